@@ -58,6 +58,14 @@ eventfd-functions = eventfd
 configs += features.h
 features.h-includes = features.h
 
+configs += hugetlb
+hugetlb-includes = sys/mman.h
+hugetlb-assert = MAP_HUGETLB
+
+configs += mbind
+mbind-includes = sys/syscall.h linux/mempolicy.h
+mbind-assert = SYS_mbind
+
 configs += net/if.h
 net/if.h-includes = net/if.h
 
@@ -72,10 +80,29 @@ configs += pthread
 pthread-cppflags = -pthread
 pthread-ldflags = -pthread
 
+configs += pthread_setaffinity_np
+pthread_setaffinity_np-cppflags = -D_GNU_SOURCE
+pthread_setaffinity_np-includes = pthread.h
+pthread_setaffinity_np-functions = pthread_setaffinity_np
+
+configs += recvmmsg
+recvmmsg-cppflags = -D_GNU_SOURCE
+recvmmsg-includes = sys/socket.h
+recvmmsg-functions = recvmmsg
+
+configs += sendmmsg
+sendmmsg-cppflags = -D_GNU_SOURCE
+sendmmsg-includes = sys/socket.h
+sendmmsg-functions = sendmmsg
+
 configs += semaphore
 semaphore-includes = semaphore.h
 semaphore-functions = sem_init
 
+configs += txtime
+txtime-includes = sys/socket.h linux/net_tstamp.h
+txtime-assert = SO_TXTIME
+
 configs += unistd.h
 unistd.h-includes = unistd.h
 
@@ -103,9 +130,14 @@ utrace-disabled = y
 define build-hook
 $(foreach target,$(filter-out %/libupipe,$1),\
   $(if $(filter %.c %.cpp,$($(target)-src)),\
-    $(eval $(target)-libs += $(if $(have_utrace),libupipe))))
+    $(eval $(target)-libs += \
+      $(if $(or $(have_utrace),$(have_ustats)),libupipe))))
 endef
 
+# --- ustats -------------------------------------------------------------------
+
+configs += ustats
+
 # --- coding-style checks ------------------------------------------------------
 
 check-whitespace:
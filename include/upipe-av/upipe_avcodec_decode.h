@@ -28,6 +28,8 @@ enum upipe_avcdec_command {
 
     /** set hardware config (const char *, const char *) */
     UPIPE_AVCDEC_SET_HW_CONFIG,
+    /** set the number of decoding threads (int) */
+    UPIPE_AVCDEC_SET_THREADS,
 };
 
 /** @This sets the hardware accel configuration.
@@ -45,6 +47,21 @@ static inline int upipe_avcdec_set_hw_config(struct upipe *upipe,
                          UPIPE_AVCDEC_SIGNATURE, type, device);
 }
 
+/** @This sets the number of threads used by libavcodec to decode frames
+ * and slices in parallel. Video frames are then directly rendered from the
+ * decoding threads into a ubuf_pic_mem pool sized for the frames in flight.
+ * It must be called before the first packet is decoded.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads number of threads, or 0 for one thread per core
+ * @return an error code
+ */
+static inline int upipe_avcdec_set_threads(struct upipe *upipe, int threads)
+{
+    return upipe_control(upipe, UPIPE_AVCDEC_SET_THREADS,
+                         UPIPE_AVCDEC_SIGNATURE, threads);
+}
+
 /** @This returns the management structure for all avcodec decode pipes.
  *
  * @return pointer to manager
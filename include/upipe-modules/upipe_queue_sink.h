@@ -25,6 +25,10 @@
  * in a different thread. That way the upipe_xfer is released on termination,
  * and releases in turn the qsrc in the appropriate upump_mgr (thread)
  * context.
+ *
+ * In batch mode (see @ref upipe_qsink_set_batch), incoming urefs are
+ * accumulated and published together, so that the queue source thread is
+ * woken up once per batch and drains the whole batch in one go.
  */
 
 #ifndef _UPIPE_MODULES_UPIPE_QUEUE_SINK_H_
@@ -37,6 +41,18 @@ extern "C" {
 #include "upipe/upipe.h"
 
 #define UPIPE_QSINK_SIGNATURE UBASE_FOURCC('q','s','n','k')
+/** maximum number of urefs in a batch */
+#define UPIPE_QSINK_MAX_BATCH 1024
+
+/** @This extends upipe_command with specific commands for queue sink. */
+enum upipe_qsink_command {
+    UPIPE_QSINK_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** returns the batch parameters (unsigned int *, uint64_t *) */
+    UPIPE_QSINK_GET_BATCH,
+    /** sets the batch parameters (unsigned int, uint64_t) */
+    UPIPE_QSINK_SET_BATCH
+};
 
 /** @This returns the management structure for all queue sinks.
  *
@@ -44,6 +60,44 @@ extern "C" {
  */
 struct upipe_mgr *upipe_qsink_mgr_alloc(void);
 
+/** @This returns the batch parameters.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with the maximum number of urefs in a batch (0 or
+ * 1 if disabled)
+ * @param timeout_p filled in with the maximum time a uref may wait in a
+ * pending batch, in units of the 27 MHz clock (0 if none)
+ * @return an error code
+ */
+static inline int upipe_qsink_get_batch(struct upipe *upipe,
+                                        unsigned int *batch_p,
+                                        uint64_t *timeout_p)
+{
+    return upipe_control(upipe, UPIPE_QSINK_GET_BATCH, UPIPE_QSINK_SIGNATURE,
+                         batch_p, timeout_p);
+}
+
+/** @This sets the batch parameters. When batch is greater than 1, urefs are
+ * accumulated until batch urefs are pending or the first pending uref has
+ * waited for timeout, and are then pushed to the queue at once. The queue
+ * source then outputs up to batch urefs per wake-up. If timeout is 0, a
+ * pending batch is only published when it is full, or when the pipe is
+ * released.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch maximum number of urefs in a batch (0 or 1 to disable, max
+ * @ref #UPIPE_QSINK_MAX_BATCH)
+ * @param timeout maximum time a uref may wait in a pending batch, in units
+ * of the 27 MHz clock (0 for none)
+ * @return an error code
+ */
+static inline int upipe_qsink_set_batch(struct upipe *upipe,
+                                        unsigned int batch, uint64_t timeout)
+{
+    return upipe_control(upipe, UPIPE_QSINK_SET_BATCH, UPIPE_QSINK_SIGNATURE,
+                         batch, timeout);
+}
+
 /** @hidden */
 #define ARGS_DECL , struct upipe *qsrc
 /** @hidden */
@@ -64,7 +64,11 @@ enum upipe_xfer_mgr_command {
     /** freeze the remote event loop (void) */
     UPIPE_XFER_MGR_FREEZE,
     /** thaw the remote event loop (void) */
-    UPIPE_XFER_MGR_THAW
+    UPIPE_XFER_MGR_THAW,
+    /** start grouping messages to the remote event loop (void) */
+    UPIPE_XFER_MGR_BATCH_BEGIN,
+    /** send the grouped messages to the remote event loop (void) */
+    UPIPE_XFER_MGR_BATCH_END
 };
 
 /** @This returns a management structure for xfer pipes. You would need one
@@ -77,7 +81,7 @@ enum upipe_xfer_mgr_command {
  * @param mutex mutual exclusion primitives to access the event loop, or NULL
  * @return pointer to manager
  */
-struct upipe_mgr *upipe_xfer_mgr_alloc(uint8_t queue_length,
+struct upipe_mgr *upipe_xfer_mgr_alloc(uint32_t queue_length,
                                        uint16_t msg_pool_depth,
                                        struct umutex *mutex);
 
@@ -128,6 +132,39 @@ static inline int upipe_xfer_mgr_thaw(struct upipe_mgr *mgr)
     return upipe_mgr_control(mgr, UPIPE_XFER_MGR_THAW, UPIPE_XFER_SIGNATURE);
 }
 
+/** @This starts grouping the messages sent by the xfer pipes of this
+ * manager (attach upump manager, set URI, set output and release), until the
+ * matching call to @ref upipe_xfer_mgr_batch_end. The grouped messages take
+ * a single slot of the queue and are processed by the remote event loop on a
+ * single wake-up, which allows to reconfigure many remote pipes at once
+ * regardless of the queue length.
+ *
+ * Calls may be nested. The grouped messages are shared by all the users of
+ * the manager, so this may only be used if the xfer pipes of the manager are
+ * controlled from a single thread.
+ *
+ * @param mgr xfer_mgr structure
+ * @return an error code
+ */
+static inline int upipe_xfer_mgr_batch_begin(struct upipe_mgr *mgr)
+{
+    return upipe_mgr_control(mgr, UPIPE_XFER_MGR_BATCH_BEGIN,
+                             UPIPE_XFER_SIGNATURE);
+}
+
+/** @This sends the messages grouped since the matching call to
+ * @ref upipe_xfer_mgr_batch_begin. If the queue is full, the messages are
+ * kept and an error is returned; the call may then be retried later.
+ *
+ * @param mgr xfer_mgr structure
+ * @return an error code
+ */
+static inline int upipe_xfer_mgr_batch_end(struct upipe_mgr *mgr)
+{
+    return upipe_mgr_control(mgr, UPIPE_XFER_MGR_BATCH_END,
+                             UPIPE_XFER_SIGNATURE);
+}
+
 /** @hidden */
 #define ARGS_DECL , struct upipe *upipe_remote
 /** @hidden */
@@ -34,6 +34,14 @@ enum upipe_udpsink_command {
     UPIPE_UDPSINK_SET_FD,
     /** set remote address (const struct sockaddr *, socklen_t) **/
     UPIPE_UDPSINK_SET_PEER,
+    /** get batch depth (unsigned int *) **/
+    UPIPE_UDPSINK_GET_BATCH,
+    /** set batch depth (unsigned int) **/
+    UPIPE_UDPSINK_SET_BATCH,
+    /** get kernel pacing parameters (int *, uint64_t *) **/
+    UPIPE_UDPSINK_GET_TXTIME,
+    /** set kernel pacing parameters (int, uint64_t) **/
+    UPIPE_UDPSINK_SET_TXTIME,
 };
 
 /** @This returns the management structure for all udp sinks.
@@ -79,6 +87,70 @@ static inline int upipe_udpsink_set_peer(struct upipe *upipe,
     return upipe_control(upipe, UPIPE_UDPSINK_SET_PEER, UPIPE_UDPSINK_SIGNATURE,
             addr, addrlen);
 }
+
+/** @This returns the batch depth, that is the maximum number of datagrams
+ * written by a single system call.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with the batch depth (0 if disabled)
+ * @return an error code
+ */
+static inline int upipe_udpsink_get_batch(struct upipe *upipe,
+                                          unsigned int *batch_p)
+{
+    return upipe_control(upipe, UPIPE_UDPSINK_GET_BATCH,
+                         UPIPE_UDPSINK_SIGNATURE, batch_p);
+}
+
+/** @This sets the batch depth. When greater than 1, all buffers that are due
+ * are written with a single sendmmsg() call, and consecutive datagrams of the
+ * same size are coalesced with UDP generic segmentation offload when the
+ * system supports it.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch batch depth (0 or 1 to disable)
+ * @return an error code
+ */
+static inline int upipe_udpsink_set_batch(struct upipe *upipe,
+                                          unsigned int batch)
+{
+    return upipe_control(upipe, UPIPE_UDPSINK_SET_BATCH,
+                         UPIPE_UDPSINK_SIGNATURE, batch);
+}
+
+/** @This returns the kernel pacing parameters.
+ *
+ * @param upipe description structure of the pipe
+ * @param clockid_p filled in with the kernel clock used for transmit times
+ * @param horizon_p filled in with the pacing horizon (0 if disabled)
+ * @return an error code
+ */
+static inline int upipe_udpsink_get_txtime(struct upipe *upipe,
+                                           int *clockid_p,
+                                           uint64_t *horizon_p)
+{
+    return upipe_control(upipe, UPIPE_UDPSINK_GET_TXTIME,
+                         UPIPE_UDPSINK_SIGNATURE, clockid_p, horizon_p);
+}
+
+/** @This enables kernel pacing (SO_TXTIME). Dated buffers are written up to
+ * horizon in advance, with their date converted to the given kernel clock,
+ * and the kernel releases them at the right time (this typically requires
+ * the fq or etf queueing discipline on the interface).
+ *
+ * @param upipe description structure of the pipe
+ * @param clockid kernel clock (CLOCK_TAI for etf, CLOCK_MONOTONIC for fq)
+ * @param horizon maximum delay before the date of a buffer at which it is
+ * written, in units of UCLOCK_FREQ (0 to disable)
+ * @return an error code
+ */
+static inline int upipe_udpsink_set_txtime(struct upipe *upipe,
+                                           int clockid, uint64_t horizon)
+{
+    return upipe_control(upipe, UPIPE_UDPSINK_SET_TXTIME,
+                         UPIPE_UDPSINK_SIGNATURE, clockid, horizon);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,10 @@ enum upipe_udpsrc_command {
     UPIPE_UDPSRC_GET_FD,
     /** set socket fd (int) */
     UPIPE_UDPSRC_SET_FD,
+    /** get batch depth (unsigned int *) */
+    UPIPE_UDPSRC_GET_BATCH,
+    /** set batch depth (unsigned int) */
+    UPIPE_UDPSRC_SET_BATCH,
 };
 
 /** @This extends uprobe_throw with specific events. */
@@ -64,6 +68,36 @@ static inline int upipe_udpsrc_set_fd(struct upipe *upipe, int fd)
                          fd);
 }
 
+/** @This returns the batch depth, that is the maximum number of datagrams
+ * read by a single system call.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with the batch depth (0 if disabled)
+ * @return an error code
+ */
+static inline int upipe_udpsrc_get_batch(struct upipe *upipe,
+                                         unsigned int *batch_p)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_GET_BATCH,
+                         UPIPE_UDPSRC_SIGNATURE, batch_p);
+}
+
+/** @This sets the batch depth. When greater than 1, the pipe pre-allocates
+ * the given number of buffers and reads them with a single recvmmsg() call
+ * each time the socket becomes readable. Each datagram is still output in
+ * its own uref.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch batch depth (0 or 1 to disable)
+ * @return an error code
+ */
+static inline int upipe_udpsrc_set_batch(struct upipe *upipe,
+                                         unsigned int batch)
+{
+    return upipe_control(upipe, UPIPE_UDPSRC_SET_BATCH,
+                         UPIPE_UDPSRC_SIGNATURE, batch);
+}
+
 /** @This returns the management structure for all udp socket sources.
  *
  * @return pointer to manager
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe pool-based memory allocator with per-thread magazines
+ * This memory allocator keeps released memory blocks in pools organized by
+ * power of 2's sizes, like @ref umem_pool_mgr_alloc. Each thread allocates
+ * from and releases to its own magazines (small arrays of buffers) without
+ * any atomic operation, and only exchanges whole magazines with the shared
+ * pools when its magazines are empty or full.
+ *
+ * The per-thread magazines are released to the shared pools when the thread
+ * exits. The manager must only be freed when no other thread uses it.
+ */
+
+#ifndef _UPIPE_PTHREAD_UMEM_PTHREAD_POOL_H_
+/** @hidden */
+#define _UPIPE_PTHREAD_UMEM_PTHREAD_POOL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/umem.h"
+
+/** @This allocates a new instance of the umem pool manager with per-thread
+ * magazines, allocating buffers from application memory, using pools in
+ * power of 2's.
+ *
+ * @param magazine_size number of buffers in a magazine
+ * @param pool0_size size (in octets) of the smallest allocatable buffer; it
+ * must be a power of 2
+ * @param nb_pools number of buffer pools to maintain, with sizes in power of
+ * 2's increments, followed, for each pool, by the maximum number of buffers
+ * to keep in the shared pool (unsigned int); larger buffers will be directly
+ * managed with malloc() and free()
+ * @return pointer to manager, or NULL in case of error
+ */
+struct umem_mgr *umem_pthread_pool_mgr_alloc(unsigned int magazine_size,
+                                             size_t pool0_size,
+                                             size_t nb_pools, ...);
+
+/** @This allocates a new instance of the umem pool manager with per-thread
+ * magazines, with a simpler API.
+ *
+ * @param magazine_size number of buffers in a magazine
+ * @param base_pools_depth number of buffers to keep in the shared pool for
+ * the smaller buffers; for larger buffers the same number is used, divided
+ * by 2, 4, or 8
+ * @return pointer to manager, or NULL in case of error
+ */
+struct umem_mgr *umem_pthread_pool_mgr_alloc_simple(unsigned int magazine_size,
+                                                    uint16_t base_pools_depth);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
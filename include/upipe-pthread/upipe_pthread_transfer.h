@@ -23,11 +23,50 @@ extern "C" {
 #include "upipe/upump.h"
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
 #include <pthread.h>
 
 /** @hidden */
 struct umutex;
 
+/** @This describes the scheduling and memory placement of a transfer
+ * thread. */
+struct upipe_pthread_attr {
+    /** priority (nice value) of the thread, or INT_MAX to leave it
+     * unchanged */
+    int priority;
+    /** scheduling policy of the thread (SCHED_OTHER, SCHED_FIFO or
+     * SCHED_RR), or -1 to leave it unchanged */
+    int sched_policy;
+    /** static priority of the thread for the real-time policies */
+    int sched_priority;
+    /** list of CPUs the thread may run on, in the format of
+     * /sys/devices/system/cpu/online (for instance "0-3,8"), or NULL */
+    const char *cpus;
+    /** NUMA node the thread preferably allocates memory from, or -1; if
+     * cpus is NULL, the thread is also restricted to the CPUs of the node */
+    int numa_node;
+    /** lock all current and future pages of the process in memory */
+    bool mlock;
+};
+
+/** @This initializes a upipe_pthread_attr structure with values leaving the
+ * thread unchanged.
+ *
+ * @param pthread_attr pointer to the structure to initialize
+ */
+static inline void upipe_pthread_attr_init(
+        struct upipe_pthread_attr *pthread_attr)
+{
+    pthread_attr->priority = INT_MAX;
+    pthread_attr->sched_policy = -1;
+    pthread_attr->sched_priority = 0;
+    pthread_attr->cpus = NULL;
+    pthread_attr->numa_node = -1;
+    pthread_attr->mlock = false;
+}
+
 /** @This returns a management structure for transfer pipes, using a new
  * pthread. You would need one management structure per target thread.
  *
@@ -44,7 +83,7 @@ struct umutex;
  * @param attr pthread attributes
  * @return pointer to xfer manager
  */
-struct upipe_mgr *upipe_pthread_xfer_mgr_alloc(uint8_t queue_length,
+struct upipe_mgr *upipe_pthread_xfer_mgr_alloc(uint32_t queue_length,
         uint16_t msg_pool_depth, struct uprobe *uprobe_pthread_upump_mgr,
         upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
         uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -68,7 +107,7 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc(uint8_t queue_length,
  * @param name custom name
  * @return pointer to xfer manager
  */
-struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named(uint8_t queue_length,
+struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named(uint32_t queue_length,
         uint16_t msg_pool_depth, struct uprobe *uprobe_pthread_upump_mgr,
         upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
         uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -95,7 +134,7 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named(uint8_t queue_length,
  */
 UBASE_FMT_PRINTF(10, 11)
 static inline struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named_va(
-        uint8_t queue_length, uint16_t msg_pool_depth,
+        uint32_t queue_length, uint16_t msg_pool_depth,
         struct uprobe *uprobe_pthread_upump_mgr,
         upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
         uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -130,7 +169,7 @@ static inline struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named_va(
  * @return pointer to xfer manager
  */
 struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio(
-    uint8_t queue_length, uint16_t msg_pool_depth,
+    uint32_t queue_length, uint16_t msg_pool_depth,
     struct uprobe *uprobe_pthread_upump_mgr,
     upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
     uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -156,7 +195,7 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio(
  * @return pointer to xfer manager
  */
 struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named(
-    uint8_t queue_length, uint16_t msg_pool_depth,
+    uint32_t queue_length, uint16_t msg_pool_depth,
     struct uprobe *uprobe_pthread_upump_mgr,
     upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
     uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -184,7 +223,7 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named(
  */
 UBASE_FMT_PRINTF(11, 12)
 static inline struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named_va(
-        uint8_t queue_length, uint16_t msg_pool_depth,
+        uint32_t queue_length, uint16_t msg_pool_depth,
         struct uprobe *uprobe_pthread_upump_mgr,
         upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
         uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -202,6 +241,62 @@ static inline struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named_va(
             priority, string), NULL)
 }
 
+/** @This returns a management structure for transfer pipes, using a new
+ * pthread with the given scheduling and memory placement. You would need one
+ * management structure per target thread. Failures to apply the attributes
+ * (for instance because of missing privileges) are reported as warnings to
+ * uprobe_pthread_upump_mgr, and the thread runs anyway.
+ *
+ * @param queue_length maximum length of the internal queue of commands
+ * @param msg_pool_depth maximum number of messages in the pool
+ * @param uprobe_pthread_upump_mgr pointer to optional probe, that will be set
+ * with the created upump_mgr
+ * @param upump_mgr_alloc alloc function provided by the upump manager
+ * @param upump_pool_depth maximum number of upump structures in the pool
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures in
+ * the pool
+ * @param mutex mutual exclusion pimitives to access the event loop, or NULL
+ * @param pthread_id_p reference to created thread ID (may be NULL)
+ * @param attr pthread attributes
+ * @param pthread_attr scheduling and memory placement of the thread, or NULL
+ * @param name custom name or NULL
+ * @return pointer to xfer manager
+ */
+struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_attr(
+    uint32_t queue_length, uint16_t msg_pool_depth,
+    struct uprobe *uprobe_pthread_upump_mgr,
+    upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
+    uint16_t upump_blocker_pool_depth, struct umutex *mutex,
+    pthread_t *pthread_id_p, const pthread_attr_t *restrict attr,
+    const struct upipe_pthread_attr *pthread_attr, const char *name);
+
+/** @This returns a management structure for worker pipes (see
+ * @ref upipe_work_mgr_alloc), transferring the subpipelines to a new pthread
+ * with the given scheduling and memory placement.
+ *
+ * @param queue_length maximum length of the internal queue of commands
+ * @param msg_pool_depth maximum number of messages in the pool
+ * @param uprobe_pthread_upump_mgr pointer to optional probe, that will be set
+ * with the created upump_mgr
+ * @param upump_mgr_alloc alloc function provided by the upump manager
+ * @param upump_pool_depth maximum number of upump structures in the pool
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures in
+ * the pool
+ * @param mutex mutual exclusion pimitives to access the event loop, or NULL
+ * @param pthread_id_p reference to created thread ID (may be NULL)
+ * @param attr pthread attributes
+ * @param pthread_attr scheduling and memory placement of the thread, or NULL
+ * @param name custom name or NULL
+ * @return pointer to worker manager
+ */
+struct upipe_mgr *upipe_pthread_work_mgr_alloc(
+    uint32_t queue_length, uint16_t msg_pool_depth,
+    struct uprobe *uprobe_pthread_upump_mgr,
+    upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
+    uint16_t upump_blocker_pool_depth, struct umutex *mutex,
+    pthread_t *pthread_id_p, const pthread_attr_t *restrict attr,
+    const struct upipe_pthread_attr *pthread_attr, const char *name);
+
 #ifdef __cplusplus
 }
 #endif
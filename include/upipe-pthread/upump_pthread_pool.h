@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe event loops scheduled on a pool of POSIX threads
+ *
+ * The pool runs one event loop per worker thread, allocated with a
+ * user-supplied @ref upump_mgr_alloc function. Pipes are not attached to a
+ * given worker, but to a pool upump manager, allocated with
+ * @ref upump_pthread_pool_mgr_alloc, which stands for an independent
+ * subgraph: all the pumps of a pool upump manager are dispatched from the
+ * same worker thread, so the pipes using it keep their single-threaded
+ * invariant.
+ *
+ * Pool upump managers are spread across the workers when they are
+ * submitted, and idle workers periodically steal a pool upump manager from
+ * the busiest worker. A pool upump manager is only moved between two
+ * dispatches, and its pumps are recreated on the event loop of the new
+ * worker.
+ *
+ * A pool upump manager may be used from any thread until it is submitted
+ * with @ref upump_pthread_pool_mgr_submit; afterwards it must only be used
+ * from the callbacks of its pumps.
+ */
+
+#ifndef _UPIPE_PTHREAD_UPUMP_PTHREAD_POOL_H_
+/** @hidden */
+#define _UPIPE_PTHREAD_UPUMP_PTHREAD_POOL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/upump.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define UPUMP_PTHREAD_POOL_SIGNATURE UBASE_FOURCC('p','p','o','l')
+
+/** @hidden */
+struct upump_pthread_pool;
+
+/** @This allocates a pool of worker threads, each running its own event loop.
+ *
+ * @param nb_threads number of worker threads
+ * @param upump_mgr_alloc function creating the event loop of a worker
+ * @param upump_pool_depth maximum number of upump structures in the pool of
+ * the event loop of a worker
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures
+ * in the pool of the event loop of a worker
+ * @param attr pthread attributes of the worker threads, or NULL
+ * @return pointer to the pool, or NULL in case of error
+ */
+struct upump_pthread_pool *upump_pthread_pool_alloc(unsigned int nb_threads,
+        upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
+        uint16_t upump_blocker_pool_depth, const pthread_attr_t *restrict attr);
+
+/** @This waits for the pumps of all submitted pool upump managers to stop
+ * blocking, terminates the worker threads and frees the pool. The pool
+ * upump managers which are still allocated may then be released from the
+ * calling thread.
+ *
+ * @param pool pointer to the pool
+ */
+void upump_pthread_pool_free(struct upump_pthread_pool *pool);
+
+/** @This allocates a upump manager scheduled on the pool.
+ *
+ * @param pool pointer to the pool
+ * @param upump_pool_depth maximum number of upump structures in the pool
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures
+ * in the pool
+ * @return pointer to the wrapped upump_mgr structure
+ */
+struct upump_mgr *upump_pthread_pool_mgr_alloc(struct upump_pthread_pool *pool,
+        uint16_t upump_pool_depth, uint16_t upump_blocker_pool_depth);
+
+/** @This hands a pool upump manager over to the least loaded worker. The
+ * calling thread must not use the manager afterwards.
+ *
+ * @param mgr pointer to a pool upump manager
+ * @return an error code
+ */
+int upump_pthread_pool_mgr_submit(struct upump_mgr *mgr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -28,7 +28,11 @@ enum upipe_sws_command {
     /** set flags (int) */
     UPIPE_SWS_SET_FLAGS,
     /** get flags (int *) */
-    UPIPE_SWS_GET_FLAGS
+    UPIPE_SWS_GET_FLAGS,
+    /** set the number of threads (unsigned int) */
+    UPIPE_SWS_SET_THREADS,
+    /** get the number of threads (unsigned int *) */
+    UPIPE_SWS_GET_THREADS
 };
 
 /** @This gets the swscale flags.
@@ -55,6 +59,36 @@ static inline bool upipe_sws_set_flags(struct upipe *upipe, int flags)
                          flags);
 }
 
+/** @This gets the number of threads converting a picture.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads_p filled in with the number of threads
+ * @return an error code
+ */
+static inline int upipe_sws_get_threads(struct upipe *upipe,
+                                        unsigned int *threads_p)
+{
+    return upipe_control(upipe, UPIPE_SWS_GET_THREADS, UPIPE_SWS_SIGNATURE,
+                         threads_p);
+}
+
+/** @This sets the number of threads converting a picture. Pictures are then
+ * split into horizontal bands, converted in parallel by worker threads and
+ * the calling thread. Bands are only used when the vertical size is not
+ * changed, for instance for a pixel format conversion; other pictures are
+ * converted by the calling thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads number of threads, 0 or 1 for the calling thread only
+ * @return an error code
+ */
+static inline int upipe_sws_set_threads(struct upipe *upipe,
+                                        unsigned int threads)
+{
+    return upipe_control(upipe, UPIPE_SWS_SET_THREADS, UPIPE_SWS_SIGNATURE,
+                         threads);
+}
+
 /** @This returns the management structure for sws pipes.
  *
  * @return pointer to manager
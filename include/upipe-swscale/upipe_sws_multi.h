@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe swscale module scaling a picture to several sizes
+ *
+ * Each output subpipe is allocated with a flow definition giving its size
+ * (hsize and vsize); the outputs keep the pixel format of the input. The
+ * source picture is mapped once, and an output is scaled from the smallest
+ * already scaled output at least twice as large in both directions, if any
+ * (for instance 540p from 1080p), instead of from the source. Outputs that
+ * do not depend on each other are scaled in parallel by worker threads.
+ */
+
+#ifndef _UPIPE_SWSCALE_UPIPE_SWS_MULTI_H_
+/** @hidden */
+#define _UPIPE_SWSCALE_UPIPE_SWS_MULTI_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/upipe.h"
+
+#define UPIPE_SWS_MULTI_SIGNATURE UBASE_FOURCC('s','w','s','m')
+#define UPIPE_SWS_MULTI_OUTPUT_SIGNATURE UBASE_FOURCC('s','w','s','o')
+
+/** @This extends upipe_command with specific commands for swscale multi
+ * pipes. */
+enum upipe_sws_multi_command {
+    UPIPE_SWS_MULTI_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** set flags (int) */
+    UPIPE_SWS_MULTI_SET_FLAGS,
+    /** get flags (int *) */
+    UPIPE_SWS_MULTI_GET_FLAGS,
+    /** set the number of threads (unsigned int) */
+    UPIPE_SWS_MULTI_SET_THREADS,
+    /** get the number of threads (unsigned int *) */
+    UPIPE_SWS_MULTI_GET_THREADS
+};
+
+/** @This gets the swscale flags.
+ *
+ * @param upipe description structure of the pipe
+ * @param flags_p filled in with the swscale flags
+ * @return an error code
+ */
+static inline int upipe_sws_multi_get_flags(struct upipe *upipe, int *flags_p)
+{
+    return upipe_control(upipe, UPIPE_SWS_MULTI_GET_FLAGS,
+                         UPIPE_SWS_MULTI_SIGNATURE, flags_p);
+}
+
+/** @This sets the swscale flags.
+ *
+ * @param upipe description structure of the pipe
+ * @param flags swscale flags
+ * @return an error code
+ */
+static inline int upipe_sws_multi_set_flags(struct upipe *upipe, int flags)
+{
+    return upipe_control(upipe, UPIPE_SWS_MULTI_SET_FLAGS,
+                         UPIPE_SWS_MULTI_SIGNATURE, flags);
+}
+
+/** @This gets the number of threads scaling the outputs.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads_p filled in with the number of threads
+ * @return an error code
+ */
+static inline int upipe_sws_multi_get_threads(struct upipe *upipe,
+                                              unsigned int *threads_p)
+{
+    return upipe_control(upipe, UPIPE_SWS_MULTI_GET_THREADS,
+                         UPIPE_SWS_MULTI_SIGNATURE, threads_p);
+}
+
+/** @This sets the number of threads scaling the outputs, including the
+ * calling thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads number of threads, 0 or 1 for the calling thread only
+ * @return an error code
+ */
+static inline int upipe_sws_multi_set_threads(struct upipe *upipe,
+                                              unsigned int threads)
+{
+    return upipe_control(upipe, UPIPE_SWS_MULTI_SET_THREADS,
+                         UPIPE_SWS_MULTI_SIGNATURE, threads);
+}
+
+/** @This returns the management structure for swscale multi pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_sws_multi_mgr_alloc(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
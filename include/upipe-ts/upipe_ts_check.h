@@ -30,12 +30,49 @@ extern "C" {
 
 #define UPIPE_TS_CHECK_SIGNATURE UBASE_FOURCC('t','s','c','k')
 
+/** @This extends upipe_command with specific commands for ts check. */
+enum upipe_ts_check_command {
+    UPIPE_TS_CHECK_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** returns whether packets are output in vectors (int *) */
+    UPIPE_TS_CHECK_GET_VECTOR,
+    /** sets whether packets are output in vectors (int) */
+    UPIPE_TS_CHECK_SET_VECTOR,
+};
+
 /** @This returns the management structure for all ts_check pipes.
  *
  * @return pointer to manager
  */
 struct upipe_mgr *upipe_ts_check_mgr_alloc(void);
 
+/** @This returns whether packets are output in vectors.
+ *
+ * @param upipe description structure of the pipe
+ * @param vector_p filled in with true if vectors are enabled
+ * @return an error code
+ */
+static inline int upipe_ts_check_get_vector(struct upipe *upipe, int *vector_p)
+{
+    return upipe_control(upipe, UPIPE_TS_CHECK_GET_VECTOR,
+                         UPIPE_TS_CHECK_SIGNATURE, vector_p);
+}
+
+/** @This sets whether packets are output in vectors. When enabled, the
+ * packets of an input buffer are output in a single uref, described by
+ * @ref uref_ts_vector_get, instead of one uref per packet. The next pipe
+ * must support TS packet vectors.
+ *
+ * @param upipe description structure of the pipe
+ * @param vector true to enable vectors
+ * @return an error code
+ */
+static inline int upipe_ts_check_set_vector(struct upipe *upipe, int vector)
+{
+    return upipe_control(upipe, UPIPE_TS_CHECK_SET_VECTOR,
+                         UPIPE_TS_CHECK_SIGNATURE, vector);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe module monitoring a transport stream
+ *
+ * This pipe analyses the TS packets of an input (single packets or packet
+ * vectors) without reassembling PES or PSI, in the spirit of the first and
+ * second priority checks of ETR 290: continuity counter errors, PCR
+ * repetition, accuracy and jitter, repetition intervals of PSI tables and
+ * bitrates, per PID. PMT PIDs are learnt from the PAT; PIDs lower than 0x20
+ * are considered to carry PSI.
+ *
+ * Time measurements are based on the cr_sys date of the incoming urefs.
+ * Packets are then forwarded unchanged to the output, so that the pipe may
+ * be inserted before a ts_demux, or dropped if there is no output.
+ */
+
+#ifndef _UPIPE_TS_UPIPE_TS_MONITOR_H_
+/** @hidden */
+#define _UPIPE_TS_UPIPE_TS_MONITOR_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/upipe.h"
+
+#define UPIPE_TS_MONITOR_SIGNATURE UBASE_FOURCC('t','s','m','n')
+
+/** maximum number of tables tracked per PID */
+#define UPIPE_TS_MONITOR_TABLES 4
+
+/** @This describes the repetition of a PSI table. */
+struct upipe_ts_monitor_table {
+    /** table ID */
+    uint8_t table_id;
+    /** number of occurrences of the first section of the table */
+    uint64_t count;
+    /** last interval between two occurrences, in units of UCLOCK_FREQ */
+    uint64_t interval;
+    /** maximum interval between two occurrences, in units of UCLOCK_FREQ */
+    uint64_t interval_max;
+};
+
+/** @This describes the statistics of a PID. */
+struct upipe_ts_monitor_stats {
+    /** number of packets */
+    uint64_t packets;
+    /** number of continuity counter errors */
+    uint64_t cc_errors;
+    /** number of packets with the transport error indicator */
+    uint64_t transport_errors;
+    /** bitrate over the last measurement period, in bits per second */
+    uint64_t bitrate;
+
+    /** number of PCRs */
+    uint64_t pcrs;
+    /** maximum interval between two PCRs, in units of UCLOCK_FREQ */
+    uint64_t pcr_interval_max;
+    /** maximum difference between a PCR and the value interpolated from the
+     * previous PCRs and the position of the packet, in units of
+     * UCLOCK_FREQ */
+    uint64_t pcr_accuracy_max;
+    /** maximum difference between the increments of the PCR and of the
+     * arrival date, in units of UCLOCK_FREQ */
+    uint64_t pcr_jitter_max;
+
+    /** number of tracked PSI tables */
+    unsigned int nb_tables;
+    /** tracked PSI tables */
+    struct upipe_ts_monitor_table tables[UPIPE_TS_MONITOR_TABLES];
+};
+
+/** @This extends upipe_command with specific commands for ts monitor. */
+enum upipe_ts_monitor_command {
+    UPIPE_TS_MONITOR_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** returns the next PID seen on the input (unsigned int *) */
+    UPIPE_TS_MONITOR_ITERATE_PID,
+    /** returns the statistics of a PID (unsigned int,
+     * struct upipe_ts_monitor_stats *) */
+    UPIPE_TS_MONITOR_GET_STATS,
+    /** resets the counters and maxima of all PIDs (void) */
+    UPIPE_TS_MONITOR_RESET_STATS,
+    /** returns the bitrate measurement period (uint64_t *) */
+    UPIPE_TS_MONITOR_GET_PERIOD,
+    /** sets the bitrate measurement period (uint64_t) */
+    UPIPE_TS_MONITOR_SET_PERIOD
+};
+
+/** @This iterates over the PIDs seen on the input, in ascending order.
+ *
+ * @param upipe description structure of the pipe
+ * @param pid_p filled in with the next PID, or UINT_MAX when there is no
+ * more PID; initialize with UINT_MAX
+ * @return an error code
+ */
+static inline int upipe_ts_monitor_iterate_pid(struct upipe *upipe,
+                                               unsigned int *pid_p)
+{
+    return upipe_control(upipe, UPIPE_TS_MONITOR_ITERATE_PID,
+                         UPIPE_TS_MONITOR_SIGNATURE, pid_p);
+}
+
+/** @This returns the statistics of a PID.
+ *
+ * @param upipe description structure of the pipe
+ * @param pid PID
+ * @param stats filled in with the statistics
+ * @return an error code
+ */
+static inline int upipe_ts_monitor_get_stats(struct upipe *upipe,
+        unsigned int pid, struct upipe_ts_monitor_stats *stats)
+{
+    return upipe_control(upipe, UPIPE_TS_MONITOR_GET_STATS,
+                         UPIPE_TS_MONITOR_SIGNATURE, pid, stats);
+}
+
+/** @This resets the counters and maxima of all PIDs, for instance after
+ * they have been reported.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static inline int upipe_ts_monitor_reset_stats(struct upipe *upipe)
+{
+    return upipe_control(upipe, UPIPE_TS_MONITOR_RESET_STATS,
+                         UPIPE_TS_MONITOR_SIGNATURE);
+}
+
+/** @This returns the bitrate measurement period.
+ *
+ * @param upipe description structure of the pipe
+ * @param period_p filled in with the period, in units of UCLOCK_FREQ
+ * @return an error code
+ */
+static inline int upipe_ts_monitor_get_period(struct upipe *upipe,
+                                              uint64_t *period_p)
+{
+    return upipe_control(upipe, UPIPE_TS_MONITOR_GET_PERIOD,
+                         UPIPE_TS_MONITOR_SIGNATURE, period_p);
+}
+
+/** @This sets the bitrate measurement period.
+ *
+ * @param upipe description structure of the pipe
+ * @param period period, in units of UCLOCK_FREQ
+ * @return an error code
+ */
+static inline int upipe_ts_monitor_set_period(struct upipe *upipe,
+                                              uint64_t period)
+{
+    return upipe_control(upipe, UPIPE_TS_MONITOR_SET_PERIOD,
+                         UPIPE_TS_MONITOR_SIGNATURE, period);
+}
+
+/** @This returns the management structure for all ts_monitor pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_ts_monitor_mgr_alloc(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
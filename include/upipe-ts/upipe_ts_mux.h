@@ -163,6 +163,10 @@ enum upipe_ts_mux_command {
     UPIPE_TS_MUX_GET_PES_MIN_DURATION,
     /** forces PES alignment (int) */
     UPIPE_TS_MUX_FORCE_PES_ALIGNMENT,
+    /** returns the size of output batches in file mode (unsigned int *) */
+    UPIPE_TS_MUX_GET_BATCH_SIZE,
+    /** sets the size of output batches in file mode (unsigned int) */
+    UPIPE_TS_MUX_SET_BATCH_SIZE,
 
     /** ts_encaps commands begin here */
     UPIPE_TS_MUX_ENCAPS = UPIPE_CONTROL_LOCAL + 0x1000,
@@ -784,6 +788,35 @@ static inline int upipe_ts_mux_force_pes_alignment(struct upipe *upipe,
                          UPIPE_TS_MUX_SIGNATURE, force ? 1 : 0);
 }
 
+/** @This returns the size of output batches in file mode.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_size_p filled in with the size of batches, in octets, or 0
+ * @return an error code
+ */
+static inline int upipe_ts_mux_get_batch_size(struct upipe *upipe,
+                                              unsigned int *batch_size_p)
+{
+    return upipe_control(upipe, UPIPE_TS_MUX_GET_BATCH_SIZE,
+                         UPIPE_TS_MUX_SIGNATURE, batch_size_p);
+}
+
+/** @This sets the size of output batches in file mode (without uclock).
+ * Instead of one uref per MTU, the mux then outputs urefs carrying a single
+ * contiguous buffer of up to the given size, made of whole MTUs, which suits
+ * writing to files faster than real time. Batches are not used in live mode.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_size size of batches, in octets, or 0 to disable batches
+ * @return an error code
+ */
+static inline int upipe_ts_mux_set_batch_size(struct upipe *upipe,
+                                              unsigned int batch_size)
+{
+    return upipe_control(upipe, UPIPE_TS_MUX_SET_BATCH_SIZE,
+                         UPIPE_TS_MUX_SIGNATURE, batch_size);
+}
+
 /** @This stops updating a PSI table upon sub removal.
  *
  * @param upipe description structure of the pipe
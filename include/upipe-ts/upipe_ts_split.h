@@ -33,6 +33,46 @@ enum uprobe_ts_split_event {
     UPROBE_TS_SPLIT_DEL_PID
 };
 
+/** @This extends upipe_command with specific commands for ts split. */
+enum upipe_ts_split_command {
+    UPIPE_TS_SPLIT_SENTINEL = UPIPE_CONTROL_LOCAL,
+
+    /** returns the bitmap of PIDs having at least one output
+     * (const uint64_t **) */
+    UPIPE_TS_SPLIT_GET_PIDS
+};
+
+/** size of a bitmap of PIDs, in 64-bit words */
+#define UPIPE_TS_SPLIT_PIDS_WORDS (8192 / 64)
+
+/** @This checks if a PID is set in a bitmap of PIDs.
+ *
+ * @param pids bitmap of @ref UPIPE_TS_SPLIT_PIDS_WORDS words
+ * @param pid PID to check
+ * @return true if the PID is set
+ */
+static inline bool upipe_ts_split_check_pid(const uint64_t *pids, uint16_t pid)
+{
+    return (pids[(pid >> 6) & (UPIPE_TS_SPLIT_PIDS_WORDS - 1)] >>
+            (pid & 63)) & 1;
+}
+
+/** @This returns the bitmap of PIDs having at least one output. The bitmap
+ * has @ref UPIPE_TS_SPLIT_PIDS_WORDS words, is owned by the pipe and is
+ * updated when outputs are allocated or released, so it may be kept and
+ * ANDed with other bitmaps to drop unwanted packets upstream.
+ *
+ * @param upipe description structure of the pipe
+ * @param pids_p filled in with a pointer to the bitmap
+ * @return an error code
+ */
+static inline int upipe_ts_split_get_pids(struct upipe *upipe,
+                                          const uint64_t **pids_p)
+{
+    return upipe_control(upipe, UPIPE_TS_SPLIT_GET_PIDS,
+                         UPIPE_TS_SPLIT_SIGNATURE, pids_p);
+}
+
 /** @This returns the management structure for all ts_split pipes.
  *
  * @return pointer to manager
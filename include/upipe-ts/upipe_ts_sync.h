@@ -37,7 +37,11 @@ enum upipe_ts_sync_command {
     /** returns the configured number of packets to synchronize with (int *) */
     UPIPE_TS_SYNC_GET_SYNC,
     /** sets the configured number of packets to synchronize with (int) */
-    UPIPE_TS_SYNC_SET_SYNC
+    UPIPE_TS_SYNC_SET_SYNC,
+    /** returns whether packets are output in vectors (int *) */
+    UPIPE_TS_SYNC_GET_VECTOR,
+    /** sets whether packets are output in vectors (int) */
+    UPIPE_TS_SYNC_SET_VECTOR,
 };
 
 /** @This returns the management structure for all ts_sync pipes.
@@ -72,6 +76,33 @@ static inline int upipe_ts_sync_set_sync(struct upipe *upipe, int sync)
                          sync);
 }
 
+/** @This returns whether packets are output in vectors.
+ *
+ * @param upipe description structure of the pipe
+ * @param vector_p filled in with true if vectors are enabled
+ * @return an error code
+ */
+static inline int upipe_ts_sync_get_vector(struct upipe *upipe, int *vector_p)
+{
+    return upipe_control(upipe, UPIPE_TS_SYNC_GET_VECTOR,
+                         UPIPE_TS_SYNC_SIGNATURE, vector_p);
+}
+
+/** @This sets whether packets are output in vectors. When enabled, all
+ * the synchronized packets available in a buffer are output in a single uref,
+ * described by @ref uref_ts_vector_get, instead of one uref per packet.
+ * The next pipe must support TS packet vectors.
+ *
+ * @param upipe description structure of the pipe
+ * @param vector true to enable vectors
+ * @return an error code
+ */
+static inline int upipe_ts_sync_set_vector(struct upipe *upipe, int vector)
+{
+    return upipe_control(upipe, UPIPE_TS_SYNC_SET_VECTOR,
+                         UPIPE_TS_SYNC_SIGNATURE, vector);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,7 @@ UREF_ATTR_SMALL_UNSIGNED(ts_flow, pes_header, "t.pes_header",
         minimum PES header size)
 UREF_ATTR_UNSIGNED(ts_flow, pes_min_duration, "t.pes_mindur",
         minimum PES duration)
+UREF_ATTR_VOID(ts_flow, vector, "t.vector", TS packet vectors accepted)
 
 /* PMT */
 UREF_ATTR_SMALL_UNSIGNED(ts_flow, component_type, "t.ctype", component type)
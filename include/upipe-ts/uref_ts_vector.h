@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe attributes for vectors of TS packets
+ *
+ * A TS packet vector is a block uref containing several contiguous packets
+ * of the same size, starting at offset 0, along with a compact attribute
+ * giving the packet size and the PID of each packet. It allows the TS input
+ * chain (ts_sync or ts_check, ts_split and ts_decaps) to pass a whole
+ * datagram with a single uref, instead of allocating one uref per packet.
+ *
+ * A uref without the attribute contains exactly one TS packet.
+ */
+
+#ifndef _UPIPE_TS_UREF_TS_VECTOR_H_
+/** @hidden */
+#define _UPIPE_TS_UREF_TS_VECTOR_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/uref.h"
+#include "upipe/uref_attr.h"
+
+#include <string.h>
+#include <stdint.h>
+
+/** maximum number of packets in a vector */
+#define UREF_TS_VECTOR_MAX 64
+
+UREF_ATTR_OPAQUE(ts_vector, internal, "t.vec", TS packet vector)
+
+/** @This returns the PID of a packet in a vector.
+ *
+ * @param pids array of PIDs, as returned by @ref uref_ts_vector_get
+ * @param i index of the packet
+ * @return the PID
+ */
+static inline uint16_t uref_ts_vector_pid(const uint8_t *pids, unsigned int i)
+{
+    return ((uint16_t)pids[2 * i] << 8) | pids[2 * i + 1];
+}
+
+/** @This sets the PID of a packet in an array of PIDs.
+ *
+ * @param pids array of PIDs
+ * @param i index of the packet
+ * @param pid PID
+ */
+static inline void uref_ts_vector_set_pid(uint8_t *pids, unsigned int i,
+                                          uint16_t pid)
+{
+    pids[2 * i] = pid >> 8;
+    pids[2 * i + 1] = pid & 0xff;
+}
+
+/** @This returns the description of a TS packet vector.
+ *
+ * @param uref pointer to the uref
+ * @param packet_size_p filled in with the size of a packet
+ * @param nb_p filled in with the number of packets
+ * @param pids_p filled in with the array of PIDs, to be read with
+ * @ref uref_ts_vector_pid
+ * @return an error code
+ */
+static inline int uref_ts_vector_get(struct uref *uref, size_t *packet_size_p,
+                                     unsigned int *nb_p,
+                                     const uint8_t **pids_p)
+{
+    const uint8_t *attr;
+    size_t size;
+    UBASE_RETURN(uref_ts_vector_get_internal(uref, &attr, &size))
+    if (unlikely(size < 2 || size % 2))
+        return UBASE_ERR_INVALID;
+    *packet_size_p = ((size_t)attr[0] << 8) | attr[1];
+    *nb_p = size / 2 - 1;
+    *pids_p = attr + 2;
+    return UBASE_ERR_NONE;
+}
+
+/** @This sets the description of a TS packet vector.
+ *
+ * @param uref pointer to the uref
+ * @param packet_size size of a packet
+ * @param nb number of packets
+ * @param pids array of PIDs, written with @ref uref_ts_vector_set_pid
+ * @return an error code
+ */
+static inline int uref_ts_vector_set(struct uref *uref, size_t packet_size,
+                                     unsigned int nb, const uint8_t *pids)
+{
+    if (unlikely(nb > UREF_TS_VECTOR_MAX || packet_size > UINT16_MAX))
+        return UBASE_ERR_INVALID;
+    uint8_t attr[2 + 2 * nb];
+    attr[0] = packet_size >> 8;
+    attr[1] = packet_size & 0xff;
+    memcpy(attr + 2, pids, 2 * nb);
+    return uref_ts_vector_set_internal(uref, attr, 2 + 2 * nb);
+}
+
+/** @This deletes the description of a TS packet vector.
+ *
+ * @param uref pointer to the uref
+ * @return an error code
+ */
+static inline int uref_ts_vector_delete(struct uref *uref)
+{
+    return uref_ts_vector_delete_internal(uref);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -46,7 +46,10 @@ enum upipe_x264_command {
     UPIPE_X264_SET_SC_LATENCY,
 
     /** set slice type enforcement mode (int) */
-    UPIPE_X264_SET_SLICE_TYPE_ENFORCE
+    UPIPE_X264_SET_SLICE_TYPE_ENFORCE,
+
+    /** encode in a dedicated thread (unsigned int) */
+    UPIPE_X264_SET_ASYNC
 };
 
 /** @This reconfigures encoder with updated parameters.
@@ -134,6 +137,25 @@ static inline int upipe_x264_set_slice_type_enforce(struct upipe *upipe,
                          UPIPE_X264_SIGNATURE, enforce ? 1 : 0);
 }
 
+/** @This switches the encoder to a dedicated thread. Pictures are handed
+ * over to the encoder thread and encoded frames are output from the upump
+ * manager of the pipe, so that the input only blocks when queue_length
+ * pictures are being encoded. Without upump manager, encoded frames are
+ * output from the input and when the pipe is released. It must be called
+ * before the first picture.
+ *
+ * @param upipe description structure of the pipe
+ * @param queue_length maximum number of pictures being encoded, or 0 to
+ * encode from the input (the default)
+ * @return an error code
+ */
+static inline int upipe_x264_set_async(struct upipe *upipe,
+                                       unsigned int queue_length)
+{
+    return upipe_control(upipe, UPIPE_X264_SET_ASYNC, UPIPE_X264_SIGNATURE,
+                         queue_length);
+}
+
 /** @This returns the management structure for x264 pipes.
  *
  * @return pointer to manager
@@ -47,6 +47,10 @@ typedef void * _Atomic uatomic_ptr_t;
 
 #define uatomic_fetch_add atomic_fetch_add
 #define uatomic_fetch_sub atomic_fetch_sub
+#define uatomic_load_relaxed(obj)                                           \
+    atomic_load_explicit(obj, memory_order_relaxed)
+#define uatomic_fetch_add_relaxed(obj, operand)                             \
+    atomic_fetch_add_explicit(obj, operand, memory_order_relaxed)
 
 #elif defined(UPIPE_HAVE_ATOMIC)
 
@@ -143,6 +147,30 @@ static inline uint32_t uatomic_fetch_sub(uatomic_uint32_t *obj,
     return __atomic_fetch_sub(obj, operand, __ATOMIC_SEQ_CST);
 }
 
+/** @This returns the value of a uatomic variable, without ordering it
+ * against other memory accesses. It is meant for statistics counters.
+ *
+ * @param obj pointer to a uatomic variable
+ * @return the value
+ */
+static inline uint32_t uatomic_load_relaxed(uatomic_uint32_t *obj)
+{
+    return __atomic_load_n(obj, __ATOMIC_RELAXED);
+}
+
+/** @This increments a uatomic variable, without ordering it against other
+ * memory accesses. It is meant for statistics counters.
+ *
+ * @param obj pointer to a uatomic variable
+ * @param operand value to add
+ * @return value before the operation
+ */
+static inline uint32_t uatomic_fetch_add_relaxed(uatomic_uint32_t *obj,
+                                                 uint32_t operand)
+{
+    return __atomic_fetch_add(obj, operand, __ATOMIC_RELAXED);
+}
+
 
 #elif defined(UPIPE_HAVE_SEMAPHORE) /* mkdoc:skip */
 
@@ -220,6 +248,9 @@ static inline uint32_t uatomic_fetch_sub(uatomic_uint32_t *obj,
     return ret;
 }
 
+#define uatomic_load_relaxed uatomic_load
+#define uatomic_fetch_add_relaxed uatomic_fetch_add
+
 
 
 #else /* mkdoc:skip */
@@ -133,7 +133,22 @@ enum udict_type {
     /** p.cea_708 */
     UDICT_TYPE_PIC_CEA_708,
     /** p.bar_data */
-    UDICT_TYPE_PIC_BAR_DATA
+    UDICT_TYPE_PIC_BAR_DATA,
+
+    /** f.global */
+    UDICT_TYPE_FLOW_GLOBAL,
+    /** f.headers */
+    UDICT_TYPE_FLOW_HEADERS,
+    /** f.name */
+    UDICT_TYPE_FLOW_NAME,
+    /** f.comp */
+    UDICT_TYPE_FLOW_COMPLETE,
+    /** b.header */
+    UDICT_TYPE_BLOCK_HEADER_SIZE,
+    /** k.index_rap */
+    UDICT_TYPE_CLOCK_INDEX_RAP,
+    /** p.original_height */
+    UDICT_TYPE_PIC_ORIGINAL_HEIGHT
 };
 
 /** @This defines standard commands which udict modules may implement. */
@@ -22,6 +22,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <assert.h>
 
 /** @hidden */
@@ -63,6 +64,35 @@ static inline size_t umem_size(struct umem *umem)
     return umem->size;
 }
 
+/** @This defines standard manager commands which umem managers may implement.
+ */
+enum umem_mgr_command {
+    /** get the statistics of a pool (unsigned int,
+     * struct umem_mgr_stats *) */
+    UMEM_MGR_GET_STATS,
+
+    /** non-standard commands implemented by a umem manager can start from
+     * there */
+    UMEM_MGR_CONTROL_LOCAL = 0x8000
+};
+
+/** @This stores the statistics of a pool of a umem manager. Counters are
+ * 32 bits and wrap around, so they are meant to be sampled periodically. */
+struct umem_mgr_stats {
+    /** size (in octets) of the buffers of the pool */
+    size_t size;
+    /** maximum number of buffers the pool may keep */
+    unsigned int depth;
+    /** number of allocations served by the pool */
+    uint32_t hits;
+    /** number of allocations that fell back to malloc() */
+    uint32_t misses;
+    /** number of buffers released to free() because the pool was full */
+    uint32_t overflows;
+    /** highest number of buffers kept in the pool at the same time */
+    uint32_t high_water;
+};
+
 /** @This defines a memory allocator management structure.
  */
 struct umem_mgr {
@@ -78,6 +108,8 @@ struct umem_mgr {
 
     /** function to release all buffers kept in pools */
     void (*umem_mgr_vacuum)(struct umem_mgr *);
+    /** manager control function for standard or local commands */
+    int (*umem_mgr_control)(struct umem_mgr *, int, va_list);
 };
 
 /** @This allocates a new umem buffer space.
@@ -134,6 +166,55 @@ static inline void umem_mgr_vacuum(struct umem_mgr *mgr)
         mgr->umem_mgr_vacuum(mgr);
 }
 
+/** @internal @This sends a control command to the umem manager.
+ *
+ * @param mgr pointer to umem manager
+ * @param command manager command to send, followed by optional read or write
+ * parameters
+ * @param args optional read or write parameters
+ * @return an error code
+ */
+static inline int umem_mgr_control_va(struct umem_mgr *mgr,
+                                      int command, va_list args)
+{
+    assert(mgr != NULL);
+    if (mgr->umem_mgr_control == NULL)
+        return UBASE_ERR_UNHANDLED;
+
+    return mgr->umem_mgr_control(mgr, command, args);
+}
+
+/** @internal @This sends a control command to the umem manager.
+ *
+ * @param mgr pointer to umem manager
+ * @param command manager command to send, followed by optional read or write
+ * parameters
+ * @return an error code
+ */
+static inline int umem_mgr_control(struct umem_mgr *mgr, int command, ...)
+{
+    int err;
+    va_list args;
+    va_start(args, command);
+    err = umem_mgr_control_va(mgr, command, args);
+    va_end(args);
+    return err;
+}
+
+/** @This returns the statistics of a pool of the umem manager. Pools are
+ * numbered from 0, by increasing buffer size.
+ *
+ * @param mgr pointer to umem manager
+ * @param pool index of the pool
+ * @param stats filled in with the statistics of the pool
+ * @return an error code, UBASE_ERR_INVALID if the pool does not exist
+ */
+static inline int umem_mgr_get_stats(struct umem_mgr *mgr, unsigned int pool,
+                                     struct umem_mgr_stats *stats)
+{
+    return umem_mgr_control(mgr, UMEM_MGR_GET_STATS, pool, stats);
+}
+
 /** @This increments the reference count of a umem manager.
  *
  * @param mgr pointer to umem manager
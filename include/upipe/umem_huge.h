@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe huge page memory allocator
+ * This memory allocator carves large buffers out of arenas backed by huge
+ * pages (MAP_HUGETLB if huge pages are reserved, or transparent huge pages
+ * otherwise), optionally bound to a NUMA node. Released buffers are kept in
+ * pools organized by power of 2's sizes, and are only returned to the system
+ * when the manager is freed. Buffers smaller than @ref UMEM_HUGE_POOL0_SIZE or
+ * larger than an arena, or allocated when all arenas are exhausted, revert to
+ * malloc() and free().
+ */
+
+#ifndef _UPIPE_UMEM_HUGE_H_
+/** @hidden */
+#define _UPIPE_UMEM_HUGE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/umem.h"
+#include "upipe/umutex.h"
+
+/** size (in octets) of the smallest buffers carved out of arenas */
+#define UMEM_HUGE_POOL0_SIZE (64 * 1024)
+
+/** @This allocates a new instance of the umem huge page manager.
+ *
+ * @param arena_size size (in octets) of an arena, rounded up to a power of 2
+ * and to the huge page size
+ * @param nb_arenas maximum number of arenas to map
+ * @param numa_node NUMA node to bind the arenas to, or -1
+ * @param mutex mutual exclusion primitives to access the arenas, or NULL if
+ * the manager is only used by a single thread
+ * @return pointer to manager, or NULL in case of error
+ */
+struct umem_mgr *umem_huge_mgr_alloc(size_t arena_size, unsigned int nb_arenas,
+                                     int numa_node, struct umutex *mutex);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe bounded multi-producer multi-consumer ring of pointers
+ * This ring holds up to 2^31 elements; its storage is rounded up to a power
+ * of 2, but it never holds more elements than requested. Each element
+ * carries a sequence number telling whether it is ready to be pushed or
+ * popped at a given position, so that producers and consumers only contend
+ * on their own position counter.
+ */
+
+#ifndef _UPIPE_UMPMC_H_
+/** @hidden */
+#define _UPIPE_UMPMC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/ubase.h"
+#include "upipe/uatomic.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/** @This is the maximum capacity of a umpmc ring. */
+#define UMPMC_MAX_LENGTH (UINT32_C(1) << 31)
+
+/** @This defines an element in the ring. */
+struct umpmc_elem {
+    /** sequence number of the element */
+    uatomic_uint32_t seq;
+    /** pointer to opaque structure */
+    void *opaque;
+};
+
+/** @This is the implementation of a bounded multi-producer multi-consumer
+ * ring. */
+struct umpmc {
+    /** capacity of the ring minus 1 */
+    uint32_t mask;
+    /** maximum number of elements in the ring */
+    uint32_t length;
+    /** next position to push to */
+    uatomic_uint32_t push_pos;
+    /** next position to pop from */
+    uatomic_uint32_t pop_pos;
+    /** array of elements */
+    struct umpmc_elem *elems;
+};
+
+/** @This returns the capacity of a ring able to hold the given number of
+ * elements (the next power of 2, and at least 2 so that the sequence numbers
+ * of pushed and free elements differ). It is a constant expression if length
+ * is.
+ *
+ * @param length maximum number of elements in the ring (max 2^31)
+ * @return capacity of the ring
+ */
+#define umpmc_capacity(length)                                              \
+    ((uint32_t)(length) <= 2 ? 2 :                                          \
+     ((((uint32_t)(length) - 1) | (((uint32_t)(length) - 1) >> 1) |         \
+       (((uint32_t)(length) - 1) >> 2) | (((uint32_t)(length) - 1) >> 4) |  \
+       (((uint32_t)(length) - 1) >> 8) | (((uint32_t)(length) - 1) >> 16))  \
+      + 1))
+
+/** @This returns the required size of extra data space for umpmc.
+ *
+ * @param length maximum number of elements in the ring (max 2^31)
+ * @return size in octets to allocate
+ */
+#define umpmc_sizeof(length)                                                \
+    ((size_t)umpmc_capacity(length) * sizeof(struct umpmc_elem))
+
+/** @This initializes a umpmc.
+ *
+ * @param umpmc pointer to a umpmc structure
+ * @param length maximum number of elements in the ring (max 2^31)
+ * @param extra mandatory extra space allocated by the caller, with the size
+ * returned by @ref #umpmc_sizeof
+ * @return the maximum number of elements in the ring
+ */
+static inline uint32_t umpmc_init(struct umpmc *umpmc, uint32_t length,
+                                  void *extra)
+{
+    assert(length && length <= UMPMC_MAX_LENGTH);
+    uint32_t capacity = umpmc_capacity(length);
+    umpmc->mask = capacity - 1;
+    umpmc->length = length;
+    umpmc->elems = (struct umpmc_elem *)extra;
+    for (uint32_t i = 0; i < capacity; i++) {
+        uatomic_init(&umpmc->elems[i].seq, i);
+        umpmc->elems[i].opaque = NULL;
+    }
+    uatomic_init(&umpmc->push_pos, 0);
+    uatomic_init(&umpmc->pop_pos, 0);
+    return length;
+}
+
+/** @This pushes a new element.
+ *
+ * @param umpmc pointer to a umpmc structure
+ * @param opaque opaque to associate with element (not NULL)
+ * @return false if the ring is full and the element couldn't be queued
+ */
+static inline bool umpmc_push(struct umpmc *umpmc, void *opaque)
+{
+    assert(opaque != NULL);
+    struct umpmc_elem *elem;
+    uint32_t pos = uatomic_load(&umpmc->push_pos);
+    for ( ; ; ) {
+        elem = &umpmc->elems[pos & umpmc->mask];
+        int32_t diff = (int32_t)(uatomic_load(&elem->seq) - pos);
+        if (diff == 0) {
+            if (pos - uatomic_load(&umpmc->pop_pos) >= umpmc->length) {
+                /* pop_pos never exceeds an up-to-date push_pos */
+                uint32_t cur = uatomic_load(&umpmc->push_pos);
+                if (cur == pos)
+                    return false;
+                pos = cur;
+                continue;
+            }
+            if (uatomic_compare_exchange(&umpmc->push_pos, &pos, pos + 1))
+                break;
+        } else if (diff < 0)
+            return false;
+        else
+            pos = uatomic_load(&umpmc->push_pos);
+    }
+
+    elem->opaque = opaque;
+    uatomic_store(&elem->seq, pos + 1);
+    return true;
+}
+
+/** @internal @This pops an element.
+ *
+ * @param umpmc pointer to a umpmc structure
+ * @return pointer to opaque, or NULL if the ring is empty
+ */
+static inline void *umpmc_pop_internal(struct umpmc *umpmc)
+{
+    struct umpmc_elem *elem;
+    uint32_t pos = uatomic_load(&umpmc->pop_pos);
+    for ( ; ; ) {
+        elem = &umpmc->elems[pos & umpmc->mask];
+        int32_t diff = (int32_t)(uatomic_load(&elem->seq) - (pos + 1));
+        if (diff == 0) {
+            if (uatomic_compare_exchange(&umpmc->pop_pos, &pos, pos + 1))
+                break;
+        } else if (diff < 0)
+            return NULL;
+        else
+            pos = uatomic_load(&umpmc->pop_pos);
+    }
+
+    void *opaque = elem->opaque;
+    elem->opaque = NULL;
+    uatomic_store(&elem->seq, pos + umpmc->mask + 1);
+    return opaque;
+}
+
+/** @This pops an element with type checking.
+ *
+ * @param umpmc pointer to a umpmc structure
+ * @param type type of the opaque pointer
+ * @return pointer to opaque, or NULL if the ring is empty
+ */
+#define umpmc_pop(umpmc, type) (type)umpmc_pop_internal(umpmc)
+
+/** @This cleans up the umpmc data structure. Please note that it is the
+ * caller's responsibility to empty the ring first.
+ *
+ * @param umpmc pointer to a umpmc structure
+ */
+static inline void umpmc_clean(struct umpmc *umpmc)
+{
+    for (uint32_t i = 0; i <= umpmc->mask; i++)
+        uatomic_clean(&umpmc->elems[i].seq);
+    uatomic_clean(&umpmc->push_pos);
+    uatomic_clean(&umpmc->pop_pos);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -23,6 +23,7 @@ extern "C" {
 #include "upipe/urequest.h"
 #include "upipe/udict_dump.h"
 #include "upipe/utrace.h"
+#include "upipe/ustats.h"
 
 #include <stdint.h>
 #include <stdarg.h>
@@ -163,6 +164,10 @@ struct upipe {
     struct uprobe *uprobe;
     /** pointer to the manager for this pipe type */
     struct upipe_mgr *mgr;
+#ifdef UPIPE_HAVE_USTATS
+    /** statistics of the pipe, allocated when first counted */
+    struct ustats_upipe *ustats;
+#endif
 };
 
 UBASE_FROM_TO(upipe, uchain, uchain, uchain)
@@ -460,6 +465,9 @@ static inline void upipe_init(struct upipe *upipe, struct upipe_mgr *mgr,
     upipe->uprobe = uprobe;
     upipe->refcount = NULL;
     upipe->mgr = mgr;
+#ifdef UPIPE_HAVE_USTATS
+    upipe->ustats = NULL;
+#endif
     upipe_mgr_use(mgr);
     utrace_upipe_init(upipe);
 }
@@ -568,6 +576,7 @@ static inline void upipe_clean(struct upipe *upipe)
 {
     assert(upipe != NULL);
     utrace_upipe_clean(upipe);
+    ustats_upipe_clean(upipe);
     uprobe_release(upipe->uprobe);
     upipe_mgr_release(upipe->mgr);
 }
@@ -1058,9 +1067,12 @@ static inline void upipe_input(struct upipe *upipe, struct uref *uref,
         uref_free(uref);
         return;
     }
+    struct ustats_frame ustats_frame;
     upipe_use(upipe);
     utrace_upipe_input_enter(upipe, uref);
+    ustats_upipe_input_enter(&ustats_frame, upipe, uref);
     upipe->mgr->upipe_input(upipe, uref, upump_p);
+    ustats_upipe_input_leave(&ustats_frame);
     utrace_upipe_input_leave();
     upipe_release(upipe);
 }
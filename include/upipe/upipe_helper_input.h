@@ -209,6 +209,7 @@ static void STRUCTURE##_hold_input(struct upipe *upipe, struct uref *uref)  \
     struct STRUCTURE *s = STRUCTURE##_from_upipe(upipe);                    \
     ulist_add(&s->UREFS, uref_to_uchain(uref));                             \
     s->NB_UREFS++;                                                          \
+    ustats_upipe_queue(upipe, s->NB_UREFS);                                 \
 }                                                                           \
 /** @internal @This pops an uref from the buffered urefs.                   \
  *                                                                          \
@@ -222,6 +223,7 @@ static UBASE_UNUSED struct uref *STRUCTURE##_pop_input(struct upipe *upipe) \
     if (uchain == NULL)                                                     \
         return NULL;                                                        \
     s->NB_UREFS--;                                                          \
+    ustats_upipe_queue(upipe, s->NB_UREFS);                                 \
     return uref_from_uchain(uchain);                                        \
 }                                                                           \
 /** @internal @This pushes an uref back into the buffered urefs.            \
@@ -235,6 +237,7 @@ static UBASE_UNUSED void STRUCTURE##_unshift_input(struct upipe *upipe,     \
     struct STRUCTURE *s = STRUCTURE##_from_upipe(upipe);                    \
     ulist_unshift(&s->UREFS, uref_to_uchain(uref));                         \
     s->NB_UREFS++;                                                          \
+    ustats_upipe_queue(upipe, s->NB_UREFS);                                 \
 }                                                                           \
 /** @internal @This outputs all urefs that have been held.                  \
  *                                                                          \
@@ -247,6 +250,7 @@ static UBASE_UNUSED bool STRUCTURE##_output_input(struct upipe *upipe)      \
     struct uchain *uchain;                                                  \
     while ((uchain = ulist_pop(&s->UREFS)) != NULL) {                       \
         s->NB_UREFS--;                                                      \
+        ustats_upipe_queue(upipe, s->NB_UREFS);                             \
         struct uref *uref = uref_from_uchain(uchain);                       \
         bool (*output)(struct upipe *, struct uref *, struct upump **) =    \
             OUTPUT;                                                         \
@@ -294,6 +298,7 @@ static void STRUCTURE##_clean_input(struct upipe *upipe)                    \
 {                                                                           \
     struct STRUCTURE *s = STRUCTURE##_from_upipe(upipe);                    \
     s->NB_UREFS = 0;                                                        \
+    ustats_upipe_queue(upipe, s->NB_UREFS);                                 \
     STRUCTURE##_unblock_input(upipe);                                       \
     struct uchain *uchain, *uchain_tmp;                                     \
     ulist_delete_foreach (&s->UREFS, uchain, uchain_tmp) {                  \
@@ -8,6 +8,9 @@
 
 /** @file
  * @short Upipe thread-safe queue of elements
+ * The queue is backed by a @ref umpmc ring, so its length may be up to 2^31
+ * elements. Elements may be pushed and popped in batches, in which case the
+ * ueventfd of the other side is triggered at most once per batch.
  */
 
 #ifndef _UPIPE_UQUEUE_H_
@@ -20,17 +23,20 @@ extern "C" {
 #include "upipe/config.h"
 #include "upipe/ubase.h"
 #include "upipe/uatomic.h"
-#include "upipe/ufifo.h"
+#include "upipe/umpmc.h"
 #include "upipe/ueventfd.h"
 #include "upipe/upump.h"
 
 #include <stdint.h>
 #include <assert.h>
 
+/** @This is the maximum length of a queue. */
+#define UQUEUE_MAX_LENGTH UMPMC_MAX_LENGTH
+
 /** @This is the implementation of a queue. */
 struct uqueue {
-    /** FIFO */
-    struct ufifo fifo;
+    /** ring of elements */
+    struct umpmc ring;
     /** number of elements in the queue */
     uatomic_uint32_t counter;
     /** maximum number of elements in the queue */
@@ -46,19 +52,22 @@ struct uqueue {
  * @param length maximum number of elements in the queue
  * @return size in octets to allocate
  */
-#define uqueue_sizeof(length) ufifo_sizeof(length)
+#define uqueue_sizeof(length) umpmc_sizeof(length)
 
 /** @This initializes a uqueue.
  *
  * @param uqueue pointer to a uqueue structure
- * @param length maximum number of elements in the queue
+ * @param length maximum number of elements in the queue (max
+ * @ref #UQUEUE_MAX_LENGTH)
  * @param extra mandatory extra space allocated by the caller, with the size
- * returned by @ref #ufifo_sizeof
+ * returned by @ref #uqueue_sizeof
  * @return false in case of failure
  */
-static inline bool uqueue_init(struct uqueue *uqueue, uint8_t length,
+static inline bool uqueue_init(struct uqueue *uqueue, uint32_t length,
                                void *extra)
 {
+    if (unlikely(!length || length > UQUEUE_MAX_LENGTH))
+        return false;
     if (unlikely(!ueventfd_init(&uqueue->event_push, true)))
         return false;
     if (unlikely(!ueventfd_init(&uqueue->event_pop, false))) {
@@ -66,9 +75,8 @@ static inline bool uqueue_init(struct uqueue *uqueue, uint8_t length,
         return false;
     }
 
-    ufifo_init(&uqueue->fifo, length, extra);
+    uqueue->length = umpmc_init(&uqueue->ring, length, extra);
     uatomic_init(&uqueue->counter, 0);
-    uqueue->length = length;
     return true;
 }
 
@@ -118,12 +126,12 @@ static inline struct upump *uqueue_upump_alloc_pop(struct uqueue *uqueue,
  */
 static inline bool uqueue_push(struct uqueue *uqueue, void *element)
 {
-    if (unlikely(!ufifo_push(&uqueue->fifo, element))) {
+    if (unlikely(!umpmc_push(&uqueue->ring, element))) {
         /* signal that we are full */
         ueventfd_read(&uqueue->event_push);
 
         /* double-check */
-        if (likely(!ufifo_push(&uqueue->fifo, element)))
+        if (likely(!umpmc_push(&uqueue->ring, element)))
             return false;
 
         /* signal that we're alright again */
@@ -142,13 +150,13 @@ static inline bool uqueue_push(struct uqueue *uqueue, void *element)
  */
 static inline void *uqueue_pop_internal(struct uqueue *uqueue)
 {
-    void *element = ufifo_pop(&uqueue->fifo, void *);
+    void *element = umpmc_pop(&uqueue->ring, void *);
     if (unlikely(element == NULL)) {
         /* signal that we starve */
         ueventfd_read(&uqueue->event_pop);
 
         /* double-check */
-        element = ufifo_pop(&uqueue->fifo, void *);
+        element = umpmc_pop(&uqueue->ring, void *);
         if (likely(element == NULL))
             return NULL;
 
@@ -169,6 +177,85 @@ static inline void *uqueue_pop_internal(struct uqueue *uqueue)
  */
 #define uqueue_pop(uqueue, type) (type)uqueue_pop_internal(uqueue)
 
+/** @This pushes a batch of elements into the queue. The popping side is
+ * woken up at most once for the whole batch.
+ *
+ * @param uqueue pointer to a uqueue structure
+ * @param elements array of pointers to elements to push
+ * @param nb number of elements in the array
+ * @return number of elements actually queued, which may be lower than nb if
+ * the queue is full
+ */
+static inline unsigned int uqueue_push_batch(struct uqueue *uqueue,
+                                             void **elements, unsigned int nb)
+{
+    unsigned int pushed = 0;
+    while (pushed < nb && umpmc_push(&uqueue->ring, elements[pushed]))
+        pushed++;
+
+    if (unlikely(!pushed && nb)) {
+        /* signal that we are full */
+        ueventfd_read(&uqueue->event_push);
+
+        /* double-check */
+        if (likely(!umpmc_push(&uqueue->ring, elements[0])))
+            return 0;
+
+        /* signal that we're alright again */
+        ueventfd_write(&uqueue->event_push);
+        pushed++;
+        while (pushed < nb && umpmc_push(&uqueue->ring, elements[pushed]))
+            pushed++;
+    }
+
+    if (likely(pushed) &&
+        unlikely(uatomic_fetch_add(&uqueue->counter, pushed) == 0))
+        ueventfd_write(&uqueue->event_pop);
+    return pushed;
+}
+
+/** @This pops a batch of elements from the queue. The pushing side is woken
+ * up at most once for the whole batch.
+ *
+ * @param uqueue pointer to a uqueue structure
+ * @param elements array filled in with pointers to popped elements
+ * @param nb maximum number of elements to pop
+ * @return number of elements actually popped, 0 if the queue is empty
+ */
+static inline unsigned int uqueue_pop_batch(struct uqueue *uqueue,
+                                            void **elements, unsigned int nb)
+{
+    unsigned int popped = 0;
+    while (popped < nb &&
+           (elements[popped] = umpmc_pop(&uqueue->ring, void *)) != NULL)
+        popped++;
+
+    if (unlikely(!popped && nb)) {
+        /* signal that we starve */
+        ueventfd_read(&uqueue->event_pop);
+
+        /* double-check */
+        elements[0] = umpmc_pop(&uqueue->ring, void *);
+        if (likely(elements[0] == NULL))
+            return 0;
+
+        /* signal that we're alright again */
+        ueventfd_write(&uqueue->event_pop);
+        popped++;
+        while (popped < nb &&
+               (elements[popped] = umpmc_pop(&uqueue->ring, void *)) != NULL)
+            popped++;
+    }
+
+    if (likely(popped)) {
+        uint32_t counter = uatomic_fetch_sub(&uqueue->counter, popped);
+        if (unlikely(counter >= uqueue->length &&
+                     counter - popped < uqueue->length))
+            ueventfd_write(&uqueue->event_push);
+    }
+    return popped;
+}
+
 /** @This returns the number of elements in the queue.
  *
  * @param uqueue pointer to a uqueue structure
@@ -186,7 +273,7 @@ static inline unsigned int uqueue_length(struct uqueue *uqueue)
 static inline void uqueue_clean(struct uqueue *uqueue)
 {
     uatomic_clean(&uqueue->counter);
-    ufifo_clean(&uqueue->fifo);
+    umpmc_clean(&uqueue->ring);
     ueventfd_clean(&uqueue->event_push);
     ueventfd_clean(&uqueue->event_pop);
 }
@@ -28,7 +28,8 @@ extern "C" {
 
 UREF_ATTR_VOID_UREF(block, start, UREF_FLAG_BLOCK_START, start of logical block)
 UREF_ATTR_VOID_UREF(block, end, UREF_FLAG_BLOCK_END, end of logical block)
-UREF_ATTR_UNSIGNED(block, header_size, "b.header", global headers size)
+UREF_ATTR_UNSIGNED_SH(block, header_size, UDICT_TYPE_BLOCK_HEADER_SIZE,
+        global headers size)
 
 /** @This returns a new uref pointing to a new ubuf pointing to a block.
  * This is equivalent to the two operations sequentially, and is a shortcut.
@@ -31,7 +31,7 @@ UREF_ATTR_UNSIGNED_UREF(clock, cr_dts_delay, cr_dts_delay,
 UREF_ATTR_UNSIGNED_UREF(clock, rap_cr_delay, rap_cr_delay,
         delay between RAP and CR)
 UREF_ATTR_UNSIGNED_SH(clock, duration, UDICT_TYPE_CLOCK_DURATION, duration)
-UREF_ATTR_SMALL_UNSIGNED(clock, index_rap, "k.index_rap",
+UREF_ATTR_SMALL_UNSIGNED_SH(clock, index_rap, UDICT_TYPE_CLOCK_INDEX_RAP,
                     frame offset from last random access point)
 UREF_ATTR_RATIONAL_SH(clock, rate, UDICT_TYPE_CLOCK_RATE, playing rate)
 UREF_ATTR_UNSIGNED_SH(clock, latency, UDICT_TYPE_CLOCK_LATENCY,
@@ -32,7 +32,7 @@ UREF_ATTR_VOID_UREF(flow, random, UREF_FLAG_FLOW_RANDOM,
 UREF_ATTR_VOID_SH(flow, error, UDICT_TYPE_FLOW_ERROR,
         error flag that may be present in any uref carrying data)
 UREF_ATTR_STRING_SH(flow, def, UDICT_TYPE_FLOW_DEF, flow definition)
-UREF_ATTR_VOID(flow, complete, "f.comp",
+UREF_ATTR_VOID_SH(flow, complete, UDICT_TYPE_FLOW_COMPLETE,
         flow def flag telling an uref represents an access unit)
 UREF_ATTR_UNSIGNED_SH(flow, id, UDICT_TYPE_FLOW_ID,
         flow ID from the last split pipe)
@@ -50,9 +50,10 @@ UREF_ATTR_VOID_VA(flow, audio_clean, "f.clean[%" PRIu8"]",
 UREF_ATTR_VOID(flow, lowdelay, "f.lowdelay", low delay mode)
 UREF_ATTR_VOID(flow, copyright, "f.copyright", copyrighted content)
 UREF_ATTR_VOID(flow, original, "f.original", original or copy)
-UREF_ATTR_VOID(flow, global, "f.global", global headers present or required)
-UREF_ATTR_OPAQUE(flow, headers, "f.headers", global headers)
-UREF_ATTR_STRING(flow, name, "f.name", flow name)
+UREF_ATTR_VOID_SH(flow, global, UDICT_TYPE_FLOW_GLOBAL,
+        global headers present or required)
+UREF_ATTR_OPAQUE_SH(flow, headers, UDICT_TYPE_FLOW_HEADERS, global headers)
+UREF_ATTR_STRING_SH(flow, name, UDICT_TYPE_FLOW_NAME, flow name)
 UREF_ATTR_STRING(flow, role, "f.role", flow role)
 
 /** @This sets the flow definition attribute of a uref, with printf-style
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe per-pipe statistics
+ *
+ * When built with the ustats configuration (the default), every pipe may
+ * keep counters of the urefs and octets it receives and outputs, of the time
+ * spent in its input function, of the depth of its input queue and of the
+ * latency of the urefs it receives, measured from their cr_sys date.
+ *
+ * Counting is off by default, and is switched on at runtime with
+ * @ref ustats_enable; pipes start counting on the first uref they receive
+ * afterwards. The counters are only updated from the thread running the
+ * pipe, so reading them from another thread gives approximate values.
+ */
+
+#ifndef _UPIPE_USTATS_H_
+/** @hidden */
+#define _UPIPE_USTATS_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "upipe/config.h"
+#include "upipe/ubase.h"
+#include "upipe/uatomic.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** @hidden */
+struct upipe;
+/** @hidden */
+struct uref;
+/** @hidden */
+struct uclock;
+/** @hidden */
+struct ustats_upipe;
+
+/** number of buckets of the latency histogram */
+#define USTATS_LATENCY_BUCKETS 16
+/** upper bound of the first bucket of the latency histogram, in units of
+ * UCLOCK_FREQ (100 µs); each following bucket doubles the bound, and the
+ * last bucket is unbounded */
+#define USTATS_LATENCY_BASE UINT64_C(2700)
+
+/** @This is a snapshot of the statistics of a pipe. */
+struct ustats {
+    /** number of urefs received */
+    uint64_t urefs_in;
+    /** number of octets of block urefs received */
+    uint64_t bytes_in;
+    /** number of urefs output */
+    uint64_t urefs_out;
+    /** number of octets of block urefs output */
+    uint64_t bytes_out;
+    /** time spent in the input function, including downstream pipes called
+     * synchronously, in nanoseconds */
+    uint64_t time_total;
+    /** time spent in the input function, excluding downstream pipes called
+     * synchronously, in nanoseconds */
+    uint64_t time_self;
+    /** longest call to the input function, in nanoseconds */
+    uint64_t time_max;
+    /** current number of urefs held in the input queue */
+    uint64_t queue_depth;
+    /** highest number of urefs held in the input queue */
+    uint64_t queue_max;
+    /** number of received urefs per latency range */
+    uint64_t latency[USTATS_LATENCY_BUCKETS];
+    /** highest latency, in units of UCLOCK_FREQ */
+    uint64_t latency_max;
+};
+
+/** @This stores the state of a call to an input function. */
+struct ustats_frame {
+    /** statistics of the pipe, or NULL if not counted */
+    void *stats;
+    /** calling frame on the same thread */
+    struct ustats_frame *parent;
+    /** date of the call, in nanoseconds */
+    uint64_t start;
+    /** time spent in nested calls, in nanoseconds */
+    uint64_t nested;
+};
+
+#ifdef UPIPE_HAVE_USTATS
+
+/** @hidden */
+extern uatomic_uint32_t ustats_enabled;
+
+/** @This switches counting on.
+ *
+ * @param uclock clock used to compute latencies, or NULL to use the
+ * monotonic system clock (as uclock_std does by default)
+ */
+void ustats_enable(struct uclock *uclock);
+
+/** @This switches counting off. Counters are kept. */
+void ustats_disable(void);
+
+/** @This returns a snapshot of the statistics of a pipe.
+ *
+ * @param upipe description structure of the pipe
+ * @param stats filled in with the counters
+ * @return an error code, UBASE_ERR_INVALID if the pipe has no counters
+ */
+int ustats_get(struct upipe *upipe, struct ustats *stats);
+
+/** @This resets the counters of all pipes. */
+void ustats_reset(void);
+
+/** @This converts a pipe to a label including its statistics, suitable for
+ * @ref upipe_dump.
+ *
+ * @param upipe description structure of the pipe
+ * @return allocated string
+ */
+char *ustats_upipe_label(struct upipe *upipe);
+
+/** @This writes the statistics of all counted pipes as a JSON array.
+ *
+ * @param file output file
+ * @return an error code
+ */
+int ustats_dump_json(FILE *file);
+
+/** @hidden */
+void ustats_upipe_clean(struct upipe *upipe);
+/** @hidden */
+void ustats_upipe_input_start(struct ustats_frame *frame,
+                              struct upipe *upipe, struct uref *uref);
+/** @hidden */
+void ustats_upipe_input_stop(struct ustats_frame *frame);
+/** @hidden */
+void ustats_upipe_count_output(struct upipe *upipe, struct uref *uref);
+/** @hidden */
+void ustats_upipe_count_queue(struct upipe *upipe, unsigned int depth);
+
+/** @internal @This returns true if counting is switched on.
+ *
+ * @return true if counting is switched on
+ */
+static inline bool ustats_is_enabled(void)
+{
+    return unlikely(uatomic_load(&ustats_enabled));
+}
+
+/** @internal @This is called before the input function of a pipe.
+ *
+ * @param frame state of the call
+ * @param upipe description structure of the pipe
+ * @param uref uref passed to the input function
+ */
+static inline void ustats_upipe_input_enter(struct ustats_frame *frame,
+                                            struct upipe *upipe,
+                                            struct uref *uref)
+{
+    frame->stats = NULL;
+    if (ustats_is_enabled())
+        ustats_upipe_input_start(frame, upipe, uref);
+}
+
+/** @internal @This is called after the input function of a pipe.
+ *
+ * @param frame state of the call
+ */
+static inline void ustats_upipe_input_leave(struct ustats_frame *frame)
+{
+    if (unlikely(frame->stats != NULL))
+        ustats_upipe_input_stop(frame);
+}
+
+/** @internal @This is called when a pipe outputs a uref.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref being output
+ */
+static inline void ustats_upipe_output(struct upipe *upipe, struct uref *uref)
+{
+    if (ustats_is_enabled())
+        ustats_upipe_count_output(upipe, uref);
+}
+
+/** @internal @This is called when the input queue of a pipe changes.
+ *
+ * @param upipe description structure of the pipe
+ * @param depth number of urefs in the queue
+ */
+static inline void ustats_upipe_queue(struct upipe *upipe, unsigned int depth)
+{
+    if (ustats_is_enabled())
+        ustats_upipe_count_queue(upipe, depth);
+}
+
+#else
+
+# define ustats_upipe_clean(Upipe)
+# define ustats_upipe_input_enter(Frame, Upipe, Uref) ((void)(Frame))
+# define ustats_upipe_input_leave(Frame)
+# define ustats_upipe_output(Upipe, Uref)
+# define ustats_upipe_queue(Upipe, Depth)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif
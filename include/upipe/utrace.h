@@ -84,6 +84,16 @@ void utrace_ulog_add_prefix(struct ulog *ulog, struct ulog_pfx *prefix);
 
 void utrace_dump_graph(const char *name);
 
+/** @This writes the per-thread event rings to a file, when ring mode is
+ * enabled with the UTRACE_RING environment variable. The rings are also
+ * written to UTRACE_RING_FILE (utrace-ring.<pid> by default) when the
+ * process receives the UTRACE_RING_SIGNAL signal (SIGUSR2 by default).
+ *
+ * @param path path of the file to write
+ * @return an error code, UBASE_ERR_INVALID if ring mode is disabled
+ */
+int utrace_ring_dump(const char *path);
+
 #else
 
 # define utrace_va_copy(Args)
@@ -121,6 +131,8 @@ void utrace_dump_graph(const char *name);
 
 # define utrace_dump_graph(Name)
 
+# define utrace_ring_dump(Path) UBASE_ERR_UNHANDLED
+
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short declarations for a Upipe event loop using io_uring
+ *
+ * Besides the standard pump types, this event loop allows modules to submit
+ * reads and writes directly to the kernel: the pump triggers once the
+ * operation has completed, and the number of octets transferred (or a
+ * negative errno) is then returned by @ref upump_uring_get_result. Another
+ * operation is submitted with @ref upump_restart, optionally after changing
+ * the buffer with @ref upump_uring_set_buffer.
+ */
+
+#ifndef _UPUMP_URING_UPUMP_URING_H_
+/** @hidden */
+#define _UPUMP_URING_UPUMP_URING_H_
+
+#include "upipe/upump.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UPUMP_URING_SIGNATURE UBASE_FOURCC('u','r','n','g')
+
+/** @This extends upump_type with specific types for upump_uring. */
+enum upump_uring_type {
+    UPUMP_URING_TYPE_SENTINEL = UPUMP_TYPE_LOCAL,
+
+    /** event triggers when a read has completed (int, void *, size_t,
+     * uint64_t) */
+    UPUMP_URING_TYPE_READ,
+    /** event triggers when a write has completed (int, const void *, size_t,
+     * uint64_t) */
+    UPUMP_URING_TYPE_WRITE,
+};
+
+/** @This extends upump_command with specific commands for upump_uring. */
+enum upump_uring_command {
+    UPUMP_URING_SENTINEL = UPUMP_CONTROL_LOCAL,
+
+    /** returns the result of the last operation (ssize_t *) */
+    UPUMP_URING_GET_RESULT,
+    /** sets the buffer of the next operation (void *, size_t, uint64_t) */
+    UPUMP_URING_SET_BUFFER,
+};
+
+/** @This allocates and initializes a upump_mgr structure.
+ *
+ * @param upump_pool_depth maximum number of upump structures in the pool
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures in
+ * the pool
+ * @return pointer to the wrapped upump_mgr structure
+ */
+struct upump_mgr *upump_uring_mgr_alloc(uint16_t upump_pool_depth,
+                                        uint16_t upump_blocker_pool_depth);
+
+/** @This allocates and initializes a pump reading from a file descriptor.
+ * The read is submitted when the pump is started, and the buffer must
+ * remain valid until the pump triggers, is stopped or is freed.
+ *
+ * @param mgr management structure for this event loop
+ * @param cb function to call when the read has completed
+ * @param opaque pointer to the module's internal structure
+ * @param refcount pointer to urefcount structure to increment during callback,
+ * or NULL
+ * @param fd file descriptor to read from
+ * @param buf buffer to read into
+ * @param len size of the buffer
+ * @param offset position in the file, or UINT64_MAX for the current position
+ * @return pointer to allocated pump, or NULL in case of failure
+ */
+static inline struct upump *upump_uring_alloc_read(struct upump_mgr *mgr,
+                                                   upump_cb cb, void *opaque,
+                                                   struct urefcount *refcount,
+                                                   int fd, void *buf,
+                                                   size_t len, uint64_t offset)
+{
+    return upump_alloc(mgr, cb, opaque, refcount, UPUMP_URING_TYPE_READ,
+                       UPUMP_URING_SIGNATURE, fd, buf, len, offset);
+}
+
+/** @This allocates and initializes a pump writing to a file descriptor.
+ * The write is submitted when the pump is started, and the buffer must
+ * remain valid until the pump triggers, is stopped or is freed.
+ *
+ * @param mgr management structure for this event loop
+ * @param cb function to call when the write has completed
+ * @param opaque pointer to the module's internal structure
+ * @param refcount pointer to urefcount structure to increment during callback,
+ * or NULL
+ * @param fd file descriptor to write to
+ * @param buf buffer to write
+ * @param len size of the buffer
+ * @param offset position in the file, or UINT64_MAX for the current position
+ * @return pointer to allocated pump, or NULL in case of failure
+ */
+static inline struct upump *upump_uring_alloc_write(struct upump_mgr *mgr,
+                                                    upump_cb cb, void *opaque,
+                                                    struct urefcount *refcount,
+                                                    int fd, const void *buf,
+                                                    size_t len, uint64_t offset)
+{
+    return upump_alloc(mgr, cb, opaque, refcount, UPUMP_URING_TYPE_WRITE,
+                       UPUMP_URING_SIGNATURE, fd, buf, len, offset);
+}
+
+/** @This returns the result of the last read or write operation.
+ *
+ * @param upump description structure of the pump
+ * @param result_p filled in with the number of octets transferred, or a
+ * negative errno value
+ * @return an error code
+ */
+static inline int upump_uring_get_result(struct upump *upump,
+                                         ssize_t *result_p)
+{
+    return upump_control(upump, UPUMP_URING_GET_RESULT,
+                         UPUMP_URING_SIGNATURE, result_p);
+}
+
+/** @This sets the buffer of the next read or write operation. It may not be
+ * called while an operation is in progress.
+ *
+ * @param upump description structure of the pump
+ * @param buf buffer to read into or to write
+ * @param len size of the buffer
+ * @param offset position in the file, or UINT64_MAX for the current position
+ * @return an error code
+ */
+static inline int upump_uring_set_buffer(struct upump *upump, void *buf,
+                                         size_t len, uint64_t offset)
+{
+    return upump_control(upump, UPUMP_URING_SET_BUFFER,
+                         UPUMP_URING_SIGNATURE, buf, len, offset);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
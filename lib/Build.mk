@@ -31,4 +31,5 @@ subdirs = \
     upipe-zvbi \
     upump-ecore \
     upump-ev \
-    upump-srt
+    upump-srt \
+    upump-uring
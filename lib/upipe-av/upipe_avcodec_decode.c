@@ -13,8 +13,11 @@
  */
 
 #include "upipe/ubase.h"
+#include "upipe/uatomic.h"
 #include "upipe/uclock.h"
 #include "upipe/ubuf.h"
+#include "upipe/ubuf_mem.h"
+#include "upipe/umem_alloc.h"
 #include "upipe/uref.h"
 #include "upipe/uref_pic.h"
 #include "upipe/uref_flow.h"
@@ -48,6 +51,7 @@
 
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
+#include <libavutil/cpu.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/opt.h>
 #include <libavutil/hwcontext.h>
@@ -64,6 +68,12 @@
 #define USE_COPY_OPAQUE
 #endif
 
+/** number of pictures kept in the direct rendering pool in addition to one
+ * per decoding thread (enough for the largest H.264/HEVC DPB) */
+#define DR_POOL_EXTRA 18
+/** maximum size of a chroma name in the direct rendering pool */
+#define DR_CHROMA_SIZE 16
+
 /** @hidden */
 static int upipe_avcdec_check(struct upipe *upipe, struct uref *flow_format);
 /** @hidden */
@@ -149,6 +159,25 @@ struct upipe_avcdec {
     /** avcodec packet */
     AVPacket *avpkt;
 
+    /** number of decoding threads, 0 for one thread per core */
+    int threads;
+    /** memory allocator of the direct rendering pool */
+    struct umem_mgr *dr_umem_mgr;
+    /** lock protecting the direct rendering pool, which is shared with the
+     * decoding threads */
+    uatomic_uint32_t dr_lock;
+    /** direct rendering pool, or NULL if not yet allocated */
+    struct ubuf_mgr *dr_ubuf_mgr;
+    /** pixel format of the direct rendering pool */
+    enum AVPixelFormat dr_pix_fmt;
+    /** picture size of the direct rendering pool, aligned as required by
+     * avcodec */
+    int dr_width_aligned, dr_height_aligned;
+    /** number of planes of the direct rendering pool */
+    uint8_t dr_planes;
+    /** chroma of the planes, in avcodec order */
+    char dr_chroma[UPIPE_AV_MAX_PLANES][DR_CHROMA_SIZE];
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -207,6 +236,211 @@ static void upipe_av_uref_pic_free(void *opaque, uint8_t *data);
  * Does not need to be reentrant.
  */
 
+/** @internal @This locks the direct rendering pool.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_avcdec_dr_lock(struct upipe *upipe)
+{
+    struct upipe_avcdec *upipe_avcdec = upipe_avcdec_from_upipe(upipe);
+    uint32_t unlocked = 0;
+    while (!uatomic_compare_exchange(&upipe_avcdec->dr_lock, &unlocked, 1))
+        unlocked = 0;
+}
+
+/** @internal @This unlocks the direct rendering pool.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_avcdec_dr_unlock(struct upipe *upipe)
+{
+    struct upipe_avcdec *upipe_avcdec = upipe_avcdec_from_upipe(upipe);
+    uatomic_store(&upipe_avcdec->dr_lock, 0);
+}
+
+/** @internal @This is called by avcodec when a directly rendered picture is
+ * released, possibly from a decoding thread.
+ *
+ * @param opaque ubuf of the picture
+ * @param data pointer to the pipe (unused)
+ */
+static void upipe_avcdec_dr_free(void *opaque, uint8_t *data)
+{
+    struct ubuf *ubuf = opaque;
+    const char *chroma = NULL;
+    while (ubase_check(ubuf_pic_plane_iterate(ubuf, &chroma)) &&
+           chroma != NULL)
+        ubuf_pic_plane_unmap(ubuf, chroma, 0, 0, -1, -1);
+    ubuf_free(ubuf);
+}
+
+/** @internal @This is called by avcodec to allocate a picture when frame
+ * threading is used. It may be called from any decoding thread, so it only
+ * uses the direct rendering pool, and falls back to the default allocator
+ * if the pool does not match the picture yet.
+ *
+ * @param context avcodec context of the decoding thread
+ * @param frame avframe to allocate
+ * @param flags avcodec flags
+ * @return 0, or a negative AVERROR code
+ */
+static int upipe_avcdec_get_buffer_dr(struct AVCodecContext *context,
+                                      AVFrame *frame, int flags)
+{
+    struct upipe *upipe = context->opaque;
+    struct upipe_avcdec *upipe_avcdec = upipe_avcdec_from_upipe(upipe);
+    struct ubuf_mgr *ubuf_mgr = NULL;
+    char chroma[UPIPE_AV_MAX_PLANES][DR_CHROMA_SIZE];
+    int width = 0, height = 0;
+    uint8_t planes = 0;
+
+    /* avcodec asks for the coded size, which may be larger than the size
+     * of the decoded pictures the pool was created from. */
+    int width_aligned = frame->width, height_aligned = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(context, &width_aligned, &height_aligned,
+                              linesize_align);
+
+    upipe_avcdec_dr_lock(upipe);
+    if (upipe_avcdec->dr_ubuf_mgr != NULL &&
+        upipe_avcdec->dr_pix_fmt == frame->format &&
+        upipe_avcdec->dr_width_aligned >= width_aligned &&
+        upipe_avcdec->dr_height_aligned >= height_aligned) {
+        ubuf_mgr = ubuf_mgr_use(upipe_avcdec->dr_ubuf_mgr);
+        width = upipe_avcdec->dr_width_aligned;
+        height = upipe_avcdec->dr_height_aligned;
+        planes = upipe_avcdec->dr_planes;
+        memcpy(chroma, upipe_avcdec->dr_chroma, sizeof (chroma));
+    }
+    upipe_avcdec_dr_unlock(upipe);
+
+    if (ubuf_mgr == NULL)
+        return avcodec_default_get_buffer2(context, frame, flags);
+
+    struct ubuf *ubuf = ubuf_pic_alloc(ubuf_mgr, width, height);
+    ubuf_mgr_release(ubuf_mgr);
+    if (unlikely(ubuf == NULL))
+        return AVERROR(ENOMEM);
+
+    for (uint8_t plane = 0; plane < planes; plane++) {
+        size_t stride = 0;
+        if (unlikely(!ubase_check(ubuf_pic_plane_write(ubuf, chroma[plane],
+                                        0, 0, -1, -1, &frame->data[plane])))) {
+            while (plane-- > 0)
+                ubuf_pic_plane_unmap(ubuf, chroma[plane], 0, 0, -1, -1);
+            ubuf_free(ubuf);
+            return AVERROR(EINVAL);
+        }
+        ubuf_pic_plane_size(ubuf, chroma[plane], &stride, NULL, NULL, NULL);
+        frame->linesize[plane] = stride;
+    }
+    for (uint8_t plane = planes; plane < AV_NUM_DATA_POINTERS; plane++) {
+        frame->data[plane] = NULL;
+        frame->linesize[plane] = 0;
+    }
+
+    /* The pipe pointer marks the buffer as directly rendered. */
+    frame->buf[0] = av_buffer_create((uint8_t *)upipe_avcdec, 0,
+                                     upipe_avcdec_dr_free, ubuf, 0);
+    if (unlikely(frame->buf[0] == NULL)) {
+        upipe_avcdec_dr_free(ubuf, NULL);
+        return AVERROR(ENOMEM);
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+/** @internal @This returns the ubuf of a directly rendered picture.
+ *
+ * @param upipe description structure of the pipe
+ * @param frame decoded avframe
+ * @return pointer to the ubuf, or NULL if the picture was not directly
+ * rendered
+ */
+static struct ubuf *upipe_avcdec_dr_ubuf(struct upipe *upipe, AVFrame *frame)
+{
+    struct upipe_avcdec *upipe_avcdec = upipe_avcdec_from_upipe(upipe);
+    if (frame->buf[0] == NULL ||
+        frame->buf[0]->data != (uint8_t *)upipe_avcdec)
+        return NULL;
+    return av_buffer_get_opaque(frame->buf[0]);
+}
+
+/** @internal @This allocates the direct rendering pool for the format of a
+ * decoded picture, so that the next pictures are rendered into it by the
+ * decoding threads.
+ *
+ * @param upipe description structure of the pipe
+ * @param frame decoded avframe
+ * @param flow_def_attr flow definition attributes of the picture
+ */
+static void upipe_avcdec_dr_prepare(struct upipe *upipe, AVFrame *frame,
+                                    struct uref *flow_def_attr)
+{
+    struct upipe_avcdec *upipe_avcdec = upipe_avcdec_from_upipe(upipe);
+    AVCodecContext *context = upipe_avcdec->context;
+
+    /* Pictures are allocated with the coded size before being cropped. */
+    int width_aligned = FFMAX(frame->width, context->coded_width);
+    int height_aligned = FFMAX(frame->height, context->coded_height);
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(context, &width_aligned, &height_aligned,
+                              linesize_align);
+
+    if (upipe_avcdec->dr_ubuf_mgr != NULL &&
+        upipe_avcdec->dr_pix_fmt == frame->format &&
+        upipe_avcdec->dr_width_aligned == width_aligned &&
+        upipe_avcdec->dr_height_aligned == height_aligned)
+        return;
+
+    uint8_t planes;
+    if (unlikely(!ubase_check(uref_pic_flow_get_planes(flow_def_attr,
+                                                       &planes)) ||
+                 planes > UPIPE_AV_MAX_PLANES))
+        return;
+
+    char chroma[UPIPE_AV_MAX_PLANES][DR_CHROMA_SIZE];
+    for (uint8_t plane = 0; plane < planes; plane++) {
+        const char *name;
+        if (unlikely(!ubase_check(uref_pic_flow_get_chroma(flow_def_attr,
+                                                           &name, plane)) ||
+                     strlen(name) >= DR_CHROMA_SIZE))
+            return;
+        strcpy(chroma[plane], name);
+    }
+
+    if (upipe_avcdec->dr_umem_mgr == NULL &&
+        unlikely((upipe_avcdec->dr_umem_mgr = umem_alloc_mgr_alloc()) == NULL))
+        return;
+
+    int threads = context->thread_count > 0 ? context->thread_count :
+                                              av_cpu_count();
+    uint16_t depth = threads + DR_POOL_EXTRA;
+    struct ubuf_mgr *ubuf_mgr =
+        ubuf_mem_mgr_alloc_from_flow_def(depth, depth,
+                                         upipe_avcdec->dr_umem_mgr,
+                                         flow_def_attr);
+    if (unlikely(ubuf_mgr == NULL)) {
+        upipe_warn(upipe, "unable to allocate direct rendering pool");
+        return;
+    }
+
+    upipe_avcdec_dr_lock(upipe);
+    struct ubuf_mgr *old_ubuf_mgr = upipe_avcdec->dr_ubuf_mgr;
+    upipe_avcdec->dr_ubuf_mgr = ubuf_mgr;
+    upipe_avcdec->dr_pix_fmt = frame->format;
+    upipe_avcdec->dr_width_aligned = width_aligned;
+    upipe_avcdec->dr_height_aligned = height_aligned;
+    upipe_avcdec->dr_planes = planes;
+    memcpy(upipe_avcdec->dr_chroma, chroma, sizeof (chroma));
+    upipe_avcdec_dr_unlock(upipe);
+    ubuf_mgr_release(old_ubuf_mgr);
+
+    upipe_notice_va(upipe, "direct rendering %s %dx%d pictures with %d threads",
+                    av_get_pix_fmt_name(frame->format), frame->width,
+                    frame->height, threads);
+}
+
 static void buffer_uref_free(void *opaque, uint8_t *data)
 {
     struct uref *uref = opaque;
@@ -429,6 +663,7 @@ static int upipe_avcdec_get_buffer_pic(struct AVCodecContext *context,
     bool use_ubuf_av = upipe_avcdec->uref == NULL ||
         frame->format == upipe_avcdec->hw_pix_fmt ||
         !(context->codec->capabilities & AV_CODEC_CAP_DR1);
+    struct ubuf *dr_ubuf = upipe_avcdec_dr_ubuf(upipe, frame);
 
     if (unlikely(upipe_avcdec->ubuf_mgr == NULL)) {
         uref_free(upipe_avcdec->flow_def_format);
@@ -452,9 +687,19 @@ static int upipe_avcdec_get_buffer_pic(struct AVCodecContext *context,
 
     flow_def_attr = uref_dup(upipe_avcdec->flow_def_provided);
 
+    /* Render the next pictures directly from the decoding threads. */
+    if (dr_ubuf == NULL &&
+        context->get_buffer2 == upipe_avcdec_get_buffer_dr &&
+        frame->format != upipe_avcdec->hw_pix_fmt && flow_def_attr != NULL)
+        upipe_avcdec_dr_prepare(upipe, frame, flow_def_attr);
+
     /* Allocate a ubuf */
     struct ubuf *ubuf;
-    if (use_ubuf_av) {
+    if (dr_ubuf != NULL) {
+        ubuf = ubuf_dup(dr_ubuf);
+        if (unlikely(ubuf == NULL))
+            goto error;
+    } else if (use_ubuf_av) {
         ubuf = ubuf_pic_av_alloc(upipe_avcdec->ubuf_mgr, frame);
         if (unlikely(ubuf == NULL)) {
             upipe_err_va(upipe, "cannot alloc ubuf for %s frame",
@@ -727,6 +972,11 @@ static int upipe_avcdec_open(struct upipe *upipe)
         case AVMEDIA_TYPE_VIDEO:
 #ifndef USE_COPY_OPAQUE
             context->get_buffer2 = upipe_avcdec_get_buffer_pic;
+#else
+            if (upipe_avcdec->threads != 1 &&
+                upipe_avcdec->hw_device_type == AV_HWDEVICE_TYPE_NONE &&
+                (context->codec->capabilities & AV_CODEC_CAP_DR1))
+                context->get_buffer2 = upipe_avcdec_get_buffer_dr;
 #endif
             if (upipe_avcdec->hw_pix_fmt != AV_PIX_FMT_NONE)
                 context->get_format = upipe_avcodec_get_format;
@@ -761,6 +1011,10 @@ static int upipe_avcdec_open(struct upipe *upipe)
 
 #ifdef USE_COPY_OPAQUE
     context->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
+    if (upipe_avcdec->threads != 1) {
+        context->thread_count = upipe_avcdec->threads;
+        context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
 #endif
 
     /* open new context */
@@ -1796,6 +2050,24 @@ static int upipe_avcdec_control(struct upipe *upipe, int command, va_list args)
             return UBASE_ERR_NONE;
         }
 
+        case UPIPE_AVCDEC_SET_THREADS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_AVCDEC_SIGNATURE)
+            int threads = va_arg(args, int);
+            struct upipe_avcdec *upipe_avcdec = upipe_avcdec_from_upipe(upipe);
+#ifndef USE_COPY_OPAQUE
+            /* buffers are allocated from the uref being decoded */
+            if (threads != 1)
+                return UBASE_ERR_UNHANDLED;
+#endif
+            if (threads < 0)
+                return UBASE_ERR_INVALID;
+            if (upipe_avcdec->context != NULL &&
+                avcodec_is_open(upipe_avcdec->context))
+                return UBASE_ERR_BUSY;
+            upipe_avcdec->threads = threads;
+            return UBASE_ERR_NONE;
+        }
+
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -1841,6 +2113,9 @@ static void upipe_avcdec_free(struct upipe *upipe)
     av_frame_free(&upipe_avcdec->frame);
     av_packet_free(&upipe_avcdec->avpkt);
     free(upipe_avcdec->hw_device);
+    ubuf_mgr_release(upipe_avcdec->dr_ubuf_mgr);
+    umem_mgr_release(upipe_avcdec->dr_umem_mgr);
+    uatomic_clean(&upipe_avcdec->dr_lock);
 
     upipe_throw_dead(upipe);
     uref_free(upipe_avcdec->uref);
@@ -1895,6 +2170,13 @@ static struct upipe *upipe_avcdec_alloc(struct upipe_mgr *mgr,
     upipe_avcdec->context = NULL;
     upipe_avcdec->frame = frame;
     upipe_avcdec->avpkt = avpkt;
+    upipe_avcdec->threads = 1;
+    upipe_avcdec->dr_umem_mgr = NULL;
+    uatomic_init(&upipe_avcdec->dr_lock, 0);
+    upipe_avcdec->dr_ubuf_mgr = NULL;
+    upipe_avcdec->dr_pix_fmt = AV_PIX_FMT_NONE;
+    upipe_avcdec->dr_width_aligned = upipe_avcdec->dr_height_aligned = 0;
+    upipe_avcdec->dr_planes = 0;
     upipe_avcdec->counter = 0;
     upipe_avcdec->pix_fmt = AV_PIX_FMT_NONE;
     upipe_avcdec->sample_fmt = AV_SAMPLE_FMT_NONE;
@@ -15,6 +15,7 @@
 #define _UPIPE_QUEUE_H_
 
 #include "upipe/ubase.h"
+#include "upipe/uatomic.h"
 #include "upipe/uqueue.h"
 #include "upipe/upipe.h"
 #include "upipe-modules/upipe_queue_source.h"
@@ -25,6 +26,9 @@
 struct upipe_queue {
     /** max length of the queue */
     unsigned int max_length;
+    /** max number of urefs output by the source per wake-up, set by the
+     * sink */
+    uatomic_uint32_t batch;
     /** uref queue */
     struct uqueue uqueue;
     /** out of band downstream queue */
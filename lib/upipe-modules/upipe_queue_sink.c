@@ -38,6 +38,8 @@ static bool upipe_qsink_output(struct upipe *upipe, struct uref *uref,
                                struct upump **upump_p);
 /** @hidden */
 static void upipe_qsink_oob(struct upump *upump);
+/** @hidden */
+static void upipe_qsink_batch_timer(struct upump *upump);
 
 /** @This is the private context of a queue sink pipe. */
 struct upipe_qsink {
@@ -50,6 +52,8 @@ struct upipe_qsink {
     struct upump *upump;
     /** oob watcher */
     struct upump *upump_oob;
+    /** batch timer */
+    struct upump *upump_batch;
 
     /** pseudo-output */
     struct upipe *output;
@@ -71,6 +75,15 @@ struct upipe_qsink {
     /** list of blockers */
     struct uchain blockers;
 
+    /** maximum number of urefs in a batch (0 or 1 if disabled) */
+    unsigned int batch;
+    /** maximum time a uref may wait in a pending batch */
+    uint64_t batch_timeout;
+    /** urefs of the pending batch */
+    void **batch_urefs;
+    /** number of urefs in the pending batch */
+    unsigned int nb_batch_urefs;
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -80,6 +93,7 @@ UPIPE_HELPER_UREFCOUNT(upipe_qsink, urefcount, upipe_qsink_free)
 UPIPE_HELPER_UPUMP_MGR(upipe_qsink, upump_mgr)
 UPIPE_HELPER_UPUMP(upipe_qsink, upump, upump_mgr)
 UPIPE_HELPER_UPUMP(upipe_qsink, upump_oob, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_qsink, upump_batch, upump_mgr)
 UPIPE_HELPER_INPUT(upipe_qsink, urefs, nb_urefs, max_urefs, blockers, upipe_qsink_output)
 
 /** @internal @This allocates a queue sink pipe.
@@ -110,11 +124,16 @@ static struct upipe *_upipe_qsink_alloc(struct upipe_mgr *mgr,
     upipe_qsink_init_upump_mgr(upipe);
     upipe_qsink_init_upump(upipe);
     upipe_qsink_init_upump_oob(upipe);
+    upipe_qsink_init_upump_batch(upipe);
     upipe_qsink_init_input(upipe);
     upipe_qsink->qsrc = upipe_use(qsrc);
     upipe_qsink->flow_def = NULL;
     upipe_qsink->flow_def_sent = false;
     upipe_qsink->output = NULL;
+    upipe_qsink->batch = 0;
+    upipe_qsink->batch_timeout = 0;
+    upipe_qsink->batch_urefs = NULL;
+    upipe_qsink->nb_batch_urefs = 0;
     ulist_init(&upipe_qsink->request_list);
 
     upipe_throw_ready(upipe);
@@ -188,6 +207,96 @@ static bool upipe_qsink_check_watcher(struct upipe *upipe)
     return true;
 }
 
+/** @internal @This holds a uref that couldn't be queued, and waits for the
+ * queue to be writable again.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_qsink_stall(struct upipe *upipe, struct uref *uref,
+                              struct upump **upump_p)
+{
+    struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
+    if (!upipe_qsink_check_watcher(upipe)) {
+        upipe_warn(upipe, "unable to spool uref");
+        uref_free(uref);
+        return;
+    }
+    upump_start(upipe_qsink->upump);
+    upipe_qsink_hold_input(upipe, uref);
+    upipe_qsink_block_input(upipe, upump_p);
+    /* Increment upipe refcount to avoid disappearing before all packets
+     * have been sent. */
+    upipe_use(upipe);
+    upipe_throw_stalled(upipe);
+}
+
+/** @internal @This pushes the pending batch to the queue, waking up the
+ * queue source once. The urefs that do not fit in the queue are held until
+ * it can be written again.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_qsink_flush_batch(struct upipe *upipe,
+                                    struct upump **upump_p)
+{
+    struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
+    upipe_qsink_set_upump_batch(upipe, NULL);
+    unsigned int nb_urefs = upipe_qsink->nb_batch_urefs;
+    if (!nb_urefs)
+        return;
+    upipe_qsink->nb_batch_urefs = 0;
+
+    struct uqueue *uqueue = &upipe_queue(upipe_qsink->qsrc)->uqueue;
+    void **urefs = upipe_qsink->batch_urefs;
+    unsigned int i = uqueue_push_batch(uqueue, urefs, nb_urefs);
+    if (i < nb_urefs)
+        upipe_qsink_stall(upipe, uref_from_uchain(urefs[i++]), upump_p);
+    for ( ; i < nb_urefs; i++) {
+        upipe_qsink_hold_input(upipe, uref_from_uchain(urefs[i]));
+        upipe_qsink_block_input(upipe, upump_p);
+    }
+}
+
+/** @internal @This is called when the first uref of the pending batch has
+ * waited long enough.
+ *
+ * @param upump description structure of the timer
+ */
+static void upipe_qsink_batch_timer(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    upipe_qsink_flush_batch(upipe, NULL);
+}
+
+/** @internal @This adds a uref to the pending batch, and publishes the batch
+ * if it is full.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_qsink_add_batch(struct upipe *upipe, struct uref *uref,
+                                  struct upump **upump_p)
+{
+    struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
+    upipe_qsink->batch_urefs[upipe_qsink->nb_batch_urefs++] =
+        uref_to_uchain(uref);
+    if (upipe_qsink->nb_batch_urefs >= upipe_qsink->batch) {
+        upipe_qsink_flush_batch(upipe, upump_p);
+        return;
+    }
+
+    if (upipe_qsink->nb_batch_urefs == 1 && upipe_qsink->batch_timeout) {
+        upipe_qsink_check_upump_mgr(upipe);
+        if (likely(upipe_qsink->upump_mgr != NULL))
+            upipe_qsink_wait_upump_batch(upipe, upipe_qsink->batch_timeout,
+                                         upipe_qsink_batch_timer);
+    }
+}
+
 /** @internal @This receives data.
  *
  * @param upipe description structure of the pipe
@@ -211,20 +320,10 @@ static void upipe_qsink_input(struct upipe *upipe, struct uref *uref,
     if (!upipe_qsink_check_input(upipe)) {
         upipe_qsink_hold_input(upipe, uref);
         upipe_qsink_block_input(upipe, upump_p);
-    } else if (!upipe_qsink_output(upipe, uref, upump_p)) {
-        if (!upipe_qsink_check_watcher(upipe)) {
-            upipe_warn(upipe, "unable to spool uref");
-            uref_free(uref);
-            return;
-        }
-        upump_start(upipe_qsink->upump);
-        upipe_qsink_hold_input(upipe, uref);
-        upipe_qsink_block_input(upipe, upump_p);
-        /* Increment upipe refcount to avoid disappearing before all packets
-         * have been sent. */
-        upipe_use(upipe);
-        upipe_throw_stalled(upipe);
-    }
+    } else if (upipe_qsink->batch > 1)
+        upipe_qsink_add_batch(upipe, uref, upump_p);
+    else if (!upipe_qsink_output(upipe, uref, upump_p))
+        upipe_qsink_stall(upipe, uref, upump_p);
 }
 
 /** @internal @This returns a pointer to the current pseudo-output.
@@ -284,6 +383,58 @@ static int upipe_qsink_set_flow_def(struct upipe *upipe, struct uref *uref)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This returns the batch parameters.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_p filled in with the maximum number of urefs in a batch
+ * @param timeout_p filled in with the maximum waiting time in a batch
+ * @return an error code
+ */
+static int _upipe_qsink_get_batch(struct upipe *upipe, unsigned int *batch_p,
+                                  uint64_t *timeout_p)
+{
+    struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
+    if (batch_p != NULL)
+        *batch_p = upipe_qsink->batch;
+    if (timeout_p != NULL)
+        *timeout_p = upipe_qsink->batch_timeout;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the batch parameters. The pending batch, if any, is
+ * published first.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch maximum number of urefs in a batch (0 or 1 to disable)
+ * @param timeout maximum waiting time in a batch (0 for none)
+ * @return an error code
+ */
+static int _upipe_qsink_set_batch(struct upipe *upipe, unsigned int batch,
+                                  uint64_t timeout)
+{
+    struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
+    if (unlikely(batch > UPIPE_QSINK_MAX_BATCH))
+        return UBASE_ERR_INVALID;
+    upipe_qsink_flush_batch(upipe, NULL);
+
+    if (batch > 1 && batch != upipe_qsink->batch) {
+        void **urefs = realloc(upipe_qsink->batch_urefs,
+                               batch * sizeof(void *));
+        UBASE_ALLOC_RETURN(urefs);
+        upipe_qsink->batch_urefs = urefs;
+    } else if (batch <= 1) {
+        free(upipe_qsink->batch_urefs);
+        upipe_qsink->batch_urefs = NULL;
+    }
+    upipe_qsink->batch = batch;
+    upipe_qsink->batch_timeout = timeout;
+    if (batch < 1)
+        batch = 1;
+    uatomic_store(&upipe_queue(upipe_qsink->qsrc)->batch, batch);
+    upipe_dbg_va(upipe, "using batches of %u urefs", batch);
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This flushes all currently held buffers, and unblocks the
  * sources.
  *
@@ -292,8 +443,13 @@ static int upipe_qsink_set_flow_def(struct upipe *upipe, struct uref *uref)
  */
 static int upipe_qsink_flush(struct upipe *upipe)
 {
+    struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
+    upipe_qsink_set_upump_batch(upipe, NULL);
+    for (unsigned int i = 0; i < upipe_qsink->nb_batch_urefs; i++)
+        uref_free(uref_from_uchain(upipe_qsink->batch_urefs[i]));
+    upipe_qsink->nb_batch_urefs = 0;
+
     if (upipe_qsink_flush_input(upipe)) {
-        struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
         upump_stop(upipe_qsink->upump);
         /* All packets have been output, release again the pipe that has been
          * used in @ref upipe_qsink_input. */
@@ -472,6 +628,7 @@ static int _upipe_qsink_control(struct upipe *upipe, int command, va_list args)
             return upipe_qsink_unregister_request(upipe, request);
         }
         case UPIPE_ATTACH_UPUMP_MGR:
+            upipe_qsink_flush_batch(upipe, NULL);
             upipe_qsink_set_upump(upipe, NULL);
             return upipe_qsink_attach_upump_mgr(upipe);
         case UPIPE_GET_OUTPUT: {
@@ -498,6 +655,19 @@ static int _upipe_qsink_control(struct upipe *upipe, int command, va_list args)
 
         case UPIPE_FLUSH:
             return upipe_qsink_flush(upipe);
+
+        case UPIPE_QSINK_GET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_QSINK_SIGNATURE)
+            unsigned int *batch_p = va_arg(args, unsigned int *);
+            uint64_t *timeout_p = va_arg(args, uint64_t *);
+            return _upipe_qsink_get_batch(upipe, batch_p, timeout_p);
+        }
+        case UPIPE_QSINK_SET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_QSINK_SIGNATURE)
+            unsigned int batch = va_arg(args, unsigned int);
+            uint64_t timeout = va_arg(args, uint64_t);
+            return _upipe_qsink_set_batch(upipe, batch, timeout);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -532,6 +702,18 @@ static void upipe_qsink_free(struct upipe *upipe)
 {
     struct upipe_qsink *upipe_qsink = upipe_qsink_from_upipe(upipe);
 
+    /* publish the pending batch */
+    upipe_qsink_set_upump_batch(upipe, NULL);
+    unsigned int i = uqueue_push_batch(&upipe_queue(upipe_qsink->qsrc)->uqueue,
+                                       upipe_qsink->batch_urefs,
+                                       upipe_qsink->nb_batch_urefs);
+    if (unlikely(i < upipe_qsink->nb_batch_urefs))
+        upipe_warn_va(upipe, "dropping %u urefs",
+                      upipe_qsink->nb_batch_urefs - i);
+    for ( ; i < upipe_qsink->nb_batch_urefs; i++)
+        uref_free(uref_from_uchain(upipe_qsink->batch_urefs[i]));
+    free(upipe_qsink->batch_urefs);
+
     /* play source end */
     upipe_dbg_va(upipe, "ending queue source %p", upipe_qsink->qsrc);
     upipe_qsink_push_downstream(upipe, UPIPE_QUEUE_DOWNSTREAM_SOURCE_END, NULL);
@@ -543,6 +725,7 @@ static void upipe_qsink_free(struct upipe *upipe)
     uref_free(upipe_qsink->flow_def);
     upipe_qsink_clean_upump(upipe);
     upipe_qsink_clean_upump_oob(upipe);
+    upipe_qsink_clean_upump_batch(upipe);
     upipe_qsink_clean_upump_mgr(upipe);
     upipe_qsink_clean_input(upipe);
     upipe_qsink_clean_urefcount(upipe);
@@ -11,7 +11,7 @@
  *
  * Note that the allocator requires an additional parameter:
  * @table 2
- * @item queue_length @item maximum length of the queue (<= 255)
+ * @item queue_length @item maximum length of the queue (<= 2^31)
  * @end table
  *
  * Also note that this module is exceptional in that upipe_release() may be
@@ -95,7 +95,7 @@ static struct upipe *_upipe_qsrc_alloc(struct upipe_mgr *mgr,
     if (signature != UPIPE_QSRC_SIGNATURE)
         goto upipe_qsrc_alloc_err;
     unsigned int length = va_arg(args, unsigned int);
-    if (!length || length > UINT8_MAX)
+    if (!length || length > UQUEUE_MAX_LENGTH)
         goto upipe_qsrc_alloc_err;
 
     struct upipe_qsrc *upipe_qsrc = malloc(sizeof(struct upipe_qsrc) +
@@ -125,6 +125,7 @@ static struct upipe *_upipe_qsrc_alloc(struct upipe_mgr *mgr,
     upipe_qsrc_init_upump(upipe);
     upipe_qsrc_init_upump_oob(upipe);
     upipe_qsrc->upipe_queue.max_length = length;
+    uatomic_init(&upipe_qsrc->upipe_queue.batch, 1);
     upipe_throw_ready(upipe);
 
     return upipe;
@@ -152,7 +153,8 @@ static void upipe_qsrc_input(struct upipe *upipe, struct uref *uref,
     upipe_qsrc_output(upipe, uref, upump_p);
 }
 
-/** @internal @This reads data from the queue and outputs it.
+/** @internal @This reads data from the queue and outputs it. In batch
+ * mode, all the urefs of a batch are output in a single call.
  *
  * @param upump description structure of the read watcher
  */
@@ -160,9 +162,20 @@ static void upipe_qsrc_worker(struct upump *upump)
 {
     struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
     struct upipe_qsrc *upipe_qsrc = upipe_qsrc_from_upipe(upipe);
-    struct uref *uref = uqueue_pop(&upipe_queue(upipe)->uqueue, struct uref *);
-    if (likely(uref != NULL))
-        upipe_qsrc_input(upipe, uref, &upipe_qsrc->upump);
+    unsigned int batch = uatomic_load(&upipe_queue(upipe)->batch);
+    if (likely(batch <= 1)) {
+        struct uref *uref = uqueue_pop(&upipe_queue(upipe)->uqueue,
+                                       struct uref *);
+        if (likely(uref != NULL))
+            upipe_qsrc_input(upipe, uref, &upipe_qsrc->upump);
+        return;
+    }
+
+    void *urefs[batch];
+    unsigned int nb_urefs = uqueue_pop_batch(&upipe_queue(upipe)->uqueue,
+                                             urefs, batch);
+    for (unsigned int i = 0; i < nb_urefs; i++)
+        upipe_qsrc_input(upipe, urefs[i], &upipe_qsrc->upump);
 }
 
 /** @internal @This handles the result of a request.
@@ -293,6 +306,7 @@ static void upipe_qsrc_free(struct upipe *upipe)
     uqueue_clean(&upipe_queue(upipe)->uqueue);
     uqueue_clean(&upipe_queue(upipe)->downstream_oob);
     uqueue_clean(&upipe_queue(upipe)->upstream_oob);
+    uatomic_clean(&upipe_queue(upipe)->batch);
 
     upipe_qsrc_clean_urefcount_real(upipe);
     upipe_qsrc_clean_urefcount(upipe);
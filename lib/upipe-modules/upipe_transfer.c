@@ -13,6 +13,7 @@
 
 #include "upipe/ubase.h"
 #include "upipe/urefcount.h"
+#include "upipe/ulist.h"
 #include "upipe/umutex.h"
 #include "upipe/ulifo.h"
 #include "upipe/uqueue.h"
@@ -47,11 +48,15 @@ struct upipe_xfer_mgr {
     /** remote upump_mgr */
     struct upump_mgr *upump_mgr;
     /** queue length */
-    uint8_t queue_length;
+    uint32_t queue_length;
     /** queue of messages */
     struct uqueue uqueue;
     /** pool of @ref upipe_xfer_msg */
     struct ulifo msg_pool;
+    /** message grouping the messages of the current batch, or NULL */
+    struct upipe_xfer_msg *batch;
+    /** number of nested batches */
+    unsigned int batch_depth;
     /** extra data for the queue and pool structures */
     uint8_t extra[];
 };
@@ -70,6 +75,8 @@ enum upipe_xfer_msg_type {
     UPIPE_XFER_SET_OUTPUT,
     /** release pipe */
     UPIPE_XFER_RELEASE,
+    /** list of messages */
+    UPIPE_XFER_BATCH,
     /** detach from remote upump_mgr */
     UPIPE_XFER_DETACH
     /* values from @ref uprobe_xfer_event are also allowed (backwards) */
@@ -503,6 +510,46 @@ static void upipe_xfer_mgr_free(struct upipe_mgr *mgr)
     free(xfer_mgr);
 }
 
+/** @This processes a message in the remote upump manager.
+ *
+ * @param mgr xfer_mgr structure
+ * @param msg message to process
+ */
+static void upipe_xfer_mgr_process(struct upipe_mgr *mgr,
+                                   struct upipe_xfer_msg *msg)
+{
+    switch (msg->type) {
+        case UPIPE_XFER_ATTACH_UPUMP_MGR:
+            upipe_attach_upump_mgr(msg->upipe_remote);
+            break;
+        case UPIPE_XFER_SET_URI:
+            upipe_set_uri(msg->upipe_remote, msg->arg.string);
+            free(msg->arg.string);
+            break;
+        case UPIPE_XFER_SET_OUTPUT:
+            upipe_set_output(msg->upipe_remote, msg->arg.pipe);
+            upipe_release(msg->arg.pipe);
+            break;
+        case UPIPE_XFER_RELEASE:
+            upipe_release(msg->upipe_remote);
+            break;
+        case UPIPE_XFER_BATCH: {
+            struct uchain *uchain, *uchain_tmp;
+            ulist_delete_foreach (&msg->uchain, uchain, uchain_tmp) {
+                ulist_delete(uchain);
+                upipe_xfer_mgr_process(mgr,
+                                       upipe_xfer_msg_from_uchain(uchain));
+            }
+            break;
+        }
+        default:
+            /* this should not happen */
+            break;
+    }
+
+    upipe_xfer_msg_free(mgr, msg);
+}
+
 /** @This is called by the remote upump manager to receive messages.
  *
  * @param upump description structure of the read watcher
@@ -514,31 +561,12 @@ static void upipe_xfer_mgr_worker(struct upump *upump)
     struct upipe_xfer_msg *msg;
     while ((msg = uqueue_pop(&xfer_mgr->uqueue,
                              struct upipe_xfer_msg *)) != NULL) {
-        switch (msg->type) {
-            case UPIPE_XFER_ATTACH_UPUMP_MGR:
-                upipe_attach_upump_mgr(msg->upipe_remote);
-                break;
-            case UPIPE_XFER_SET_URI:
-                upipe_set_uri(msg->upipe_remote, msg->arg.string);
-                free(msg->arg.string);
-                break;
-            case UPIPE_XFER_SET_OUTPUT:
-                upipe_set_output(msg->upipe_remote, msg->arg.pipe);
-                upipe_release(msg->arg.pipe);
-                break;
-            case UPIPE_XFER_RELEASE:
-                upipe_release(msg->upipe_remote);
-                break;
-            case UPIPE_XFER_DETACH:
-                upipe_xfer_msg_free(mgr, msg);
-                upipe_xfer_mgr_free(mgr);
-                return;
-            default:
-                /* this should not happen */
-                break;
+        if (msg->type == UPIPE_XFER_DETACH) {
+            upipe_xfer_msg_free(mgr, msg);
+            upipe_xfer_mgr_free(mgr);
+            return;
         }
-
-        upipe_xfer_msg_free(mgr, msg);
+        upipe_xfer_mgr_process(mgr, msg);
     }
 }
 
@@ -547,7 +575,7 @@ static void upipe_xfer_mgr_worker(struct upump *upump)
  * @param mgr xfer_mgr structure
  * @param type type of message
  * @param upipe_remote optional remote pipe
- * @paral arg optional argument
+ * @param arg optional argument
  * @return an error code
  */
 static int upipe_xfer_mgr_send(struct upipe_mgr *mgr, int type,
@@ -563,6 +591,13 @@ static int upipe_xfer_mgr_send(struct upipe_mgr *mgr, int type,
     msg->upipe_remote = upipe_remote;
     msg->arg = arg;
 
+    if (xfer_mgr->batch != NULL) {
+        /* the batch holds a reference so this cannot be a detach */
+        assert(type != UPIPE_XFER_DETACH);
+        ulist_add(&xfer_mgr->batch->uchain, upipe_xfer_msg_to_uchain(msg));
+        return UBASE_ERR_NONE;
+    }
+
     if (unlikely(!uqueue_push(&xfer_mgr->uqueue, msg))) {
         upipe_xfer_msg_free(mgr, msg);
         return UBASE_ERR_EXTERNAL;
@@ -650,6 +685,56 @@ static inline int _upipe_xfer_mgr_thaw(struct upipe_mgr *mgr)
     return err;
 }
 
+/** @This starts grouping the messages sent to the remote upump manager.
+ *
+ * @param mgr xfer_mgr structure
+ * @return an error code
+ */
+static int _upipe_xfer_mgr_batch_begin(struct upipe_mgr *mgr)
+{
+    struct upipe_xfer_mgr *xfer_mgr = upipe_xfer_mgr_from_upipe_mgr(mgr);
+    if (xfer_mgr->batch == NULL) {
+        struct upipe_xfer_msg *msg = upipe_xfer_msg_alloc(mgr);
+        if (unlikely(msg == NULL))
+            return UBASE_ERR_ALLOC;
+        msg->type = UPIPE_XFER_BATCH;
+        msg->upipe_remote = NULL;
+        ulist_init(&msg->uchain);
+        xfer_mgr->batch = msg;
+        upipe_mgr_use(mgr);
+    }
+    xfer_mgr->batch_depth++;
+    return UBASE_ERR_NONE;
+}
+
+/** @This sends the messages grouped since the outermost call to
+ * @ref _upipe_xfer_mgr_batch_begin.
+ *
+ * @param mgr xfer_mgr structure
+ * @return an error code
+ */
+static int _upipe_xfer_mgr_batch_end(struct upipe_mgr *mgr)
+{
+    struct upipe_xfer_mgr *xfer_mgr = upipe_xfer_mgr_from_upipe_mgr(mgr);
+    if (unlikely(xfer_mgr->batch == NULL))
+        return UBASE_ERR_INVALID;
+    if (--xfer_mgr->batch_depth)
+        return UBASE_ERR_NONE;
+
+    struct upipe_xfer_msg *msg = xfer_mgr->batch;
+    if (ulist_empty(&msg->uchain))
+        upipe_xfer_msg_free(mgr, msg);
+    else if (unlikely(!uqueue_push(&xfer_mgr->uqueue, msg))) {
+        /* keep the batch open so that the caller may retry */
+        xfer_mgr->batch_depth = 1;
+        return UBASE_ERR_EXTERNAL;
+    }
+
+    xfer_mgr->batch = NULL;
+    upipe_mgr_release(mgr);
+    return UBASE_ERR_NONE;
+}
+
 /** @This processes manager control commands.
  *
  * @param mgr xfer_mgr structure
@@ -674,6 +759,14 @@ static int upipe_xfer_mgr_control(struct upipe_mgr *mgr,
             UBASE_SIGNATURE_CHECK(args, UPIPE_XFER_SIGNATURE)
             return _upipe_xfer_mgr_thaw(mgr);
         }
+        case UPIPE_XFER_MGR_BATCH_BEGIN: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_XFER_SIGNATURE)
+            return _upipe_xfer_mgr_batch_begin(mgr);
+        }
+        case UPIPE_XFER_MGR_BATCH_END: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_XFER_SIGNATURE)
+            return _upipe_xfer_mgr_batch_end(mgr);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -689,7 +782,7 @@ static int upipe_xfer_mgr_control(struct upipe_mgr *mgr,
  * @param mutex mutual exclusion primitives to access the event loop, or NULL
  * @return pointer to manager
  */
-struct upipe_mgr *upipe_xfer_mgr_alloc(uint8_t queue_length,
+struct upipe_mgr *upipe_xfer_mgr_alloc(uint32_t queue_length,
                                        uint16_t msg_pool_depth,
                                        struct umutex *mutex)
 {
@@ -710,6 +803,8 @@ struct upipe_mgr *upipe_xfer_mgr_alloc(uint8_t queue_length,
     xfer_mgr->upump = NULL;
     xfer_mgr->upump_mgr = NULL;
     xfer_mgr->queue_length = queue_length;
+    xfer_mgr->batch = NULL;
+    xfer_mgr->batch_depth = 0;
     ulifo_init(&xfer_mgr->msg_pool, msg_pool_depth,
                xfer_mgr->extra + uqueue_sizeof(queue_length));
 
@@ -11,6 +11,9 @@
  * @short Upipe sink module for udp
  */
 
+#define _GNU_SOURCE
+
+#include "config.h"
 #include "upipe/ubase.h"
 #include "upipe/uclock.h"
 #include "upipe/uref.h"
@@ -35,8 +38,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
+
+#ifdef HAVE_TXTIME
+#include <linux/net_tstamp.h>
+#endif
 
 /** tolerance for late packets */
 #define SYSTIME_TOLERANCE UCLOCK_FREQ
@@ -48,6 +59,30 @@
 #define UDP_DEFAULT_TTL 0
 #define UDP_DEFAULT_PORT 1234
 
+/** maximum number of datagrams written by a single sendmmsg() call */
+#define UDP_MAX_BATCH 1024
+/** maximum number of segments in a GSO datagram */
+#define UDP_MAX_GSO_SEGMENTS 64
+/** maximum payload of a GSO datagram */
+#define UDP_MAX_GSO_SIZE 65507
+
+#ifdef HAVE_SENDMMSG
+/** size of the ancillary data of a batched message */
+#define UDP_MMSG_CONTROL_SIZE \
+    (CMSG_SPACE(sizeof(uint16_t)) + CMSG_SPACE(sizeof(uint64_t)))
+
+/** @internal @This stores the per-message buffers of the batch mode. */
+struct upipe_udpsink_mmsg {
+    /** RAW header */
+    uint8_t raw_header[RAW_HEADER_SIZE];
+    /** ancillary data */
+    union {
+        struct cmsghdr cmsghdr;
+        char buf[UDP_MMSG_CONTROL_SIZE];
+    } control;
+};
+#endif
+
 /** @hidden */
 static void upipe_udpsink_watcher(struct upump *upump);
 /** @hidden */
@@ -94,6 +129,26 @@ struct upipe_udpsink {
     /** destination for not-connected socket (size) */
     socklen_t addrlen;
 
+    /** kernel clock used for transmit times */
+    int txtime_clockid;
+    /** maximum advance of buffers handed to the kernel (0 if disabled) */
+    uint64_t txtime_horizon;
+    /** kernel clock in nanoseconds, sampled at the same time as uclock */
+    uint64_t txtime_ref;
+
+    /** requested batch depth (0 or 1 if disabled) */
+    unsigned int batch;
+#ifdef HAVE_SENDMMSG
+    /** true if UDP generic segmentation offload may be used */
+    bool gso;
+    /** sendmmsg() message headers */
+    struct mmsghdr *mmsgs;
+    /** per-message buffers */
+    struct upipe_udpsink_mmsg *mmsg_bufs;
+    /** urefs of the batch being written */
+    struct uref **mmsg_urefs;
+#endif
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -134,6 +189,20 @@ static struct upipe *upipe_udpsink_alloc(struct upipe_mgr *mgr,
     upipe_udpsink->uri = NULL;
     upipe_udpsink->raw = false;
     upipe_udpsink->addrlen = 0;
+#ifdef HAVE_TXTIME
+    upipe_udpsink->txtime_clockid = CLOCK_TAI;
+#else
+    upipe_udpsink->txtime_clockid = -1;
+#endif
+    upipe_udpsink->txtime_horizon = 0;
+    upipe_udpsink->txtime_ref = 0;
+    upipe_udpsink->batch = 0;
+#ifdef HAVE_SENDMMSG
+    upipe_udpsink->gso = true;
+    upipe_udpsink->mmsgs = NULL;
+    upipe_udpsink->mmsg_bufs = NULL;
+    upipe_udpsink->mmsg_urefs = NULL;
+#endif
     upipe_throw_ready(upipe);
     return upipe;
 }
@@ -161,6 +230,278 @@ static void upipe_udpsink_poll(struct upipe *upipe)
     }
 }
 
+#ifdef HAVE_TXTIME
+/** @internal @This converts a date to the transmit time of the kernel clock.
+ *
+ * @param upipe description structure of the pipe
+ * @param systime date of the buffer, latency included
+ * @param now current date, sampled with @ref txtime_ref
+ * @return transmit time in nanoseconds
+ */
+static uint64_t upipe_udpsink_txtime(struct upipe *upipe, uint64_t systime,
+                                     uint64_t now)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+    int64_t delay = (int64_t)(systime - now);
+    return upipe_udpsink->txtime_ref +
+        delay * INT64_C(1000000000) / (int64_t)UCLOCK_FREQ;
+}
+
+/** @internal @This fills in a SCM_TXTIME control message.
+ *
+ * @param cmsghdr control message header
+ * @param txtime transmit time in nanoseconds
+ * @return the space used by the control message
+ */
+static size_t upipe_udpsink_set_cmsg_txtime(struct cmsghdr *cmsghdr,
+                                            uint64_t txtime)
+{
+    cmsghdr->cmsg_level = SOL_SOCKET;
+    cmsghdr->cmsg_type = SCM_TXTIME;
+    cmsghdr->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+    memcpy(CMSG_DATA(cmsghdr), &txtime, sizeof(uint64_t));
+    return CMSG_SPACE(sizeof(uint64_t));
+}
+#endif
+
+/** @internal @This returns the current date, and samples the kernel clock
+ * if kernel pacing is enabled.
+ *
+ * @param upipe description structure of the pipe
+ * @return current date
+ */
+static uint64_t upipe_udpsink_sample_now(struct upipe *upipe)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+    uint64_t now = uclock_now(upipe_udpsink->uclock);
+#ifdef HAVE_TXTIME
+    struct timespec ts;
+    if (upipe_udpsink->txtime_horizon &&
+        likely(clock_gettime(upipe_udpsink->txtime_clockid, &ts) != -1))
+        upipe_udpsink->txtime_ref =
+            ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+#endif
+    return now;
+}
+
+#ifdef HAVE_SENDMMSG
+/** @internal @This checks if a held buffer may be written in the same batch
+ * as the buffer being output.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param now current date, if the pipe is in live mode
+ * @param systime_p filled in with the date of the buffer, latency included,
+ * or UINT64_MAX if not in live mode
+ * @return true if the buffer is due
+ */
+static bool upipe_udpsink_mmsg_due(struct upipe *upipe, struct uref *uref,
+                                   uint64_t now, uint64_t *systime_p)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+    const char *def;
+    *systime_p = UINT64_MAX;
+    if (unlikely(ubase_check(uref_flow_get_def(uref, &def))))
+        return false;
+    if (likely(upipe_udpsink->uclock == NULL))
+        return true;
+
+    /* let the normal path handle non-dated and late buffers */
+    uint64_t systime;
+    if (unlikely(!ubase_check(uref_clock_get_cr_sys(uref, &systime))))
+        return false;
+    systime += upipe_udpsink->latency;
+    *systime_p = systime;
+    return systime <= now + upipe_udpsink->txtime_horizon &&
+           now <= systime + SYSTIME_PRINT;
+}
+
+/** @internal @This outputs a buffer, and all the following held buffers
+ * that are due, with a single sendmmsg() call.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param now current date, if the pipe is in live mode
+ * @param systime date of the buffer, latency included, or UINT64_MAX
+ * @return true if the uref was processed
+ */
+static bool upipe_udpsink_output_mmsg(struct upipe *upipe, struct uref *uref,
+                                      uint64_t now, uint64_t systime)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+    struct uref **urefs = upipe_udpsink->mmsg_urefs;
+    uint64_t systimes[upipe_udpsink->batch];
+    unsigned int nb_urefs = 0;
+    systimes[nb_urefs] = systime;
+    urefs[nb_urefs++] = uref;
+
+    struct uchain *uchain;
+    ulist_foreach (&upipe_udpsink->urefs, uchain) {
+        if (nb_urefs >= upipe_udpsink->batch)
+            break;
+        struct uref *next = uref_from_uchain(uchain);
+        if (!upipe_udpsink_mmsg_due(upipe, next, now, &systimes[nb_urefs]))
+            break;
+        urefs[nb_urefs++] = next;
+    }
+
+    size_t sizes[nb_urefs];
+    int iovec_counts[nb_urefs];
+    int nb_iovecs = 0;
+    for (unsigned int i = 0; i < nb_urefs; i++) {
+        iovec_counts[i] = uref_block_iovec_count(urefs[i], 0, -1);
+        if (unlikely(iovec_counts[i] <= 0 ||
+                     !ubase_check(uref_block_size(urefs[i], &sizes[i])))) {
+            if (i > 0) {
+                /* will be handled by the next call */
+                nb_urefs = i;
+                break;
+            }
+            if (iovec_counts[i] != 0)
+                upipe_warn(upipe, "cannot read ubuf buffer");
+            uref_free(uref);
+            return true;
+        }
+        nb_iovecs += iovec_counts[i];
+    }
+
+    struct iovec payloads[nb_iovecs];
+    nb_iovecs = 0;
+    for (unsigned int i = 0; i < nb_urefs; i++) {
+        if (unlikely(!ubase_check(uref_block_iovec_read(urefs[i], 0, -1,
+                                                        payloads + nb_iovecs)))) {
+            if (i > 0) {
+                nb_urefs = i;
+                break;
+            }
+            upipe_warn(upipe, "cannot read ubuf buffer");
+            uref_free(uref);
+            return true;
+        }
+        nb_iovecs += iovec_counts[i];
+    }
+
+    /* build the messages, coalescing datagrams of the same size unless they
+     * are paced by the kernel */
+    struct iovec iovecs[nb_iovecs + nb_urefs];
+    unsigned int segments[nb_urefs];
+    unsigned int nb_msgs = 0;
+    struct iovec *iovec = iovecs;
+    struct iovec *payload = payloads;
+    bool gso = false;
+    for (unsigned int i = 0; i < nb_urefs; nb_msgs++) {
+        struct mmsghdr *mmsg = &upipe_udpsink->mmsgs[nb_msgs];
+        struct upipe_udpsink_mmsg *buf = &upipe_udpsink->mmsg_bufs[nb_msgs];
+        struct msghdr *msghdr = &mmsg->msg_hdr;
+        msghdr->msg_name = upipe_udpsink->addrlen ? &upipe_udpsink->addr : NULL;
+        msghdr->msg_namelen = upipe_udpsink->addrlen;
+        msghdr->msg_iov = iovec;
+        msghdr->msg_control = NULL;
+        msghdr->msg_controllen = 0;
+        msghdr->msg_flags = 0;
+        mmsg->msg_len = 0;
+
+        if (upipe_udpsink->raw) {
+            memcpy(buf->raw_header, upipe_udpsink->raw_header,
+                   RAW_HEADER_SIZE);
+            udp_raw_set_len(buf->raw_header, sizes[i]);
+            iovec->iov_base = buf->raw_header;
+            iovec->iov_len = RAW_HEADER_SIZE;
+            iovec++;
+        }
+
+        unsigned int first = i;
+        size_t total = 0;
+        do {
+            memcpy(iovec, payload, iovec_counts[i] * sizeof(struct iovec));
+            iovec += iovec_counts[i];
+            payload += iovec_counts[i];
+            total += sizes[i];
+            i++;
+        } while (upipe_udpsink->gso && !upipe_udpsink->raw &&
+                 !upipe_udpsink->txtime_horizon && i < nb_urefs &&
+                 sizes[i] == sizes[first] &&
+                 i - first < UDP_MAX_GSO_SEGMENTS &&
+                 total + sizes[i] <= UDP_MAX_GSO_SIZE);
+        msghdr->msg_iovlen = iovec - msghdr->msg_iov;
+        segments[nb_msgs] = i - first;
+
+        msghdr->msg_control = buf->control.buf;
+        msghdr->msg_controllen = sizeof(buf->control.buf);
+        struct cmsghdr *cmsghdr = CMSG_FIRSTHDR(msghdr);
+        size_t controllen = 0;
+#ifdef UDP_SEGMENT
+        if (segments[nb_msgs] > 1) {
+            cmsghdr->cmsg_level = SOL_UDP;
+            cmsghdr->cmsg_type = UDP_SEGMENT;
+            cmsghdr->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segment_size = sizes[first];
+            memcpy(CMSG_DATA(cmsghdr), &segment_size, sizeof(uint16_t));
+            controllen += CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr = CMSG_NXTHDR(msghdr, cmsghdr);
+            gso = true;
+        }
+#endif
+#ifdef HAVE_TXTIME
+        if (upipe_udpsink->txtime_horizon && systimes[first] != UINT64_MAX)
+            controllen += upipe_udpsink_set_cmsg_txtime(cmsghdr,
+                    upipe_udpsink_txtime(upipe, systimes[first], now));
+#endif
+        msghdr->msg_controllen = controllen;
+        if (!controllen)
+            msghdr->msg_control = NULL;
+    }
+
+    int ret;
+    while ((ret = sendmmsg(upipe_udpsink->fd, upipe_udpsink->mmsgs, nb_msgs,
+                           0)) == -1 && errno == EINTR);
+
+    nb_iovecs = 0;
+    for (unsigned int i = 0; i < nb_urefs; i++) {
+        uref_block_iovec_unmap(urefs[i], 0, -1, payloads + nb_iovecs);
+        nb_iovecs += iovec_counts[i];
+    }
+
+    unsigned int sent = 0;
+    if (unlikely(ret == -1)) {
+        switch (errno) {
+            case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+            case EWOULDBLOCK:
+#endif
+                upipe_udpsink_poll(upipe);
+                return false;
+            case EINVAL:
+            case EIO:
+                if (gso) {
+                    upipe_warn_va(upipe, "disabling segmentation offload (%m)");
+                    upipe_udpsink->gso = false;
+                    return upipe_udpsink_output_mmsg(upipe, uref, now,
+                                                     systime);
+                }
+                break;
+            default:
+                break;
+        }
+        /* Drop the first message, as errors at this point come from ICMP
+         * messages such as "port unreachable" and are transient. */
+        sent = segments[0];
+    } else {
+        for (int i = 0; i < ret; i++)
+            sent += segments[i];
+    }
+
+    /* the first uref was already removed from the list */
+    uref_free(uref);
+    for (unsigned int i = 1; i < sent; i++) {
+        ulist_delete(uref_to_uchain(urefs[i]));
+        upipe_udpsink->nb_urefs--;
+        uref_free(urefs[i]);
+    }
+    return true;
+}
+#endif
+
 /** @internal @This outputs data to the udp sink.
  *
  * @param upipe description structure of the pipe
@@ -188,23 +529,28 @@ static bool upipe_udpsink_output(struct upipe *upipe, struct uref *uref,
         return true;
     }
 
+    uint64_t now = 0;
+    uint64_t systime = UINT64_MAX;
     if (likely(upipe_udpsink->uclock == NULL))
         goto write_buffer;
 
-    uint64_t systime = 0;
+    now = upipe_udpsink_sample_now(upipe);
     if (unlikely(!ubase_check(uref_clock_get_cr_sys(uref, &systime)))) {
         upipe_warn(upipe, "received non-dated buffer");
+        systime = UINT64_MAX;
         goto write_buffer;
     }
 
-    uint64_t now = uclock_now(upipe_udpsink->uclock);
     systime += upipe_udpsink->latency;
-    if (unlikely(now < systime)) {
+    /* with kernel pacing, buffers are handed over up to the horizon in
+     * advance */
+    uint64_t horizon = upipe_udpsink->txtime_horizon;
+    if (unlikely(now + horizon < systime)) {
         upipe_udpsink_check_upump_mgr(upipe);
         if (likely(upipe_udpsink->upump_mgr != NULL)) {
             upipe_verbose_va(upipe, "sleeping %"PRIu64" (%"PRIu64")",
-                             systime - now, systime);
-            upipe_udpsink_wait_upump(upipe, systime - now,
+                             systime - horizon - now, systime);
+            upipe_udpsink_wait_upump(upipe, systime - horizon - now,
                                      upipe_udpsink_watcher);
             return false;
         }
@@ -222,6 +568,11 @@ static bool upipe_udpsink_output(struct upipe *upipe, struct uref *uref,
                       upipe_udpsink->latency / (UCLOCK_FREQ / 1000));
 
 write_buffer:
+#ifdef HAVE_SENDMMSG
+    if (upipe_udpsink->batch > 1)
+        return upipe_udpsink_output_mmsg(upipe, uref, now, systime);
+#endif
+
     for ( ; ; ) {
         size_t payload_len = 0;
         if (unlikely(!ubase_check(uref_block_size(uref, &payload_len)))) {
@@ -272,6 +623,19 @@ write_buffer:
             .msg_flags = 0,
         };
 
+#ifdef HAVE_TXTIME
+        union {
+            struct cmsghdr cmsghdr;
+            char buf[CMSG_SPACE(sizeof(uint64_t))];
+        } control;
+        if (upipe_udpsink->txtime_horizon && systime != UINT64_MAX) {
+            msghdr.msg_control = control.buf;
+            msghdr.msg_controllen = sizeof(control.buf);
+            upipe_udpsink_set_cmsg_txtime(CMSG_FIRSTHDR(&msghdr),
+                    upipe_udpsink_txtime(upipe, systime, now));
+        }
+#endif
+
         ssize_t ret = sendmsg(upipe_udpsink->fd, &msghdr, 0);
         uref_block_iovec_unmap(uref, 0, -1, iovecs);
 
@@ -362,6 +726,57 @@ static int upipe_udpsink_set_flow_def(struct upipe *upipe,
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This configures kernel pacing on the socket.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_udpsink_setup_txtime(struct upipe *upipe)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+    if (upipe_udpsink->fd == -1)
+        return UBASE_ERR_NONE;
+
+#ifdef HAVE_TXTIME
+    struct sock_txtime sock_txtime = {
+        .clockid = upipe_udpsink->txtime_clockid,
+        .flags = 0,
+    };
+    if (!upipe_udpsink->txtime_horizon)
+        return UBASE_ERR_NONE;
+    if (unlikely(setsockopt(upipe_udpsink->fd, SOL_SOCKET, SO_TXTIME,
+                            &sock_txtime, sizeof(sock_txtime)) == -1)) {
+        upipe_err_va(upipe, "can't enable kernel pacing (%m)");
+        upipe_udpsink->txtime_horizon = 0;
+        return UBASE_ERR_EXTERNAL;
+    }
+#endif
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the kernel pacing parameters.
+ *
+ * @param upipe description structure of the pipe
+ * @param clockid kernel clock
+ * @param horizon maximum advance of buffers (0 to disable)
+ * @return an error code
+ */
+static int _upipe_udpsink_set_txtime(struct upipe *upipe, int clockid,
+                                     uint64_t horizon)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+#ifdef HAVE_TXTIME
+    upipe_udpsink->txtime_clockid = clockid;
+    upipe_udpsink->txtime_horizon = horizon;
+    return upipe_udpsink_setup_txtime(upipe);
+#else
+    if (!horizon)
+        return UBASE_ERR_NONE;
+    upipe_err(upipe, "kernel pacing is not supported");
+    return UBASE_ERR_EXTERNAL;
+#endif
+}
+
 /** @internal @This returns the uri of the currently opened socket.
  *
  * @param upipe description structure of the pipe
@@ -413,6 +828,9 @@ static int _upipe_udpsink_set_uri(struct upipe *upipe, const char *uri)
         return UBASE_ERR_EXTERNAL;
     }
 
+#ifdef HAVE_SENDMMSG
+    upipe_udpsink->gso = true;
+#endif
     upipe_udpsink->uri = strdup(uri);
     if (unlikely(upipe_udpsink->uri == NULL)) {
         ubase_clean_fd(&upipe_udpsink->fd);
@@ -423,6 +841,63 @@ static int _upipe_udpsink_set_uri(struct upipe *upipe, const char *uri)
         /* Use again the pipe that we previously released. */
         upipe_use(upipe);
     upipe_notice_va(upipe, "opening uri %s", upipe_udpsink->uri);
+    if (unlikely(!ubase_check(upipe_udpsink_setup_txtime(upipe))))
+        upipe_warn(upipe, "falling back to userspace pacing");
+    return UBASE_ERR_NONE;
+}
+
+#ifdef HAVE_SENDMMSG
+/** @internal @This releases the batch mode buffers.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_udpsink_clean_mmsg(struct upipe *upipe)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+    free(upipe_udpsink->mmsgs);
+    free(upipe_udpsink->mmsg_bufs);
+    free(upipe_udpsink->mmsg_urefs);
+    upipe_udpsink->mmsgs = NULL;
+    upipe_udpsink->mmsg_bufs = NULL;
+    upipe_udpsink->mmsg_urefs = NULL;
+}
+#endif
+
+/** @internal @This sets the batch depth.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch maximum number of datagrams written at once (0 or 1 to
+ * disable)
+ * @return an error code
+ */
+static int _upipe_udpsink_set_batch(struct upipe *upipe, unsigned int batch)
+{
+    struct upipe_udpsink *upipe_udpsink = upipe_udpsink_from_upipe(upipe);
+    if (unlikely(batch > UDP_MAX_BATCH)) {
+        upipe_err_va(upipe, "batch depth %u is too large (max %u)",
+                     batch, UDP_MAX_BATCH);
+        return UBASE_ERR_INVALID;
+    }
+#ifdef HAVE_SENDMMSG
+    upipe_udpsink_clean_mmsg(upipe);
+    upipe_udpsink->batch = 0;
+    if (batch > 1) {
+        upipe_udpsink->mmsgs = calloc(batch, sizeof(struct mmsghdr));
+        upipe_udpsink->mmsg_bufs = calloc(batch,
+                                          sizeof(struct upipe_udpsink_mmsg));
+        upipe_udpsink->mmsg_urefs = calloc(batch, sizeof(struct uref *));
+        if (unlikely(upipe_udpsink->mmsgs == NULL ||
+                     upipe_udpsink->mmsg_bufs == NULL ||
+                     upipe_udpsink->mmsg_urefs == NULL)) {
+            upipe_udpsink_clean_mmsg(upipe);
+            return UBASE_ERR_ALLOC;
+        }
+    }
+#else
+    if (batch > 1)
+        upipe_warn(upipe, "sendmmsg() is not available, ignoring batch depth");
+#endif
+    upipe_udpsink->batch = batch;
     return UBASE_ERR_NONE;
 }
 
@@ -502,6 +977,8 @@ static int _upipe_udpsink_control(struct upipe *upipe,
             if (likely(upipe_udpsink->fd != -1))
                 close(upipe_udpsink->fd);
             upipe_udpsink->fd = va_arg(args, int );
+            if (unlikely(!ubase_check(upipe_udpsink_setup_txtime(upipe))))
+                upipe_warn(upipe, "falling back to userspace pacing");
             return UBASE_ERR_NONE;
         }
         case UPIPE_UDPSINK_SET_PEER: {
@@ -511,6 +988,31 @@ static int _upipe_udpsink_control(struct upipe *upipe,
             memcpy(&upipe_udpsink->addr, s, upipe_udpsink->addrlen);
             return UBASE_ERR_NONE;
         }
+        case UPIPE_UDPSINK_GET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSINK_SIGNATURE)
+            unsigned int *batch_p = va_arg(args, unsigned int *);
+            *batch_p = upipe_udpsink->batch;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSINK_SET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSINK_SIGNATURE)
+            unsigned int batch = va_arg(args, unsigned int);
+            return _upipe_udpsink_set_batch(upipe, batch);
+        }
+        case UPIPE_UDPSINK_GET_TXTIME: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSINK_SIGNATURE)
+            int *clockid_p = va_arg(args, int *);
+            uint64_t *horizon_p = va_arg(args, uint64_t *);
+            *clockid_p = upipe_udpsink->txtime_clockid;
+            *horizon_p = upipe_udpsink->txtime_horizon;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSINK_SET_TXTIME: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSINK_SIGNATURE)
+            int clockid = va_arg(args, int);
+            uint64_t horizon = va_arg(args, uint64_t);
+            return _upipe_udpsink_set_txtime(upipe, clockid, horizon);
+        }
         case UPIPE_FLUSH:
             return upipe_udpsink_flush(upipe);
         default:
@@ -555,6 +1057,9 @@ static void upipe_udpsink_free(struct upipe *upipe)
     upipe_throw_dead(upipe);
 
     free(upipe_udpsink->uri);
+#ifdef HAVE_SENDMMSG
+    upipe_udpsink_clean_mmsg(upipe);
+#endif
     upipe_udpsink_clean_uclock(upipe);
     upipe_udpsink_clean_upump(upipe);
     upipe_udpsink_clean_upump_mgr(upipe);
@@ -11,6 +11,9 @@
  * @short Upipe source module for udp sockets
  */
 
+#define _GNU_SOURCE
+
+#include "config.h"
 #include "upipe/ubase.h"
 #include "upipe/uclock.h"
 #include "upipe/uref.h"
@@ -41,9 +44,12 @@
 #include <errno.h>
 #include <assert.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 /** default size of buffers when unspecified */
 #define UBUF_DEFAULT_SIZE       4096
+/** maximum number of datagrams read by a single recvmmsg() call */
+#define UDP_MAX_BATCH           1024
 
 #define UDP_DEFAULT_TTL 0
 #define UDP_DEFAULT_PORT 1234
@@ -99,6 +105,23 @@ struct upipe_udpsrc {
     /** source address (size) */
     socklen_t addrlen;
 
+    /** requested batch depth (0 or 1 if disabled) */
+    unsigned int batch;
+#ifdef HAVE_RECVMMSG
+    /** number of allocated recvmmsg() slots */
+    unsigned int mmsg_depth;
+    /** size of the pre-allocated buffers */
+    unsigned int mmsg_size;
+    /** recvmmsg() message headers */
+    struct mmsghdr *mmsgs;
+    /** recvmmsg() vectors */
+    struct iovec *mmsg_iovecs;
+    /** recvmmsg() source addresses */
+    struct sockaddr_storage *mmsg_addrs;
+    /** pre-allocated urefs */
+    struct uref **mmsg_urefs;
+#endif
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -149,10 +172,216 @@ static struct upipe *upipe_udpsrc_alloc(struct upipe_mgr *mgr,
     upipe_udpsrc->fd = -1;
     upipe_udpsrc->uri = NULL;
     upipe_udpsrc->addrlen = 0;
+    upipe_udpsrc->batch = 0;
+#ifdef HAVE_RECVMMSG
+    upipe_udpsrc->mmsg_depth = 0;
+    upipe_udpsrc->mmsg_size = 0;
+    upipe_udpsrc->mmsgs = NULL;
+    upipe_udpsrc->mmsg_iovecs = NULL;
+    upipe_udpsrc->mmsg_addrs = NULL;
+    upipe_udpsrc->mmsg_urefs = NULL;
+#endif
     upipe_throw_ready(upipe);
     return upipe;
 }
 
+/** @internal @This handles a read error on the udp socket.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_udpsrc_read_error(struct upipe *upipe)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    switch (errno) {
+        case EINTR:
+        case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+        case EWOULDBLOCK:
+#endif
+            /* not an issue, try again later */
+            return;
+        case EBADF:
+        case EINVAL:
+        case EIO:
+        default:
+            break;
+    }
+    upipe_err_va(upipe, "read error from %s (%m)", upipe_udpsrc->uri);
+    upipe_udpsrc_set_upump(upipe, NULL);
+    upipe_throw_source_end(upipe);
+}
+
+/** @internal @This throws an event if the remote address changed.
+ *
+ * @param upipe description structure of the pipe
+ * @param addr address of the sender
+ * @param addrlen size of the address of the sender
+ */
+static void upipe_udpsrc_check_peer(struct upipe *upipe,
+                                    struct sockaddr_storage *addr,
+                                    socklen_t addrlen)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    if (addrlen != upipe_udpsrc->addrlen ||
+        memcmp(addr, &upipe_udpsrc->addr, addrlen)) {
+        upipe_throw(upipe, UPROBE_UDPSRC_NEW_PEER, UPIPE_UDPSRC_SIGNATURE,
+                addr, &addrlen);
+        upipe_udpsrc->addrlen = addrlen;
+        memcpy(&upipe_udpsrc->addr, addr, addrlen);
+    }
+}
+
+#ifdef HAVE_RECVMMSG
+/** @internal @This releases the pre-allocated batch buffers.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_udpsrc_clean_mmsg(struct upipe *upipe)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    for (unsigned int i = 0; i < upipe_udpsrc->mmsg_depth; i++)
+        if (upipe_udpsrc->mmsg_urefs[i] != NULL)
+            uref_free(upipe_udpsrc->mmsg_urefs[i]);
+    free(upipe_udpsrc->mmsgs);
+    free(upipe_udpsrc->mmsg_iovecs);
+    free(upipe_udpsrc->mmsg_addrs);
+    free(upipe_udpsrc->mmsg_urefs);
+    upipe_udpsrc->mmsgs = NULL;
+    upipe_udpsrc->mmsg_iovecs = NULL;
+    upipe_udpsrc->mmsg_addrs = NULL;
+    upipe_udpsrc->mmsg_urefs = NULL;
+    upipe_udpsrc->mmsg_depth = 0;
+}
+
+/** @internal @This allocates the batch buffers if needed and maps them for
+ * writing.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_udpsrc_prepare_mmsg(struct upipe *upipe)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    if (upipe_udpsrc->mmsg_depth != upipe_udpsrc->batch ||
+        upipe_udpsrc->mmsg_size != upipe_udpsrc->output_size) {
+        unsigned int depth = upipe_udpsrc->batch;
+        upipe_udpsrc_clean_mmsg(upipe);
+        upipe_udpsrc->mmsgs = calloc(depth, sizeof(struct mmsghdr));
+        upipe_udpsrc->mmsg_iovecs = calloc(depth, sizeof(struct iovec));
+        upipe_udpsrc->mmsg_addrs = calloc(depth,
+                                          sizeof(struct sockaddr_storage));
+        upipe_udpsrc->mmsg_urefs = calloc(depth, sizeof(struct uref *));
+        if (unlikely(upipe_udpsrc->mmsgs == NULL ||
+                     upipe_udpsrc->mmsg_iovecs == NULL ||
+                     upipe_udpsrc->mmsg_addrs == NULL ||
+                     upipe_udpsrc->mmsg_urefs == NULL)) {
+            upipe_udpsrc_clean_mmsg(upipe);
+            return UBASE_ERR_ALLOC;
+        }
+        upipe_udpsrc->mmsg_depth = depth;
+        upipe_udpsrc->mmsg_size = upipe_udpsrc->output_size;
+    }
+
+    unsigned int i;
+    for (i = 0; i < upipe_udpsrc->mmsg_depth; i++) {
+        if (upipe_udpsrc->mmsg_urefs[i] == NULL) {
+            upipe_udpsrc->mmsg_urefs[i] =
+                uref_block_alloc(upipe_udpsrc->uref_mgr,
+                                 upipe_udpsrc->ubuf_mgr,
+                                 upipe_udpsrc->mmsg_size);
+            if (unlikely(upipe_udpsrc->mmsg_urefs[i] == NULL))
+                break;
+        }
+
+        uint8_t *buffer;
+        int size = -1;
+        if (unlikely(!ubase_check(uref_block_write(upipe_udpsrc->mmsg_urefs[i],
+                                                   0, &size, &buffer)))) {
+            uref_free(upipe_udpsrc->mmsg_urefs[i]);
+            upipe_udpsrc->mmsg_urefs[i] = NULL;
+            break;
+        }
+        assert(size == upipe_udpsrc->mmsg_size);
+
+        upipe_udpsrc->mmsg_iovecs[i].iov_base = buffer;
+        upipe_udpsrc->mmsg_iovecs[i].iov_len = size;
+        struct msghdr *msghdr = &upipe_udpsrc->mmsgs[i].msg_hdr;
+        msghdr->msg_name = &upipe_udpsrc->mmsg_addrs[i];
+        msghdr->msg_namelen = sizeof(struct sockaddr_storage);
+        msghdr->msg_iov = &upipe_udpsrc->mmsg_iovecs[i];
+        msghdr->msg_iovlen = 1;
+        msghdr->msg_control = NULL;
+        msghdr->msg_controllen = 0;
+        msghdr->msg_flags = 0;
+        upipe_udpsrc->mmsgs[i].msg_len = 0;
+    }
+
+    if (unlikely(i < upipe_udpsrc->mmsg_depth)) {
+        while (i-- > 0)
+            uref_block_unmap(upipe_udpsrc->mmsg_urefs[i], 0);
+        return UBASE_ERR_ALLOC;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This reads a batch of datagrams with a single recvmmsg() call
+ * and outputs them.
+ *
+ * @param upipe description structure of the pipe
+ * @param systime reception date
+ */
+static void upipe_udpsrc_worker_mmsg(struct upipe *upipe, uint64_t systime)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    if (unlikely(!ubase_check(upipe_udpsrc_prepare_mmsg(upipe)))) {
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return;
+    }
+
+    int ret = recvmmsg(upipe_udpsrc->fd, upipe_udpsrc->mmsgs,
+                       upipe_udpsrc->mmsg_depth, MSG_WAITFORONE, NULL);
+    for (unsigned int i = 0; i < upipe_udpsrc->mmsg_depth; i++)
+        uref_block_unmap(upipe_udpsrc->mmsg_urefs[i], 0);
+
+    if (unlikely(ret == -1)) {
+        upipe_udpsrc_read_error(upipe);
+        return;
+    }
+
+    /* the pre-allocated arrays are only reallocated from the worker, so they
+     * remain valid while we output */
+    for (int i = 0; i < ret; i++) {
+        struct uref *uref = upipe_udpsrc->mmsg_urefs[i];
+        upipe_udpsrc->mmsg_urefs[i] = NULL;
+        if (unlikely(upipe_udpsrc->upump == NULL)) {
+            /* the source was stopped by a previous datagram */
+            uref_free(uref);
+            continue;
+        }
+
+        struct msghdr *msghdr = &upipe_udpsrc->mmsgs[i].msg_hdr;
+        upipe_udpsrc_check_peer(upipe, msghdr->msg_name, msghdr->msg_namelen);
+
+        unsigned int len = upipe_udpsrc->mmsgs[i].msg_len;
+        if (unlikely(len == 0)) {
+            uref_free(uref);
+            if (likely(upipe_udpsrc->uclock == NULL)) {
+                upipe_notice_va(upipe, "end of udp socket %s",
+                                upipe_udpsrc->uri);
+                upipe_udpsrc_set_upump(upipe, NULL);
+                upipe_throw_source_end(upipe);
+            }
+            continue;
+        }
+        if (unlikely(upipe_udpsrc->uclock != NULL))
+            uref_clock_set_cr_sys(uref, systime);
+        if (unlikely(len != upipe_udpsrc->mmsg_size))
+            uref_block_resize(uref, 0, len);
+        upipe_udpsrc_output(upipe, uref, &upipe_udpsrc->upump);
+    }
+}
+#endif
+
 /** @internal @This reads data from the source and outputs it.
  * It is called either when the idler triggers (permanent storage mode) or
  * when data is available on the udp socket descriptor (live stream mode).
@@ -167,6 +396,13 @@ static void upipe_udpsrc_worker(struct upump *upump)
     if (unlikely(upipe_udpsrc->uclock != NULL))
         systime = uclock_now(upipe_udpsrc->uclock);
 
+#ifdef HAVE_RECVMMSG
+    if (upipe_udpsrc->batch > 1) {
+        upipe_udpsrc_worker_mmsg(upipe, systime);
+        return;
+    }
+#endif
+
     struct uref *uref = uref_block_alloc(upipe_udpsrc->uref_mgr,
                                          upipe_udpsrc->ubuf_mgr,
                                          upipe_udpsrc->output_size);
@@ -194,31 +430,10 @@ static void upipe_udpsrc_worker(struct upump *upump)
 
     if (unlikely(ret == -1)) {
         uref_free(uref);
-        switch (errno) {
-            case EINTR:
-            case EAGAIN:
-#if EAGAIN != EWOULDBLOCK
-            case EWOULDBLOCK:
-#endif
-                /* not an issue, try again later */
-                return;
-            case EBADF:
-            case EINVAL:
-            case EIO:
-            default:
-                break;
-        }
-        upipe_err_va(upipe, "read error from %s (%m)", upipe_udpsrc->uri);
-        upipe_udpsrc_set_upump(upipe, NULL);
-        upipe_throw_source_end(upipe);
+        upipe_udpsrc_read_error(upipe);
         return;
-    } else if (addrlen != upipe_udpsrc->addrlen ||
-        memcmp(&addr, &upipe_udpsrc->addr, addrlen)) {
-        upipe_throw(upipe, UPROBE_UDPSRC_NEW_PEER, UPIPE_UDPSRC_SIGNATURE,
-                &addr, &addrlen);
-        upipe_udpsrc->addrlen = addrlen;
-        memcpy(&upipe_udpsrc->addr, &addr, addrlen);
     }
+    upipe_udpsrc_check_peer(upipe, &addr, addrlen);
 
     if (unlikely(ret == 0)) {
         uref_free(uref);
@@ -343,6 +558,28 @@ static int upipe_udpsrc_set_uri(struct upipe *upipe, const char *uri)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This sets the batch depth.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch maximum number of datagrams read at once (0 or 1 to disable)
+ * @return an error code
+ */
+static int _upipe_udpsrc_set_batch(struct upipe *upipe, unsigned int batch)
+{
+    struct upipe_udpsrc *upipe_udpsrc = upipe_udpsrc_from_upipe(upipe);
+    if (unlikely(batch > UDP_MAX_BATCH)) {
+        upipe_err_va(upipe, "batch depth %u is too large (max %u)",
+                     batch, UDP_MAX_BATCH);
+        return UBASE_ERR_INVALID;
+    }
+#ifndef HAVE_RECVMMSG
+    if (batch > 1)
+        upipe_warn(upipe, "recvmmsg() is not available, ignoring batch depth");
+#endif
+    upipe_udpsrc->batch = batch;
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands on a udp socket source pipe.
  *
  * @param upipe description structure of the pipe
@@ -395,6 +632,17 @@ static int _upipe_udpsrc_control(struct upipe *upipe,
             upipe_udpsrc->fd = va_arg(args, int );
             return UBASE_ERR_NONE;
         }
+        case UPIPE_UDPSRC_GET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            unsigned int *batch_p = va_arg(args, unsigned int *);
+            *batch_p = upipe_udpsrc->batch;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_UDPSRC_SET_BATCH: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_UDPSRC_SIGNATURE)
+            unsigned int batch = va_arg(args, unsigned int);
+            return _upipe_udpsrc_set_batch(upipe, batch);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -435,6 +683,9 @@ static void upipe_udpsrc_free(struct upipe *upipe)
     upipe_throw_dead(upipe);
 
     free(upipe_udpsrc->uri);
+#ifdef HAVE_RECVMMSG
+    upipe_udpsrc_clean_mmsg(upipe);
+#endif
     upipe_udpsrc_clean_output_size(upipe);
     upipe_udpsrc_clean_uclock(upipe);
     upipe_udpsrc_clean_upump(upipe);
@@ -4,15 +4,19 @@ libupipe_pthread-desc = pthread modules
 libupipe_pthread-so-version = 1.0.0
 
 libupipe_pthread-includes = \
+    umem_pthread_pool.h \
     umutex_pthread.h \
     upipe_pthread_transfer.h \
     uprobe_pthread_assert.h \
-    uprobe_pthread_upump_mgr.h
+    uprobe_pthread_upump_mgr.h \
+    upump_pthread_pool.h
 
 libupipe_pthread-src = \
+    umem_pthread_pool.c \
     umutex_pthread.c \
     upipe_pthread_transfer.c \
     uprobe_pthread_assert.c \
-    uprobe_pthread_upump_mgr.c
+    uprobe_pthread_upump_mgr.c \
+    upump_pthread_pool.c
 
 libupipe_pthread-libs = libupipe libupipe_modules pthread
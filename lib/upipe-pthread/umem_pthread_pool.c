@@ -0,0 +1,701 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe pool-based memory allocator with per-thread magazines
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/urefcount.h"
+#include "upipe/ulifo.h"
+#include "upipe/ulist.h"
+#include "upipe/uatomic.h"
+#include "upipe/umem.h"
+#include "upipe-pthread/umem_pthread_pool.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+/** @This defines a magazine, that is an array of buffers of the same size. */
+struct umem_pthread_pool_magazine {
+    /** number of buffers in the magazine */
+    unsigned int count;
+    /** buffers */
+    uint8_t *buffers[];
+};
+
+/** @This defines a shared pool of magazines of buffers of the same size. */
+struct umem_pthread_pool {
+    /** non-empty magazines */
+    struct ulifo full;
+    /** empty magazines */
+    struct ulifo empty;
+    /** maximum number of buffers kept in the pool */
+    unsigned int depth;
+    /** number of buffers currently in the pool */
+    uatomic_uint32_t nb;
+    /** highest number of buffers kept in the pool */
+    uatomic_uint32_t high_water;
+    /** number of allocations served by the pool */
+    uatomic_uint32_t hits;
+    /** number of allocations that fell back to malloc() */
+    uatomic_uint32_t misses;
+    /** number of buffers released because the pool was full */
+    uatomic_uint32_t overflows;
+};
+
+/** @This defines the magazines of a thread for a given pool. */
+struct umem_pthread_pool_slot {
+    /** magazine currently used */
+    struct umem_pthread_pool_magazine *loaded;
+    /** previously used magazine */
+    struct umem_pthread_pool_magazine *previous;
+    /** allocations served by the magazines since the last exchange */
+    uint32_t hits;
+    /** allocations that fell back to malloc() since the last exchange */
+    uint32_t misses;
+    /** buffers released because the pool was full since the last exchange */
+    uint32_t overflows;
+};
+
+/** @This defines the per-thread cache of a manager. */
+struct umem_pthread_pool_cache {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** pointer to the manager */
+    struct umem_pthread_pool_mgr *pool_mgr;
+    /** magazines of each pool */
+    struct umem_pthread_pool_slot slots[];
+};
+
+UBASE_FROM_TO(umem_pthread_pool_cache, uchain, uchain, uchain)
+
+/** @This defines the private data structures of the umem pool manager. */
+struct umem_pthread_pool_mgr {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** common management structure */
+    struct umem_mgr mgr;
+
+    /** key to the per-thread caches */
+    pthread_key_t key;
+    /** mutex protecting the list of caches */
+    pthread_mutex_t mutex;
+    /** list of per-thread caches */
+    struct uchain caches;
+
+    /** number of buffers in a magazine */
+    unsigned int magazine_size;
+    /** size (in octets) of buffers of pools[0] */
+    size_t pool0_size;
+    /** number of pools of buffers */
+    size_t nb_pools;
+    /** buffer pools */
+    struct umem_pthread_pool pools[];
+};
+
+UBASE_FROM_TO(umem_pthread_pool_mgr, umem_mgr, umem_mgr, mgr)
+UBASE_FROM_TO(umem_pthread_pool_mgr, urefcount, urefcount, urefcount)
+
+/** @internal @This returns the nearest bigger size to allocate for a umem of
+ * the given size to fit into and returns the index of the appropriate pool.
+ *
+ * @param pool_mgr description structure of the umem mgr
+ * @param wanted desired size of the umem
+ * @param real_p reference written with the actual size of the future buffer
+ * @return index of the pool in which to find appropriate buffers
+ */
+static unsigned int umem_pthread_pool_find(
+        struct umem_pthread_pool_mgr *pool_mgr, size_t wanted, size_t *real_p)
+{
+    size_t size = pool_mgr->pool0_size;
+    unsigned int pool;
+
+    for (pool = 0; pool < pool_mgr->nb_pools; pool++)
+        if (wanted <= (size << pool))
+            break;
+    if (likely(real_p != NULL))
+        *real_p = pool < pool_mgr->nb_pools ? size << pool : wanted;
+    return pool;
+}
+
+/** @internal @This allocates an empty magazine.
+ *
+ * @param pool_mgr description structure of the umem mgr
+ * @return pointer to magazine, or NULL in case of allocation error
+ */
+static struct umem_pthread_pool_magazine *
+    umem_pthread_pool_magazine_alloc(struct umem_pthread_pool_mgr *pool_mgr)
+{
+    struct umem_pthread_pool_magazine *magazine =
+        malloc(sizeof(struct umem_pthread_pool_magazine) +
+               sizeof(uint8_t *) * pool_mgr->magazine_size);
+    if (likely(magazine != NULL))
+        magazine->count = 0;
+    return magazine;
+}
+
+/** @internal @This frees the buffers of a magazine, and the magazine.
+ *
+ * @param magazine pointer to magazine
+ */
+static void umem_pthread_pool_magazine_free(
+        struct umem_pthread_pool_magazine *magazine)
+{
+    if (magazine == NULL)
+        return;
+    for (unsigned int i = 0; i < magazine->count; i++)
+        free(magazine->buffers[i]);
+    free(magazine);
+}
+
+/** @internal @This folds the statistics of a slot into the shared pool.
+ *
+ * @param umem_pool pointer to the shared pool
+ * @param slot pointer to the slot of the thread
+ */
+static void umem_pthread_pool_flush_stats(struct umem_pthread_pool *umem_pool,
+                                          struct umem_pthread_pool_slot *slot)
+{
+    if (slot->hits)
+        uatomic_fetch_add_relaxed(&umem_pool->hits, slot->hits);
+    if (slot->misses)
+        uatomic_fetch_add_relaxed(&umem_pool->misses, slot->misses);
+    if (slot->overflows)
+        uatomic_fetch_add_relaxed(&umem_pool->overflows, slot->overflows);
+    slot->hits = slot->misses = slot->overflows = 0;
+}
+
+/** @internal @This gives a magazine back to the shared pool, or frees it.
+ *
+ * @param umem_pool pointer to the shared pool
+ * @param magazine pointer to magazine
+ * @return false if the magazine was full and had to be freed
+ */
+static bool umem_pthread_pool_put(struct umem_pthread_pool *umem_pool,
+                                  struct umem_pthread_pool_magazine *magazine)
+{
+    unsigned int count = magazine->count;
+    if (!count) {
+        if (unlikely(!ulifo_push(&umem_pool->empty, magazine)))
+            free(magazine);
+        return true;
+    }
+
+    if (unlikely(!ulifo_push(&umem_pool->full, magazine))) {
+        umem_pthread_pool_magazine_free(magazine);
+        return false;
+    }
+
+    uint32_t nb = uatomic_fetch_add_relaxed(&umem_pool->nb, count) + count;
+    uint32_t high_water = uatomic_load_relaxed(&umem_pool->high_water);
+    while (unlikely(nb > high_water) && nb <= umem_pool->depth &&
+           !uatomic_compare_exchange(&umem_pool->high_water,
+                                     &high_water, nb));
+    return true;
+}
+
+/** @internal @This releases the magazines of a per-thread cache to the
+ * shared pools, and frees the cache.
+ *
+ * @param cache pointer to the per-thread cache
+ */
+static void umem_pthread_pool_cache_free(struct umem_pthread_pool_cache *cache)
+{
+    struct umem_pthread_pool_mgr *pool_mgr = cache->pool_mgr;
+    for (unsigned int i = 0; i < pool_mgr->nb_pools; i++) {
+        struct umem_pthread_pool *umem_pool = &pool_mgr->pools[i];
+        struct umem_pthread_pool_slot *slot = &cache->slots[i];
+        umem_pthread_pool_flush_stats(umem_pool, slot);
+        umem_pthread_pool_put(umem_pool, slot->loaded);
+        umem_pthread_pool_put(umem_pool, slot->previous);
+    }
+    free(cache);
+}
+
+/** @internal @This is called when a thread exits.
+ *
+ * @param opaque pointer to the per-thread cache
+ */
+static void umem_pthread_pool_cache_exit(void *opaque)
+{
+    struct umem_pthread_pool_cache *cache = opaque;
+    struct umem_pthread_pool_mgr *pool_mgr = cache->pool_mgr;
+
+    pthread_mutex_lock(&pool_mgr->mutex);
+    ulist_delete(umem_pthread_pool_cache_to_uchain(cache));
+    pthread_mutex_unlock(&pool_mgr->mutex);
+    umem_pthread_pool_cache_free(cache);
+}
+
+/** @internal @This returns the cache of the current thread, and allocates it
+ * on first use.
+ *
+ * @param pool_mgr description structure of the umem mgr
+ * @return pointer to the per-thread cache, or NULL in case of error
+ */
+static struct umem_pthread_pool_cache *
+    umem_pthread_pool_cache(struct umem_pthread_pool_mgr *pool_mgr)
+{
+    struct umem_pthread_pool_cache *cache =
+        pthread_getspecific(pool_mgr->key);
+    if (likely(cache != NULL))
+        return cache;
+
+    cache = malloc(sizeof(struct umem_pthread_pool_cache) +
+                   sizeof(struct umem_pthread_pool_slot) * pool_mgr->nb_pools);
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    cache->pool_mgr = pool_mgr;
+    for (unsigned int i = 0; i < pool_mgr->nb_pools; i++) {
+        struct umem_pthread_pool_slot *slot = &cache->slots[i];
+        slot->loaded = umem_pthread_pool_magazine_alloc(pool_mgr);
+        slot->previous = umem_pthread_pool_magazine_alloc(pool_mgr);
+        slot->hits = slot->misses = slot->overflows = 0;
+        if (unlikely(slot->loaded == NULL || slot->previous == NULL)) {
+            for (unsigned int j = 0; j <= i; j++) {
+                free(cache->slots[j].loaded);
+                free(cache->slots[j].previous);
+            }
+            free(cache);
+            return NULL;
+        }
+    }
+
+    if (unlikely(pthread_setspecific(pool_mgr->key, cache) != 0)) {
+        for (unsigned int i = 0; i < pool_mgr->nb_pools; i++) {
+            free(cache->slots[i].loaded);
+            free(cache->slots[i].previous);
+        }
+        free(cache);
+        return NULL;
+    }
+
+    uchain_init(umem_pthread_pool_cache_to_uchain(cache));
+    pthread_mutex_lock(&pool_mgr->mutex);
+    ulist_add(&pool_mgr->caches, umem_pthread_pool_cache_to_uchain(cache));
+    pthread_mutex_unlock(&pool_mgr->mutex);
+    return cache;
+}
+
+/** @internal @This takes a buffer from the magazines of the current thread,
+ * and exchanges an empty magazine with a full one from the shared pool if
+ * needed.
+ *
+ * @param pool_mgr description structure of the umem mgr
+ * @param pool index of the pool
+ * @return pointer to buffer, or NULL if the pool is empty
+ */
+static uint8_t *umem_pthread_pool_pop(struct umem_pthread_pool_mgr *pool_mgr,
+                                      unsigned int pool)
+{
+    struct umem_pthread_pool_cache *cache = umem_pthread_pool_cache(pool_mgr);
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    struct umem_pthread_pool_slot *slot = &cache->slots[pool];
+    if (likely(slot->loaded->count)) {
+        slot->hits++;
+        return slot->loaded->buffers[--slot->loaded->count];
+    }
+
+    struct umem_pthread_pool_magazine *magazine = slot->previous;
+    if (!magazine->count) {
+        struct umem_pthread_pool *umem_pool = &pool_mgr->pools[pool];
+        magazine = ulifo_pop(&umem_pool->full,
+                             struct umem_pthread_pool_magazine *);
+        if (magazine == NULL) {
+            slot->misses++;
+            umem_pthread_pool_flush_stats(umem_pool, slot);
+            return NULL;
+        }
+        uatomic_fetch_sub(&umem_pool->nb, magazine->count);
+        umem_pthread_pool_put(umem_pool, slot->previous);
+        umem_pthread_pool_flush_stats(umem_pool, slot);
+    }
+
+    slot->previous = slot->loaded;
+    slot->loaded = magazine;
+    slot->hits++;
+    return magazine->buffers[--magazine->count];
+}
+
+/** @internal @This gives a buffer to the magazines of the current thread,
+ * and exchanges a full magazine with an empty one from the shared pool if
+ * needed.
+ *
+ * @param pool_mgr description structure of the umem mgr
+ * @param pool index of the pool
+ * @param buffer pointer to buffer
+ * @return false if the buffer could not be kept
+ */
+static bool umem_pthread_pool_push(struct umem_pthread_pool_mgr *pool_mgr,
+                                   unsigned int pool, uint8_t *buffer)
+{
+    struct umem_pthread_pool_cache *cache = umem_pthread_pool_cache(pool_mgr);
+    if (unlikely(cache == NULL))
+        return false;
+
+    struct umem_pthread_pool_slot *slot = &cache->slots[pool];
+    unsigned int magazine_size = pool_mgr->magazine_size;
+    if (likely(slot->loaded->count < magazine_size)) {
+        slot->loaded->buffers[slot->loaded->count++] = buffer;
+        return true;
+    }
+
+    struct umem_pthread_pool_magazine *magazine = slot->previous;
+    if (magazine->count == magazine_size) {
+        /* both magazines are full, give the previous one to the shared pool
+         * in exchange for an empty one */
+        struct umem_pthread_pool *umem_pool = &pool_mgr->pools[pool];
+        struct umem_pthread_pool_magazine *empty =
+            ulifo_pop(&umem_pool->empty, struct umem_pthread_pool_magazine *);
+        if (empty == NULL &&
+            unlikely((empty = umem_pthread_pool_magazine_alloc(pool_mgr)) ==
+                     NULL))
+            return false;
+        if (unlikely(!umem_pthread_pool_put(umem_pool, magazine)))
+            slot->overflows += magazine_size;
+        umem_pthread_pool_flush_stats(umem_pool, slot);
+        magazine = empty;
+    }
+
+    slot->previous = slot->loaded;
+    slot->loaded = magazine;
+    magazine->buffers[magazine->count++] = buffer;
+    return true;
+}
+
+/** @This allocates a new umem buffer space.
+ *
+ * @param mgr management structure
+ * @param umem caller-allocated structure, filled in with the required pointer
+ * and size (previous content is discarded)
+ * @param size requested size of the umem
+ * @return false if the memory couldn't be allocated (umem left untouched)
+ */
+static bool umem_pthread_pool_alloc(struct umem_mgr *mgr, struct umem *umem,
+                                    size_t size)
+{
+    struct umem_pthread_pool_mgr *pool_mgr =
+        umem_pthread_pool_mgr_from_umem_mgr(mgr);
+    size_t real_size;
+    unsigned int pool = umem_pthread_pool_find(pool_mgr, size, &real_size);
+    uint8_t *buffer = NULL;
+
+    if (likely(pool < pool_mgr->nb_pools))
+        buffer = umem_pthread_pool_pop(pool_mgr, pool);
+    if (unlikely(buffer == NULL))
+        buffer = malloc(real_size);
+    if (unlikely(buffer == NULL))
+        return false;
+
+    umem->buffer = buffer;
+    umem->size = size;
+    umem->real_size = real_size;
+    umem->mgr = mgr;
+    return true;
+}
+
+/** @This frees a umem.
+ *
+ * @param umem pointer to umem
+ */
+static void umem_pthread_pool_free(struct umem *umem)
+{
+    struct umem_pthread_pool_mgr *pool_mgr =
+        umem_pthread_pool_mgr_from_umem_mgr(umem->mgr);
+    unsigned int pool = umem_pthread_pool_find(pool_mgr, umem->real_size,
+                                               NULL);
+
+    if (unlikely(pool >= pool_mgr->nb_pools ||
+                 !umem_pthread_pool_push(pool_mgr, pool, umem->buffer)))
+        free(umem->buffer);
+    umem->buffer = NULL;
+    umem->mgr = NULL;
+}
+
+/** @This resizes a umem. We do not realloc() the buffer because it would
+ * artificially grow the size of a pool, and create a malloc/free contention.
+ *
+ * @param umem caller-allocated structure, previously successfully passed to
+ * @ref umem_alloc, and filled in with the new pointer and size
+ * @param new_size new requested size of the umem
+ * @return false if the memory couldn't be allocated (umem left untouched)
+ */
+static bool umem_pthread_pool_realloc(struct umem *umem, size_t new_size)
+{
+    if (likely(new_size <= umem->real_size)) {
+        umem->size = new_size;
+        return true;
+    }
+
+    struct umem new_umem;
+    if (!umem_pthread_pool_alloc(umem->mgr, &new_umem, new_size))
+        return false;
+    memcpy(new_umem.buffer, umem->buffer, umem->size);
+    umem_pthread_pool_free(umem);
+    *umem = new_umem;
+    return true;
+}
+
+/** @This releases all buffers kept in the shared pools and in the magazines
+ * of the current thread. It is intended as a debug tool only.
+ *
+ * @param mgr pointer to umem manager
+ */
+static void umem_pthread_pool_mgr_vacuum(struct umem_mgr *mgr)
+{
+    struct umem_pthread_pool_mgr *pool_mgr =
+        umem_pthread_pool_mgr_from_umem_mgr(mgr);
+    struct umem_pthread_pool_cache *cache =
+        pthread_getspecific(pool_mgr->key);
+
+    for (unsigned int i = 0; i < pool_mgr->nb_pools; i++) {
+        struct umem_pthread_pool *umem_pool = &pool_mgr->pools[i];
+        if (cache != NULL) {
+            struct umem_pthread_pool_slot *slot = &cache->slots[i];
+            for (unsigned int j = 0; j < slot->loaded->count; j++)
+                free(slot->loaded->buffers[j]);
+            slot->loaded->count = 0;
+            for (unsigned int j = 0; j < slot->previous->count; j++)
+                free(slot->previous->buffers[j]);
+            slot->previous->count = 0;
+        }
+
+        struct umem_pthread_pool_magazine *magazine;
+        while ((magazine = ulifo_pop(&umem_pool->full,
+                        struct umem_pthread_pool_magazine *)) != NULL) {
+            uatomic_fetch_sub(&umem_pool->nb, magazine->count);
+            umem_pthread_pool_magazine_free(magazine);
+        }
+        while ((magazine = ulifo_pop(&umem_pool->empty,
+                        struct umem_pthread_pool_magazine *)) != NULL)
+            free(magazine);
+    }
+}
+
+/** @This returns the statistics of a pool. The statistics of the magazines
+ * are folded into the shared pool each time a thread exchanges a magazine,
+ * so they may lag by up to a magazine per thread.
+ *
+ * @param mgr pointer to umem manager
+ * @param pool index of the pool
+ * @param stats filled in with the statistics of the pool
+ * @return an error code
+ */
+static int umem_pthread_pool_mgr_get_stats(struct umem_mgr *mgr,
+                                           unsigned int pool,
+                                           struct umem_mgr_stats *stats)
+{
+    struct umem_pthread_pool_mgr *pool_mgr =
+        umem_pthread_pool_mgr_from_umem_mgr(mgr);
+    if (pool >= pool_mgr->nb_pools)
+        return UBASE_ERR_INVALID;
+
+    struct umem_pthread_pool *umem_pool = &pool_mgr->pools[pool];
+    stats->size = pool_mgr->pool0_size << pool;
+    stats->depth = umem_pool->depth;
+    stats->hits = uatomic_load_relaxed(&umem_pool->hits);
+    stats->misses = uatomic_load_relaxed(&umem_pool->misses);
+    stats->overflows = uatomic_load_relaxed(&umem_pool->overflows);
+    stats->high_water = uatomic_load_relaxed(&umem_pool->high_water);
+    return UBASE_ERR_NONE;
+}
+
+/** @This processes control commands on a umem pool manager.
+ *
+ * @param mgr pointer to umem manager
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int umem_pthread_pool_mgr_control(struct umem_mgr *mgr,
+                                         int command, va_list args)
+{
+    switch (command) {
+        case UMEM_MGR_GET_STATS: {
+            unsigned int pool = va_arg(args, unsigned int);
+            struct umem_mgr_stats *stats = va_arg(args,
+                                                  struct umem_mgr_stats *);
+            return umem_pthread_pool_mgr_get_stats(mgr, pool, stats);
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @This frees a umem manager.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static void umem_pthread_pool_mgr_free(struct urefcount *urefcount)
+{
+    struct umem_pthread_pool_mgr *pool_mgr =
+        umem_pthread_pool_mgr_from_urefcount(urefcount);
+
+    /* no destructor will be called for the remaining caches */
+    pthread_key_delete(pool_mgr->key);
+    struct uchain *uchain, *uchain_tmp;
+    ulist_delete_foreach(&pool_mgr->caches, uchain, uchain_tmp) {
+        ulist_delete(uchain);
+        umem_pthread_pool_cache_free(
+            umem_pthread_pool_cache_from_uchain(uchain));
+    }
+    pthread_mutex_destroy(&pool_mgr->mutex);
+
+    for (unsigned int i = 0; i < pool_mgr->nb_pools; i++) {
+        struct umem_pthread_pool *umem_pool = &pool_mgr->pools[i];
+        struct umem_pthread_pool_magazine *magazine;
+        while ((magazine = ulifo_pop(&umem_pool->full,
+                        struct umem_pthread_pool_magazine *)) != NULL)
+            umem_pthread_pool_magazine_free(magazine);
+        while ((magazine = ulifo_pop(&umem_pool->empty,
+                        struct umem_pthread_pool_magazine *)) != NULL)
+            free(magazine);
+        ulifo_clean(&umem_pool->full);
+        ulifo_clean(&umem_pool->empty);
+        uatomic_clean(&umem_pool->nb);
+        uatomic_clean(&umem_pool->high_water);
+        uatomic_clean(&umem_pool->hits);
+        uatomic_clean(&umem_pool->misses);
+        uatomic_clean(&umem_pool->overflows);
+    }
+
+    urefcount_clean(urefcount);
+    free(pool_mgr);
+}
+
+/** @internal @This returns the number of magazines of a shared pool.
+ *
+ * @param depth maximum number of buffers kept in the pool
+ * @param magazine_size number of buffers in a magazine
+ * @return number of magazines
+ */
+static uint16_t umem_pthread_pool_length(unsigned int depth,
+                                         unsigned int magazine_size)
+{
+    unsigned int length = (depth + magazine_size - 1) / magazine_size;
+    return length ? length : 1;
+}
+
+/** @This allocates a new instance of the umem pool manager with per-thread
+ * magazines, allocating buffers from application memory, using pools in
+ * power of 2's.
+ *
+ * @param magazine_size number of buffers in a magazine
+ * @param pool0_size size (in octets) of the smallest allocatable buffer; it
+ * must be a power of 2
+ * @param nb_pools number of buffer pools to maintain, with sizes in power of
+ * 2's increments, followed, for each pool, by the maximum number of buffers
+ * to keep in the shared pool (unsigned int); larger buffers will be directly
+ * managed with malloc() and free()
+ * @return pointer to manager, or NULL in case of error
+ */
+struct umem_mgr *umem_pthread_pool_mgr_alloc(unsigned int magazine_size,
+                                             size_t pool0_size,
+                                             size_t nb_pools, ...)
+{
+    if (unlikely(!magazine_size))
+        return NULL;
+
+    size_t alloc_size = sizeof(struct umem_pthread_pool_mgr) +
+                        sizeof(struct umem_pthread_pool) * nb_pools;
+    unsigned int pools_depths[nb_pools];
+    va_list args;
+    va_start(args, nb_pools);
+    for (unsigned int i = 0; i < nb_pools; i++) {
+        pools_depths[i] = va_arg(args, unsigned int);
+        assert(pools_depths[i] <= UINT16_MAX);
+        alloc_size += 2 * ulifo_sizeof(
+            umem_pthread_pool_length(pools_depths[i], magazine_size));
+    }
+    va_end(args);
+
+    struct umem_pthread_pool_mgr *pool_mgr = malloc(alloc_size);
+    if (unlikely(pool_mgr == NULL))
+        return NULL;
+
+    if (unlikely(pthread_key_create(&pool_mgr->key,
+                                    umem_pthread_pool_cache_exit) != 0)) {
+        free(pool_mgr);
+        return NULL;
+    }
+    pthread_mutex_init(&pool_mgr->mutex, NULL);
+    ulist_init(&pool_mgr->caches);
+
+    pool_mgr->magazine_size = magazine_size;
+    pool_mgr->pool0_size = pool0_size;
+    pool_mgr->nb_pools = nb_pools;
+
+    void *extra = (void *)pool_mgr + sizeof(struct umem_pthread_pool_mgr) +
+                  sizeof(struct umem_pthread_pool) * nb_pools;
+
+    for (unsigned int i = 0; i < nb_pools; i++) {
+        struct umem_pthread_pool *umem_pool = &pool_mgr->pools[i];
+        uint16_t length = umem_pthread_pool_length(pools_depths[i],
+                                                   magazine_size);
+        ulifo_init(&umem_pool->full, length, extra);
+        extra += ulifo_sizeof(length);
+        ulifo_init(&umem_pool->empty, length, extra);
+        extra += ulifo_sizeof(length);
+        umem_pool->depth = pools_depths[i];
+        uatomic_init(&umem_pool->nb, 0);
+        uatomic_init(&umem_pool->high_water, 0);
+        uatomic_init(&umem_pool->hits, 0);
+        uatomic_init(&umem_pool->misses, 0);
+        uatomic_init(&umem_pool->overflows, 0);
+    }
+
+    urefcount_init(umem_pthread_pool_mgr_to_urefcount(pool_mgr),
+                   umem_pthread_pool_mgr_free);
+    pool_mgr->mgr.refcount = umem_pthread_pool_mgr_to_urefcount(pool_mgr);
+    pool_mgr->mgr.umem_alloc = umem_pthread_pool_alloc;
+    pool_mgr->mgr.umem_realloc = umem_pthread_pool_realloc;
+    pool_mgr->mgr.umem_free = umem_pthread_pool_free;
+    pool_mgr->mgr.umem_mgr_vacuum = umem_pthread_pool_mgr_vacuum;
+    pool_mgr->mgr.umem_mgr_control = umem_pthread_pool_mgr_control;
+
+    return umem_pthread_pool_mgr_to_umem_mgr(pool_mgr);
+}
+
+/** @This allocates a new instance of the umem pool manager with per-thread
+ * magazines, with a simpler API.
+ *
+ * @param magazine_size number of buffers in a magazine
+ * @param base_pools_depth number of buffers to keep in the shared pool for
+ * the smaller buffers; for larger buffers the same number is used, divided
+ * by 2, 4, or 8
+ * @return pointer to manager, or NULL in case of error
+ */
+struct umem_mgr *umem_pthread_pool_mgr_alloc_simple(unsigned int magazine_size,
+                                                    uint16_t base_pools_depth)
+{
+    return umem_pthread_pool_mgr_alloc(magazine_size, 32, 18,
+                                       base_pools_depth, /* 32 */
+                                       base_pools_depth, /* 64 */
+                                       base_pools_depth, /* 128 */
+                                       base_pools_depth, /* 256 */
+                                       base_pools_depth, /* 512 */
+                                       base_pools_depth, /* 1 Ki */
+                                       base_pools_depth, /* 2 Ki */
+                                       base_pools_depth, /* 4 Ki */
+                                       base_pools_depth / 2, /* 8 Ki */
+                                       base_pools_depth / 2, /* 16 Ki */
+                                       base_pools_depth / 2, /* 32 Ki */
+                                       base_pools_depth / 4, /* 64 Ki */
+                                       base_pools_depth / 4, /* 128 Ki */
+                                       base_pools_depth / 4, /* 256 Ki */
+                                       base_pools_depth / 4, /* 512 Ki */
+                                       base_pools_depth / 8, /* 1 Mi */
+                                       base_pools_depth / 8, /* 2 Mi */
+                                       base_pools_depth / 8); /* 4 Mi */
+}
@@ -13,16 +13,25 @@
 
 #define _GNU_SOURCE
 
+#include "config.h"
 #include "upipe/ubase.h"
 #include "upipe/ueventfd.h"
 #include "upipe/umutex.h"
 #include "upipe/uprobe.h"
 #include "upipe/upump.h"
 #include "upipe-modules/upipe_transfer.h"
+#include "upipe-modules/upipe_worker.h"
 #include "upipe-pthread/upipe_pthread_transfer.h"
 #include "upipe-pthread/uprobe_pthread_upump_mgr.h"
 
 #include <sys/resource.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_MBIND
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -30,6 +39,16 @@
 #include <string.h>
 #include <signal.h>
 #include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <errno.h>
+
+/** maximum size of the list of CPUs of a NUMA node */
+#define UPIPE_PTHREAD_CPULIST_SIZE 4096
+/** number of bits in a NUMA node mask word */
+#define UPIPE_PTHREAD_LONG_BITS (8 * sizeof(unsigned long))
+/** maximum number of NUMA nodes (MAX_NUMNODES of the kernel) */
+#define UPIPE_PTHREAD_MAX_NODES 1024
 
 /** @internal @This is the private context for pthread. */
 struct upipe_pthread_ctx {
@@ -51,10 +70,140 @@ struct upipe_pthread_ctx {
     struct umutex *mutex;
     /** thread name */
     char *name;
-    /** thread priority value */
-    int priority;
+    /** scheduling and memory placement of the thread */
+    struct upipe_pthread_attr pthread_attr;
+    /** list of CPUs (owned copy of pthread_attr.cpus) */
+    char *cpus;
 };
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+/** @internal @This parses a list of CPUs such as "0-3,8".
+ *
+ * @param list list of CPUs
+ * @param cpuset filled in with the CPUs
+ * @return false if the list is invalid
+ */
+static bool upipe_pthread_parse_cpus(const char *list, cpu_set_t *cpuset)
+{
+    CPU_ZERO(cpuset);
+    while (*list != '\0' && *list != '\n') {
+        char *end;
+        unsigned long first = strtoul(list, &end, 10), last = first;
+        if (end == list)
+            return false;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtoul(list, &end, 10);
+            if (end == list || last < first)
+                return false;
+        }
+        for (unsigned long cpu = first; cpu <= last && cpu < CPU_SETSIZE;
+             cpu++)
+            CPU_SET(cpu, cpuset);
+        list = end;
+        if (*list == ',')
+            list++;
+    }
+    return CPU_COUNT(cpuset) > 0;
+}
+
+/** @internal @This reads the list of CPUs of a NUMA node.
+ *
+ * @param numa_node NUMA node
+ * @param buffer filled in with the list of CPUs
+ * @param size size of the buffer
+ * @return false in case of error
+ */
+static bool upipe_pthread_read_node_cpus(int numa_node, char *buffer,
+                                         size_t size)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             numa_node);
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    bool ret = fgets(buffer, size, file) != NULL;
+    fclose(file);
+    return ret;
+}
+#endif
+
+/** @internal @This applies the scheduling and memory placement to the
+ * calling thread. Failures are reported as warnings.
+ *
+ * @param pthread_ctx private context of the thread
+ */
+static void upipe_pthread_apply_attr(struct upipe_pthread_ctx *pthread_ctx)
+{
+    struct upipe_pthread_attr *pthread_attr = &pthread_ctx->pthread_attr;
+    struct uprobe *uprobe = pthread_ctx->uprobe_pthread_upump_mgr;
+
+    if (pthread_attr->priority != INT_MAX)
+        setpriority(PRIO_PROCESS, 0, pthread_attr->priority);
+
+    if (pthread_attr->sched_policy != -1) {
+        struct sched_param param;
+        param.sched_priority = pthread_attr->sched_priority;
+        int err = pthread_setschedparam(pthread_self(),
+                                        pthread_attr->sched_policy, &param);
+        if (err)
+            uprobe_warn_va(uprobe, NULL,
+                           "unable to set scheduling policy (%s)",
+                           strerror(err));
+    }
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    const char *cpus = pthread_attr->cpus;
+    char node_cpus[UPIPE_PTHREAD_CPULIST_SIZE];
+    if (cpus == NULL && pthread_attr->numa_node >= 0) {
+        if (upipe_pthread_read_node_cpus(pthread_attr->numa_node, node_cpus,
+                                         sizeof(node_cpus)))
+            cpus = node_cpus;
+        else
+            uprobe_warn_va(uprobe, NULL, "unable to read CPUs of node %d",
+                           pthread_attr->numa_node);
+    }
+    if (cpus != NULL) {
+        cpu_set_t cpuset;
+        int err;
+        if (!upipe_pthread_parse_cpus(cpus, &cpuset))
+            uprobe_warn_va(uprobe, NULL, "invalid list of CPUs %s", cpus);
+        else if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset),
+                                               &cpuset)))
+            uprobe_warn_va(uprobe, NULL, "unable to set CPU affinity (%s)",
+                           strerror(err));
+    }
+#else
+    if (pthread_attr->cpus != NULL)
+        uprobe_warn(uprobe, NULL, "CPU affinity is not supported");
+#endif
+
+    if (pthread_attr->numa_node >= 0) {
+#ifdef HAVE_MBIND
+        unsigned long nodemask[UPIPE_PTHREAD_MAX_NODES /
+                               UPIPE_PTHREAD_LONG_BITS];
+        if (pthread_attr->numa_node >= UPIPE_PTHREAD_MAX_NODES)
+            uprobe_warn_va(uprobe, NULL, "invalid NUMA node %d",
+                           pthread_attr->numa_node);
+        else {
+            memset(nodemask, 0, sizeof(nodemask));
+            nodemask[pthread_attr->numa_node / UPIPE_PTHREAD_LONG_BITS] =
+                1UL << (pthread_attr->numa_node % UPIPE_PTHREAD_LONG_BITS);
+            if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodemask,
+                        UPIPE_PTHREAD_MAX_NODES + 1) == -1)
+                uprobe_warn_va(uprobe, NULL,
+                               "unable to set memory policy (%m)");
+        }
+#else
+        uprobe_warn(uprobe, NULL, "NUMA memory placement is not supported");
+#endif
+    }
+
+    if (pthread_attr->mlock && mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+        uprobe_warn_va(uprobe, NULL, "unable to lock memory (%m)");
+}
+
 /** @internal @This is the main function of the new thread.
  *
  * @param mgr pointer to a upipe pthread manager
@@ -83,8 +232,7 @@ static void *upipe_pthread_start(void *_pthread_ctx)
 
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
-    if (pthread_ctx->priority != INT_MAX)
-        setpriority(PRIO_PROCESS, 0, pthread_ctx->priority);
+    upipe_pthread_apply_attr(pthread_ctx);
 
     /* spawn the upump manager */
     struct upump_mgr *upump_mgr =
@@ -144,6 +292,7 @@ static void upipe_pthread_stop(struct upump *upump)
     ueventfd_clean(&pthread_ctx->event);
     umutex_release(pthread_ctx->mutex);
     free(pthread_ctx->name);
+    free(pthread_ctx->cpus);
     free(pthread_ctx);
 }
 
@@ -161,17 +310,17 @@ static void upipe_pthread_stop(struct upump *upump)
  * @param mutex mutual exclusion pimitives to access the event loop, or NULL
  * @param pthread_id_p reference to created thread ID (may be NULL)
  * @param attr pthread attributes
+ * @param pthread_attr scheduling and memory placement of the thread, or NULL
  * @param name custom name or NULL
- * @param priority priority of the thread or INT_MAX to leave it unchanged
  * @return pointer to xfer manager
  */
-struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named(
-    uint8_t queue_length, uint16_t msg_pool_depth,
+struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_attr(
+    uint32_t queue_length, uint16_t msg_pool_depth,
     struct uprobe *uprobe_pthread_upump_mgr,
     upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
     uint16_t upump_blocker_pool_depth, struct umutex *mutex,
     pthread_t *pthread_id_p, const pthread_attr_t *restrict attr,
-    int priority, const char *name)
+    const struct upipe_pthread_attr *pthread_attr, const char *name)
 {
     struct upipe_pthread_ctx *pthread_ctx =
         malloc(sizeof(struct upipe_pthread_ctx));
@@ -206,7 +355,13 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named(
     pthread_ctx->upump_blocker_pool_depth = upump_blocker_pool_depth;
     pthread_ctx->mutex = umutex_use(mutex);
     pthread_ctx->name = name ? strdup(name) : NULL;
-    pthread_ctx->priority = priority;
+    if (pthread_attr != NULL)
+        pthread_ctx->pthread_attr = *pthread_attr;
+    else
+        upipe_pthread_attr_init(&pthread_ctx->pthread_attr);
+    pthread_ctx->cpus = pthread_ctx->pthread_attr.cpus != NULL ?
+                        strdup(pthread_ctx->pthread_attr.cpus) : NULL;
+    pthread_ctx->pthread_attr.cpus = pthread_ctx->cpus;
 
     if (unlikely(pthread_create(&pthread_ctx->pthread_id, attr,
                                 upipe_pthread_start, pthread_ctx) != 0))
@@ -218,6 +373,8 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named(
     return xfer_mgr;
 
 upipe_pthread_xfer_mgr_alloc_err5:
+    free(pthread_ctx->name);
+    free(pthread_ctx->cpus);
     umutex_release(mutex);
     upipe_mgr_release(pthread_ctx->xfer_mgr);
     upipe_mgr_release(xfer_mgr);
@@ -232,7 +389,31 @@ upipe_pthread_xfer_mgr_alloc_err1:
     return NULL;
 }
 
-struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named(uint8_t queue_length,
+struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio_named(
+    uint32_t queue_length, uint16_t msg_pool_depth,
+    struct uprobe *uprobe_pthread_upump_mgr,
+    upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
+    uint16_t upump_blocker_pool_depth, struct umutex *mutex,
+    pthread_t *pthread_id_p, const pthread_attr_t *restrict attr,
+    int priority, const char *name)
+{
+    struct upipe_pthread_attr pthread_attr;
+    upipe_pthread_attr_init(&pthread_attr);
+    pthread_attr.priority = priority;
+    return upipe_pthread_xfer_mgr_alloc_attr(queue_length,
+                                             msg_pool_depth,
+                                             uprobe_pthread_upump_mgr,
+                                             upump_mgr_alloc,
+                                             upump_pool_depth,
+                                             upump_blocker_pool_depth,
+                                             mutex,
+                                             pthread_id_p,
+                                             attr,
+                                             &pthread_attr,
+                                             name);
+}
+
+struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named(uint32_t queue_length,
         uint16_t msg_pool_depth, struct uprobe *uprobe_pthread_upump_mgr,
         upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
         uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -252,7 +433,7 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_named(uint8_t queue_length,
                                                    name);
 }
 
-struct upipe_mgr *upipe_pthread_xfer_mgr_alloc(uint8_t queue_length,
+struct upipe_mgr *upipe_pthread_xfer_mgr_alloc(uint32_t queue_length,
         uint16_t msg_pool_depth, struct uprobe *uprobe_pthread_upump_mgr,
         upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
         uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -271,7 +452,7 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc(uint8_t queue_length,
 }
 
 struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio(
-    uint8_t queue_length, uint16_t msg_pool_depth,
+    uint32_t queue_length, uint16_t msg_pool_depth,
     struct uprobe *uprobe_pthread_upump_mgr,
     upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
     uint16_t upump_blocker_pool_depth, struct umutex *mutex,
@@ -290,3 +471,31 @@ struct upipe_mgr *upipe_pthread_xfer_mgr_alloc_prio(
                                                    priority,
                                                    NULL);
 }
+
+struct upipe_mgr *upipe_pthread_work_mgr_alloc(
+    uint32_t queue_length, uint16_t msg_pool_depth,
+    struct uprobe *uprobe_pthread_upump_mgr,
+    upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
+    uint16_t upump_blocker_pool_depth, struct umutex *mutex,
+    pthread_t *pthread_id_p, const pthread_attr_t *restrict attr,
+    const struct upipe_pthread_attr *pthread_attr, const char *name)
+{
+    struct upipe_mgr *xfer_mgr =
+        upipe_pthread_xfer_mgr_alloc_attr(queue_length,
+                                          msg_pool_depth,
+                                          uprobe_pthread_upump_mgr,
+                                          upump_mgr_alloc,
+                                          upump_pool_depth,
+                                          upump_blocker_pool_depth,
+                                          mutex,
+                                          pthread_id_p,
+                                          attr,
+                                          pthread_attr,
+                                          name);
+    if (unlikely(xfer_mgr == NULL))
+        return NULL;
+
+    struct upipe_mgr *work_mgr = upipe_work_mgr_alloc(xfer_mgr);
+    upipe_mgr_release(xfer_mgr);
+    return work_mgr;
+}
@@ -0,0 +1,1157 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe event loops scheduled on a pool of POSIX threads
+ *
+ * Each pool upump manager keeps its own pumps (called virtual pumps here),
+ * and allocates the corresponding real pumps on the event loop of the worker
+ * it is attached to. Real pumps are stopped and started along with their
+ * virtual pumps, and only freed with them, except timers whose delay
+ * changes. Moving a manager to another worker frees the real pumps and
+ * allocates them again on the event loop of the new worker, from the new
+ * worker thread.
+ *
+ * Workers exchange messages through a list protected by a mutex and an
+ * eventfd: a worker with less load than another one asks it to hand over a
+ * manager (steal), and the victim, between two dispatches, detaches the
+ * manager which best balances the load and sends it to the thief (attach).
+ * A manager released outside of its worker thread is also removed by its
+ * worker (detach).
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/ulist.h"
+#include "upipe/urefcount.h"
+#include "upipe/uatomic.h"
+#include "upipe/uclock.h"
+#include "upipe/ueventfd.h"
+#include "upipe/upump.h"
+#include "upipe/upump_common.h"
+#include "upipe-pthread/upump_pthread_pool.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+/** period of the load balancing */
+#define UPUMP_PTHREAD_POOL_PERIOD (UCLOCK_FREQ / 10)
+/** minimum load difference (per period) triggering a steal */
+#define UPUMP_PTHREAD_POOL_THRESHOLD (UCLOCK_FREQ / 100)
+
+/** @hidden */
+struct upump_pthread_pool_mgr;
+
+/** @internal @This is the type of a message sent to a worker. */
+enum upump_pthread_pool_msg_type {
+    /** attach a pool upump manager to the worker */
+    UPUMP_PTHREAD_POOL_MSG_ATTACH,
+    /** hand a pool upump manager over to another worker */
+    UPUMP_PTHREAD_POOL_MSG_STEAL,
+    /** remove a released pool upump manager from the worker */
+    UPUMP_PTHREAD_POOL_MSG_DETACH,
+};
+
+/** @internal @This is a message sent to a worker. */
+struct upump_pthread_pool_msg {
+    /** structure for double-linked list */
+    struct uchain uchain;
+    /** type of message */
+    enum upump_pthread_pool_msg_type type;
+    /** pool upump manager to attach */
+    struct upump_pthread_pool_mgr *pool_mgr;
+    /** worker asking for a pool upump manager */
+    struct upump_pthread_pool_worker *thief;
+    /** true if the sender waits for the manager to be removed, otherwise
+     * the worker frees the manager */
+    bool wait;
+    /** true once the manager is removed (protected by the mutex) */
+    bool done;
+};
+
+UBASE_FROM_TO(upump_pthread_pool_msg, uchain, uchain, uchain)
+
+/** @internal @This is the private context of a worker thread. */
+struct upump_pthread_pool_worker {
+    /** pointer to the pool */
+    struct upump_pthread_pool *pool;
+    /** thread ID */
+    pthread_t pthread_id;
+    /** true if the thread was created */
+    bool created;
+
+    /** mutex protecting the inbox */
+    pthread_mutex_t mutex;
+    /** condition signaling removed managers */
+    pthread_cond_t cond;
+    /** list of incoming messages */
+    struct uchain inbox;
+    /** true if the worker no longer accepts messages */
+    bool exited;
+    /** eventfd signaling incoming messages */
+    struct ueventfd event;
+
+    /** event loop of the worker */
+    struct upump_mgr *upump_mgr;
+    /** watcher on the eventfd */
+    struct upump *upump_event;
+    /** load balancing timer */
+    struct upump *upump_balance;
+    /** list of attached pool upump managers (only accessed by the worker) */
+    struct uchain pool_mgrs;
+
+    /** number of attached pool upump managers, including those in transit */
+    uatomic_uint32_t nb_pool_mgrs;
+    /** time spent dispatching during the last period, in clock ticks */
+    uatomic_uint32_t load;
+};
+
+/** @internal @This is the private context of the pool. */
+struct upump_pthread_pool {
+    /** true when the pool is being freed */
+    uatomic_uint32_t stopping;
+    /** number of worker threads */
+    unsigned int nb_workers;
+    /** worker threads */
+    struct upump_pthread_pool_worker workers[];
+};
+
+/** @internal @This stores management parameters and local structures of a
+ * pool upump manager.
+ */
+struct upump_pthread_pool_mgr {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** pointer to the pool */
+    struct upump_pthread_pool *pool;
+    /** worker the manager is attached or sent to, or NULL (read by the
+     * thread releasing the manager) */
+    uatomic_ptr_t worker;
+    /** structure for double-linked list of the worker */
+    struct uchain uchain;
+    /** true if the manager was handed over to the pool */
+    bool submitted;
+    /** list of allocated pumps */
+    struct uchain upumps;
+
+    /** time spent dispatching during the current period, in clock ticks */
+    uint64_t load;
+    /** time spent dispatching during the last period, in clock ticks */
+    uint64_t last_load;
+
+    /** common structure */
+    struct upump_common_mgr common_mgr;
+
+    /** extra space for upool */
+    uint8_t upool_extra[];
+};
+
+UBASE_FROM_TO(upump_pthread_pool_mgr, upump_mgr, upump_mgr, common_mgr.mgr)
+UBASE_FROM_TO(upump_pthread_pool_mgr, urefcount, urefcount, urefcount)
+UBASE_FROM_TO(upump_pthread_pool_mgr, uchain, uchain, uchain)
+
+/** @internal @This stores local structures of a pump. */
+struct upump_pthread_pool_pump {
+    /** structure for double-linked list of the manager */
+    struct uchain uchain;
+    /** type of event to watch */
+    int event;
+
+    /** private structure */
+    union {
+        /** file descriptor or signal */
+        int fd;
+        struct {
+            /** delay before the first expiration */
+            uint64_t after;
+            /** delay between expirations */
+            uint64_t repeat;
+            /** next expiration */
+            uint64_t deadline;
+            /** true if a one-shot timer has expired */
+            bool expired;
+        } timer;
+    };
+
+    /** true if the pump is really started */
+    bool active;
+    /** pump on the event loop of the worker, or NULL */
+    struct upump *real;
+
+    /** common structure */
+    struct upump_common common;
+};
+
+UBASE_FROM_TO(upump_pthread_pool_pump, upump, upump, common.upump)
+UBASE_FROM_TO(upump_pthread_pool_pump, uchain, uchain, uchain)
+
+/** @internal @This returns the current date of the monotonic clock.
+ *
+ * @return date in clock ticks
+ */
+static uint64_t upump_pthread_pool_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * UCLOCK_FREQ +
+           (uint64_t)ts.tv_nsec * UCLOCK_FREQ / UINT64_C(1000000000);
+}
+
+/** @internal @This dispatches a virtual pump from its real pump.
+ *
+ * @param real real pump
+ */
+static void upump_pthread_pool_dispatch(struct upump *real)
+{
+    struct upump_pthread_pool_pump *pump =
+        upump_get_opaque(real, struct upump_pthread_pool_pump *);
+    struct upump *upump = upump_pthread_pool_pump_to_upump(pump);
+    struct upump_pthread_pool_mgr *pool_mgr =
+        upump_pthread_pool_mgr_from_upump_mgr(upump->mgr);
+
+    if (pump->event == UPUMP_TYPE_TIMER) {
+        if (pump->timer.repeat)
+            pump->timer.deadline += pump->timer.repeat;
+        else
+            pump->timer.expired = true;
+    }
+
+    /* the pump and its manager may be freed by the callback */
+    struct upump_mgr *mgr = upump_mgr_use(upump->mgr);
+    uint64_t start = upump_pthread_pool_now();
+    upump_common_dispatch(upump);
+    pool_mgr->load += upump_pthread_pool_now() - start;
+    upump_mgr_release(mgr);
+}
+
+/** @internal @This starts the real pump of a virtual pump, allocating it
+ * if needed.
+ *
+ * @param pump pointer to a virtual pump
+ */
+static void upump_pthread_pool_pump_arm(struct upump_pthread_pool_pump *pump)
+{
+    struct upump *upump = upump_pthread_pool_pump_to_upump(pump);
+    struct upump_pthread_pool_mgr *pool_mgr =
+        upump_pthread_pool_mgr_from_upump_mgr(upump->mgr);
+    struct upump_pthread_pool_worker *worker =
+        uatomic_ptr_load_ptr(&pool_mgr->worker,
+                             struct upump_pthread_pool_worker *);
+    if (worker == NULL)
+        return;
+    if (pump->real != NULL) {
+        upump_set_status(pump->real, pump->common.status);
+        upump_start(pump->real);
+        return;
+    }
+    struct upump_mgr *mgr = worker->upump_mgr;
+
+    switch (pump->event) {
+        case UPUMP_TYPE_IDLER:
+            pump->real = upump_alloc_idler(mgr, upump_pthread_pool_dispatch,
+                                           pump, NULL);
+            break;
+        case UPUMP_TYPE_TIMER: {
+            if (pump->timer.expired)
+                return;
+            uint64_t now = upump_pthread_pool_now();
+            uint64_t after = pump->timer.deadline > now ?
+                             pump->timer.deadline - now : 0;
+            pump->real = upump_alloc_timer(mgr, upump_pthread_pool_dispatch,
+                                           pump, NULL, after,
+                                           pump->timer.repeat);
+            break;
+        }
+        case UPUMP_TYPE_FD_READ:
+            pump->real = upump_alloc_fd_read(mgr, upump_pthread_pool_dispatch,
+                                             pump, NULL, pump->fd);
+            break;
+        case UPUMP_TYPE_FD_WRITE:
+            pump->real = upump_alloc_fd_write(mgr, upump_pthread_pool_dispatch,
+                                              pump, NULL, pump->fd);
+            break;
+        case UPUMP_TYPE_SIGNAL:
+            pump->real = upump_alloc_signal(mgr, upump_pthread_pool_dispatch,
+                                            pump, NULL, pump->fd);
+            break;
+        default:
+            break;
+    }
+    if (unlikely(pump->real == NULL))
+        return;
+
+    upump_set_status(pump->real, pump->common.status);
+    upump_start(pump->real);
+}
+
+/** @internal @This stops and frees the real pump of a virtual pump.
+ *
+ * @param pump pointer to a virtual pump
+ */
+static void upump_pthread_pool_pump_release(
+        struct upump_pthread_pool_pump *pump)
+{
+    if (pump->real == NULL)
+        return;
+    upump_stop(pump->real);
+    upump_free(pump->real);
+    pump->real = NULL;
+}
+
+/** @internal @This stops the real pump of a virtual pump. It is kept for
+ * the next start, except for timers, which are allocated again with the
+ * delay of their next start.
+ *
+ * @param pump pointer to a virtual pump
+ */
+static void upump_pthread_pool_pump_disarm(struct upump_pthread_pool_pump *pump)
+{
+    if (pump->event == UPUMP_TYPE_TIMER)
+        upump_pthread_pool_pump_release(pump);
+    else if (pump->real != NULL)
+        upump_stop(pump->real);
+}
+
+/** @This allocates a new pump.
+ *
+ * @param mgr pointer to a upump_mgr structure wrapped into a
+ * upump_pthread_pool_mgr structure
+ * @param event type of event to watch for
+ * @param args optional parameters depending on event type
+ * @return pointer to allocated pump, or NULL in case of failure
+ */
+static struct upump *upump_pthread_pool_pump_alloc(struct upump_mgr *mgr,
+                                                   int event, va_list args)
+{
+    struct upump_pthread_pool_mgr *pool_mgr =
+        upump_pthread_pool_mgr_from_upump_mgr(mgr);
+    struct upump_pthread_pool_pump *pump =
+        upool_alloc(&pool_mgr->common_mgr.upump_pool,
+                    struct upump_pthread_pool_pump *);
+    if (unlikely(pump == NULL))
+        return NULL;
+    struct upump *upump = upump_pthread_pool_pump_to_upump(pump);
+
+    switch (event) {
+        case UPUMP_TYPE_IDLER:
+            break;
+        case UPUMP_TYPE_TIMER:
+            pump->timer.after = va_arg(args, uint64_t);
+            pump->timer.repeat = va_arg(args, uint64_t);
+            pump->timer.deadline = 0;
+            pump->timer.expired = false;
+            break;
+        case UPUMP_TYPE_FD_READ:
+        case UPUMP_TYPE_FD_WRITE:
+        case UPUMP_TYPE_SIGNAL:
+            pump->fd = va_arg(args, int);
+            break;
+        default:
+            upool_free(&pool_mgr->common_mgr.upump_pool, pump);
+            return NULL;
+    }
+    pump->event = event;
+    pump->active = false;
+    pump->real = NULL;
+    ulist_add(&pool_mgr->upumps, &pump->uchain);
+
+    upump_common_init(upump);
+
+    return upump;
+}
+
+/** @This starts a pump.
+ *
+ * @param upump description structure of the pump
+ * @param status blocking status of the pump
+ */
+static void upump_pthread_pool_real_start(struct upump *upump, bool status)
+{
+    struct upump_pthread_pool_pump *pump =
+        upump_pthread_pool_pump_from_upump(upump);
+    if (pump->event == UPUMP_TYPE_TIMER) {
+        pump->timer.deadline = upump_pthread_pool_now() + pump->timer.after;
+        pump->timer.expired = false;
+    }
+    pump->active = true;
+    upump_pthread_pool_pump_arm(pump);
+}
+
+/** @This stops a pump.
+ *
+ * @param upump description structure of the pump
+ * @param status blocking status of the pump
+ */
+static void upump_pthread_pool_real_stop(struct upump *upump, bool status)
+{
+    struct upump_pthread_pool_pump *pump =
+        upump_pthread_pool_pump_from_upump(upump);
+    pump->active = false;
+    upump_pthread_pool_pump_disarm(pump);
+}
+
+/** @This restarts a pump.
+ *
+ * @param upump description structure of the pump
+ * @param status blocking status of the pump
+ */
+static void upump_pthread_pool_real_restart(struct upump *upump, bool status)
+{
+    struct upump_pthread_pool_pump *pump =
+        upump_pthread_pool_pump_from_upump(upump);
+    if (pump->event != UPUMP_TYPE_TIMER)
+        return;
+
+    bool running = pump->active && !pump->timer.expired;
+    uint64_t value = running && pump->timer.repeat ?
+                     pump->timer.repeat : pump->timer.after;
+    upump_pthread_pool_pump_disarm(pump);
+    pump->timer.deadline = upump_pthread_pool_now() + value;
+    pump->timer.expired = false;
+    pump->active = true;
+    upump_pthread_pool_pump_arm(pump);
+}
+
+/** @This releases the memory space previously used by a pump.
+ *
+ * @param upump description structure of the pump
+ */
+static void upump_pthread_pool_pump_free(struct upump *upump)
+{
+    struct upump_pthread_pool_mgr *pool_mgr =
+        upump_pthread_pool_mgr_from_upump_mgr(upump->mgr);
+    upump_stop(upump);
+    upump_common_clean(upump);
+    struct upump_pthread_pool_pump *pump =
+        upump_pthread_pool_pump_from_upump(upump);
+    upump_pthread_pool_pump_release(pump);
+    ulist_delete(&pump->uchain);
+    upool_free(&pool_mgr->common_mgr.upump_pool, pump);
+}
+
+/** @internal @This allocates the data structure.
+ *
+ * @param upool pointer to upool
+ * @return pointer to upump_pthread_pool_pump or NULL in case of allocation
+ * error
+ */
+static void *upump_pthread_pool_alloc_inner(struct upool *upool)
+{
+    struct upump_common_mgr *common_mgr =
+        upump_common_mgr_from_upump_pool(upool);
+    struct upump_pthread_pool_pump *pump =
+        malloc(sizeof(struct upump_pthread_pool_pump));
+    if (unlikely(pump == NULL))
+        return NULL;
+    struct upump *upump = upump_pthread_pool_pump_to_upump(pump);
+    upump->mgr = upump_common_mgr_to_upump_mgr(common_mgr);
+    return pump;
+}
+
+/** @internal @This frees a upump_pthread_pool_pump.
+ *
+ * @param upool pointer to upool
+ * @param pump pointer to a upump_pthread_pool_pump structure to free
+ */
+static void upump_pthread_pool_free_inner(struct upool *upool, void *pump)
+{
+    free(pump);
+}
+
+/** @This processes control commands on a pump.
+ *
+ * @param upump description structure of the pump
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upump_pthread_pool_pump_control(struct upump *upump,
+                                           int command, va_list args)
+{
+    switch (command) {
+        case UPUMP_START:
+            upump_common_start(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_RESTART:
+            upump_common_restart(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_STOP:
+            upump_common_stop(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_FREE:
+            upump_pthread_pool_pump_free(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_GET_STATUS: {
+            int *status_p = va_arg(args, int *);
+            upump_common_get_status(upump, status_p);
+            return UBASE_ERR_NONE;
+        }
+        case UPUMP_SET_STATUS: {
+            int status = va_arg(args, int);
+            upump_common_set_status(upump, status);
+            return UBASE_ERR_NONE;
+        }
+        case UPUMP_ALLOC_BLOCKER: {
+            struct upump_blocker **p = va_arg(args, struct upump_blocker **);
+            *p = upump_common_blocker_alloc(upump);
+            return UBASE_ERR_NONE;
+        }
+        case UPUMP_FREE_BLOCKER: {
+            struct upump_blocker *blocker =
+                va_arg(args, struct upump_blocker *);
+            upump_common_blocker_free(blocker);
+            return UBASE_ERR_NONE;
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @internal @This attaches a pool upump manager sent to the calling worker
+ * and allocates its real pumps.
+ *
+ * @param worker pointer to the worker
+ * @param pool_mgr pointer to a pool upump manager
+ */
+static void upump_pthread_pool_worker_attach(
+        struct upump_pthread_pool_worker *worker,
+        struct upump_pthread_pool_mgr *pool_mgr)
+{
+    ulist_add(&worker->pool_mgrs, &pool_mgr->uchain);
+
+    struct uchain *uchain;
+    ulist_foreach(&pool_mgr->upumps, uchain) {
+        struct upump_pthread_pool_pump *pump =
+            upump_pthread_pool_pump_from_uchain(uchain);
+        if (pump->active)
+            upump_pthread_pool_pump_arm(pump);
+    }
+}
+
+/** @internal @This detaches a pool upump manager from its worker and frees
+ * its real pumps.
+ *
+ * @param pool_mgr pointer to a pool upump manager
+ */
+static void upump_pthread_pool_worker_detach(
+        struct upump_pthread_pool_mgr *pool_mgr)
+{
+    struct uchain *uchain;
+    ulist_foreach(&pool_mgr->upumps, uchain) {
+        struct upump_pthread_pool_pump *pump =
+            upump_pthread_pool_pump_from_uchain(uchain);
+        upump_pthread_pool_pump_release(pump);
+    }
+
+    struct upump_pthread_pool_worker *worker =
+        uatomic_ptr_load_ptr(&pool_mgr->worker,
+                             struct upump_pthread_pool_worker *);
+    ulist_delete(&pool_mgr->uchain);
+    uatomic_fetch_sub(&worker->nb_pool_mgrs, 1);
+    uatomic_ptr_store(&pool_mgr->worker, NULL);
+}
+
+/** @internal @This sends a message to a worker.
+ *
+ * @param worker pointer to the worker
+ * @param msg message to send
+ * @return false if the worker no longer accepts messages
+ */
+static bool upump_pthread_pool_worker_post(
+        struct upump_pthread_pool_worker *worker,
+        struct upump_pthread_pool_msg *msg)
+{
+    pthread_mutex_lock(&worker->mutex);
+    if (worker->exited) {
+        pthread_mutex_unlock(&worker->mutex);
+        return false;
+    }
+    if (msg->type == UPUMP_PTHREAD_POOL_MSG_ATTACH) {
+        uatomic_fetch_add(&worker->nb_pool_mgrs, 1);
+        /* a release in transit is sent after the manager */
+        uatomic_ptr_store(&msg->pool_mgr->worker, worker);
+    }
+    ulist_add(&worker->inbox, &msg->uchain);
+    pthread_mutex_unlock(&worker->mutex);
+    ueventfd_write(&worker->event);
+    return true;
+}
+
+/** @internal @This hands the pool upump manager which best balances the load
+ * over to a thief.
+ *
+ * @param worker pointer to the victim
+ * @param msg steal message, reused to send the manager
+ */
+static void upump_pthread_pool_worker_steal(
+        struct upump_pthread_pool_worker *worker,
+        struct upump_pthread_pool_msg *msg)
+{
+    struct upump_pthread_pool_worker *thief = msg->thief;
+    uint32_t load = uatomic_load(&worker->load);
+    uint32_t thief_load = uatomic_load(&thief->load);
+    if (load <= thief_load || ulist_depth(&worker->pool_mgrs) < 2) {
+        free(msg);
+        return;
+    }
+
+    uint64_t target = (load - thief_load) / 2;
+    struct upump_pthread_pool_mgr *best = NULL;
+    struct uchain *uchain;
+    ulist_foreach(&worker->pool_mgrs, uchain) {
+        struct upump_pthread_pool_mgr *pool_mgr =
+            upump_pthread_pool_mgr_from_uchain(uchain);
+        /* a manager without pumps may be released from another thread */
+        if (!ulist_empty(&pool_mgr->upumps) &&
+            pool_mgr->last_load && pool_mgr->last_load <= target &&
+            (best == NULL || pool_mgr->last_load > best->last_load))
+            best = pool_mgr;
+    }
+    if (best == NULL) {
+        free(msg);
+        return;
+    }
+
+    upump_pthread_pool_worker_detach(best);
+    msg->type = UPUMP_PTHREAD_POOL_MSG_ATTACH;
+    msg->pool_mgr = best;
+    if (!upump_pthread_pool_worker_post(thief, msg)) {
+        free(msg);
+        uatomic_fetch_add(&worker->nb_pool_mgrs, 1);
+        uatomic_ptr_store(&best->worker, worker);
+        upump_pthread_pool_worker_attach(worker, best);
+    }
+}
+
+/** @internal @This frees the resources of a pool upump manager.
+ *
+ * @param pool_mgr pointer to a pool upump manager
+ */
+static void upump_pthread_pool_mgr_clean(
+        struct upump_pthread_pool_mgr *pool_mgr)
+{
+    upump_common_mgr_clean(upump_pthread_pool_mgr_to_upump_mgr(pool_mgr));
+    uatomic_ptr_clean(&pool_mgr->worker);
+    urefcount_clean(upump_pthread_pool_mgr_to_urefcount(pool_mgr));
+    free(pool_mgr);
+}
+
+/** @internal @This removes a released pool upump manager from the worker,
+ * and either acknowledges it to the waiting sender or frees the manager.
+ *
+ * @param worker pointer to the worker
+ * @param msg detach message
+ */
+static void upump_pthread_pool_worker_release(
+        struct upump_pthread_pool_worker *worker,
+        struct upump_pthread_pool_msg *msg)
+{
+    struct upump_pthread_pool_mgr *pool_mgr = msg->pool_mgr;
+    if (uatomic_ptr_load(&pool_mgr->worker) == worker)
+        upump_pthread_pool_worker_detach(pool_mgr);
+
+    if (!msg->wait) {
+        upump_pthread_pool_mgr_clean(pool_mgr);
+        free(msg);
+        return;
+    }
+    pthread_mutex_lock(&worker->mutex);
+    msg->done = true;
+    pthread_cond_broadcast(&worker->cond);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+/** @internal @This processes the incoming messages of a worker.
+ *
+ * @param worker pointer to the worker
+ */
+static void upump_pthread_pool_worker_process(
+        struct upump_pthread_pool_worker *worker)
+{
+    for ( ; ; ) {
+        pthread_mutex_lock(&worker->mutex);
+        struct uchain *uchain = ulist_pop(&worker->inbox);
+        pthread_mutex_unlock(&worker->mutex);
+        if (uchain == NULL)
+            break;
+
+        struct upump_pthread_pool_msg *msg =
+            upump_pthread_pool_msg_from_uchain(uchain);
+        switch (msg->type) {
+            case UPUMP_PTHREAD_POOL_MSG_ATTACH:
+                upump_pthread_pool_worker_attach(worker, msg->pool_mgr);
+                free(msg);
+                break;
+            case UPUMP_PTHREAD_POOL_MSG_STEAL:
+                upump_pthread_pool_worker_steal(worker, msg);
+                break;
+            case UPUMP_PTHREAD_POOL_MSG_DETACH:
+                upump_pthread_pool_worker_release(worker, msg);
+                break;
+        }
+    }
+}
+
+/** @internal @This checks if the pumps of the attached pool upump managers
+ * keep the event loop of a worker running.
+ *
+ * @param worker pointer to the worker
+ * @return true if a pump is blocking
+ */
+static bool upump_pthread_pool_worker_blocking(
+        struct upump_pthread_pool_worker *worker)
+{
+    struct uchain *uchain, *uchain_pump;
+    ulist_foreach(&worker->pool_mgrs, uchain) {
+        struct upump_pthread_pool_mgr *pool_mgr =
+            upump_pthread_pool_mgr_from_uchain(uchain);
+        ulist_foreach(&pool_mgr->upumps, uchain_pump) {
+            struct upump_pthread_pool_pump *pump =
+                upump_pthread_pool_pump_from_uchain(uchain_pump);
+            if (pump->active && pump->common.status &&
+                (pump->event != UPUMP_TYPE_TIMER || !pump->timer.expired))
+                return true;
+        }
+    }
+    return false;
+}
+
+/** @internal @This releases the pumps of a worker once the pool is being
+ * freed and its pool upump managers have no blocking pump, so that its
+ * event loop returns.
+ *
+ * @param worker pointer to the worker
+ */
+static void upump_pthread_pool_worker_check(
+        struct upump_pthread_pool_worker *worker)
+{
+    if (!uatomic_load(&worker->pool->stopping) ||
+        upump_pthread_pool_worker_blocking(worker))
+        return;
+
+    upump_free(worker->upump_balance);
+    worker->upump_balance = NULL;
+    upump_free(worker->upump_event);
+    worker->upump_event = NULL;
+}
+
+/** @internal @This is called when the eventfd of a worker is readable.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upump_pthread_pool_worker_event(struct upump *upump)
+{
+    struct upump_pthread_pool_worker *worker =
+        upump_get_opaque(upump, struct upump_pthread_pool_worker *);
+    ueventfd_read(&worker->event);
+    upump_pthread_pool_worker_process(worker);
+    upump_pthread_pool_worker_check(worker);
+}
+
+/** @internal @This is called periodically to update the load of a worker
+ * and to steal from the busiest worker.
+ *
+ * @param upump description structure of the timer
+ */
+static void upump_pthread_pool_worker_balance(struct upump *upump)
+{
+    struct upump_pthread_pool_worker *worker =
+        upump_get_opaque(upump, struct upump_pthread_pool_worker *);
+    struct upump_pthread_pool *pool = worker->pool;
+
+    uint64_t load = 0;
+    struct uchain *uchain;
+    ulist_foreach(&worker->pool_mgrs, uchain) {
+        struct upump_pthread_pool_mgr *pool_mgr =
+            upump_pthread_pool_mgr_from_uchain(uchain);
+        pool_mgr->last_load = pool_mgr->load;
+        pool_mgr->load = 0;
+        load += pool_mgr->last_load;
+    }
+    if (load > UINT32_MAX)
+        load = UINT32_MAX;
+    uatomic_store(&worker->load, load);
+
+    struct upump_pthread_pool_worker *victim = NULL;
+    uint64_t victim_load = 0;
+    for (unsigned int i = 0; i < pool->nb_workers; i++) {
+        struct upump_pthread_pool_worker *other = &pool->workers[i];
+        uint32_t other_load = uatomic_load(&other->load);
+        if (other != worker && other_load > victim_load &&
+            uatomic_load(&other->nb_pool_mgrs) > 1) {
+            victim = other;
+            victim_load = other_load;
+        }
+    }
+    if (victim != NULL &&
+        victim_load > 2 * load + UPUMP_PTHREAD_POOL_THRESHOLD) {
+        struct upump_pthread_pool_msg *msg =
+            malloc(sizeof(struct upump_pthread_pool_msg));
+        if (likely(msg != NULL)) {
+            msg->type = UPUMP_PTHREAD_POOL_MSG_STEAL;
+            msg->pool_mgr = NULL;
+            msg->thief = worker;
+            if (!upump_pthread_pool_worker_post(victim, msg))
+                free(msg);
+        }
+    }
+
+    upump_pthread_pool_worker_check(worker);
+}
+
+/** @internal @This is the main function of a worker thread.
+ *
+ * @param _worker pointer to the worker
+ * @return NULL
+ */
+static void *upump_pthread_pool_worker_main(void *_worker)
+{
+    struct upump_pthread_pool_worker *worker =
+        (struct upump_pthread_pool_worker *)_worker;
+
+    upump_set_status(worker->upump_balance, false);
+    upump_start(worker->upump_balance);
+    upump_start(worker->upump_event);
+
+    for ( ; ; ) {
+        upump_mgr_run(worker->upump_mgr, NULL);
+
+        /* managers may still be in transit */
+        pthread_mutex_lock(&worker->mutex);
+        bool empty = ulist_empty(&worker->inbox);
+        if (empty) {
+            /* managers released afterwards find they are detached */
+            worker->exited = true;
+            struct uchain *uchain, *uchain_tmp;
+            ulist_delete_foreach(&worker->pool_mgrs, uchain, uchain_tmp) {
+                struct upump_pthread_pool_mgr *pool_mgr =
+                    upump_pthread_pool_mgr_from_uchain(uchain);
+                upump_pthread_pool_worker_detach(pool_mgr);
+            }
+        }
+        pthread_mutex_unlock(&worker->mutex);
+        if (empty)
+            break;
+        upump_pthread_pool_worker_process(worker);
+    }
+    return NULL;
+}
+
+/** @This processes control commands on a pool upump manager.
+ *
+ * @param mgr pointer to a upump_mgr structure
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upump_pthread_pool_mgr_control(struct upump_mgr *mgr,
+                                          int command, va_list args)
+{
+    switch (command) {
+        case UPUMP_MGR_VACUUM:
+            upump_common_mgr_vacuum(mgr);
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @This frees a pool upump manager.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static void upump_pthread_pool_mgr_free(struct urefcount *urefcount)
+{
+    struct upump_pthread_pool_mgr *pool_mgr =
+        upump_pthread_pool_mgr_from_urefcount(urefcount);
+    struct upump_pthread_pool_worker *worker =
+        uatomic_ptr_load_ptr(&pool_mgr->worker,
+                             struct upump_pthread_pool_worker *);
+    if (worker == NULL || pthread_equal(worker->pthread_id, pthread_self())) {
+        if (worker != NULL)
+            upump_pthread_pool_worker_detach(pool_mgr);
+        upump_pthread_pool_mgr_clean(pool_mgr);
+        return;
+    }
+
+    /* the list of managers of a worker is only accessed by the worker */
+    struct upump_pthread_pool_msg *msg =
+        malloc(sizeof(struct upump_pthread_pool_msg));
+    if (unlikely(msg == NULL))
+        return;
+    msg->type = UPUMP_PTHREAD_POOL_MSG_DETACH;
+    msg->pool_mgr = pool_mgr;
+    msg->thief = NULL;
+    msg->done = false;
+    /* two workers waiting for each other would never wake up, so workers
+     * leave the manager to be freed by its worker */
+    bool wait = true;
+    struct upump_pthread_pool *pool = pool_mgr->pool;
+    for (unsigned int i = 0; i < pool->nb_workers; i++)
+        if (pool->workers[i].created &&
+            pthread_equal(pool->workers[i].pthread_id, pthread_self()))
+            wait = false;
+    msg->wait = wait;
+
+    if (!upump_pthread_pool_worker_post(worker, msg)) {
+        /* the worker exited and detached its managers */
+        free(msg);
+        upump_pthread_pool_mgr_clean(pool_mgr);
+        return;
+    }
+    if (!wait)
+        return;
+
+    pthread_mutex_lock(&worker->mutex);
+    while (!msg->done)
+        pthread_cond_wait(&worker->cond, &worker->mutex);
+    pthread_mutex_unlock(&worker->mutex);
+    free(msg);
+    upump_pthread_pool_mgr_clean(pool_mgr);
+}
+
+/** @This allocates a upump manager scheduled on the pool.
+ *
+ * @param pool pointer to the pool
+ * @param upump_pool_depth maximum number of upump structures in the pool
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures
+ * in the pool
+ * @return pointer to the wrapped upump_mgr structure
+ */
+struct upump_mgr *upump_pthread_pool_mgr_alloc(struct upump_pthread_pool *pool,
+        uint16_t upump_pool_depth, uint16_t upump_blocker_pool_depth)
+{
+    struct upump_pthread_pool_mgr *pool_mgr =
+        malloc(sizeof(struct upump_pthread_pool_mgr) +
+               upump_common_mgr_sizeof(upump_pool_depth,
+                                       upump_blocker_pool_depth));
+    if (unlikely(pool_mgr == NULL))
+        return NULL;
+
+    struct upump_mgr *mgr = upump_pthread_pool_mgr_to_upump_mgr(pool_mgr);
+    mgr->signature = UPUMP_PTHREAD_POOL_SIGNATURE;
+    urefcount_init(upump_pthread_pool_mgr_to_urefcount(pool_mgr),
+                   upump_pthread_pool_mgr_free);
+    pool_mgr->common_mgr.mgr.refcount =
+        upump_pthread_pool_mgr_to_urefcount(pool_mgr);
+    pool_mgr->common_mgr.mgr.upump_alloc = upump_pthread_pool_pump_alloc;
+    pool_mgr->common_mgr.mgr.upump_control = upump_pthread_pool_pump_control;
+    pool_mgr->common_mgr.mgr.upump_mgr_control =
+        upump_pthread_pool_mgr_control;
+    upump_common_mgr_init(mgr, upump_pool_depth, upump_blocker_pool_depth,
+                          pool_mgr->upool_extra,
+                          upump_pthread_pool_real_start,
+                          upump_pthread_pool_real_stop,
+                          upump_pthread_pool_real_restart,
+                          upump_pthread_pool_alloc_inner,
+                          upump_pthread_pool_free_inner);
+
+    pool_mgr->pool = pool;
+    uatomic_ptr_init(&pool_mgr->worker, NULL);
+    uchain_init(&pool_mgr->uchain);
+    pool_mgr->submitted = false;
+    ulist_init(&pool_mgr->upumps);
+    pool_mgr->load = 0;
+    pool_mgr->last_load = 0;
+    return mgr;
+}
+
+/** @This hands a pool upump manager over to the least loaded worker. The
+ * calling thread must not use the manager afterwards.
+ *
+ * @param mgr pointer to a pool upump manager
+ * @return an error code
+ */
+int upump_pthread_pool_mgr_submit(struct upump_mgr *mgr)
+{
+    if (mgr == NULL || mgr->signature != UPUMP_PTHREAD_POOL_SIGNATURE)
+        return UBASE_ERR_INVALID;
+    struct upump_pthread_pool_mgr *pool_mgr =
+        upump_pthread_pool_mgr_from_upump_mgr(mgr);
+    struct upump_pthread_pool *pool = pool_mgr->pool;
+    if (pool_mgr->submitted)
+        return UBASE_ERR_BUSY;
+
+    struct upump_pthread_pool_worker *worker = NULL;
+    uint32_t nb_pool_mgrs = UINT32_MAX;
+    for (unsigned int i = 0; i < pool->nb_workers; i++) {
+        uint32_t nb = uatomic_load(&pool->workers[i].nb_pool_mgrs);
+        if (nb < nb_pool_mgrs) {
+            worker = &pool->workers[i];
+            nb_pool_mgrs = nb;
+        }
+    }
+    if (unlikely(worker == NULL))
+        return UBASE_ERR_INVALID;
+
+    struct upump_pthread_pool_msg *msg =
+        malloc(sizeof(struct upump_pthread_pool_msg));
+    UBASE_ALLOC_RETURN(msg);
+    msg->type = UPUMP_PTHREAD_POOL_MSG_ATTACH;
+    msg->pool_mgr = pool_mgr;
+    msg->thief = NULL;
+    pool_mgr->submitted = true;
+    if (unlikely(uatomic_load(&pool->stopping) ||
+                 !upump_pthread_pool_worker_post(worker, msg))) {
+        pool_mgr->submitted = false;
+        free(msg);
+        return UBASE_ERR_INVALID;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This releases the resources of the workers.
+ *
+ * @param pool pointer to the pool
+ * @param nb_workers number of initialized workers
+ */
+static void upump_pthread_pool_clean(struct upump_pthread_pool *pool,
+                                     unsigned int nb_workers)
+{
+    for (unsigned int i = 0; i < nb_workers; i++) {
+        struct upump_pthread_pool_worker *worker = &pool->workers[i];
+        upump_free(worker->upump_balance);
+        upump_free(worker->upump_event);
+        upump_mgr_release(worker->upump_mgr);
+        ueventfd_clean(&worker->event);
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->mutex);
+
+        struct uchain *uchain;
+        while ((uchain = ulist_pop(&worker->inbox)) != NULL)
+            free(upump_pthread_pool_msg_from_uchain(uchain));
+        uatomic_clean(&worker->nb_pool_mgrs);
+        uatomic_clean(&worker->load);
+    }
+    uatomic_clean(&pool->stopping);
+    free(pool);
+}
+
+/** @This waits for the pumps of all submitted pool upump managers to stop
+ * blocking, terminates the worker threads and frees the pool.
+ *
+ * @param pool pointer to the pool
+ */
+void upump_pthread_pool_free(struct upump_pthread_pool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    uatomic_store(&pool->stopping, 1);
+    for (unsigned int i = 0; i < pool->nb_workers; i++)
+        ueventfd_write(&pool->workers[i].event);
+    for (unsigned int i = 0; i < pool->nb_workers; i++)
+        if (pool->workers[i].created)
+            pthread_join(pool->workers[i].pthread_id, NULL);
+    upump_pthread_pool_clean(pool, pool->nb_workers);
+}
+
+/** @internal @This initializes a worker and its event loop.
+ *
+ * @param pool pointer to the pool
+ * @param worker pointer to the worker
+ * @param upump_mgr_alloc function creating the event loop of the worker
+ * @param upump_pool_depth maximum number of upump structures in the pool
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures
+ * in the pool
+ * @return false in case of error
+ */
+static bool upump_pthread_pool_worker_init(struct upump_pthread_pool *pool,
+        struct upump_pthread_pool_worker *worker,
+        upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
+        uint16_t upump_blocker_pool_depth)
+{
+    worker->pool = pool;
+    worker->created = false;
+    ulist_init(&worker->inbox);
+    worker->exited = false;
+    ulist_init(&worker->pool_mgrs);
+    uatomic_init(&worker->nb_pool_mgrs, 0);
+    uatomic_init(&worker->load, 0);
+    worker->upump_event = NULL;
+    worker->upump_balance = NULL;
+    if (unlikely(!ueventfd_init(&worker->event, false)))
+        return false;
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->cond, NULL);
+
+    /* the event loop is only used by the worker thread once it is created */
+    worker->upump_mgr = upump_mgr_alloc(upump_pool_depth,
+                                        upump_blocker_pool_depth);
+    if (unlikely(worker->upump_mgr == NULL))
+        goto upump_pthread_pool_worker_init_err;
+    worker->upump_event =
+        ueventfd_upump_alloc(&worker->event, worker->upump_mgr,
+                             upump_pthread_pool_worker_event, worker, NULL);
+    worker->upump_balance =
+        upump_alloc_timer(worker->upump_mgr, upump_pthread_pool_worker_balance,
+                          worker, NULL, UPUMP_PTHREAD_POOL_PERIOD,
+                          UPUMP_PTHREAD_POOL_PERIOD);
+    if (unlikely(worker->upump_event == NULL ||
+                 worker->upump_balance == NULL))
+        goto upump_pthread_pool_worker_init_err;
+    return true;
+
+upump_pthread_pool_worker_init_err:
+    upump_free(worker->upump_balance);
+    upump_free(worker->upump_event);
+    upump_mgr_release(worker->upump_mgr);
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->mutex);
+    ueventfd_clean(&worker->event);
+    return false;
+}
+
+/** @This allocates a pool of worker threads, each running its own event loop.
+ *
+ * @param nb_threads number of worker threads
+ * @param upump_mgr_alloc function creating the event loop of a worker
+ * @param upump_pool_depth maximum number of upump structures in the pool of
+ * the event loop of a worker
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures
+ * in the pool of the event loop of a worker
+ * @param attr pthread attributes of the worker threads, or NULL
+ * @return pointer to the pool, or NULL in case of error
+ */
+struct upump_pthread_pool *upump_pthread_pool_alloc(unsigned int nb_threads,
+        upump_mgr_alloc upump_mgr_alloc, uint16_t upump_pool_depth,
+        uint16_t upump_blocker_pool_depth, const pthread_attr_t *restrict attr)
+{
+    if (unlikely(!nb_threads || upump_mgr_alloc == NULL))
+        return NULL;
+
+    struct upump_pthread_pool *pool =
+        malloc(sizeof(struct upump_pthread_pool) +
+               nb_threads * sizeof(struct upump_pthread_pool_worker));
+    if (unlikely(pool == NULL))
+        return NULL;
+    uatomic_init(&pool->stopping, 0);
+    pool->nb_workers = nb_threads;
+
+    for (unsigned int i = 0; i < nb_threads; i++) {
+        if (unlikely(!upump_pthread_pool_worker_init(pool, &pool->workers[i],
+                        upump_mgr_alloc, upump_pool_depth,
+                        upump_blocker_pool_depth))) {
+            upump_pthread_pool_clean(pool, i);
+            return NULL;
+        }
+    }
+
+    for (unsigned int i = 0; i < nb_threads; i++) {
+        struct upump_pthread_pool_worker *worker = &pool->workers[i];
+        if (unlikely(pthread_create(&worker->pthread_id, attr,
+                                    upump_pthread_pool_worker_main,
+                                    worker) != 0)) {
+            upump_pthread_pool_free(pool);
+            return NULL;
+        }
+        worker->created = true;
+    }
+    return pool;
+}
@@ -27,6 +27,7 @@
 #include "upipe/upipe_helper_input.h"
 #include "upipe-swscale/upipe_sws.h"
 #include "upipe-av/upipe_av_pixfmt.h"
+#include "upipe_sws_workers.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -34,6 +35,7 @@
 #include <stdarg.h>
 #include <string.h>
 
+#include <libavutil/mem.h>
 #include <libavutil/opt.h>
 #include <libswscale/swscale.h>
 
@@ -42,6 +44,45 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
                              struct upump **upump_p);
 /** @hidden */
 static int upipe_sws_check(struct upipe *upipe, struct uref *flow_format);
+/** @This stores the state of a horizontal band of the picture, converted by
+ * a worker thread, or by the calling thread for the first band. */
+struct upipe_sws_band {
+    /** swscale contexts [0] for progressive, [1,2] interlaced */
+    struct SwsContext *convert_ctx[3];
+
+    /** context used for the current picture, or NULL if the band is empty */
+    struct SwsContext *ctx;
+    /** input planes of the band, including the overlapping lines */
+    const uint8_t *input_planes[UPIPE_AV_MAX_PLANES + 1];
+    /** input strides */
+    const int *input_strides;
+    /** output planes of the band, in the scratch buffer if the band overlaps
+     * its neighbours */
+    uint8_t *output_planes[UPIPE_AV_MAX_PLANES + 1];
+    /** output strides */
+    int output_strides[UPIPE_AV_MAX_PLANES + 1];
+    /** number of lines converted, including the overlapping lines */
+    int lines;
+    /** return value of sws_scale */
+    int ret;
+
+    /** buffer receiving the output of an overlapping band */
+    uint8_t *scratch;
+    /** size of the scratch buffer */
+    size_t scratch_size;
+    /** true if the lines of the band are copied from the scratch buffer */
+    bool copy;
+    /** first line of the band in the converted lines */
+    int skip;
+    /** number of lines of the band */
+    int band_lines;
+    /** planes of the picture receiving the lines of the band */
+    uint8_t *dest_planes[UPIPE_AV_MAX_PLANES];
+    /** strides of the picture */
+    const int *dest_strides;
+    /** vertical subsampling of the output planes */
+    const uint8_t *dest_vsub;
+};
 
 /** upipe_sws structure with swscale parameters */
 struct upipe_sws {
@@ -100,6 +141,16 @@ struct upipe_sws {
     /** true if the we already tried to set the colorspace, but failed at it */
     bool colorspace_invalid;
 
+    /** number of threads converting a picture, 0 or 1 for the calling
+     * thread only */
+    unsigned int threads;
+    /** array of bands, one per thread, or NULL */
+    struct upipe_sws_band *bands;
+    /** number of bands */
+    unsigned int nb_bands;
+    /** worker threads converting the bands */
+    struct upipe_sws_workers workers;
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -136,6 +187,312 @@ static int upipe_sws_convert_color(struct upipe *upipe, struct uref *flow_def)
     return colorspace;
 }
 
+/** @internal @This prepares a swscale context for the given sizes, and
+ * applies the color space settings.
+ *
+ * @param upipe description structure of the pipe
+ * @param ctx_p pointer to the cached context
+ * @param input_hsize input horizontal size
+ * @param input_vsize input vertical size
+ * @param output_hsize output horizontal size
+ * @param output_vsize output vertical size
+ * @return false if the context could not be allocated
+ */
+static bool upipe_sws_prepare_ctx(struct upipe *upipe,
+                                  struct SwsContext **ctx_p,
+                                  int input_hsize, int input_vsize,
+                                  int output_hsize, int output_vsize)
+{
+    struct upipe_sws *upipe_sws = upipe_sws_from_upipe(upipe);
+    *ctx_p = sws_getCachedContext(*ctx_p,
+                input_hsize, input_vsize, upipe_sws->input_pix_fmt,
+                output_hsize, output_vsize, upipe_sws->output_pix_fmt,
+                upipe_sws->flags, NULL, NULL, NULL);
+
+    if (unlikely(*ctx_p == NULL)) {
+        upipe_err(upipe, "sws_getContext failed");
+        return false;
+    }
+
+    if (upipe_sws->colorspace_invalid)
+        return true;
+
+    int in_full, out_full, brightness, contrast, saturation;
+    const int *inv_table, *table;
+
+    if (unlikely(sws_getColorspaceDetails(*ctx_p,
+                    (int **)&inv_table, &in_full, (int **)&table, &out_full,
+                    &brightness, &contrast, &saturation) < 0)) {
+        upipe_warn(upipe, "unable to set color space data");
+        upipe_sws->colorspace_invalid = true;
+        return true;
+    }
+
+    if (upipe_sws->input_colorspace != -1)
+        inv_table = sws_getCoefficients(upipe_sws->input_colorspace);
+    if (upipe_sws->input_color_range != -1)
+        in_full = upipe_sws->input_color_range;
+    if (upipe_sws->output_colorspace != -1)
+        table = sws_getCoefficients(upipe_sws->output_colorspace);
+    if (upipe_sws->output_color_range != -1)
+        out_full = upipe_sws->output_color_range;
+
+    if (unlikely(sws_setColorspaceDetails(*ctx_p,
+                    inv_table, in_full, table, out_full,
+                    brightness, contrast, saturation) < 0)) {
+        upipe_warn(upipe, "unable to set color space data");
+        upipe_sws->colorspace_invalid = true;
+    }
+    return true;
+}
+
+/** @internal @This sets the chroma positions of a set of contexts.
+ *
+ * @param upipe description structure of the pipe
+ * @param convert_ctx contexts [0] for progressive, [1,2] interlaced
+ */
+static void upipe_sws_set_chroma_pos(struct upipe *upipe,
+                                     struct SwsContext *convert_ctx[3])
+{
+    struct upipe_sws *upipe_sws = upipe_sws_from_upipe(upipe);
+    if (upipe_sws->input_pix_fmt == AV_PIX_FMT_YUV420P) {
+        av_opt_set_int(convert_ctx[0], "src_v_chr_pos", 128, 0);
+        av_opt_set_int(convert_ctx[1], "src_v_chr_pos", 64, 0);
+        av_opt_set_int(convert_ctx[2], "src_v_chr_pos", 192, 0);
+    }
+
+    if (upipe_sws->output_pix_fmt == AV_PIX_FMT_YUV420P) {
+        av_opt_set_int(convert_ctx[0], "dst_v_chr_pos", 128, 0);
+        av_opt_set_int(convert_ctx[1], "dst_v_chr_pos", 64, 0);
+        av_opt_set_int(convert_ctx[2], "dst_v_chr_pos", 192, 0);
+    }
+}
+
+/** @internal @This returns the number of source lines read by the vertical
+ * filter of swscale for each output line, when no vertical scaling is
+ * involved, as computed by initFilter() in libswscale.
+ *
+ * @param flags swscale flags
+ * @return number of filter taps
+ */
+static unsigned int upipe_sws_filter_taps(int flags)
+{
+    if (flags & SWS_POINT)
+        return 1;
+    if (flags & (SWS_FAST_BILINEAR | SWS_AREA | SWS_BILINEAR))
+        return 2;
+    if (flags & SWS_BICUBIC)
+        return 4;
+    if (flags & SWS_LANCZOS)
+        return 6;
+    if (flags & (SWS_X | SWS_GAUSS))
+        return 8;
+    return 20;
+}
+
+/** @internal @This converts the band of a worker.
+ *
+ * @param band description structure of the band
+ */
+static void upipe_sws_band_run(struct upipe_sws_band *band)
+{
+    if (band->ctx == NULL)
+        return;
+
+    band->ret = sws_scale(band->ctx,
+                          band->input_planes, band->input_strides,
+                          0, band->lines,
+                          band->output_planes, band->output_strides);
+    if (!band->copy || band->ret <= 0)
+        return;
+
+    /* only keep the lines of the band */
+    for (int i = 0; i < UPIPE_AV_MAX_PLANES && band->output_planes[i]; i++) {
+        const uint8_t *src = band->output_planes[i] +
+            band->skip / band->dest_vsub[i] * band->output_strides[i];
+        uint8_t *dst = band->dest_planes[i];
+        for (int y = 0; y < band->band_lines / band->dest_vsub[i]; y++) {
+            memcpy(dst, src, band->output_strides[i]);
+            src += band->output_strides[i];
+            dst += band->dest_strides[i];
+        }
+    }
+}
+
+/** @internal @This converts the band of a thread of the pool.
+ *
+ * @param opaque description structure of the pipe
+ * @param index index of the thread
+ */
+static void upipe_sws_band_cb(void *opaque, unsigned int index)
+{
+    struct upipe_sws *upipe_sws = opaque;
+    upipe_sws_band_run(&upipe_sws->bands[index]);
+}
+
+/** @internal @This stops the worker threads and frees the bands.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_sws_stop_bands(struct upipe *upipe)
+{
+    struct upipe_sws *upipe_sws = upipe_sws_from_upipe(upipe);
+    if (upipe_sws->bands == NULL)
+        return;
+
+    upipe_sws_workers_stop(&upipe_sws->workers);
+    for (unsigned int n = 0; n < upipe_sws->threads; n++) {
+        struct upipe_sws_band *band = &upipe_sws->bands[n];
+        for (int i = 0; i < 3; i++)
+            if (band->convert_ctx[i] != NULL)
+                sws_freeContext(band->convert_ctx[i]);
+        av_free(band->scratch);
+    }
+    free(upipe_sws->bands);
+    upipe_sws->bands = NULL;
+    upipe_sws->nb_bands = 0;
+}
+
+/** @internal @This converts a picture or a field in horizontal bands, one
+ * per thread, the calling thread converting the first band. The number of
+ * lines is not changed, so that each band maps to the same lines on output.
+ *
+ * Each band converts the lines read by the vertical filter above and below
+ * it, into a scratch buffer, and only keeps its own lines, so that the
+ * output is identical to the conversion of the whole picture. Bands also
+ * start on the same line of the ordered dither matrix as the whole picture.
+ *
+ * @param upipe description structure of the pipe
+ * @param field 0 for a progressive picture, 1 or 2 for a field
+ * @param input_hsize input horizontal size
+ * @param output_hsize output horizontal size
+ * @param vsize number of lines of the picture or field
+ * @param input_planes input planes
+ * @param input_strides input strides
+ * @param input_vsub vertical subsampling of the input planes
+ * @param output_planes output planes
+ * @param output_strides output strides
+ * @param output_vsub vertical subsampling of the output planes
+ * @return the number of output lines, or a negative value on error
+ */
+static int upipe_sws_scale_bands(struct upipe *upipe, int field,
+                                 size_t input_hsize, size_t output_hsize,
+                                 size_t vsize,
+                                 const uint8_t *input_planes[],
+                                 const int input_strides[],
+                                 const uint8_t input_vsub[],
+                                 uint8_t *output_planes[],
+                                 const int output_strides[],
+                                 const uint8_t output_vsub[])
+{
+    struct upipe_sws *upipe_sws = upipe_sws_from_upipe(upipe);
+    unsigned int nb_bands = upipe_sws->nb_bands;
+
+    /* bands must start on a line of every plane */
+    size_t align = 1;
+    for (int i = 0; i < UPIPE_AV_MAX_PLANES; i++) {
+        if (input_planes[i] != NULL && input_vsub[i] > align)
+            align = input_vsub[i];
+        if (output_planes[i] != NULL && output_vsub[i] > align)
+            align = output_vsub[i];
+    }
+    /* the chroma of a band is only scaled by the same ratio as the chroma
+     * of the picture if the picture ends on a line of every plane */
+    if (vsize % align)
+        nb_bands = 1;
+    /* lines read by the vertical filter around a band, at the largest
+     * chroma subsampling */
+    size_t margin = (upipe_sws_filter_taps(upipe_sws->flags) + 1) * align;
+    /* overlapping lines start on the first line of the dither matrix */
+    size_t dither = 8 * align;
+
+    for (unsigned int n = 0; n < upipe_sws->nb_bands; n++) {
+        struct upipe_sws_band *band = &upipe_sws->bands[n];
+        size_t start = vsize * n / nb_bands / align * align;
+        size_t end = n + 1 >= nb_bands ? vsize :
+                     vsize * (n + 1) / nb_bands / align * align;
+
+        band->ctx = NULL;
+        band->ret = 0;
+        if (n >= nb_bands || end <= start)
+            continue;
+
+        size_t first = start > margin ?
+                       (start - margin) / dither * dither : 0;
+        size_t last = end + margin < vsize ? end + margin : vsize;
+        if (unlikely(!upipe_sws_prepare_ctx(upipe, &band->convert_ctx[field],
+                                            input_hsize, last - first,
+                                            output_hsize, last - first)))
+            return -1;
+
+        band->ctx = band->convert_ctx[field];
+        band->lines = last - first;
+        band->skip = start - first;
+        band->band_lines = end - start;
+        band->copy = first != start || last != end;
+        band->dest_strides = output_strides;
+        band->dest_vsub = output_vsub;
+
+        size_t scratch_size = 0;
+        for (int i = 0; i < UPIPE_AV_MAX_PLANES; i++) {
+            band->input_planes[i] = input_planes[i] == NULL ? NULL :
+                input_planes[i] + first / input_vsub[i] * input_strides[i];
+            band->dest_planes[i] = output_planes[i] == NULL ? NULL :
+                output_planes[i] + start / output_vsub[i] * output_strides[i];
+            /* a field only uses every other line of the picture */
+            band->output_strides[i] = band->copy ?
+                output_strides[i] >> !!field : output_strides[i];
+            if (output_planes[i] != NULL && band->copy)
+                scratch_size += (band->output_strides[i] * band->lines /
+                                 output_vsub[i] + 63) & ~63;
+        }
+        band->input_planes[UPIPE_AV_MAX_PLANES] = NULL;
+        band->output_planes[UPIPE_AV_MAX_PLANES] = NULL;
+        band->output_strides[UPIPE_AV_MAX_PLANES] = 0;
+        band->input_strides = input_strides;
+
+        if (!band->copy) {
+            for (int i = 0; i < UPIPE_AV_MAX_PLANES; i++)
+                band->output_planes[i] = band->dest_planes[i];
+            continue;
+        }
+
+        if (scratch_size > band->scratch_size) {
+            av_free(band->scratch);
+            band->scratch_size = 0;
+            band->scratch = av_malloc(scratch_size);
+            if (unlikely(band->scratch == NULL)) {
+                upipe_err(upipe, "unable to allocate scratch buffer");
+                band->ctx = NULL;
+                return -1;
+            }
+            band->scratch_size = scratch_size;
+        }
+
+        uint8_t *scratch = band->scratch;
+        for (int i = 0; i < UPIPE_AV_MAX_PLANES; i++) {
+            band->output_planes[i] = output_planes[i] == NULL ? NULL :
+                                     scratch;
+            if (output_planes[i] != NULL)
+                scratch += (band->output_strides[i] * band->lines /
+                            output_vsub[i] + 63) & ~63;
+        }
+    }
+
+    upipe_sws_workers_run(&upipe_sws->workers);
+
+    int lines = 0;
+    for (unsigned int n = 0; n < nb_bands; n++) {
+        struct upipe_sws_band *band = &upipe_sws->bands[n];
+        if (band->ctx == NULL)
+            continue;
+        if (unlikely(band->ret <= 0))
+            return -1;
+        lines += band->band_lines;
+    }
+    return lines;
+}
+
 /** @internal @This handles data.
  *
  * @param upipe description structure of the pipe
@@ -183,48 +540,18 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
         output_vsize = input_vsize;
     }
 
+    /* bands are only used when the number of lines is kept, as vertical
+     * scaling needs lines from the neighbouring bands */
+    bool banded = upipe_sws->nb_bands > 1 && input_vsize == output_vsize;
+
     int i;
-    for (i = 0; i < 3; i++) {
-        upipe_sws->convert_ctx[i] = sws_getCachedContext(upipe_sws->convert_ctx[i],
-                    input_hsize, input_vsize >> !!i, upipe_sws->input_pix_fmt,
-                    output_hsize, output_vsize >> !!i, upipe_sws->output_pix_fmt,
-                    upipe_sws->flags, NULL, NULL, NULL);
-
-        if (unlikely(upipe_sws->convert_ctx[i] == NULL)) {
-            upipe_err(upipe, "sws_getContext failed");
+    for (i = 0; i < 3 && !banded; i++) {
+        if (unlikely(!upipe_sws_prepare_ctx(upipe, &upipe_sws->convert_ctx[i],
+                        input_hsize, input_vsize >> !!i,
+                        output_hsize, output_vsize >> !!i))) {
             uref_free(uref);
             return true;
         }
-
-        if (upipe_sws->colorspace_invalid)
-            continue;
-
-        int in_full, out_full, brightness, contrast, saturation;
-        const int *inv_table, *table;
-
-        if (unlikely(sws_getColorspaceDetails(upipe_sws->convert_ctx[i],
-                        (int **)&inv_table, &in_full, (int **)&table, &out_full,
-                        &brightness, &contrast, &saturation) < 0)) {
-            upipe_warn(upipe, "unable to set color space data");
-            upipe_sws->colorspace_invalid = true;
-            continue;
-        }
-
-        if (upipe_sws->input_colorspace != -1)
-            inv_table = sws_getCoefficients(upipe_sws->input_colorspace);
-        if (upipe_sws->input_color_range != -1)
-            in_full = upipe_sws->input_color_range;
-        if (upipe_sws->output_colorspace != -1)
-            table = sws_getCoefficients(upipe_sws->output_colorspace);
-        if (upipe_sws->output_color_range != -1)
-            out_full = upipe_sws->output_color_range;
-
-        if (unlikely(sws_setColorspaceDetails(upipe_sws->convert_ctx[i],
-                        inv_table, in_full, table, out_full,
-                        brightness, contrast, saturation) < 0)) {
-            upipe_warn(upipe, "unable to set color space data");
-            upipe_sws->colorspace_invalid = true;
-        }
     }
 
     upipe_verbose_va(upipe, "%s -> %s",
@@ -234,6 +561,7 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
     /* map input */
     const uint8_t *input_planes[UPIPE_AV_MAX_PLANES + 1];
     int input_strides[UPIPE_AV_MAX_PLANES + 1];
+    uint8_t input_vsub[UPIPE_AV_MAX_PLANES];
     for (i = 0; i < UPIPE_AV_MAX_PLANES &&
                 upipe_sws->input_chroma_map[i] != NULL; i++) {
         const uint8_t *data;
@@ -243,7 +571,8 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
                                           0, 0, -1, -1, &data)) ||
                      !ubase_check(uref_pic_plane_size(uref,
                                           upipe_sws->input_chroma_map[i],
-                                          &stride, NULL, NULL, NULL)))) {
+                                          &stride, NULL, &input_vsub[i],
+                                          NULL)))) {
             upipe_warn(upipe, "invalid buffer received");
             uref_free(uref);
             return true;
@@ -256,6 +585,7 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
     for ( ; i < UPIPE_AV_MAX_PLANES; i++) {
         input_planes[i] = NULL;
         input_strides[i] = 0;
+        input_vsub[i] = 1;
     }
 
     /* allocate dest ubuf */
@@ -274,6 +604,7 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
     /* map output */
     uint8_t *output_planes[UPIPE_AV_MAX_PLANES + 1];
     int output_strides[UPIPE_AV_MAX_PLANES + 1];
+    uint8_t output_vsub[UPIPE_AV_MAX_PLANES];
     for (i = 0; i < UPIPE_AV_MAX_PLANES &&
                 upipe_sws->output_chroma_map[i] != NULL; i++) {
         uint8_t *data;
@@ -283,7 +614,8 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
                                            0, 0, -1, -1, &data)) ||
                      !ubase_check(ubuf_pic_plane_size(ubuf,
                                           upipe_sws->output_chroma_map[i],
-                                          &stride, NULL, NULL, NULL)))) {
+                                          &stride, NULL, &output_vsub[i],
+                                          NULL)))) {
             upipe_warn(upipe, "invalid buffer received");
             ubuf_free(ubuf);
             uref_free(uref);
@@ -297,11 +629,31 @@ static bool upipe_sws_handle(struct upipe *upipe, struct uref *uref,
     for ( ; i < UPIPE_AV_MAX_PLANES; i++) {
         output_planes[i] = NULL;
         output_strides[i] = 0;
+        output_vsub[i] = 1;
     }
 
     /* fire ! */
     int ret = 0, ret2 = 1;
-    if (progressive) {
+    if (banded) {
+        ret = upipe_sws_scale_bands(upipe, progressive ? 0 : 1,
+                input_hsize, output_hsize, progressive ? input_vsize :
+                (input_vsize + 1) / 2,
+                input_planes, input_strides, input_vsub,
+                output_planes, output_strides, output_vsub);
+
+        if (!progressive) {
+            for (i = 0; i < UPIPE_AV_MAX_PLANES && input_planes[i]; i++)
+                input_planes[i] += input_strides[i] >> 1;
+            for (i = 0; i < UPIPE_AV_MAX_PLANES && output_planes[i]; i++)
+                output_planes[i] += output_strides[i] >> 1;
+
+            ret2 = upipe_sws_scale_bands(upipe, 2,
+                    input_hsize, output_hsize, input_vsize / 2,
+                    input_planes, input_strides, input_vsub,
+                    output_planes, output_strides, output_vsub);
+        }
+    }
+    else if (progressive) {
         ret = sws_scale(upipe_sws->convert_ctx[0],
                         input_planes, input_strides, 0, input_vsize,
                         output_planes, output_strides);
@@ -495,17 +847,9 @@ static int upipe_sws_set_flow_def(struct upipe *upipe, struct uref *flow_def)
         }
     }
 
-    if (upipe_sws->input_pix_fmt == AV_PIX_FMT_YUV420P) {
-        av_opt_set_int(upipe_sws->convert_ctx[0], "src_v_chr_pos", 128, 0);
-        av_opt_set_int(upipe_sws->convert_ctx[1], "src_v_chr_pos", 64, 0);
-        av_opt_set_int(upipe_sws->convert_ctx[2], "src_v_chr_pos", 192, 0);
-    }
-
-    if (upipe_sws->output_pix_fmt == AV_PIX_FMT_YUV420P) {
-        av_opt_set_int(upipe_sws->convert_ctx[0], "dst_v_chr_pos", 128, 0);
-        av_opt_set_int(upipe_sws->convert_ctx[1], "dst_v_chr_pos", 64, 0);
-        av_opt_set_int(upipe_sws->convert_ctx[2], "dst_v_chr_pos", 192, 0);
-    }
+    upipe_sws_set_chroma_pos(upipe, upipe_sws->convert_ctx);
+    for (unsigned int n = 0; n < upipe_sws->nb_bands; n++)
+        upipe_sws_set_chroma_pos(upipe, upipe_sws->bands[n].convert_ctx);
     upipe_sws->colorspace_invalid = false;
 
     upipe_input(upipe, flow_def, NULL);
@@ -539,6 +883,66 @@ static int _upipe_sws_set_flags(struct upipe *upipe, int flags)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This gets the number of threads converting a picture.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads_p filled in with the number of threads
+ * @return an error code
+ */
+static int _upipe_sws_get_threads(struct upipe *upipe,
+                                  unsigned int *threads_p)
+{
+    struct upipe_sws *upipe_sws = upipe_sws_from_upipe(upipe);
+    *threads_p = upipe_sws->threads;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the number of threads converting a picture, and
+ * starts the worker threads.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads number of threads, 0 or 1 for the calling thread only
+ * @return an error code
+ */
+static int _upipe_sws_set_threads(struct upipe *upipe, unsigned int threads)
+{
+    struct upipe_sws *upipe_sws = upipe_sws_from_upipe(upipe);
+    upipe_sws_stop_bands(upipe);
+    upipe_sws->threads = threads;
+    upipe_dbg_va(upipe, "setting threads to %u", threads);
+    if (threads <= 1)
+        return UBASE_ERR_NONE;
+
+    upipe_sws->bands = calloc(threads, sizeof (struct upipe_sws_band));
+    if (unlikely(upipe_sws->bands == NULL)) {
+        upipe_sws->threads = 0;
+        return UBASE_ERR_ALLOC;
+    }
+
+    for (unsigned int n = 0; n < threads; n++) {
+        struct upipe_sws_band *band = &upipe_sws->bands[n];
+        for (int i = 0; i < 3; i++) {
+            band->convert_ctx[i] = sws_alloc_context();
+            if (unlikely(band->convert_ctx[i] == NULL)) {
+                upipe_sws_stop_bands(upipe);
+                upipe_sws->threads = 0;
+                return UBASE_ERR_ALLOC;
+            }
+        }
+        upipe_sws_set_chroma_pos(upipe, band->convert_ctx);
+    }
+    upipe_sws->nb_bands = threads;
+
+    if (unlikely(!upipe_sws_workers_start(&upipe_sws->workers,
+                                          threads - 1))) {
+        upipe_err(upipe, "unable to start worker threads");
+        upipe_sws_stop_bands(upipe);
+        upipe_sws->threads = 0;
+        return UBASE_ERR_EXTERNAL;
+    }
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes control commands on a file source pipe, and
  * checks the status of the pipe afterwards.
  *
@@ -586,6 +990,16 @@ static int upipe_sws_control(struct upipe *upipe, int command, va_list args)
             int flags = va_arg(args, int);
             return _upipe_sws_set_flags(upipe, flags);
         }
+        case UPIPE_SWS_GET_THREADS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_SWS_SIGNATURE)
+            unsigned int *threads_p = va_arg(args, unsigned int *);
+            return _upipe_sws_get_threads(upipe, threads_p);
+        }
+        case UPIPE_SWS_SET_THREADS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_SWS_SIGNATURE)
+            unsigned int threads = va_arg(args, unsigned int);
+            return _upipe_sws_set_threads(upipe, threads);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -625,6 +1039,12 @@ static struct upipe *upipe_sws_alloc(struct upipe_mgr *mgr,
     upipe_sws_init_flow_def(upipe);
     upipe_sws_init_input(upipe);
     upipe_sws->colorspace_invalid = false;
+    upipe_sws->input_pix_fmt = AV_PIX_FMT_NONE;
+    upipe_sws->threads = 0;
+    upipe_sws->bands = NULL;
+    upipe_sws->nb_bands = 0;
+    upipe_sws_workers_init(&upipe_sws->workers, upipe_sws_band_cb,
+                           upipe_sws);
 
     memset(upipe_sws->convert_ctx, 0, sizeof(upipe_sws->convert_ctx));
     for (int i = 0; i < 3; i++) {
@@ -651,6 +1071,7 @@ fail:
             sws_freeContext(upipe_sws->convert_ctx[i]);
         upipe_sws->convert_ctx[i] = NULL;
     }
+    upipe_sws_workers_clean(&upipe_sws->workers);
     uref_free(flow_def);
     upipe_sws_free_flow(upipe);
     return NULL;
@@ -668,6 +1089,8 @@ static void upipe_sws_free(struct upipe *upipe)
             sws_freeContext(upipe_sws->convert_ctx[i]);
         upipe_sws->convert_ctx[i] = NULL;
     }
+    upipe_sws_stop_bands(upipe);
+    upipe_sws_workers_clean(&upipe_sws->workers);
 
     upipe_throw_dead(upipe);
     upipe_sws_clean_input(upipe);
@@ -0,0 +1,912 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe swscale module scaling a picture to several sizes
+ */
+
+#include "upipe/ulist.h"
+#include "upipe/uprobe.h"
+#include "upipe/uref.h"
+#include "upipe/ubuf.h"
+#include "upipe/upipe.h"
+#include "upipe/uref_flow.h"
+#include "upipe/uref_pic.h"
+#include "upipe/uref_pic_flow.h"
+#include "upipe/uref_dump.h"
+#include "upipe/upipe_helper_upipe.h"
+#include "upipe/upipe_helper_urefcount.h"
+#include "upipe/upipe_helper_void.h"
+#include "upipe/upipe_helper_flow.h"
+#include "upipe/upipe_helper_output.h"
+#include "upipe/upipe_helper_subpipe.h"
+#include "upipe/upipe_helper_ubuf_mgr.h"
+#include "upipe-swscale/upipe_sws_multi.h"
+#include "upipe-av/upipe_av_pixfmt.h"
+#include "upipe_sws_workers.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+
+/** @internal @This is the private context of a swscale multi pipe. */
+struct upipe_sws_multi {
+    /** real refcount management structure */
+    struct urefcount urefcount_real;
+    /** refcount management structure exported to the public structure */
+    struct urefcount urefcount;
+
+    /** list of output subpipes, sorted by decreasing size */
+    struct uchain outputs;
+    /** input flow definition packet */
+    struct uref *flow_def;
+    /** input pixel format */
+    enum AVPixelFormat pix_fmt;
+    /** chroma map */
+    const char *chroma_map[UPIPE_AV_MAX_PLANES];
+    /** swscale flags */
+    int flags;
+
+    /** outputs scaled for the current picture */
+    struct upipe_sws_multi_sub **jobs;
+    /** number of outputs scaled for the current picture */
+    unsigned int nb_jobs;
+    /** allocated size of the jobs array */
+    unsigned int jobs_size;
+
+    /** number of threads scaling the outputs */
+    unsigned int threads;
+    /** worker threads scaling the outputs with the calling thread */
+    struct upipe_sws_workers workers;
+    /** mutex protecting the fields below */
+    pthread_mutex_t mutex;
+    /** cascade level being scaled */
+    unsigned int level;
+    /** next job to consider */
+    unsigned int next_job;
+
+    /** manager to create output subpipes */
+    struct upipe_mgr sub_mgr;
+
+    /** public upipe structure */
+    struct upipe upipe;
+};
+
+UPIPE_HELPER_UPIPE(upipe_sws_multi, upipe, UPIPE_SWS_MULTI_SIGNATURE)
+UPIPE_HELPER_UREFCOUNT(upipe_sws_multi, urefcount, upipe_sws_multi_no_input)
+UPIPE_HELPER_VOID(upipe_sws_multi)
+
+UBASE_FROM_TO(upipe_sws_multi, urefcount, urefcount_real, urefcount_real)
+
+/** @hidden */
+static void upipe_sws_multi_free(struct urefcount *urefcount_real);
+
+/** @internal @This is the private context of an output of a swscale multi
+ * pipe. */
+struct upipe_sws_multi_sub {
+    /** refcount management structure */
+    struct urefcount urefcount;
+    /** structure for double-linked lists */
+    struct uchain uchain;
+
+    /** pipe acting as output */
+    struct upipe *output;
+    /** flow definition packet */
+    struct uref *flow_def;
+    /** output state */
+    enum upipe_helper_output_state output_state;
+    /** list of output requests */
+    struct uchain request_list;
+
+    /** ubuf manager */
+    struct ubuf_mgr *ubuf_mgr;
+    /** flow format packet */
+    struct uref *flow_format;
+    /** ubuf manager request */
+    struct urequest ubuf_mgr_request;
+
+    /** output horizontal size */
+    uint64_t hsize;
+    /** output vertical size */
+    uint64_t vsize;
+    /** swscale contexts [0] for progressive, [1,2] interlaced */
+    struct SwsContext *convert_ctx[3];
+
+    /** output buffer of the current picture */
+    struct ubuf *ubuf;
+    /** output the current picture is scaled from, or NULL for the source */
+    struct upipe_sws_multi_sub *source;
+    /** cascade level of the current picture, 0 if scaled from the source */
+    unsigned int level;
+    /** true if the current picture is progressive */
+    bool progressive;
+    /** source planes */
+    const uint8_t *src_planes[UPIPE_AV_MAX_PLANES + 1];
+    /** source strides */
+    int src_strides[UPIPE_AV_MAX_PLANES + 1];
+    /** source vertical size */
+    size_t src_vsize;
+    /** output planes */
+    uint8_t *planes[UPIPE_AV_MAX_PLANES + 1];
+    /** output strides */
+    int strides[UPIPE_AV_MAX_PLANES + 1];
+    /** result of the conversion */
+    bool ok;
+
+    /** public upipe structure */
+    struct upipe upipe;
+};
+
+/** @hidden */
+static int upipe_sws_multi_sub_check(struct upipe *upipe,
+                                     struct uref *flow_format);
+
+UPIPE_HELPER_UPIPE(upipe_sws_multi_sub, upipe,
+                   UPIPE_SWS_MULTI_OUTPUT_SIGNATURE)
+UPIPE_HELPER_UREFCOUNT(upipe_sws_multi_sub, urefcount,
+                       upipe_sws_multi_sub_free)
+UPIPE_HELPER_OUTPUT(upipe_sws_multi_sub, output, flow_def, output_state,
+                    request_list)
+UPIPE_HELPER_FLOW(upipe_sws_multi_sub, "pic.")
+UPIPE_HELPER_UBUF_MGR(upipe_sws_multi_sub, ubuf_mgr, flow_format,
+                      ubuf_mgr_request,
+                      upipe_sws_multi_sub_check,
+                      upipe_sws_multi_sub_register_output_request,
+                      upipe_sws_multi_sub_unregister_output_request)
+
+UPIPE_HELPER_SUBPIPE(upipe_sws_multi, upipe_sws_multi_sub, output,
+                     sub_mgr, outputs, uchain)
+
+/** @internal @This receives the result of ubuf manager requests.
+ *
+ * @param upipe description structure of the subpipe
+ * @param flow_format amended flow format
+ * @return an error code
+ */
+static int upipe_sws_multi_sub_check(struct upipe *upipe,
+                                     struct uref *flow_format)
+{
+    if (flow_format != NULL)
+        upipe_sws_multi_sub_store_flow_def(upipe, flow_format);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the chroma positions of the swscale contexts of a
+ * subpipe, the second and third contexts scaling the top and bottom fields.
+ *
+ * @param upipe description structure of the subpipe
+ */
+static void upipe_sws_multi_sub_set_chroma_pos(struct upipe *upipe)
+{
+    struct upipe_sws_multi_sub *sub = upipe_sws_multi_sub_from_upipe(upipe);
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_sub_mgr(upipe->mgr);
+    if (multi->pix_fmt != AV_PIX_FMT_YUV420P)
+        return;
+
+    static const int chr_pos[3] = { 128, 64, 192 };
+    for (int i = 0; i < 3; i++) {
+        if (sub->convert_ctx[i] == NULL)
+            continue;
+        av_opt_set_int(sub->convert_ctx[i], "src_v_chr_pos", chr_pos[i], 0);
+        av_opt_set_int(sub->convert_ctx[i], "dst_v_chr_pos", chr_pos[i], 0);
+    }
+}
+
+/** @internal @This builds the subpipe flow definition from the input flow
+ * definition.
+ *
+ * @param upipe description structure of the subpipe
+ */
+static void upipe_sws_multi_sub_build_flow_def(struct upipe *upipe)
+{
+    struct upipe_sws_multi_sub *sub = upipe_sws_multi_sub_from_upipe(upipe);
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_sub_mgr(upipe->mgr);
+    if (multi->flow_def == NULL)
+        return;
+
+    if (sub->ubuf_mgr) {
+        ubuf_mgr_release(sub->ubuf_mgr);
+        sub->ubuf_mgr = NULL;
+    }
+
+    struct uref *flow_def = uref_dup(multi->flow_def);
+    if (unlikely(flow_def == NULL)) {
+        upipe_throw_error(upipe, UBASE_ERR_ALLOC);
+        return;
+    }
+
+    uint64_t input_hsize, input_vsize;
+    if (ubase_check(uref_pic_flow_get_hsize(flow_def, &input_hsize)) &&
+        ubase_check(uref_pic_flow_get_vsize(flow_def, &input_vsize))) {
+        uint64_t hsize_visible;
+        if (ubase_check(uref_pic_flow_get_hsize_visible(flow_def,
+                                                        &hsize_visible)))
+            UBASE_ERROR(upipe, uref_pic_flow_set_hsize_visible(flow_def,
+                        hsize_visible * sub->hsize / input_hsize))
+
+        uint64_t vsize_visible;
+        if (ubase_check(uref_pic_flow_get_vsize_visible(flow_def,
+                                                        &vsize_visible)))
+            UBASE_ERROR(upipe, uref_pic_flow_set_vsize_visible(flow_def,
+                        vsize_visible * sub->vsize / input_vsize))
+
+        struct urational sar;
+        if (ubase_check(uref_pic_flow_get_sar(flow_def, &sar))) {
+            sar.num *= input_hsize * sub->vsize;
+            sar.den *= input_vsize * sub->hsize;
+            urational_simplify(&sar);
+            UBASE_ERROR(upipe, uref_pic_flow_set_sar(flow_def, sar))
+        }
+    }
+    UBASE_ERROR(upipe, uref_pic_flow_set_hsize(flow_def, sub->hsize))
+    UBASE_ERROR(upipe, uref_pic_flow_set_vsize(flow_def, sub->vsize))
+
+    uint64_t align = 16;
+    if (!ubase_check(uref_pic_flow_get_align(flow_def, &align)) ||
+        align % 16)
+        UBASE_ERROR(upipe, uref_pic_flow_set_align(flow_def, 16))
+
+    upipe_sws_multi_sub_demand_ubuf_mgr(upipe, flow_def);
+}
+
+/** @internal @This allocates an output subpipe of a swscale multi pipe.
+ *
+ * @param mgr common management structure
+ * @param uprobe structure used to raise events
+ * @param signature signature of the pipe allocator
+ * @param args optional arguments
+ * @return pointer to upipe or NULL in case of allocation error
+ */
+static struct upipe *upipe_sws_multi_sub_alloc(struct upipe_mgr *mgr,
+                                               struct uprobe *uprobe,
+                                               uint32_t signature,
+                                               va_list args)
+{
+    struct uref *flow_def;
+    struct upipe *upipe = upipe_sws_multi_sub_alloc_flow(mgr,
+                            uprobe, signature, args, &flow_def);
+    if (unlikely(upipe == NULL))
+        return NULL;
+
+    struct upipe_sws_multi_sub *sub = upipe_sws_multi_sub_from_upipe(upipe);
+    if (unlikely(!ubase_check(uref_pic_flow_get_hsize(flow_def,
+                                                      &sub->hsize)) ||
+                 !ubase_check(uref_pic_flow_get_vsize(flow_def,
+                                                      &sub->vsize)) ||
+                 !sub->hsize || !sub->vsize)) {
+        uref_free(flow_def);
+        upipe_sws_multi_sub_free_flow(upipe);
+        return NULL;
+    }
+    uref_free(flow_def);
+
+    for (int i = 0; i < 3; i++) {
+        sub->convert_ctx[i] = sws_alloc_context();
+        if (unlikely(sub->convert_ctx[i] == NULL)) {
+            while (--i >= 0)
+                sws_freeContext(sub->convert_ctx[i]);
+            upipe_sws_multi_sub_free_flow(upipe);
+            return NULL;
+        }
+    }
+    sub->ubuf = NULL;
+    sub->source = NULL;
+    sub->level = 0;
+
+    upipe_sws_multi_sub_init_urefcount(upipe);
+    upipe_sws_multi_sub_init_output(upipe);
+    upipe_sws_multi_sub_init_ubuf_mgr(upipe);
+    upipe_sws_multi_sub_init_sub(upipe);
+
+    /* keep the outputs sorted by decreasing size */
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_sub_mgr(mgr);
+    struct uchain *uchain;
+    ulist_delete(&sub->uchain);
+    ulist_foreach (&multi->outputs, uchain) {
+        struct upipe_sws_multi_sub *other =
+            upipe_sws_multi_sub_from_uchain(uchain);
+        if (other->hsize * other->vsize < sub->hsize * sub->vsize)
+            break;
+    }
+    ulist_insert(uchain->prev, uchain, &sub->uchain);
+
+    upipe_throw_ready(upipe);
+    upipe_sws_multi_sub_set_chroma_pos(upipe);
+    upipe_sws_multi_sub_build_flow_def(upipe);
+    return upipe;
+}
+
+/** @internal @This processes control commands on an output subpipe of a
+ * swscale multi pipe.
+ *
+ * @param upipe description structure of the subpipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upipe_sws_multi_sub_control(struct upipe *upipe,
+                                       int command, va_list args)
+{
+    UBASE_HANDLED_RETURN(
+        upipe_sws_multi_sub_control_super(upipe, command, args));
+    switch (command) {
+        case UPIPE_GET_FLOW_DEF:
+        case UPIPE_GET_OUTPUT:
+        case UPIPE_SET_OUTPUT:
+            return upipe_sws_multi_sub_control_output(upipe, command, args);
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @This frees a subpipe.
+ *
+ * @param upipe description structure of the subpipe
+ */
+static void upipe_sws_multi_sub_free(struct upipe *upipe)
+{
+    struct upipe_sws_multi_sub *sub = upipe_sws_multi_sub_from_upipe(upipe);
+    upipe_throw_dead(upipe);
+
+    for (int i = 0; i < 3; i++)
+        if (sub->convert_ctx[i] != NULL)
+            sws_freeContext(sub->convert_ctx[i]);
+    upipe_sws_multi_sub_clean_output(upipe);
+    upipe_sws_multi_sub_clean_sub(upipe);
+    upipe_sws_multi_sub_clean_ubuf_mgr(upipe);
+    upipe_sws_multi_sub_clean_urefcount(upipe);
+    upipe_sws_multi_sub_free_flow(upipe);
+}
+
+/** @internal @This initializes the output manager for a swscale multi pipe.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_sws_multi_init_sub_mgr(struct upipe *upipe)
+{
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    struct upipe_mgr *sub_mgr = &multi->sub_mgr;
+    sub_mgr->refcount = upipe_sws_multi_to_urefcount_real(multi);
+    sub_mgr->signature = UPIPE_SWS_MULTI_OUTPUT_SIGNATURE;
+    sub_mgr->upipe_alloc = upipe_sws_multi_sub_alloc;
+    sub_mgr->upipe_control = upipe_sws_multi_sub_control;
+}
+
+/** @internal @This scales the current picture of an output.
+ *
+ * @param sub description structure of the output
+ */
+static void upipe_sws_multi_sub_scale(struct upipe_sws_multi_sub *sub)
+{
+    if (sub->source != NULL && !sub->source->ok) {
+        sub->ok = false;
+        return;
+    }
+
+    if (sub->progressive) {
+        sub->ok = sws_scale(sub->convert_ctx[0],
+                            sub->src_planes, sub->src_strides,
+                            0, sub->src_vsize,
+                            sub->planes, sub->strides) > 0;
+        return;
+    }
+
+    const uint8_t *src_planes[UPIPE_AV_MAX_PLANES + 1];
+    uint8_t *planes[UPIPE_AV_MAX_PLANES + 1];
+    for (int i = 0; i < UPIPE_AV_MAX_PLANES + 1; i++) {
+        src_planes[i] = sub->src_planes[i];
+        planes[i] = sub->planes[i];
+    }
+
+    int ret = sws_scale(sub->convert_ctx[1], src_planes, sub->src_strides,
+                        0, (sub->src_vsize + 1) / 2,
+                        planes, sub->strides);
+
+    for (int i = 0; i < UPIPE_AV_MAX_PLANES && src_planes[i]; i++)
+        src_planes[i] += sub->src_strides[i] >> 1;
+    for (int i = 0; i < UPIPE_AV_MAX_PLANES && planes[i]; i++)
+        planes[i] += sub->strides[i] >> 1;
+
+    int ret2 = sws_scale(sub->convert_ctx[2], src_planes, sub->src_strides,
+                         0, sub->src_vsize / 2,
+                         planes, sub->strides);
+    sub->ok = ret > 0 && ret2 > 0;
+}
+
+/** @internal @This returns the next output to scale at the current level.
+ * It must be called with the mutex held.
+ *
+ * @param multi description structure of the pipe
+ * @return pointer to the output, or NULL if there is none left
+ */
+static struct upipe_sws_multi_sub *
+    upipe_sws_multi_next_job(struct upipe_sws_multi *multi)
+{
+    while (multi->next_job < multi->nb_jobs) {
+        struct upipe_sws_multi_sub *sub = multi->jobs[multi->next_job++];
+        if (sub->level == multi->level)
+            return sub;
+    }
+    return NULL;
+}
+
+/** @internal @This scales outputs of the current level until there is none
+ * left.
+ *
+ * @param multi description structure of the pipe
+ */
+static void upipe_sws_multi_work(struct upipe_sws_multi *multi)
+{
+    struct upipe_sws_multi_sub *sub;
+    pthread_mutex_lock(&multi->mutex);
+    while ((sub = upipe_sws_multi_next_job(multi)) != NULL) {
+        pthread_mutex_unlock(&multi->mutex);
+        upipe_sws_multi_sub_scale(sub);
+        pthread_mutex_lock(&multi->mutex);
+    }
+    pthread_mutex_unlock(&multi->mutex);
+}
+
+/** @internal @This scales outputs of the current level on a thread of the
+ * pool.
+ *
+ * @param opaque description structure of the pipe
+ * @param index index of the thread
+ */
+static void upipe_sws_multi_work_cb(void *opaque, unsigned int index)
+{
+    upipe_sws_multi_work(opaque);
+}
+
+/** @internal @This scales the outputs of a cascade level, in parallel with
+ * the worker threads.
+ *
+ * @param upipe description structure of the pipe
+ * @param level cascade level
+ */
+static void upipe_sws_multi_run(struct upipe *upipe, unsigned int level)
+{
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+
+    pthread_mutex_lock(&multi->mutex);
+    multi->level = level;
+    multi->next_job = 0;
+    pthread_mutex_unlock(&multi->mutex);
+
+    upipe_sws_workers_run(&multi->workers);
+}
+
+/** @internal @This prepares an output for the current picture: it chooses
+ * the source, allocates and maps the output buffer and sets up the swscale
+ * contexts.
+ *
+ * @param upipe description structure of the pipe
+ * @param sub description structure of the output
+ * @param hsize source picture horizontal size
+ * @param vsize source picture vertical size
+ * @param progressive true if the picture is progressive
+ * @param planes source picture planes
+ * @param strides source picture strides
+ * @return false if the output is skipped
+ */
+static bool upipe_sws_multi_prepare(struct upipe *upipe,
+                                    struct upipe_sws_multi_sub *sub,
+                                    size_t hsize, size_t vsize,
+                                    bool progressive,
+                                    const uint8_t *const planes[],
+                                    const int strides[])
+{
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    struct upipe *upipe_sub = upipe_sws_multi_sub_to_upipe(sub);
+    if (unlikely(sub->ubuf_mgr == NULL || sub->flow_def == NULL))
+        return false;
+
+    /* cascade from the smallest output at least twice as large */
+    struct upipe_sws_multi_sub *source = NULL;
+    for (unsigned int j = 0; j < multi->nb_jobs; j++) {
+        struct upipe_sws_multi_sub *job = multi->jobs[j];
+        if (job->hsize >= 2 * sub->hsize && job->vsize >= 2 * sub->vsize &&
+            (source == NULL ||
+             job->hsize * job->vsize < source->hsize * source->vsize))
+            source = job;
+    }
+
+    size_t src_hsize = hsize, src_vsize = vsize;
+    if (source != NULL) {
+        upipe_verbose_va(upipe_sub, "scaling from %"PRIu64"x%"PRIu64,
+                         source->hsize, source->vsize);
+        src_hsize = source->hsize;
+        src_vsize = source->vsize;
+        planes = (const uint8_t *const *)source->planes;
+        strides = source->strides;
+        sub->level = source->level + 1;
+    } else
+        sub->level = 0;
+    sub->source = source;
+
+    for (int i = progressive ? 0 : 1; i < (progressive ? 1 : 3); i++) {
+        sub->convert_ctx[i] = sws_getCachedContext(sub->convert_ctx[i],
+                src_hsize, src_vsize >> !!i, multi->pix_fmt,
+                sub->hsize, sub->vsize >> !!i, multi->pix_fmt,
+                multi->flags, NULL, NULL, NULL);
+        if (unlikely(sub->convert_ctx[i] == NULL)) {
+            upipe_err(upipe_sub, "sws_getContext failed");
+            return false;
+        }
+    }
+
+    sub->ubuf = ubuf_pic_alloc(sub->ubuf_mgr, sub->hsize, sub->vsize);
+    if (unlikely(sub->ubuf == NULL)) {
+        upipe_throw_error(upipe_sub, UBASE_ERR_ALLOC);
+        return false;
+    }
+
+    int i;
+    for (i = 0; i < UPIPE_AV_MAX_PLANES && multi->chroma_map[i] != NULL;
+         i++) {
+        uint8_t *data;
+        size_t stride;
+        if (unlikely(!ubase_check(ubuf_pic_plane_write(sub->ubuf,
+                            multi->chroma_map[i], 0, 0, -1, -1, &data)) ||
+                     !ubase_check(ubuf_pic_plane_size(sub->ubuf,
+                            multi->chroma_map[i], &stride,
+                            NULL, NULL, NULL)))) {
+            upipe_warn(upipe_sub, "unable to map output buffer");
+            while (--i >= 0)
+                ubuf_pic_plane_unmap(sub->ubuf, multi->chroma_map[i],
+                                     0, 0, -1, -1);
+            ubuf_free(sub->ubuf);
+            sub->ubuf = NULL;
+            return false;
+        }
+        sub->planes[i] = data;
+        sub->strides[i] = stride * (1 + !progressive);
+        sub->src_planes[i] = planes[i];
+        sub->src_strides[i] = strides[i];
+    }
+    for ( ; i < UPIPE_AV_MAX_PLANES + 1; i++) {
+        sub->planes[i] = NULL;
+        sub->strides[i] = 0;
+        sub->src_planes[i] = NULL;
+        sub->src_strides[i] = 0;
+    }
+    sub->src_vsize = src_vsize;
+    sub->progressive = progressive;
+    sub->ok = false;
+    return true;
+}
+
+/** @internal @This allocates a swscale multi pipe.
+ *
+ * @param mgr common management structure
+ * @param uprobe structure used to raise events
+ * @param signature signature of the pipe allocator
+ * @param args optional arguments
+ * @return pointer to upipe or NULL in case of allocation error
+ */
+static struct upipe *upipe_sws_multi_alloc(struct upipe_mgr *mgr,
+                                           struct uprobe *uprobe,
+                                           uint32_t signature, va_list args)
+{
+    struct upipe *upipe = upipe_sws_multi_alloc_void(mgr, uprobe, signature,
+                                                     args);
+    if (unlikely(upipe == NULL))
+        return NULL;
+
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    upipe_sws_multi_init_urefcount(upipe);
+    urefcount_init(upipe_sws_multi_to_urefcount_real(multi),
+                   upipe_sws_multi_free);
+    upipe_sws_multi_init_sub_outputs(upipe);
+    upipe_sws_multi_init_sub_mgr(upipe);
+    multi->flow_def = NULL;
+    multi->pix_fmt = AV_PIX_FMT_NONE;
+    multi->flags = SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND | SWS_LANCZOS;
+    multi->jobs = NULL;
+    multi->nb_jobs = 0;
+    multi->jobs_size = 0;
+    multi->threads = 0;
+    upipe_sws_workers_init(&multi->workers, upipe_sws_multi_work_cb, multi);
+    pthread_mutex_init(&multi->mutex, NULL);
+    multi->level = 0;
+    multi->next_job = 0;
+    upipe_throw_ready(upipe);
+    return upipe;
+}
+
+/** @internal @This receives data.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_sws_multi_input(struct upipe *upipe, struct uref *uref,
+                                  struct upump **upump_p)
+{
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    if (unlikely(multi->flow_def == NULL)) {
+        upipe_warn(upipe, "received buffer before flow definition");
+        uref_free(uref);
+        return;
+    }
+
+    size_t hsize, vsize;
+    if (unlikely(!ubase_check(uref_pic_size(uref, &hsize, &vsize, NULL)))) {
+        upipe_warn(upipe, "invalid buffer received");
+        uref_free(uref);
+        return;
+    }
+
+    bool progressive = uref_pic_check_progressive(uref);
+    if (unlikely(!progressive && vsize % 2)) {
+        upipe_warn(upipe, "interlaced picture has odd vertical size");
+        progressive = true;
+    }
+
+    unsigned int nb_outputs = ulist_depth(&multi->outputs);
+    if (unlikely(nb_outputs > multi->jobs_size)) {
+        struct upipe_sws_multi_sub **jobs =
+            realloc(multi->jobs, nb_outputs * sizeof (*jobs));
+        if (unlikely(jobs == NULL)) {
+            uref_free(uref);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        multi->jobs = jobs;
+        multi->jobs_size = nb_outputs;
+    }
+
+    /* map input once for all outputs */
+    const uint8_t *planes[UPIPE_AV_MAX_PLANES + 1];
+    int strides[UPIPE_AV_MAX_PLANES + 1];
+    int i;
+    for (i = 0; i < UPIPE_AV_MAX_PLANES && multi->chroma_map[i] != NULL;
+         i++) {
+        size_t stride;
+        if (unlikely(!ubase_check(uref_pic_plane_read(uref,
+                            multi->chroma_map[i], 0, 0, -1, -1,
+                            &planes[i])) ||
+                     !ubase_check(uref_pic_plane_size(uref,
+                            multi->chroma_map[i], &stride,
+                            NULL, NULL, NULL)))) {
+            upipe_warn(upipe, "invalid buffer received");
+            while (--i >= 0)
+                uref_pic_plane_unmap(uref, multi->chroma_map[i],
+                                     0, 0, -1, -1);
+            uref_free(uref);
+            return;
+        }
+        strides[i] = stride * (1 + !progressive);
+    }
+    for ( ; i < UPIPE_AV_MAX_PLANES + 1; i++) {
+        planes[i] = NULL;
+        strides[i] = 0;
+    }
+
+    /* outputs are sorted by decreasing size, so that the sources of a
+     * cascade are prepared first */
+    unsigned int nb_levels = 0;
+    struct uchain *uchain;
+    multi->nb_jobs = 0;
+    ulist_foreach (&multi->outputs, uchain) {
+        struct upipe_sws_multi_sub *sub =
+            upipe_sws_multi_sub_from_uchain(uchain);
+        if (!upipe_sws_multi_prepare(upipe, sub, hsize, vsize, progressive,
+                                     planes, strides))
+            continue;
+        multi->jobs[multi->nb_jobs++] = sub;
+        if (sub->level + 1 > nb_levels)
+            nb_levels = sub->level + 1;
+    }
+
+    for (unsigned int level = 0; level < nb_levels; level++)
+        upipe_sws_multi_run(upipe, level);
+
+    for (i = 0; i < UPIPE_AV_MAX_PLANES && multi->chroma_map[i] != NULL; i++)
+        uref_pic_plane_unmap(uref, multi->chroma_map[i], 0, 0, -1, -1);
+
+    for (unsigned int j = 0; j < multi->nb_jobs; j++) {
+        struct upipe_sws_multi_sub *sub = multi->jobs[j];
+        struct upipe *upipe_sub = upipe_sws_multi_sub_to_upipe(sub);
+        struct ubuf *ubuf = sub->ubuf;
+        sub->ubuf = NULL;
+        for (i = 0; i < UPIPE_AV_MAX_PLANES && multi->chroma_map[i] != NULL;
+             i++)
+            ubuf_pic_plane_unmap(ubuf, multi->chroma_map[i], 0, 0, -1, -1);
+
+        if (unlikely(!sub->ok)) {
+            upipe_warn(upipe_sub, "error during sws conversion");
+            ubuf_free(ubuf);
+            continue;
+        }
+
+        struct uref *output = uref_dup(uref);
+        if (unlikely(output == NULL)) {
+            ubuf_free(ubuf);
+            upipe_throw_error(upipe_sub, UBASE_ERR_ALLOC);
+            continue;
+        }
+        uref_attach_ubuf(output, ubuf);
+        upipe_sws_multi_sub_output(upipe_sub, output, upump_p);
+    }
+    multi->nb_jobs = 0;
+    uref_free(uref);
+}
+
+/** @internal @This sets the input flow definition, and rebuilds the flow
+ * definitions of all outputs.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def new flow definition
+ * @return an error code
+ */
+static int upipe_sws_multi_set_flow_def(struct upipe *upipe,
+                                        struct uref *flow_def)
+{
+    if (flow_def == NULL)
+        return UBASE_ERR_INVALID;
+
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    UBASE_RETURN(uref_flow_match_def(flow_def, "pic."))
+    const char *chroma_map[UPIPE_AV_MAX_PLANES];
+    enum AVPixelFormat pix_fmt =
+        upipe_av_pixfmt_from_flow_def(flow_def, NULL, chroma_map);
+    if (pix_fmt == AV_PIX_FMT_NONE || !sws_isSupportedInput(pix_fmt) ||
+        !sws_isSupportedOutput(pix_fmt)) {
+        upipe_err(upipe, "incompatible flow def");
+        uref_dump(flow_def, upipe->uprobe);
+        return UBASE_ERR_EXTERNAL;
+    }
+
+    struct uref *flow_def_dup = uref_dup(flow_def);
+    UBASE_ALLOC_RETURN(flow_def_dup);
+    uref_free(multi->flow_def);
+    multi->flow_def = flow_def_dup;
+    multi->pix_fmt = pix_fmt;
+    for (int i = 0; i < UPIPE_AV_MAX_PLANES; i++)
+        multi->chroma_map[i] = chroma_map[i];
+
+    struct uchain *uchain;
+    ulist_foreach (&multi->outputs, uchain) {
+        struct upipe_sws_multi_sub *sub =
+            upipe_sws_multi_sub_from_uchain(uchain);
+        upipe_sws_multi_sub_set_chroma_pos(upipe_sws_multi_sub_to_upipe(sub));
+        upipe_sws_multi_sub_build_flow_def(upipe_sws_multi_sub_to_upipe(sub));
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the number of threads scaling the outputs, and
+ * starts the worker threads.
+ *
+ * @param upipe description structure of the pipe
+ * @param threads number of threads, 0 or 1 for the calling thread only
+ * @return an error code
+ */
+static int _upipe_sws_multi_set_threads(struct upipe *upipe,
+                                        unsigned int threads)
+{
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    multi->threads = threads;
+    upipe_dbg_va(upipe, "setting threads to %u", threads);
+    if (unlikely(!upipe_sws_workers_start(&multi->workers,
+                                          threads > 1 ? threads - 1 : 0))) {
+        upipe_err(upipe, "unable to start worker threads");
+        multi->threads = 0;
+        return UBASE_ERR_EXTERNAL;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This processes control commands on a swscale multi pipe.
+ *
+ * @param upipe description structure of the pipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upipe_sws_multi_control(struct upipe *upipe,
+                                   int command, va_list args)
+{
+    UBASE_HANDLED_RETURN(
+        upipe_sws_multi_control_outputs(upipe, command, args));
+
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    switch (command) {
+        case UPIPE_REGISTER_REQUEST:
+        case UPIPE_UNREGISTER_REQUEST:
+            return upipe_control_provide_request(upipe, command, args);
+
+        case UPIPE_SET_FLOW_DEF: {
+            struct uref *uref = va_arg(args, struct uref *);
+            return upipe_sws_multi_set_flow_def(upipe, uref);
+        }
+
+        case UPIPE_SWS_MULTI_GET_FLAGS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_SWS_MULTI_SIGNATURE)
+            int *flags_p = va_arg(args, int *);
+            *flags_p = multi->flags;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_SWS_MULTI_SET_FLAGS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_SWS_MULTI_SIGNATURE)
+            multi->flags = va_arg(args, int);
+            upipe_dbg_va(upipe, "setting flags to %d", multi->flags);
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_SWS_MULTI_GET_THREADS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_SWS_MULTI_SIGNATURE)
+            unsigned int *threads_p = va_arg(args, unsigned int *);
+            *threads_p = multi->threads;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_SWS_MULTI_SET_THREADS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_SWS_MULTI_SIGNATURE)
+            unsigned int threads = va_arg(args, unsigned int);
+            return _upipe_sws_multi_set_threads(upipe, threads);
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @This frees a upipe.
+ *
+ * @param urefcount_real pointer to urefcount_real structure
+ */
+static void upipe_sws_multi_free(struct urefcount *urefcount_real)
+{
+    struct upipe_sws_multi *multi =
+        upipe_sws_multi_from_urefcount_real(urefcount_real);
+    struct upipe *upipe = upipe_sws_multi_to_upipe(multi);
+    upipe_throw_dead(upipe);
+    upipe_sws_workers_clean(&multi->workers);
+    pthread_mutex_destroy(&multi->mutex);
+    free(multi->jobs);
+    upipe_sws_multi_clean_sub_outputs(upipe);
+    uref_free(multi->flow_def);
+    urefcount_clean(urefcount_real);
+    upipe_sws_multi_clean_urefcount(upipe);
+    upipe_sws_multi_free_void(upipe);
+}
+
+/** @This is called when there is no external reference to the pipe anymore.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_sws_multi_no_input(struct upipe *upipe)
+{
+    struct upipe_sws_multi *multi = upipe_sws_multi_from_upipe(upipe);
+    upipe_sws_multi_throw_sub_outputs(upipe, UPROBE_SOURCE_END);
+    urefcount_release(upipe_sws_multi_to_urefcount_real(multi));
+}
+
+/** swscale multi module manager static descriptor */
+static struct upipe_mgr upipe_sws_multi_mgr = {
+    .refcount = NULL,
+    .signature = UPIPE_SWS_MULTI_SIGNATURE,
+
+    .upipe_alloc = upipe_sws_multi_alloc,
+    .upipe_input = upipe_sws_multi_input,
+    .upipe_control = upipe_sws_multi_control,
+
+    .upipe_mgr_control = NULL
+};
+
+/** @This returns the management structure for all swscale multi pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_sws_multi_mgr_alloc(void)
+{
+    return &upipe_sws_multi_mgr;
+}
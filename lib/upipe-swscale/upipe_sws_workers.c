@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short internal pool of worker threads shared by swscale pipes
+ */
+
+#include "upipe/ubase.h"
+#include "upipe_sws_workers.h"
+
+#include <stdlib.h>
+
+/** @internal @This is the main loop of a worker thread.
+ *
+ * @param opaque description structure of the worker
+ * @return NULL
+ */
+static void *upipe_sws_workers_main(void *opaque)
+{
+    struct upipe_sws_worker *worker = opaque;
+    struct upipe_sws_workers *workers = worker->workers;
+
+    pthread_mutex_lock(&workers->mutex);
+    for ( ; ; ) {
+        while (!workers->quit && workers->generation == worker->generation)
+            pthread_cond_wait(&workers->cond_start, &workers->mutex);
+        if (workers->quit)
+            break;
+        worker->generation = workers->generation;
+        pthread_mutex_unlock(&workers->mutex);
+
+        workers->cb(workers->opaque, worker->index);
+
+        pthread_mutex_lock(&workers->mutex);
+        if (!--workers->pending)
+            pthread_cond_signal(&workers->cond_done);
+    }
+    pthread_mutex_unlock(&workers->mutex);
+    return NULL;
+}
+
+/** @This initializes a pool without worker threads.
+ *
+ * @param workers pointer to the pool
+ * @param cb function run by each thread
+ * @param opaque opaque passed to cb
+ */
+void upipe_sws_workers_init(struct upipe_sws_workers *workers,
+                            upipe_sws_workers_cb cb, void *opaque)
+{
+    workers->cb = cb;
+    workers->opaque = opaque;
+    workers->threads = NULL;
+    workers->nb_threads = 0;
+    pthread_mutex_init(&workers->mutex, NULL);
+    pthread_cond_init(&workers->cond_start, NULL);
+    pthread_cond_init(&workers->cond_done, NULL);
+    workers->generation = 0;
+    workers->pending = 0;
+    workers->quit = false;
+}
+
+/** @This starts worker threads, in addition to the calling thread.
+ *
+ * @param workers pointer to the pool
+ * @param nb_threads number of worker threads
+ * @return false if the threads could not be started
+ */
+bool upipe_sws_workers_start(struct upipe_sws_workers *workers,
+                             unsigned int nb_threads)
+{
+    upipe_sws_workers_stop(workers);
+    if (!nb_threads)
+        return true;
+
+    workers->threads = malloc(nb_threads * sizeof (struct upipe_sws_worker));
+    if (unlikely(workers->threads == NULL))
+        return false;
+
+    for (unsigned int n = 0; n < nb_threads; n++) {
+        struct upipe_sws_worker *worker = &workers->threads[n];
+        worker->workers = workers;
+        worker->index = n + 1;
+        worker->generation = workers->generation;
+        if (unlikely(pthread_create(&worker->thread, NULL,
+                                    upipe_sws_workers_main, worker) != 0)) {
+            upipe_sws_workers_stop(workers);
+            return false;
+        }
+        workers->nb_threads = n + 1;
+    }
+    return true;
+}
+
+/** @This stops the worker threads.
+ *
+ * @param workers pointer to the pool
+ */
+void upipe_sws_workers_stop(struct upipe_sws_workers *workers)
+{
+    if (workers->threads == NULL)
+        return;
+
+    pthread_mutex_lock(&workers->mutex);
+    workers->quit = true;
+    pthread_cond_broadcast(&workers->cond_start);
+    pthread_mutex_unlock(&workers->mutex);
+
+    for (unsigned int n = 0; n < workers->nb_threads; n++)
+        pthread_join(workers->threads[n].thread, NULL);
+    free(workers->threads);
+    workers->threads = NULL;
+    workers->nb_threads = 0;
+    workers->quit = false;
+}
+
+/** @This runs a job on every worker thread and on the calling thread, and
+ * waits for its completion.
+ *
+ * @param workers pointer to the pool
+ */
+void upipe_sws_workers_run(struct upipe_sws_workers *workers)
+{
+    pthread_mutex_lock(&workers->mutex);
+    workers->pending = workers->nb_threads;
+    workers->generation++;
+    pthread_cond_broadcast(&workers->cond_start);
+    pthread_mutex_unlock(&workers->mutex);
+
+    workers->cb(workers->opaque, 0);
+
+    pthread_mutex_lock(&workers->mutex);
+    while (workers->pending)
+        pthread_cond_wait(&workers->cond_done, &workers->mutex);
+    pthread_mutex_unlock(&workers->mutex);
+}
+
+/** @This stops the worker threads and cleans up the pool.
+ *
+ * @param workers pointer to the pool
+ */
+void upipe_sws_workers_clean(struct upipe_sws_workers *workers)
+{
+    upipe_sws_workers_stop(workers);
+    pthread_cond_destroy(&workers->cond_done);
+    pthread_cond_destroy(&workers->cond_start);
+    pthread_mutex_destroy(&workers->mutex);
+}
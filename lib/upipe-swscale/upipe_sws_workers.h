@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short internal pool of worker threads shared by swscale pipes
+ */
+
+#ifndef _UPIPE_SWSCALE_UPIPE_SWS_WORKERS_H_
+/** @hidden */
+#define _UPIPE_SWSCALE_UPIPE_SWS_WORKERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/** @hidden */
+struct upipe_sws_workers;
+
+/** @This is the function run by each thread of the pool for a job.
+ *
+ * @param opaque opaque given at initialization
+ * @param index index of the thread, 0 for the calling thread
+ */
+typedef void (*upipe_sws_workers_cb)(void *opaque, unsigned int index);
+
+/** @This stores the state of a worker thread. */
+struct upipe_sws_worker {
+    /** pointer to the pool */
+    struct upipe_sws_workers *workers;
+    /** index of the thread, starting at 1 */
+    unsigned int index;
+    /** worker thread */
+    pthread_t thread;
+    /** last generation handled by the worker */
+    uint64_t generation;
+};
+
+/** @This is a pool of worker threads running a job together with the
+ * calling thread. */
+struct upipe_sws_workers {
+    /** function run by each thread */
+    upipe_sws_workers_cb cb;
+    /** opaque passed to cb */
+    void *opaque;
+    /** array of worker threads, or NULL */
+    struct upipe_sws_worker *threads;
+    /** number of running worker threads */
+    unsigned int nb_threads;
+
+    /** mutex protecting the fields below */
+    pthread_mutex_t mutex;
+    /** condition signaled when a job is dispatched or on exit */
+    pthread_cond_t cond_start;
+    /** condition signaled when the last worker is done */
+    pthread_cond_t cond_done;
+    /** incremented each time a job is dispatched */
+    uint64_t generation;
+    /** number of workers still running the job */
+    unsigned int pending;
+    /** true if the workers must exit */
+    bool quit;
+};
+
+/** @This initializes a pool without worker threads.
+ *
+ * @param workers pointer to the pool
+ * @param cb function run by each thread
+ * @param opaque opaque passed to cb
+ */
+void upipe_sws_workers_init(struct upipe_sws_workers *workers,
+                            upipe_sws_workers_cb cb, void *opaque);
+
+/** @This starts worker threads, in addition to the calling thread.
+ *
+ * @param workers pointer to the pool
+ * @param nb_threads number of worker threads
+ * @return false if the threads could not be started
+ */
+bool upipe_sws_workers_start(struct upipe_sws_workers *workers,
+                             unsigned int nb_threads);
+
+/** @This stops the worker threads.
+ *
+ * @param workers pointer to the pool
+ */
+void upipe_sws_workers_stop(struct upipe_sws_workers *workers);
+
+/** @This runs a job on every worker thread and on the calling thread, and
+ * waits for its completion.
+ *
+ * @param workers pointer to the pool
+ */
+void upipe_sws_workers_run(struct upipe_sws_workers *workers);
+
+/** @This stops the worker threads and cleans up the pool.
+ *
+ * @param workers pointer to the pool
+ */
+void upipe_sws_workers_clean(struct upipe_sws_workers *workers);
+
+#endif
@@ -16,6 +16,7 @@ libupipe_ts-includes = \
     upipe_ts_eit_decoder.h \
     upipe_ts_encaps.h \
     upipe_ts_metadata_generator.h \
+    upipe_ts_monitor.h \
     upipe_ts_mux.h \
     upipe_ts_nit_decoder.h \
     upipe_ts_pat_decoder.h \
@@ -45,9 +46,12 @@ libupipe_ts-includes = \
     uref_ts_flow.h \
     uref_ts_scte104_flow.h \
     uref_ts_scte35.h \
-    uref_ts_scte35_desc.h
+    uref_ts_scte35_desc.h \
+    uref_ts_vector.h
 
 libupipe_ts-src = \
+    ts_scan.c \
+    ts_scan.h \
     upipe_rtp_fec.c \
     upipe_ts_ait_decoder.c \
     upipe_ts_ait_generator.c \
@@ -59,6 +63,7 @@ libupipe_ts-src = \
     upipe_ts_eit_decoder.c \
     upipe_ts_encaps.c \
     upipe_ts_metadata_generator.c \
+    upipe_ts_monitor.c \
     upipe_ts_mux.c \
     upipe_ts_nit_decoder.c \
     upipe_ts_pat_decoder.c \
@@ -86,6 +91,9 @@ libupipe_ts-src = \
     upipe_ts_tstd.c \
     uref_ts_scte35.c
 
+libupipe_ts-src += \
+    $(if $(have_x86asm),x86/ts_scan.asm)
+
 configs += libiconv
 libiconv-ldlibs = -liconv
 
@@ -0,0 +1,26 @@
+/*
+ * TS packet scanning
+ *
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include <stdint.h>
+#include "ts_scan.h"
+
+/** TS synchronization word */
+#define TS_SYNC 0x47
+
+uintptr_t upipe_ts_scan_c(const uint8_t *src, uint8_t *pids, uintptr_t stride,
+                          uintptr_t packets)
+{
+    uintptr_t i;
+    for (i = 0; i < packets; i++, src += stride) {
+        if (src[0] != TS_SYNC)
+            break;
+        pids[2 * i]     = src[1] & 0x1f;
+        pids[2 * i + 1] = src[2];
+    }
+    return i;
+}
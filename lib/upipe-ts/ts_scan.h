@@ -0,0 +1,71 @@
+/*
+ * TS packet scanning
+ *
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef _TS_SCAN_H_
+/** @hidden */
+#define _TS_SCAN_H_
+
+#include <stdint.h>
+
+/** @This checks the sync word of packets laid out at a given stride, and
+ * extracts their PIDs, in the format of @ref uref_ts_vector_set_pid.
+ * PIDs may also be written for the packets following the first one with an
+ * invalid sync word.
+ *
+ * @return the number of leading packets starting with a sync word
+ */
+typedef uintptr_t (*upipe_ts_scan_func)(const uint8_t *src, uint8_t *pids,
+                                        uintptr_t stride, uintptr_t packets);
+
+uintptr_t upipe_ts_scan_c(const uint8_t *src, uint8_t *pids, uintptr_t stride, uintptr_t packets);
+
+/* process multiples of 8 packets */
+uintptr_t upipe_ts_scan_sse2(const uint8_t *src, uint8_t *pids, uintptr_t stride, uintptr_t packets);
+uintptr_t upipe_ts_scan_avx2(const uint8_t *src, uint8_t *pids, uintptr_t stride, uintptr_t packets);
+
+/** @This returns the fastest scan function supported by the CPU.
+ *
+ * @return pointer to scan function
+ */
+static inline upipe_ts_scan_func upipe_ts_scan_init(void)
+{
+    upipe_ts_scan_func scan = upipe_ts_scan_c;
+#ifdef HAVE_X86ASM
+#if defined(__i686__) || defined(__x86_64__)
+    if (__builtin_cpu_supports("sse2"))
+        scan = upipe_ts_scan_sse2;
+    if (__builtin_cpu_supports("avx2"))
+        scan = upipe_ts_scan_avx2;
+#endif
+#endif
+    return scan;
+}
+
+/** @This scans packets with the given function, and completes the last
+ * packets that are not a multiple of 8 with the C version.
+ *
+ * @param scan scan function returned by @ref upipe_ts_scan_init
+ * @param src pointer to the first packet
+ * @param pids filled in with the PIDs of the packets
+ * @param stride size of a packet
+ * @param packets number of packets
+ * @return the number of leading packets starting with a sync word
+ */
+static inline uintptr_t upipe_ts_scan(upipe_ts_scan_func scan,
+                                      const uint8_t *src, uint8_t *pids,
+                                      uintptr_t stride, uintptr_t packets)
+{
+    uintptr_t simd = scan == upipe_ts_scan_c ? 0 : packets & ~(uintptr_t)7;
+    uintptr_t valid = simd ? scan(src, pids, stride, simd) : 0;
+    if (valid < simd)
+        return valid;
+    return valid + upipe_ts_scan_c(src + valid * stride, pids + 2 * valid,
+                                   stride, packets - valid);
+}
+
+#endif
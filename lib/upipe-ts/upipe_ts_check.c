@@ -29,6 +29,9 @@
 #include "upipe/upipe_helper_output.h"
 #include "upipe/upipe_helper_output_size.h"
 #include "upipe-ts/upipe_ts_check.h"
+#include "upipe-ts/uref_ts_vector.h"
+
+#include "ts_scan.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -61,6 +64,10 @@ struct upipe_ts_check {
 
     /** TS packet size */
     size_t output_size;
+    /** true if packets are output in vectors */
+    bool vector;
+    /** function scanning packets in a contiguous buffer */
+    upipe_ts_scan_func scan;
 
     /** public upipe structure */
     struct upipe upipe;
@@ -92,6 +99,8 @@ static struct upipe *upipe_ts_check_alloc(struct upipe_mgr *mgr,
     upipe_ts_check_init_urefcount(upipe);
     upipe_ts_check_init_output(upipe);
     upipe_ts_check_init_output_size(upipe, TS_SIZE);
+    upipe_ts_check_from_upipe(upipe)->vector = false;
+    upipe_ts_check_from_upipe(upipe)->scan = upipe_ts_scan_init();
     upipe_throw_ready(upipe);
     return upipe;
 }
@@ -126,6 +135,107 @@ static bool upipe_ts_check_check(struct upipe *upipe, struct uref *uref,
     return true;
 }
 
+/** @internal @This checks the sync words of the packets of a buffer, and
+ * outputs them in vectors.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param size size of the buffer
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_check_input_vector(struct upipe *upipe, struct uref *uref,
+                                        size_t size, struct upump **upump_p)
+{
+    struct upipe_ts_check *upipe_ts_check = upipe_ts_check_from_upipe(upipe);
+    size_t packet_size = upipe_ts_check->output_size;
+
+    for ( ; ; ) {
+        uint8_t pids[2 * UREF_TS_VECTOR_MAX];
+        unsigned int nb = 0;
+        size_t offset = 0;
+        bool lost = false;
+        while (nb < UREF_TS_VECTOR_MAX && offset + packet_size <= size) {
+            const uint8_t *buffer;
+            int read_size = -1;
+            if (unlikely(!ubase_check(uref_block_read(uref, offset,
+                                                      &read_size, &buffer)))) {
+                uref_free(uref);
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                return;
+            }
+
+            uintptr_t packets = read_size / packet_size;
+            if (packets > UREF_TS_VECTOR_MAX - nb)
+                packets = UREF_TS_VECTOR_MAX - nb;
+            if (likely(packets)) {
+                /* fast path: packets lying in one segment */
+                uintptr_t valid = upipe_ts_scan(upipe_ts_check->scan, buffer,
+                        pids + 2 * nb, packet_size, packets);
+                uint8_t word = valid < packets ? buffer[valid * packet_size] :
+                               TS_SYNC;
+                uref_block_unmap(uref, offset);
+                nb += valid;
+                offset += valid * packet_size;
+                if (word != TS_SYNC) {
+                    upipe_warn_va(upipe, "invalid TS sync 0x%"PRIx8, word);
+                    lost = true;
+                    break;
+                }
+                continue;
+            }
+            uref_block_unmap(uref, offset);
+
+            /* packet overlapping two segments */
+            uint8_t header[TS_HEADER_SIZE];
+            const uint8_t *ts_header = uref_block_peek(uref, offset,
+                                                       TS_HEADER_SIZE, header);
+            if (unlikely(ts_header == NULL)) {
+                uref_free(uref);
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                return;
+            }
+            uint8_t word = ts_header[0];
+            uint16_t pid = ts_get_pid(ts_header);
+            uref_block_peek_unmap(uref, offset, header, ts_header);
+            if (word != TS_SYNC) {
+                upipe_warn_va(upipe, "invalid TS sync 0x%"PRIx8, word);
+                lost = true;
+                break;
+            }
+            uref_ts_vector_set_pid(pids, nb++, pid);
+            offset += packet_size;
+        }
+        if (!nb) {
+            uref_free(uref);
+            return;
+        }
+
+        struct uref *next = NULL;
+        if (!lost && size - offset >= packet_size) {
+            next = uref_block_split(uref, offset);
+            if (unlikely(next == NULL)) {
+                uref_free(uref);
+                upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                return;
+            }
+        } else if (offset < size)
+            uref_block_truncate(uref, offset);
+
+        if (unlikely(!ubase_check(uref_ts_vector_set(uref, packet_size,
+                                                     nb, pids)))) {
+            uref_free(uref);
+            uref_free(next);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        upipe_ts_check_output(upipe, uref, upump_p);
+        if (next == NULL)
+            return;
+        uref = next;
+        size -= offset;
+    }
+}
+
 /** @internal @This tries to find TS packets in the buffered input urefs.
  *
  * @param upipe description structure of the pipe
@@ -143,6 +253,11 @@ static void upipe_ts_check_input(struct upipe *upipe, struct uref *uref,
         return;
     }
 
+    if (upipe_ts_check->vector) {
+        upipe_ts_check_input_vector(upipe, uref, size, upump_p);
+        return;
+    }
+
     while (size > upipe_ts_check->output_size) {
         struct uref *next = uref_block_split(uref, upipe_ts_check->output_size);
         if (unlikely(next == NULL)) {
@@ -205,6 +320,22 @@ static int upipe_ts_check_control(struct upipe *upipe,
             struct uref *flow_def = va_arg(args, struct uref *);
             return upipe_ts_check_set_flow_def(upipe, flow_def);
         }
+
+        case UPIPE_TS_CHECK_GET_VECTOR: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_CHECK_SIGNATURE)
+            struct upipe_ts_check *upipe_ts_check =
+                upipe_ts_check_from_upipe(upipe);
+            int *vector_p = va_arg(args, int *);
+            *vector_p = upipe_ts_check->vector;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_TS_CHECK_SET_VECTOR: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_CHECK_SIGNATURE)
+            struct upipe_ts_check *upipe_ts_check =
+                upipe_ts_check_from_upipe(upipe);
+            upipe_ts_check->vector = !!va_arg(args, int);
+            return UBASE_ERR_NONE;
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
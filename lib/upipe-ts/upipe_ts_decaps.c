@@ -22,6 +22,8 @@
 #include "upipe/upipe_helper_void.h"
 #include "upipe/upipe_helper_output.h"
 #include "upipe-ts/upipe_ts_decaps.h"
+#include "upipe-ts/uref_ts_flow.h"
+#include "upipe-ts/uref_ts_vector.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -32,6 +34,8 @@
 
 /** we only accept TS packets */
 #define EXPECTED_FLOW_DEF "block.mpegts."
+/** maximum size of the payload kept to detect duplicate packets */
+#define MAX_PAYLOAD_SIZE 256
 
 /** @internal @This is the private context of a ts_decaps pipe. */
 struct upipe_ts_decaps {
@@ -49,8 +53,10 @@ struct upipe_ts_decaps {
 
     /** last continuity counter for this PID, or -1 */
     int8_t last_cc;
-    /** last TS packet */
-    struct uref *last_uref;
+    /** payload of the last TS packet */
+    uint8_t last_payload[MAX_PAYLOAD_SIZE];
+    /** size of the payload of the last TS packet, or 0 */
+    size_t last_payload_size;
 
     /** lost packets based on cc errors */
     uint64_t lost;
@@ -86,19 +92,59 @@ static struct upipe *upipe_ts_decaps_alloc(struct upipe_mgr *mgr,
     upipe_ts_decaps_init_output(upipe);
     upipe_ts_decaps->last_cc = -1;
     upipe_ts_decaps->lost = 0;
-    upipe_ts_decaps->last_uref = NULL;
+    upipe_ts_decaps->last_payload_size = 0;
     upipe_throw_ready(upipe);
     return upipe;
 }
 
+/** @internal @This checks whether the payload of a packet repeats the
+ * payload of the last packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure, without TS header
+ * @return true if the packet is a duplicate
+ */
+static bool upipe_ts_decaps_duplicate(struct upipe *upipe, struct uref *uref)
+{
+    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
+    size_t size = upipe_ts_decaps->last_payload_size;
+    if (!size)
+        return false;
+    uint8_t buffer[size];
+    const uint8_t *payload = uref_block_peek(uref, 0, size, buffer);
+    if (payload == NULL)
+        return false;
+    bool duplicate = !memcmp(payload, upipe_ts_decaps->last_payload, size);
+    uref_block_peek_unmap(uref, 0, buffer, payload);
+    return duplicate;
+}
+
+/** @internal @This keeps the payload of a packet, to detect a duplicate
+ * next packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure, without TS header
+ */
+static void upipe_ts_decaps_keep(struct upipe *upipe, struct uref *uref)
+{
+    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
+    size_t size;
+    upipe_ts_decaps->last_payload_size = 0;
+    if (likely(ubase_check(uref_block_size(uref, &size))) &&
+        size <= MAX_PAYLOAD_SIZE &&
+        likely(ubase_check(uref_block_extract(uref, 0, size,
+                                        upipe_ts_decaps->last_payload))))
+        upipe_ts_decaps->last_payload_size = size;
+}
+
 /** @internal @This parses and removes the TS header of a packet.
  *
  * @param upipe description structure of the pipe
  * @param uref uref structure
  * @param upump_p reference to pump that generated the buffer
  */
-static void upipe_ts_decaps_input(struct upipe *upipe, struct uref *uref,
-                                  struct upump **upump_p)
+static void upipe_ts_decaps_work(struct upipe *upipe, struct uref *uref,
+                                 struct upump **upump_p)
 {
     struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
     uint8_t buffer[TS_HEADER_SIZE_PCR];
@@ -177,9 +223,7 @@ static void upipe_ts_decaps_input(struct upipe *upipe, struct uref *uref,
             uref_free(uref);
             return;
         }
-        if (upipe_ts_decaps->last_uref != NULL &&
-            ubase_check(uref_block_compare(uref, 0,
-                                           upipe_ts_decaps->last_uref))) {
+        if (upipe_ts_decaps_duplicate(upipe, uref)) {
             upipe_verbose(upipe, "removing duplicate packet");
             uref_free(uref);
             return;
@@ -212,11 +256,48 @@ static void upipe_ts_decaps_input(struct upipe *upipe, struct uref *uref,
     if (unlikely(transporterror))
         uref_flow_set_error(uref);
 
-    uref_free(upipe_ts_decaps->last_uref);
-    upipe_ts_decaps->last_uref = uref_dup(uref);
+    upipe_ts_decaps_keep(upipe, uref);
     upipe_ts_decaps_output(upipe, uref, upump_p);
 }
 
+/** @internal @This parses and removes the TS header of a packet, or of all
+ * the packets of a TS packet vector.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_decaps_input(struct upipe *upipe, struct uref *uref,
+                                  struct upump **upump_p)
+{
+    size_t packet_size;
+    unsigned int nb;
+    const uint8_t *pids;
+    if (likely(!ubase_check(uref_ts_vector_get(uref, &packet_size, &nb,
+                                               &pids)))) {
+        upipe_ts_decaps_work(upipe, uref, upump_p);
+        return;
+    }
+
+    uref_ts_vector_delete(uref);
+    if (unlikely(!nb)) {
+        uref_free(uref);
+        return;
+    }
+    for (unsigned int i = 0; i < nb - 1; i++) {
+        struct uref *packet = uref_dup(uref);
+        if (unlikely(packet == NULL)) {
+            uref_free(uref);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        uref_block_resize(packet, i * packet_size, packet_size);
+        upipe_ts_decaps_work(upipe, packet, upump_p);
+    }
+    uref_block_resize(uref, (nb - 1) * packet_size, packet_size);
+    upipe_ts_decaps_work(upipe, uref, upump_p);
+}
+
 /** @internal @This sets the input flow definition.
  *
  * @param upipe description structure of the pipe
@@ -240,6 +321,7 @@ static int upipe_ts_decaps_set_flow_def(struct upipe *upipe,
     if (unlikely(!ubase_check(uref_flow_set_def_va(flow_def_dup, "block.%s",
                                        def + strlen(EXPECTED_FLOW_DEF)))))
         upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+    uref_ts_flow_delete_vector(flow_def_dup);
     upipe_ts_decaps_store_flow_def(upipe, flow_def_dup);
     return UBASE_ERR_NONE;
 }
@@ -282,8 +364,6 @@ static void upipe_ts_decaps_free(struct upipe *upipe)
 {
     upipe_throw_dead(upipe);
 
-    struct upipe_ts_decaps *upipe_ts_decaps = upipe_ts_decaps_from_upipe(upipe);
-    uref_free(upipe_ts_decaps->last_uref);
     upipe_ts_decaps_clean_output(upipe);
     upipe_ts_decaps_clean_urefcount(upipe);
     upipe_ts_decaps_free_void(upipe);
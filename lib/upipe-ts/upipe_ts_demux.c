@@ -646,6 +646,7 @@ static struct upipe_ts_demux_psi_pid *
     }
 
     uref_flow_set_def(flow_def, "block.mpegts.mpegtspsi.");
+    uref_ts_flow_set_vector(flow_def);
     psi_pid->split_output =
         upipe_flow_alloc_sub(upipe_ts_demux->split,
                              uprobe_pfx_alloc_va(
@@ -1163,15 +1164,19 @@ static struct upipe *upipe_ts_demux_output_alloc(struct upipe_mgr *mgr,
 
     struct upipe_ts_demux_mgr *ts_demux_mgr =
         upipe_ts_demux_mgr_from_upipe_mgr(upipe_ts_demux_to_upipe(demux)->mgr);
-    /* set up split_output and set rap inner pipes */
-    if (unlikely((upipe_ts_demux_output->split_output =
-                    upipe_flow_alloc_sub(
-                        demux->split,
-                        uprobe_pfx_alloc_va(
-                            uprobe_use(&upipe_ts_demux_output->probe),
-                            UPROBE_LOG_VERBOSE,
-                            "split output %"PRIu64, upipe_ts_demux_output->pid),
-                        flow_def)) == NULL ||
+    /* set up split_output and set rap inner pipes, ts_decaps accepts
+     * TS packet vectors */
+    uref_ts_flow_set_vector(flow_def);
+    upipe_ts_demux_output->split_output =
+        upipe_flow_alloc_sub(
+            demux->split,
+            uprobe_pfx_alloc_va(
+                uprobe_use(&upipe_ts_demux_output->probe),
+                UPROBE_LOG_VERBOSE,
+                "split output %"PRIu64, upipe_ts_demux_output->pid),
+            flow_def);
+    uref_ts_flow_delete_vector(flow_def);
+    if (unlikely(upipe_ts_demux_output->split_output == NULL ||
                  (upipe_ts_demux_output->setrap =
                     upipe_void_alloc_output(upipe_ts_demux_output->split_output,
                                ts_demux_mgr->setrap_mgr,
@@ -2115,6 +2120,7 @@ static void upipe_ts_demux_program_check_pcr(struct upipe *upipe)
     struct uref *flow_def = uref_alloc_control(demux->uref_mgr);
     if (unlikely(flow_def == NULL ||
                  !ubase_check(uref_flow_set_def(flow_def, "block.mpegts.")) ||
+                 !ubase_check(uref_ts_flow_set_vector(flow_def)) ||
                  !ubase_check(uref_ts_flow_set_pid(flow_def,
                                        upipe_ts_demux_program->pcr_pid)))) {
         if (flow_def != NULL)
@@ -3879,6 +3885,11 @@ static int upipe_ts_demux_set_flow_def(struct upipe *upipe,
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return UBASE_ERR_ALLOC;
         }
+        /* ts_split and ts_decaps inner pipes handle TS packet vectors */
+        if (!ubase_ncmp(def, EXPECTED_FLOW_DEF_CHECK))
+            upipe_ts_check_set_vector(input, true);
+        else
+            upipe_ts_sync_set_vector(input, true);
         upipe_ts_demux_store_bin_input(upipe, input);
         upipe_set_output(input, upipe_ts_demux->setrap);
 
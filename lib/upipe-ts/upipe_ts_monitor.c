@@ -0,0 +1,676 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe module monitoring a transport stream
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_flow.h"
+#include "upipe/upipe.h"
+#include "upipe/upipe_helper_upipe.h"
+#include "upipe/upipe_helper_urefcount.h"
+#include "upipe/upipe_helper_void.h"
+#include "upipe/upipe_helper_output.h"
+#include "upipe-ts/upipe_ts_monitor.h"
+#include "upipe-ts/uref_ts_vector.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include <bitstream/mpeg/ts.h>
+#include <bitstream/mpeg/psi.h>
+
+/** we only accept TS packets */
+#define EXPECTED_FLOW_DEF "block.mpegts."
+/** maximum number of PIDs */
+#define MAX_PIDS 8192
+/** PIDs below this value carry PSI */
+#define PSI_PIDS 0x20
+/** null packets PID */
+#define NULL_PID 0x1fff
+/** wraparound of the PCR, in 27 MHz units */
+#define PCR_MAX (UINT64_C(300) << 33)
+/** default bitrate measurement period */
+#define DEFAULT_PERIOD UCLOCK_FREQ
+
+/** @internal @This keeps the state of a PID. */
+struct upipe_ts_monitor_pid {
+    /** statistics returned to the application */
+    struct upipe_ts_monitor_stats stats;
+    /** octets received during the current period */
+    uint64_t octets;
+    /** last continuity counter, or -1 */
+    int last_cc;
+    /** true if the PID carries PSI sections */
+    bool psi;
+
+    /** last PCR, or UINT64_MAX */
+    uint64_t last_pcr;
+    /** number of the packet carrying the last PCR */
+    uint64_t last_pcr_packet;
+    /** arrival date of the last PCR, or UINT64_MAX */
+    uint64_t last_pcr_sys;
+    /** difference between the last two PCRs */
+    uint64_t pcr_delta;
+    /** number of packets between the last two PCRs */
+    uint64_t pcr_packets;
+
+    /** arrival dates of the last occurrences of the tables, or UINT64_MAX */
+    uint64_t table_sys[UPIPE_TS_MONITOR_TABLES];
+};
+
+/** @internal @This is the private context of a ts_monitor pipe. */
+struct upipe_ts_monitor {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** pipe acting as output */
+    struct upipe *output;
+    /** output flow definition packet */
+    struct uref *flow_def;
+    /** output state */
+    enum upipe_helper_output_state output_state;
+    /** list of output requests */
+    struct uchain request_list;
+
+    /** index of each PID in the states array plus one, or 0 */
+    uint16_t index[MAX_PIDS];
+    /** states of the PIDs seen on the input */
+    struct upipe_ts_monitor_pid *pids;
+    /** number of PIDs seen on the input */
+    unsigned int nb_pids;
+    /** number of packets received */
+    uint64_t packets;
+
+    /** bitrate measurement period */
+    uint64_t period;
+    /** start of the current period, or UINT64_MAX */
+    uint64_t period_start;
+
+    /** public upipe structure */
+    struct upipe upipe;
+};
+
+UPIPE_HELPER_UPIPE(upipe_ts_monitor, upipe, UPIPE_TS_MONITOR_SIGNATURE)
+UPIPE_HELPER_UREFCOUNT(upipe_ts_monitor, urefcount, upipe_ts_monitor_free)
+UPIPE_HELPER_VOID(upipe_ts_monitor)
+UPIPE_HELPER_OUTPUT(upipe_ts_monitor, output, flow_def, output_state, request_list)
+
+/** @internal @This allocates a ts_monitor pipe.
+ *
+ * @param mgr common management structure
+ * @param uprobe structure used to raise events
+ * @param signature signature of the pipe allocator
+ * @param args optional arguments
+ * @return pointer to upipe or NULL in case of allocation error
+ */
+static struct upipe *upipe_ts_monitor_alloc(struct upipe_mgr *mgr,
+                                            struct uprobe *uprobe,
+                                            uint32_t signature, va_list args)
+{
+    struct upipe *upipe = upipe_ts_monitor_alloc_void(mgr, uprobe, signature,
+                                                      args);
+    if (unlikely(upipe == NULL))
+        return NULL;
+
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    upipe_ts_monitor_init_urefcount(upipe);
+    upipe_ts_monitor_init_output(upipe);
+    memset(upipe_ts_monitor->index, 0, sizeof(upipe_ts_monitor->index));
+    upipe_ts_monitor->pids = NULL;
+    upipe_ts_monitor->nb_pids = 0;
+    upipe_ts_monitor->packets = 0;
+    upipe_ts_monitor->period = DEFAULT_PERIOD;
+    upipe_ts_monitor->period_start = UINT64_MAX;
+
+    upipe_throw_ready(upipe);
+    return upipe;
+}
+
+/** @internal @This resets the continuity state of a PID, after a
+ * discontinuity.
+ *
+ * @param state state of the PID
+ */
+static void upipe_ts_monitor_pid_reset(struct upipe_ts_monitor_pid *state)
+{
+    state->last_cc = -1;
+    state->last_pcr = UINT64_MAX;
+    state->last_pcr_packet = 0;
+    state->last_pcr_sys = UINT64_MAX;
+    state->pcr_delta = 0;
+    state->pcr_packets = 0;
+}
+
+/** @internal @This returns the state of a PID, and allocates it the first
+ * time the PID is seen. Pointers to other states are invalidated by an
+ * allocation.
+ *
+ * @param upipe description structure of the pipe
+ * @param pid PID
+ * @return pointer to the state, or NULL in case of allocation error
+ */
+static struct upipe_ts_monitor_pid *
+    upipe_ts_monitor_get_pid(struct upipe *upipe, uint16_t pid)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    uint16_t index = upipe_ts_monitor->index[pid];
+    if (likely(index))
+        return &upipe_ts_monitor->pids[index - 1];
+
+    struct upipe_ts_monitor_pid *pids = realloc(upipe_ts_monitor->pids,
+            (upipe_ts_monitor->nb_pids + 1) * sizeof(*pids));
+    if (unlikely(pids == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return NULL;
+    }
+    upipe_ts_monitor->pids = pids;
+
+    struct upipe_ts_monitor_pid *state = &pids[upipe_ts_monitor->nb_pids++];
+    memset(&state->stats, 0, sizeof(state->stats));
+    state->octets = 0;
+    state->psi = pid < PSI_PIDS;
+    for (unsigned int i = 0; i < UPIPE_TS_MONITOR_TABLES; i++)
+        state->table_sys[i] = UINT64_MAX;
+    upipe_ts_monitor_pid_reset(state);
+    upipe_ts_monitor->index[pid] = upipe_ts_monitor->nb_pids;
+    return state;
+}
+
+/** @internal @This computes the bitrates of the PIDs at the end of a
+ * measurement period.
+ *
+ * @param upipe description structure of the pipe
+ * @param cr_sys arrival date of the current buffer
+ */
+static void upipe_ts_monitor_update_period(struct upipe *upipe,
+                                           uint64_t cr_sys)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    if (unlikely(upipe_ts_monitor->period_start == UINT64_MAX ||
+                 cr_sys < upipe_ts_monitor->period_start)) {
+        upipe_ts_monitor->period_start = cr_sys;
+        return;
+    }
+
+    uint64_t duration = cr_sys - upipe_ts_monitor->period_start;
+    if (duration < upipe_ts_monitor->period)
+        return;
+
+    for (unsigned int i = 0; i < upipe_ts_monitor->nb_pids; i++) {
+        struct upipe_ts_monitor_pid *state = &upipe_ts_monitor->pids[i];
+        state->stats.bitrate = state->octets * 8 * UCLOCK_FREQ / duration;
+        state->octets = 0;
+    }
+    upipe_ts_monitor->period_start = cr_sys;
+}
+
+/** @internal @This checks a PCR against the previous PCRs of the PID, the
+ * same way ts_pcr_interpolator interpolates dates between PCRs, and against
+ * the arrival dates.
+ *
+ * @param upipe description structure of the pipe
+ * @param state state of the PID
+ * @param pcr value of the PCR, in 27 MHz units
+ * @param cr_sys arrival date of the packet, or UINT64_MAX
+ */
+static void upipe_ts_monitor_pcr(struct upipe *upipe,
+                                 struct upipe_ts_monitor_pid *state,
+                                 uint64_t pcr, uint64_t cr_sys)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    state->stats.pcrs++;
+
+    if (state->last_pcr != UINT64_MAX) {
+        uint64_t delta = (PCR_MAX + pcr - state->last_pcr) % PCR_MAX;
+        delta *= UCLOCK_FREQ / 27000000;
+        uint64_t packets =
+            upipe_ts_monitor->packets - state->last_pcr_packet;
+
+        if (delta > state->stats.pcr_interval_max)
+            state->stats.pcr_interval_max = delta;
+
+        if (state->pcr_packets) {
+            uint64_t expected =
+                state->pcr_delta * packets / state->pcr_packets;
+            uint64_t accuracy = delta > expected ? delta - expected :
+                                                   expected - delta;
+            if (accuracy > state->stats.pcr_accuracy_max)
+                state->stats.pcr_accuracy_max = accuracy;
+        }
+
+        if (cr_sys != UINT64_MAX && state->last_pcr_sys != UINT64_MAX &&
+            cr_sys >= state->last_pcr_sys) {
+            uint64_t sys_delta = cr_sys - state->last_pcr_sys;
+            uint64_t jitter = delta > sys_delta ? delta - sys_delta :
+                                                  sys_delta - delta;
+            if (jitter > state->stats.pcr_jitter_max)
+                state->stats.pcr_jitter_max = jitter;
+        }
+
+        state->pcr_delta = delta;
+        state->pcr_packets = packets;
+    }
+
+    state->last_pcr = pcr;
+    state->last_pcr_packet = upipe_ts_monitor->packets;
+    state->last_pcr_sys = cr_sys;
+}
+
+/** @internal @This learns the PMT PIDs from a PAT section contained in a
+ * single packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param section pointer to the section
+ * @param size size of the packet after the start of the section
+ */
+static void upipe_ts_monitor_pat(struct upipe *upipe, const uint8_t *section,
+                                 size_t size)
+{
+    size_t length = PSI_HEADER_SIZE + psi_get_length(section);
+    if (length > size || length < PAT_HEADER_SIZE + PSI_CRC_SIZE)
+        return;
+
+    const uint8_t *end = section + length - PSI_CRC_SIZE;
+    for (const uint8_t *program = section + PAT_HEADER_SIZE;
+         program + PAT_PROGRAM_SIZE <= end; program += PAT_PROGRAM_SIZE) {
+        if (!patn_get_program(program))
+            continue;
+        uint16_t pid = patn_get_pid(program);
+        struct upipe_ts_monitor_pid *state =
+            upipe_ts_monitor_get_pid(upipe, pid);
+        if (unlikely(state == NULL))
+            return;
+        if (!state->psi) {
+            upipe_dbg_va(upipe, "new PMT PID %"PRIu16, pid);
+            state->psi = true;
+        }
+    }
+}
+
+/** @internal @This records the occurrence of the first section of a PSI
+ * table.
+ *
+ * @param upipe description structure of the pipe
+ * @param pid PID of the packet
+ * @param state state of the PID, invalidated on return
+ * @param section pointer to the section
+ * @param size size of the packet after the start of the section
+ * @param cr_sys arrival date of the packet, or UINT64_MAX
+ */
+static void upipe_ts_monitor_table(struct upipe *upipe, uint16_t pid,
+                                   struct upipe_ts_monitor_pid *state,
+                                   const uint8_t *section, size_t size,
+                                   uint64_t cr_sys)
+{
+    uint8_t table_id = psi_get_tableid(section);
+    if (table_id == 0xff || (psi_get_syntax(section) &&
+                             psi_get_section(section)))
+        return;
+
+    unsigned int i;
+    for (i = 0; i < state->stats.nb_tables; i++)
+        if (state->stats.tables[i].table_id == table_id)
+            break;
+    if (i == state->stats.nb_tables) {
+        if (i >= UPIPE_TS_MONITOR_TABLES)
+            return;
+        state->stats.nb_tables++;
+        memset(&state->stats.tables[i], 0, sizeof(state->stats.tables[i]));
+        state->stats.tables[i].table_id = table_id;
+        state->table_sys[i] = UINT64_MAX;
+    }
+
+    struct upipe_ts_monitor_table *table = &state->stats.tables[i];
+    table->count++;
+    if (cr_sys != UINT64_MAX) {
+        if (state->table_sys[i] != UINT64_MAX) {
+            table->interval = cr_sys - state->table_sys[i];
+            if (table->interval > table->interval_max)
+                table->interval_max = table->interval;
+        }
+        state->table_sys[i] = cr_sys;
+    }
+
+    if (pid == 0 && table_id == PAT_TABLE_ID)
+        upipe_ts_monitor_pat(upipe, section, size);
+}
+
+/** @internal @This analyses a TS packet.
+ *
+ * @param upipe description structure of the pipe
+ * @param ts pointer to the packet
+ * @param packet_size size of the packet
+ * @param cr_sys arrival date of the packet, or UINT64_MAX
+ */
+static void upipe_ts_monitor_packet(struct upipe *upipe, const uint8_t *ts,
+                                    size_t packet_size, uint64_t cr_sys)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    upipe_ts_monitor->packets++;
+    if (unlikely(!ts_validate(ts)))
+        return;
+
+    uint16_t pid = ts_get_pid(ts);
+    struct upipe_ts_monitor_pid *state = upipe_ts_monitor_get_pid(upipe, pid);
+    if (unlikely(state == NULL))
+        return;
+    state->stats.packets++;
+    state->octets += packet_size;
+    if (unlikely(ts_get_transporterror(ts))) {
+        state->stats.transport_errors++;
+        return;
+    }
+
+    bool has_payload = ts_has_payload(ts);
+    bool discontinuity = false;
+    size_t offset = TS_HEADER_SIZE;
+    if (ts_has_adaptation(ts)) {
+        uint8_t af_length = ts_get_adaptation(ts);
+        if (unlikely(af_length > TS_SIZE - TS_HEADER_SIZE - 1))
+            return;
+        offset += 1 + af_length;
+
+        if (af_length) {
+            discontinuity = tsaf_has_discontinuity(ts);
+            if (unlikely(discontinuity))
+                upipe_ts_monitor_pid_reset(state);
+            if (tsaf_has_pcr(ts) && offset >= TS_HEADER_SIZE_PCR)
+                upipe_ts_monitor_pcr(upipe, state,
+                                     tsaf_get_pcr(ts) * 300 +
+                                     tsaf_get_pcrext(ts), cr_sys);
+        }
+    }
+
+    if (unlikely(pid == NULL_PID) || !has_payload)
+        return;
+
+    uint8_t cc = ts_get_cc(ts);
+    if (unlikely(state->last_cc != -1 && !discontinuity &&
+                 !ts_check_duplicate(cc, state->last_cc) &&
+                 ts_check_discontinuity(cc, state->last_cc))) {
+        state->stats.cc_errors++;
+        upipe_verbose_va(upipe, "CC error on PID %"PRIu16, pid);
+    }
+    state->last_cc = cc;
+
+    if (!state->psi || !ts_get_unitstart(ts) || offset >= TS_SIZE)
+        return;
+    offset += 1 + ts[offset];
+    if (offset + PSI_HEADER_SIZE_SYNTAX1 > TS_SIZE)
+        return;
+    upipe_ts_monitor_table(upipe, pid, state, ts + offset, TS_SIZE - offset,
+                           cr_sys);
+}
+
+/** @internal @This analyses the TS packets of a uref.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param packet_size size of a TS packet
+ * @param nb number of packets
+ * @param cr_sys arrival date of the uref, or UINT64_MAX
+ */
+static void upipe_ts_monitor_work(struct upipe *upipe, struct uref *uref,
+                                  size_t packet_size, unsigned int nb,
+                                  uint64_t cr_sys)
+{
+    unsigned int i = 0;
+    while (i < nb) {
+        const uint8_t *buffer;
+        int size = -1;
+        if (unlikely(!ubase_check(uref_block_read(uref, i * packet_size,
+                                                  &size, &buffer)))) {
+            upipe_warn(upipe, "unable to read TS packets");
+            return;
+        }
+        unsigned int n = size / packet_size;
+        if (n > nb - i)
+            n = nb - i;
+        for (unsigned int j = 0; j < n; j++)
+            upipe_ts_monitor_packet(upipe, buffer + j * packet_size,
+                                    packet_size, cr_sys);
+        uref_block_unmap(uref, i * packet_size);
+
+        if (unlikely(!n)) {
+            /* packet spanning several segments */
+            uint8_t ts[TS_SIZE];
+            if (unlikely(!ubase_check(uref_block_extract(uref,
+                                i * packet_size, TS_SIZE, ts)))) {
+                upipe_warn(upipe, "unable to read TS packets");
+                return;
+            }
+            upipe_ts_monitor_packet(upipe, ts, packet_size, cr_sys);
+            n = 1;
+        }
+        i += n;
+    }
+}
+
+/** @internal @This analyses the TS packets of a uref, and forwards it.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_monitor_input(struct upipe *upipe, struct uref *uref,
+                                   struct upump **upump_p)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    uint64_t cr_sys;
+    if (!ubase_check(uref_clock_get_cr_sys(uref, &cr_sys)))
+        cr_sys = UINT64_MAX;
+
+    if (unlikely(ubase_check(uref_flow_get_discontinuity(uref)))) {
+        for (unsigned int i = 0; i < upipe_ts_monitor->nb_pids; i++)
+            upipe_ts_monitor_pid_reset(&upipe_ts_monitor->pids[i]);
+        upipe_ts_monitor->period_start = UINT64_MAX;
+    }
+    if (cr_sys != UINT64_MAX)
+        upipe_ts_monitor_update_period(upipe, cr_sys);
+
+    size_t packet_size;
+    unsigned int nb;
+    const uint8_t *pids;
+    if (!ubase_check(uref_ts_vector_get(uref, &packet_size, &nb, &pids))) {
+        /* plain block of consecutive TS packets */
+        size_t size;
+        if (unlikely(!ubase_check(uref_block_size(uref, &size))))
+            size = 0;
+        packet_size = TS_SIZE;
+        nb = size / TS_SIZE;
+    }
+
+    if (likely(packet_size >= TS_SIZE && nb))
+        upipe_ts_monitor_work(upipe, uref, packet_size, nb, cr_sys);
+    else
+        upipe_warn(upipe, "invalid TS packet size");
+
+    if (upipe_ts_monitor->output == NULL) {
+        uref_free(uref);
+        return;
+    }
+    upipe_ts_monitor_output(upipe, uref, upump_p);
+}
+
+/** @internal @This sets the input flow definition.
+ *
+ * @param upipe description structure of the pipe
+ * @param flow_def flow definition packet
+ * @return an error code
+ */
+static int upipe_ts_monitor_set_flow_def(struct upipe *upipe,
+                                         struct uref *flow_def)
+{
+    if (flow_def == NULL)
+        return UBASE_ERR_INVALID;
+    UBASE_RETURN(uref_flow_match_def(flow_def, EXPECTED_FLOW_DEF))
+    struct uref *flow_def_dup = uref_dup(flow_def);
+    if (unlikely(flow_def_dup == NULL)) {
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return UBASE_ERR_ALLOC;
+    }
+    upipe_ts_monitor_store_flow_def(upipe, flow_def_dup);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This iterates over the PIDs seen on the input.
+ *
+ * @param upipe description structure of the pipe
+ * @param pid_p filled in with the next PID, or UINT_MAX
+ * @return an error code
+ */
+static int _upipe_ts_monitor_iterate_pid(struct upipe *upipe,
+                                             unsigned int *pid_p)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    unsigned int pid = *pid_p == UINT_MAX ? 0 : *pid_p + 1;
+    for ( ; pid < MAX_PIDS; pid++) {
+        if (upipe_ts_monitor->index[pid]) {
+            *pid_p = pid;
+            return UBASE_ERR_NONE;
+        }
+    }
+    *pid_p = UINT_MAX;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This resets the counters and maxima of all PIDs.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int _upipe_ts_monitor_reset_stats(struct upipe *upipe)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    for (unsigned int i = 0; i < upipe_ts_monitor->nb_pids; i++) {
+        struct upipe_ts_monitor_stats *stats =
+            &upipe_ts_monitor->pids[i].stats;
+        stats->packets = 0;
+        stats->cc_errors = 0;
+        stats->transport_errors = 0;
+        stats->pcrs = 0;
+        stats->pcr_interval_max = 0;
+        stats->pcr_accuracy_max = 0;
+        stats->pcr_jitter_max = 0;
+        for (unsigned int j = 0; j < stats->nb_tables; j++) {
+            stats->tables[j].count = 0;
+            stats->tables[j].interval_max = 0;
+        }
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This processes control commands on a ts_monitor pipe.
+ *
+ * @param upipe description structure of the pipe
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upipe_ts_monitor_control(struct upipe *upipe,
+                                    int command, va_list args)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+
+    UBASE_HANDLED_RETURN(upipe_ts_monitor_control_output(upipe, command, args));
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF: {
+            struct uref *flow_def = va_arg(args, struct uref *);
+            return upipe_ts_monitor_set_flow_def(upipe, flow_def);
+        }
+        case UPIPE_TS_MONITOR_ITERATE_PID: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MONITOR_SIGNATURE)
+            unsigned int *pid_p = va_arg(args, unsigned int *);
+            return _upipe_ts_monitor_iterate_pid(upipe, pid_p);
+        }
+        case UPIPE_TS_MONITOR_GET_STATS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MONITOR_SIGNATURE)
+            unsigned int pid = va_arg(args, unsigned int);
+            struct upipe_ts_monitor_stats *stats =
+                va_arg(args, struct upipe_ts_monitor_stats *);
+            if (pid >= MAX_PIDS || !upipe_ts_monitor->index[pid])
+                return UBASE_ERR_INVALID;
+            *stats = upipe_ts_monitor->pids[
+                upipe_ts_monitor->index[pid] - 1].stats;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_TS_MONITOR_RESET_STATS:
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MONITOR_SIGNATURE)
+            return _upipe_ts_monitor_reset_stats(upipe);
+        case UPIPE_TS_MONITOR_GET_PERIOD: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MONITOR_SIGNATURE)
+            uint64_t *period_p = va_arg(args, uint64_t *);
+            *period_p = upipe_ts_monitor->period;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_TS_MONITOR_SET_PERIOD: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MONITOR_SIGNATURE)
+            uint64_t period = va_arg(args, uint64_t);
+            if (!period)
+                return UBASE_ERR_INVALID;
+            upipe_ts_monitor->period = period;
+            return UBASE_ERR_NONE;
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @This frees a upipe.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_ts_monitor_free(struct upipe *upipe)
+{
+    struct upipe_ts_monitor *upipe_ts_monitor =
+        upipe_ts_monitor_from_upipe(upipe);
+    upipe_throw_dead(upipe);
+
+    free(upipe_ts_monitor->pids);
+    upipe_ts_monitor_clean_output(upipe);
+    upipe_ts_monitor_clean_urefcount(upipe);
+    upipe_ts_monitor_free_void(upipe);
+}
+
+/** module manager static descriptor */
+static struct upipe_mgr upipe_ts_monitor_mgr = {
+    .refcount = NULL,
+    .signature = UPIPE_TS_MONITOR_SIGNATURE,
+
+    .upipe_alloc = upipe_ts_monitor_alloc,
+    .upipe_input = upipe_ts_monitor_input,
+    .upipe_control = upipe_ts_monitor_control,
+
+    .upipe_mgr_control = NULL
+};
+
+/** @This returns the management structure for all ts_monitor pipes.
+ *
+ * @return pointer to manager
+ */
+struct upipe_mgr *upipe_ts_monitor_mgr_alloc(void)
+{
+    return &upipe_ts_monitor_mgr;
+}
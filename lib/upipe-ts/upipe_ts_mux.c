@@ -211,6 +211,31 @@ static int upipe_ts_mux_check(struct upipe *upipe, struct uref *unused);
 
 /** @hidden */
 struct upipe_ts_mux_psi_pid;
+/** @hidden */
+struct upipe_ts_mux_input;
+
+/** @internal @This lists the dates by which inputs are indexed for splice. */
+enum upipe_ts_mux_heap_key {
+    /** cr_sys of the next packet */
+    UPIPE_TS_MUX_HEAP_CR,
+    /** dts_sys of the next packet */
+    UPIPE_TS_MUX_HEAP_DTS,
+    /** cr_sys of the next PCR */
+    UPIPE_TS_MUX_HEAP_PCR,
+    /** number of heaps */
+    UPIPE_TS_MUX_HEAPS
+};
+
+/** @internal @This is a binary min-heap of inputs, keyed on one of their
+ * dates, with ties broken by splice order. */
+struct upipe_ts_mux_heap {
+    /** array of inputs */
+    struct upipe_ts_mux_input **inputs;
+    /** number of inputs in the heap */
+    size_t size;
+    /** number of allocated entries */
+    size_t allocated;
+};
 
 /** @internal @This is the private context of a ts_mux pipe. */
 struct upipe_ts_mux {
@@ -361,8 +386,26 @@ struct upipe_ts_mux {
     struct uref *uref;
     /** size of current aggregation */
     size_t uref_size;
+    /** lowest dts_sys of the current aggregation, in batch mode */
+    uint64_t uref_dts_sys;
+    /** size of output batches in file mode, or 0 */
+    size_t batch_size;
+    /** current batch, in file mode */
+    struct uref *batch;
+    /** write pointer to the buffer of the current batch */
+    uint8_t *batch_buffer;
+    /** size of the buffer of the current batch */
+    size_t batch_capacity;
+    /** number of octets written to the current batch */
+    size_t batch_offset;
     /** true during the preroll period */
     bool preroll;
+    /** inputs indexed by their dates, for splice */
+    struct upipe_ts_mux_heap heaps[UPIPE_TS_MUX_HEAPS];
+    /** list of inputs that are not ready, in splice order */
+    struct uchain unready_inputs;
+    /** last attributed splice order */
+    uint64_t splice_order_auto;
 
     /** manager of the pseudo inner sink */
     struct upipe_mgr inner_sink_mgr;
@@ -446,6 +489,8 @@ struct upipe_ts_mux_program {
 
     /** calculated required octetrate including overheads and PMT */
     uint64_t required_octetrate;
+    /** splice order of the program */
+    uint64_t splice_order;
 
     /** interval between PMTs */
     uint64_t pmt_interval;
@@ -568,6 +613,12 @@ struct upipe_ts_mux_input {
     uint64_t pcr_sys;
     /** true if the input is ready to output packet */
     bool ready;
+    /** splice order of the input in its program */
+    uint64_t splice_order;
+    /** positions of the input in the heaps of the mux */
+    size_t heap_index[UPIPE_TS_MUX_HEAPS];
+    /** structure for double-linked lists of inputs that are not ready */
+    struct uchain uchain_unready;
 
     /** psi_pid structure for PSI-based elementary streams */
     struct upipe_ts_mux_psi_pid *psi_pid;
@@ -601,6 +652,7 @@ UPIPE_HELPER_BIN_INPUT(upipe_ts_mux_input, input, input_request_list)
 
 UBASE_FROM_TO(upipe_ts_mux_input, urefcount, urefcount_real, urefcount_real)
 UBASE_FROM_TO(upipe_ts_mux_input, uchain, uchain_psi, uchain_psi)
+UBASE_FROM_TO(upipe_ts_mux_input, uchain, uchain_unready, uchain_unready)
 
 UPIPE_HELPER_SUBPIPE(upipe_ts_mux_program, upipe_ts_mux_input, input,
                      input_mgr, inputs, uchain)
@@ -609,6 +661,350 @@ UPIPE_HELPER_SUBPIPE(upipe_ts_mux_program, upipe_ts_mux_input, input,
 static void upipe_ts_mux_input_free(struct urefcount *urefcount_real);
 
 
+/*
+ * input scheduling
+ */
+
+/** @internal @This returns the program of an input.
+ *
+ * @param input private context of the input
+ * @return pointer to the program
+ */
+static inline struct upipe_ts_mux_program *
+    upipe_ts_mux_input_program(struct upipe_ts_mux_input *input)
+{
+    return upipe_ts_mux_program_from_input_mgr(
+            upipe_ts_mux_input_to_upipe(input)->mgr);
+}
+
+/** @internal @This returns the mux of an input.
+ *
+ * @param input private context of the input
+ * @return pointer to the mux
+ */
+static inline struct upipe_ts_mux *
+    upipe_ts_mux_input_mux(struct upipe_ts_mux_input *input)
+{
+    return upipe_ts_mux_from_program_mgr(upipe_ts_mux_program_to_upipe(
+                upipe_ts_mux_input_program(input))->mgr);
+}
+
+/** @internal @This checks whether an input comes after a position in splice
+ * order, that is the order of the programs and of their inputs.
+ *
+ * @param input private context of the input
+ * @param program_order splice order of the program of the position
+ * @param input_order splice order of the input of the position
+ * @return true if the input comes strictly after the position
+ */
+static inline bool upipe_ts_mux_input_after(struct upipe_ts_mux_input *input,
+                                            uint64_t program_order,
+                                            uint64_t input_order)
+{
+    uint64_t order = upipe_ts_mux_input_program(input)->splice_order;
+    return order > program_order ||
+           (order == program_order && input->splice_order > input_order);
+}
+
+/** @internal @This checks whether an input comes before another input in
+ * splice order.
+ *
+ * @param input1 private context of the first input
+ * @param input2 private context of the second input
+ * @return true if the first input comes strictly before the second input
+ */
+static inline bool upipe_ts_mux_input_precedes(
+        struct upipe_ts_mux_input *input1, struct upipe_ts_mux_input *input2)
+{
+    return upipe_ts_mux_input_after(input2,
+            upipe_ts_mux_input_program(input1)->splice_order,
+            input1->splice_order);
+}
+
+/** @internal @This returns the date of an input indexed by a heap.
+ *
+ * @param input private context of the input
+ * @param key key of the heap
+ * @return the date of the input
+ */
+static inline uint64_t upipe_ts_mux_input_date(
+        struct upipe_ts_mux_input *input, enum upipe_ts_mux_heap_key key)
+{
+    switch (key) {
+        case UPIPE_TS_MUX_HEAP_CR:
+            return input->cr_sys;
+        case UPIPE_TS_MUX_HEAP_DTS:
+            return input->dts_sys;
+        default:
+            return input->pcr_sys;
+    }
+}
+
+/** @internal @This compares two inputs in a heap.
+ *
+ * @param input1 private context of the first input
+ * @param input2 private context of the second input
+ * @param key key of the heap
+ * @return true if the first input must be closer to the top of the heap
+ */
+static inline bool upipe_ts_mux_heap_less(struct upipe_ts_mux_input *input1,
+                                          struct upipe_ts_mux_input *input2,
+                                          enum upipe_ts_mux_heap_key key)
+{
+    uint64_t date1 = upipe_ts_mux_input_date(input1, key);
+    uint64_t date2 = upipe_ts_mux_input_date(input2, key);
+    if (date1 != date2)
+        return date1 < date2;
+    return upipe_ts_mux_input_precedes(input1, input2);
+}
+
+/** @internal @This stores an input at the given position of a heap.
+ *
+ * @param heap pointer to the heap
+ * @param key key of the heap
+ * @param index position in the heap
+ * @param input private context of the input
+ */
+static inline void upipe_ts_mux_heap_set(struct upipe_ts_mux_heap *heap,
+                                         enum upipe_ts_mux_heap_key key,
+                                         size_t index,
+                                         struct upipe_ts_mux_input *input)
+{
+    heap->inputs[index] = input;
+    input->heap_index[key] = index;
+}
+
+/** @internal @This moves an input towards the top of a heap.
+ *
+ * @param heap pointer to the heap
+ * @param key key of the heap
+ * @param index position of the input in the heap
+ */
+static void upipe_ts_mux_heap_sift_up(struct upipe_ts_mux_heap *heap,
+                                      enum upipe_ts_mux_heap_key key,
+                                      size_t index)
+{
+    struct upipe_ts_mux_input *input = heap->inputs[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!upipe_ts_mux_heap_less(input, heap->inputs[parent], key))
+            break;
+        upipe_ts_mux_heap_set(heap, key, index, heap->inputs[parent]);
+        index = parent;
+    }
+    upipe_ts_mux_heap_set(heap, key, index, input);
+}
+
+/** @internal @This moves an input towards the bottom of a heap.
+ *
+ * @param heap pointer to the heap
+ * @param key key of the heap
+ * @param index position of the input in the heap
+ */
+static void upipe_ts_mux_heap_sift_down(struct upipe_ts_mux_heap *heap,
+                                        enum upipe_ts_mux_heap_key key,
+                                        size_t index)
+{
+    struct upipe_ts_mux_input *input = heap->inputs[index];
+    for ( ; ; ) {
+        size_t child = 2 * index + 1;
+        if (child >= heap->size)
+            break;
+        if (child + 1 < heap->size &&
+            upipe_ts_mux_heap_less(heap->inputs[child + 1],
+                                   heap->inputs[child], key))
+            child++;
+        if (!upipe_ts_mux_heap_less(heap->inputs[child], input, key))
+            break;
+        upipe_ts_mux_heap_set(heap, key, index, heap->inputs[child]);
+        index = child;
+    }
+    upipe_ts_mux_heap_set(heap, key, index, input);
+}
+
+/** @internal @This restores the heap property after the date of an input
+ * has changed.
+ *
+ * @param heap pointer to the heap
+ * @param key key of the heap
+ * @param index position of the input in the heap
+ */
+static void upipe_ts_mux_heap_fix(struct upipe_ts_mux_heap *heap,
+                                  enum upipe_ts_mux_heap_key key,
+                                  size_t index)
+{
+    if (index > 0 && upipe_ts_mux_heap_less(heap->inputs[index],
+                                            heap->inputs[(index - 1) / 2],
+                                            key))
+        upipe_ts_mux_heap_sift_up(heap, key, index);
+    else
+        upipe_ts_mux_heap_sift_down(heap, key, index);
+}
+
+/** @internal @This inserts an input into a heap.
+ *
+ * @param heap pointer to the heap
+ * @param key key of the heap
+ * @param input private context of the input
+ * @return an error code
+ */
+static int upipe_ts_mux_heap_insert(struct upipe_ts_mux_heap *heap,
+                                    enum upipe_ts_mux_heap_key key,
+                                    struct upipe_ts_mux_input *input)
+{
+    if (heap->size == heap->allocated) {
+        size_t allocated = heap->allocated ? heap->allocated * 2 : 16;
+        struct upipe_ts_mux_input **inputs =
+            realloc(heap->inputs, allocated * sizeof(*inputs));
+        if (unlikely(inputs == NULL))
+            return UBASE_ERR_ALLOC;
+        heap->inputs = inputs;
+        heap->allocated = allocated;
+    }
+    heap->inputs[heap->size] = input;
+    upipe_ts_mux_heap_sift_up(heap, key, heap->size++);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This removes an input from a heap, if it is present.
+ *
+ * @param heap pointer to the heap
+ * @param key key of the heap
+ * @param input private context of the input
+ */
+static void upipe_ts_mux_heap_remove(struct upipe_ts_mux_heap *heap,
+                                     enum upipe_ts_mux_heap_key key,
+                                     struct upipe_ts_mux_input *input)
+{
+    size_t index = input->heap_index[key];
+    if (index == SIZE_MAX)
+        return;
+    input->heap_index[key] = SIZE_MAX;
+    if (index == --heap->size)
+        return;
+    upipe_ts_mux_heap_set(heap, key, index, heap->inputs[heap->size]);
+    upipe_ts_mux_heap_fix(heap, key, index);
+}
+
+/** @internal @This finds, in the subtree of a heap, the first input in splice
+ * order after a position whose date is lower than or equal to a limit.
+ *
+ * @param heap pointer to the heap
+ * @param key key of the heap
+ * @param index root of the subtree
+ * @param limit maximum date
+ * @param program_order splice order of the program of the position
+ * @param input_order splice order of the input of the position
+ * @param first first input found so far, or NULL
+ * @return the first input found, or NULL
+ */
+static struct upipe_ts_mux_input *
+    upipe_ts_mux_heap_first(struct upipe_ts_mux_heap *heap,
+                            enum upipe_ts_mux_heap_key key, size_t index,
+                            uint64_t limit, uint64_t program_order,
+                            uint64_t input_order,
+                            struct upipe_ts_mux_input *first)
+{
+    if (index >= heap->size)
+        return first;
+    struct upipe_ts_mux_input *input = heap->inputs[index];
+    if (upipe_ts_mux_input_date(input, key) > limit)
+        return first;
+
+    if (upipe_ts_mux_input_after(input, program_order, input_order) &&
+        (first == NULL || upipe_ts_mux_input_precedes(input, first)))
+        first = input;
+    first = upipe_ts_mux_heap_first(heap, key, 2 * index + 1, limit,
+                                    program_order, input_order, first);
+    return upipe_ts_mux_heap_first(heap, key, 2 * index + 2, limit,
+                                   program_order, input_order, first);
+}
+
+/** @internal @This finds, in the subtree of the cr_sys heap, the lowest
+ * cr_sys of inputs that are not being deleted while not ready.
+ *
+ * @param heap pointer to the cr_sys heap
+ * @param index root of the subtree
+ * @return the lowest cr_sys, or UINT64_MAX
+ */
+static uint64_t upipe_ts_mux_heap_available(struct upipe_ts_mux_heap *heap,
+                                            size_t index)
+{
+    if (index >= heap->size)
+        return UINT64_MAX;
+    struct upipe_ts_mux_input *input = heap->inputs[index];
+    if (!input->deleted || input->ready)
+        return input->cr_sys;
+
+    uint64_t cr_sys1 = upipe_ts_mux_heap_available(heap, 2 * index + 1);
+    uint64_t cr_sys2 = upipe_ts_mux_heap_available(heap, 2 * index + 2);
+    return cr_sys1 < cr_sys2 ? cr_sys1 : cr_sys2;
+}
+
+/** @internal @This updates the scheduling structures of the mux after the
+ * status of an input has changed.
+ *
+ * @param input private context of the input
+ */
+static void upipe_ts_mux_input_update_schedule(struct upipe_ts_mux_input *input)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_input_mux(input);
+    for (int key = 0; key < UPIPE_TS_MUX_HEAPS; key++)
+        if (input->heap_index[key] != SIZE_MAX)
+            upipe_ts_mux_heap_fix(&mux->heaps[key], key,
+                                  input->heap_index[key]);
+
+    struct uchain *uchain_unready = upipe_ts_mux_input_to_uchain_unready(input);
+    if (input->ready) {
+        if (ulist_is_in(uchain_unready))
+            ulist_delete(uchain_unready);
+    } else if (!ulist_is_in(uchain_unready)) {
+        /* keep the list in splice order */
+        struct uchain *uchain;
+        ulist_foreach_reverse (&mux->unready_inputs, uchain) {
+            if (upipe_ts_mux_input_precedes(
+                        upipe_ts_mux_input_from_uchain_unready(uchain), input))
+                break;
+        }
+        ulist_insert(uchain, uchain->next, uchain_unready);
+    }
+}
+
+/** @internal @This adds an input to the scheduling structures of the mux.
+ *
+ * @param input private context of the input
+ * @return an error code
+ */
+static int upipe_ts_mux_input_init_schedule(struct upipe_ts_mux_input *input)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_input_mux(input);
+    input->splice_order = ++mux->splice_order_auto;
+    uchain_init(upipe_ts_mux_input_to_uchain_unready(input));
+    for (int key = 0; key < UPIPE_TS_MUX_HEAPS; key++)
+        input->heap_index[key] = SIZE_MAX;
+
+    for (int key = 0; key < UPIPE_TS_MUX_HEAPS; key++)
+        UBASE_RETURN(upipe_ts_mux_heap_insert(&mux->heaps[key], key, input))
+    upipe_ts_mux_input_update_schedule(input);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This removes an input from the scheduling structures of the
+ * mux.
+ *
+ * @param input private context of the input
+ */
+static void upipe_ts_mux_input_clean_schedule(struct upipe_ts_mux_input *input)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_input_mux(input);
+    for (int key = 0; key < UPIPE_TS_MUX_HEAPS; key++)
+        upipe_ts_mux_heap_remove(&mux->heaps[key], key, input);
+    struct uchain *uchain_unready = upipe_ts_mux_input_to_uchain_unready(input);
+    if (ulist_is_in(uchain_unready))
+        ulist_delete(uchain_unready);
+}
+
+
 /*
  * psi_pid structure handling
  */
@@ -972,6 +1368,7 @@ static int upipe_ts_mux_input_encaps_probe(struct uprobe *uprobe,
     upipe_ts_mux_input->dts_sys = va_arg(args, uint64_t);
     upipe_ts_mux_input->pcr_sys = va_arg(args, uint64_t);
     upipe_ts_mux_input->ready = !!va_arg(args, int);
+    upipe_ts_mux_input_update_schedule(upipe_ts_mux_input);
     return UBASE_ERR_NONE;
 }
 
@@ -1030,6 +1427,7 @@ static struct upipe *upipe_ts_mux_input_alloc(struct upipe_mgr *mgr,
         upipe_ts_mux_input->original_au_per_sec.den = 0;
 
     upipe_ts_mux_input_init_sub(upipe);
+    int err = upipe_ts_mux_input_init_schedule(upipe_ts_mux_input);
     uprobe_init(&upipe_ts_mux_input->probe, upipe_ts_mux_input_probe, NULL);
     upipe_ts_mux_input->probe.refcount =
         upipe_ts_mux_input_to_urefcount_real(upipe_ts_mux_input);
@@ -1039,6 +1437,11 @@ static struct upipe *upipe_ts_mux_input_alloc(struct upipe_mgr *mgr,
         upipe_ts_mux_input_to_urefcount_real(upipe_ts_mux_input);
     upipe_throw_ready(upipe);
 
+    if (unlikely(!ubase_check(err))) {
+        upipe_throw_fatal(upipe, err);
+        return upipe;
+    }
+
     struct upipe_ts_mux_mgr *ts_mux_mgr =
         upipe_ts_mux_mgr_from_upipe_mgr(upipe_ts_mux_to_upipe(upipe_ts_mux)->mgr);
     if (unlikely((upipe_ts_mux_input->tstd =
@@ -1383,6 +1786,7 @@ static int upipe_ts_mux_input_set_flow_def(struct upipe *upipe,
         input->dts_sys = UINT64_MAX;
         input->pcr_sys = UINT64_MAX;
         input->ready = false;
+        upipe_ts_mux_input_update_schedule(input);
         if (!ulist_is_in(upipe_ts_mux_input_to_uchain_psi(input)))
             ulist_add(&upipe_ts_mux->psi_inputs,
                       upipe_ts_mux_input_to_uchain_psi(input));
@@ -1829,6 +2233,7 @@ static void upipe_ts_mux_input_free(struct urefcount *urefcount_real)
     struct upipe_ts_mux_program *program =
         upipe_ts_mux_program_from_input_mgr(upipe->mgr);
 
+    upipe_ts_mux_input_clean_schedule(upipe_ts_mux_input);
     upipe_ts_mux_input_clean_sub(upipe);
     if (!upipe_single(upipe_ts_mux_program_to_upipe(program)))
         upipe_ts_mux_program_change(upipe_ts_mux_program_to_upipe(program));
@@ -2030,6 +2435,7 @@ static struct upipe *upipe_ts_mux_program_alloc(struct upipe_mgr *mgr,
     upipe_ts_mux_program->pes_min_duration = upipe_ts_mux->pes_min_duration;
     upipe_ts_mux_program->max_delay = upipe_ts_mux->max_delay;
     upipe_ts_mux_program->required_octetrate = 0;
+    upipe_ts_mux_program->splice_order = ++upipe_ts_mux->splice_order_auto;
     upipe_ts_mux_program_init_sub(upipe);
 
     uprobe_init(&upipe_ts_mux_program->probe, upipe_ts_mux_program_probe, NULL);
@@ -2928,7 +3334,19 @@ static struct upipe *upipe_ts_mux_alloc(struct upipe_mgr *mgr,
     upipe_ts_mux->cr_sys_remainder = 0;
     upipe_ts_mux->uref = NULL;
     upipe_ts_mux->uref_size = 0;
+    upipe_ts_mux->uref_dts_sys = UINT64_MAX;
+    upipe_ts_mux->batch_size = 0;
+    upipe_ts_mux->batch = NULL;
+    upipe_ts_mux->batch_buffer = NULL;
+    upipe_ts_mux->batch_capacity = 0;
+    upipe_ts_mux->batch_offset = 0;
     upipe_ts_mux->preroll = true;
+    for (int key = 0; key < UPIPE_TS_MUX_HEAPS; key++) {
+        upipe_ts_mux->heaps[key].inputs = NULL;
+        upipe_ts_mux->heaps[key].size = upipe_ts_mux->heaps[key].allocated = 0;
+    }
+    ulist_init(&upipe_ts_mux->unready_inputs);
+    upipe_ts_mux->splice_order_auto = 0;
 
     uprobe_init(&upipe_ts_mux->probe, upipe_ts_mux_probe, NULL);
     upipe_ts_mux->probe.refcount = upipe_ts_mux_to_urefcount_real(upipe_ts_mux);
@@ -3090,48 +3508,49 @@ static void upipe_ts_mux_splice(struct upipe *upipe, struct ubuf **ubuf_p,
         return;
     }
 
-    /* 2. Inputs */
-    uint64_t cr_sys = UINT64_MAX;
-    struct upipe_ts_mux_input *selected_input = NULL;
-    struct uchain *uchain_tmp;
-    ulist_delete_foreach (&mux->programs, uchain, uchain_tmp) {
-        struct upipe_ts_mux_program *program =
-            upipe_ts_mux_program_from_uchain(uchain);
-        upipe_use(upipe_ts_mux_program_to_upipe(program));
-
-        struct uchain *uchain_input, *uchain_tmp2;
-        ulist_delete_foreach (&program->inputs, uchain_input, uchain_tmp2) {
-            struct upipe_ts_mux_input *input =
-                upipe_ts_mux_input_from_uchain(uchain_input);
-            if (input->dts_sys < original_cr_sys) { /* flush */
-                upipe_ts_encaps_splice(input->encaps, original_cr_sys,
-                                       original_cr_sys + mux->interval,
-                                       NULL, NULL);
-
-                if (input->deleted && !input->ready) {
-                    /* This triggers the immediate deletion of the input. */
-                    upipe_release(input->encaps);
-                    continue;
-                }
-            }
+    /* 2. Inputs whose dts_sys or PCR is due, in splice order */
+    struct upipe_ts_mux_input *selected_input;
+    uint64_t program_order = 0, input_order = 0;
+    for ( ; ; ) {
+        selected_input = upipe_ts_mux_heap_first(
+                &mux->heaps[UPIPE_TS_MUX_HEAP_DTS], UPIPE_TS_MUX_HEAP_DTS, 0,
+                original_cr_sys + mux->interval, program_order, input_order,
+                NULL);
+        selected_input = upipe_ts_mux_heap_first(
+                &mux->heaps[UPIPE_TS_MUX_HEAP_PCR], UPIPE_TS_MUX_HEAP_PCR, 0,
+                original_cr_sys, program_order, input_order, selected_input);
+        if (selected_input == NULL)
+            break;
 
-            if (input->dts_sys <= original_cr_sys + mux->interval ||
-                input->pcr_sys <= original_cr_sys) {
-                selected_input = input;
+        struct upipe_ts_mux_program *program =
+            upipe_ts_mux_input_program(selected_input);
+        program_order = program->splice_order;
+        input_order = selected_input->splice_order;
+
+        if (selected_input->dts_sys < original_cr_sys) { /* flush */
+            upipe_ts_encaps_splice(selected_input->encaps, original_cr_sys,
+                                   original_cr_sys + mux->interval,
+                                   NULL, NULL);
+
+            if (selected_input->deleted && !selected_input->ready) {
+                /* This triggers the immediate deletion of the input. */
+                upipe_use(upipe_ts_mux_program_to_upipe(program));
+                upipe_release(selected_input->encaps);
                 upipe_release(upipe_ts_mux_program_to_upipe(program));
-                goto upipe_ts_mux_splice_done;
-            }
-            if (input->cr_sys < cr_sys) {
-                selected_input = input;
-                cr_sys = input->cr_sys;
+                continue;
             }
         }
 
-        upipe_release(upipe_ts_mux_program_to_upipe(program));
+        if (selected_input->dts_sys <= original_cr_sys + mux->interval ||
+            selected_input->pcr_sys <= original_cr_sys)
+            goto upipe_ts_mux_splice_done;
     }
 
-    if (selected_input == NULL ||
-        selected_input->cr_sys > original_cr_sys)
+    /* 3. Input with the lowest cr_sys */
+    if (!mux->heaps[UPIPE_TS_MUX_HEAP_CR].size)
+        return;
+    selected_input = mux->heaps[UPIPE_TS_MUX_HEAP_CR].inputs[0];
+    if (selected_input->cr_sys > original_cr_sys)
         return;
 
 upipe_ts_mux_splice_done:
@@ -3149,6 +3568,90 @@ upipe_ts_mux_splice_done:
     }
 }
 
+/** @internal @This outputs the current batch (file mode only).
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_mux_batch_output(struct upipe *upipe,
+                                      struct upump **upump_p)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    struct uref *batch = mux->batch;
+    if (batch == NULL)
+        return;
+
+    uref_block_unmap(batch, 0);
+    if (mux->batch_offset < mux->batch_capacity)
+        uref_block_resize(batch, 0, mux->batch_offset);
+    mux->batch = NULL;
+    mux->batch_buffer = NULL;
+    mux->batch_capacity = 0;
+    mux->batch_offset = 0;
+    upipe_ts_mux_output(upipe, batch, upump_p);
+}
+
+/** @internal @This copies a TS packet to the current batch, allocating it
+ * if needed (file mode only).
+ *
+ * @param upipe description structure of the pipe
+ * @param ubuf ubuf to append
+ * @param dts_sys dts_sys associated with the ubuf
+ */
+static void upipe_ts_mux_batch_append(struct upipe *upipe, struct ubuf *ubuf,
+                                      uint64_t dts_sys)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    if (mux->batch != NULL && mux->batch_offset + TS_SIZE > mux->batch_capacity)
+        upipe_ts_mux_batch_output(upipe, NULL);
+
+    if (mux->batch == NULL) {
+        size_t capacity = mux->batch_size > mux->mtu ? mux->batch_size :
+                          mux->mtu;
+        int size = -1;
+        mux->batch = uref_block_alloc(mux->uref_mgr, mux->ubuf_mgr, capacity);
+        if (unlikely(mux->batch == NULL ||
+                     !ubase_check(uref_block_write(mux->batch, 0, &size,
+                                                   &mux->batch_buffer)))) {
+            uref_free(mux->batch);
+            mux->batch = NULL;
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            ubuf_free(ubuf);
+            return;
+        }
+        mux->batch_capacity = size;
+        uref_clock_set_cr_sys(mux->batch, mux->cr_sys);
+        if (dts_sys != UINT64_MAX)
+            uref_clock_set_cr_dts_delay(mux->batch, dts_sys - mux->cr_sys);
+    }
+
+    if (unlikely(!ubase_check(ubuf_block_extract(ubuf, 0, TS_SIZE,
+                                    mux->batch_buffer + mux->batch_offset))))
+        upipe_warn(upipe, "unable to read TS packet");
+    ubuf_free(ubuf);
+    mux->batch_offset += TS_SIZE;
+    if (dts_sys < mux->uref_dts_sys)
+        mux->uref_dts_sys = dts_sys;
+    mux->uref_size += TS_SIZE;
+}
+
+/** @internal @This returns the lowest dts_sys of the current aggregation.
+ *
+ * @param upipe description structure of the pipe
+ * @param dts_sys_p filled in with the dts_sys
+ * @return false if the current aggregation has no dts_sys
+ */
+static bool upipe_ts_mux_get_dts_sys(struct upipe *upipe, uint64_t *dts_sys_p)
+{
+    struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    if (mux->batch_size && !mux->live) {
+        *dts_sys_p = mux->uref_dts_sys;
+        return mux->uref_size && mux->uref_dts_sys != UINT64_MAX;
+    }
+    return mux->uref != NULL &&
+           ubase_check(uref_clock_get_dts_sys(mux->uref, dts_sys_p));
+}
+
 /** @internal @This appends a uref to our buffer.
  *
  * @param upipe description structure of the pipe
@@ -3159,6 +3662,11 @@ static void upipe_ts_mux_append(struct upipe *upipe, struct ubuf *ubuf,
                                 uint64_t dts_sys)
 {
     struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    if (mux->batch_size && !mux->live) {
+        upipe_ts_mux_batch_append(upipe, ubuf, dts_sys);
+        return;
+    }
+
     if (mux->uref == NULL) {
         mux->uref = uref_alloc(mux->uref_mgr);
         if (unlikely(mux->uref == NULL)) {
@@ -3190,6 +3698,14 @@ static void upipe_ts_mux_append(struct upipe *upipe, struct ubuf *ubuf,
 static void upipe_ts_mux_complete(struct upipe *upipe, struct upump **upump_p)
 {
     struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
+    if (mux->batch_size && !mux->live) {
+        mux->uref_size = 0;
+        mux->uref_dts_sys = UINT64_MAX;
+        if (mux->batch_offset + mux->mtu > mux->batch_capacity)
+            upipe_ts_mux_batch_output(upipe, upump_p);
+        return;
+    }
+
     struct uref *uref = mux->uref;
     mux->uref = NULL;
     mux->uref_size = 0;
@@ -3263,39 +3779,25 @@ static void upipe_ts_mux_watcher(struct upump *upump)
 static uint64_t upipe_ts_mux_check_available(struct upipe *upipe)
 {
     struct upipe_ts_mux *mux = upipe_ts_mux_from_upipe(upipe);
-    uint64_t min_cr_sys = UINT64_MAX;
-
-    struct uchain *uchain_program, *uchain_program_tmp;
-    ulist_delete_foreach (&mux->programs, uchain_program,
-                          uchain_program_tmp) {
-        struct upipe_ts_mux_program *program =
-            upipe_ts_mux_program_from_uchain(uchain_program);
-        upipe_use(upipe_ts_mux_program_to_upipe(program));
 
-        struct uchain *uchain_input, *uchain_input_tmp;
-        ulist_delete_foreach (&program->inputs, uchain_input,
-                              uchain_input_tmp) {
-            struct upipe_ts_mux_input *input =
-                upipe_ts_mux_input_from_uchain(uchain_input);
-            if (!input->ready) {
-                if (input->deleted) {
-                    upipe_release(input->encaps);
-                    continue;
-                } else if (input->input_type != UPIPE_TS_MUX_INPUT_OTHER &&
-                           input->input_type != UPIPE_TS_MUX_INPUT_SCTE35 &&
-                           input->input_type != UPIPE_TS_MUX_INPUT_METADATA &&
-                           (input->input_type != UPIPE_TS_MUX_INPUT_UNKNOWN ||
-                            mux->preroll)) {
-                    upipe_release(upipe_ts_mux_program_to_upipe(program));
-                    return UINT64_MAX;
-                }
-            }
-            if (min_cr_sys > input->cr_sys)
-                min_cr_sys = input->cr_sys;
-        }
-        upipe_release(upipe_ts_mux_program_to_upipe(program));
+    struct uchain *uchain, *uchain_tmp;
+    ulist_delete_foreach (&mux->unready_inputs, uchain, uchain_tmp) {
+        struct upipe_ts_mux_input *input =
+            upipe_ts_mux_input_from_uchain_unready(uchain);
+        if (input->deleted) {
+            struct upipe_ts_mux_program *program =
+                upipe_ts_mux_input_program(input);
+            upipe_use(upipe_ts_mux_program_to_upipe(program));
+            upipe_release(input->encaps);
+            upipe_release(upipe_ts_mux_program_to_upipe(program));
+        } else if (input->input_type != UPIPE_TS_MUX_INPUT_OTHER &&
+                   input->input_type != UPIPE_TS_MUX_INPUT_SCTE35 &&
+                   input->input_type != UPIPE_TS_MUX_INPUT_METADATA &&
+                   (input->input_type != UPIPE_TS_MUX_INPUT_UNKNOWN ||
+                    mux->preroll))
+            return UINT64_MAX;
     }
-    return min_cr_sys;
+    return upipe_ts_mux_heap_available(&mux->heaps[UPIPE_TS_MUX_HEAP_CR], 0);
 }
 
 /** @internal @This sets the initial cr_prog of all programs.
@@ -3355,8 +3857,7 @@ static void upipe_ts_mux_work_file(struct upipe *upipe, struct upump **upump_p)
         }
 
         if (mux->mode == UPIPE_TS_MUX_MODE_CAPPED &&
-            (mux->uref == NULL ||
-             !ubase_check(uref_clock_get_dts_sys(mux->uref, &dts_sys)) ||
+            (!upipe_ts_mux_get_dts_sys(upipe, &dts_sys) ||
              dts_sys + mux->latency >= upipe_ts_mux_show_increment(upipe))) {
             upipe_ts_mux_increment(upipe);
             continue;
@@ -4034,6 +4535,41 @@ static int upipe_ts_mux_set_output_size(struct upipe *upipe, unsigned int mtu)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This returns the size of output batches in file mode.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_size_p filled in with the size of batches, in octets, or 0
+ * @return an error code
+ */
+static int _upipe_ts_mux_get_batch_size(struct upipe *upipe,
+                                        unsigned int *batch_size_p)
+{
+    struct upipe_ts_mux *upipe_ts_mux = upipe_ts_mux_from_upipe(upipe);
+    assert(batch_size_p != NULL);
+    *batch_size_p = upipe_ts_mux->batch_size;
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This sets the size of output batches in file mode.
+ *
+ * @param upipe description structure of the pipe
+ * @param batch_size size of batches, in octets, or 0 to disable batches
+ * @return an error code
+ */
+static int _upipe_ts_mux_set_batch_size(struct upipe *upipe,
+                                        unsigned int batch_size)
+{
+    struct upipe_ts_mux *upipe_ts_mux = upipe_ts_mux_from_upipe(upipe);
+    batch_size -= batch_size % TS_SIZE;
+    if (unlikely(upipe_ts_mux->uref_size &&
+                 !batch_size != !upipe_ts_mux->batch_size))
+        return UBASE_ERR_BUSY;
+    upipe_ts_mux->batch_size = batch_size;
+    if (!batch_size)
+        upipe_ts_mux_batch_output(upipe, NULL);
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This ends the preroll period.
  *
  * @param upipe description structure of the pipe
@@ -4978,6 +5514,16 @@ static int _upipe_ts_mux_control(struct upipe *upipe, int command, va_list args)
             int force = va_arg(args, int);
             return _upipe_ts_mux_force_pes_alignment(upipe, !!force);
         }
+        case UPIPE_TS_MUX_GET_BATCH_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            unsigned int *batch_size_p = va_arg(args, unsigned int *);
+            return _upipe_ts_mux_get_batch_size(upipe, batch_size_p);
+        }
+        case UPIPE_TS_MUX_SET_BATCH_SIZE: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            unsigned int batch_size = va_arg(args, unsigned int);
+            return _upipe_ts_mux_set_batch_size(upipe, batch_size);
+        }
 
         case UPIPE_TS_MUX_GET_VERSION:
         case UPIPE_TS_MUX_SET_VERSION:
@@ -5026,10 +5572,8 @@ static void upipe_ts_mux_free(struct urefcount *urefcount_real)
     struct upipe_ts_mux *mux = upipe_ts_mux_from_urefcount_real(urefcount_real);
     struct upipe *upipe = upipe_ts_mux_to_upipe(mux);
 
-    if (mux->uref != NULL) {
-        size_t uref_size;
-        while ((ubase_check(uref_block_size(mux->uref, &uref_size)) &&
-                uref_size < mux->mtu)) {
+    if (mux->uref_size) {
+        while (mux->uref_size < mux->mtu) {
             struct ubuf *ubuf = ubuf_dup(mux->padding);
             if (ubuf == NULL)
                 break;
@@ -5038,11 +5582,14 @@ static void upipe_ts_mux_free(struct urefcount *urefcount_real)
 
         upipe_ts_mux_complete(upipe, NULL);
     }
+    upipe_ts_mux_batch_output(upipe, NULL);
 
     upipe_throw_dead(upipe);
 
     ubuf_free(mux->padding);
     uref_free(mux->flow_def_input);
+    for (int key = 0; key < UPIPE_TS_MUX_HEAPS; key++)
+        free(mux->heaps[key].inputs);
     uprobe_clean(&mux->probe);
     urefcount_clean(urefcount_real);
     upipe_ts_mux_clean_inner_sink(upipe);
@@ -325,6 +325,97 @@ static struct upipe *upipe_ts_sig_service_alloc(struct upipe_mgr *mgr,
     return upipe;
 }
 
+/** @internal @This frees a list of PSI sections.
+ *
+ * @param sections list of sections
+ */
+static void upipe_ts_sig_free_sections(struct uchain *sections)
+{
+    struct uchain *section_chain;
+    while ((section_chain = ulist_pop(sections)) != NULL)
+        ubuf_free(ubuf_from_uchain(section_chain));
+}
+
+/** @internal @This checks if two PSI sections are identical, except for
+ * the version number and the CRC.
+ *
+ * @param ubuf1 first section
+ * @param ubuf2 second section
+ * @return true if the sections are identical
+ */
+static bool upipe_ts_sig_section_equal(struct ubuf *ubuf1, struct ubuf *ubuf2)
+{
+    size_t size1, size2;
+    if (!ubase_check(ubuf_block_size(ubuf1, &size1)) ||
+        !ubase_check(ubuf_block_size(ubuf2, &size2)) || size1 != size2 ||
+        size1 < PSI_HEADER_SIZE_SYNTAX1 + PSI_CRC_SIZE)
+        return false;
+
+    const uint8_t *buffer1, *buffer2;
+    int read1 = -1, read2 = -1;
+    if (!ubase_check(ubuf_block_read(ubuf1, 0, &read1, &buffer1)))
+        return false;
+    if (!ubase_check(ubuf_block_read(ubuf2, 0, &read2, &buffer2))) {
+        ubuf_block_unmap(ubuf1, 0);
+        return false;
+    }
+
+    bool equal = read1 == size1 && read2 == size2 &&
+        !memcmp(buffer1, buffer2, 5) &&
+        (buffer1[5] & 0xc1) == (buffer2[5] & 0xc1) &&
+        !memcmp(buffer1 + 6, buffer2 + 6, size1 - 6 - PSI_CRC_SIZE);
+    ubuf_block_unmap(ubuf1, 0);
+    ubuf_block_unmap(ubuf2, 0);
+    return equal;
+}
+
+/** @internal @This checks if newly built PSI sections are identical to the
+ * previous ones, except for the version number and the CRC.
+ *
+ * @param sections list of new sections
+ * @param old_sections list of previous sections
+ * @return true if the sections are identical
+ */
+static bool upipe_ts_sig_sections_equal(struct uchain *sections,
+                                        struct uchain *old_sections)
+{
+    struct uchain *chain = sections->next, *old_chain = old_sections->next;
+    while (chain != sections && old_chain != old_sections) {
+        if (!upipe_ts_sig_section_equal(ubuf_from_uchain(chain),
+                                        ubuf_from_uchain(old_chain)))
+            return false;
+        chain = chain->next;
+        old_chain = old_chain->next;
+    }
+    return chain == sections && old_chain == old_sections;
+}
+
+/** @internal @This keeps either the newly built PSI sections or the
+ * previous ones, and frees the others. The previous sections are only
+ * reused if all the tables sharing their version number are unchanged,
+ * otherwise a table could get its previous version number back after the
+ * version number wraps.
+ *
+ * @param sections list of new sections, replaced with the previous ones
+ * if reuse is true
+ * @param old_sections list of previous sections
+ * @param reuse true if the previous sections are reused
+ */
+static void upipe_ts_sig_reuse_sections(struct uchain *sections,
+                                        struct uchain *old_sections,
+                                        bool reuse)
+{
+    if (!reuse) {
+        upipe_ts_sig_free_sections(old_sections);
+        return;
+    }
+
+    upipe_ts_sig_free_sections(sections);
+    struct uchain *section_chain;
+    while ((section_chain = ulist_pop(old_sections)) != NULL)
+        ulist_add(sections, section_chain);
+}
+
 /** @internal @This generates a new EIT event.
  *
  * @param upipe description structure of the pipe
@@ -456,9 +547,12 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
     uint64_t i = 0;
     uint64_t total_size = 0;
 
+    struct uchain old_eit_sections, old_eits_sections;
+    ulist_init(&old_eit_sections);
+    ulist_init(&old_eits_sections);
     struct uchain *section_chain;
     while ((section_chain = ulist_pop(&service->eit_sections)) != NULL)
-        ubuf_free(ubuf_from_uchain(section_chain));
+        ulist_add(&old_eit_sections, section_chain);
 
     do {
         if (unlikely(nb_sections >= PSI_TABLE_MAX_SECTIONS)) {
@@ -470,6 +564,7 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
         struct ubuf *ubuf = ubuf_block_alloc(sig->ubuf_mgr,
                 PSI_PRIVATE_MAX_SIZE + PSI_HEADER_SIZE);
         if (unlikely(ubuf == NULL)) {
+            upipe_ts_sig_free_sections(&old_eit_sections);
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
@@ -478,6 +573,7 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
         int size = -1;
         if (!ubase_check(ubuf_block_write(ubuf, 0, &size, &buffer))) {
             ubuf_free(ubuf);
+            upipe_ts_sig_free_sections(&old_eit_sections);
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
@@ -549,7 +645,6 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
 
     service->eit_nb_sections = nb_sections;
     service->eit_size = total_size;
-    service->eit_sent = false;
 
 
     /* EIT schedules */
@@ -557,7 +652,7 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
     nb_sections = 0;
 
     while ((section_chain = ulist_pop(&service->eits_sections)) != NULL)
-        ubuf_free(ubuf_from_uchain(section_chain));
+        ulist_add(&old_eits_sections, section_chain);
     sig->eits_nb_sections -= service->eits_nb_sections;
 
     uint8_t table_id = EIT_TABLE_ID_SCHED_ACTUAL_FIRST;
@@ -579,6 +674,9 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
             struct ubuf *ubuf = ubuf_block_alloc(sig->ubuf_mgr,
                     PSI_PRIVATE_MAX_SIZE + PSI_HEADER_SIZE);
             if (unlikely(ubuf == NULL)) {
+                upipe_ts_sig_free_sections(&old_eit_sections);
+                upipe_ts_sig_free_sections(&old_eits_sections);
+                service->eit_sent = false;
                 upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
                 return;
             }
@@ -587,6 +685,9 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
             int size = -1;
             if (!ubase_check(ubuf_block_write(ubuf, 0, &size, &buffer))) {
                 ubuf_free(ubuf);
+                upipe_ts_sig_free_sections(&old_eit_sections);
+                upipe_ts_sig_free_sections(&old_eits_sections);
+                service->eit_sent = false;
                 upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
                 return;
             }
@@ -665,7 +766,22 @@ static void upipe_ts_sig_service_build_eit(struct upipe *upipe)
         nb_sections;
     sig->eits_nb_sections += service->eits_nb_sections;
     service->eits_size = total_size;
-    service->eits_next_section = 0;
+
+    /* p/f and schedule tables share the version number */
+    bool changed =
+        !upipe_ts_sig_sections_equal(&service->eit_sections,
+                                     &old_eit_sections) ||
+        !upipe_ts_sig_sections_equal(&service->eits_sections,
+                                     &old_eits_sections);
+    upipe_ts_sig_reuse_sections(&service->eit_sections, &old_eit_sections,
+                                !changed);
+    upipe_ts_sig_reuse_sections(&service->eits_sections, &old_eits_sections,
+                                !changed);
+    if (changed) {
+        service->eit_sent = false;
+        service->eits_next_section = 0;
+    } else
+        upipe_dbg(upipe, "EIT unchanged");
 
     upipe_notice_va(upipe, "end EIT (%"PRIu8" sections p/f, %"PRIu16" sections schedule)",
                     service->eit_nb_sections, service->eits_nb_sections);
@@ -1174,9 +1290,11 @@ static void upipe_ts_sig_build_nit(struct upipe *upipe)
     uref_ts_flow_get_nit_ts(sig->flow_def, &ts_number);
     uint64_t total_size = 0;
 
+    struct uchain old_sections;
+    ulist_init(&old_sections);
     struct uchain *section_chain;
     while ((section_chain = ulist_pop(&sig->nit_sections)) != NULL)
-        ubuf_free(ubuf_from_uchain(section_chain));
+        ulist_add(&old_sections, section_chain);
 
     do {
         if (unlikely(nb_sections >= PSI_TABLE_MAX_SECTIONS)) {
@@ -1188,6 +1306,7 @@ static void upipe_ts_sig_build_nit(struct upipe *upipe)
         struct ubuf *ubuf = ubuf_block_alloc(sig->ubuf_mgr,
                                              PSI_MAX_SIZE + PSI_HEADER_SIZE);
         if (unlikely(ubuf == NULL)) {
+            upipe_ts_sig_free_sections(&old_sections);
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
@@ -1196,6 +1315,7 @@ static void upipe_ts_sig_build_nit(struct upipe *upipe)
         int size = -1;
         if (!ubase_check(ubuf_block_write(ubuf, 0, &size, &buffer))) {
             ubuf_free(ubuf);
+            upipe_ts_sig_free_sections(&old_sections);
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
@@ -1252,6 +1372,7 @@ static void upipe_ts_sig_build_nit(struct upipe *upipe)
                     break;
                 upipe_err_va(upipe, "NIT ts too large");
                 ubuf_free(ubuf);
+                upipe_ts_sig_free_sections(&old_sections);
                 upipe_throw_error(upipe, UBASE_ERR_INVALID);
                 return;
             }
@@ -1302,7 +1423,13 @@ static void upipe_ts_sig_build_nit(struct upipe *upipe)
 
     sig->nit_nb_sections = nb_sections;
     sig->nit_size = total_size;
-    sig->nit_sent = false;
+    bool changed = !upipe_ts_sig_sections_equal(&sig->nit_sections,
+                                                &old_sections);
+    upipe_ts_sig_reuse_sections(&sig->nit_sections, &old_sections, !changed);
+    if (changed)
+        sig->nit_sent = false;
+    else
+        upipe_dbg(upipe, "NIT unchanged");
     upipe_ts_sig_update_status(upipe);
 }
 
@@ -1410,9 +1537,11 @@ static void upipe_ts_sig_build_sdt(struct upipe *upipe)
     struct uchain *service_chain = &sig->services;
     uint64_t total_size = 0;
 
+    struct uchain old_sections;
+    ulist_init(&old_sections);
     struct uchain *section_chain;
     while ((section_chain = ulist_pop(&sig->sdt_sections)) != NULL)
-        ubuf_free(ubuf_from_uchain(section_chain));
+        ulist_add(&old_sections, section_chain);
 
     do {
         if (unlikely(nb_sections >= PSI_TABLE_MAX_SECTIONS)) {
@@ -1424,6 +1553,7 @@ static void upipe_ts_sig_build_sdt(struct upipe *upipe)
         struct ubuf *ubuf = ubuf_block_alloc(sig->ubuf_mgr,
                                              PSI_MAX_SIZE + PSI_HEADER_SIZE);
         if (unlikely(ubuf == NULL)) {
+            upipe_ts_sig_free_sections(&old_sections);
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
@@ -1432,6 +1562,7 @@ static void upipe_ts_sig_build_sdt(struct upipe *upipe)
         int size = -1;
         if (!ubase_check(ubuf_block_write(ubuf, 0, &size, &buffer))) {
             ubuf_free(ubuf);
+            upipe_ts_sig_free_sections(&old_sections);
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             return;
         }
@@ -1498,6 +1629,7 @@ static void upipe_ts_sig_build_sdt(struct upipe *upipe)
                 }
                 upipe_err_va(upipe, "SDT service too large");
                 ubuf_free(ubuf);
+                upipe_ts_sig_free_sections(&old_sections);
                 upipe_throw_error(upipe, UBASE_ERR_INVALID);
                 return;
             }
@@ -1563,7 +1695,13 @@ static void upipe_ts_sig_build_sdt(struct upipe *upipe)
 
     sig->sdt_nb_sections = nb_sections;
     sig->sdt_size = total_size;
-    sig->sdt_sent = false;
+    bool changed = !upipe_ts_sig_sections_equal(&sig->sdt_sections,
+                                                &old_sections);
+    upipe_ts_sig_reuse_sections(&sig->sdt_sections, &old_sections, !changed);
+    if (changed)
+        sig->sdt_sent = false;
+    else
+        upipe_dbg(upipe, "SDT unchanged");
     upipe_ts_sig_update_status(upipe);
 }
 
@@ -23,15 +23,17 @@
 #include "upipe/upipe_helper_subpipe.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe-ts/upipe_ts_split.h"
+#include "upipe-ts/uref_ts_vector.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <string.h>
 #include <assert.h>
 
 #include <bitstream/mpeg/ts.h>
 
-/** we only accept blocks containing exactly one TS packet */
+/** we only accept blocks containing exactly one TS packet, or vectors */
 #define EXPECTED_FLOW_DEF "block.mpegts."
 /** maximum number of PIDs */
 #define MAX_PIDS 8192
@@ -54,6 +56,9 @@ struct upipe_ts_split {
     /** list of output subpipes */
     struct uchain subs;
 
+    /** bitmap of PIDs having at least one output, checked before looking
+     * up the PIDs array */
+    uint64_t wanted[UPIPE_TS_SPLIT_PIDS_WORDS];
     /** PIDs array */
     struct upipe_ts_split_pid pids[MAX_PIDS];
 
@@ -91,6 +96,9 @@ struct upipe_ts_split_sub {
     /** list of output requests */
     struct uchain request_list;
 
+    /** true if the output accepts TS packet vectors */
+    bool vector;
+
     /** public upipe structure */
     struct upipe upipe;
 };
@@ -136,6 +144,7 @@ static struct upipe *upipe_ts_split_sub_alloc(struct upipe_mgr *mgr,
     uchain_init(&upipe_ts_split_sub->uchain_pid);
     upipe_ts_split_sub_init_output(upipe);
     upipe_ts_split_sub_init_sub(upipe);
+    upipe_ts_split_sub->vector = ubase_check(uref_ts_flow_get_vector(flow_def));
     upipe_ts_split_sub_store_flow_def(upipe, flow_def);
 
     struct upipe_ts_split *upipe_ts_split =
@@ -238,6 +247,7 @@ static struct upipe *upipe_ts_split_alloc(struct upipe_mgr *mgr,
                    upipe_ts_split_free);
     upipe_ts_split_init_sub_subs(upipe);
     upipe_ts_split_init_sub_mgr(upipe);
+    memset(upipe_ts_split->wanted, 0, sizeof(upipe_ts_split->wanted));
 
     int i;
     for (i = 0; i < MAX_PIDS; i++) {
@@ -259,6 +269,7 @@ static void upipe_ts_split_pid_check(struct upipe *upipe, uint16_t pid)
     assert(pid < MAX_PIDS);
     struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
     if (!ulist_empty(&upipe_ts_split->pids[pid].subs)) {
+        upipe_ts_split->wanted[pid >> 6] |= UINT64_C(1) << (pid & 63);
         if (!upipe_ts_split->pids[pid].set) {
             upipe_ts_split->pids[pid].set = true;
             upipe_dbg_va(upipe, "throw ts split add pid %"PRIu16, pid);
@@ -266,6 +277,7 @@ static void upipe_ts_split_pid_check(struct upipe *upipe, uint16_t pid)
                         UPIPE_TS_SPLIT_SIGNATURE, (unsigned int)pid);
         }
     } else {
+        upipe_ts_split->wanted[pid >> 6] &= ~(UINT64_C(1) << (pid & 63));
         if (upipe_ts_split->pids[pid].set) {
             upipe_ts_split->pids[pid].set = false;
             upipe_dbg_va(upipe, "throw ts split del pid %"PRIu16, pid);
@@ -311,41 +323,73 @@ static void upipe_ts_split_pid_unset(struct upipe *upipe, uint16_t pid,
     upipe_ts_split_pid_check(upipe, pid);
 }
 
-/** @internal @This demuxes a TS packet to the appropriate output(s).
+/** @internal @This outputs a TS packet vector to an output subpipe, or
+ * the individual packets if the output doesn't accept vectors.
  *
- * @param upipe description structure of the pipe
+ * @param upipe description structure of the subpipe
  * @param uref uref structure
+ * @param packet_size size of a TS packet, or 0 if uref is not a vector
+ * @param nb number of packets
  * @param upump_p reference to pump that generated the buffer
  */
-static void upipe_ts_split_input(struct upipe *upipe, struct uref *uref,
-                                 struct upump **upump_p)
+static void upipe_ts_split_sub_output_vector(struct upipe *upipe,
+                                             struct uref *uref,
+                                             size_t packet_size,
+                                             unsigned int nb,
+                                             struct upump **upump_p)
 {
-    struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
-    uint8_t buffer[TS_HEADER_SIZE];
-    const uint8_t *ts_header = uref_block_peek(uref, 0, TS_HEADER_SIZE,
-                                               buffer);
-    if (unlikely(ts_header == NULL)) {
-        uref_free(uref);
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+    struct upipe_ts_split_sub *upipe_ts_split_sub =
+        upipe_ts_split_sub_from_upipe(upipe);
+    if (!packet_size || upipe_ts_split_sub->vector) {
+        upipe_ts_split_sub_output(upipe, uref, upump_p);
         return;
     }
-    uint16_t pid = ts_get_pid(ts_header);
-    UBASE_FATAL(upipe, uref_block_peek_unmap(uref, 0, buffer, ts_header))
 
+    uref_ts_vector_delete(uref);
+    for (unsigned int i = 0; i < nb - 1; i++) {
+        struct uref *packet = uref_dup(uref);
+        if (unlikely(packet == NULL)) {
+            uref_free(uref);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        }
+        uref_block_resize(packet, i * packet_size, packet_size);
+        upipe_ts_split_sub_output(upipe, packet, upump_p);
+    }
+    uref_block_resize(uref, (nb - 1) * packet_size, packet_size);
+    upipe_ts_split_sub_output(upipe, uref, upump_p);
+}
+
+/** @internal @This outputs TS packets of a given PID to the appropriate
+ * output(s).
+ *
+ * @param upipe description structure of the pipe
+ * @param pid PID of the packets
+ * @param uref uref structure
+ * @param packet_size size of a TS packet, or 0 if uref is not a vector
+ * @param nb number of packets
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_split_output(struct upipe *upipe, uint16_t pid,
+                                  struct uref *uref, size_t packet_size,
+                                  unsigned int nb, struct upump **upump_p)
+{
+    struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
     struct uchain *uchain, *uchain_tmp;
     ulist_delete_foreach(&upipe_ts_split->pids[pid].subs, uchain, uchain_tmp) {
         struct upipe_ts_split_sub *output =
                 upipe_ts_split_sub_from_uchain_pid(uchain);
         if (likely(uchain->next == NULL)) {
-            upipe_ts_split_sub_output(upipe_ts_split_sub_to_upipe(output),
-                                      uref, upump_p);
+            upipe_ts_split_sub_output_vector(
+                    upipe_ts_split_sub_to_upipe(output),
+                    uref, packet_size, nb, upump_p);
             uref = NULL;
         } else {
             struct uref *new_uref = uref_dup(uref);
             if (likely(new_uref != NULL))
-                upipe_ts_split_sub_output(
+                upipe_ts_split_sub_output_vector(
                         upipe_ts_split_sub_to_upipe(output),
-                        new_uref, upump_p);
+                        new_uref, packet_size, nb, upump_p);
             else {
                 uref_free(uref);
                 upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
@@ -357,6 +401,113 @@ static void upipe_ts_split_input(struct upipe *upipe, struct uref *uref,
         uref_free(uref);
 }
 
+/** @internal @This demuxes a TS packet vector to the appropriate outputs.
+ * Consecutive packets of the same PID are output together, sharing the
+ * buffer of the input vector, so that the order of the packets is kept
+ * across PIDs.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param packet_size size of a TS packet
+ * @param nb number of packets
+ * @param vector_pids array of PIDs of the packets
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_split_input_vector(struct upipe *upipe, struct uref *uref,
+                                        size_t packet_size, unsigned int nb,
+                                        const uint8_t *vector_pids,
+                                        struct upump **upump_p)
+{
+    struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
+    uint8_t pids[2 * UREF_TS_VECTOR_MAX];
+    if (unlikely(nb > UREF_TS_VECTOR_MAX)) {
+        uref_free(uref);
+        upipe_throw_fatal(upipe, UBASE_ERR_INVALID);
+        return;
+    }
+
+    /* drop vectors without any wanted packet before touching the uref */
+    unsigned int i;
+    for (i = 0; i < nb; i++)
+        if (upipe_ts_split_check_pid(upipe_ts_split->wanted,
+                                     uref_ts_vector_pid(vector_pids, i)))
+            break;
+    if (i == nb) {
+        uref_free(uref);
+        return;
+    }
+    memcpy(pids, vector_pids, 2 * nb);
+
+    i = 0;
+    while (i < nb) {
+        uint16_t pid = uref_ts_vector_pid(pids, i) & (MAX_PIDS - 1);
+        unsigned int j = i + 1;
+        while (j < nb && (uref_ts_vector_pid(pids, j) & (MAX_PIDS - 1)) == pid)
+            j++;
+
+        if (upipe_ts_split_check_pid(upipe_ts_split->wanted, pid)) {
+            struct uref *run;
+            if (!i && j == nb) {
+                run = uref;
+                uref = NULL;
+            } else {
+                run = uref_dup(uref);
+                if (unlikely(run == NULL ||
+                        !ubase_check(uref_block_resize(run, i * packet_size,
+                                (j - i) * packet_size)) ||
+                        !ubase_check(uref_ts_vector_set(run, packet_size,
+                                j - i, pids + 2 * i)))) {
+                    uref_free(run);
+                    uref_free(uref);
+                    upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+                    return;
+                }
+            }
+            upipe_ts_split_output(upipe, pid, run, packet_size, j - i,
+                                  upump_p);
+        }
+        i = j;
+    }
+    uref_free(uref);
+}
+
+/** @internal @This demuxes a TS packet to the appropriate output(s).
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_ts_split_input(struct upipe *upipe, struct uref *uref,
+                                 struct upump **upump_p)
+{
+    struct upipe_ts_split *upipe_ts_split = upipe_ts_split_from_upipe(upipe);
+    size_t packet_size;
+    unsigned int nb;
+    const uint8_t *pids;
+    if (unlikely(ubase_check(uref_ts_vector_get(uref, &packet_size, &nb,
+                                                &pids)))) {
+        upipe_ts_split_input_vector(upipe, uref, packet_size, nb, pids,
+                                    upump_p);
+        return;
+    }
+
+    uint8_t buffer[TS_HEADER_SIZE];
+    const uint8_t *ts_header = uref_block_peek(uref, 0, TS_HEADER_SIZE,
+                                               buffer);
+    if (unlikely(ts_header == NULL)) {
+        uref_free(uref);
+        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+        return;
+    }
+    uint16_t pid = ts_get_pid(ts_header);
+    UBASE_FATAL(upipe, uref_block_peek_unmap(uref, 0, buffer, ts_header))
+    if (!upipe_ts_split_check_pid(upipe_ts_split->wanted, pid)) {
+        uref_free(uref);
+        return;
+    }
+    upipe_ts_split_output(upipe, pid, uref, 0, 1, upump_p);
+}
+
 /** @internal @This sets the input flow definition.
  *
  * @param upipe description structure of the pipe
@@ -396,6 +547,14 @@ static int upipe_ts_split_control(struct upipe *upipe,
             struct uref *flow_def = va_arg(args, struct uref *);
             return upipe_ts_split_set_flow_def(upipe, flow_def);
         }
+        case UPIPE_TS_SPLIT_GET_PIDS: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_SPLIT_SIGNATURE)
+            const uint64_t **pids_p = va_arg(args, const uint64_t **);
+            struct upipe_ts_split *upipe_ts_split =
+                upipe_ts_split_from_upipe(upipe);
+            *pids_p = upipe_ts_split->wanted;
+            return UBASE_ERR_NONE;
+        }
 
         default:
             return UBASE_ERR_UNHANDLED;
@@ -32,6 +32,9 @@
 #include "upipe/upipe_helper_output.h"
 #include "upipe/upipe_helper_output_size.h"
 #include "upipe-ts/upipe_ts_sync.h"
+#include "upipe-ts/uref_ts_vector.h"
+
+#include "ts_scan.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -77,6 +80,10 @@ struct upipe_ts_sync {
     struct uchain urefs;
     /** true if we have thrown the sync_acquired event */
     bool acquired;
+    /** true if packets are output in vectors */
+    bool vector;
+    /** function scanning packets in a contiguous buffer */
+    upipe_ts_scan_func scan;
 
     /** public upipe structure */
     struct upipe upipe;
@@ -114,6 +121,8 @@ static struct upipe *upipe_ts_sync_alloc(struct upipe_mgr *mgr,
     upipe_ts_sync_init_output(upipe);
     upipe_ts_sync_init_output_size(upipe, TS_SIZE);
     upipe_ts_sync->ts_sync = DEFAULT_TS_SYNC;
+    upipe_ts_sync->vector = false;
+    upipe_ts_sync->scan = upipe_ts_scan_init();
     upipe_ts_sync->next_uref = NULL;
     ulist_init(&upipe_ts_sync->urefs);
     upipe_throw_ready(upipe);
@@ -162,6 +171,68 @@ static bool upipe_ts_sync_check(struct upipe *upipe, size_t *offset_p)
     return true;
 }
 
+/** @internal @This counts the packets at the beginning of the working
+ * buffer that may be output, that is the packets followed by the required
+ * number of sync words, and reads their PIDs. The first packet must have been
+ * checked by @ref upipe_ts_sync_check. A vector does not extend past the
+ * first input buffer, so that all its packets share the same arrival date.
+ *
+ * @param upipe description structure of the pipe
+ * @param pids filled in with the PIDs of the packets
+ * @return the number of packets
+ */
+static unsigned int upipe_ts_sync_vector(struct upipe *upipe, uint8_t *pids)
+{
+    struct upipe_ts_sync *upipe_ts_sync = upipe_ts_sync_from_upipe(upipe);
+    size_t packet_size = upipe_ts_sync->output_size;
+    size_t lookahead = (upipe_ts_sync->ts_sync - 1) * packet_size;
+    unsigned int max = upipe_ts_sync->next_uref_size / packet_size;
+    if (!max)
+        /* packet straddling two input buffers */
+        max = 1;
+    else if (max > UREF_TS_VECTOR_MAX)
+        max = UREF_TS_VECTOR_MAX;
+    unsigned int nb = 0;
+    size_t offset = 0;
+
+    /* fast path: scan the packets lying in the first segment */
+    const uint8_t *buffer;
+    int size = -1;
+    if (ubase_check(uref_block_read(upipe_ts_sync->next_uref, 0, &size,
+                                    &buffer))) {
+        uintptr_t packets = size / packet_size;
+        if (packets > max)
+            packets = max;
+        uintptr_t valid = upipe_ts_scan(upipe_ts_sync->scan, buffer, pids,
+                                        packet_size, packets);
+        uref_block_unmap(upipe_ts_sync->next_uref, 0);
+        if (valid >= upipe_ts_sync->ts_sync) {
+            nb = valid - (upipe_ts_sync->ts_sync - 1);
+            offset = nb * packet_size;
+        }
+    }
+
+    /* slow path: packets followed by sync words in the next segments */
+    while (nb < max) {
+        uint8_t word;
+        if (nb && (!ubase_check(uref_block_extract(upipe_ts_sync->next_uref,
+                                        offset + lookahead, 1, &word)) ||
+                   word != TS_SYNC))
+            break;
+
+        uint8_t header[TS_HEADER_SIZE];
+        const uint8_t *ts_header = uref_block_peek(upipe_ts_sync->next_uref,
+                offset, TS_HEADER_SIZE, header);
+        if (unlikely(ts_header == NULL))
+            break;
+        uref_ts_vector_set_pid(pids, nb++, ts_get_pid(ts_header));
+        uref_block_peek_unmap(upipe_ts_sync->next_uref, offset, header,
+                              ts_header);
+        offset += packet_size;
+    }
+    return nb;
+}
+
 /** @internal @This flushes all input buffers.
  *
  * @param upipe description structure of the pipe
@@ -220,12 +291,28 @@ static void upipe_ts_sync_input(struct upipe *upipe, struct uref *uref,
 
         /* upipe_ts_sync_check said there is at least one TS packet there. */
         upipe_ts_sync_sync_acquired(upipe);
+        uint8_t pids[2 * UREF_TS_VECTOR_MAX];
+        unsigned int nb = 1;
+        if (upipe_ts_sync->vector)
+            nb = upipe_ts_sync_vector(upipe, pids);
+        if (unlikely(!nb)) {
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            break;
+        }
+
         struct uref *output = upipe_ts_sync_extract_uref_stream(upipe,
-                                                    upipe_ts_sync->output_size);
+                                        nb * upipe_ts_sync->output_size);
         if (unlikely(output == NULL)) {
             upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
             continue;
         }
+        if (upipe_ts_sync->vector &&
+            unlikely(!ubase_check(uref_ts_vector_set(output,
+                            upipe_ts_sync->output_size, nb, pids)))) {
+            uref_free(output);
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            continue;
+        }
         upipe_ts_sync_output(upipe, output, upump_p);
     }
 }
@@ -316,6 +403,21 @@ static int upipe_ts_sync_control(struct upipe *upipe,
             int sync = va_arg(args, int);
             return _upipe_ts_sync_set_sync(upipe, sync);
         }
+        case UPIPE_TS_SYNC_GET_VECTOR: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_SYNC_SIGNATURE)
+            struct upipe_ts_sync *upipe_ts_sync =
+                upipe_ts_sync_from_upipe(upipe);
+            int *vector_p = va_arg(args, int *);
+            *vector_p = upipe_ts_sync->vector;
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_TS_SYNC_SET_VECTOR: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_SYNC_SIGNATURE)
+            struct upipe_ts_sync *upipe_ts_sync =
+                upipe_ts_sync_from_upipe(upipe);
+            upipe_ts_sync->vector = !!va_arg(args, int);
+            return UBASE_ERR_NONE;
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
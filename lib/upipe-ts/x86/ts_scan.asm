@@ -0,0 +1,89 @@
+;******************************************************************************
+;* TS packet scanning
+;* Copyright (C) 2026 EasyTools
+;*
+;* SPDX-License-Identifier: LGPL-2.1-or-later
+;******************************************************************************
+
+%include "x86util.asm"
+
+SECTION_RODATA 32
+
+ts_sync_mask:  times 8 dd 0xff
+ts_sync_word:  times 8 dd 0x47
+ts_pid_mask:   times 8 dd 0xff1f00
+ts_gather_idx: dd 0, 1, 2, 3, 4, 5, 6, 7
+
+SECTION .text
+
+%macro ts_scan 0
+
+; ts_scan(const uint8_t *src, uint8_t *pids, uintptr_t stride, uintptr_t packets)
+cglobal ts_scan, 4, 7, 5, src, pids, stride, packets, stride3, count, mask
+    xor countd, countd
+    test packetsq, packetsq
+    jz .end
+
+%if cpuflag(avx2)
+    movd     xm4, strided
+    vpbroadcastd m4, xm4
+    pmulld   m4, [ts_gather_idx]
+%else
+    lea      stride3q, [3*strideq]
+%endif
+
+.loop:
+    ; load the first 4 octets of mmsize/4 packets
+%if cpuflag(avx2)
+    pcmpeqd  m1, m1
+    vpgatherdd m0, [srcq + m4], m1
+    lea      srcq, [srcq + 8*strideq]
+%else
+    movd     m0, [srcq]
+    movd     m1, [srcq + strideq]
+    movd     m2, [srcq + 2*strideq]
+    movd     m3, [srcq + stride3q]
+    punpckldq m0, m1
+    punpckldq m2, m3
+    punpcklqdq m0, m2
+    lea      srcq, [srcq + 4*strideq]
+%endif
+
+    ; PID in network order: (dword >> 8) & 0xff1f, sign extended for packing
+    pand     m2, m0, [ts_pid_mask]
+    pslld    m2, 8
+    psrad    m2, 16
+    packssdw m2, m2
+%if cpuflag(avx2)
+    vpermq   m2, m2, q3120
+    movu     [pidsq], xm2
+%else
+    movq     [pidsq], m2
+%endif
+
+    pand     m0, [ts_sync_mask]
+    pcmpeqd  m0, [ts_sync_word]
+    movmskps maskd, m0
+    cmp      maskd, (1 << (mmsize/4)) - 1
+    jne .lost
+
+    add      pidsq, mmsize/2
+    add      countd, mmsize/4
+    sub      packetsq, mmsize/4
+    jg .loop
+
+.end:
+    mov      eax, countd
+    RET
+
+.lost:
+    not      maskd
+    bsf      maskd, maskd
+    add      countd, maskd
+    jmp .end
+%endmacro
+
+INIT_XMM sse2
+ts_scan
+INIT_YMM avx2
+ts_scan
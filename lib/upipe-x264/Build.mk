@@ -4,7 +4,7 @@ libupipe_x264-desc = x264 interface module
 libupipe_x264-so-version = 1.0.0
 libupipe_x264-includes = upipe_x264.h
 libupipe_x264-src = upipe_x264.c
-libupipe_x264-libs = libupipe libupipe_framers x264 bitstream
+libupipe_x264-libs = libupipe libupipe_framers x264 bitstream pthread
 
 configs += x264-obe
 x264-obe-functions = x264_speedcontrol_sync
@@ -25,12 +25,16 @@
 #include "upipe/uref_block.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/ubuf_block.h"
+#include "upipe/uqueue.h"
+#include "upipe/upump.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_upipe.h"
 #include "upipe/upipe_helper_urefcount.h"
 #include "upipe/upipe_helper_void.h"
 #include "upipe/upipe_helper_ubuf_mgr.h"
 #include "upipe/upipe_helper_uclock.h"
+#include "upipe/upipe_helper_upump_mgr.h"
+#include "upipe/upipe_helper_upump.h"
 #include "upipe/upipe_helper_output.h"
 #include "upipe/upipe_helper_input.h"
 #include "upipe/upipe_helper_flow_format.h"
@@ -44,7 +48,9 @@
 #include "upipe-framers/upipe_h26x_common.h"
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include <x264.h>
 #include <bitstream/mpeg/h264.h>
@@ -139,10 +145,81 @@ struct upipe_x264 {
     /** last input PTS (system time) */
     uint64_t input_pts_sys;
 
+    /** upump manager */
+    struct upump_mgr *upump_mgr;
+    /** watcher of the queue of encoded frames */
+    struct upump *upump;
+    /** maximum number of frames handed to the encoder thread, or 0 to encode
+     * synchronously */
+    unsigned int async_length;
+    /** number of frames handed to the encoder thread and not output yet */
+    unsigned int async_pending;
+    /** true if the encoder thread is running */
+    bool async_running;
+    /** true if the encoder thread must exit when it has no more frames */
+    bool async_quit;
+    /** encoder thread */
+    pthread_t async_thread;
+    /** mutex protecting the list of frames to encode */
+    pthread_mutex_t async_mutex;
+    /** condition signalled when the list of frames to encode changes, or
+     * when a frame is encoded */
+    pthread_cond_t async_cond;
+    /** list of frames to encode */
+    struct uchain async_frames;
+    /** queue of encoded frames */
+    struct uqueue async_done;
+    /** extra data for the queue of encoded frames */
+    void *async_done_extra;
+
     /** public structure */
     struct upipe upipe;
 };
 
+/** @internal @This describes a picture going through the encoder. */
+struct upipe_x264_frame {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** picture to encode or NULL to flush a delayed frame, then encoded frame
+     * or NULL if the encoder returned no frame */
+    struct uref *uref;
+    /** ubuf manager to allocate the encoded frame */
+    struct ubuf_mgr *ubuf_mgr;
+    /** chroma subsampling */
+    int csp;
+    /** x264 "PTS" */
+    int64_t i_pts;
+    /** forced x264 frame type */
+    int i_type;
+    /** top field first, or -1 */
+    int b_tff;
+    /** true if the NAL offsets must be set */
+    bool nal_offsets;
+    /** uclock to synchronize speedcontrol, or NULL */
+    struct uclock *uclock;
+    /** supposed latency of the packets when leaving the encoder */
+    uint64_t initial_latency;
+    /** latency introduced by speedcontrol */
+    uint64_t sc_latency;
+    /** input PTS (program time) at the time of the picture */
+    uint64_t input_pts;
+    /** input PTS (system time) at the time of the picture */
+    uint64_t input_pts_sys;
+    /** drift rate at the time of the picture */
+    struct urational drift_rate;
+
+    /** error code */
+    int err;
+    /** chroma plane which could not be read */
+    const char *chroma;
+    /** delay between DTS and PTS of the encoded frame */
+    uint64_t dts_pts_delay;
+    /** true if the encoded frame is a keyframe */
+    bool keyframe;
+};
+
+UBASE_FROM_TO(upipe_x264_frame, uchain, uchain, uchain)
+
 /** @hidden */
 static int upipe_x264_check_ubuf_mgr(struct upipe *upipe,
                                      struct uref *flow_format);
@@ -152,6 +229,8 @@ static int upipe_x264_check_flow_format(struct upipe *upipe,
 /** @hidden */
 static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
                               struct upump **upump_p);
+/** @hidden */
+static void upipe_x264_async_drain(struct upipe *upipe);
 
 UPIPE_HELPER_UPIPE(upipe_x264, upipe, UPIPE_X264_SIGNATURE);
 UPIPE_HELPER_UREFCOUNT(upipe_x264, urefcount, upipe_x264_free)
@@ -169,6 +248,8 @@ UPIPE_HELPER_UBUF_MGR(upipe_x264, ubuf_mgr, flow_format, ubuf_mgr_request,
                       upipe_x264_register_output_request,
                       upipe_x264_unregister_output_request)
 UPIPE_HELPER_UCLOCK(upipe_x264, uclock, uclock_request, NULL, upipe_throw_provide_request, NULL)
+UPIPE_HELPER_UPUMP_MGR(upipe_x264, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_x264, upump, upump_mgr)
 
 /** @internal loglevel map from x264 to uprobe_log */
 static const enum uprobe_log_level loglevel_map[] = {
@@ -206,6 +287,217 @@ static inline bool upipe_x264_mpeg2_enabled(struct upipe *upipe)
 #endif
 }
 
+/** @internal @This encodes a picture and packs the returned NAL units into
+ * a block. It only uses the fields of the frame and the encoder, so that it
+ * may run in the encoder thread.
+ *
+ * @param upipe_x264 private structure of the pipe
+ * @param frame description of the picture, replaced with the encoded frame
+ */
+static void upipe_x264_encode_frame(struct upipe_x264 *upipe_x264,
+                                    struct upipe_x264_frame *frame)
+{
+    static const char *chromas_planar[] = {"y8", "u8", "v8"};
+    static const char *chromas_semiplanar[] = {"y8", "u8v8"};
+    struct uref *uref = frame->uref;
+    x264_picture_t pic;
+    x264_nal_t *nals;
+    int i, nals_num, size = 0, header_size = 0;
+    struct ubuf *ubuf_block;
+    uint8_t *buf = NULL;
+    x264_param_t curparams;
+    int ret = 0;
+
+    frame->uref = NULL;
+
+    /* init x264 picture */
+    x264_picture_init(&pic);
+
+    if (likely(uref)) {
+        pic.opaque = uref;
+        pic.img.i_csp = frame->csp;
+        pic.i_pts = frame->i_pts;
+        pic.i_type = frame->i_type;
+#ifdef HAVE_X264_MPEG2
+        if (frame->b_tff >= 0)
+            pic.b_tff = frame->b_tff;
+#endif
+
+        /* map */
+        const char **chromas;
+        int chromas_count;
+
+        if (frame->csp == X264_CSP_NV12 || frame->csp == X264_CSP_NV16) {
+            chromas = chromas_semiplanar;
+            chromas_count = 2;
+        } else {
+            chromas = chromas_planar;
+            chromas_count = 3;
+        }
+
+        for (i = 0; i < chromas_count; i++) {
+            size_t stride;
+            const uint8_t *plane;
+            if (unlikely(!ubase_check(uref_pic_plane_size(uref, chromas[i], &stride,
+                                              NULL, NULL, NULL)) ||
+                         !ubase_check(uref_pic_plane_read(uref, chromas[i], 0, 0, -1, -1,
+                                              &plane)))) {
+                frame->err = UBASE_ERR_INVALID;
+                frame->chroma = chromas[i];
+                while (--i >= 0)
+                    uref_pic_plane_unmap(uref, chromas[i], 0, 0, -1, -1);
+                uref_free(uref);
+                return;
+            }
+            pic.img.i_stride[i] = stride;
+            /* cast needed because of x264 API */
+            pic.img.plane[i] = (uint8_t *)plane;
+        }
+        pic.img.i_plane = i;
+
+        /* encode frame ! */
+        ret = x264_encoder_encode(upipe_x264->encoder,
+                                  &nals, &nals_num, &pic, &pic);
+
+        /* unmap */
+        for (i = 0; i < chromas_count; i++) {
+            uref_pic_plane_unmap(uref, chromas[i], 0, 0, -1, -1);
+        }
+        ubuf_free(uref_detach_ubuf(uref));
+
+    } else {
+        /* NULL uref, flushing delayed frame */
+        ret = x264_encoder_encode(upipe_x264->encoder,
+                                  &nals, &nals_num, NULL, &pic);
+    }
+    x264_encoder_parameters(upipe_x264->encoder, &curparams);
+
+    if (unlikely(ret < 0)) {
+        frame->err = UBASE_ERR_EXTERNAL;
+        uref_free(uref);
+        return;
+    } else if (unlikely(ret == 0)) {
+        return;
+    }
+
+    /* get uref back */
+    uref = pic.opaque;
+    assert(uref);
+
+    for (i = 0; i < nals_num; i++) {
+        size += nals[i].i_payload;
+        if (nals[i].i_type == NAL_SPS || nals[i].i_type == NAL_PPS ||
+            nals[i].i_type == NAL_AUD || nals[i].i_type == NAL_FILLER ||
+            nals[i].i_type == NAL_UNKNOWN)
+            header_size += nals[i].i_payload;
+    }
+
+    /* alloc ubuf, map, copy, unmap */
+    ubuf_block = ubuf_block_alloc(frame->ubuf_mgr, size);
+    if (unlikely(ubuf_block == NULL)) {
+        frame->err = UBASE_ERR_ALLOC;
+        uref_free(uref);
+        return;
+    }
+    ubuf_block_write(ubuf_block, 0, &size, &buf);
+    memcpy(buf, nals[0].p_payload, size);
+    ubuf_block_unmap(ubuf_block, 0);
+    uref_attach_ubuf(uref, ubuf_block);
+    uref_block_set_header_size(uref, header_size);
+
+    if (frame->nal_offsets) {
+        /* NAL offsets */
+        uint64_t offset = 0;
+        for (i = 0; i < nals_num - 1; i++) {
+            offset += nals[i].i_payload;
+            uref_h26x_set_nal_offset(uref, offset, i);
+        }
+    }
+
+    frame->dts_pts_delay = (uint64_t)(pic.i_pts - pic.i_dts) * UCLOCK_FREQ
+                           * curparams.i_timebase_num
+                           / curparams.i_timebase_den;
+    frame->keyframe = pic.b_keyframe;
+    frame->uref = uref;
+
+#ifdef HAVE_X264_OBE
+    /* speedcontrol, from the DTS of the frame just encoded */
+    uint64_t pts;
+    if (frame->uclock != NULL && frame->sc_latency &&
+        frame->input_pts != UINT64_MAX && frame->input_pts_sys != UINT64_MAX &&
+        ubase_check(uref_clock_get_pts_prog(uref, &pts))) {
+        int64_t dts_sys = (int64_t)frame->input_pts_sys +
+            ((int64_t)(pts - frame->dts_pts_delay) -
+             (int64_t)frame->input_pts) *
+            (int64_t)frame->drift_rate.num /
+            (int64_t)frame->drift_rate.den;
+        int64_t buffer_state = dts_sys + frame->initial_latency +
+                               frame->sc_latency - uclock_now(frame->uclock);
+        float buffer_fill = (float)buffer_state / (float)frame->sc_latency;
+        x264_speedcontrol_sync(upipe_x264->encoder, buffer_fill, 0, 1);
+    }
+#endif
+}
+
+/** @internal @This is the main loop of the encoder thread. It encodes the
+ * queued frames in order and hands them back to the queue of encoded
+ * frames.
+ *
+ * @param _upipe_x264 private structure of the pipe
+ * @return NULL
+ */
+static void *upipe_x264_async_run(void *_upipe_x264)
+{
+    struct upipe_x264 *upipe_x264 = _upipe_x264;
+
+    pthread_mutex_lock(&upipe_x264->async_mutex);
+    for ( ; ; ) {
+        struct uchain *uchain = ulist_pop(&upipe_x264->async_frames);
+        if (uchain == NULL) {
+            if (upipe_x264->async_quit)
+                break;
+            pthread_cond_wait(&upipe_x264->async_cond,
+                              &upipe_x264->async_mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&upipe_x264->async_mutex);
+
+        struct upipe_x264_frame *frame = upipe_x264_frame_from_uchain(uchain);
+        upipe_x264_encode_frame(upipe_x264, frame);
+        /* the queue is at least as long as the number of pending frames */
+        bool ret = uqueue_push(&upipe_x264->async_done, frame);
+        assert(ret);
+        (void)ret;
+
+        pthread_mutex_lock(&upipe_x264->async_mutex);
+        /* wake up the pipe if it waits for an encoded frame */
+        pthread_cond_broadcast(&upipe_x264->async_cond);
+    }
+    pthread_mutex_unlock(&upipe_x264->async_mutex);
+    return NULL;
+}
+
+/** @internal @This waits for the encoder thread to encode the queued frames
+ * and terminates it, so that the encoder may be used from the pipe. The
+ * thread is started again with the next picture.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_x264_async_join(struct upipe *upipe)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    if (!upipe_x264->async_running)
+        return;
+
+    pthread_mutex_lock(&upipe_x264->async_mutex);
+    upipe_x264->async_quit = true;
+    pthread_cond_broadcast(&upipe_x264->async_cond);
+    pthread_mutex_unlock(&upipe_x264->async_mutex);
+    pthread_join(upipe_x264->async_thread, NULL);
+    upipe_x264->async_quit = false;
+    upipe_x264->async_running = false;
+}
+
 /** @internal @This reconfigures encoder with updated parameters
  * @param upipe description structure of the pipe
  * @return an error code
@@ -217,6 +509,7 @@ static int _upipe_x264_reconfigure(struct upipe *upipe)
     if (unlikely(!upipe_x264->encoder)) {
         return UBASE_ERR_UNHANDLED;
     }
+    upipe_x264_async_join(upipe);
     ret = x264_encoder_reconfig(upipe_x264->encoder, &upipe_x264->params);
     return ( (ret < 0) ? UBASE_ERR_EXTERNAL : UBASE_ERR_NONE );
 }
@@ -333,6 +626,37 @@ static int _upipe_x264_set_slice_type_enforce(struct upipe *upipe, bool enforce)
     return UBASE_ERR_NONE;
 }
 
+/** @This switches the encoder to a dedicated thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param queue_length maximum number of frames handed to the encoder thread
+ * @return an error code
+ */
+static int _upipe_x264_set_async(struct upipe *upipe,
+                                 unsigned int queue_length)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    if (upipe_x264->encoder != NULL || upipe_x264->async_length)
+        return UBASE_ERR_BUSY;
+    if (!queue_length)
+        return UBASE_ERR_NONE;
+    if (queue_length > UQUEUE_MAX_LENGTH)
+        return UBASE_ERR_INVALID;
+
+    upipe_x264->async_done_extra = malloc(uqueue_sizeof(queue_length));
+    UBASE_ALLOC_RETURN(upipe_x264->async_done_extra);
+    if (unlikely(!uqueue_init(&upipe_x264->async_done, queue_length,
+                              upipe_x264->async_done_extra))) {
+        free(upipe_x264->async_done_extra);
+        upipe_x264->async_done_extra = NULL;
+        return UBASE_ERR_EXTERNAL;
+    }
+    upipe_x264->async_length = queue_length;
+    upipe_dbg_va(upipe, "encoding in a dedicated thread (queue length %u)",
+                 queue_length);
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This allocates a filter pipe.
  *
  * @param mgr common management structure
@@ -380,6 +704,17 @@ static struct upipe *upipe_x264_alloc(struct upipe_mgr *mgr,
     upipe_x264->input_pts = UINT64_MAX;
     upipe_x264->input_pts_sys = UINT64_MAX;
 
+    upipe_x264_init_upump_mgr(upipe);
+    upipe_x264_init_upump(upipe);
+    upipe_x264->async_length = 0;
+    upipe_x264->async_pending = 0;
+    upipe_x264->async_running = false;
+    upipe_x264->async_quit = false;
+    pthread_mutex_init(&upipe_x264->async_mutex, NULL);
+    pthread_cond_init(&upipe_x264->async_cond, NULL);
+    ulist_init(&upipe_x264->async_frames);
+    upipe_x264->async_done_extra = NULL;
+
     upipe_throw_ready(upipe);
     return upipe;
 }
@@ -626,6 +961,7 @@ static void upipe_x264_close(struct upipe *upipe)
 {
     struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
     if (upipe_x264->encoder) {
+        upipe_x264_async_drain(upipe);
         while(x264_encoder_delayed_frames(upipe_x264->encoder)) {
             upipe_x264_handle(upipe, NULL, NULL);
         }
@@ -644,6 +980,7 @@ static void upipe_x264_build_flow_def(struct upipe *upipe)
 {
     struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
     assert(upipe_x264->flow_def_requested != NULL);
+    upipe_x264_async_join(upipe);
 
     struct uref *flow_def = uref_dup(upipe_x264->flow_def_requested);
     if (unlikely(flow_def == NULL)) {
@@ -692,7 +1029,8 @@ static void upipe_x264_build_flow_def(struct upipe *upipe)
  *
  * @param upipe description structure of the pipe
  * @param uref new image to encode
- * @return an error code
+ * @return an error code, UBASE_ERR_BUSY if the frames in the encoder thread
+ * must be output first
  */
 static int upipe_x264_update(struct upipe *upipe, struct uref *uref)
 {
@@ -723,6 +1061,10 @@ static int upipe_x264_update(struct upipe *upipe, struct uref *uref)
                  params->vui.i_overscan != upipe_x264->overscan ||
                  params->b_tff != tff);
 
+        /* output the frames of the previous configuration first */
+        if (need_update && upipe_x264->async_pending)
+            return UBASE_ERR_BUSY;
+
         if (need_update)
             upipe_notice_va(upipe,
                             "Flow parameters changed, reconfiguring encoder "
@@ -741,120 +1083,55 @@ static int upipe_x264_update(struct upipe *upipe, struct uref *uref)
     return ret;
 }
 
-/** @internal @This processes pictures.
+/** @internal @This fills in the description of a picture to encode.
  *
  * @param upipe description structure of the pipe
- * @param uref uref structure
- * @param upump_p reference to upump structure
- * @return true if the packet was handled
+ * @param frame description of the picture
+ * @param uref picture to encode, or NULL to flush a delayed frame
  */
-static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
-                              struct upump **upump_p)
+static void upipe_x264_prepare_frame(struct upipe *upipe,
+                                     struct upipe_x264_frame *frame,
+                                     struct uref *uref)
 {
     struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
-    const char *def;
-    if (unlikely(uref != NULL && ubase_check(uref_flow_get_def(uref, &def)))) {
-        upipe_x264->input_latency = 0;
-        uref_clock_get_latency(uref, &upipe_x264->input_latency);
-        upipe_x264_store_flow_def(upipe, NULL);
-        uref_free(upipe_x264->flow_def_requested);
-        upipe_x264->flow_def_requested = NULL;
 
-        if (upipe_x264_mpeg2_enabled(upipe)) {
-            struct urational dar;
-            dar.num = 4;
-            dar.den = 3;
-            uref_pic_flow_infer_dar(uref, &dar);
-            if (dar.num == 4 && dar.den == 3)
-                upipe_x264->mpeg2_ar = 2;
-            else if (dar.num == 16 && dar.den == 9)
-                upipe_x264->mpeg2_ar = 3;
-            else if (dar.num == 221 && dar.den == 100)
-                upipe_x264->mpeg2_ar = 4;
-            else {
-                upipe_warn_va(upipe,
-                        "unrecognized aspect ratio %"PRId64"/%"PRIu64", using square",
-                        dar.num, dar.den);
-                upipe_x264->mpeg2_ar = 1;
-            }
-        } else {
-            upipe_x264->sar.num = upipe_x264->sar.den = 1;
-            uref_pic_flow_get_sar(uref, &upipe_x264->sar);
-            bool overscan;
-            if (!ubase_check(uref_pic_flow_get_overscan(uref, &overscan)))
-                upipe_x264->overscan = 0; /* undef */
-            else
-                upipe_x264->overscan = overscan ? 2 : 1;
-        }
-
-        if (ubase_check(uref_pic_flow_check_yuv420p(uref)))
-            upipe_x264->chroma_subsampling = X264_CSP_I420;
-        else if (ubase_check(uref_pic_flow_check_yuv422p(uref)))
-            upipe_x264->chroma_subsampling = X264_CSP_I422;
-        else if (ubase_check(uref_pic_flow_check_yuv444p(uref)))
-            upipe_x264->chroma_subsampling = X264_CSP_I444;
-        else if (ubase_check(uref_pic_flow_check_nv12(uref)))
-            upipe_x264->chroma_subsampling = X264_CSP_NV12;
-        else if (ubase_check(uref_pic_flow_check_nv16(uref)))
-            upipe_x264->chroma_subsampling = X264_CSP_NV16;
-        else
-            upipe_err(upipe, "invalid chroma subsampling");
-
-        uref = upipe_x264_store_flow_def_input(upipe, uref);
-        if (uref != NULL) {
-            uref_pic_flow_clear_format(uref);
-            upipe_x264_require_flow_format(upipe, uref);
-        }
-        return true;
-    }
-
-    x264_picture_t pic;
-    x264_nal_t *nals;
-    int i, nals_num, size = 0, header_size = 0;
-    struct ubuf *ubuf_block;
-    uint8_t *buf = NULL;
-    x264_param_t curparams;
-    int ret = 0;
-
-    /* init x264 picture */
-    x264_picture_init(&pic);
+    uchain_init(&frame->uchain);
+    frame->uref = uref;
+    frame->ubuf_mgr = ubuf_mgr_use(upipe_x264->ubuf_mgr);
+    frame->csp = upipe_x264->chroma_subsampling;
+    frame->i_pts = 0;
+    frame->i_type = X264_TYPE_AUTO;
+    frame->b_tff = -1;
+    frame->nal_offsets = !upipe_x264_mpeg2_enabled(upipe);
+    frame->uclock = upipe_x264->sc_latency ?
+                    uclock_use(upipe_x264->uclock) : NULL;
+    frame->initial_latency = upipe_x264->initial_latency;
+    frame->sc_latency = upipe_x264->sc_latency;
+    frame->err = UBASE_ERR_NONE;
+    frame->chroma = NULL;
+    frame->dts_pts_delay = 0;
+    frame->keyframe = false;
 
     if (likely(uref)) {
-        pic.opaque = uref;
-
-        /* open encoder if not already opened or if update needed */
-        if (unlikely(!ubase_check(upipe_x264_update(upipe, uref)))) {
-            upipe_err(upipe, "Could not open encoder");
-            uref_free(uref);
-            return true;
-        }
-        if (upipe_x264->flow_def_requested == NULL)
-            return false;
-
-        x264_encoder_parameters(upipe_x264->encoder, &curparams);
-
-        pic.img.i_csp = upipe_x264->chroma_subsampling;
-
         /* set pts in x264 timebase */
-        pic.i_pts = upipe_x264->x264_ts;
+        frame->i_pts = upipe_x264->x264_ts;
         upipe_x264->x264_ts++;
         uref_clock_get_rate(uref, &upipe_x264->drift_rate);
         uref_clock_get_pts_prog(uref, &upipe_x264->input_pts);
         uref_clock_get_pts_sys(uref, &upipe_x264->input_pts_sys);
 
-        pic.i_type = X264_TYPE_AUTO;
         if (upipe_x264->slice_type_enforce) {
             uint8_t type;
             if (ubase_check(uref_h264_get_type(uref, &type))) {
                 switch (type) {
                     case H264SLI_TYPE_P:
-                        pic.i_type = X264_TYPE_P;
+                        frame->i_type = X264_TYPE_P;
                         break;
                     case H264SLI_TYPE_B:
-                        pic.i_type = X264_TYPE_B;
+                        frame->i_type = X264_TYPE_B;
                         break;
                     case H264SLI_TYPE_I:
-                        pic.i_type = X264_TYPE_KEYFRAME;
+                        frame->i_type = X264_TYPE_KEYFRAME;
                         break;
                     case H264SLI_TYPE_SP:
                     case H264SLI_TYPE_SI:
@@ -864,13 +1141,13 @@ static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
             } else if (ubase_check(uref_mpgv_get_type(uref, &type))) {
                 switch (type) {
                     case MP2VPIC_TYPE_P:
-                        pic.i_type = X264_TYPE_P;
+                        frame->i_type = X264_TYPE_P;
                         break;
                     case MP2VPIC_TYPE_B:
-                        pic.i_type = X264_TYPE_B;
+                        frame->i_type = X264_TYPE_B;
                         break;
                     case MP2VPIC_TYPE_I:
-                        pic.i_type = X264_TYPE_KEYFRAME;
+                        frame->i_type = X264_TYPE_KEYFRAME;
                         break;
                     case MP2VPIC_TYPE_D:
                     default:
@@ -879,102 +1156,50 @@ static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
             }
         }
 
-#ifdef HAVE_X264_MPEG2
         if (!uref_pic_check_progressive(uref))
-            pic.b_tff = uref_pic_check_tff(uref);
-#endif
-
-        /* map */
-        static const char *chromas_planar[] = {"y8", "u8", "v8"};
-        static const char *chromas_semiplanar[] = {"y8", "u8v8"};
-        const char **chromas;
-        int chromas_count;
-
-        if (upipe_x264->chroma_subsampling == X264_CSP_NV12 ||
-            upipe_x264->chroma_subsampling == X264_CSP_NV16) {
-            chromas = chromas_semiplanar;
-            chromas_count = 2;
-        } else {
-            chromas = chromas_planar;
-            chromas_count = 3;
-        }
-
-        for (i = 0; i < chromas_count; i++) {
-            size_t stride;
-            const uint8_t *plane;
-            if (unlikely(!ubase_check(uref_pic_plane_size(uref, chromas[i], &stride,
-                                              NULL, NULL, NULL)) ||
-                         !ubase_check(uref_pic_plane_read(uref, chromas[i], 0, 0, -1, -1,
-                                              &plane)))) {
-                upipe_err_va(upipe, "Could not read origin chroma %s",
-                             chromas[i]);
-                uref_free(uref);
-                return true;
-            }
-            pic.img.i_stride[i] = stride;
-            /* cast needed because of x264 API */
-            pic.img.plane[i] = (uint8_t *)plane;
-        }
-        pic.img.i_plane = i;
-
-        /* encode frame ! */
-        ret = x264_encoder_encode(upipe_x264->encoder,
-                                  &nals, &nals_num, &pic, &pic);
-
-        /* unmap */
-        for (i = 0; i < chromas_count; i++) {
-            uref_pic_plane_unmap(uref, chromas[i], 0, 0, -1, -1);
-        }
-        ubuf_free(uref_detach_ubuf(uref));
-
-    } else {
-        /* NULL uref, flushing delayed frame */
-        ret = x264_encoder_encode(upipe_x264->encoder,
-                                  &nals, &nals_num, NULL, &pic);
-        x264_encoder_parameters(upipe_x264->encoder, &curparams);
-    }
-
-    if (unlikely(ret < 0)) {
-        upipe_warn(upipe, "Error encoding frame");
-        uref_free(uref);
-        return true;
-    } else if (unlikely(ret == 0)) {
-        upipe_verbose(upipe, "No nal units returned");
-        return true;
+            frame->b_tff = uref_pic_check_tff(uref);
     }
 
-    /* get uref back */
-    uref = pic.opaque;
-    assert(uref);
+    frame->input_pts = upipe_x264->input_pts;
+    frame->input_pts_sys = upipe_x264->input_pts_sys;
+    frame->drift_rate = upipe_x264->drift_rate;
+}
 
-    for (i = 0; i < nals_num; i++) {
-        size += nals[i].i_payload;
-        if (nals[i].i_type == NAL_SPS || nals[i].i_type == NAL_PPS ||
-            nals[i].i_type == NAL_AUD || nals[i].i_type == NAL_FILLER ||
-            nals[i].i_type == NAL_UNKNOWN)
-            header_size += nals[i].i_payload;
+/** @internal @This outputs an encoded frame.
+ *
+ * @param upipe description structure of the pipe
+ * @param frame description of the encoded frame
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_x264_output_frame(struct upipe *upipe,
+                                    struct upipe_x264_frame *frame,
+                                    struct upump **upump_p)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    struct uref *uref = frame->uref;
+    ubuf_mgr_release(frame->ubuf_mgr);
+    uclock_release(frame->uclock);
+
+    switch (frame->err) {
+        case UBASE_ERR_NONE:
+            break;
+        case UBASE_ERR_INVALID:
+            upipe_err_va(upipe, "Could not read origin chroma %s",
+                         frame->chroma);
+            return;
+        case UBASE_ERR_ALLOC:
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        default:
+            upipe_warn(upipe, "Error encoding frame");
+            return;
     }
-
-    /* alloc ubuf, map, copy, unmap */
-    ubuf_block = ubuf_block_alloc(upipe_x264->ubuf_mgr, size);
-    if (unlikely(ubuf_block == NULL)) {
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return true;
+    if (unlikely(uref == NULL)) {
+        upipe_verbose(upipe, "No nal units returned");
+        return;
     }
-    ubuf_block_write(ubuf_block, 0, &size, &buf);
-    memcpy(buf, nals[0].p_payload, size);
-    ubuf_block_unmap(ubuf_block, 0);
-    uref_attach_ubuf(uref, ubuf_block);
-    uref_block_set_header_size(uref, header_size);
 
     if (!upipe_x264_mpeg2_enabled(upipe)) {
-        /* NAL offsets */
-        uint64_t offset = 0;
-        for (i = 0; i < nals_num - 1; i++) {
-            offset += nals[i].i_payload;
-            uref_h26x_set_nal_offset(uref, offset, i);
-        }
-
         /* optionally convert NAL encapsulation */
         enum uref_h26x_encaps encaps = upipe_x264->params.b_annexb ?
             UREF_H26X_ENCAPS_ANNEXB : UREF_H26X_ENCAPS_LENGTH4;
@@ -990,10 +1215,7 @@ static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
     }
 
     /* set dts */
-    uint64_t dts_pts_delay = (uint64_t)(pic.i_pts - pic.i_dts) * UCLOCK_FREQ
-                              * curparams.i_timebase_num
-                              / curparams.i_timebase_den;
-    uref_clock_set_dts_pts_delay(uref, dts_pts_delay);
+    uref_clock_set_dts_pts_delay(uref, frame->dts_pts_delay);
     uref_clock_delete_cr_dts_delay(uref);
 
     /* rebase to dts as we're in encoded domain now */
@@ -1010,12 +1232,12 @@ static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
 
     uint64_t dts_sys = UINT64_MAX;
     if (dts != UINT64_MAX &&
-        upipe_x264->input_pts != UINT64_MAX &&
-        upipe_x264->input_pts_sys != UINT64_MAX) {
-        dts_sys = (int64_t)upipe_x264->input_pts_sys +
-            ((int64_t)dts - (int64_t)upipe_x264->input_pts) *
-            (int64_t)upipe_x264->drift_rate.num /
-            (int64_t)upipe_x264->drift_rate.den;
+        frame->input_pts != UINT64_MAX &&
+        frame->input_pts_sys != UINT64_MAX) {
+        dts_sys = (int64_t)frame->input_pts_sys +
+            ((int64_t)dts - (int64_t)frame->input_pts) *
+            (int64_t)frame->drift_rate.num /
+            (int64_t)frame->drift_rate.den;
         uref_clock_set_dts_sys(uref, dts_sys);
     } else if (!ubase_check(uref_clock_get_dts_sys(uref, &dts_sys)) ||
         (upipe_x264->last_dts_sys != UINT64_MAX &&
@@ -1030,25 +1252,12 @@ static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
         uref_clock_rebase_dts_sys(uref);
 
     uref_clock_rebase_dts_orig(uref);
-    uref_clock_set_rate(uref, upipe_x264->drift_rate);
+    uref_clock_set_rate(uref, frame->drift_rate);
 
     upipe_x264->last_dts = dts;
     upipe_x264->last_dts_sys = dts_sys;
 
-#ifdef HAVE_X264_OBE
-    /* speedcontrol */
-    if (dts_sys != UINT64_MAX && upipe_x264->uclock != NULL &&
-        upipe_x264->sc_latency) {
-        uint64_t systime = uclock_now(upipe_x264->uclock);
-        int64_t buffer_state = dts_sys + upipe_x264->initial_latency +
-                               upipe_x264->sc_latency - systime;
-        float buffer_fill = (float)buffer_state /
-                            (float)upipe_x264->sc_latency;
-        x264_speedcontrol_sync(upipe_x264->encoder, buffer_fill, 0, 1);
-    }
-#endif
-
-    if (pic.b_keyframe) {
+    if (frame->keyframe) {
         uref_flow_set_random(uref);
     }
 
@@ -1056,6 +1265,254 @@ static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
         upipe_x264_build_flow_def(upipe);
 
     upipe_x264_output(upipe, uref, upump_p);
+}
+
+/** @internal @This outputs the frames returned by the encoder thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_x264_async_output(struct upipe *upipe,
+                                    struct upump **upump_p)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    struct upipe_x264_frame *frame;
+    while ((frame = uqueue_pop(&upipe_x264->async_done,
+                               struct upipe_x264_frame *)) != NULL) {
+        assert(upipe_x264->async_pending);
+        upipe_x264->async_pending--;
+        upipe_x264_output_frame(upipe, frame, upump_p);
+        free(frame);
+    }
+}
+
+/** @internal @This is called when the encoder thread returns frames.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_x264_async_worker(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    upipe_x264_async_output(upipe, &upipe_x264->upump);
+
+    bool was_buffered = !upipe_x264_check_input(upipe);
+    upipe_x264_output_input(upipe);
+    upipe_x264_unblock_input(upipe);
+    if (was_buffered && upipe_x264_check_input(upipe)) {
+        /* All packets have been output, release again the pipe that has been
+         * used in @ref upipe_x264_input. */
+        upipe_release(upipe);
+    }
+}
+
+/** @internal @This terminates the encoder thread and outputs all the frames
+ * it returned.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_x264_async_drain(struct upipe *upipe)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    if (!upipe_x264->async_length)
+        return;
+    upipe_x264_async_join(upipe);
+    upipe_x264_async_output(upipe, NULL);
+    assert(!upipe_x264->async_pending);
+}
+
+/** @internal @This outputs the frames returned by the encoder thread when
+ * there is no upump manager to watch them. If the encoder thread is full,
+ * or if all pending frames are requested, it first waits for frames to be
+ * encoded, since nothing would output an input held for them.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ * @param flush true to wait for all pending frames
+ */
+static void upipe_x264_async_poll(struct upipe *upipe, struct upump **upump_p,
+                                  bool flush)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    while (upipe_x264->async_pending &&
+           (flush ||
+            upipe_x264->async_pending >= upipe_x264->async_length)) {
+        pthread_mutex_lock(&upipe_x264->async_mutex);
+        while (!uqueue_length(&upipe_x264->async_done))
+            pthread_cond_wait(&upipe_x264->async_cond,
+                              &upipe_x264->async_mutex);
+        pthread_mutex_unlock(&upipe_x264->async_mutex);
+        upipe_x264_async_output(upipe, upump_p);
+    }
+    upipe_x264_async_output(upipe, upump_p);
+}
+
+/** @internal @This starts the watcher of encoded frames if an upump manager
+ * is available, and the encoder thread if needed.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_x264_async_start(struct upipe *upipe)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    if (upipe_x264->upump == NULL && upipe_x264->upump_mgr == NULL)
+        upipe_x264_check_upump_mgr(upipe);
+    if (upipe_x264->upump == NULL && upipe_x264->upump_mgr != NULL) {
+        struct upump *upump =
+            uqueue_upump_alloc_pop(&upipe_x264->async_done,
+                                   upipe_x264->upump_mgr,
+                                   upipe_x264_async_worker, upipe,
+                                   upipe->refcount);
+        UBASE_ALLOC_RETURN(upump);
+        upipe_x264_set_upump(upipe, upump);
+        upump_start(upump);
+    }
+
+    if (!upipe_x264->async_running) {
+        if (unlikely(pthread_create(&upipe_x264->async_thread, NULL,
+                                    upipe_x264_async_run, upipe_x264) != 0))
+            return UBASE_ERR_EXTERNAL;
+        upipe_x264->async_running = true;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This hands a picture over to the encoder thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref picture to encode
+ * @return an error code
+ */
+static int upipe_x264_async_submit(struct upipe *upipe, struct uref *uref)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    UBASE_RETURN(upipe_x264_async_start(upipe));
+
+    struct upipe_x264_frame *frame = malloc(sizeof (*frame));
+    UBASE_ALLOC_RETURN(frame);
+    upipe_x264_prepare_frame(upipe, frame, uref);
+
+    upipe_x264->async_pending++;
+    pthread_mutex_lock(&upipe_x264->async_mutex);
+    ulist_add(&upipe_x264->async_frames, &frame->uchain);
+    pthread_cond_broadcast(&upipe_x264->async_cond);
+    pthread_mutex_unlock(&upipe_x264->async_mutex);
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This processes pictures.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref uref structure
+ * @param upump_p reference to upump structure
+ * @return true if the packet was handled
+ */
+static bool upipe_x264_handle(struct upipe *upipe, struct uref *uref,
+                              struct upump **upump_p)
+{
+    struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+    const char *def;
+    if (unlikely(uref != NULL && ubase_check(uref_flow_get_def(uref, &def)))) {
+        /* output the frames of the previous flow first */
+        if (upipe_x264->async_pending && upipe_x264->upump == NULL)
+            upipe_x264_async_poll(upipe, upump_p, true);
+        if (upipe_x264->async_pending)
+            return false;
+
+        upipe_x264->input_latency = 0;
+        uref_clock_get_latency(uref, &upipe_x264->input_latency);
+        upipe_x264_store_flow_def(upipe, NULL);
+        uref_free(upipe_x264->flow_def_requested);
+        upipe_x264->flow_def_requested = NULL;
+
+        if (upipe_x264_mpeg2_enabled(upipe)) {
+            struct urational dar;
+            dar.num = 4;
+            dar.den = 3;
+            uref_pic_flow_infer_dar(uref, &dar);
+            if (dar.num == 4 && dar.den == 3)
+                upipe_x264->mpeg2_ar = 2;
+            else if (dar.num == 16 && dar.den == 9)
+                upipe_x264->mpeg2_ar = 3;
+            else if (dar.num == 221 && dar.den == 100)
+                upipe_x264->mpeg2_ar = 4;
+            else {
+                upipe_warn_va(upipe,
+                        "unrecognized aspect ratio %"PRId64"/%"PRIu64", using square",
+                        dar.num, dar.den);
+                upipe_x264->mpeg2_ar = 1;
+            }
+        } else {
+            upipe_x264->sar.num = upipe_x264->sar.den = 1;
+            uref_pic_flow_get_sar(uref, &upipe_x264->sar);
+            bool overscan;
+            if (!ubase_check(uref_pic_flow_get_overscan(uref, &overscan)))
+                upipe_x264->overscan = 0; /* undef */
+            else
+                upipe_x264->overscan = overscan ? 2 : 1;
+        }
+
+        if (ubase_check(uref_pic_flow_check_yuv420p(uref)))
+            upipe_x264->chroma_subsampling = X264_CSP_I420;
+        else if (ubase_check(uref_pic_flow_check_yuv422p(uref)))
+            upipe_x264->chroma_subsampling = X264_CSP_I422;
+        else if (ubase_check(uref_pic_flow_check_yuv444p(uref)))
+            upipe_x264->chroma_subsampling = X264_CSP_I444;
+        else if (ubase_check(uref_pic_flow_check_nv12(uref)))
+            upipe_x264->chroma_subsampling = X264_CSP_NV12;
+        else if (ubase_check(uref_pic_flow_check_nv16(uref)))
+            upipe_x264->chroma_subsampling = X264_CSP_NV16;
+        else
+            upipe_err(upipe, "invalid chroma subsampling");
+
+        uref = upipe_x264_store_flow_def_input(upipe, uref);
+        if (uref != NULL) {
+            uref_pic_flow_clear_format(uref);
+            upipe_x264_require_flow_format(upipe, uref);
+        }
+        return true;
+    }
+
+    struct upipe_x264_frame frame;
+
+    if (likely(uref)) {
+        /* without a watcher, encoded frames are output from the input */
+        if (upipe_x264->async_pending && upipe_x264->upump == NULL)
+            upipe_x264_async_poll(upipe, upump_p, false);
+        if (upipe_x264->async_pending >= upipe_x264->async_length &&
+            upipe_x264->async_length)
+            return false;
+
+        /* open encoder if not already opened or if update needed */
+        int err = upipe_x264_update(upipe, uref);
+        if (err == UBASE_ERR_BUSY && upipe_x264->upump == NULL) {
+            upipe_x264_async_poll(upipe, upump_p, true);
+            err = upipe_x264_update(upipe, uref);
+        }
+        if (err == UBASE_ERR_BUSY)
+            return false;
+        if (unlikely(!ubase_check(err))) {
+            upipe_err(upipe, "Could not open encoder");
+            uref_free(uref);
+            return true;
+        }
+        if (upipe_x264->flow_def_requested == NULL)
+            return false;
+
+        if (upipe_x264->async_length) {
+            err = upipe_x264_async_submit(upipe, uref);
+            if (likely(ubase_check(err)))
+                return true;
+            upipe_warn_va(upipe, "unable to use the encoder thread (%s)",
+                          ubase_err_str(err) ?: "unknown");
+            upipe_x264_async_join(upipe);
+        }
+    }
+
+    upipe_x264_prepare_frame(upipe, &frame, uref);
+    upipe_x264_encode_frame(upipe_x264, &frame);
+    upipe_x264_output_frame(upipe, &frame, upump_p);
     return true;
 }
 
@@ -1261,6 +1718,15 @@ static int upipe_x264_control(struct upipe *upipe, int command, va_list args)
         case UPIPE_ATTACH_UCLOCK:
             upipe_x264_require_uclock(upipe);
             return UBASE_ERR_NONE;
+        case UPIPE_ATTACH_UPUMP_MGR: {
+            struct upipe_x264 *upipe_x264 = upipe_x264_from_upipe(upipe);
+            upipe_x264_set_upump(upipe, NULL);
+            UBASE_RETURN(upipe_x264_attach_upump_mgr(upipe));
+            if (upipe_x264->async_pending)
+                /* watch the frames still in the encoder thread */
+                return upipe_x264_async_start(upipe);
+            return UBASE_ERR_NONE;
+        }
         case UPIPE_REGISTER_REQUEST: {
             struct urequest *request = va_arg(args, struct urequest *);
             if (request->type == UREQUEST_UBUF_MGR)
@@ -1324,6 +1790,11 @@ static int upipe_x264_control(struct upipe *upipe, int command, va_list args)
             bool enforce = !(va_arg(args, int) == 0);
             return _upipe_x264_set_slice_type_enforce(upipe, enforce);
         }
+        case UPIPE_X264_SET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_X264_SIGNATURE)
+            unsigned int queue_length = va_arg(args, unsigned int);
+            return _upipe_x264_set_async(upipe, queue_length);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -1339,6 +1810,14 @@ static void upipe_x264_free(struct upipe *upipe)
     upipe_x264_close(upipe);
 
     upipe_throw_dead(upipe);
+    upipe_x264_clean_upump(upipe);
+    upipe_x264_clean_upump_mgr(upipe);
+    if (upipe_x264->async_done_extra != NULL) {
+        uqueue_clean(&upipe_x264->async_done);
+        free(upipe_x264->async_done_extra);
+    }
+    pthread_cond_destroy(&upipe_x264->async_cond);
+    pthread_mutex_destroy(&upipe_x264->async_mutex);
     upipe_x264_clean_uclock(upipe);
     upipe_x264_clean_ubuf_mgr(upipe);
     upipe_x264_clean_input(upipe);
@@ -4,4 +4,4 @@ libupipe_x265-desc = x265 interface module
 libupipe_x265-so-version = 1.0.0
 libupipe_x265-includes = upipe_x265.h
 libupipe_x265-src = upipe_x265.c
-libupipe_x265-libs = libupipe_framers x265 bitstream
+libupipe_x265-libs = libupipe_framers x265 bitstream pthread
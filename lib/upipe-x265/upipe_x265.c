@@ -24,12 +24,16 @@
 #include "upipe/uref_block.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/ubuf_block.h"
+#include "upipe/uqueue.h"
+#include "upipe/upump.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_upipe.h"
 #include "upipe/upipe_helper_urefcount.h"
 #include "upipe/upipe_helper_void.h"
 #include "upipe/upipe_helper_ubuf_mgr.h"
 #include "upipe/upipe_helper_uclock.h"
+#include "upipe/upipe_helper_upump_mgr.h"
+#include "upipe/upipe_helper_upump.h"
 #include "upipe/upipe_helper_output.h"
 #include "upipe/upipe_helper_input.h"
 #include "upipe/upipe_helper_flow_format.h"
@@ -44,6 +48,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include <x265_config.h>
 
@@ -222,11 +227,81 @@ struct upipe_x265 {
     int64_t sc_buffer_size;
     /** speedcontrol buffer fullness */
     int64_t sc_buffer_fill;
+    /** true if the parameters of a speedcontrol preset must be applied
+     * before the next picture */
+    bool sc_reconfig;
+
+    /** upump manager */
+    struct upump_mgr *upump_mgr;
+    /** watcher of the queue of encoded frames */
+    struct upump *upump;
+    /** maximum number of frames handed to the encoder thread, or 0 to encode
+     * synchronously */
+    unsigned int async_length;
+    /** number of frames handed to the encoder thread and not output yet */
+    unsigned int async_pending;
+    /** true if the encoder thread is running */
+    bool async_running;
+    /** true if the encoder thread must exit when it has no more frames */
+    bool async_quit;
+    /** encoder thread */
+    pthread_t async_thread;
+    /** mutex protecting the list of frames to encode */
+    pthread_mutex_t async_mutex;
+    /** condition signalled when the list of frames to encode changes, or
+     * when a frame is encoded */
+    pthread_cond_t async_cond;
+    /** list of frames to encode */
+    struct uchain async_frames;
+    /** queue of encoded frames */
+    struct uqueue async_done;
+    /** extra data for the queue of encoded frames */
+    void *async_done_extra;
 
     /** public structure */
     struct upipe upipe;
 };
 
+/** @internal @This describes a picture going through the encoder. */
+struct upipe_x265_frame {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** picture to encode or NULL to flush a delayed frame, then encoded frame
+     * or NULL if the encoder returned no frame */
+    struct uref *uref;
+    /** true if flushing a delayed frame */
+    bool flush;
+    /** parameters to apply before encoding the picture, or NULL */
+    x265_param *params;
+    /** ubuf manager to allocate the encoded frame */
+    struct ubuf_mgr *ubuf_mgr;
+    /** x265 picture */
+    x265_picture pic;
+    /** names of the planes of the picture */
+    const char *const *chromas;
+    /** input PTS (program time) at the time of the picture */
+    uint64_t input_pts;
+    /** input PTS (system time) at the time of the picture */
+    uint64_t input_pts_sys;
+    /** drift rate at the time of the picture */
+    struct urational drift_rate;
+
+    /** value returned by the encoder */
+    int ret;
+    /** error code */
+    int err;
+    /** chroma plane which could not be read */
+    const char *chroma;
+    /** error code of the reconfiguration of the encoder */
+    int reconfig_err;
+    /** delay between DTS and PTS of the encoded frame */
+    uint64_t dts_pts_delay;
+    /** true if the encoded frame is a random access point */
+    bool keyframe;
+};
+
+UBASE_FROM_TO(upipe_x265_frame, uchain, uchain, uchain)
+
 /** @hidden */
 static int upipe_x265_check_ubuf_mgr(struct upipe *upipe,
                                      struct uref *flow_format);
@@ -236,6 +311,8 @@ static int upipe_x265_check_flow_format(struct upipe *upipe,
 /** @hidden */
 static bool upipe_x265_handle(struct upipe *upipe, struct uref *uref,
                               struct upump **upump_p);
+/** @hidden */
+static void upipe_x265_async_drain(struct upipe *upipe);
 
 UPIPE_HELPER_UPIPE(upipe_x265, upipe, UPIPE_X265_SIGNATURE);
 UPIPE_HELPER_UREFCOUNT(upipe_x265, urefcount, upipe_x265_free)
@@ -253,6 +330,8 @@ UPIPE_HELPER_UBUF_MGR(upipe_x265, ubuf_mgr, flow_format, ubuf_mgr_request,
                       upipe_x265_register_output_request,
                       upipe_x265_unregister_output_request)
 UPIPE_HELPER_UCLOCK(upipe_x265, uclock, uclock_request, NULL, upipe_throw_provide_request, NULL)
+UPIPE_HELPER_UPUMP_MGR(upipe_x265, upump_mgr)
+UPIPE_HELPER_UPUMP(upipe_x265, upump, upump_mgr)
 
 /** @internal @This describes the supported pixel formats. */
 static const struct uref_pic_flow_format *pixel_format_desc[] = {
@@ -267,6 +346,19 @@ static const struct uref_pic_flow_format *pixel_format_desc[] = {
     [PIX_FMT_YUV444P12LE] = &uref_pic_flow_format_yuv444p12le,
 };
 
+/** @internal @This describes the planes of the supported pixel formats. */
+static const char *const chromas_list[][3] = {
+    [PIX_FMT_YUV420P]     = {"y8", "u8", "v8"},
+    [PIX_FMT_YUV422P]     = {"y8", "u8", "v8"},
+    [PIX_FMT_YUV444P]     = {"y8", "u8", "v8"},
+    [PIX_FMT_YUV420P10LE] = {"y10l", "u10l", "v10l"},
+    [PIX_FMT_YUV422P10LE] = {"y10l", "u10l", "v10l"},
+    [PIX_FMT_YUV444P10LE] = {"y10l", "u10l", "v10l"},
+    [PIX_FMT_YUV420P12LE] = {"y12l", "u12l", "v12l"},
+    [PIX_FMT_YUV422P12LE] = {"y12l", "u12l", "v12l"},
+    [PIX_FMT_YUV444P12LE] = {"y12l", "u12l", "v12l"},
+};
+
 /** @internal @This gets the pixel format from the flow definition.
  *
  * @param flow_def flow definition
@@ -458,6 +550,186 @@ static int setup_encoder_params(struct upipe *upipe)
     return UBASE_ERR_NONE;
 }
 
+/** @internal @This encodes a picture and packs the returned NAL units into
+ * a block. It only uses the fields of the frame and the encoder, so that it
+ * may run in the encoder thread.
+ *
+ * @param upipe_x265 private structure of the pipe
+ * @param frame description of the picture, replaced with the encoded frame
+ */
+static void upipe_x265_encode_frame(struct upipe_x265 *upipe_x265,
+                                    struct upipe_x265_frame *frame)
+{
+    const char * const *chromas = frame->chromas;
+    struct uref *uref = frame->uref;
+    x265_nal *nals = NULL;
+    int i, size = 0, header_size = 0;
+    uint32_t nals_num = 0;
+    struct ubuf *ubuf_block;
+    uint8_t *buf = NULL;
+    int ret = 0;
+
+    if (frame->params != NULL) {
+        if (upipe_x265->api->encoder_reconfig(upipe_x265->encoder,
+                                              frame->params) != 0)
+            frame->reconfig_err = UBASE_ERR_EXTERNAL;
+        free(frame->params);
+        frame->params = NULL;
+    }
+
+#if X265_BUILD >= 210 && X265_BUILD < 213
+    x265_picture *pic_out[MAX_SCALABLE_LAYERS] = { &frame->pic };
+#else
+    x265_picture *pic_out = &frame->pic;
+#endif
+
+    frame->uref = NULL;
+
+    if (likely(uref)) {
+        /* map */
+        for (i = 0; i < 3; i++) {
+            size_t stride;
+            const uint8_t *plane;
+            if (unlikely(!ubase_check(uref_pic_plane_size(uref, chromas[i], &stride,
+                                              NULL, NULL, NULL)) ||
+                         !ubase_check(uref_pic_plane_read(uref, chromas[i], 0, 0, -1, -1,
+                                              &plane)))) {
+                frame->err = UBASE_ERR_INVALID;
+                frame->chroma = chromas[i];
+                while (--i >= 0)
+                    uref_pic_plane_unmap(uref, chromas[i], 0, 0, -1, -1);
+                uref_free(uref);
+                return;
+            }
+            frame->pic.stride[i] = stride;
+            frame->pic.planes[i] = (void *)plane;
+        }
+
+        /* encode frame */
+        ret = upipe_x265->api->encoder_encode(upipe_x265->encoder,
+                                              &nals, &nals_num,
+                                              &frame->pic, pic_out);
+
+        /* unmap */
+        for (i = 0; i < 3; i++)
+            uref_pic_plane_unmap(uref, chromas[i], 0, 0, -1, -1);
+
+        ubuf_free(uref_detach_ubuf(uref));
+
+    } else {
+        /* NULL uref, flushing delayed frame */
+        ret = upipe_x265->api->encoder_encode(upipe_x265->encoder,
+                                              &nals, &nals_num,
+                                              NULL, pic_out);
+    }
+
+    frame->ret = ret;
+    if (unlikely(ret < 0)) {
+        frame->err = UBASE_ERR_EXTERNAL;
+        uref_free(uref);
+        return;
+    } else if (unlikely(ret == 0)) {
+        return;
+    }
+
+    /* get uref back */
+    uref = frame->pic.userData;
+    assert(uref);
+
+    for (i = 0; i < nals_num; i++) {
+        size += nals[i].sizeBytes;
+        if (nals[i].type == NAL_UNIT_VPS ||
+            nals[i].type == NAL_UNIT_SPS ||
+            nals[i].type == NAL_UNIT_PPS ||
+            nals[i].type == NAL_UNIT_ACCESS_UNIT_DELIMITER ||
+            nals[i].type == NAL_UNIT_FILLER_DATA)
+            header_size += nals[i].sizeBytes;
+    }
+
+    /* alloc ubuf, map, copy, unmap */
+    ubuf_block = ubuf_block_alloc(frame->ubuf_mgr, size);
+    if (unlikely(ubuf_block == NULL)) {
+        frame->err = UBASE_ERR_ALLOC;
+        uref_free(uref);
+        return;
+    }
+    ubuf_block_write(ubuf_block, 0, &size, &buf);
+    memcpy(buf, nals[0].payload, size);
+    ubuf_block_unmap(ubuf_block, 0);
+    uref_attach_ubuf(uref, ubuf_block);
+    uref_block_set_header_size(uref, header_size);
+
+    /* NAL offsets */
+    uint64_t offset = 0;
+    for (i = 0; i < nals_num - 1; i++) {
+        offset += nals[i].sizeBytes;
+        uref_h26x_set_nal_offset(uref, offset, i);
+    }
+
+    frame->dts_pts_delay = frame->pic.pts - frame->pic.dts;
+    frame->keyframe = IS_X265_TYPE_I(frame->pic.sliceType);
+    frame->uref = uref;
+}
+
+/** @internal @This is the main loop of the encoder thread. It encodes the
+ * queued frames in order and hands them back to the queue of encoded
+ * frames.
+ *
+ * @param _upipe_x265 private structure of the pipe
+ * @return NULL
+ */
+static void *upipe_x265_async_run(void *_upipe_x265)
+{
+    struct upipe_x265 *upipe_x265 = _upipe_x265;
+
+    pthread_mutex_lock(&upipe_x265->async_mutex);
+    for ( ; ; ) {
+        struct uchain *uchain = ulist_pop(&upipe_x265->async_frames);
+        if (uchain == NULL) {
+            if (upipe_x265->async_quit)
+                break;
+            pthread_cond_wait(&upipe_x265->async_cond,
+                              &upipe_x265->async_mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&upipe_x265->async_mutex);
+
+        struct upipe_x265_frame *frame = upipe_x265_frame_from_uchain(uchain);
+        upipe_x265_encode_frame(upipe_x265, frame);
+        /* the queue is at least as long as the number of pending frames */
+        bool ret = uqueue_push(&upipe_x265->async_done, frame);
+        assert(ret);
+        (void)ret;
+
+        pthread_mutex_lock(&upipe_x265->async_mutex);
+        /* wake up the pipe if it waits for an encoded frame */
+        pthread_cond_broadcast(&upipe_x265->async_cond);
+    }
+    pthread_mutex_unlock(&upipe_x265->async_mutex);
+    return NULL;
+}
+
+/** @internal @This waits for the encoder thread to encode the queued frames
+ * and terminates it, so that the encoder may be used from the pipe. The
+ * thread is started again with the next picture.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_x265_async_join(struct upipe *upipe)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    if (!upipe_x265->async_running)
+        return;
+
+    pthread_mutex_lock(&upipe_x265->async_mutex);
+    upipe_x265->async_quit = true;
+    pthread_cond_broadcast(&upipe_x265->async_cond);
+    pthread_mutex_unlock(&upipe_x265->async_mutex);
+    pthread_join(upipe_x265->async_thread, NULL);
+    upipe_x265->async_quit = false;
+    upipe_x265->async_running = false;
+}
+
 /** @internal @This reconfigures encoder with updated parameters
  *
  * @param upipe description structure of the pipe
@@ -471,6 +743,9 @@ static int _upipe_x265_reconfigure(struct upipe *upipe)
     if (unlikely(upipe_x265->encoder == NULL))
         return UBASE_ERR_NONE;
 
+    upipe_x265_async_join(upipe);
+    /* the parameters include the last speedcontrol preset */
+    upipe_x265->sc_reconfig = false;
     int ret = upipe_x265->api->encoder_reconfig(upipe_x265->encoder,
                                                 &upipe_x265->params);
     return ret != 0 ? UBASE_ERR_EXTERNAL : UBASE_ERR_NONE;
@@ -527,6 +802,37 @@ static int _upipe_x265_set_slice_type_enforce(struct upipe *upipe, bool enforce)
     return UBASE_ERR_NONE;
 }
 
+/** @This switches the encoder to a dedicated thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param queue_length maximum number of frames handed to the encoder thread
+ * @return an error code
+ */
+static int _upipe_x265_set_async(struct upipe *upipe,
+                                 unsigned int queue_length)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    if (upipe_x265->encoder != NULL || upipe_x265->async_length)
+        return UBASE_ERR_BUSY;
+    if (!queue_length)
+        return UBASE_ERR_NONE;
+    if (queue_length > UQUEUE_MAX_LENGTH)
+        return UBASE_ERR_INVALID;
+
+    upipe_x265->async_done_extra = malloc(uqueue_sizeof(queue_length));
+    UBASE_ALLOC_RETURN(upipe_x265->async_done_extra);
+    if (unlikely(!uqueue_init(&upipe_x265->async_done, queue_length,
+                              upipe_x265->async_done_extra))) {
+        free(upipe_x265->async_done_extra);
+        upipe_x265->async_done_extra = NULL;
+        return UBASE_ERR_EXTERNAL;
+    }
+    upipe_x265->async_length = queue_length;
+    upipe_dbg_va(upipe, "encoding in a dedicated thread (queue length %u)",
+                 queue_length);
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This allocates a filter pipe.
  *
  * @param mgr common management structure
@@ -557,6 +863,7 @@ static struct upipe *upipe_x265_alloc(struct upipe_mgr *mgr,
     upipe_x265->latency_frames = 3;
     upipe_x265->initial_latency = 0;
     upipe_x265->sc_latency = 0;
+    upipe_x265->sc_reconfig = false;
     upipe_x265->slice_type_enforce = false;
     upipe_x265->delayed_frames = true;
 
@@ -580,6 +887,17 @@ static struct upipe *upipe_x265_alloc(struct upipe_mgr *mgr,
     upipe_x265->input_pts = UINT64_MAX;
     upipe_x265->input_pts_sys = UINT64_MAX;
 
+    upipe_x265_init_upump_mgr(upipe);
+    upipe_x265_init_upump(upipe);
+    upipe_x265->async_length = 0;
+    upipe_x265->async_pending = 0;
+    upipe_x265->async_running = false;
+    upipe_x265->async_quit = false;
+    pthread_mutex_init(&upipe_x265->async_mutex, NULL);
+    pthread_cond_init(&upipe_x265->async_cond, NULL);
+    ulist_init(&upipe_x265->async_frames);
+    upipe_x265->async_done_extra = NULL;
+
     upipe_throw_ready(upipe);
     return upipe;
 }
@@ -622,8 +940,9 @@ static void speedcontrol_update(struct upipe *upipe)
                                   option->name, option->value);
         }
 
-        if (ubase_check(_upipe_x265_reconfigure(upipe)))
-            upipe_x265->sc_preset = set;
+        /* applied between two pictures, by the thread encoding them */
+        upipe_x265->sc_reconfig = true;
+        upipe_x265->sc_preset = set;
     }
 }
 
@@ -758,6 +1077,7 @@ static void upipe_x265_close(struct upipe *upipe)
 {
     struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
     if (upipe_x265->encoder) {
+        upipe_x265_async_drain(upipe);
         while (upipe_x265->delayed_frames)
             upipe_x265_handle(upipe, NULL, NULL);
 
@@ -774,6 +1094,7 @@ static void upipe_x265_build_flow_def(struct upipe *upipe)
 {
     struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
     assert(upipe_x265->flow_def_requested != NULL);
+    upipe_x265_async_join(upipe);
 
     struct uref *flow_def = uref_dup(upipe_x265->flow_def_requested);
     if (unlikely(flow_def == NULL)) {
@@ -900,6 +1221,336 @@ static void upipe_x265_get_aspect_ratio(struct upipe *upipe,
     upipe_x265->sar_height = sar.den;
 }
 
+/** @internal @This fills in the description of a picture to encode.
+ *
+ * @param upipe description structure of the pipe
+ * @param frame description of the picture
+ * @param uref picture to encode, or NULL to flush a delayed frame
+ */
+static void upipe_x265_prepare_frame(struct upipe *upipe,
+                                     struct upipe_x265_frame *frame,
+                                     struct uref *uref)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+
+    uchain_init(&frame->uchain);
+    frame->uref = uref;
+    frame->flush = uref == NULL;
+    frame->ubuf_mgr = ubuf_mgr_use(upipe_x265->ubuf_mgr);
+    frame->chromas = chromas_list[upipe_x265->pixel_format];
+    frame->ret = 0;
+    frame->err = UBASE_ERR_NONE;
+    frame->chroma = NULL;
+    frame->dts_pts_delay = 0;
+    frame->keyframe = false;
+    frame->reconfig_err = UBASE_ERR_NONE;
+
+    frame->params = NULL;
+    if (upipe_x265->sc_reconfig) {
+        frame->params = malloc(sizeof (*frame->params));
+        if (likely(frame->params != NULL)) {
+            *frame->params = upipe_x265->params;
+            upipe_x265->sc_reconfig = false;
+        }
+    }
+
+    /* init x265 picture */
+    upipe_x265->api->picture_init(&upipe_x265->params, &frame->pic);
+
+    if (likely(uref)) {
+        frame->pic.userData = uref;
+        frame->pic.bitDepth =
+            pixel_format_to_bit_depth(upipe_x265->pixel_format);
+        frame->pic.colorSpace =
+            pixel_format_to_color_space(upipe_x265->pixel_format);
+
+        uref_clock_get_rate(uref, &upipe_x265->drift_rate);
+        uref_clock_get_pts_prog(uref, &upipe_x265->input_pts);
+        uref_clock_get_pts_sys(uref, &upipe_x265->input_pts_sys);
+
+        frame->pic.pts = upipe_x265->input_pts;
+
+        frame->pic.sliceType = X265_TYPE_AUTO;
+        if (upipe_x265->slice_type_enforce) {
+            uint8_t type;
+            if (ubase_check(uref_h265_get_type(uref, &type))) {
+                switch (type) {
+                    case H265SLI_TYPE_P:
+                        frame->pic.sliceType = X265_TYPE_P;
+                        break;
+                    case H265SLI_TYPE_B:
+                        frame->pic.sliceType = X265_TYPE_B;
+                        break;
+                    case H265SLI_TYPE_I:
+                        frame->pic.sliceType = upipe_x265->params.bOpenGOP ?
+                            X265_TYPE_I :
+                            X265_TYPE_IDR;
+                        break;
+                }
+            }
+        }
+    }
+
+    frame->input_pts = upipe_x265->input_pts;
+    frame->input_pts_sys = upipe_x265->input_pts_sys;
+    frame->drift_rate = upipe_x265->drift_rate;
+}
+
+/** @internal @This outputs an encoded frame.
+ *
+ * @param upipe description structure of the pipe
+ * @param frame description of the encoded frame
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_x265_output_frame(struct upipe *upipe,
+                                    struct upipe_x265_frame *frame,
+                                    struct upump **upump_p)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    struct uref *uref = frame->uref;
+    ubuf_mgr_release(frame->ubuf_mgr);
+
+    if (unlikely(!ubase_check(frame->reconfig_err)))
+        upipe_err(upipe, "could not apply speedcontrol preset");
+
+    if (frame->flush) {
+        if (frame->ret <= 0)
+            upipe_x265->delayed_frames = false;
+    } else if (unlikely(frame->ret == 0 && frame->err == UBASE_ERR_NONE)) {
+        /* delayed frame, increase latency */
+        upipe_x265->latency_frames++;
+    }
+
+    switch (frame->err) {
+        case UBASE_ERR_NONE:
+            break;
+        case UBASE_ERR_INVALID:
+            upipe_err_va(upipe, "Could not read origin chroma %s",
+                         frame->chroma);
+            return;
+        case UBASE_ERR_ALLOC:
+            upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
+            return;
+        default:
+            upipe_warn(upipe, "Error encoding frame");
+            return;
+    }
+    if (unlikely(uref == NULL)) {
+        upipe_verbose(upipe, "No nal units returned");
+        return;
+    }
+
+    /* optionally convert NAL encapsulation */
+    enum uref_h26x_encaps encaps = upipe_x265->params.bAnnexB ?
+        UREF_H26X_ENCAPS_ANNEXB : UREF_H26X_ENCAPS_LENGTH4;
+    /* no need for annex B header because if annexb is requested, there
+     * will be no conversion */
+    int err = upipe_h26xf_convert_frame(uref,
+                                        encaps,
+                                        upipe_x265->encaps_requested,
+                                        upipe_x265->ubuf_mgr,
+                                        NULL);
+    if (!ubase_check(err)) {
+        upipe_warn(upipe, "invalid NAL encapsulation conversion");
+        upipe_throw_error(upipe, err);
+    }
+
+    /* set dts */
+    uref_clock_set_dts_pts_delay(uref, frame->dts_pts_delay);
+    uref_clock_delete_cr_dts_delay(uref);
+
+    /* rebase to dts as we're in encoded domain now */
+    uint64_t dts = UINT64_MAX;
+    if ((!ubase_check(uref_clock_get_dts_prog(uref, &dts)) ||
+         dts < upipe_x265->last_dts) &&
+        upipe_x265->last_dts != UINT64_MAX) {
+        upipe_warn_va(upipe, "DTS prog in the past, resetting (%"PRIu64" ms)",
+                      (upipe_x265->last_dts - dts) * 1000 / UCLOCK_FREQ);
+        dts = upipe_x265->last_dts + 1;
+        uref_clock_set_dts_prog(uref, dts);
+    } else
+        uref_clock_rebase_dts_prog(uref);
+
+    uint64_t dts_sys = UINT64_MAX;
+    if (dts != UINT64_MAX &&
+        frame->input_pts != UINT64_MAX &&
+        frame->input_pts_sys != UINT64_MAX) {
+        dts_sys = (int64_t)frame->input_pts_sys +
+            ((int64_t)dts - (int64_t)frame->input_pts) *
+            (int64_t)frame->drift_rate.num /
+            (int64_t)frame->drift_rate.den;
+        uref_clock_set_dts_sys(uref, dts_sys);
+    } else if (!ubase_check(uref_clock_get_dts_sys(uref, &dts_sys)) ||
+        (upipe_x265->last_dts_sys != UINT64_MAX &&
+               dts_sys < upipe_x265->last_dts_sys)) {
+        upipe_warn_va(upipe,
+                      "DTS sys in the past, resetting (%"PRIu64" ms)",
+                      (upipe_x265->last_dts_sys - dts_sys) * 1000 /
+                      UCLOCK_FREQ);
+        dts_sys = upipe_x265->last_dts_sys + 1;
+        uref_clock_set_dts_sys(uref, dts_sys);
+    } else
+        uref_clock_rebase_dts_sys(uref);
+
+    uref_clock_rebase_dts_orig(uref);
+    uref_clock_set_rate(uref, frame->drift_rate);
+
+    upipe_x265->last_dts = dts;
+    upipe_x265->last_dts_sys = dts_sys;
+
+    if (dts_sys != UINT64_MAX &&
+        upipe_x265->uclock != NULL &&
+        upipe_x265->sc_latency) {
+        /* speedcontrol sync */
+        upipe_x265->sc_buffer_fill = dts_sys +
+            upipe_x265->initial_latency +
+            upipe_x265->sc_latency -
+            uclock_now(upipe_x265->uclock);
+    }
+
+    if (frame->keyframe)
+        uref_flow_set_random(uref);
+
+    if (upipe_x265->flow_def == NULL)
+        upipe_x265_build_flow_def(upipe);
+
+    upipe_x265_output(upipe, uref, upump_p);
+}
+
+/** @internal @This outputs the frames returned by the encoder thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ */
+static void upipe_x265_async_output(struct upipe *upipe,
+                                    struct upump **upump_p)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    struct upipe_x265_frame *frame;
+    while ((frame = uqueue_pop(&upipe_x265->async_done,
+                               struct upipe_x265_frame *)) != NULL) {
+        assert(upipe_x265->async_pending);
+        upipe_x265->async_pending--;
+        upipe_x265_output_frame(upipe, frame, upump_p);
+        free(frame);
+    }
+}
+
+/** @internal @This is called when the encoder thread returns frames.
+ *
+ * @param upump description structure of the watcher
+ */
+static void upipe_x265_async_worker(struct upump *upump)
+{
+    struct upipe *upipe = upump_get_opaque(upump, struct upipe *);
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    upipe_x265_async_output(upipe, &upipe_x265->upump);
+
+    bool was_buffered = !upipe_x265_check_input(upipe);
+    upipe_x265_output_input(upipe);
+    upipe_x265_unblock_input(upipe);
+    if (was_buffered && upipe_x265_check_input(upipe)) {
+        /* All packets have been output, release again the pipe that has been
+         * used in @ref upipe_x265_input. */
+        upipe_release(upipe);
+    }
+}
+
+/** @internal @This terminates the encoder thread and outputs all the frames
+ * it returned.
+ *
+ * @param upipe description structure of the pipe
+ */
+static void upipe_x265_async_drain(struct upipe *upipe)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    if (!upipe_x265->async_length)
+        return;
+    upipe_x265_async_join(upipe);
+    upipe_x265_async_output(upipe, NULL);
+    assert(!upipe_x265->async_pending);
+}
+
+/** @internal @This outputs the frames returned by the encoder thread when
+ * there is no upump manager to watch them. If the encoder thread is full,
+ * or if all pending frames are requested, it first waits for frames to be
+ * encoded, since nothing would output an input held for them.
+ *
+ * @param upipe description structure of the pipe
+ * @param upump_p reference to pump that generated the buffer
+ * @param flush true to wait for all pending frames
+ */
+static void upipe_x265_async_poll(struct upipe *upipe, struct upump **upump_p,
+                                  bool flush)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    while (upipe_x265->async_pending &&
+           (flush ||
+            upipe_x265->async_pending >= upipe_x265->async_length)) {
+        pthread_mutex_lock(&upipe_x265->async_mutex);
+        while (!uqueue_length(&upipe_x265->async_done))
+            pthread_cond_wait(&upipe_x265->async_cond,
+                              &upipe_x265->async_mutex);
+        pthread_mutex_unlock(&upipe_x265->async_mutex);
+        upipe_x265_async_output(upipe, upump_p);
+    }
+    upipe_x265_async_output(upipe, upump_p);
+}
+
+/** @internal @This starts the watcher of encoded frames if an upump manager
+ * is available, and the encoder thread if needed.
+ *
+ * @param upipe description structure of the pipe
+ * @return an error code
+ */
+static int upipe_x265_async_start(struct upipe *upipe)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    if (upipe_x265->upump == NULL && upipe_x265->upump_mgr == NULL)
+        upipe_x265_check_upump_mgr(upipe);
+    if (upipe_x265->upump == NULL && upipe_x265->upump_mgr != NULL) {
+        struct upump *upump =
+            uqueue_upump_alloc_pop(&upipe_x265->async_done,
+                                   upipe_x265->upump_mgr,
+                                   upipe_x265_async_worker, upipe,
+                                   upipe->refcount);
+        UBASE_ALLOC_RETURN(upump);
+        upipe_x265_set_upump(upipe, upump);
+        upump_start(upump);
+    }
+
+    if (!upipe_x265->async_running) {
+        if (unlikely(pthread_create(&upipe_x265->async_thread, NULL,
+                                    upipe_x265_async_run, upipe_x265) != 0))
+            return UBASE_ERR_EXTERNAL;
+        upipe_x265->async_running = true;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** @internal @This hands a picture over to the encoder thread.
+ *
+ * @param upipe description structure of the pipe
+ * @param uref picture to encode
+ * @return an error code
+ */
+static int upipe_x265_async_submit(struct upipe *upipe, struct uref *uref)
+{
+    struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
+    UBASE_RETURN(upipe_x265_async_start(upipe));
+
+    struct upipe_x265_frame *frame = malloc(sizeof (*frame));
+    UBASE_ALLOC_RETURN(frame);
+    upipe_x265_prepare_frame(upipe, frame, uref);
+
+    upipe_x265->async_pending++;
+    pthread_mutex_lock(&upipe_x265->async_mutex);
+    ulist_add(&upipe_x265->async_frames, &frame->uchain);
+    pthread_cond_broadcast(&upipe_x265->async_cond);
+    pthread_mutex_unlock(&upipe_x265->async_mutex);
+    return UBASE_ERR_NONE;
+}
+
 /** @internal @This processes pictures.
  *
  * @param upipe description structure of the pipe
@@ -914,6 +1565,12 @@ static bool upipe_x265_handle(struct upipe *upipe,
     struct upipe_x265 *upipe_x265 = upipe_x265_from_upipe(upipe);
 
     if (unlikely(uref != NULL && ubase_check(uref_flow_get_def(uref, NULL)))) {
+        /* output the frames of the previous flow first */
+        if (upipe_x265->async_pending && upipe_x265->upump == NULL)
+            upipe_x265_async_poll(upipe, upump_p, true);
+        if (upipe_x265->async_pending)
+            return false;
+
         upipe_x265->input_latency = 0;
         uref_clock_get_latency(uref, &upipe_x265->input_latency);
         upipe_x265_store_flow_def(upipe, NULL);
@@ -968,45 +1625,22 @@ err_invalid:
         return true;
     }
 
-    static const char *const chromas_list[][3] = {
-        [PIX_FMT_YUV420P]     = {"y8", "u8", "v8"},
-        [PIX_FMT_YUV422P]     = {"y8", "u8", "v8"},
-        [PIX_FMT_YUV444P]     = {"y8", "u8", "v8"},
-        [PIX_FMT_YUV420P10LE] = {"y10l", "u10l", "v10l"},
-        [PIX_FMT_YUV422P10LE] = {"y10l", "u10l", "v10l"},
-        [PIX_FMT_YUV444P10LE] = {"y10l", "u10l", "v10l"},
-        [PIX_FMT_YUV420P12LE] = {"y12l", "u12l", "v12l"},
-        [PIX_FMT_YUV422P12LE] = {"y12l", "u12l", "v12l"},
-        [PIX_FMT_YUV444P12LE] = {"y12l", "u12l", "v12l"},
-    };
-    const char * const *chromas = chromas_list[upipe_x265->pixel_format];
-    size_t width, height;
-    x265_picture pic;
-    x265_nal *nals = NULL;
-    int i, size = 0, header_size = 0;
-    uint32_t nals_num = 0;
-    struct ubuf *ubuf_block;
-    uint8_t *buf = NULL;
-    bool needopen = false;
-    int ret = 0;
-
-#if X265_BUILD >= 210 && X265_BUILD < 213
-    x265_picture *pic_out[MAX_SCALABLE_LAYERS] = { &pic };
-#else
-    x265_picture *pic_out = &pic;
-#endif
-
-    /* init x265 picture */
-    upipe_x265->api->picture_init(&upipe_x265->params, &pic);
+    struct upipe_x265_frame frame;
 
     if (upipe_x265->sc_latency &&
         likely(upipe_x265->encoder))
         speedcontrol_update(upipe);
 
     if (likely(uref)) {
-        pic.userData = uref;
-        pic.bitDepth = pixel_format_to_bit_depth(upipe_x265->pixel_format);
-        pic.colorSpace = pixel_format_to_color_space(upipe_x265->pixel_format);
+        size_t width, height;
+        bool needopen = false;
+
+        /* without a watcher, encoded frames are output from the input */
+        if (upipe_x265->async_pending && upipe_x265->upump == NULL)
+            upipe_x265_async_poll(upipe, upump_p, false);
+        if (upipe_x265->async_pending >= upipe_x265->async_length &&
+            upipe_x265->async_length)
+            return false;
 
         uref_pic_size(uref, &width, &height, NULL);
 
@@ -1014,6 +1648,12 @@ err_invalid:
         if (unlikely(!upipe_x265->encoder)) {
             needopen = true;
         } else if (unlikely(upipe_x265_need_update(upipe, width, height))) {
+            /* output the frames of the previous configuration first */
+            if (upipe_x265->async_pending && upipe_x265->upump == NULL)
+                upipe_x265_async_poll(upipe, upump_p, true);
+            if (upipe_x265->async_pending)
+                return false;
+
             x265_param *params = &upipe_x265->params;
             upipe_notice_va(upipe, "Flow parameters changed, reconfiguring encoder "
                             "(%d:%zu, %d:%zu, %d/%d/%d:%d/%d/%d, %s:%s)",
@@ -1039,191 +1679,19 @@ err_invalid:
         if (upipe_x265->flow_def_requested == NULL)
             return false;
 
-        uref_clock_get_rate(uref, &upipe_x265->drift_rate);
-        uref_clock_get_pts_prog(uref, &upipe_x265->input_pts);
-        uref_clock_get_pts_sys(uref, &upipe_x265->input_pts_sys);
-
-        pic.pts = upipe_x265->input_pts;
-
-        pic.sliceType = X265_TYPE_AUTO;
-        if (upipe_x265->slice_type_enforce) {
-            uint8_t type;
-            if (ubase_check(uref_h265_get_type(uref, &type))) {
-                switch (type) {
-                    case H265SLI_TYPE_P:
-                        pic.sliceType = X265_TYPE_P;
-                        break;
-                    case H265SLI_TYPE_B:
-                        pic.sliceType = X265_TYPE_B;
-                        break;
-                    case H265SLI_TYPE_I:
-                        pic.sliceType = upipe_x265->params.bOpenGOP ?
-                            X265_TYPE_I :
-                            X265_TYPE_IDR;
-                        break;
-                }
-            }
-        }
-
-        /* map */
-        for (i = 0; i < 3; i++) {
-            size_t stride;
-            const uint8_t *plane;
-            if (unlikely(!ubase_check(uref_pic_plane_size(uref, chromas[i], &stride,
-                                              NULL, NULL, NULL)) ||
-                         !ubase_check(uref_pic_plane_read(uref, chromas[i], 0, 0, -1, -1,
-                                              &plane)))) {
-                upipe_err_va(upipe, "Could not read origin chroma %s",
-                             chromas[i]);
-                uref_free(uref);
+        if (upipe_x265->async_length) {
+            int err = upipe_x265_async_submit(upipe, uref);
+            if (likely(ubase_check(err)))
                 return true;
-            }
-            pic.stride[i] = stride;
-            pic.planes[i] = (void *)plane;
+            upipe_warn_va(upipe, "unable to use the encoder thread (%s)",
+                          ubase_err_str(err) ?: "unknown");
+            upipe_x265_async_join(upipe);
         }
-
-        /* encode frame */
-        ret = upipe_x265->api->encoder_encode(upipe_x265->encoder,
-                                              &nals, &nals_num,
-                                              &pic, pic_out);
-
-        /* unmap */
-        for (i = 0; i < 3; i++)
-            uref_pic_plane_unmap(uref, chromas[i], 0, 0, -1, -1);
-
-        ubuf_free(uref_detach_ubuf(uref));
-
-        /* delayed frame, increase latency */
-        if (unlikely(ret == 0))
-                upipe_x265->latency_frames++;
-
-    } else {
-        /* NULL uref, flushing delayed frame */
-        ret = upipe_x265->api->encoder_encode(upipe_x265->encoder,
-                                              &nals, &nals_num,
-                                              NULL, pic_out);
-        if (ret <= 0)
-            upipe_x265->delayed_frames = false;
-    }
-
-    if (unlikely(ret < 0)) {
-        upipe_warn(upipe, "Error encoding frame");
-        uref_free(uref);
-        return true;
-    } else if (unlikely(ret == 0)) {
-        upipe_verbose(upipe, "No nal units returned");
-        return true;
     }
 
-    /* get uref back */
-    uref = pic.userData;
-    assert(uref);
-
-    for (i = 0; i < nals_num; i++) {
-        size += nals[i].sizeBytes;
-        if (nals[i].type == NAL_UNIT_VPS ||
-            nals[i].type == NAL_UNIT_SPS ||
-            nals[i].type == NAL_UNIT_PPS ||
-            nals[i].type == NAL_UNIT_ACCESS_UNIT_DELIMITER ||
-            nals[i].type == NAL_UNIT_FILLER_DATA)
-            header_size += nals[i].sizeBytes;
-    }
-
-    /* alloc ubuf, map, copy, unmap */
-    ubuf_block = ubuf_block_alloc(upipe_x265->ubuf_mgr, size);
-    if (unlikely(ubuf_block == NULL)) {
-        upipe_throw_fatal(upipe, UBASE_ERR_ALLOC);
-        return true;
-    }
-    ubuf_block_write(ubuf_block, 0, &size, &buf);
-    memcpy(buf, nals[0].payload, size);
-    ubuf_block_unmap(ubuf_block, 0);
-    uref_attach_ubuf(uref, ubuf_block);
-    uref_block_set_header_size(uref, header_size);
-
-    /* NAL offsets */
-    uint64_t offset = 0;
-    for (i = 0; i < nals_num - 1; i++) {
-        offset += nals[i].sizeBytes;
-        uref_h26x_set_nal_offset(uref, offset, i);
-    }
-
-    /* optionally convert NAL encapsulation */
-    enum uref_h26x_encaps encaps = upipe_x265->params.bAnnexB ?
-        UREF_H26X_ENCAPS_ANNEXB : UREF_H26X_ENCAPS_LENGTH4;
-    /* no need for annex B header because if annexb is requested, there
-     * will be no conversion */
-    int err = upipe_h26xf_convert_frame(uref,
-                                        encaps,
-                                        upipe_x265->encaps_requested,
-                                        upipe_x265->ubuf_mgr,
-                                        NULL);
-    if (!ubase_check(err)) {
-        upipe_warn(upipe, "invalid NAL encapsulation conversion");
-        upipe_throw_error(upipe, err);
-    }
-
-    /* set dts */
-    uint64_t dts_pts_delay = pic.pts - pic.dts;
-    uref_clock_set_dts_pts_delay(uref, dts_pts_delay);
-    uref_clock_delete_cr_dts_delay(uref);
-
-    /* rebase to dts as we're in encoded domain now */
-    uint64_t dts = UINT64_MAX;
-    if ((!ubase_check(uref_clock_get_dts_prog(uref, &dts)) ||
-         dts < upipe_x265->last_dts) &&
-        upipe_x265->last_dts != UINT64_MAX) {
-        upipe_warn_va(upipe, "DTS prog in the past, resetting (%"PRIu64" ms)",
-                      (upipe_x265->last_dts - dts) * 1000 / UCLOCK_FREQ);
-        dts = upipe_x265->last_dts + 1;
-        uref_clock_set_dts_prog(uref, dts);
-    } else
-        uref_clock_rebase_dts_prog(uref);
-
-    uint64_t dts_sys = UINT64_MAX;
-    if (dts != UINT64_MAX &&
-        upipe_x265->input_pts != UINT64_MAX &&
-        upipe_x265->input_pts_sys != UINT64_MAX) {
-        dts_sys = (int64_t)upipe_x265->input_pts_sys +
-            ((int64_t)dts - (int64_t)upipe_x265->input_pts) *
-            (int64_t)upipe_x265->drift_rate.num /
-            (int64_t)upipe_x265->drift_rate.den;
-        uref_clock_set_dts_sys(uref, dts_sys);
-    } else if (!ubase_check(uref_clock_get_dts_sys(uref, &dts_sys)) ||
-        (upipe_x265->last_dts_sys != UINT64_MAX &&
-               dts_sys < upipe_x265->last_dts_sys)) {
-        upipe_warn_va(upipe,
-                      "DTS sys in the past, resetting (%"PRIu64" ms)",
-                      (upipe_x265->last_dts_sys - dts_sys) * 1000 /
-                      UCLOCK_FREQ);
-        dts_sys = upipe_x265->last_dts_sys + 1;
-        uref_clock_set_dts_sys(uref, dts_sys);
-    } else
-        uref_clock_rebase_dts_sys(uref);
-
-    uref_clock_rebase_dts_orig(uref);
-    uref_clock_set_rate(uref, upipe_x265->drift_rate);
-
-    upipe_x265->last_dts = dts;
-    upipe_x265->last_dts_sys = dts_sys;
-
-    if (dts_sys != UINT64_MAX &&
-        upipe_x265->uclock != NULL &&
-        upipe_x265->sc_latency) {
-        /* speedcontrol sync */
-        upipe_x265->sc_buffer_fill = dts_sys +
-            upipe_x265->initial_latency +
-            upipe_x265->sc_latency -
-            uclock_now(upipe_x265->uclock);
-    }
-
-    if (IS_X265_TYPE_I(pic.sliceType))
-        uref_flow_set_random(uref);
-
-    if (upipe_x265->flow_def == NULL)
-        upipe_x265_build_flow_def(upipe);
-
-    upipe_x265_output(upipe, uref, upump_p);
+    upipe_x265_prepare_frame(upipe, &frame, uref);
+    upipe_x265_encode_frame(upipe_x265, &frame);
+    upipe_x265_output_frame(upipe, &frame, upump_p);
     return true;
 }
 
@@ -1261,6 +1729,9 @@ static int upipe_x265_check_flow_format(struct upipe *upipe,
     if (flow_format == NULL)
         return UBASE_ERR_INVALID;
 
+    /* output the frames of the previous flow format first */
+    upipe_x265_async_drain(upipe);
+
     upipe_x265->headers_requested =
         ubase_check(uref_flow_get_global(flow_format));
     upipe_x265->encaps_requested = uref_h26x_flow_infer_encaps(flow_format);
@@ -1443,6 +1914,13 @@ static int upipe_x265_control(struct upipe *upipe, int command, va_list args)
         case UPIPE_ATTACH_UCLOCK:
             upipe_x265_require_uclock(upipe);
             return UBASE_ERR_NONE;
+        case UPIPE_ATTACH_UPUMP_MGR:
+            upipe_x265_set_upump(upipe, NULL);
+            UBASE_RETURN(upipe_x265_attach_upump_mgr(upipe));
+            if (upipe_x265->async_pending)
+                /* watch the frames still in the encoder thread */
+                return upipe_x265_async_start(upipe);
+            return UBASE_ERR_NONE;
         case UPIPE_REGISTER_REQUEST: {
             struct urequest *request = va_arg(args, struct urequest *);
             if (request->type == UREQUEST_UBUF_MGR)
@@ -1555,6 +2033,11 @@ static int upipe_x265_control(struct upipe *upipe, int command, va_list args)
             bool enforce = va_arg(args, int);
             return _upipe_x265_set_slice_type_enforce(upipe, enforce);
         }
+        case UPIPE_X265_SET_ASYNC: {
+            UBASE_SIGNATURE_CHECK(args, UPIPE_X265_SIGNATURE)
+            unsigned int queue_length = va_arg(args, unsigned int);
+            return _upipe_x265_set_async(upipe, queue_length);
+        }
         default:
             return UBASE_ERR_UNHANDLED;
     }
@@ -1592,6 +2075,14 @@ static void upipe_x265_free(struct upipe *upipe)
     free(upipe_x265->tune);
     free(upipe_x265->profile);
     upipe_throw_dead(upipe);
+    upipe_x265_clean_upump(upipe);
+    upipe_x265_clean_upump_mgr(upipe);
+    if (upipe_x265->async_done_extra != NULL) {
+        uqueue_clean(&upipe_x265->async_done);
+        free(upipe_x265->async_done_extra);
+    }
+    pthread_cond_destroy(&upipe_x265->async_cond);
+    pthread_mutex_destroy(&upipe_x265->async_mutex);
     upipe_x265_clean_uclock(upipe);
     upipe_x265_clean_ubuf_mgr(upipe);
     upipe_x265_clean_input(upipe);
@@ -38,7 +38,9 @@ libupipe-includes = \
     ulog.h \
     umem.h \
     umem_alloc.h \
+    umem_huge.h \
     umem_pool.h \
+    umpmc.h \
     umutex.h \
     upipe.h \
     upipe_dump.h \
@@ -120,6 +122,7 @@ libupipe-includes = \
     urefcount_helper.h \
     urequest.h \
     uring.h \
+    ustats.h \
     ustring.h \
     utrace.h \
     uuri.h
@@ -138,6 +141,7 @@ libupipe-src = \
     ucookie.c \
     udict_inline.c \
     umem_alloc.c \
+    umem_huge.c \
     umem_pool.c \
     upipe_dump.c \
     uprobe.c \
@@ -159,6 +163,7 @@ libupipe-src = \
     uref_pic_flow.c \
     uref_std.c \
     uref_uri.c \
+    ustats.c \
     ustring.c \
     utrace.c \
     uuri.c
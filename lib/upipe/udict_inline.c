@@ -22,6 +22,7 @@
 #include "upipe/udict_inline.h"
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <assert.h>
 
 /** define to activate statistics */
@@ -30,6 +31,10 @@
 #define UDICT_MIN_SIZE 128
 /** default extra space added on udict expansion */
 #define UDICT_EXTRA_SIZE 64
+/** number of named attributes walked before a hash index is built */
+#define UDICT_INDEX_THRESHOLD 8
+/** minimal number of slots of the hash index */
+#define UDICT_INDEX_MIN_SIZE 32
 
 /** @internal @This represents a shorthand attribute type. */
 struct inline_shorthand {
@@ -87,6 +92,14 @@ static const struct inline_shorthand inline_shorthands[] = {
     { "p.afd", UDICT_TYPE_SMALL_UNSIGNED },
     { "p.cea_708", UDICT_TYPE_OPAQUE },
     { "p.bar_data", UDICT_TYPE_OPAQUE },
+
+    { "f.global", UDICT_TYPE_VOID },
+    { "f.headers", UDICT_TYPE_OPAQUE },
+    { "f.name", UDICT_TYPE_STRING },
+    { "f.comp", UDICT_TYPE_VOID },
+    { "b.header", UDICT_TYPE_UNSIGNED },
+    { "k.index_rap", UDICT_TYPE_SMALL_UNSIGNED },
+    { "p.original_height", UDICT_TYPE_UNSIGNED },
 };
 
 /** @This stores the size of the value of basic attribute types. */
@@ -126,6 +139,15 @@ struct udict_inline {
     /** used size */
     size_t size;
 
+    /** hash index of named attributes (offset + 1, 0 if empty), or NULL */
+    uint32_t *index;
+    /** number of allocated slots in the index (power of 2) */
+    size_t index_size;
+    /** number of named attributes in the index */
+    size_t index_used;
+    /** true if the index reflects the attributes */
+    bool index_valid;
+
     /** common structure */
     struct udict udict;
 };
@@ -155,6 +177,7 @@ static struct udict *udict_inline_alloc(struct udict_mgr *mgr, size_t size)
     uint8_t *buffer = umem_buffer(&inl->umem);
     buffer[0] = UDICT_TYPE_END;
     inl->size = 1;
+    inl->index_valid = false;
 
     return udict;
 }
@@ -190,8 +213,8 @@ static int udict_inline_dup(struct udict *udict, struct udict **new_udict_p)
 static const struct inline_shorthand *
     udict_inline_shorthand(enum udict_type type)
 {
-    if (unlikely(type > UDICT_TYPE_SHORTHAND + 1 + sizeof(inline_shorthands) /
-                                               sizeof(struct inline_shorthand)))
+    if (unlikely(type >= UDICT_TYPE_SHORTHAND + 1 + sizeof(inline_shorthands) /
+                                                sizeof(struct inline_shorthand)))
         return NULL;
     return &inline_shorthands[type - UDICT_TYPE_SHORTHAND - 1];
 }
@@ -220,9 +243,105 @@ static uint8_t *udict_inline_next(uint8_t *attr)
     return attr + 3 + size;
 }
 
+/** @internal @This hashes the name and type of a named attribute.
+ *
+ * @param name name of the attribute
+ * @param type type of the attribute
+ * @return hash value
+ */
+static inline uint32_t udict_inline_hash(const char *name,
+                                         enum udict_type type)
+{
+    /* FNV-1a */
+    uint32_t hash = UINT32_C(2166136261) ^ type;
+    while (*name)
+        hash = (hash ^ (uint8_t)*name++) * UINT32_C(16777619);
+    return hash;
+}
+
+/** @internal @This inserts a named attribute in the hash index, which must
+ * have free slots.
+ *
+ * @param inl pointer to the udict_inline
+ * @param attr pointer to the attribute
+ */
+static void udict_inline_index_insert(struct udict_inline *inl, uint8_t *attr)
+{
+    size_t mask = inl->index_size - 1;
+    size_t i = udict_inline_hash((const char *)(attr + 3), *attr) & mask;
+    while (inl->index[i])
+        i = (i + 1) & mask;
+    inl->index[i] = attr - umem_buffer(&inl->umem) + 1;
+    inl->index_used++;
+}
+
+/** @internal @This builds the hash index of named attributes.
+ *
+ * @param inl pointer to the udict_inline
+ * @return false in case of allocation error
+ */
+static bool udict_inline_index_build(struct udict_inline *inl)
+{
+    size_t nb_named = 0;
+    uint8_t *attr = umem_buffer(&inl->umem);
+    while (attr != NULL && *attr != UDICT_TYPE_END) {
+        if (*attr < UDICT_TYPE_SHORTHAND)
+            nb_named++;
+        attr = udict_inline_next(attr);
+    }
+
+    size_t index_size = UDICT_INDEX_MIN_SIZE;
+    while (index_size < nb_named * 2)
+        index_size *= 2;
+    if (index_size > inl->index_size) {
+        uint32_t *index = realloc(inl->index, index_size * sizeof(uint32_t));
+        if (unlikely(index == NULL))
+            return false;
+        inl->index = index;
+        inl->index_size = index_size;
+    }
+    memset(inl->index, 0, inl->index_size * sizeof(uint32_t));
+    inl->index_used = 0;
+
+    attr = umem_buffer(&inl->umem);
+    while (attr != NULL && *attr != UDICT_TYPE_END) {
+        if (*attr < UDICT_TYPE_SHORTHAND)
+            udict_inline_index_insert(inl, attr);
+        attr = udict_inline_next(attr);
+    }
+    inl->index_valid = true;
+    return true;
+}
+
+/** @internal @This looks up a named attribute in the hash index.
+ *
+ * @param inl pointer to the udict_inline
+ * @param name name of the attribute
+ * @param type type of the attribute
+ * @return pointer to the attribute, or NULL
+ */
+static uint8_t *udict_inline_index_find(struct udict_inline *inl,
+                                        const char *name,
+                                        enum udict_type type)
+{
+    uint8_t *buffer = umem_buffer(&inl->umem);
+    size_t mask = inl->index_size - 1;
+    size_t i = udict_inline_hash(name, type) & mask;
+    while (inl->index[i]) {
+        uint8_t *attr = buffer + inl->index[i] - 1;
+        if (*attr == type && !strcmp((const char *)(attr + 3), name))
+            return attr;
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
 /** @internal @This finds an attribute (shorthand or not) of the given name
  * and type and returns a pointer to its beginning.
  *
+ * Named attributes are looked up in a hash index, which is lazily built
+ * once a lookup has walked past a given number of named attributes.
+ *
  * @param udict pointer to the udict
  * @param name name of the attribute
  * @param type type of the attribute (excluding inline_shorthands)
@@ -239,15 +358,25 @@ static uint8_t *udict_inline_find(struct udict *udict, const char *name,
         inline_mgr->stats[type - UDICT_TYPE_SHORTHAND - 1]++;
     }
 #endif
+    bool named = type < UDICT_TYPE_SHORTHAND && type != UDICT_TYPE_END;
+    if (named && inl->index_valid)
+        return udict_inline_index_find(inl, name, type);
+
+    size_t nb_named = 0;
     uint8_t *attr = umem_buffer(&inl->umem);
     while (attr != NULL) {
         if (*attr == type &&
              (type > UDICT_TYPE_SHORTHAND || type == UDICT_TYPE_END ||
               !strcmp((const char *)(attr + 3), name)))
-            return attr;
+            break;
+        if (*attr < UDICT_TYPE_SHORTHAND && *attr != UDICT_TYPE_END)
+            nb_named++;
         attr = udict_inline_next(attr);
     }
-    return NULL;
+
+    if (named && nb_named >= UDICT_INDEX_THRESHOLD)
+        udict_inline_index_build(inl);
+    return attr;
 }
 
 /** @internal @This finds an attribute (shorthand or not) of the given name
@@ -368,6 +497,8 @@ static int udict_inline_delete(struct udict *udict, const char *name,
     uint8_t *end = udict_inline_next(attr);
     memmove(attr, end, umem_buffer(&inl->umem) + inl->size - end);
     inl->size -= end - attr;
+    /* the offsets of the following attributes have changed */
+    inl->index_valid = false;
     return UBASE_ERR_NONE;
 }
 
@@ -442,6 +573,12 @@ static int udict_inline_set(struct udict *udict, const char *name,
         *attr++ = size >> 8;
         *attr++ = size & 0xff;
         memcpy(attr, name, namelen + 1);
+        if (inl->index_valid) {
+            if (unlikely((inl->index_used + 1) * 2 > inl->index_size))
+                inl->index_valid = false;
+            else
+                udict_inline_index_insert(inl, attr - 3);
+        }
         attr += namelen + 1;
    } else if (shorthand->base_type == UDICT_TYPE_OPAQUE ||
               shorthand->base_type == UDICT_TYPE_STRING) {
@@ -560,6 +697,9 @@ static void *udict_inline_alloc_inner(struct upool *upool)
         return NULL;
     struct udict *udict = udict_inline_to_udict(inl);
     udict->mgr = udict_inline_mgr_to_udict_mgr(inline_mgr);
+    inl->index = NULL;
+    inl->index_size = 0;
+    inl->index_valid = false;
     return inl;
 }
 
@@ -568,8 +708,10 @@ static void *udict_inline_alloc_inner(struct upool *upool)
  * @param upool pointer to upool
  * @param inl pointer to a udict_inline structure to free
  */
-static void udict_inline_free_inner(struct upool *upool, void *inl)
+static void udict_inline_free_inner(struct upool *upool, void *_inl)
 {
+    struct udict_inline *inl = (struct udict_inline *)_inl;
+    free(inl->index);
     free(inl);
 }
 
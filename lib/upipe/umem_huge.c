@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include "upipe/ubase.h"
+#include "upipe/urefcount.h"
+#include "upipe/ulifo.h"
+#include "upipe/uatomic.h"
+#include "upipe/umutex.h"
+#include "upipe/umem.h"
+#include "upipe/umem_huge.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_MBIND
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+/** size of a huge page, to which arenas are aligned */
+#define UMEM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+/** maximum number of NUMA nodes */
+#define UMEM_HUGE_MAX_NODES 1024
+/** number of bits in a NUMA node mask word */
+#define UMEM_HUGE_LONG_BITS (8 * sizeof(unsigned long))
+
+/** @This defines a pool of buffers of the same size. */
+struct umem_huge_pool {
+    /** buffers kept in the pool */
+    struct ulifo lifo;
+    /** maximum number of buffers kept in the pool */
+    unsigned int depth;
+    /** number of buffers currently in the pool */
+    uatomic_uint32_t nb;
+    /** highest number of buffers kept in the pool */
+    uatomic_uint32_t high_water;
+    /** number of allocations served by the pool */
+    uatomic_uint32_t hits;
+    /** number of allocations carved out of an arena or allocated by
+     * malloc() */
+    uatomic_uint32_t misses;
+    /** number of buffers lost because the pool was full */
+    uatomic_uint32_t overflows;
+};
+
+/** @This defines the private data structures of the umem huge manager. */
+struct umem_huge_mgr {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** common management structure */
+    struct umem_mgr mgr;
+
+    /** mutual exclusion primitives to access the arenas */
+    struct umutex *mutex;
+    /** NUMA node to bind the arenas to, or -1 */
+    int numa_node;
+    /** size (in octets) of an arena */
+    size_t arena_size;
+    /** maximum number of arenas */
+    unsigned int nb_arenas;
+    /** number of mapped arenas */
+    uatomic_uint32_t nb_mapped;
+    /** first free octet in the last arena */
+    size_t offset;
+    /** mapped arenas */
+    uint8_t **arenas;
+
+    /** number of pools of buffers */
+    size_t nb_pools;
+    /** buffer pools */
+    struct umem_huge_pool pools[];
+};
+
+UBASE_FROM_TO(umem_huge_mgr, umem_mgr, umem_mgr, mgr)
+UBASE_FROM_TO(umem_huge_mgr, urefcount, urefcount, urefcount)
+
+/** @internal @This returns the nearest bigger size to allocate for a umem of
+ * the given size to fit into and returns the index of the appropriate pool.
+ *
+ * @param huge_mgr description structure of the umem mgr
+ * @param wanted desired size of the umem
+ * @param real_p reference written with the actual size of the future buffer
+ * @return index of the pool in which to find appropriate buffers
+ */
+static unsigned int umem_huge_find(struct umem_huge_mgr *huge_mgr,
+                                   size_t wanted, size_t *real_p)
+{
+    unsigned int pool;
+
+    if (wanted < UMEM_HUGE_POOL0_SIZE)
+        pool = huge_mgr->nb_pools;
+    else
+        for (pool = 0; pool < huge_mgr->nb_pools; pool++)
+            if (wanted <= ((size_t)UMEM_HUGE_POOL0_SIZE << pool))
+                break;
+    if (likely(real_p != NULL))
+        *real_p = pool < huge_mgr->nb_pools ?
+                  (size_t)UMEM_HUGE_POOL0_SIZE << pool : wanted;
+    return pool;
+}
+
+/** @internal @This maps a new arena, aligned on huge pages.
+ *
+ * @param huge_mgr description structure of the umem mgr
+ * @return pointer to the arena, or NULL in case of error
+ */
+static uint8_t *umem_huge_map(struct umem_huge_mgr *huge_mgr)
+{
+    size_t size = huge_mgr->arena_size;
+    uint8_t *arena = MAP_FAILED;
+
+#ifdef HAVE_HUGETLB
+    /* explicit huge pages, only available if some are reserved */
+    arena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (arena == MAP_FAILED) {
+        /* over-allocate to align the arena for transparent huge pages */
+        uint8_t *map = mmap(NULL, size + UMEM_HUGE_PAGE_SIZE,
+                            PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (unlikely(map == MAP_FAILED))
+            return NULL;
+
+        arena = (uint8_t *)(((uintptr_t)map + UMEM_HUGE_PAGE_SIZE - 1) &
+                            ~(uintptr_t)(UMEM_HUGE_PAGE_SIZE - 1));
+        if (arena > map)
+            munmap(map, arena - map);
+        munmap(arena + size, map + UMEM_HUGE_PAGE_SIZE - arena);
+#ifdef MADV_HUGEPAGE
+        madvise(arena, size, MADV_HUGEPAGE);
+#endif
+    }
+
+#ifdef HAVE_MBIND
+    if (huge_mgr->numa_node >= 0) {
+        /* pages are not touched yet, so they will be allocated on the node;
+         * binding is best effort on kernels without NUMA support */
+        unsigned long nodemask[UMEM_HUGE_MAX_NODES / UMEM_HUGE_LONG_BITS];
+        memset(nodemask, 0, sizeof(nodemask));
+        nodemask[huge_mgr->numa_node / UMEM_HUGE_LONG_BITS] =
+            1UL << (huge_mgr->numa_node % UMEM_HUGE_LONG_BITS);
+        syscall(SYS_mbind, arena, size, MPOL_BIND, nodemask,
+                8 * sizeof(nodemask) + 1, 0);
+    }
+#endif
+    return arena;
+}
+
+/** @internal @This carves a buffer out of the arenas.
+ *
+ * @param huge_mgr description structure of the umem mgr
+ * @param size size of the buffer
+ * @return pointer to buffer, or NULL if the arenas are exhausted
+ */
+static uint8_t *umem_huge_carve(struct umem_huge_mgr *huge_mgr, size_t size)
+{
+    uint8_t *buffer = NULL;
+    umutex_lock(huge_mgr->mutex);
+
+    uint32_t nb_mapped = uatomic_load(&huge_mgr->nb_mapped);
+    if (nb_mapped && huge_mgr->offset + size <= huge_mgr->arena_size) {
+        buffer = huge_mgr->arenas[nb_mapped - 1] + huge_mgr->offset;
+        huge_mgr->offset += size;
+    } else if (nb_mapped < huge_mgr->nb_arenas) {
+        uint8_t *arena = umem_huge_map(huge_mgr);
+        if (likely(arena != NULL)) {
+            huge_mgr->arenas[nb_mapped] = arena;
+            uatomic_store(&huge_mgr->nb_mapped, nb_mapped + 1);
+            buffer = arena;
+            huge_mgr->offset = size;
+        }
+    }
+
+    umutex_unlock(huge_mgr->mutex);
+    return buffer;
+}
+
+/** @internal @This checks if a buffer was carved out of an arena.
+ *
+ * @param huge_mgr description structure of the umem mgr
+ * @param buffer pointer to buffer
+ * @return true if the buffer belongs to an arena
+ */
+static bool umem_huge_carved(struct umem_huge_mgr *huge_mgr, uint8_t *buffer)
+{
+    uint32_t nb_mapped = uatomic_load(&huge_mgr->nb_mapped);
+    for (uint32_t i = 0; i < nb_mapped; i++)
+        if (buffer >= huge_mgr->arenas[i] &&
+            buffer < huge_mgr->arenas[i] + huge_mgr->arena_size)
+            return true;
+    return false;
+}
+
+/** @This allocates a new umem buffer space.
+ *
+ * @param mgr management structure
+ * @param umem caller-allocated structure, filled in with the required pointer
+ * and size (previous content is discarded)
+ * @param size requested size of the umem
+ * @return false if the memory couldn't be allocated (umem left untouched)
+ */
+static bool umem_huge_alloc(struct umem_mgr *mgr, struct umem *umem,
+                            size_t size)
+{
+    struct umem_huge_mgr *huge_mgr = umem_huge_mgr_from_umem_mgr(mgr);
+    size_t real_size;
+    unsigned int pool = umem_huge_find(huge_mgr, size, &real_size);
+    uint8_t *buffer = NULL;
+
+    if (likely(pool < huge_mgr->nb_pools)) {
+        struct umem_huge_pool *huge_pool = &huge_mgr->pools[pool];
+        buffer = ulifo_pop(&huge_pool->lifo, uint8_t *);
+        if (likely(buffer != NULL)) {
+            uatomic_fetch_sub(&huge_pool->nb, 1);
+            uatomic_fetch_add(&huge_pool->hits, 1);
+        } else {
+            uatomic_fetch_add(&huge_pool->misses, 1);
+            buffer = umem_huge_carve(huge_mgr, real_size);
+        }
+    }
+    if (unlikely(buffer == NULL))
+        buffer = malloc(real_size);
+    if (unlikely(buffer == NULL))
+        return false;
+
+    umem->buffer = buffer;
+    umem->size = size;
+    umem->real_size = real_size;
+    umem->mgr = mgr;
+    return true;
+}
+
+/** @This frees a umem.
+ *
+ * @param umem pointer to umem
+ */
+static void umem_huge_free(struct umem *umem)
+{
+    struct umem_huge_mgr *huge_mgr = umem_huge_mgr_from_umem_mgr(umem->mgr);
+
+    if (!umem_huge_carved(huge_mgr, umem->buffer))
+        free(umem->buffer);
+    else {
+        unsigned int pool = umem_huge_find(huge_mgr, umem->real_size, NULL);
+        struct umem_huge_pool *huge_pool = &huge_mgr->pools[pool];
+        if (likely(ulifo_push(&huge_pool->lifo, umem->buffer))) {
+            /* nb may transiently wrap around if a concurrent pop is
+             * accounted before this push */
+            uint32_t nb = uatomic_fetch_add(&huge_pool->nb, 1) + 1;
+            uint32_t high_water = uatomic_load(&huge_pool->high_water);
+            while (unlikely(nb > high_water) && nb <= huge_pool->depth &&
+                   !uatomic_compare_exchange(&huge_pool->high_water,
+                                             &high_water, nb));
+        } else
+            /* the buffer is lost until the manager is freed */
+            uatomic_fetch_add(&huge_pool->overflows, 1);
+    }
+    umem->buffer = NULL;
+    umem->mgr = NULL;
+}
+
+/** @This resizes a umem. Buffers carved out of arenas are never resized in
+ * place.
+ *
+ * @param umem caller-allocated structure, previously successfully passed to
+ * @ref umem_alloc, and filled in with the new pointer and size
+ * @param new_size new requested size of the umem
+ * @return false if the memory couldn't be allocated (umem left untouched)
+ */
+static bool umem_huge_realloc(struct umem *umem, size_t new_size)
+{
+    if (likely(new_size <= umem->real_size)) {
+        umem->size = new_size;
+        return true;
+    }
+
+    struct umem new_umem;
+    if (!umem_huge_alloc(umem->mgr, &new_umem, new_size))
+        return false;
+    memcpy(new_umem.buffer, umem->buffer, umem->size);
+    umem_huge_free(umem);
+    *umem = new_umem;
+    return true;
+}
+
+/** @This returns the statistics of a pool.
+ *
+ * @param mgr pointer to umem manager
+ * @param pool index of the pool
+ * @param stats filled in with the statistics of the pool
+ * @return an error code
+ */
+static int umem_huge_mgr_get_stats(struct umem_mgr *mgr, unsigned int pool,
+                                   struct umem_mgr_stats *stats)
+{
+    struct umem_huge_mgr *huge_mgr = umem_huge_mgr_from_umem_mgr(mgr);
+    if (pool >= huge_mgr->nb_pools)
+        return UBASE_ERR_INVALID;
+
+    struct umem_huge_pool *huge_pool = &huge_mgr->pools[pool];
+    stats->size = (size_t)UMEM_HUGE_POOL0_SIZE << pool;
+    stats->depth = huge_pool->depth;
+    stats->hits = uatomic_load(&huge_pool->hits);
+    stats->misses = uatomic_load(&huge_pool->misses);
+    stats->overflows = uatomic_load(&huge_pool->overflows);
+    stats->high_water = uatomic_load(&huge_pool->high_water);
+    return UBASE_ERR_NONE;
+}
+
+/** @This processes control commands on a umem huge manager.
+ *
+ * @param mgr pointer to umem manager
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int umem_huge_mgr_control(struct umem_mgr *mgr,
+                                 int command, va_list args)
+{
+    switch (command) {
+        case UMEM_MGR_GET_STATS: {
+            unsigned int pool = va_arg(args, unsigned int);
+            struct umem_mgr_stats *stats = va_arg(args,
+                                                  struct umem_mgr_stats *);
+            return umem_huge_mgr_get_stats(mgr, pool, stats);
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @This frees a umem manager.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static void umem_huge_mgr_free(struct urefcount *urefcount)
+{
+    struct umem_huge_mgr *huge_mgr = umem_huge_mgr_from_urefcount(urefcount);
+
+    for (unsigned int i = 0; i < huge_mgr->nb_pools; i++) {
+        struct umem_huge_pool *huge_pool = &huge_mgr->pools[i];
+        while (ulifo_pop(&huge_pool->lifo, uint8_t *) != NULL);
+        ulifo_clean(&huge_pool->lifo);
+        uatomic_clean(&huge_pool->nb);
+        uatomic_clean(&huge_pool->high_water);
+        uatomic_clean(&huge_pool->hits);
+        uatomic_clean(&huge_pool->misses);
+        uatomic_clean(&huge_pool->overflows);
+    }
+
+    uint32_t nb_mapped = uatomic_load(&huge_mgr->nb_mapped);
+    for (uint32_t i = 0; i < nb_mapped; i++)
+        munmap(huge_mgr->arenas[i], huge_mgr->arena_size);
+    uatomic_clean(&huge_mgr->nb_mapped);
+    umutex_release(huge_mgr->mutex);
+
+    urefcount_clean(urefcount);
+    free(huge_mgr);
+}
+
+/** @This allocates a new instance of the umem huge page manager.
+ *
+ * @param arena_size size (in octets) of an arena, rounded up to a power of 2
+ * and to the huge page size
+ * @param nb_arenas maximum number of arenas to map
+ * @param numa_node NUMA node to bind the arenas to, or -1
+ * @param mutex mutual exclusion primitives to access the arenas, or NULL if
+ * the manager is only used by a single thread
+ * @return pointer to manager, or NULL in case of error
+ */
+struct umem_mgr *umem_huge_mgr_alloc(size_t arena_size, unsigned int nb_arenas,
+                                     int numa_node, struct umutex *mutex)
+{
+    if (unlikely(!nb_arenas || numa_node >= UMEM_HUGE_MAX_NODES))
+        return NULL;
+
+    size_t size = UMEM_HUGE_PAGE_SIZE;
+    while (size < arena_size)
+        size <<= 1;
+    arena_size = size;
+
+    size_t nb_pools = 1;
+    while (((size_t)UMEM_HUGE_POOL0_SIZE << (nb_pools - 1)) < arena_size)
+        nb_pools++;
+
+    size_t alloc_size = sizeof(struct umem_huge_mgr) +
+                        sizeof(struct umem_huge_pool) * nb_pools +
+                        sizeof(uint8_t *) * nb_arenas;
+    unsigned int pools_depths[nb_pools];
+    for (unsigned int i = 0; i < nb_pools; i++) {
+        /* enough to keep all the buffers that fit in the arenas */
+        size_t depth = (arena_size >> i) / UMEM_HUGE_POOL0_SIZE * nb_arenas;
+        pools_depths[i] = depth > UINT16_MAX ? UINT16_MAX : depth;
+        alloc_size += ulifo_sizeof(pools_depths[i]);
+    }
+
+    struct umem_huge_mgr *huge_mgr = malloc(alloc_size);
+    if (unlikely(huge_mgr == NULL))
+        return NULL;
+
+    huge_mgr->mutex = umutex_use(mutex);
+    huge_mgr->numa_node = numa_node;
+    huge_mgr->arena_size = arena_size;
+    huge_mgr->nb_arenas = nb_arenas;
+    uatomic_init(&huge_mgr->nb_mapped, 0);
+    huge_mgr->offset = 0;
+    huge_mgr->nb_pools = nb_pools;
+
+    void *extra = (void *)huge_mgr + sizeof(struct umem_huge_mgr) +
+                  sizeof(struct umem_huge_pool) * nb_pools;
+    huge_mgr->arenas = extra;
+    extra += sizeof(uint8_t *) * nb_arenas;
+
+    for (unsigned int i = 0; i < nb_pools; i++) {
+        struct umem_huge_pool *huge_pool = &huge_mgr->pools[i];
+        ulifo_init(&huge_pool->lifo, pools_depths[i], extra);
+        extra += ulifo_sizeof(pools_depths[i]);
+        huge_pool->depth = pools_depths[i];
+        uatomic_init(&huge_pool->nb, 0);
+        uatomic_init(&huge_pool->high_water, 0);
+        uatomic_init(&huge_pool->hits, 0);
+        uatomic_init(&huge_pool->misses, 0);
+        uatomic_init(&huge_pool->overflows, 0);
+    }
+
+    urefcount_init(umem_huge_mgr_to_urefcount(huge_mgr), umem_huge_mgr_free);
+    huge_mgr->mgr.refcount = umem_huge_mgr_to_urefcount(huge_mgr);
+    huge_mgr->mgr.umem_alloc = umem_huge_alloc;
+    huge_mgr->mgr.umem_realloc = umem_huge_realloc;
+    huge_mgr->mgr.umem_free = umem_huge_free;
+    huge_mgr->mgr.umem_mgr_vacuum = NULL;
+    huge_mgr->mgr.umem_mgr_control = umem_huge_mgr_control;
+
+    return umem_huge_mgr_to_umem_mgr(huge_mgr);
+}
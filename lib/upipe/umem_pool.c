@@ -9,6 +9,7 @@
 #include "upipe/ubase.h"
 #include "upipe/urefcount.h"
 #include "upipe/ulifo.h"
+#include "upipe/uatomic.h"
 #include "upipe/umem.h"
 #include "upipe/umem_pool.h"
 
@@ -16,6 +17,30 @@
 #include <stdbool.h>
 #include <assert.h>
 
+/** @This defines a pool of buffers of the same size. */
+struct umem_pool {
+    /** buffers kept in the pool */
+    struct ulifo lifo;
+    /** maximum number of buffers kept in the pool */
+    unsigned int depth;
+
+    /* statistics are updated with a single relaxed operation per
+     * allocation or release; the number of buffers in the pool is derived
+     * from them */
+    /** number of buffers released to the pool */
+    uatomic_uint32_t pushes;
+    /** number of allocations served by the pool */
+    uatomic_uint32_t hits;
+    /** number of buffers freed by @ref umem_pool_mgr_vacuum */
+    uatomic_uint32_t vacuums;
+    /** number of allocations that fell back to malloc() */
+    uatomic_uint32_t misses;
+    /** number of buffers released because the pool was full */
+    uatomic_uint32_t overflows;
+    /** highest number of buffers kept in the pool */
+    uatomic_uint32_t high_water;
+};
+
 /** @This defines the private data structures of the umem pool manager. */
 struct umem_pool_mgr {
     /** refcount management structure */
@@ -29,7 +54,7 @@ struct umem_pool_mgr {
     /** number of pools of buffers */
     size_t nb_pools;
     /** buffer pools */
-    struct ulifo pools[];
+    struct umem_pool pools[];
 };
 
 UBASE_FROM_TO(umem_pool_mgr, umem_mgr, umem_mgr, mgr)
@@ -74,8 +99,14 @@ static bool umem_pool_alloc(struct umem_mgr *mgr, struct umem *umem,
     unsigned int pool = umem_pool_find(mgr, size, &real_size);
     uint8_t *buffer = NULL;
 
-    if (likely(pool < pool_mgr->nb_pools))
-        buffer = ulifo_pop(&pool_mgr->pools[pool], uint8_t *);
+    if (likely(pool < pool_mgr->nb_pools)) {
+        struct umem_pool *umem_pool = &pool_mgr->pools[pool];
+        buffer = ulifo_pop(&umem_pool->lifo, uint8_t *);
+        if (likely(buffer != NULL))
+            uatomic_fetch_add_relaxed(&umem_pool->hits, 1);
+        else
+            uatomic_fetch_add_relaxed(&umem_pool->misses, 1);
+    }
     if (unlikely(buffer == NULL))
         buffer = malloc(real_size);
     if (unlikely(buffer == NULL))
@@ -100,9 +131,25 @@ static void umem_pool_free(struct umem *umem)
     struct umem_pool_mgr *pool_mgr = umem_pool_mgr_from_umem_mgr(umem->mgr);
     unsigned int pool = umem_pool_find(umem->mgr, umem->real_size, NULL);
 
-    if (unlikely(pool >= pool_mgr->nb_pools ||
-                 !ulifo_push(&pool_mgr->pools[pool], umem->buffer)))
+    if (unlikely(pool >= pool_mgr->nb_pools))
         free(umem->buffer);
+    else {
+        struct umem_pool *umem_pool = &pool_mgr->pools[pool];
+        if (likely(ulifo_push(&umem_pool->lifo, umem->buffer))) {
+            /* nb may be transiently off, or even wrap around, while
+             * concurrent pops are not accounted yet */
+            uint32_t nb = uatomic_fetch_add_relaxed(&umem_pool->pushes, 1) +
+                          1 - uatomic_load_relaxed(&umem_pool->hits) -
+                          uatomic_load_relaxed(&umem_pool->vacuums);
+            uint32_t high_water = uatomic_load_relaxed(&umem_pool->high_water);
+            while (unlikely(nb > high_water) && nb <= umem_pool->depth &&
+                   !uatomic_compare_exchange(&umem_pool->high_water,
+                                             &high_water, nb));
+        } else {
+            uatomic_fetch_add_relaxed(&umem_pool->overflows, 1);
+            free(umem->buffer);
+        }
+    }
     umem->buffer = NULL;
     umem->mgr = NULL;
 }
@@ -143,8 +190,57 @@ static void umem_pool_mgr_vacuum(struct umem_mgr *mgr)
 
     for (unsigned int i = 0; i < pool_mgr->nb_pools; i++) {
         uint8_t *buffer;
-        while ((buffer = ulifo_pop(&pool_mgr->pools[i], uint8_t *)) != NULL)
+        while ((buffer = ulifo_pop(&pool_mgr->pools[i].lifo,
+                                   uint8_t *)) != NULL) {
+            uatomic_fetch_add_relaxed(&pool_mgr->pools[i].vacuums, 1);
             free(buffer);
+        }
+    }
+}
+
+/** @This returns the statistics of a pool.
+ *
+ * @param mgr pointer to umem manager
+ * @param pool index of the pool
+ * @param stats filled in with the statistics of the pool
+ * @return an error code
+ */
+static int umem_pool_mgr_get_stats(struct umem_mgr *mgr, unsigned int pool,
+                                   struct umem_mgr_stats *stats)
+{
+    struct umem_pool_mgr *pool_mgr = umem_pool_mgr_from_umem_mgr(mgr);
+    if (pool >= pool_mgr->nb_pools)
+        return UBASE_ERR_INVALID;
+
+    struct umem_pool *umem_pool = &pool_mgr->pools[pool];
+    stats->size = pool_mgr->pool0_size << pool;
+    stats->depth = umem_pool->depth;
+    stats->hits = uatomic_load_relaxed(&umem_pool->hits);
+    stats->misses = uatomic_load_relaxed(&umem_pool->misses);
+    stats->overflows = uatomic_load_relaxed(&umem_pool->overflows);
+    stats->high_water = uatomic_load_relaxed(&umem_pool->high_water);
+    return UBASE_ERR_NONE;
+}
+
+/** @This processes control commands on a umem pool manager.
+ *
+ * @param mgr pointer to umem manager
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int umem_pool_mgr_control(struct umem_mgr *mgr,
+                                 int command, va_list args)
+{
+    switch (command) {
+        case UMEM_MGR_GET_STATS: {
+            unsigned int pool = va_arg(args, unsigned int);
+            struct umem_mgr_stats *stats = va_arg(args,
+                                                  struct umem_mgr_stats *);
+            return umem_pool_mgr_get_stats(mgr, pool, stats);
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
     }
 }
 
@@ -157,8 +253,16 @@ static void umem_pool_mgr_free(struct urefcount *urefcount)
     struct umem_pool_mgr *pool_mgr = umem_pool_mgr_from_urefcount(urefcount);
     umem_pool_mgr_vacuum(umem_pool_mgr_to_umem_mgr(pool_mgr));
 
-    for (unsigned int i = 0; i < pool_mgr->nb_pools; i++)
-        ulifo_clean(&pool_mgr->pools[i]);
+    for (unsigned int i = 0; i < pool_mgr->nb_pools; i++) {
+        struct umem_pool *umem_pool = &pool_mgr->pools[i];
+        ulifo_clean(&umem_pool->lifo);
+        uatomic_clean(&umem_pool->pushes);
+        uatomic_clean(&umem_pool->hits);
+        uatomic_clean(&umem_pool->vacuums);
+        uatomic_clean(&umem_pool->misses);
+        uatomic_clean(&umem_pool->overflows);
+        uatomic_clean(&umem_pool->high_water);
+    }
 
     urefcount_clean(urefcount);
     free(pool_mgr);
@@ -178,7 +282,7 @@ static void umem_pool_mgr_free(struct urefcount *urefcount)
 struct umem_mgr *umem_pool_mgr_alloc(size_t pool0_size, size_t nb_pools, ...)
 {
     size_t alloc_size = sizeof(struct umem_pool_mgr) +
-                        sizeof(struct ulifo) * nb_pools;
+                        sizeof(struct umem_pool) * nb_pools;
     unsigned int pools_depths[nb_pools];
     va_list args;
     va_start(args, nb_pools);
@@ -197,11 +301,19 @@ struct umem_mgr *umem_pool_mgr_alloc(size_t pool0_size, size_t nb_pools, ...)
     pool_mgr->nb_pools = nb_pools;
 
     void *extra = (void *)pool_mgr + sizeof(struct umem_pool_mgr) +
-                  sizeof(struct ulifo) * nb_pools;
+                  sizeof(struct umem_pool) * nb_pools;
 
     for (unsigned int i = 0; i < nb_pools; i++) {
-        ulifo_init(&pool_mgr->pools[i], pools_depths[i], extra);
+        struct umem_pool *umem_pool = &pool_mgr->pools[i];
+        ulifo_init(&umem_pool->lifo, pools_depths[i], extra);
         extra += ulifo_sizeof(pools_depths[i]);
+        umem_pool->depth = pools_depths[i];
+        uatomic_init(&umem_pool->pushes, 0);
+        uatomic_init(&umem_pool->hits, 0);
+        uatomic_init(&umem_pool->vacuums, 0);
+        uatomic_init(&umem_pool->misses, 0);
+        uatomic_init(&umem_pool->overflows, 0);
+        uatomic_init(&umem_pool->high_water, 0);
     }
 
     urefcount_init(umem_pool_mgr_to_urefcount(pool_mgr), umem_pool_mgr_free);
@@ -210,6 +322,7 @@ struct umem_mgr *umem_pool_mgr_alloc(size_t pool0_size, size_t nb_pools, ...)
     pool_mgr->mgr.umem_realloc = umem_pool_realloc;
     pool_mgr->mgr.umem_free = umem_pool_free;
     pool_mgr->mgr.umem_mgr_vacuum = umem_pool_mgr_vacuum;
+    pool_mgr->mgr.umem_mgr_control = umem_pool_mgr_control;
 
     return umem_pool_mgr_to_umem_mgr(pool_mgr);
 }
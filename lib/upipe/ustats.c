@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short Upipe per-pipe statistics
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+#include "upipe/ubase.h"
+#include "upipe/ulist.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/upipe.h"
+#include "upipe/upipe_dump.h"
+#include "upipe/ustats.h"
+
+#ifdef HAVE_USTATS
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+/** @This stores the statistics of a pipe. */
+struct ustats_upipe {
+    /** structure for double-linked lists */
+    struct uchain uchain;
+    /** pointer to the pipe */
+    struct upipe *upipe;
+    /** counters */
+    struct ustats stats;
+};
+
+UBASE_FROM_TO(ustats_upipe, uchain, uchain, uchain)
+
+/** true if counting is switched on */
+uatomic_uint32_t ustats_enabled;
+/** clock used to compute latencies */
+static struct uclock *ustats_uclock = NULL;
+/** list of counted pipes */
+static struct uchain ustats_list = { .next = &ustats_list,
+                                     .prev = &ustats_list };
+/** lock protecting the list of counted pipes */
+static uatomic_uint32_t ustats_lock;
+/** innermost input function being counted on this thread */
+static _Thread_local struct ustats_frame *ustats_current = NULL;
+
+/** @internal @This locks the list of counted pipes. */
+static void ustats_list_lock(void)
+{
+    uint32_t unlocked = 0;
+    while (!uatomic_compare_exchange(&ustats_lock, &unlocked, 1))
+        unlocked = 0;
+}
+
+/** @internal @This unlocks the list of counted pipes. */
+static void ustats_list_unlock(void)
+{
+    uatomic_store(&ustats_lock, 0);
+}
+
+/** @internal @This returns the monotonic time in nanoseconds.
+ *
+ * @return current time
+ */
+static uint64_t ustats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+/** @internal @This returns the current system date for latencies.
+ *
+ * @param now_ns current monotonic time in nanoseconds
+ * @return system date in units of UCLOCK_FREQ
+ */
+static uint64_t ustats_now_sys(uint64_t now_ns)
+{
+    struct uclock *uclock = ustats_uclock;
+    if (uclock != NULL)
+        return uclock_now(uclock);
+    return now_ns / 1000 * UCLOCK_MICROSECOND;
+}
+
+/** @internal @This returns the statistics of a pipe, allocating them if
+ * needed.
+ *
+ * @param upipe description structure of the pipe
+ * @return pointer to the statistics, or NULL in case of allocation failure
+ */
+static struct ustats_upipe *ustats_upipe_get(struct upipe *upipe)
+{
+    if (likely(upipe->ustats != NULL))
+        return upipe->ustats;
+
+    struct ustats_upipe *ustats = calloc(1, sizeof (*ustats));
+    if (unlikely(ustats == NULL))
+        return NULL;
+    ustats->upipe = upipe;
+    uchain_init(&ustats->uchain);
+    ustats_list_lock();
+    ulist_add(&ustats_list, &ustats->uchain);
+    ustats_list_unlock();
+    upipe->ustats = ustats;
+    return ustats;
+}
+
+/** @This switches counting on.
+ *
+ * @param uclock clock used to compute latencies, or NULL to use the
+ * monotonic system clock (as uclock_std does by default)
+ */
+void ustats_enable(struct uclock *uclock)
+{
+    ustats_uclock = uclock;
+    uatomic_store(&ustats_enabled, 1);
+}
+
+/** @This switches counting off. Counters are kept. */
+void ustats_disable(void)
+{
+    uatomic_store(&ustats_enabled, 0);
+}
+
+/** @This returns a snapshot of the statistics of a pipe.
+ *
+ * @param upipe description structure of the pipe
+ * @param stats filled in with the counters
+ * @return an error code, UBASE_ERR_INVALID if the pipe has no counters
+ */
+int ustats_get(struct upipe *upipe, struct ustats *stats)
+{
+    if (upipe == NULL || upipe->ustats == NULL)
+        return UBASE_ERR_INVALID;
+    *stats = upipe->ustats->stats;
+    return UBASE_ERR_NONE;
+}
+
+/** @This resets the counters of all pipes. */
+void ustats_reset(void)
+{
+    struct uchain *uchain;
+    ustats_list_lock();
+    ulist_foreach (&ustats_list, uchain) {
+        struct ustats *stats = &ustats_upipe_from_uchain(uchain)->stats;
+        uint64_t queue_depth = stats->queue_depth;
+        memset(stats, 0, sizeof (*stats));
+        stats->queue_depth = stats->queue_max = queue_depth;
+    }
+    ustats_list_unlock();
+}
+
+/** @This converts a pipe to a label including its statistics, suitable for
+ * @ref upipe_dump.
+ *
+ * @param upipe description structure of the pipe
+ * @return allocated string
+ */
+char *ustats_upipe_label(struct upipe *upipe)
+{
+    char *label = upipe_dump_upipe_label_default(upipe);
+    if (label == NULL || upipe->ustats == NULL)
+        return label;
+
+    struct ustats *stats = &upipe->ustats->stats;
+    char *string;
+    if (asprintf(&string, "%s\\nin %"PRIu64" (%"PRIu64" o)"
+                 " out %"PRIu64" (%"PRIu64" o)"
+                 "\\nself %.3f ms total %.3f ms max %.3f ms"
+                 "\\nqueue %"PRIu64"/%"PRIu64" latency max %.3f ms",
+                 label, stats->urefs_in, stats->bytes_in,
+                 stats->urefs_out, stats->bytes_out,
+                 stats->time_self / 1000000., stats->time_total / 1000000.,
+                 stats->time_max / 1000000.,
+                 stats->queue_depth, stats->queue_max,
+                 stats->latency_max * 1000. / UCLOCK_FREQ) == -1)
+        string = NULL;
+    free(label);
+    return string;
+}
+
+/** @internal @This writes a JSON string.
+ *
+ * @param file output file
+ * @param str string to write, or NULL
+ */
+static void ustats_json_string(FILE *file, const char *str)
+{
+    if (str == NULL) {
+        fputs("null", file);
+        return;
+    }
+
+    fputc('"', file);
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            fprintf(file, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf(file, "\\u%04x", *p);
+        else
+            fputc(*p, file);
+    }
+    fputc('"', file);
+}
+
+/** @This writes the statistics of all counted pipes as a JSON array.
+ *
+ * @param file output file
+ * @return an error code
+ */
+int ustats_dump_json(FILE *file)
+{
+    struct uchain *uchain;
+    bool first = true;
+
+    fputc('[', file);
+    ustats_list_lock();
+    ulist_foreach (&ustats_list, uchain) {
+        struct ustats_upipe *ustats = ustats_upipe_from_uchain(uchain);
+        struct upipe *upipe = ustats->upipe;
+        struct ustats *stats = &ustats->stats;
+
+        const char *name = NULL;
+        for (struct uprobe *uprobe = upipe->uprobe;
+             uprobe != NULL && name == NULL; uprobe = uprobe->next)
+            name = uprobe_pfx_get_name(uprobe);
+        char signature[5];
+        memcpy(signature, &upipe->mgr->signature, 4);
+        signature[4] = '\0';
+
+        fprintf(file, "%s\n{\"pipe\":\"%p\",\"name\":", first ? "" : ",",
+                upipe);
+        ustats_json_string(file, name);
+        fputs(",\"signature\":", file);
+        ustats_json_string(file, signature);
+        fprintf(file, ",\"urefs_in\":%"PRIu64",\"bytes_in\":%"PRIu64
+                ",\"urefs_out\":%"PRIu64",\"bytes_out\":%"PRIu64
+                ",\"time_total\":%"PRIu64",\"time_self\":%"PRIu64
+                ",\"time_max\":%"PRIu64
+                ",\"queue_depth\":%"PRIu64",\"queue_max\":%"PRIu64
+                ",\"latency_max\":%"PRIu64",\"latency\":[",
+                stats->urefs_in, stats->bytes_in,
+                stats->urefs_out, stats->bytes_out,
+                stats->time_total, stats->time_self, stats->time_max,
+                stats->queue_depth, stats->queue_max,
+                stats->latency_max);
+        for (unsigned i = 0; i < USTATS_LATENCY_BUCKETS; i++)
+            fprintf(file, "%s%"PRIu64, i ? "," : "", stats->latency[i]);
+        fputs("]}", file);
+        first = false;
+    }
+    ustats_list_unlock();
+    fputs("\n]\n", file);
+    return ferror(file) ? UBASE_ERR_EXTERNAL : UBASE_ERR_NONE;
+}
+
+/** @hidden */
+void ustats_upipe_clean(struct upipe *upipe)
+{
+    struct ustats_upipe *ustats = upipe->ustats;
+    if (ustats == NULL)
+        return;
+
+    ustats_list_lock();
+    ulist_delete(&ustats->uchain);
+    ustats_list_unlock();
+    upipe->ustats = NULL;
+    free(ustats);
+}
+
+/** @hidden */
+void ustats_upipe_input_start(struct ustats_frame *frame,
+                              struct upipe *upipe, struct uref *uref)
+{
+    struct ustats_upipe *ustats = ustats_upipe_get(upipe);
+    if (unlikely(ustats == NULL))
+        return;
+
+    struct ustats *stats = &ustats->stats;
+    uint64_t now = ustats_now();
+    stats->urefs_in++;
+    size_t size;
+    if (uref->ubuf != NULL && ubase_check(uref_block_size(uref, &size)))
+        stats->bytes_in += size;
+
+    uint64_t cr_sys;
+    if (ubase_check(uref_clock_get_cr_sys(uref, &cr_sys))) {
+        uint64_t now_sys = ustats_now_sys(now);
+        uint64_t latency = now_sys > cr_sys ? now_sys - cr_sys : 0;
+        unsigned i = 0;
+        while (i < USTATS_LATENCY_BUCKETS - 1 &&
+               latency >= USTATS_LATENCY_BASE << i)
+            i++;
+        stats->latency[i]++;
+        if (latency > stats->latency_max)
+            stats->latency_max = latency;
+    }
+
+    frame->stats = ustats;
+    frame->parent = ustats_current;
+    frame->nested = 0;
+    frame->start = now;
+    ustats_current = frame;
+}
+
+/** @hidden */
+void ustats_upipe_input_stop(struct ustats_frame *frame)
+{
+    struct ustats *stats = &((struct ustats_upipe *)frame->stats)->stats;
+    uint64_t elapsed = ustats_now() - frame->start;
+
+    stats->time_total += elapsed;
+    stats->time_self += elapsed > frame->nested ? elapsed - frame->nested : 0;
+    if (elapsed > stats->time_max)
+        stats->time_max = elapsed;
+
+    ustats_current = frame->parent;
+    if (frame->parent != NULL)
+        frame->parent->nested += elapsed;
+}
+
+/** @hidden */
+void ustats_upipe_count_output(struct upipe *upipe, struct uref *uref)
+{
+    struct ustats_upipe *ustats = ustats_upipe_get(upipe);
+    if (unlikely(ustats == NULL))
+        return;
+
+    ustats->stats.urefs_out++;
+    size_t size;
+    if (uref->ubuf != NULL && ubase_check(uref_block_size(uref, &size)))
+        ustats->stats.bytes_out += size;
+}
+
+/** @hidden */
+void ustats_upipe_count_queue(struct upipe *upipe, unsigned int depth)
+{
+    struct ustats_upipe *ustats = ustats_upipe_get(upipe);
+    if (unlikely(ustats == NULL))
+        return;
+
+    ustats->stats.queue_depth = depth;
+    if (depth > ustats->stats.queue_max)
+        ustats->stats.queue_max = depth;
+}
+
+#endif
@@ -22,10 +22,29 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <link.h>
 #include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
 
 #define UTRACE_MAGIC "UTRACE01"
+#define UTRACE_RING_MAGIC "UTRING01"
+
+/** default number of events per thread in ring mode */
+#define UTRACE_RING_DEFAULT_EVENTS 65536
+/** default number of pipes tracked in ring mode */
+#define UTRACE_RING_DEFAULT_PIPES 4096
+/** maximum length of a pipe name in ring mode */
+#define UTRACE_RING_NAME_SIZE 52
 
 enum utrace_id {
     UTRACE_DUMP_GRAPH,
@@ -71,6 +90,386 @@ static FILE *utrace_f;
 
 static void utrace_init(void);
 
+/*
+ * Ring mode: each thread records fixed-size events in its own ring buffer,
+ * without locks nor system calls, and the rings are written to a file on
+ * demand or when a signal is received.
+ */
+
+/** @This is an event recorded in a ring. */
+struct utrace_ring_event {
+    /** timestamp, in TSC ticks (or nanoseconds without TSC) */
+    uint64_t ts;
+    /** main object of the event */
+    uint64_t ptr;
+    /** event argument */
+    uint64_t arg;
+    /** event identifier */
+    uint32_t id;
+    /** padding */
+    uint32_t reserved;
+};
+
+/** @This is the ring of a thread. */
+struct utrace_ring {
+    /** next ring */
+    struct utrace_ring *next;
+    /** system thread identifier */
+    uint64_t tid;
+    /** number of events recorded since the beginning */
+    uint64_t head;
+    /** events */
+    struct utrace_ring_event events[];
+};
+
+/** @This describes a live pipe in ring mode. */
+struct utrace_ring_pipe {
+    /** pipe, NULL if the slot is free or 1 if it is being filled */
+    uatomic_ptr_t upipe;
+    /** signature of the pipe manager */
+    uint32_t signature;
+    /** name of the pipe */
+    char name[UTRACE_RING_NAME_SIZE];
+};
+
+/** @This is the header of a ring dump. */
+struct utrace_ring_header {
+    /** @ref UTRACE_RING_MAGIC */
+    char magic[8];
+    /** number of events per ring */
+    uint32_t nb_events;
+    /** number of pipe slots */
+    uint32_t nb_pipes;
+    /** timestamps and monotonic dates in nanoseconds, at initialization and
+     * at dump, to convert timestamps */
+    uint64_t ts[2];
+    uint64_t ns[2];
+};
+
+/** number of events per ring (power of 2), or 0 if ring mode is disabled */
+static uint32_t utrace_ring_size;
+/** number of pipe slots (power of 2) */
+static uint32_t utrace_ring_nb_pipes;
+/** pipe slots */
+static struct utrace_ring_pipe *utrace_ring_pipes;
+/** list of rings */
+static uatomic_ptr_t utrace_ring_list;
+/** ring of the current thread */
+static _Thread_local struct utrace_ring *utrace_ring_self;
+/** timestamp and monotonic date at initialization */
+static uint64_t utrace_ring_ts0, utrace_ring_ns0;
+/** file written when the signal is received */
+static char utrace_ring_path[PATH_MAX];
+
+/** @internal @This returns the monotonic date in nanoseconds.
+ *
+ * @return date in nanoseconds
+ */
+static uint64_t utrace_ring_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** @internal @This returns a cheap timestamp.
+ *
+ * @return timestamp in TSC ticks, or in nanoseconds without TSC
+ */
+static inline uint64_t utrace_ring_ts(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return utrace_ring_ns();
+#endif
+}
+
+/** @internal @This allocates the ring of the current thread.
+ *
+ * @return pointer to the ring, or NULL in case of allocation failure
+ */
+static struct utrace_ring *utrace_ring_alloc(void)
+{
+    struct utrace_ring *ring =
+        calloc(1, sizeof (*ring) +
+               utrace_ring_size * sizeof (struct utrace_ring_event));
+    if (ring == NULL)
+        return NULL;
+    ring->tid = syscall(SYS_gettid);
+
+    void *next = uatomic_ptr_load(&utrace_ring_list);
+    do
+        ring->next = next;
+    while (!uatomic_ptr_compare_exchange(&utrace_ring_list, &next, ring));
+    utrace_ring_self = ring;
+    return ring;
+}
+
+/** @internal @This records an event in the ring of the current thread.
+ *
+ * @param id event identifier
+ * @param ptr main object of the event
+ * @param arg event argument
+ */
+static void utrace_ring_record(enum utrace_id id, const void *ptr,
+                               uint64_t arg)
+{
+    utrace_init();
+    if (likely(!utrace_ring_size))
+        return;
+
+    struct utrace_ring *ring = utrace_ring_self;
+    if (unlikely(ring == NULL) && (ring = utrace_ring_alloc()) == NULL)
+        return;
+
+    uint64_t head = ring->head;
+    struct utrace_ring_event *event =
+        &ring->events[head & (utrace_ring_size - 1)];
+    event->ts = utrace_ring_ts();
+    event->ptr = (uintptr_t)ptr;
+    event->arg = arg;
+    event->id = id;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/** @internal @This returns the first slot to look up for a pipe.
+ *
+ * @param upipe pipe
+ * @return slot index
+ */
+static uint32_t utrace_ring_pipe_hash(struct upipe *upipe)
+{
+    return ((uintptr_t)upipe >> 4) * UINT32_C(2654435761);
+}
+
+/** @internal @This registers a pipe so that its name appears in dumps.
+ *
+ * @param upipe pipe
+ */
+static void utrace_ring_pipe_add(struct upipe *upipe)
+{
+    utrace_init();
+    if (utrace_ring_pipes == NULL)
+        return;
+
+    uint32_t mask = utrace_ring_nb_pipes - 1;
+    uint32_t hash = utrace_ring_pipe_hash(upipe);
+    for (uint32_t i = 0; i < utrace_ring_nb_pipes; i++) {
+        struct utrace_ring_pipe *slot = &utrace_ring_pipes[(hash + i) & mask];
+        void *expected = NULL;
+        if (!uatomic_ptr_compare_exchange(&slot->upipe, &expected,
+                                          (void *)1))
+            continue;
+
+        const char *name = NULL;
+        for (struct uprobe *uprobe = upipe->uprobe;
+             uprobe != NULL && name == NULL; uprobe = uprobe->next)
+            name = uprobe_pfx_get_name(uprobe);
+        slot->signature = upipe->mgr->signature;
+        strncpy(slot->name, name ?: "", sizeof (slot->name) - 1);
+        slot->name[sizeof (slot->name) - 1] = '\0';
+        uatomic_ptr_store(&slot->upipe, upipe);
+        return;
+    }
+}
+
+/** @internal @This unregisters a pipe.
+ *
+ * @param upipe pipe
+ */
+static void utrace_ring_pipe_del(struct upipe *upipe)
+{
+    if (utrace_ring_pipes == NULL)
+        return;
+
+    uint32_t mask = utrace_ring_nb_pipes - 1;
+    uint32_t hash = utrace_ring_pipe_hash(upipe);
+    for (uint32_t i = 0; i < utrace_ring_nb_pipes; i++) {
+        struct utrace_ring_pipe *slot = &utrace_ring_pipes[(hash + i) & mask];
+        void *expected = upipe;
+        if (uatomic_ptr_compare_exchange(&slot->upipe, &expected, NULL))
+            return;
+    }
+}
+
+/** @internal @This writes a buffer to a file descriptor.
+ *
+ * @param fd file descriptor
+ * @param buf buffer to write
+ * @param len size of the buffer
+ * @return false in case of error
+ */
+static bool utrace_ring_write(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t ret = write(fd, p, len);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+/** @internal @This writes the rings to a file descriptor. It only uses
+ * async-signal-safe functions.
+ *
+ * @param fd file descriptor
+ * @return false in case of error
+ */
+static bool utrace_ring_write_all(int fd)
+{
+    struct utrace_ring_header header = {
+        .magic = UTRACE_RING_MAGIC,
+        .nb_events = utrace_ring_size,
+        .nb_pipes = utrace_ring_nb_pipes,
+        .ts = { utrace_ring_ts0, utrace_ring_ts() },
+        .ns = { utrace_ring_ns0, utrace_ring_ns() },
+    };
+    if (!utrace_ring_write(fd, &header, sizeof (header)))
+        return false;
+
+    /* live pipes, terminated by an empty slot */
+    struct utrace_ring_pipe pipes[64];
+    unsigned nb = 0;
+    for (uint32_t i = 0; i <= utrace_ring_nb_pipes; i++) {
+        if (i < utrace_ring_nb_pipes) {
+            struct utrace_ring_pipe *slot = &utrace_ring_pipes[i];
+            void *upipe = uatomic_ptr_load(&slot->upipe);
+            if ((uintptr_t)upipe <= 1)
+                continue;
+            pipes[nb] = *slot;
+            pipes[nb].upipe = upipe;
+        } else
+            memset(&pipes[nb], 0, sizeof (pipes[nb]));
+        if (++nb == UBASE_ARRAY_SIZE(pipes) || i == utrace_ring_nb_pipes) {
+            if (!utrace_ring_write(fd, pipes, nb * sizeof (pipes[0])))
+                return false;
+            nb = 0;
+        }
+    }
+
+    /* rings, terminated by a null thread identifier */
+    struct utrace_ring *ring = uatomic_ptr_load(&utrace_ring_list);
+    for ( ; ring != NULL; ring = ring->next) {
+        uint64_t ring_header[2] = {
+            ring->tid, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)
+        };
+        if (!utrace_ring_write(fd, ring_header, sizeof (ring_header)) ||
+            !utrace_ring_write(fd, ring->events,
+                               utrace_ring_size * sizeof (ring->events[0])))
+            return false;
+    }
+    uint64_t ring_end[2] = { 0, 0 };
+    return utrace_ring_write(fd, ring_end, sizeof (ring_end));
+}
+
+int utrace_ring_dump(const char *path)
+{
+    utrace_init();
+    if (!utrace_ring_size)
+        return UBASE_ERR_INVALID;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return UBASE_ERR_EXTERNAL;
+    bool ret = utrace_ring_write_all(fd);
+    close(fd);
+    return ret ? UBASE_ERR_NONE : UBASE_ERR_EXTERNAL;
+}
+
+/** @internal @This is the handler of the dump signal.
+ *
+ * @param signum signal number
+ */
+static void utrace_ring_signal(int signum)
+{
+    int saved_errno = errno;
+    utrace_ring_dump(utrace_ring_path);
+    errno = saved_errno;
+}
+
+/** @internal @This returns the power of 2 greater or equal to the value of
+ * an environment variable.
+ *
+ * @param str value of the environment variable, or NULL
+ * @param def default value, if the variable is not set or empty
+ * @return the value
+ */
+static uint32_t utrace_ring_pow2(const char *str, uint32_t def)
+{
+    unsigned long val = str != NULL && *str ? strtoul(str, NULL, 0) : def;
+    if (val == 0 || val > UINT32_C(1) << 30)
+        val = def;
+    uint32_t pow2 = 1;
+    while (pow2 < val)
+        pow2 <<= 1;
+    return pow2;
+}
+
+/** @internal @This initializes ring mode from the environment. */
+static void utrace_ring_init(void)
+{
+    const char *events = getenv("UTRACE_RING");
+    if (events == NULL)
+        return;
+
+    uint32_t size = utrace_ring_pow2(events, UTRACE_RING_DEFAULT_EVENTS);
+    utrace_ring_nb_pipes = utrace_ring_pow2(getenv("UTRACE_RING_PIPES"),
+                                            UTRACE_RING_DEFAULT_PIPES);
+    utrace_ring_pipes = calloc(utrace_ring_nb_pipes,
+                               sizeof (struct utrace_ring_pipe));
+    if (utrace_ring_pipes == NULL)
+        return;
+
+    const char *path = getenv("UTRACE_RING_FILE");
+    if (path != NULL)
+        snprintf(utrace_ring_path, sizeof (utrace_ring_path), "%s", path);
+    else
+        snprintf(utrace_ring_path, sizeof (utrace_ring_path),
+                 "utrace-ring.%d", getpid());
+
+    int signum = SIGUSR2;
+    const char *signum_str = getenv("UTRACE_RING_SIGNAL");
+    if (signum_str != NULL)
+        signum = atoi(signum_str);
+    if (signum > 0) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof (sa));
+        sa.sa_handler = utrace_ring_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(signum, &sa, NULL);
+    }
+
+    utrace_ring_ts0 = utrace_ring_ts();
+    utrace_ring_ns0 = utrace_ring_ns();
+    utrace_ring_size = size;
+    fprintf(stderr, "upipe: ring tracing enabled (%u events per thread, "
+            "dump to %s on signal %d)\n", size, utrace_ring_path, signum);
+}
+
+/** @internal @This records an event in ring mode and starts writing it to
+ * the trace file, or returns from the calling hook if there is no trace
+ * file.
+ *
+ * @param Id event identifier
+ * @param Ptr main object of the event
+ * @param Arg event argument
+ */
+#define utrace_begin(Id, Ptr, Arg)                                          \
+    do {                                                                    \
+        utrace_ring_record(Id, Ptr, Arg);                                   \
+        if (utrace_f == NULL)                                               \
+            return;                                                         \
+        utrace_write_id(Id);                                                \
+    } while (0)
+
 static void utrace_write(const void *buf, size_t len)
 {
     utrace_init();
@@ -258,6 +657,7 @@ static void utrace_init(void)
 {
     if (!utrace_initialized) {
         utrace_initialized = true;
+        utrace_ring_init();
         const char *fd_str = getenv("UTRACE_FD");
         if (fd_str == NULL)
             return;
@@ -290,7 +690,7 @@ static void utrace_init(void)
 
 void utrace_uprobe_init(struct uprobe *uprobe)
 {
-    utrace_write_id(UTRACE_UPROBE_INIT);
+    utrace_begin(UTRACE_UPROBE_INIT, uprobe, 0);
     utrace_write_ptr(uprobe);
     utrace_write_ptr(uprobe->uprobe_throw);
     utrace_write_ptr(uprobe->next);
@@ -300,7 +700,7 @@ void utrace_uprobe_init(struct uprobe *uprobe)
 
 void utrace_uprobe_clean(struct uprobe *uprobe)
 {
-    utrace_write_id(UTRACE_UPROBE_CLEAN);
+    utrace_begin(UTRACE_UPROBE_CLEAN, uprobe, 0);
     utrace_write_ptr(uprobe);
     utrace_end();
 }
@@ -311,7 +711,7 @@ void utrace_uprobe_throw_enter(struct uprobe *uprobe,
 {
     va_list ap;
 
-    utrace_write_id(UTRACE_UPROBE_THROW_ENTER);
+    utrace_begin(UTRACE_UPROBE_THROW_ENTER, upipe, event);
     utrace_write_ptr(uprobe);
     utrace_write_ptr(upipe);
     utrace_write_int(event);
@@ -325,7 +725,7 @@ void utrace_uprobe_throw_enter(struct uprobe *uprobe,
 
 void utrace_uprobe_throw_leave(int err)
 {
-    utrace_write_id(UTRACE_UPROBE_THROW_LEAVE);
+    utrace_begin(UTRACE_UPROBE_THROW_LEAVE, NULL, err);
     utrace_write_int(err);
     utrace_end();
 }
@@ -334,7 +734,7 @@ void utrace_upipe_alloc_enter(struct upipe_mgr *mgr,
                               struct uprobe *uprobe,
                               uint32_t signature)
 {
-    utrace_write_id(UTRACE_UPIPE_ALLOC_ENTER);
+    utrace_begin(UTRACE_UPIPE_ALLOC_ENTER, mgr, mgr->signature);
     utrace_write_ptr(mgr);
     utrace_write_sig(mgr->signature);
     utrace_write_ptr(mgr->upipe_alloc);
@@ -345,14 +745,15 @@ void utrace_upipe_alloc_enter(struct upipe_mgr *mgr,
 
 void utrace_upipe_alloc_leave(struct upipe *upipe)
 {
-    utrace_write_id(UTRACE_UPIPE_ALLOC_LEAVE);
+    utrace_begin(UTRACE_UPIPE_ALLOC_LEAVE, upipe, 0);
     utrace_write_ptr(upipe);
     utrace_end();
 }
 
 void utrace_upipe_init(struct upipe *upipe)
 {
-    utrace_write_id(UTRACE_UPIPE_INIT);
+    utrace_ring_pipe_add(upipe);
+    utrace_begin(UTRACE_UPIPE_INIT, upipe, upipe->mgr->signature);
     utrace_write_ptr(upipe);
     utrace_write_ptr(upipe->mgr);
     utrace_write_ptr(upipe->uprobe);
@@ -361,7 +762,8 @@ void utrace_upipe_init(struct upipe *upipe)
 
 void utrace_upipe_clean(struct upipe *upipe)
 {
-    utrace_write_id(UTRACE_UPIPE_CLEAN);
+    utrace_ring_pipe_del(upipe);
+    utrace_begin(UTRACE_UPIPE_CLEAN, upipe, 0);
     utrace_write_ptr(upipe);
     utrace_end();
 }
@@ -371,7 +773,7 @@ void utrace_upipe_control_enter(struct upipe *upipe,
 {
     va_list ap;
 
-    utrace_write_id(UTRACE_UPIPE_CONTROL_ENTER);
+    utrace_begin(UTRACE_UPIPE_CONTROL_ENTER, upipe, command);
     utrace_write_ptr(upipe);
     utrace_write_int(command);
     va_copy(ap, args);
@@ -421,7 +823,7 @@ void utrace_upipe_control_enter(struct upipe *upipe,
 void utrace_upipe_control_leave(int err, int command, va_list args)
 {
 
-    utrace_write_id(UTRACE_UPIPE_CONTROL_LEAVE);
+    utrace_begin(UTRACE_UPIPE_CONTROL_LEAVE, NULL, err);
     utrace_write_int(err);
     utrace_write_int(command);
     if (err == UBASE_ERR_NONE) {
@@ -453,7 +855,7 @@ void utrace_upipe_throw_enter(struct upipe *upipe, int event, va_list args)
 {
     va_list ap;
 
-    utrace_write_id(UTRACE_UPIPE_THROW_ENTER);
+    utrace_begin(UTRACE_UPIPE_THROW_ENTER, upipe, event);
     utrace_write_ptr(upipe);
     utrace_write_ptr(upipe->uprobe);
     utrace_write_int(event);
@@ -493,7 +895,7 @@ void utrace_upipe_throw_enter(struct upipe *upipe, int event, va_list args)
 
 void utrace_upipe_throw_leave(int err, int event, va_list args)
 {
-    utrace_write_id(UTRACE_UPIPE_THROW_LEAVE);
+    utrace_begin(UTRACE_UPIPE_THROW_LEAVE, NULL, err);
     utrace_write_int(err);
     utrace_write_int(event);
     if (err == UBASE_ERR_NONE) {
@@ -510,20 +912,20 @@ void utrace_upipe_throw_leave(int err, int event, va_list args)
 
 void utrace_upipe_input_enter(struct upipe *upipe, struct uref *uref)
 {
-    utrace_write_id(UTRACE_UPIPE_INPUT_ENTER);
+    utrace_begin(UTRACE_UPIPE_INPUT_ENTER, upipe, upipe->mgr->signature);
     utrace_write_ptr(upipe);
     utrace_end();
 }
 
 void utrace_upipe_input_leave(void)
 {
-    utrace_write_id(UTRACE_UPIPE_INPUT_LEAVE);
+    utrace_begin(UTRACE_UPIPE_INPUT_LEAVE, NULL, 0);
     utrace_end();
 }
 
 void utrace_urequest_init(struct urequest *urequest)
 {
-    utrace_write_id(UTRACE_UREQUEST_INIT);
+    utrace_begin(UTRACE_UREQUEST_INIT, urequest, urequest->type);
     utrace_write_ptr(urequest);
     utrace_write_int(urequest->type);
     utrace_write_uref(urequest->uref);
@@ -532,14 +934,14 @@ void utrace_urequest_init(struct urequest *urequest)
 
 void utrace_urequest_clean(struct urequest *urequest)
 {
-    utrace_write_id(UTRACE_UREQUEST_CLEAN);
+    utrace_begin(UTRACE_UREQUEST_CLEAN, urequest, 0);
     utrace_write_ptr(urequest);
     utrace_end();
 }
 
 void utrace_urequest_free(struct urequest *urequest)
 {
-    utrace_write_id(UTRACE_UREQUEST_FREE);
+    utrace_begin(UTRACE_UREQUEST_FREE, urequest, 0);
     utrace_write_ptr(urequest);
     utrace_end();
 }
@@ -548,7 +950,7 @@ void utrace_urequest_provide_enter(struct urequest *urequest, va_list args)
 {
     va_list ap;
 
-    utrace_write_id(UTRACE_UREQUEST_PROVIDE_ENTER);
+    utrace_begin(UTRACE_UREQUEST_PROVIDE_ENTER, urequest, urequest->type);
     utrace_write_ptr(urequest);
     va_copy(ap, args);
     switch (urequest->type) {
@@ -568,7 +970,7 @@ void utrace_urequest_provide_enter(struct urequest *urequest, va_list args)
 
 void utrace_urequest_provide_leave(int err)
 {
-    utrace_write_id(UTRACE_UREQUEST_PROVIDE_LEAVE);
+    utrace_begin(UTRACE_UREQUEST_PROVIDE_LEAVE, NULL, err);
     utrace_write_int(err);
     utrace_end();
 }
@@ -577,7 +979,7 @@ void utrace_upump_alloc_enter(struct upump_mgr *mgr, int event, va_list args)
 {
     va_list ap;
 
-    utrace_write_id(UTRACE_UPUMP_ALLOC_ENTER);
+    utrace_begin(UTRACE_UPUMP_ALLOC_ENTER, mgr, event);
     utrace_write_ptr(mgr);
     utrace_write_sig(mgr->signature);
     utrace_write_ptr(mgr->upump_alloc);
@@ -600,7 +1002,7 @@ void utrace_upump_alloc_enter(struct upump_mgr *mgr, int event, va_list args)
 
 void utrace_upump_alloc_leave(struct upump *upump)
 {
-    utrace_write_id(UTRACE_UPUMP_ALLOC_LEAVE);
+    utrace_begin(UTRACE_UPUMP_ALLOC_LEAVE, upump, 0);
     utrace_write_ptr(upump);
     utrace_write_ptr(upump ? upump->cb : NULL);
     utrace_end();
@@ -610,7 +1012,7 @@ void utrace_upump_control_enter(struct upump *upump, int command, va_list args)
 {
     va_list ap;
 
-    utrace_write_id(UTRACE_UPUMP_CONTROL_ENTER);
+    utrace_begin(UTRACE_UPUMP_CONTROL_ENTER, upump, command);
     utrace_write_ptr(upump);
     utrace_write_int(command);
     va_copy(ap, args);
@@ -634,7 +1036,7 @@ void utrace_upump_control_enter(struct upump *upump, int command, va_list args)
 
 void utrace_upump_control_leave(int err, int command, va_list args)
 {
-    utrace_write_id(UTRACE_UPUMP_CONTROL_LEAVE);
+    utrace_begin(UTRACE_UPUMP_CONTROL_LEAVE, NULL, err);
     utrace_write_int(err);
     utrace_write_int(command);
     if (err == UBASE_ERR_NONE) {
@@ -651,10 +1053,10 @@ void utrace_upump_control_leave(int err, int command, va_list args)
 
 void utrace_ulog_init(struct ulog *ulog)
 {
+    utrace_begin(UTRACE_ULOG_INIT, ulog, ulog->level);
+
     char msg[ulog_msg_len(ulog) + 1];
     ulog_msg_print(ulog, msg, sizeof msg);
-
-    utrace_write_id(UTRACE_ULOG_INIT);
     utrace_write_ptr(ulog);
     utrace_write_uint(ulog->level);
     utrace_write_str(msg);
@@ -663,7 +1065,7 @@ void utrace_ulog_init(struct ulog *ulog)
 
 void utrace_ulog_add_prefix(struct ulog *ulog, struct ulog_pfx *prefix)
 {
-    utrace_write_id(UTRACE_ULOG_ADD_PREFIX);
+    utrace_begin(UTRACE_ULOG_ADD_PREFIX, ulog, 0);
     utrace_write_ptr(ulog);
     utrace_write_str(prefix->tag);
     utrace_end();
@@ -671,7 +1073,7 @@ void utrace_ulog_add_prefix(struct ulog *ulog, struct ulog_pfx *prefix)
 
 void utrace_dump_graph(const char *name)
 {
-    utrace_write_id(UTRACE_DUMP_GRAPH);
+    utrace_begin(UTRACE_DUMP_GRAPH, name, 0);
     utrace_write_str(name);
     utrace_end();
 }
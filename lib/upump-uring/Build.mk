@@ -0,0 +1,12 @@
+configs += io_uring
+io_uring-includes = sys/syscall.h linux/io_uring.h
+io_uring-assert = __NR_io_uring_setup
+
+lib-targets = libupump_uring
+
+libupump_uring-desc = io_uring event loop
+libupump_uring-so-version = 1.0.0
+libupump_uring-includes = upump_uring.h
+libupump_uring-src = upump_uring.c
+libupump_uring-deps = io_uring
+libupump_uring-libs = libupipe pthread
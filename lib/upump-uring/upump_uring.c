@@ -0,0 +1,1214 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short implementation of a Upipe event loop using io_uring
+ *
+ * All pumps are implemented as io_uring requests: poll requests for file
+ * descriptors and signals (through a signalfd), absolute timeout requests
+ * for timers, and plain read and write requests for the local types. A
+ * request is identified by the pump id and a generation number, which is
+ * bumped every time the pump is disarmed, so that late completions of
+ * cancelled requests are ignored. The generation is kept with the id when a
+ * pump is freed, so that a new pump reusing the id does not match them
+ * either. Signals are blocked while their pump is started, so that they are
+ * only reported through the signalfd.
+ *
+ * The manager counts the started pumps which keep the event loop running,
+ * and keeps the started idlers in a separate list, so that an iteration of
+ * the event loop does not depend on the number of pumps.
+ */
+
+#include "upipe/ubase.h"
+#include "upipe/urefcount.h"
+#include "upipe/uclock.h"
+#include "upipe/umutex.h"
+#include "upipe/upump.h"
+#include "upipe/upump_common.h"
+#include "upump-uring/upump_uring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/signalfd.h>
+
+#include <linux/io_uring.h>
+
+/** number of submission queue entries */
+#define UPUMP_URING_ENTRIES 256
+/** user data of requests whose completion is ignored */
+#define UPUMP_URING_IGNORE UINT64_MAX
+/** number of nanoseconds per second */
+#define NSEC_PER_SEC UINT64_C(1000000000)
+
+/** @This stores a completion event. */
+struct upump_uring_cqe {
+    /** user data of the request */
+    uint64_t user_data;
+    /** result of the request */
+    int32_t res;
+};
+
+/** @This stores management parameters and local structures.
+ */
+struct upump_uring_mgr {
+    /** refcount management structure */
+    struct urefcount urefcount;
+
+    /** io_uring file descriptor */
+    int fd;
+    /** submission queue ring mapping */
+    void *sq_ring;
+    /** size of the submission queue ring mapping */
+    size_t sq_ring_size;
+    /** completion queue ring mapping, or NULL if shared with sq_ring */
+    void *cq_ring;
+    /** size of the completion queue ring mapping */
+    size_t cq_ring_size;
+    /** submission queue entries */
+    struct io_uring_sqe *sqes;
+    /** size of the submission queue entries mapping */
+    size_t sqes_size;
+    /** expirations of timeout requests, indexed like the submission queue
+     * entries, as the kernel only reads them on submission */
+    struct __kernel_timespec *sq_ts;
+    /** submission queue head (written by the kernel) */
+    unsigned *sq_head;
+    /** submission queue tail */
+    unsigned *sq_tail;
+    /** submission queue mask */
+    unsigned sq_mask;
+    /** number of submission queue entries */
+    unsigned sq_entries;
+    /** local submission queue tail, published on submission */
+    unsigned sq_local_tail;
+    /** completion queue head */
+    unsigned *cq_head;
+    /** completion queue tail (written by the kernel) */
+    unsigned *cq_tail;
+    /** completion queue mask */
+    unsigned cq_mask;
+    /** completion queue entries */
+    struct io_uring_cqe *cqes;
+
+    /** completions reaped while waiting for a given request */
+    struct upump_uring_cqe *stash;
+    /** index of the first completion in the stash */
+    unsigned int stash_head;
+    /** number of completions in the stash */
+    unsigned int stash_tail;
+    /** allocated size of the stash */
+    unsigned int stash_size;
+
+    /** pumps indexed by id */
+    struct upump_uring **slots;
+    /** next generation of each id */
+    uint32_t *gens;
+    /** number of slots */
+    unsigned int nb_slots;
+    /** stack of free ids */
+    uint32_t *free_ids;
+    /** number of free ids */
+    unsigned int nb_free_ids;
+
+    /** number of started pumps keeping the event loop running */
+    unsigned int nb_blocking;
+    /** list of started idlers */
+    struct uchain idlers;
+    /** currently dispatching events */
+    bool running;
+    /** list of allocated upump structures */
+    struct uchain upumps;
+
+    /** common structure */
+    struct upump_common_mgr common_mgr;
+
+    /** extra space for upool */
+    uint8_t upool_extra[];
+};
+
+UBASE_FROM_TO(upump_uring_mgr, upump_mgr, upump_mgr, common_mgr.mgr)
+UBASE_FROM_TO(upump_uring_mgr, urefcount, urefcount, urefcount)
+
+/** @This stores local structures.
+ */
+struct upump_uring {
+    /** structure for double-linked list */
+    struct uchain uchain;
+
+    /** type of event to watch */
+    int event;
+    /** file descriptor */
+    int fd;
+    /** id of the pump in the manager */
+    uint32_t id;
+    /** generation of the current request */
+    uint32_t gen;
+    /** true if a request is in progress */
+    bool armed;
+    /** true if a one-shot timer or an operation has completed */
+    bool expired;
+    /** true if the pump is started and not blocked */
+    bool active;
+    /** true if the pump is counted in the blocking pumps of the manager */
+    bool blocking;
+    /** structure for the list of started idlers */
+    struct uchain idler_uchain;
+
+    /** private structure */
+    union {
+        struct {
+            /** delay before the first expiration */
+            uint64_t after;
+            /** delay between expirations */
+            uint64_t repeat;
+            /** next expiration, in nanoseconds of the monotonic clock */
+            uint64_t deadline;
+        } timer;
+        struct {
+            /** buffer */
+            void *buf;
+            /** size of the buffer */
+            size_t len;
+            /** position in the file */
+            uint64_t offset;
+            /** result of the last operation */
+            ssize_t result;
+        } io;
+        struct {
+            /** signal number */
+            int signum;
+            /** true if the signal was blocked by the pump */
+            bool unblock;
+        } signal;
+    };
+
+    /** upump should be freed after dispatching */
+    bool free;
+
+    /** common structure */
+    struct upump_common common;
+};
+
+UBASE_FROM_TO(upump_uring, upump, upump, common.upump)
+UBASE_FROM_TO(upump_uring, uchain, uchain, uchain)
+UBASE_FROM_TO(upump_uring, uchain, idler_uchain, idler_uchain)
+
+/** @internal @This converts a duration in clock ticks to nanoseconds.
+ *
+ * @param ticks duration in units of @ref UCLOCK_FREQ
+ * @return duration in nanoseconds
+ */
+static inline uint64_t upump_uring_ticks_to_ns(uint64_t ticks)
+{
+    return (ticks / UCLOCK_FREQ) * NSEC_PER_SEC +
+           ((ticks % UCLOCK_FREQ) * NSEC_PER_SEC) / UCLOCK_FREQ;
+}
+
+/** @internal @This returns the current date of the monotonic clock.
+ *
+ * @return date in nanoseconds
+ */
+static inline uint64_t upump_uring_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/** @internal @This submits the queued requests and optionally waits for
+ * completions.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @param min_complete minimum number of completions to wait for
+ * @return -1 in case of error (errno is set)
+ */
+static int upump_uring_enter(struct upump_uring_mgr *uring_mgr,
+                             unsigned int min_complete)
+{
+    __atomic_store_n(uring_mgr->sq_tail, uring_mgr->sq_local_tail,
+                     __ATOMIC_RELEASE);
+    unsigned to_submit = uring_mgr->sq_local_tail -
+        __atomic_load_n(uring_mgr->sq_head, __ATOMIC_ACQUIRE);
+    if (!to_submit && !min_complete)
+        return 0;
+    return syscall(__NR_io_uring_enter, uring_mgr->fd, to_submit,
+                   min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0,
+                   NULL, 0);
+}
+
+/** @internal @This returns a free submission queue entry.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @param user_data user data of the request
+ * @return pointer to the entry, or NULL if the queue is full
+ */
+static struct io_uring_sqe *upump_uring_get_sqe(
+        struct upump_uring_mgr *uring_mgr, uint64_t user_data)
+{
+    unsigned head = __atomic_load_n(uring_mgr->sq_head, __ATOMIC_ACQUIRE);
+    if (unlikely(uring_mgr->sq_local_tail - head >= uring_mgr->sq_entries)) {
+        upump_uring_enter(uring_mgr, 0);
+        head = __atomic_load_n(uring_mgr->sq_head, __ATOMIC_ACQUIRE);
+        if (uring_mgr->sq_local_tail - head >= uring_mgr->sq_entries)
+            return NULL;
+    }
+
+    struct io_uring_sqe *sqe =
+        &uring_mgr->sqes[uring_mgr->sq_local_tail & uring_mgr->sq_mask];
+    uring_mgr->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+/** @internal @This returns the user data of the current request of a pump.
+ *
+ * @param upump_uring pointer to a upump_uring structure
+ * @return user data
+ */
+static inline uint64_t upump_uring_user_data(struct upump_uring *upump_uring)
+{
+    return ((uint64_t)upump_uring->gen << 32) | upump_uring->id;
+}
+
+/** @internal @This pops the next completion event.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @param cqe filled in with the completion event
+ * @return false if there is no pending completion
+ */
+static bool upump_uring_next_cqe(struct upump_uring_mgr *uring_mgr,
+                                 struct upump_uring_cqe *cqe)
+{
+    if (uring_mgr->stash_head < uring_mgr->stash_tail) {
+        *cqe = uring_mgr->stash[uring_mgr->stash_head++];
+        if (uring_mgr->stash_head == uring_mgr->stash_tail)
+            uring_mgr->stash_head = uring_mgr->stash_tail = 0;
+        return true;
+    }
+
+    unsigned head = *uring_mgr->cq_head;
+    if (head == __atomic_load_n(uring_mgr->cq_tail, __ATOMIC_ACQUIRE))
+        return false;
+    struct io_uring_cqe *io_cqe = &uring_mgr->cqes[head & uring_mgr->cq_mask];
+    cqe->user_data = io_cqe->user_data;
+    cqe->res = io_cqe->res;
+    __atomic_store_n(uring_mgr->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/** @internal @This waits for the completion of a given request. Other
+ * completions are kept for the next iteration of the event loop.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @param user_data user data of the request
+ * @return result of the request
+ */
+static int32_t upump_uring_wait(struct upump_uring_mgr *uring_mgr,
+                                uint64_t user_data)
+{
+    for (unsigned int i = uring_mgr->stash_head;
+         i < uring_mgr->stash_tail; i++)
+        if (uring_mgr->stash[i].user_data == user_data) {
+            int32_t res = uring_mgr->stash[i].res;
+            uring_mgr->stash[i].user_data = UPUMP_URING_IGNORE;
+            return res;
+        }
+
+    for ( ; ; ) {
+        unsigned head = *uring_mgr->cq_head;
+        while (head != __atomic_load_n(uring_mgr->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *io_cqe =
+                &uring_mgr->cqes[head & uring_mgr->cq_mask];
+            struct upump_uring_cqe cqe = {
+                .user_data = io_cqe->user_data,
+                .res = io_cqe->res
+            };
+            __atomic_store_n(uring_mgr->cq_head, ++head, __ATOMIC_RELEASE);
+            if (cqe.user_data == user_data)
+                return cqe.res;
+            if (cqe.user_data == UPUMP_URING_IGNORE)
+                continue;
+
+            if (uring_mgr->stash_tail >= uring_mgr->stash_size) {
+                unsigned int size = uring_mgr->stash_size ?
+                                    uring_mgr->stash_size * 2 : 16;
+                struct upump_uring_cqe *stash =
+                    realloc(uring_mgr->stash, size * sizeof(*stash));
+                if (unlikely(stash == NULL))
+                    continue;
+                uring_mgr->stash = stash;
+                uring_mgr->stash_size = size;
+            }
+            uring_mgr->stash[uring_mgr->stash_tail++] = cqe;
+        }
+
+        if (upump_uring_enter(uring_mgr, 1) < 0 && errno != EINTR)
+            return -errno;
+    }
+}
+
+/** @internal @This submits the request of a pump.
+ *
+ * @param upump_uring pointer to a upump_uring structure
+ */
+static void upump_uring_arm(struct upump_uring *upump_uring)
+{
+    struct upump *upump = upump_uring_to_upump(upump_uring);
+    struct upump_uring_mgr *uring_mgr =
+        upump_uring_mgr_from_upump_mgr(upump->mgr);
+    assert(!upump_uring->armed);
+
+    struct io_uring_sqe *sqe =
+        upump_uring_get_sqe(uring_mgr, upump_uring_user_data(upump_uring));
+    if (unlikely(sqe == NULL))
+        return;
+
+    switch (upump_uring->event) {
+        case UPUMP_TYPE_TIMER: {
+            /* the pump may be freed before the request is submitted */
+            struct __kernel_timespec *ts =
+                &uring_mgr->sq_ts[sqe - uring_mgr->sqes];
+            ts->tv_sec = upump_uring->timer.deadline / NSEC_PER_SEC;
+            ts->tv_nsec = upump_uring->timer.deadline % NSEC_PER_SEC;
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = (uintptr_t)ts;
+            sqe->len = 1;
+            sqe->timeout_flags = IORING_TIMEOUT_ABS;
+            break;
+        }
+        case UPUMP_TYPE_FD_READ:
+        case UPUMP_TYPE_SIGNAL:
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = upump_uring->fd;
+            sqe->poll32_events = POLLIN;
+            break;
+        case UPUMP_TYPE_FD_WRITE:
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = upump_uring->fd;
+            sqe->poll32_events = POLLOUT;
+            break;
+        case UPUMP_URING_TYPE_READ:
+        case UPUMP_URING_TYPE_WRITE:
+            sqe->opcode = upump_uring->event == UPUMP_URING_TYPE_READ ?
+                          IORING_OP_READ : IORING_OP_WRITE;
+            sqe->fd = upump_uring->fd;
+            sqe->addr = (uintptr_t)upump_uring->io.buf;
+            sqe->len = upump_uring->io.len;
+            sqe->off = upump_uring->io.offset;
+            break;
+    }
+    upump_uring->armed = true;
+}
+
+/** @internal @This cancels the request of a pump, if any.
+ *
+ * @param upump_uring pointer to a upump_uring structure
+ */
+static void upump_uring_disarm(struct upump_uring *upump_uring)
+{
+    if (!upump_uring->armed)
+        return;
+
+    struct upump *upump = upump_uring_to_upump(upump_uring);
+    struct upump_uring_mgr *uring_mgr =
+        upump_uring_mgr_from_upump_mgr(upump->mgr);
+    uint64_t user_data = upump_uring_user_data(upump_uring);
+    upump_uring->armed = false;
+    upump_uring->gen++;
+
+    struct io_uring_sqe *sqe =
+        upump_uring_get_sqe(uring_mgr, UPUMP_URING_IGNORE);
+    if (unlikely(sqe == NULL))
+        return;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    switch (upump_uring->event) {
+        case UPUMP_TYPE_TIMER:
+            sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+            break;
+        case UPUMP_TYPE_FD_READ:
+        case UPUMP_TYPE_FD_WRITE:
+        case UPUMP_TYPE_SIGNAL:
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            break;
+        default:
+            /* the buffer must not be accessed after this function returns */
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            upump_uring_wait(uring_mgr, user_data);
+            break;
+    }
+}
+
+/** @internal @This registers a pump in the table of ids.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @param upump_uring pointer to a upump_uring structure
+ * @return false in case of allocation error
+ */
+static bool upump_uring_mgr_add(struct upump_uring_mgr *uring_mgr,
+                                struct upump_uring *upump_uring)
+{
+    if (!uring_mgr->nb_free_ids) {
+        unsigned int nb_slots = uring_mgr->nb_slots ?
+                                uring_mgr->nb_slots * 2 : 16;
+        struct upump_uring **slots =
+            realloc(uring_mgr->slots, nb_slots * sizeof(*slots));
+        if (unlikely(slots == NULL))
+            return false;
+        uring_mgr->slots = slots;
+        uint32_t *free_ids =
+            realloc(uring_mgr->free_ids, nb_slots * sizeof(*free_ids));
+        if (unlikely(free_ids == NULL))
+            return false;
+        uring_mgr->free_ids = free_ids;
+        uint32_t *gens = realloc(uring_mgr->gens, nb_slots * sizeof(*gens));
+        if (unlikely(gens == NULL))
+            return false;
+        uring_mgr->gens = gens;
+
+        for (unsigned int i = nb_slots; i > uring_mgr->nb_slots; i--) {
+            slots[i - 1] = NULL;
+            gens[i - 1] = 0;
+            free_ids[uring_mgr->nb_free_ids++] = i - 1;
+        }
+        uring_mgr->nb_slots = nb_slots;
+    }
+
+    upump_uring->id = uring_mgr->free_ids[--uring_mgr->nb_free_ids];
+    upump_uring->gen = uring_mgr->gens[upump_uring->id];
+    uring_mgr->slots[upump_uring->id] = upump_uring;
+    return true;
+}
+
+/** @internal @This unregisters a pump from the table of ids. Its
+ * generation is kept for the next pump using the id, as cancelled requests
+ * may still complete.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @param upump_uring pointer to a upump_uring structure
+ */
+static void upump_uring_mgr_remove(struct upump_uring_mgr *uring_mgr,
+                                   struct upump_uring *upump_uring)
+{
+    uring_mgr->slots[upump_uring->id] = NULL;
+    uring_mgr->gens[upump_uring->id] = upump_uring->gen;
+    uring_mgr->free_ids[uring_mgr->nb_free_ids++] = upump_uring->id;
+}
+
+/** @This allocates a new upump_uring.
+ *
+ * @param mgr pointer to a upump_mgr structure wrapped into a
+ * upump_uring_mgr structure
+ * @param event type of event to watch for
+ * @param args optional parameters depending on event type
+ * @return pointer to allocated pump, or NULL in case of failure
+ */
+static struct upump *upump_uring_alloc(struct upump_mgr *mgr,
+                                       int event, va_list args)
+{
+    if (event >= UPUMP_TYPE_LOCAL) {
+        unsigned int signature = va_arg(args, unsigned int);
+        if (signature != mgr->signature)
+            return NULL;
+    }
+
+    struct upump_uring_mgr *uring_mgr = upump_uring_mgr_from_upump_mgr(mgr);
+    struct upump_uring *upump_uring =
+        upool_alloc(&uring_mgr->common_mgr.upump_pool, struct upump_uring *);
+    if (unlikely(upump_uring == NULL))
+        return NULL;
+    struct upump *upump = upump_uring_to_upump(upump_uring);
+
+    switch (event) {
+        case UPUMP_TYPE_IDLER:
+            upump_uring->fd = -1;
+            break;
+        case UPUMP_TYPE_TIMER:
+            upump_uring->fd = -1;
+            upump_uring->timer.after = va_arg(args, uint64_t);
+            upump_uring->timer.repeat = va_arg(args, uint64_t);
+            break;
+        case UPUMP_TYPE_FD_READ:
+        case UPUMP_TYPE_FD_WRITE:
+            upump_uring->fd = va_arg(args, int);
+            break;
+        case UPUMP_TYPE_SIGNAL: {
+            upump_uring->signal.signum = va_arg(args, int);
+            upump_uring->signal.unblock = false;
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigaddset(&mask, upump_uring->signal.signum);
+            upump_uring->fd = signalfd(-1, &mask, SFD_NONBLOCK);
+            if (upump_uring->fd == -1) {
+                upool_free(&uring_mgr->common_mgr.upump_pool, upump_uring);
+                return NULL;
+            }
+            break;
+        }
+        case UPUMP_URING_TYPE_READ:
+        case UPUMP_URING_TYPE_WRITE:
+            upump_uring->fd = va_arg(args, int);
+            upump_uring->io.buf = va_arg(args, void *);
+            upump_uring->io.len = va_arg(args, size_t);
+            upump_uring->io.offset = va_arg(args, uint64_t);
+            upump_uring->io.result = 0;
+            break;
+        default:
+            upool_free(&uring_mgr->common_mgr.upump_pool, upump_uring);
+            return NULL;
+    }
+
+    if (unlikely(!upump_uring_mgr_add(uring_mgr, upump_uring))) {
+        if (event == UPUMP_TYPE_SIGNAL)
+            close(upump_uring->fd);
+        upool_free(&uring_mgr->common_mgr.upump_pool, upump_uring);
+        return NULL;
+    }
+    uchain_init(&upump_uring->uchain);
+    uchain_init(&upump_uring->idler_uchain);
+    upump_uring->event = event;
+    upump_uring->armed = false;
+    upump_uring->expired = false;
+    upump_uring->active = false;
+    upump_uring->blocking = false;
+    upump_uring->free = false;
+    ulist_add(&uring_mgr->upumps, &upump_uring->uchain);
+
+    upump_common_init(upump);
+
+    return upump;
+}
+
+/** @internal @This blocks the signal of a pump in the calling thread, so
+ * that its default action does not run.
+ *
+ * @param upump_uring pointer to a upump_uring structure
+ */
+static void upump_uring_block_signal(struct upump_uring *upump_uring)
+{
+    sigset_t mask, old;
+    sigemptyset(&mask);
+    sigaddset(&mask, upump_uring->signal.signum);
+    pthread_sigmask(SIG_BLOCK, &mask, &old);
+    upump_uring->signal.unblock =
+        !sigismember(&old, upump_uring->signal.signum);
+}
+
+/** @internal @This restores the signal mask changed by
+ * @ref upump_uring_block_signal.
+ *
+ * @param upump_uring pointer to a upump_uring structure
+ */
+static void upump_uring_unblock_signal(struct upump_uring *upump_uring)
+{
+    if (!upump_uring->signal.unblock)
+        return;
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, upump_uring->signal.signum);
+    pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+    upump_uring->signal.unblock = false;
+}
+
+/** @internal @This updates the number of pumps keeping the event loop
+ * running, after the state of a pump changed.
+ *
+ * @param upump_uring pointer to a upump_uring structure
+ */
+static void upump_uring_update_blocking(struct upump_uring *upump_uring)
+{
+    struct upump *upump = upump_uring_to_upump(upump_uring);
+    struct upump_uring_mgr *uring_mgr =
+        upump_uring_mgr_from_upump_mgr(upump->mgr);
+    bool blocking = upump_uring->active && upump_uring->common.status &&
+                    !upump_uring->expired;
+    if (blocking == upump_uring->blocking)
+        return;
+    upump_uring->blocking = blocking;
+    if (blocking)
+        uring_mgr->nb_blocking++;
+    else
+        uring_mgr->nb_blocking--;
+}
+
+/** @This starts a pump.
+ *
+ * @param upump description structure of the pump
+ * @param status blocking status of the pump
+ */
+static void upump_uring_real_start(struct upump *upump, bool status)
+{
+    struct upump_uring *upump_uring = upump_uring_from_upump(upump);
+    struct upump_uring_mgr *uring_mgr =
+        upump_uring_mgr_from_upump_mgr(upump->mgr);
+
+    upump_uring->active = true;
+    switch (upump_uring->event) {
+        case UPUMP_TYPE_IDLER:
+            ulist_add(&uring_mgr->idlers, &upump_uring->idler_uchain);
+            break;
+        case UPUMP_TYPE_TIMER:
+            upump_uring->timer.deadline = upump_uring_now() +
+                upump_uring_ticks_to_ns(upump_uring->timer.after);
+            upump_uring->expired = false;
+            upump_uring_arm(upump_uring);
+            break;
+        case UPUMP_TYPE_SIGNAL:
+            upump_uring_block_signal(upump_uring);
+            upump_uring->expired = false;
+            upump_uring_arm(upump_uring);
+            break;
+        default:
+            upump_uring->expired = false;
+            upump_uring_arm(upump_uring);
+            break;
+    }
+    upump_uring_update_blocking(upump_uring);
+}
+
+/** @This stops a pump.
+ *
+ * @param upump description structure of the pump
+ * @param status blocking status of the pump
+ */
+static void upump_uring_real_stop(struct upump *upump, bool status)
+{
+    struct upump_uring *upump_uring = upump_uring_from_upump(upump);
+
+    upump_uring->active = false;
+    if (upump_uring->event == UPUMP_TYPE_IDLER)
+        ulist_delete(&upump_uring->idler_uchain);
+    else
+        upump_uring_disarm(upump_uring);
+    if (upump_uring->event == UPUMP_TYPE_SIGNAL)
+        upump_uring_unblock_signal(upump_uring);
+    upump_uring_update_blocking(upump_uring);
+}
+
+/** @This restarts a pump.
+ *
+ * @param upump description structure of the pump
+ * @param status blocking status of the pump
+ */
+static void upump_uring_real_restart(struct upump *upump, bool status)
+{
+    struct upump_uring *upump_uring = upump_uring_from_upump(upump);
+    if (!upump_uring->active) {
+        /* the pump was not started */
+        upump_uring_real_start(upump, status);
+        return;
+    }
+
+    switch (upump_uring->event) {
+        case UPUMP_TYPE_TIMER: {
+            uint64_t value = upump_uring->armed && upump_uring->timer.repeat ?
+                upump_uring->timer.repeat : upump_uring->timer.after;
+            upump_uring_disarm(upump_uring);
+            upump_uring->timer.deadline = upump_uring_now() +
+                upump_uring_ticks_to_ns(value);
+            upump_uring->expired = false;
+            upump_uring_arm(upump_uring);
+            break;
+        }
+        case UPUMP_URING_TYPE_READ:
+        case UPUMP_URING_TYPE_WRITE:
+            upump_uring_disarm(upump_uring);
+            upump_uring->expired = false;
+            upump_uring_arm(upump_uring);
+            break;
+        default:
+            break;
+    }
+    upump_uring_update_blocking(upump_uring);
+}
+
+/** @This releases the memory space previously used by a pump.
+ *
+ * @param upump description structure of the pump
+ */
+static void upump_uring_free(struct upump *upump)
+{
+    struct upump_uring_mgr *uring_mgr =
+        upump_uring_mgr_from_upump_mgr(upump->mgr);
+    upump_stop(upump);
+    upump_common_clean(upump);
+    struct upump_uring *upump_uring = upump_uring_from_upump(upump);
+    upump_uring_mgr_remove(uring_mgr, upump_uring);
+    if (upump_uring->event == UPUMP_TYPE_SIGNAL)
+        close(upump_uring->fd);
+    if (uring_mgr->running)
+        upump_uring->free = true;
+    else {
+        ulist_delete(&upump_uring->uchain);
+        upool_free(&uring_mgr->common_mgr.upump_pool, upump_uring);
+    }
+}
+
+/** @internal @This allocates the data structure.
+ *
+ * @param upool pointer to upool
+ * @return pointer to upump_uring or NULL in case of allocation error
+ */
+static void *upump_uring_alloc_inner(struct upool *upool)
+{
+    struct upump_common_mgr *common_mgr =
+        upump_common_mgr_from_upump_pool(upool);
+    struct upump_uring *upump_uring = malloc(sizeof(struct upump_uring));
+    if (unlikely(upump_uring == NULL))
+        return NULL;
+    struct upump *upump = upump_uring_to_upump(upump_uring);
+    upump->mgr = upump_common_mgr_to_upump_mgr(common_mgr);
+    return upump_uring;
+}
+
+/** @internal @This frees a upump_uring.
+ *
+ * @param upool pointer to upool
+ * @param upump_uring pointer to a upump_uring structure to free
+ */
+static void upump_uring_free_inner(struct upool *upool, void *upump_uring)
+{
+    free(upump_uring);
+}
+
+/** @internal @This sets the buffer of the next operation.
+ *
+ * @param upump description structure of the pump
+ * @param buf buffer
+ * @param len size of the buffer
+ * @param offset position in the file
+ * @return an error code
+ */
+static int _upump_uring_set_buffer(struct upump *upump, void *buf,
+                                   size_t len, uint64_t offset)
+{
+    struct upump_uring *upump_uring = upump_uring_from_upump(upump);
+    if (upump_uring->event != UPUMP_URING_TYPE_READ &&
+        upump_uring->event != UPUMP_URING_TYPE_WRITE)
+        return UBASE_ERR_INVALID;
+    if (upump_uring->armed)
+        return UBASE_ERR_BUSY;
+    upump_uring->io.buf = buf;
+    upump_uring->io.len = len;
+    upump_uring->io.offset = offset;
+    return UBASE_ERR_NONE;
+}
+
+/** @This processes control commands on a upump_uring.
+ *
+ * @param upump description structure of the pump
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upump_uring_control(struct upump *upump, int command, va_list args)
+{
+    switch (command) {
+        case UPUMP_START:
+            upump_common_start(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_RESTART:
+            upump_common_restart(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_STOP:
+            upump_common_stop(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_FREE:
+            upump_uring_free(upump);
+            return UBASE_ERR_NONE;
+        case UPUMP_GET_STATUS: {
+            int *status_p = va_arg(args, int *);
+            upump_common_get_status(upump, status_p);
+            return UBASE_ERR_NONE;
+        }
+        case UPUMP_SET_STATUS: {
+            int status = va_arg(args, int);
+            upump_common_set_status(upump, status);
+            return UBASE_ERR_NONE;
+        }
+        case UPUMP_ALLOC_BLOCKER: {
+            struct upump_blocker **p = va_arg(args, struct upump_blocker **);
+            *p = upump_common_blocker_alloc(upump);
+            return UBASE_ERR_NONE;
+        }
+        case UPUMP_FREE_BLOCKER: {
+            struct upump_blocker *blocker =
+                va_arg(args, struct upump_blocker *);
+            upump_common_blocker_free(blocker);
+            return UBASE_ERR_NONE;
+        }
+
+        case UPUMP_URING_GET_RESULT: {
+            UBASE_SIGNATURE_CHECK(args, UPUMP_URING_SIGNATURE)
+            ssize_t *result_p = va_arg(args, ssize_t *);
+            struct upump_uring *upump_uring = upump_uring_from_upump(upump);
+            *result_p = upump_uring->io.result;
+            return UBASE_ERR_NONE;
+        }
+        case UPUMP_URING_SET_BUFFER: {
+            UBASE_SIGNATURE_CHECK(args, UPUMP_URING_SIGNATURE)
+            void *buf = va_arg(args, void *);
+            size_t len = va_arg(args, size_t);
+            uint64_t offset = va_arg(args, uint64_t);
+            return _upump_uring_set_buffer(upump, buf, len, offset);
+        }
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @internal @This handles a completion event.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @param cqe completion event
+ */
+static void upump_uring_complete(struct upump_uring_mgr *uring_mgr,
+                                 const struct upump_uring_cqe *cqe)
+{
+    uint32_t id = cqe->user_data;
+    if (cqe->user_data == UPUMP_URING_IGNORE || id >= uring_mgr->nb_slots)
+        return;
+    struct upump_uring *upump_uring = uring_mgr->slots[id];
+    if (upump_uring == NULL || !upump_uring->armed ||
+        upump_uring->gen != (uint32_t)(cqe->user_data >> 32))
+        return;
+    struct upump *upump = upump_uring_to_upump(upump_uring);
+    upump_uring->armed = false;
+    upump_uring->gen++;
+
+    switch (upump_uring->event) {
+        case UPUMP_TYPE_TIMER:
+            if (cqe->res != -ETIME && cqe->res != 0)
+                return;
+            if (upump_uring->timer.repeat) {
+                uint64_t now = upump_uring_now();
+                upump_uring->timer.deadline +=
+                    upump_uring_ticks_to_ns(upump_uring->timer.repeat);
+                if (upump_uring->timer.deadline < now)
+                    upump_uring->timer.deadline = now;
+                upump_uring_arm(upump_uring);
+            } else {
+                upump_uring->expired = true;
+                upump_uring_update_blocking(upump_uring);
+            }
+            upump_common_dispatch(upump);
+            return;
+
+        case UPUMP_TYPE_SIGNAL:
+        case UPUMP_TYPE_FD_READ:
+        case UPUMP_TYPE_FD_WRITE:
+            if (cqe->res == -EINTR || cqe->res == -EAGAIN ||
+                cqe->res == -ECANCELED)
+                /* transient error, poll again */
+                break;
+            if (cqe->res < 0) {
+                /* the file descriptor cannot be polled: stop polling it and
+                 * let the callback find out the error, as libev does */
+                upump_uring->expired = true;
+                upump_uring_update_blocking(upump_uring);
+                upump_common_dispatch(upump);
+                return;
+            }
+            if (upump_uring->event == UPUMP_TYPE_SIGNAL) {
+                struct signalfd_siginfo siginfo;
+                if (read(upump_uring->fd, &siginfo, sizeof(siginfo)) != -1)
+                    upump_common_dispatch(upump);
+            } else
+                upump_common_dispatch(upump);
+            break;
+
+        case UPUMP_URING_TYPE_READ:
+        case UPUMP_URING_TYPE_WRITE:
+            upump_uring->io.result = cqe->res;
+            upump_uring->expired = true;
+            upump_uring_update_blocking(upump_uring);
+            upump_common_dispatch(upump);
+            return;
+    }
+
+    /* poll requests are one-shot */
+    if (!upump_uring->free && !upump_uring->armed &&
+        upump_uring->common.started &&
+        ulist_empty(&upump_uring->common.blockers))
+        upump_uring_arm(upump_uring);
+}
+
+/** @internal @This dispatches the started idlers. Idlers started by the
+ * callbacks are only dispatched at the next iteration.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ */
+static void upump_uring_mgr_idle(struct upump_uring_mgr *uring_mgr)
+{
+    /* idlers stopped by a callback are removed from the pending list */
+    struct uchain pending, *uchain;
+    ulist_init(&pending);
+    while ((uchain = ulist_pop(&uring_mgr->idlers)) != NULL)
+        ulist_add(&pending, uchain);
+
+    while ((uchain = ulist_pop(&pending)) != NULL) {
+        ulist_add(&uring_mgr->idlers, uchain);
+        struct upump_uring *upump_uring =
+            upump_uring_from_idler_uchain(uchain);
+        upump_common_dispatch(upump_uring_to_upump(upump_uring));
+    }
+}
+
+/** @internal @This runs an event loop.
+ *
+ * @param mgr pointer to a upump_mgr structure
+ * @param mutex mutual exclusion primitives to access the event loop
+ * @return an error code
+ */
+static int upump_uring_mgr_run(struct upump_mgr *mgr, struct umutex *mutex)
+{
+    struct upump_uring_mgr *uring_mgr = upump_uring_mgr_from_upump_mgr(mgr);
+    int err = UBASE_ERR_NONE;
+
+    if (mutex != NULL)
+        umutex_lock(mutex);
+
+    while (uring_mgr->nb_blocking) {
+        bool wait = ulist_empty(&uring_mgr->idlers) &&
+            uring_mgr->stash_head == uring_mgr->stash_tail &&
+            *uring_mgr->cq_head ==
+                __atomic_load_n(uring_mgr->cq_tail, __ATOMIC_ACQUIRE);
+        if (wait && mutex != NULL)
+            umutex_unlock(mutex);
+        int ret = upump_uring_enter(uring_mgr, wait ? 1 : 0);
+        int errnum = errno;
+        if (wait && mutex != NULL)
+            umutex_lock(mutex);
+        if (ret < 0 && errnum != EINTR && errnum != EAGAIN &&
+            errnum != EBUSY) {
+            err = UBASE_ERR_EXTERNAL;
+            break;
+        }
+
+        uring_mgr->running = true;
+
+        unsigned int nb_events = 0;
+        struct upump_uring_cqe cqe;
+        while (upump_uring_next_cqe(uring_mgr, &cqe)) {
+            upump_uring_complete(uring_mgr, &cqe);
+            nb_events++;
+        }
+
+        if (!nb_events && !ulist_empty(&uring_mgr->idlers))
+            upump_uring_mgr_idle(uring_mgr);
+
+        uring_mgr->running = false;
+
+        struct uchain *uchain, *uchain_tmp;
+        ulist_delete_foreach(&uring_mgr->upumps, uchain, uchain_tmp) {
+            struct upump_uring *upump_uring = upump_uring_from_uchain(uchain);
+            if (upump_uring->free) {
+                ulist_delete(&upump_uring->uchain);
+                upool_free(&uring_mgr->common_mgr.upump_pool, upump_uring);
+            }
+        }
+    }
+
+    /* submit the pending cancellations */
+    upump_uring_enter(uring_mgr, 0);
+
+    if (mutex != NULL)
+        umutex_unlock(mutex);
+    return err;
+}
+
+/** @This processes control commands on a upump_uring_mgr.
+ *
+ * @param mgr pointer to a upump_mgr structure
+ * @param command type of command to process
+ * @param args arguments of the command
+ * @return an error code
+ */
+static int upump_uring_mgr_control(struct upump_mgr *mgr,
+                                   int command, va_list args)
+{
+    switch (command) {
+        case UPUMP_MGR_RUN: {
+            struct umutex *mutex = va_arg(args, struct umutex *);
+            return upump_uring_mgr_run(mgr, mutex);
+        }
+        case UPUMP_MGR_VACUUM:
+            upump_common_mgr_vacuum(mgr);
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** @internal @This unmaps the rings and closes the io_uring.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ */
+static void upump_uring_mgr_close(struct upump_uring_mgr *uring_mgr)
+{
+    if (uring_mgr->sqes != MAP_FAILED)
+        munmap(uring_mgr->sqes, uring_mgr->sqes_size);
+    if (uring_mgr->cq_ring != MAP_FAILED)
+        munmap(uring_mgr->cq_ring, uring_mgr->cq_ring_size);
+    if (uring_mgr->sq_ring != MAP_FAILED)
+        munmap(uring_mgr->sq_ring, uring_mgr->sq_ring_size);
+    free(uring_mgr->sq_ts);
+    close(uring_mgr->fd);
+}
+
+/** @internal @This creates the io_uring and maps its rings.
+ *
+ * @param uring_mgr pointer to a upump_uring_mgr structure
+ * @return false in case of error
+ */
+static bool upump_uring_mgr_open(struct upump_uring_mgr *uring_mgr)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    uring_mgr->fd = syscall(__NR_io_uring_setup, UPUMP_URING_ENTRIES,
+                            &params);
+    if (uring_mgr->fd < 0)
+        return false;
+
+    uring_mgr->sq_ring = uring_mgr->cq_ring = uring_mgr->sqes = MAP_FAILED;
+    uring_mgr->sq_ts = NULL;
+    uring_mgr->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring_mgr->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP &&
+        uring_mgr->cq_ring_size > uring_mgr->sq_ring_size)
+        uring_mgr->sq_ring_size = uring_mgr->cq_ring_size;
+
+    uring_mgr->sq_ring = mmap(NULL, uring_mgr->sq_ring_size,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, uring_mgr->fd,
+                              IORING_OFF_SQ_RING);
+    if (uring_mgr->sq_ring == MAP_FAILED)
+        goto upump_uring_mgr_open_err;
+
+    void *cq_ring = uring_mgr->sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        uring_mgr->cq_ring = mmap(NULL, uring_mgr->cq_ring_size,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, uring_mgr->fd,
+                                  IORING_OFF_CQ_RING);
+        if (uring_mgr->cq_ring == MAP_FAILED)
+            goto upump_uring_mgr_open_err;
+        cq_ring = uring_mgr->cq_ring;
+    }
+
+    uring_mgr->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring_mgr->sqes = mmap(NULL, uring_mgr->sqes_size,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, uring_mgr->fd,
+                           IORING_OFF_SQES);
+    if (uring_mgr->sqes == MAP_FAILED)
+        goto upump_uring_mgr_open_err;
+
+    uint8_t *sq = uring_mgr->sq_ring;
+    uring_mgr->sq_head = (unsigned *)(sq + params.sq_off.head);
+    uring_mgr->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    uring_mgr->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    uring_mgr->sq_entries = *(unsigned *)(sq + params.sq_off.ring_entries);
+    uring_mgr->sq_local_tail = *uring_mgr->sq_tail;
+    uring_mgr->sq_ts = malloc(uring_mgr->sq_entries *
+                              sizeof(*uring_mgr->sq_ts));
+    if (uring_mgr->sq_ts == NULL)
+        goto upump_uring_mgr_open_err;
+    unsigned *sq_array = (unsigned *)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < uring_mgr->sq_entries; i++)
+        sq_array[i] = i;
+
+    uint8_t *cq = cq_ring;
+    uring_mgr->cq_head = (unsigned *)(cq + params.cq_off.head);
+    uring_mgr->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    uring_mgr->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    uring_mgr->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return true;
+
+upump_uring_mgr_open_err:
+    upump_uring_mgr_close(uring_mgr);
+    return false;
+}
+
+/** @This frees a upump manager.
+ *
+ * @param urefcount pointer to urefcount
+ */
+static void upump_uring_mgr_free(struct urefcount *urefcount)
+{
+    struct upump_uring_mgr *uring_mgr =
+        upump_uring_mgr_from_urefcount(urefcount);
+    upump_common_mgr_clean(upump_uring_mgr_to_upump_mgr(uring_mgr));
+    upump_uring_mgr_close(uring_mgr);
+    free(uring_mgr->stash);
+    free(uring_mgr->slots);
+    free(uring_mgr->free_ids);
+    free(uring_mgr->gens);
+    free(uring_mgr);
+}
+
+/** @This allocates and initializes a upump_uring_mgr structure.
+ *
+ * @param upump_pool_depth maximum number of upump structures in the pool
+ * @param upump_blocker_pool_depth maximum number of upump_blocker structures in
+ * the pool
+ * @return pointer to the wrapped upump_mgr structure
+ */
+struct upump_mgr *upump_uring_mgr_alloc(uint16_t upump_pool_depth,
+                                        uint16_t upump_blocker_pool_depth)
+{
+    struct upump_uring_mgr *uring_mgr =
+        malloc(sizeof(struct upump_uring_mgr) +
+               upump_common_mgr_sizeof(upump_pool_depth,
+                                       upump_blocker_pool_depth));
+    if (unlikely(uring_mgr == NULL))
+        return NULL;
+
+    if (unlikely(!upump_uring_mgr_open(uring_mgr))) {
+        free(uring_mgr);
+        return NULL;
+    }
+
+    struct upump_mgr *mgr = upump_uring_mgr_to_upump_mgr(uring_mgr);
+    mgr->signature = UPUMP_URING_SIGNATURE;
+    urefcount_init(upump_uring_mgr_to_urefcount(uring_mgr),
+                   upump_uring_mgr_free);
+    uring_mgr->common_mgr.mgr.refcount =
+        upump_uring_mgr_to_urefcount(uring_mgr);
+    uring_mgr->common_mgr.mgr.upump_alloc = upump_uring_alloc;
+    uring_mgr->common_mgr.mgr.upump_control = upump_uring_control;
+    uring_mgr->common_mgr.mgr.upump_mgr_control = upump_uring_mgr_control;
+    upump_common_mgr_init(mgr, upump_pool_depth, upump_blocker_pool_depth,
+                          uring_mgr->upool_extra,
+                          upump_uring_real_start, upump_uring_real_stop,
+                          upump_uring_real_restart,
+                          upump_uring_alloc_inner, upump_uring_free_inner);
+
+    uring_mgr->stash = NULL;
+    uring_mgr->stash_head = uring_mgr->stash_tail = 0;
+    uring_mgr->stash_size = 0;
+    uring_mgr->slots = NULL;
+    uring_mgr->nb_slots = 0;
+    uring_mgr->free_ids = NULL;
+    uring_mgr->gens = NULL;
+    uring_mgr->nb_free_ids = 0;
+    ulist_init(&uring_mgr->upumps);
+    uring_mgr->nb_blocking = 0;
+    ulist_init(&uring_mgr->idlers);
+    uring_mgr->running = false;
+    return mgr;
+}
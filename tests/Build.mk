@@ -72,10 +72,26 @@ tests += umem_alloc_test
 umem_alloc_test-src = umem_alloc_test.c
 umem_alloc_test-libs = libupipe
 
+tests += umem_huge_test
+umem_huge_test-src = umem_huge_test.c
+umem_huge_test-libs = libupipe
+
 tests += umem_pool_test
 umem_pool_test-src = umem_pool_test.c
 umem_pool_test-libs = libupipe
 
+tests += umem_pthread_pool_test
+umem_pthread_pool_test-src = umem_pthread_pool_test.c
+umem_pthread_pool_test-libs = libupipe libupipe_pthread pthread
+
+tests += upump_pthread_pool_test
+upump_pthread_pool_test-src = upump_pthread_pool_test.c
+upump_pthread_pool_test-libs = libupipe libupipe_pthread libupump_ev pthread
+
+tests += umpmc_test
+umpmc_test-src = umpmc_test.c
+umpmc_test-libs = libupipe pthread
+
 tests += upipe_a52_framer_test
 upipe_a52_framer_test-src = upipe_a52_framer_test.c
 upipe_a52_framer_test-libs = libupipe libupipe_framers bitstream
@@ -313,6 +329,11 @@ tests += upipe_probe_uref_test
 upipe_probe_uref_test-src = upipe_probe_uref_test.c
 upipe_probe_uref_test-libs = libupipe libupipe_modules
 
+tests += upipe_pthread_transfer_test
+upipe_pthread_transfer_test-src = upipe_pthread_transfer_test.c
+upipe_pthread_transfer_test-libs = libupipe libupipe_modules libupipe_pthread \
+                                   libupump_ev pthread
+
 tests += upipe_queue_test
 upipe_queue_test-src = upipe_queue_test.c
 upipe_queue_test-libs = libupipe libupipe_modules libupump_ev
@@ -381,6 +402,10 @@ tests += upipe_swr_test
 upipe_swr_test-src = upipe_swr_test.c
 upipe_swr_test-libs = libupipe libupipe_modules libupipe_swresample
 
+tests += upipe_sws_multi_test
+upipe_sws_multi_test-src = upipe_sws_multi_test.c
+upipe_sws_multi_test-libs = libupipe libupipe_swscale libswscale
+
 tests += upipe_sws_test
 upipe_sws_test-src = upipe_sws_test.c
 upipe_sws_test-libs = libupipe libupipe_swscale libswscale libavutil
@@ -417,6 +442,14 @@ tests += upipe_ts_encaps_test
 upipe_ts_encaps_test-src = upipe_ts_encaps_test.c
 upipe_ts_encaps_test-libs = libupipe libupipe_ts bitstream
 
+tests += upipe_ts_monitor_test
+upipe_ts_monitor_test-src = upipe_ts_monitor_test.c
+upipe_ts_monitor_test-libs = libupipe libupipe_ts bitstream
+
+tests += upipe_ts_mux_test
+upipe_ts_mux_test-src = upipe_ts_mux_test.c
+upipe_ts_mux_test-libs = libupipe libupipe_ts bitstream
+
 tests += upipe_ts_nit_decoder_test
 upipe_ts_nit_decoder_test-src = upipe_ts_nit_decoder_test.c
 upipe_ts_nit_decoder_test-libs = libupipe libupipe_ts bitstream
@@ -564,11 +597,11 @@ upipe_worker_test-libs = libupipe libupipe_modules libupipe_pthread \
 
 tests += upipe_x264_test
 upipe_x264_test-src = upipe_x264_test.c
-upipe_x264_test-libs = libupipe libupipe_x264
+upipe_x264_test-libs = libupipe libupipe_x264 libupump_ev
 
 tests += upipe_x265_test
 upipe_x265_test-src = upipe_x265_test.c
-upipe_x265_test-libs = libupipe libupipe_x265
+upipe_x265_test-libs = libupipe libupipe_x265 libupump_ev
 check-$(builddir)/upipe_x265_test: log-env += ASAN_OPTIONS="detect_leaks=0"
 
 tests += upipe_zoneplate_source_test
@@ -645,6 +678,10 @@ tests += upump_srt_test
 upump_srt_test-src = upump_srt_test.c upump_common_test.c upump_common_test.h
 upump_srt_test-libs = libupump_srt srt
 
+tests += upump_uring_test
+upump_uring_test-src = upump_uring_test.c upump_common_test.c upump_common_test.h
+upump_uring_test-libs = libupump_uring pthread
+
 $(builddir)/upump_common_test.o: CFLAGS += $(call try_cc,-Wno-logical-op)
 
 tests += uref_dump_test.sh
@@ -665,12 +702,20 @@ test-targets += uref_uri_test
 uref_uri_test-src = uref_uri_test.c
 uref_uri_test-libs = libupipe
 
+tests += ustats_test
+ustats_test-src = ustats_test.c
+ustats_test-libs = libupipe libupipe_modules ustats
+
 tests += ustring_test.sh
 ustring_test.sh-deps = ustring_test
 
 test-targets += ustring_test
 ustring_test-src = ustring_test.c
 
+tests += utrace_ring_test
+utrace_ring_test-src = utrace_ring_test.c
+utrace_ring_test-libs = libupipe utrace
+
 tests += uuri_test
 uuri_test-src = uuri_test.c
 uuri_test-libs = libupipe
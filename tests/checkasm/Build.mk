@@ -8,6 +8,7 @@ checkasm-src = \
     planar8_input.c \
     sdi_input.c \
     timer.h \
+    ts_scan.c \
     uyvy_input.c \
     v210_input.c
 
@@ -26,4 +27,6 @@ $(builddir)/checkasm: \
     $(top_builddir)/lib/upipe-hbrmt/sdienc.o \
     $(top_builddir)/lib/upipe-hbrmt/sdidec.o \
     $(top_builddir)/lib/upipe-hbrmt/x86/sdienc.o \
-    $(top_builddir)/lib/upipe-hbrmt/x86/sdidec.o
+    $(top_builddir)/lib/upipe-hbrmt/x86/sdidec.o \
+    $(top_builddir)/lib/upipe-ts/ts_scan.o \
+    $(top_builddir)/lib/upipe-ts/x86/ts_scan.o
@@ -78,6 +78,7 @@ static const struct {
     { "planar10_input", checkasm_check_planar10_input },
     { "planar8_input", checkasm_check_planar8_input },
     { "sdi_input", checkasm_check_sdi_input },
+    { "ts_scan", checkasm_check_ts_scan },
     { "uyvy_input", checkasm_check_uyvy_input },
     { "v210_input", checkasm_check_v210_input },
     { NULL, NULL }
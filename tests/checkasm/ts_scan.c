@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "lib/upipe-ts/ts_scan.h"
+
+#define NUM_PACKETS 64
+
+static void randomize_buffers(uint8_t *src, uintptr_t stride, int lost)
+{
+    for (uintptr_t i = 0; i < NUM_PACKETS * stride; i++)
+        src[i] = rnd();
+    for (int i = 0; i < NUM_PACKETS; i++)
+        src[i * stride] = 0x47;
+    if (lost >= 0)
+        src[lost * stride] = 0xff;
+}
+
+void checkasm_check_ts_scan(void)
+{
+    struct {
+        uintptr_t (*scan)(const uint8_t *src, uint8_t *pids,
+                          uintptr_t stride, uintptr_t packets);
+    } s = {
+#ifdef HAVE_BITSTREAM
+        .scan = upipe_ts_scan_c,
+#endif
+    };
+
+#ifdef HAVE_X86ASM
+#ifdef HAVE_BITSTREAM
+    int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_SSE2) {
+        s.scan = upipe_ts_scan_sse2;
+    }
+    if (cpu_flags & AV_CPU_FLAG_AVX2) {
+        s.scan = upipe_ts_scan_avx2;
+    }
+#endif
+#endif
+
+    static const uintptr_t strides[] = { 188, 204 };
+    for (int i = 0; i < 2; i++) {
+        uintptr_t stride = strides[i];
+        if (check_func(s.scan, "ts_scan_%u", (unsigned)stride)) {
+            uint8_t src[NUM_PACKETS * 204];
+            uint8_t pids0[2 * NUM_PACKETS];
+            uint8_t pids1[2 * NUM_PACKETS];
+            declare_func(uintptr_t, const uint8_t *src, uint8_t *pids,
+                         uintptr_t stride, uintptr_t packets);
+
+            for (int lost = -1; lost < NUM_PACKETS; lost += 13) {
+                randomize_buffers(src, stride, lost);
+                uintptr_t ret0 = call_ref(src, pids0, stride, NUM_PACKETS);
+                uintptr_t ret1 = call_new(src, pids1, stride, NUM_PACKETS);
+                if (ret0 != ret1 || memcmp(pids0, pids1, 2 * ret0))
+                    fail();
+            }
+            randomize_buffers(src, stride, -1);
+            bench_new(src, pids1, stride, NUM_PACKETS);
+        }
+    }
+    report("ts_scan");
+}
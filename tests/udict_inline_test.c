@@ -24,11 +24,25 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
 #include <assert.h>
 
 #define UDICT_POOL_DEPTH 1
 
 #define SALUTATION "Hello everyone, this is just some padding to make the structure bigger, if you don't mind."
+/** number of named attributes in the lookup test */
+#define NB_NAMED 64
+/** number of lookups in the benchmark */
+#define BENCH_LOOPS 100000
+
+/** @This returns a monotonic time in nanoseconds. */
+static uint64_t now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * UINT64_C(1000000000) + t.tv_nsec;
+}
 
 int main(int argc, char **argv)
 {
@@ -143,6 +157,78 @@ int main(int argc, char **argv)
         udict_free(udict2);
     }
 
+    {
+        /* many named attributes, to exercise the hash index */
+        struct udict *udict1 = udict_alloc(mgr, 0);
+        assert(udict1 != NULL);
+        char name[32];
+        for (unsigned i = 0; i < NB_NAMED; i++) {
+            snprintf(name, sizeof(name), "x.attr%u", i);
+            ubase_assert(udict_set_unsigned(udict1, i, UDICT_TYPE_UNSIGNED,
+                                            name));
+            ubase_assert(udict_set_void(udict1, NULL, UDICT_TYPE_VOID, name));
+        }
+        ubase_assert(udict_set_unsigned(udict1, 42,
+                                        UDICT_TYPE_BLOCK_HEADER_SIZE, NULL));
+
+        uint64_t u;
+        for (unsigned i = 0; i < NB_NAMED; i++) {
+            snprintf(name, sizeof(name), "x.attr%u", i);
+            ubase_assert(udict_get_unsigned(udict1, &u, UDICT_TYPE_UNSIGNED,
+                                            name));
+            assert(u == i);
+            ubase_assert(udict_get_void(udict1, NULL, UDICT_TYPE_VOID, name));
+            ubase_nassert(udict_get_bool(udict1, NULL, UDICT_TYPE_BOOL, name));
+        }
+        ubase_nassert(udict_get_unsigned(udict1, &u, UDICT_TYPE_UNSIGNED,
+                                         "x.attr"));
+
+        /* deletions and resizes move attributes around */
+        for (unsigned i = 0; i < NB_NAMED; i += 2) {
+            snprintf(name, sizeof(name), "x.attr%u", i);
+            ubase_assert(udict_delete(udict1, UDICT_TYPE_UNSIGNED, name));
+            ubase_assert(udict_set_string(udict1, SALUTATION,
+                                          UDICT_TYPE_STRING, name));
+        }
+        for (unsigned i = 0; i < NB_NAMED; i++) {
+            snprintf(name, sizeof(name), "x.attr%u", i);
+            if (i % 2) {
+                ubase_assert(udict_get_unsigned(udict1, &u,
+                                                UDICT_TYPE_UNSIGNED, name));
+                assert(u == i);
+            } else {
+                const char *string;
+                ubase_nassert(udict_get_unsigned(udict1, &u,
+                                                 UDICT_TYPE_UNSIGNED, name));
+                ubase_assert(udict_get_string(udict1, &string,
+                                              UDICT_TYPE_STRING, name));
+                assert(!strcmp(string, SALUTATION));
+            }
+        }
+        ubase_assert(udict_get_unsigned(udict1, &u,
+                                        UDICT_TYPE_BLOCK_HEADER_SIZE, NULL));
+        assert(u == 42);
+
+        struct udict *udict2 = udict_dup(udict1);
+        assert(udict2 != NULL);
+        assert(udict_cmp(udict1, udict2) == 0);
+        snprintf(name, sizeof(name), "x.attr%u", NB_NAMED - 1);
+        ubase_assert(udict_get_unsigned(udict2, &u, UDICT_TYPE_UNSIGNED,
+                                        name));
+        assert(u == NB_NAMED - 1);
+        udict_free(udict2);
+
+        /* microbenchmark of lookups of the last named attribute */
+        uint64_t start = now();
+        for (unsigned i = 0; i < BENCH_LOOPS; i++)
+            ubase_assert(udict_get_unsigned(udict1, &u, UDICT_TYPE_UNSIGNED,
+                                            name));
+        uint64_t duration = now() - start;
+        fprintf(stderr, "%u named attributes: %"PRIu64" ns per lookup\n",
+                2 * NB_NAMED, duration / BENCH_LOOPS);
+        udict_free(udict1);
+    }
+
     udict_mgr_release(mgr);
 
     umem_mgr_release(umem_mgr);
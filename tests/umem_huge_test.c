@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for umem huge page manager
+ */
+
+#undef NDEBUG
+
+#include "upipe/umem.h"
+#include "upipe/umem_huge.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+/* 3840x2160 10-bit luma plane */
+#define UHD_SIZE (3840 * 2160 * 2)
+
+int main(int argc, char **argv)
+{
+    /* 2 arenas of 32 MiB, not bound */
+    struct umem_mgr *mgr = umem_huge_mgr_alloc(24 * 1024 * 1024, 2, -1, NULL);
+    assert(mgr != NULL);
+
+    struct umem umem;
+    assert(umem_alloc(mgr, &umem, UHD_SIZE));
+    uint8_t *p = umem_buffer(&umem);
+    assert(p != NULL);
+    assert(((uintptr_t)p & (2 * 1024 * 1024 - 1)) == 0);
+    memset(p, 0x42, UHD_SIZE);
+    umem_free(&umem);
+    printf("Passed 1\n");
+
+    assert(umem_alloc(mgr, &umem, UHD_SIZE - 42));
+    assert(umem_buffer(&umem) == p);
+    assert(umem_realloc(&umem, UHD_SIZE));
+    assert(umem_buffer(&umem) == p);
+    assert(umem_buffer(&umem)[UHD_SIZE - 1] == 0x42);
+    printf("Passed 2\n");
+
+    /* the second buffer is carved after the first one */
+    struct umem umem2;
+    assert(umem_alloc(mgr, &umem2, UHD_SIZE));
+    assert(umem_buffer(&umem2) == p + 16 * 1024 * 1024);
+    umem_free(&umem2);
+    umem_free(&umem);
+    printf("Passed 3\n");
+
+    /* small buffers revert to malloc() */
+    assert(umem_alloc(mgr, &umem, 42));
+    memset(umem_buffer(&umem), 0x43, 42);
+    assert(umem_realloc(&umem, 128 * 1024));
+    assert(umem_buffer(&umem)[41] == 0x43);
+    umem_free(&umem);
+    printf("Passed 4\n");
+
+    struct umem_mgr_stats stats;
+    ubase_assert(umem_mgr_get_stats(mgr, 8, &stats));
+    assert(stats.size == 16 * 1024 * 1024);
+    assert(stats.hits == 1);
+    assert(stats.misses == 2);
+    assert(stats.high_water == 2);
+    ubase_assert(umem_mgr_get_stats(mgr, 9, &stats));
+    assert(stats.size == 32 * 1024 * 1024);
+    ubase_nassert(umem_mgr_get_stats(mgr, 10, &stats));
+    printf("Passed 5\n");
+
+    umem_mgr_release(mgr);
+
+    /* bound to the first NUMA node */
+    mgr = umem_huge_mgr_alloc(0, 1, 0, NULL);
+    assert(mgr != NULL);
+    assert(umem_alloc(mgr, &umem, 1024 * 1024));
+    memset(umem_buffer(&umem), 0x44, 1024 * 1024);
+    umem_free(&umem);
+    umem_mgr_release(mgr);
+    printf("Passed 6\n");
+    return 0;
+}
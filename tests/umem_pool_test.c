@@ -70,6 +70,37 @@ int main(int argc, char **argv)
     umem_free(&umem);
     printf("Passed 6\n");
 
+    struct umem_mgr_stats stats;
+    ubase_assert(umem_mgr_get_stats(mgr, 0, &stats));
+    assert(stats.size == 32);
+    assert(stats.depth == 32);
+    ubase_assert(umem_mgr_get_stats(mgr, 8, &stats));
+    assert(stats.size == 8192);
+    assert(stats.depth == 16);
+    assert(stats.hits == 1);
+    assert(stats.misses == 1);
+    assert(stats.overflows == 0);
+    assert(stats.high_water == 1);
+    ubase_assert(umem_mgr_get_stats(mgr, 2, &stats));
+    assert(stats.hits == 0);
+    assert(stats.misses == 1);
+    assert(stats.high_water == 1);
+    ubase_nassert(umem_mgr_get_stats(mgr, 18, &stats));
+    printf("Passed 7\n");
+
+    /* buffers released by a vacuum no longer count in the pool */
+    umem_mgr_vacuum(mgr);
+    struct umem umem2;
+    assert(umem_alloc(mgr, &umem, 128));
+    assert(umem_alloc(mgr, &umem2, 128));
+    umem_free(&umem);
+    umem_free(&umem2);
+    ubase_assert(umem_mgr_get_stats(mgr, 2, &stats));
+    assert(stats.hits == 0);
+    assert(stats.misses == 3);
+    assert(stats.high_water == 2);
+    printf("Passed 8\n");
+
     umem_mgr_release(mgr);
     return 0;
 }
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for umem pool manager with per-thread magazines
+ */
+
+#undef NDEBUG
+
+#include "upipe/umem.h"
+#include "upipe-pthread/umem_pthread_pool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define MAGAZINE_SIZE 4
+#define NB_THREADS 4
+#define NB_LOOPS 1000
+#define NB_BUFFERS 16
+
+static void *thread_run(void *arg)
+{
+    struct umem_mgr *mgr = arg;
+    struct umem umems[NB_BUFFERS];
+
+    for (int i = 0; i < NB_LOOPS; i++) {
+        for (int j = 0; j < NB_BUFFERS; j++) {
+            assert(umem_alloc(mgr, &umems[j], 1316));
+            memset(umem_buffer(&umems[j]), j, 1316);
+        }
+        for (int j = 0; j < NB_BUFFERS; j++) {
+            assert(umem_buffer(&umems[j])[1315] == j);
+            umem_free(&umems[j]);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    struct umem_mgr *mgr = umem_pthread_pool_mgr_alloc(MAGAZINE_SIZE, 32, 4,
+                                                       8, 8, 8, 8);
+    assert(mgr != NULL);
+
+    /* the magazines of the thread keep up to 2 magazines */
+    struct umem umems[3 * MAGAZINE_SIZE];
+    uint8_t *buffers[3 * MAGAZINE_SIZE];
+    for (int i = 0; i < 3 * MAGAZINE_SIZE; i++) {
+        assert(umem_alloc(mgr, &umems[i], 42));
+        buffers[i] = umem_buffer(&umems[i]);
+        memset(buffers[i], 0x42, 42);
+    }
+    for (int i = 0; i < 3 * MAGAZINE_SIZE; i++)
+        umem_free(&umems[i]);
+    printf("Passed 1\n");
+
+    struct umem_mgr_stats stats;
+    ubase_assert(umem_mgr_get_stats(mgr, 1, &stats));
+    assert(stats.size == 64);
+    assert(stats.depth == 8);
+    assert(stats.hits == 0);
+    assert(stats.misses == 3 * MAGAZINE_SIZE);
+    /* the third magazine went to the shared pool */
+    assert(stats.high_water == MAGAZINE_SIZE);
+    printf("Passed 2\n");
+
+    /* buffers are reused in LIFO order */
+    struct umem umem;
+    assert(umem_alloc(mgr, &umem, 64));
+    assert(umem_buffer(&umem) == buffers[3 * MAGAZINE_SIZE - 1]);
+    assert(umem_realloc(&umem, 100));
+    assert(umem_buffer(&umem)[41] == 0x42);
+    umem_free(&umem);
+    assert(umem_alloc(mgr, &umem, 1 << 20));
+    umem_free(&umem);
+    ubase_nassert(umem_mgr_get_stats(mgr, 4, &stats));
+    printf("Passed 3\n");
+
+    umem_mgr_release(mgr);
+
+    mgr = umem_pthread_pool_mgr_alloc_simple(MAGAZINE_SIZE, 32);
+    assert(mgr != NULL);
+    pthread_t threads[NB_THREADS];
+    for (int i = 0; i < NB_THREADS; i++)
+        assert(pthread_create(&threads[i], NULL, thread_run, mgr) == 0);
+    for (int i = 0; i < NB_THREADS; i++)
+        assert(pthread_join(threads[i], NULL) == 0);
+
+    ubase_assert(umem_mgr_get_stats(mgr, 6, &stats));
+    assert(stats.size == 2048);
+    assert(stats.hits + stats.misses == NB_THREADS * NB_LOOPS * NB_BUFFERS);
+    assert(stats.hits > stats.misses);
+    assert(stats.high_water <= 32);
+    printf("Passed 4\n");
+
+    umem_mgr_vacuum(mgr);
+    umem_mgr_release(mgr);
+    return 0;
+}
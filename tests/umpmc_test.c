@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for umpmc rings and batched uqueue operations
+ */
+
+#undef NDEBUG
+
+#include "upipe/umpmc.h"
+#include "upipe/uqueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <assert.h>
+
+#define RING_LENGTH 1000
+#define NB_THREADS 4
+#define NB_LOOPS 100000
+#define BATCH_SIZE 32
+
+static uint8_t ring_buffer[umpmc_sizeof(RING_LENGTH)];
+static struct umpmc ring;
+static uatomic_uint32_t popped;
+static uint64_t sums[NB_THREADS];
+
+static void *producer(void *_nb)
+{
+    uintptr_t nb = (uintptr_t)_nb;
+    for (uintptr_t i = 1; i <= NB_LOOPS; i++)
+        while (!umpmc_push(&ring, (void *)(i * NB_THREADS + nb)))
+            sched_yield();
+    return NULL;
+}
+
+static void *consumer(void *_nb)
+{
+    uintptr_t nb = (uintptr_t)_nb;
+    while (uatomic_load(&popped) < NB_THREADS * NB_LOOPS) {
+        void *opaque = umpmc_pop(&ring, void *);
+        if (opaque == NULL) {
+            sched_yield();
+            continue;
+        }
+        sums[nb] += (uintptr_t)opaque;
+        uatomic_fetch_add(&popped, 1);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    /* capacity */
+    assert(umpmc_capacity(1) == 2);
+    assert(umpmc_capacity(255) == 256);
+    assert(umpmc_capacity(256) == 256);
+    assert(umpmc_capacity(UMPMC_MAX_LENGTH) == UMPMC_MAX_LENGTH);
+    assert(umpmc_init(&ring, RING_LENGTH, ring_buffer) == RING_LENGTH);
+
+    /* single thread, with positions wrapping around */
+    uintptr_t i, j;
+    for (j = 0; j < 3; j++) {
+        for (i = 1; i <= RING_LENGTH; i++)
+            assert(umpmc_push(&ring, (void *)i));
+        assert(!umpmc_push(&ring, (void *)i));
+        for (i = 1; i <= RING_LENGTH; i++)
+            assert(umpmc_pop(&ring, uintptr_t) == i);
+        assert(umpmc_pop(&ring, void *) == NULL);
+    }
+    umpmc_clean(&ring);
+
+    /* multiple producers and consumers */
+    umpmc_init(&ring, RING_LENGTH, ring_buffer);
+    uatomic_init(&popped, 0);
+    pthread_t producers[NB_THREADS], consumers[NB_THREADS];
+    for (i = 0; i < NB_THREADS; i++) {
+        assert(pthread_create(&consumers[i], NULL, consumer,
+                              (void *)i) == 0);
+        assert(pthread_create(&producers[i], NULL, producer,
+                              (void *)i) == 0);
+    }
+    uint64_t sum = 0;
+    for (i = 0; i < NB_THREADS; i++) {
+        assert(pthread_join(producers[i], NULL) == 0);
+        assert(pthread_join(consumers[i], NULL) == 0);
+        sum += sums[i];
+    }
+    uint64_t expected = 0;
+    for (i = 1; i <= NB_LOOPS; i++)
+        for (j = 0; j < NB_THREADS; j++)
+            expected += i * NB_THREADS + j;
+    assert(sum == expected);
+    assert(umpmc_pop(&ring, void *) == NULL);
+    uatomic_clean(&popped);
+    umpmc_clean(&ring);
+
+    /* batched uqueue */
+    struct uqueue uqueue;
+    uint8_t *uqueue_buffer = malloc(uqueue_sizeof(RING_LENGTH));
+    assert(uqueue_buffer != NULL);
+    assert(uqueue_init(&uqueue, RING_LENGTH, uqueue_buffer));
+    void *elements[BATCH_SIZE];
+    for (i = 0; i < BATCH_SIZE; i++)
+        elements[i] = (void *)(i + 1);
+    unsigned int nb = 0, pushed;
+    while ((pushed = uqueue_push_batch(&uqueue, elements, BATCH_SIZE)))
+        nb += pushed;
+    assert(nb == RING_LENGTH);
+    assert(uqueue_length(&uqueue) == RING_LENGTH);
+    assert(!uqueue_push(&uqueue, elements[0]));
+
+    void *popped_elements[BATCH_SIZE + 1];
+    while ((nb = uqueue_pop_batch(&uqueue, popped_elements,
+                                  BATCH_SIZE + 1))) {
+        for (i = 0; i < nb; i++)
+            assert(popped_elements[i] != NULL);
+    }
+    assert(uqueue_length(&uqueue) == 0);
+    assert(uqueue_pop(&uqueue, void *) == NULL);
+    assert(uqueue_push_batch(&uqueue, elements, 3) == 3);
+    assert(uqueue_pop(&uqueue, uintptr_t) == 1);
+    assert(uqueue_pop_batch(&uqueue, popped_elements, BATCH_SIZE) == 2);
+    assert(popped_elements[0] == (void *)2 && popped_elements[1] == (void *)3);
+    uqueue_clean(&uqueue);
+    free(uqueue_buffer);
+
+    return 0;
+}
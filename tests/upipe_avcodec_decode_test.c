@@ -274,7 +274,7 @@ static void *test_thread(void *_thread)
 }
 
 static void usage(const char *argv0) {
-    fprintf(stdout, "Usage: %s [-n threads] <source file> [pgmprefix]\n", argv0);
+    fprintf(stdout, "Usage: %s [-n threads] [-t decoding threads] <source file> [pgmprefix]\n", argv0);
     exit(EXIT_FAILURE);
 }
 
@@ -283,11 +283,15 @@ int main (int argc, char **argv)
     printf("Compiled %s %s - %s\n", __DATE__, __TIME__, __FILE__);
     int opt;
     int thread_num = THREAD_NUM;
-    while ((opt = getopt(argc, argv, "n:")) != -1) {
+    int decoding_threads = 1;
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
         switch(opt) {
             case 'n':
                 thread_num = strtod(optarg, NULL);
                 break;
+            case 't':
+                decoding_threads = strtol(optarg, NULL, 10);
+                break;
             default:
                 usage(argv[0]);
         }
@@ -398,6 +402,8 @@ int main (int argc, char **argv)
     assert(avcdec);
     ubase_assert(upipe_set_flow_def(avcdec, flowdef));
     uref_free(flowdef);
+    if (decoding_threads != 1)
+        ubase_assert(upipe_avcdec_set_threads(avcdec, decoding_threads));
     /* mainthread avcdec runs alone (no thread) so it doesn't need any upump_mgr
      * Please do not add one, to check the nopump (direct call) case */
     mainthread.avcdec = avcdec;
@@ -16,6 +16,7 @@
 #include "upipe/uprobe_upump_mgr.h"
 #include "upipe/uprobe_ubuf_mem.h"
 #include "upipe/upipe.h"
+#include "upipe/urefcount.h"
 #include "upipe/umem.h"
 #include "upipe/umem_alloc.h"
 #include "upipe/udict.h"
@@ -62,6 +63,7 @@ UREF_ATTR_INT(xflow, num, "x.f.num", flow num)
 #define THREAD_NUM          4
 #define FRAMES_LIMIT        100
 #define THREAD_FRAMES_LIMIT (FRAMES_LIMIT / 8)
+#define DECODE_THREADS      4
 #define WIDTH 120
 #define HEIGHT 90
 #define STREAM stdout
@@ -77,6 +79,13 @@ struct ubuf_mgr *pic_mgr;
 struct uprobe *logger;
 struct uprobe uprobe_avcenc_s;
 
+/** number of threads of the decoders */
+static int decode_threads = 1;
+/** checksums of the decoded pictures, or NULL to discard them */
+static uint32_t *checksums = NULL;
+/** number of decoded pictures */
+static unsigned int nb_checksums = 0;
+
 struct thread {
     pthread_t id;
     unsigned int num;
@@ -101,6 +110,93 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe, int event, va_list
     return UBASE_ERR_NONE;
 }
 
+/** helper phony pipe */
+struct sum_test {
+    struct urefcount urefcount;
+    struct upipe upipe;
+};
+
+/** helper phony pipe */
+static void sum_test_free(struct urefcount *urefcount)
+{
+    struct sum_test *sum_test =
+        container_of(urefcount, struct sum_test, urefcount);
+    upipe_throw_dead(&sum_test->upipe);
+    urefcount_clean(&sum_test->urefcount);
+    upipe_clean(&sum_test->upipe);
+    free(sum_test);
+}
+
+/** helper phony pipe */
+static struct upipe *sum_test_alloc(struct upipe_mgr *mgr,
+                                    struct uprobe *uprobe,
+                                    uint32_t signature, va_list args)
+{
+    struct sum_test *sum_test = malloc(sizeof(struct sum_test));
+    assert(sum_test != NULL);
+    upipe_init(&sum_test->upipe, mgr, uprobe);
+    urefcount_init(&sum_test->urefcount, sum_test_free);
+    sum_test->upipe.refcount = &sum_test->urefcount;
+    upipe_throw_ready(&sum_test->upipe);
+    return &sum_test->upipe;
+}
+
+/** helper phony pipe computing a checksum of the decoded pictures */
+static void sum_test_input(struct upipe *upipe, struct uref *uref,
+                           struct upump **upump_p)
+{
+    size_t hsize, vsize;
+    ubase_assert(uref_pic_size(uref, &hsize, &vsize, NULL));
+    assert(hsize == WIDTH && vsize == HEIGHT);
+    assert(nb_checksums < FRAMES_LIMIT);
+
+    uint32_t sum = 0;
+    const char *chroma;
+    uref_pic_foreach_plane(uref, chroma) {
+        const uint8_t *buf;
+        size_t stride;
+        uint8_t hsub, vsub, macropixel_size;
+        ubase_assert(uref_pic_plane_size(uref, chroma, &stride, &hsub, &vsub,
+                                         &macropixel_size));
+        ubase_assert(uref_pic_plane_read(uref, chroma, 0, 0, -1, -1, &buf));
+        for (size_t j = 0; j < vsize / vsub; j++) {
+            for (size_t i = 0; i < hsize / hsub * macropixel_size; i++)
+                sum = sum * 31 + buf[i];
+            buf += stride;
+        }
+        ubase_assert(uref_pic_plane_unmap(uref, chroma, 0, 0, -1, -1));
+    }
+    checksums[nb_checksums++] = sum;
+    uref_free(uref);
+}
+
+/** helper phony pipe */
+static int sum_test_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+            return UBASE_ERR_NONE;
+        default:
+            assert(0);
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe */
+static struct upipe_mgr sum_test_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = sum_test_alloc,
+    .upipe_input = sum_test_input,
+    .upipe_control = sum_test_control,
+};
+
 /** definition of our uprobe */
 static int catch_avcenc(struct uprobe *uprobe, struct upipe *upipe,
                         int event, va_list args)
@@ -130,6 +226,20 @@ static int catch_avcenc(struct uprobe *uprobe, struct upipe *upipe,
                                 "avcdec %"PRId64, num), upump_mgr));
     assert(avcdec);
     upipe_release(avcdec);
+    if (decode_threads != 1) {
+        int err = upipe_avcdec_set_threads(avcdec, decode_threads);
+        assert(err == UBASE_ERR_NONE || err == UBASE_ERR_UNHANDLED);
+    }
+
+    if (checksums != NULL) {
+        struct upipe *sink = upipe_void_alloc(&sum_test_mgr,
+            uprobe_pfx_alloc_va(uprobe_use(logger), loglevel,
+                                "sum %"PRId64, num));
+        assert(sink);
+        upipe_set_output(avcdec, sink);
+        upipe_release(sink);
+        return UBASE_ERR_NONE;
+    }
 
     /* /dev/null */
     struct upipe *null = upipe_void_alloc(upipe_null_mgr,
@@ -143,7 +253,7 @@ static int catch_avcenc(struct uprobe *uprobe, struct upipe *upipe,
 }
 
 /* fill picture with some stuff */
-static void fill_pic(struct ubuf *ubuf)
+static void fill_pic(struct ubuf *ubuf, int frame)
 {
     const char *chroma;
     uint8_t *buf, hsub, vsub;
@@ -156,7 +266,7 @@ static void fill_pic(struct ubuf *ubuf)
         ubuf_pic_plane_size(ubuf, chroma, &stride, &hsub, &vsub, NULL);
         for (j = 0; j < height/vsub; j++) {
             for (i=0; i < width/hsub; i++) {
-                buf[i] = 2*i + j;
+                buf[i] = 2*i + j + frame;
             }
             buf += stride;
         }
@@ -196,7 +306,7 @@ static void source_idler(struct upump *upump)
     struct uref *pic;
 
     pic = uref_pic_alloc(uref_mgr, pic_mgr, WIDTH, HEIGHT);
-    fill_pic(pic->ubuf);
+    fill_pic(pic->ubuf, thread->iteration);
     upipe_input(avcenc, pic, &upump);
 
     if (thread->iteration > thread->limit) {
@@ -343,13 +453,50 @@ int main(int argc, char **argv)
     for (i=0; i < FRAMES_LIMIT; i++) {
         pic = uref_pic_alloc(uref_mgr, pic_mgr, WIDTH, HEIGHT);
         assert(pic != NULL);
-        fill_pic(pic->ubuf);
+        fill_pic(pic->ubuf, i);
         upipe_input(avcenc, pic, NULL);
    }
 
     upipe_release(avcenc);
     printf("Everything good so far, cleaning\n");
 
+    /* decoding threads must not change the decoded pictures */
+    uint32_t sums[2][FRAMES_LIMIT];
+    unsigned int nb_sums[2];
+    for (int run = 0; run < 2; run++) {
+        decode_threads = run ? DECODE_THREADS : 1;
+        checksums = sums[run];
+        nb_checksums = 0;
+
+        flow = uref_pic_flow_alloc_def(uref_mgr, 1);
+        assert(flow != NULL);
+        ubase_assert(uref_pic_flow_add_plane(flow, 1, 1, 1, "y8"));
+        ubase_assert(uref_pic_flow_add_plane(flow, 2, 2, 1, "u8"));
+        ubase_assert(uref_pic_flow_add_plane(flow, 2, 2, 1, "v8"));
+        ubase_assert(uref_pic_flow_set_hsize(flow, WIDTH));
+        ubase_assert(uref_pic_flow_set_vsize(flow, HEIGHT));
+        ubase_assert(uref_pic_flow_set_fps(flow, fps));
+        avcenc = build_pipeline("mpeg2video.pic.", NULL, -1, flow);
+        uref_free(flow);
+
+        for (i=0; i < FRAMES_LIMIT; i++) {
+            pic = uref_pic_alloc(uref_mgr, pic_mgr, WIDTH, HEIGHT);
+            assert(pic != NULL);
+            fill_pic(pic->ubuf, i);
+            upipe_input(avcenc, pic, NULL);
+        }
+
+        /* flushes the decoder */
+        upipe_release(avcenc);
+        nb_sums[run] = nb_checksums;
+    }
+    checksums = NULL;
+    decode_threads = 1;
+    assert(nb_sums[0] > 0);
+    assert(nb_sums[0] == nb_sums[1]);
+    assert(!memcmp(sums[0], sums[1], nb_sums[0] * sizeof(uint32_t)));
+    printf("Decoding with %d threads matches\n", DECODE_THREADS);
+
     /* mono-threaded audio test without upump_mgr */
     flow = uref_sound_flow_alloc_def(uref_mgr, "s16le.", 2, 4);
     assert(flow != NULL);
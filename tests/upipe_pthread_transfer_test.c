@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for transfer and worker managers on a new pthread
+ */
+
+#undef NDEBUG
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include "upipe/uprobe.h"
+#include "upipe/ulog.h"
+#include "upipe/upipe.h"
+#include "upipe/upump.h"
+#include "upump-ev/upump_ev.h"
+#include "upipe-pthread/uprobe_pthread_upump_mgr.h"
+#include "upipe-pthread/upipe_pthread_transfer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <sched.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define UPUMP_POOL 1
+#define UPUMP_BLOCKER_POOL 1
+#define XFER_QUEUE 255
+#define XFER_POOL 1
+#define THREAD_NAME "xfer_test"
+
+/** CPUs the test process may run on */
+static cpu_set_t process_cpuset;
+/** CPUs the last thread could run on */
+static cpu_set_t thread_cpuset;
+/** name of the last thread */
+static char thread_name[16];
+/** number of warnings thrown by the last thread */
+static unsigned int nb_warnings;
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        case UPROBE_LOG: {
+            struct ulog *ulog = va_arg(args, struct ulog *);
+            assert(ulog->level != UPROBE_LOG_ERROR);
+            if (ulog->level == UPROBE_LOG_WARNING)
+                nb_warnings++;
+            break;
+        }
+        default:
+            assert(0);
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** event loop allocator recording the attributes of the new thread */
+static struct upump_mgr *test_mgr_alloc(uint16_t upump_pool_depth,
+                                        uint16_t upump_blocker_pool_depth)
+{
+    assert(!pthread_getaffinity_np(pthread_self(), sizeof(thread_cpuset),
+                                   &thread_cpuset));
+    assert(!pthread_getname_np(pthread_self(), thread_name,
+                               sizeof(thread_name)));
+    return upump_ev_mgr_alloc_loop(upump_pool_depth,
+                                   upump_blocker_pool_depth);
+}
+
+/** runs a thread with the given attributes until it exits */
+static void test_thread(struct upump_mgr *upump_mgr, struct uprobe *uprobe,
+                        const struct upipe_pthread_attr *pthread_attr,
+                        bool work)
+{
+    CPU_ZERO(&thread_cpuset);
+    thread_name[0] = '\0';
+    nb_warnings = 0;
+
+    struct upipe_mgr *mgr;
+    if (work)
+        mgr = upipe_pthread_work_mgr_alloc(XFER_QUEUE, XFER_POOL,
+                                           uprobe_use(uprobe), test_mgr_alloc,
+                                           UPUMP_POOL, UPUMP_BLOCKER_POOL,
+                                           NULL, NULL, NULL, pthread_attr,
+                                           THREAD_NAME);
+    else
+        mgr = upipe_pthread_xfer_mgr_alloc_attr(XFER_QUEUE, XFER_POOL,
+                                                uprobe_use(uprobe),
+                                                test_mgr_alloc,
+                                                UPUMP_POOL, UPUMP_BLOCKER_POOL,
+                                                NULL, NULL, NULL, pthread_attr,
+                                                THREAD_NAME);
+    assert(mgr != NULL);
+    upipe_mgr_release(mgr);
+
+    /* returns once the thread is joined */
+    upump_mgr_run(upump_mgr, NULL);
+    assert(!strcmp(thread_name, THREAD_NAME));
+}
+
+/** runs a thread restricted to the given list of CPUs */
+static void test_cpus(struct upump_mgr *upump_mgr, struct uprobe *uprobe,
+                      const char *cpus, const cpu_set_t *expected)
+{
+    struct upipe_pthread_attr pthread_attr;
+    upipe_pthread_attr_init(&pthread_attr);
+    pthread_attr.cpus = cpus;
+    test_thread(upump_mgr, uprobe, &pthread_attr, false);
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    if (expected == NULL) {
+        /* invalid list: the thread runs anyway with the default CPUs */
+        assert(nb_warnings == 1);
+        assert(CPU_EQUAL(&thread_cpuset, &process_cpuset));
+    } else {
+        assert(nb_warnings == 0);
+        assert(CPU_EQUAL(&thread_cpuset, expected));
+    }
+#else
+    assert(nb_warnings == 1);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    struct upump_mgr *upump_mgr =
+        upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger = uprobe_pthread_upump_mgr_alloc(&uprobe);
+    assert(logger != NULL);
+    ubase_assert(uprobe_pthread_upump_mgr_set(logger, upump_mgr));
+
+    assert(!sched_getaffinity(0, sizeof(process_cpuset), &process_cpuset));
+    int first = -1, last = -1;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &process_cpuset)) {
+            if (first == -1)
+                first = cpu;
+            last = cpu;
+        }
+    assert(first != -1);
+
+    /* no attribute */
+    test_thread(upump_mgr, logger, NULL, false);
+    assert(nb_warnings == 0);
+    assert(CPU_EQUAL(&thread_cpuset, &process_cpuset));
+
+    /* single CPU, in various forms */
+    cpu_set_t single;
+    CPU_ZERO(&single);
+    CPU_SET(first, &single);
+    char list[64];
+    snprintf(list, sizeof(list), "%d", first);
+    test_cpus(upump_mgr, logger, list, &single);
+    snprintf(list, sizeof(list), "%d-%d\n", first, first);
+    test_cpus(upump_mgr, logger, list, &single);
+    snprintf(list, sizeof(list), "%d,%d-%d", first, first, first);
+    test_cpus(upump_mgr, logger, list, &single);
+
+    /* a range covering all allowed CPUs, and CPUs past CPU_SETSIZE */
+    snprintf(list, sizeof(list), "%d-%d", first, last);
+    test_cpus(upump_mgr, logger, list, &process_cpuset);
+    snprintf(list, sizeof(list), "%d,%d-%d", first, first, CPU_SETSIZE * 2);
+    test_cpus(upump_mgr, logger, list, &process_cpuset);
+
+    /* malformed lists */
+    test_cpus(upump_mgr, logger, "", NULL);
+    test_cpus(upump_mgr, logger, "abc", NULL);
+    test_cpus(upump_mgr, logger, ",", NULL);
+    test_cpus(upump_mgr, logger, "1-", NULL);
+    test_cpus(upump_mgr, logger, "3-1", NULL);
+    snprintf(list, sizeof(list), "%d", CPU_SETSIZE);
+    test_cpus(upump_mgr, logger, list, NULL);
+
+    /* out of range NUMA node: the thread runs anyway */
+    struct upipe_pthread_attr pthread_attr;
+    upipe_pthread_attr_init(&pthread_attr);
+    snprintf(list, sizeof(list), "%d", first);
+    pthread_attr.cpus = list;
+    pthread_attr.numa_node = INT_MAX;
+    test_thread(upump_mgr, logger, &pthread_attr, false);
+    assert(nb_warnings == 1);
+
+    /* worker manager */
+    upipe_pthread_attr_init(&pthread_attr);
+    pthread_attr.cpus = list;
+    test_thread(upump_mgr, logger, &pthread_attr, true);
+    assert(nb_warnings == 0);
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    assert(CPU_EQUAL(&thread_cpuset, &single));
+#endif
+
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+    upump_mgr_release(upump_mgr);
+    return 0;
+}
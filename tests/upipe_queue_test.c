@@ -17,6 +17,7 @@
 #include "upipe/uprobe_prefix.h"
 #include "upipe/uprobe_uref_mgr.h"
 #include "upipe/uprobe_upump_mgr.h"
+#include "upipe/uclock.h"
 #include "upipe/umem.h"
 #include "upipe/umem_alloc.h"
 #include "upipe/udict.h"
@@ -38,6 +39,8 @@
 #define UPUMP_POOL 0
 #define UPUMP_BLOCKER_POOL 0
 #define QUEUE_LENGTH 6
+#define BATCH 3
+#define BATCH_UREFS 10
 #define UPROBE_LOG_LEVEL UPROBE_LOG_VERBOSE
 
 UREF_ATTR_SMALL_UNSIGNED(test, test, "x.test", test)
@@ -48,6 +51,9 @@ static uint8_t counter = 0;
 static struct uref_mgr *uref_mgr;
 static struct urequest request;
 static bool request_was_unregistered = false;
+static struct upipe *upipe_batch_qsink;
+static uint8_t batch_counter = 0;
+static bool stalled = false;
 
 /** definition of our uprobe */
 static int catch(struct uprobe *uprobe, struct upipe *upipe,
@@ -64,6 +70,10 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
         case UPROBE_SOURCE_END:
             upipe_release(upipe);
             break;
+        case UPROBE_STALLED:
+            assert(upipe == upipe_batch_qsink);
+            stalled = true;
+            break;
     }
     return UBASE_ERR_NONE;
 }
@@ -148,6 +158,48 @@ static struct upipe_mgr queue_test_mgr = {
     .upipe_control = test_control
 };
 
+/** helper phony pipe */
+static void batch_test_input(struct upipe *upipe, struct uref *uref,
+                             struct upump **upump_p)
+{
+    assert(uref != NULL);
+    uint8_t uref_counter;
+    ubase_assert(uref_test_get_test(uref, &uref_counter));
+    upipe_notice_va(upipe, "batch loop %"PRIu8, uref_counter);
+    assert(uref_counter == batch_counter);
+    batch_counter++;
+    uref_free(uref);
+
+    if (batch_counter == BATCH_UREFS - 1) {
+        /* a lone uref is only published by the batch timer */
+        uref = uref_alloc(uref_mgr);
+        assert(uref != NULL);
+        ubase_assert(uref_test_set_test(uref, BATCH_UREFS - 1));
+        upipe_input(upipe_batch_qsink, uref, NULL);
+    } else if (batch_counter == BATCH_UREFS)
+        upipe_release(upipe_batch_qsink);
+}
+
+/** helper phony pipe */
+static int batch_test_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        default:
+            assert(0);
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe */
+static struct upipe_mgr batch_test_mgr = {
+    .refcount = NULL,
+    .upipe_alloc = test_alloc,
+    .upipe_input = batch_test_input,
+    .upipe_control = batch_test_control
+};
+
 int main(int argc, char *argv[])
 {
     upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
@@ -218,6 +270,69 @@ int main(int argc, char *argv[])
     assert(counter == 2);
     assert(request_was_unregistered);
 
+    /* batch mode */
+    struct upipe *upipe_batch_sink = upipe_void_alloc(&batch_test_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "batch sink"));
+    assert(upipe_batch_sink != NULL);
+
+    upipe_qsrc = upipe_qsrc_alloc(upipe_qsrc_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "batch queue source"), QUEUE_LENGTH);
+    assert(upipe_qsrc != NULL);
+    ubase_assert(upipe_set_output(upipe_qsrc, upipe_batch_sink));
+
+    upipe_batch_qsink = upipe_qsink_alloc(upipe_qsink_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "batch queue sink"),
+            upipe_qsrc);
+    assert(upipe_batch_qsink != NULL);
+    uref = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(uref != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_batch_qsink, uref));
+    uref_free(uref);
+    ubase_assert(upipe_qsink_set_batch(upipe_batch_qsink, BATCH,
+                                       UCLOCK_FREQ / 1000));
+    unsigned int batch;
+    uint64_t timeout;
+    ubase_assert(upipe_qsink_get_batch(upipe_batch_qsink, &batch, &timeout));
+    assert(batch == BATCH);
+    assert(timeout == UCLOCK_FREQ / 1000);
+
+    /* the flow definition and the first uref stay in the pending batch */
+    uref = uref_alloc(uref_mgr);
+    assert(uref != NULL);
+    ubase_assert(uref_test_set_test(uref, 0));
+    upipe_input(upipe_batch_qsink, uref, NULL);
+    ubase_assert(upipe_qsrc_get_length(upipe_qsrc, &length));
+    assert(length == 0);
+
+    /* the batch is published once full */
+    uref = uref_alloc(uref_mgr);
+    assert(uref != NULL);
+    ubase_assert(uref_test_set_test(uref, 1));
+    upipe_input(upipe_batch_qsink, uref, NULL);
+    ubase_assert(upipe_qsrc_get_length(upipe_qsrc, &length));
+    assert(length == BATCH);
+
+    /* fill the queue, then overflow it so that the sink stalls and blocks */
+    for (uint8_t i = 2; i < BATCH_UREFS - 1; i++) {
+        uref = uref_alloc(uref_mgr);
+        assert(uref != NULL);
+        ubase_assert(uref_test_set_test(uref, i));
+        upipe_input(upipe_batch_qsink, uref, NULL);
+    }
+    ubase_assert(upipe_qsrc_get_length(upipe_qsrc, &length));
+    assert(length == QUEUE_LENGTH);
+    assert(stalled);
+
+    /* the held urefs are written as the queue drains, and the last one is
+     * sent by batch_test_input */
+    upump_mgr_run(upump_mgr, NULL);
+
+    assert(batch_counter == BATCH_UREFS);
+    test_free(upipe_batch_sink);
+
     /* check that they are correctly released even if no flow def is input */
     upipe_qsrc = upipe_qsrc_alloc(upipe_qsrc_mgr,
             uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
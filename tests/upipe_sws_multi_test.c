@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for swscale multi pipes
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_ubuf_mem.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_pic_mem.h"
+#include "upipe/uref.h"
+#include "upipe/uref_pic_flow.h"
+#include "upipe/uref_pic_flow_formats.h"
+#include "upipe/uref_pic.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe/upipe_helper_upipe.h"
+#include "upipe-swscale/upipe_sws.h"
+#include "upipe-swscale/upipe_sws_multi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#include <libswscale/swscale.h>
+
+#define UDICT_POOL_DEPTH    0
+#define UREF_POOL_DEPTH     0
+#define UBUF_POOL_DEPTH     0
+#define UBUF_ALIGN          16
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+
+#define SRCSIZE             64
+#define NB_OUTPUTS          3
+#define NB_PICS             4
+#define THREADS             3
+#define SWS_FLAGS           (SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND | \
+                             SWS_LANCZOS)
+
+/** sizes of the outputs, in allocation order */
+static const uint64_t sizes[NB_OUTPUTS] = { 32, 16, 48 };
+/** output cascaded from the 32x32 output */
+#define CASCADED            1
+/** source output of the cascade */
+#define CASCADE_SOURCE      0
+
+/** planes of the pictures */
+static const struct {
+    const char *chroma;
+    uint8_t hsub, vsub;
+} planes[] = {
+    { "y8", 1, 1 },
+    { "u8", 2, 2 },
+    { "v8", 2, 2 },
+};
+#define NB_PLANES           (sizeof (planes) / sizeof (planes[0]))
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_NEW_FLOW_DEF:
+        case UPROBE_SOURCE_END:
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** helper phony pipe */
+struct sws_multi_test {
+    uint64_t size;
+    unsigned int count;
+    struct uref *pic;
+    struct upipe upipe;
+};
+
+/** helper phony pipe */
+UPIPE_HELPER_UPIPE(sws_multi_test, upipe, 0);
+
+/** helper phony pipe */
+static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct sws_multi_test *test = malloc(sizeof(struct sws_multi_test));
+    assert(test != NULL);
+    test->size = 0;
+    test->count = 0;
+    test->pic = NULL;
+    upipe_init(&test->upipe, mgr, uprobe);
+    upipe_throw_ready(&test->upipe);
+    return &test->upipe;
+}
+
+/** helper phony pipe */
+static void test_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    struct sws_multi_test *test = sws_multi_test_from_upipe(upipe);
+    size_t hsize, vsize;
+    ubase_assert(uref_pic_size(uref, &hsize, &vsize, NULL));
+    assert(hsize == test->size);
+    assert(vsize == test->size);
+    assert(uref_pic_check_progressive(uref));
+    test->count++;
+    uref_free(test->pic);
+    test->pic = uref;
+}
+
+/** helper phony pipe */
+static int test_control(struct upipe *upipe, int command, va_list args)
+{
+    struct sws_multi_test *test = sws_multi_test_from_upipe(upipe);
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF: {
+            struct uref *flow_def = va_arg(args, struct uref *);
+            uint64_t hsize, vsize;
+            ubase_assert(uref_pic_flow_get_hsize(flow_def, &hsize));
+            ubase_assert(uref_pic_flow_get_vsize(flow_def, &vsize));
+            assert(hsize == test->size);
+            assert(vsize == test->size);
+            return UBASE_ERR_NONE;
+        }
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+            return UBASE_ERR_NONE;
+        default:
+            assert(0);
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe */
+static void test_free(struct upipe *upipe)
+{
+    upipe_throw_dead(upipe);
+    struct sws_multi_test *test = sws_multi_test_from_upipe(upipe);
+    uref_free(test->pic);
+    upipe_clean(upipe);
+    free(test);
+}
+
+/** helper phony pipe */
+static struct upipe_mgr sws_multi_test_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = test_alloc,
+    .upipe_input = test_input,
+    .upipe_control = test_control
+};
+
+/** fills a picture with a pattern depending on its number */
+static void fill_in(struct uref *uref, int pic)
+{
+    for (int i = 0; i < NB_PLANES; i++) {
+        size_t hsize, vsize, stride;
+        uint8_t *buffer;
+        ubase_assert(uref_pic_size(uref, &hsize, &vsize, NULL));
+        ubase_assert(uref_pic_plane_write(uref, planes[i].chroma,
+                                          0, 0, -1, -1, &buffer));
+        ubase_assert(uref_pic_plane_size(uref, planes[i].chroma, &stride,
+                                         NULL, NULL, NULL));
+        for (int y = 0; y < vsize / planes[i].vsub; y++) {
+            for (int x = 0; x < hsize / planes[i].hsub; x++)
+                buffer[x] = x * x + 3 * y * y + 11 * pic + 37 * i;
+            buffer += stride;
+        }
+        ubase_assert(uref_pic_plane_unmap(uref, planes[i].chroma,
+                                          0, 0, -1, -1));
+    }
+}
+
+/** compares two pictures */
+static bool compare(struct uref *uref1, struct uref *uref2)
+{
+    size_t hsize, vsize, hsize2, vsize2;
+    ubase_assert(uref_pic_size(uref1, &hsize, &vsize, NULL));
+    ubase_assert(uref_pic_size(uref2, &hsize2, &vsize2, NULL));
+    assert(hsize == hsize2 && vsize == vsize2);
+
+    bool same = true;
+    for (int i = 0; i < NB_PLANES; i++) {
+        const uint8_t *buffer1, *buffer2;
+        size_t stride1, stride2;
+        ubase_assert(uref_pic_plane_read(uref1, planes[i].chroma,
+                                         0, 0, -1, -1, &buffer1));
+        ubase_assert(uref_pic_plane_read(uref2, planes[i].chroma,
+                                         0, 0, -1, -1, &buffer2));
+        ubase_assert(uref_pic_plane_size(uref1, planes[i].chroma, &stride1,
+                                         NULL, NULL, NULL));
+        ubase_assert(uref_pic_plane_size(uref2, planes[i].chroma, &stride2,
+                                         NULL, NULL, NULL));
+        for (int y = 0; y < vsize / planes[i].vsub; y++) {
+            if (memcmp(buffer1, buffer2, hsize / planes[i].hsub))
+                same = false;
+            buffer1 += stride1;
+            buffer2 += stride2;
+        }
+        ubase_assert(uref_pic_plane_unmap(uref1, planes[i].chroma,
+                                          0, 0, -1, -1));
+        ubase_assert(uref_pic_plane_unmap(uref2, planes[i].chroma,
+                                          0, 0, -1, -1));
+    }
+    return same;
+}
+
+/** single-threaded swscale pipe and its sink */
+struct sws_ref {
+    struct upipe *sws;
+    struct upipe *sink;
+};
+
+/** allocates a single-threaded swscale pipe */
+static void sws_ref_alloc(struct sws_ref *ref, struct upipe_mgr *sws_mgr,
+                          struct uref_mgr *uref_mgr, struct uprobe *logger,
+                          uint64_t src_size, uint64_t size)
+{
+    ref->sink = upipe_void_alloc(&sws_multi_test_mgr,
+            uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                "ref sink %"PRIu64"->%"PRIu64,
+                                src_size, size));
+    assert(ref->sink != NULL);
+    sws_multi_test_from_upipe(ref->sink)->size = size;
+
+    struct uref *flow_def = uref_pic_flow_alloc_yuv420p(uref_mgr);
+    assert(flow_def != NULL);
+    ubase_assert(uref_pic_flow_set_hsize(flow_def, size));
+    ubase_assert(uref_pic_flow_set_vsize(flow_def, size));
+    ref->sws = upipe_flow_alloc(sws_mgr,
+            uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                "ref sws %"PRIu64"->%"PRIu64,
+                                src_size, size),
+            flow_def);
+    assert(ref->sws != NULL);
+    uref_free(flow_def);
+    ubase_assert(upipe_sws_set_flags(ref->sws, SWS_FLAGS));
+
+    struct uref *pic_flow = uref_pic_flow_alloc_yuv420p(uref_mgr);
+    assert(pic_flow != NULL);
+    ubase_assert(uref_pic_flow_set_hsize(pic_flow, src_size));
+    ubase_assert(uref_pic_flow_set_vsize(pic_flow, src_size));
+    ubase_assert(upipe_set_flow_def(ref->sws, pic_flow));
+    uref_free(pic_flow);
+    ubase_assert(upipe_set_output(ref->sws, ref->sink));
+}
+
+/** scales a picture with a single-threaded swscale pipe */
+static struct uref *sws_ref_scale(struct sws_ref *ref, struct uref *uref)
+{
+    struct uref *dup = uref_dup(uref);
+    assert(dup != NULL);
+    upipe_input(ref->sws, dup, NULL);
+    struct uref *pic = sws_multi_test_from_upipe(ref->sink)->pic;
+    assert(pic != NULL);
+    return pic;
+}
+
+/** releases a single-threaded swscale pipe */
+static void sws_ref_release(struct sws_ref *ref)
+{
+    upipe_release(ref->sws);
+    test_free(ref->sink);
+}
+
+int main(int argc, char **argv)
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr =
+        udict_inline_mgr_alloc(UDICT_POOL_DEPTH, umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr =
+        uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr, 0);
+    assert(uref_mgr != NULL);
+    struct ubuf_mgr *ubuf_mgr =
+        ubuf_pic_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH, umem_mgr, 1,
+                               0, 0, 0, 0, UBUF_ALIGN, 0);
+    assert(ubuf_mgr != NULL);
+    ubase_assert(ubuf_pic_mem_mgr_add_plane(ubuf_mgr, "y8", 1, 1, 1));
+    ubase_assert(ubuf_pic_mem_mgr_add_plane(ubuf_mgr, "u8", 2, 2, 1));
+    ubase_assert(ubuf_pic_mem_mgr_add_plane(ubuf_mgr, "v8", 2, 2, 1));
+
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger = uprobe_stdio_alloc(&uprobe, stdout,
+                                               UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr, UBUF_POOL_DEPTH,
+                                   UBUF_POOL_DEPTH);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_sws_multi_mgr = upipe_sws_multi_mgr_alloc();
+    assert(upipe_sws_multi_mgr != NULL);
+    struct upipe *multi = upipe_void_alloc(upipe_sws_multi_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "sws multi"));
+    assert(multi != NULL);
+    ubase_assert(upipe_sws_multi_set_threads(multi, THREADS));
+    unsigned int threads;
+    ubase_assert(upipe_sws_multi_get_threads(multi, &threads));
+    assert(threads == THREADS);
+    ubase_assert(upipe_sws_multi_set_flags(multi, SWS_FLAGS));
+
+    struct uref *pic_flow = uref_pic_flow_alloc_yuv420p(uref_mgr);
+    assert(pic_flow != NULL);
+    ubase_assert(uref_pic_flow_set_hsize(pic_flow, SRCSIZE));
+    ubase_assert(uref_pic_flow_set_vsize(pic_flow, SRCSIZE));
+    ubase_assert(upipe_set_flow_def(multi, pic_flow));
+    uref_free(pic_flow);
+
+    struct upipe *outputs[NB_OUTPUTS];
+    struct upipe *sinks[NB_OUTPUTS];
+    for (int i = 0; i < NB_OUTPUTS; i++) {
+        sinks[i] = upipe_void_alloc(&sws_multi_test_mgr,
+                uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                    "sink %d", i));
+        assert(sinks[i] != NULL);
+        sws_multi_test_from_upipe(sinks[i])->size = sizes[i];
+
+        struct uref *flow_def = uref_pic_flow_alloc_def(uref_mgr, 1);
+        assert(flow_def != NULL);
+        ubase_assert(uref_pic_flow_set_hsize(flow_def, sizes[i]));
+        ubase_assert(uref_pic_flow_set_vsize(flow_def, sizes[i]));
+        outputs[i] = upipe_flow_alloc_sub(multi,
+                uprobe_pfx_alloc_va(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                    "output %d", i),
+                flow_def);
+        assert(outputs[i] != NULL);
+        uref_free(flow_def);
+        ubase_assert(upipe_set_output(outputs[i], sinks[i]));
+    }
+
+    /* references: the non-cascaded outputs from the source picture, the
+     * cascaded output from the reference of its source output, and the
+     * cascaded output directly from the source picture */
+    struct upipe_mgr *upipe_sws_mgr = upipe_sws_mgr_alloc();
+    assert(upipe_sws_mgr != NULL);
+    struct sws_ref refs[NB_OUTPUTS];
+    for (int i = 0; i < NB_OUTPUTS; i++)
+        sws_ref_alloc(&refs[i], upipe_sws_mgr, uref_mgr, logger,
+                      i == CASCADED ? sizes[CASCADE_SOURCE] : SRCSIZE,
+                      sizes[i]);
+    struct sws_ref direct;
+    sws_ref_alloc(&direct, upipe_sws_mgr, uref_mgr, logger,
+                  SRCSIZE, sizes[CASCADED]);
+
+    for (int i = 0; i < NB_PICS; i++) {
+        struct uref *uref = uref_pic_alloc(uref_mgr, ubuf_mgr,
+                                           SRCSIZE, SRCSIZE);
+        assert(uref != NULL);
+        ubase_assert(uref_pic_set_progressive(uref, true));
+        fill_in(uref, i);
+
+        struct uref *ref_pics[NB_OUTPUTS];
+        for (int j = 0; j < NB_OUTPUTS; j++)
+            if (j != CASCADED)
+                ref_pics[j] = sws_ref_scale(&refs[j], uref);
+        ref_pics[CASCADED] = sws_ref_scale(&refs[CASCADED],
+                                           ref_pics[CASCADE_SOURCE]);
+        struct uref *direct_pic = sws_ref_scale(&direct, uref);
+        /* the pattern is not scaled the same way in one or two steps */
+        assert(!compare(ref_pics[CASCADED], direct_pic));
+
+        upipe_input(multi, uref, NULL);
+        for (int j = 0; j < NB_OUTPUTS; j++) {
+            struct sws_multi_test *sink = sws_multi_test_from_upipe(sinks[j]);
+            assert(sink->count == i + 1);
+            assert(compare(sink->pic, ref_pics[j]));
+        }
+    }
+
+    for (int i = 0; i < NB_OUTPUTS; i++)
+        assert(sws_multi_test_from_upipe(sinks[i])->count == NB_PICS);
+
+    for (int i = 0; i < NB_OUTPUTS; i++) {
+        upipe_release(outputs[i]);
+        test_free(sinks[i]);
+        sws_ref_release(&refs[i]);
+    }
+    sws_ref_release(&direct);
+    upipe_mgr_release(upipe_sws_mgr);
+    upipe_release(multi);
+
+    ubuf_mgr_release(ubuf_mgr);
+    uref_mgr_release(uref_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    return 0;
+}
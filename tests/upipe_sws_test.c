@@ -24,6 +24,7 @@
 #include "upipe/ubuf_pic_mem.h"
 #include "upipe/uref.h"
 #include "upipe/uref_pic_flow.h"
+#include "upipe/uref_pic_flow_formats.h"
 #include "upipe/uref_pic.h"
 #include "upipe/uref_std.h"
 #include "upipe-swscale/upipe_sws.h"
@@ -33,6 +34,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
 #include <assert.h>
 
 #include <libswscale/swscale.h>
@@ -49,6 +53,10 @@
 
 #define SRCSIZE             32
 #define DSTSIZE             16
+#define SWS_THREADS         4
+#define BENCH_HSIZE         1920
+#define BENCH_VSIZE         1080
+#define BENCH_PICS          8
 
 /** definition of our uprobe */
 static int catch(struct uprobe *uprobe, struct upipe *upipe,
@@ -177,6 +185,49 @@ static bool compare_chroma(struct uref **urefs, const char *chroma, uint8_t hsub
     return true;
 }
 
+/* fill a 10-bit plane with gradients in both directions */
+static void fill_in_10(struct uref *uref, const char *chroma,
+                       uint8_t hsub, uint8_t vsub)
+{
+    size_t hsize, vsize, stride;
+    uint8_t *buffer = NULL;
+    ubase_assert(uref_pic_plane_write(uref, chroma, 0, 0, -1, -1, &buffer));
+    ubase_assert(uref_pic_plane_size(uref, chroma, &stride,
+                                     NULL, NULL, NULL));
+    ubase_assert(uref_pic_size(uref, &hsize, &vsize, NULL));
+    for (int y = 0; y < vsize / vsub; y++) {
+        uint16_t *line = (uint16_t *)(buffer + y * stride);
+        for (int x = 0; x < hsize / hsub; x++)
+            line[x] = (x * 7 + y * 13) % 1024;
+    }
+    uref_pic_plane_unmap(uref, chroma, 0, 0, -1, -1);
+}
+
+/* check that a plane of two pictures is identical */
+static bool compare_plane(struct uref *uref1, struct uref *uref2,
+                          const char *chroma, uint8_t hsub, uint8_t vsub,
+                          uint8_t macropixel_size)
+{
+    size_t hsize, vsize, stride1, stride2;
+    const uint8_t *buffer1, *buffer2;
+    ubase_assert(uref_pic_size(uref1, &hsize, &vsize, NULL));
+    ubase_assert(uref_pic_plane_read(uref1, chroma, 0, 0, -1, -1, &buffer1));
+    ubase_assert(uref_pic_plane_read(uref2, chroma, 0, 0, -1, -1, &buffer2));
+    ubase_assert(uref_pic_plane_size(uref1, chroma, &stride1,
+                                     NULL, NULL, NULL));
+    ubase_assert(uref_pic_plane_size(uref2, chroma, &stride2,
+                                     NULL, NULL, NULL));
+
+    bool same = true;
+    for (int y = 0; y < vsize / vsub && same; y++)
+        same = !memcmp(buffer1 + y * stride1, buffer2 + y * stride2,
+                       hsize / hsub * macropixel_size);
+
+    uref_pic_plane_unmap(uref1, chroma, 0, 0, -1, -1);
+    uref_pic_plane_unmap(uref2, chroma, 0, 0, -1, -1);
+    return same;
+}
+
 /** helper phony pipe */
 struct sws_test {
     struct uref *pic;
@@ -271,6 +322,71 @@ static int check_image_pointers(const uint8_t * const data[4], enum AVPixelForma
     return 1;
 }
 
+/** converts 4:2:2 10 bits pictures to 4:2:0, returns the last converted
+ * picture in pic_p and the time spent */
+static uint64_t bench(struct uref_mgr *uref_mgr, struct umem_mgr *umem_mgr,
+                      struct uprobe *logger, struct upipe *sws_test,
+                      unsigned int threads, struct uref **pic_p)
+{
+    struct ubuf_mgr *ubuf_mgr =
+        ubuf_pic_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH, umem_mgr, 1,
+                               UBUF_PREPEND, UBUF_APPEND,
+                               UBUF_PREPEND, UBUF_APPEND,
+                               UBUF_ALIGN, UBUF_ALIGN_HOFFSET);
+    assert(ubuf_mgr != NULL);
+    ubase_assert(ubuf_pic_mem_mgr_add_plane(ubuf_mgr, "y10l", 1, 1, 2));
+    ubase_assert(ubuf_pic_mem_mgr_add_plane(ubuf_mgr, "u10l", 2, 1, 2));
+    ubase_assert(ubuf_pic_mem_mgr_add_plane(ubuf_mgr, "v10l", 2, 1, 2));
+
+    struct uref *pic_flow = uref_pic_flow_alloc_yuv422p10le(uref_mgr);
+    assert(pic_flow != NULL);
+    ubase_assert(uref_pic_flow_set_hsize(pic_flow, BENCH_HSIZE));
+    ubase_assert(uref_pic_flow_set_vsize(pic_flow, BENCH_VSIZE));
+    struct uref *output_flow = uref_pic_flow_alloc_yuv420p10le(uref_mgr);
+    assert(output_flow != NULL);
+
+    struct upipe *sws = upipe_flow_alloc(upipe_sws_mgr_alloc(),
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "sws bench"),
+            output_flow);
+    assert(sws != NULL);
+    uref_free(output_flow);
+    ubase_assert(upipe_sws_set_threads(sws, threads));
+    ubase_assert(upipe_set_flow_def(sws, pic_flow));
+    uref_free(pic_flow);
+    ubase_assert(upipe_set_output(sws, sws_test));
+
+    struct uref *uref = uref_pic_alloc(uref_mgr, ubuf_mgr,
+                                       BENCH_HSIZE, BENCH_VSIZE);
+    assert(uref != NULL);
+    ubase_assert(uref_pic_set_progressive(uref, true));
+    fill_in_10(uref, "y10l", 1, 1);
+    fill_in_10(uref, "u10l", 2, 1);
+    fill_in_10(uref, "v10l", 2, 1);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_PICS; i++)
+        upipe_input(sws, uref_dup(uref), NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    struct uref *pic = sws_test_from_upipe(sws_test)->pic;
+    assert(pic != NULL);
+    size_t hsize, vsize;
+    ubase_assert(uref_pic_size(pic, &hsize, &vsize, NULL));
+    assert(hsize == BENCH_HSIZE);
+    assert(vsize == BENCH_VSIZE);
+    ubase_assert(uref_pic_plane_size(pic, "u10l", NULL, NULL, NULL, NULL));
+    *pic_p = pic;
+    sws_test_from_upipe(sws_test)->pic = NULL;
+
+    uref_free(uref);
+    upipe_release(sws);
+    ubuf_mgr_release(ubuf_mgr);
+    return (end.tv_sec - start.tv_sec) * UINT64_C(1000000000) +
+           end.tv_nsec - start.tv_nsec;
+}
+
 int main(int argc, char **argv)
 {
 
@@ -403,10 +519,43 @@ int main(int argc, char **argv)
     assert(compare_chroma(((struct uref*[]){uref2, sws_test_from_upipe(sws_test)->pic}), "u8", 2, 2, 1, logger));
     assert(compare_chroma(((struct uref*[]){uref2, sws_test_from_upipe(sws_test)->pic}), "v8", 2, 2, 1, logger));
 
+    /* same picture with slice threads, converted by the calling thread
+     * because of the vertical scaling */
+    unsigned int threads;
+    ubase_assert(upipe_sws_get_threads(sws, &threads));
+    assert(threads == 0);
+    ubase_assert(upipe_sws_set_threads(sws, SWS_THREADS));
+    ubase_assert(upipe_sws_get_threads(sws, &threads));
+    assert(threads == SWS_THREADS);
+    upipe_input(sws, uref_dup(uref1), NULL);
+
+    assert(sws_test_from_upipe(sws_test)->pic);
+    assert(compare_chroma(((struct uref*[]){uref2, sws_test_from_upipe(sws_test)->pic}), "y8", 1, 1, 1, logger));
+    assert(compare_chroma(((struct uref*[]){uref2, sws_test_from_upipe(sws_test)->pic}), "u8", 2, 2, 1, logger));
+    assert(compare_chroma(((struct uref*[]){uref2, sws_test_from_upipe(sws_test)->pic}), "v8", 2, 2, 1, logger));
+
     /* release urefs */
     uref_free(uref1);
     uref_free(uref2);
 
+    /* 4:2:2 to 4:2:0 conversion, converted in bands */
+    struct uref *pic1, *picn;
+    uint64_t elapsed1 = bench(uref_mgr, umem_mgr, logger, sws_test, 1,
+                              &pic1);
+    uint64_t elapsedn = bench(uref_mgr, umem_mgr, logger, sws_test,
+                              SWS_THREADS, &picn);
+    /* bands overlap, so the output does not depend on the threads */
+    assert(compare_plane(pic1, picn, "y10l", 1, 1, 2));
+    assert(compare_plane(pic1, picn, "u10l", 2, 2, 2));
+    assert(compare_plane(pic1, picn, "v10l", 2, 2, 2));
+    uref_free(pic1);
+    uref_free(picn);
+    uprobe_notice_va(logger, NULL,
+            "%d pictures %dx%d yuv422p10le -> yuv420p10le: "
+            "1 thread %"PRIu64" ms, %d threads %"PRIu64" ms",
+            BENCH_PICS, BENCH_HSIZE, BENCH_VSIZE, elapsed1 / 1000000,
+            SWS_THREADS, elapsedn / 1000000);
+
     /* release pipes */
     upipe_release(sws);
     test_free(sws_test);
@@ -33,6 +33,7 @@
 #define UPUMP_BLOCKER_POOL 1
 #define XFER_QUEUE 255
 #define XFER_POOL 1
+#define XFER_BATCH 512
 
 static struct upump_mgr *upump_mgr = NULL;
 static bool transferred = false;
@@ -154,7 +155,8 @@ int main(int argc, char **argv)
     ubase_assert(uprobe_xfer_add(uprobe_xfer, UPROBE_XFER_VOID,
                                  UPROBE_SOURCE_END, 0));
     struct upipe *upipe_test = upipe_void_alloc(&test_mgr,
-            uprobe_pfx_alloc(uprobe_xfer, UPROBE_LOG_VERBOSE, "test"));
+            uprobe_pfx_alloc(uprobe_use(uprobe_xfer), UPROBE_LOG_VERBOSE,
+                             "test"));
     assert(upipe_test != NULL);
 
     struct upipe_mgr *upipe_xfer_mgr =
@@ -174,13 +176,35 @@ int main(int argc, char **argv)
     ubase_assert(upipe_set_uri(upipe_handle, "toto"));
     upipe_release(upipe_handle);
 
+    /* more messages than the queue can hold */
+    ubase_assert(upipe_xfer_mgr_batch_begin(upipe_xfer_mgr));
+    for (int i = 0; i < XFER_BATCH; i++) {
+        upipe_test = upipe_void_alloc(&test_mgr,
+                uprobe_pfx_alloc(uprobe_use(uprobe_xfer), UPROBE_LOG_VERBOSE,
+                                 "test batch"));
+        assert(upipe_test != NULL);
+        upipe_handle = upipe_xfer_alloc(upipe_xfer_mgr,
+                uprobe_pfx_alloc(uprobe_use(uprobe_upump_mgr),
+                                 UPROBE_LOG_VERBOSE, "xfer batch"),
+                upipe_test);
+        assert(upipe_handle != NULL);
+        ubase_assert(upipe_xfer_mgr_batch_begin(upipe_xfer_mgr));
+        ubase_assert(upipe_attach_upump_mgr(upipe_handle));
+        ubase_assert(upipe_set_uri(upipe_handle, "toto"));
+        ubase_assert(upipe_xfer_mgr_batch_end(upipe_xfer_mgr));
+        upipe_release(upipe_handle);
+    }
+    ubase_assert(upipe_xfer_mgr_batch_end(upipe_xfer_mgr));
+    ubase_nassert(upipe_xfer_mgr_batch_end(upipe_xfer_mgr));
+    uprobe_release(uprobe_xfer);
+
     upipe_mgr_release(upipe_xfer_mgr);
 
     upump_mgr_run(upump_mgr, NULL);
 
     assert(!pthread_join(xfer_thread_id, NULL));
     assert(transferred);
-    assert(uatomic_load(&source_end) == 1);
+    assert(uatomic_load(&source_end) == 1 + XFER_BATCH);
 
     uprobe_release(uprobe_stdio);
     uprobe_release(uprobe_upump_mgr);
@@ -27,6 +27,7 @@
 #include "upipe/uref_std.h"
 #include "upipe/upipe.h"
 #include "upipe-ts/upipe_ts_check.h"
+#include "upipe-ts/uref_ts_vector.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -74,16 +75,28 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     assert(uref != NULL);
     size_t size;
     ubase_assert(uref_block_size(uref, &size));
-    assert(size == TS_SIZE);
 
-    const uint8_t *buffer;
-    int rsize = 1;
-    ubase_assert(uref_block_read(uref, 0, &rsize, &buffer));
-    assert(rsize == 1);
-    assert(ts_validate(buffer));
-    uref_block_unmap(uref, 0);
+    size_t packet_size = TS_SIZE;
+    unsigned int nb = 1;
+    const uint8_t *pids;
+    if (ubase_check(uref_ts_vector_get(uref, &packet_size, &nb, &pids))) {
+        assert(packet_size == TS_SIZE);
+        assert(nb == nb_packets);
+        for (unsigned int i = 0; i < nb; i++)
+            assert(uref_ts_vector_pid(pids, i) == 0x1fff);
+    }
+    assert(size == nb * TS_SIZE);
+
+    for (unsigned int i = 0; i < nb; i++) {
+        const uint8_t *buffer;
+        int rsize = 1;
+        ubase_assert(uref_block_read(uref, i * TS_SIZE, &rsize, &buffer));
+        assert(rsize == 1);
+        assert(ts_validate(buffer));
+        uref_block_unmap(uref, i * TS_SIZE);
+    }
     uref_free(uref);
-    nb_packets--;
+    nb_packets -= nb;
 }
 
 /** helper phony pipe */
@@ -193,6 +206,39 @@ int main(int argc, char *argv[])
     upipe_input(upipe_ts_check, uref, NULL);
     assert(!nb_packets);
 
+    /* packet vectors */
+    int vector;
+    ubase_assert(upipe_ts_check_get_vector(upipe_ts_check, &vector));
+    assert(!vector);
+    ubase_assert(upipe_ts_check_set_vector(upipe_ts_check, true));
+    ubase_assert(upipe_ts_check_get_vector(upipe_ts_check, &vector));
+    assert(vector);
+
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 7 * TS_SIZE + 12);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 7 * TS_SIZE + 12);
+    for (i = 0; i < 7; i++)
+        ts_pad(buffer + i * TS_SIZE);
+    uref_block_unmap(uref, 0);
+    nb_packets = 7;
+    upipe_input(upipe_ts_check, uref, NULL);
+    assert(!nb_packets);
+
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 7 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 7 * TS_SIZE);
+    for (i = 0; i < 7; i++)
+        ts_pad(buffer + i * TS_SIZE);
+    buffer[3 * TS_SIZE] = 0xff;
+    uref_block_unmap(uref, 0);
+    nb_packets = 3;
+    upipe_input(upipe_ts_check, uref, NULL);
+    assert(!nb_packets);
+
     upipe_release(upipe_ts_check);
     upipe_mgr_release(upipe_ts_check_mgr); // nop
 
@@ -29,9 +29,11 @@
 #include "upipe/uref_std.h"
 #include "upipe/upipe.h"
 #include "upipe-ts/upipe_ts_decaps.h"
+#include "upipe-ts/uref_ts_vector.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <bitstream/mpeg/ts.h>
@@ -89,11 +91,13 @@ static void test_input(struct upipe *upipe, struct uref *uref,
 {
     assert(uref != NULL);
     size_t size;
+    const uint8_t *vector;
     ubase_assert(uref_block_size(uref, &size));
     assert(size == payload_size);
     assert(transporterror == uref_flow_get_error(uref));
     assert(discontinuity == uref_flow_get_discontinuity(uref));
     assert(start == uref_block_get_start(uref));
+    assert(!ubase_check(uref_ts_vector_get_internal(uref, &vector, &size)));
     uref_free(uref);
     nb_packets--;
 }
@@ -219,6 +223,32 @@ int main(int argc, char *argv[])
     assert(!nb_packets);
     assert(!pcr);
 
+    /* packet vector, with a duplicate packet */
+    static const uint8_t vector_cc[] = { 4, 5, 5, 6 };
+    unsigned int nb = sizeof(vector_cc);
+    uint8_t pids[2 * nb];
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, nb * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == nb * TS_SIZE);
+    for (unsigned int i = 0; i < nb; i++) {
+        uint8_t *packet = buffer + i * TS_SIZE;
+        ts_init(packet);
+        ts_set_cc(packet, vector_cc[i]);
+        ts_set_payload(packet);
+        memset(packet + TS_HEADER_SIZE, vector_cc[i],
+               TS_SIZE - TS_HEADER_SIZE);
+        uref_ts_vector_set_pid(pids, i, 0);
+    }
+    uref_block_unmap(uref, 0);
+    ubase_assert(uref_ts_vector_set(uref, TS_SIZE, nb, pids));
+    discontinuity = UBASE_ERR_INVALID;
+    payload_size = 184;
+    nb_packets += 3;
+    upipe_input(upipe_ts_decaps, uref, NULL);
+    assert(!nb_packets);
+
     upipe_release(upipe_ts_decaps);
     upipe_mgr_release(upipe_ts_decaps_mgr); // nop
 
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for TS monitor module
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe-ts/upipe_ts_monitor.h"
+#include "upipe-ts/uref_ts_vector.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <assert.h>
+
+#include <bitstream/mpeg/ts.h>
+#include <bitstream/mpeg/psi.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+
+#define PMT_PID 0x100
+#define PCR_PID 0x101
+#define ES_PID 0x102
+
+static struct uref_mgr *uref_mgr;
+static struct ubuf_mgr *ubuf_mgr;
+static struct upipe *upipe_ts_monitor;
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_NEW_FLOW_DEF:
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** allocates a TS packet with the given PID and arrival date */
+static struct uref *packet_alloc(uint16_t pid, uint64_t cr_sys,
+                                 uint8_t **buffer_p)
+{
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, TS_SIZE);
+    assert(uref != NULL);
+    int size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, buffer_p));
+    assert(size == TS_SIZE);
+    ts_init(*buffer_p);
+    ts_set_pid(*buffer_p, pid);
+    uref_clock_set_cr_sys(uref, cr_sys);
+    return uref;
+}
+
+/** sends a PAT announcing the PMT PID */
+static void send_pat(uint8_t cc, uint64_t cr_sys)
+{
+    uint8_t *buffer;
+    struct uref *uref = packet_alloc(0, cr_sys, &buffer);
+    ts_set_unitstart(buffer);
+    ts_set_cc(buffer, cc);
+    ts_set_payload(buffer);
+    uint8_t *payload = ts_payload(buffer);
+    *payload++ = 0; /* pointer_field */
+    pat_init(payload);
+    pat_set_length(payload, PAT_PROGRAM_SIZE);
+    pat_set_tsid(payload, 42);
+    psi_set_version(payload, 0);
+    psi_set_current(payload);
+    psi_set_section(payload, 0);
+    psi_set_lastsection(payload, 0);
+    uint8_t *pat_program = pat_get_program(payload, 0);
+    patn_init(pat_program);
+    patn_set_program(pat_program, 1);
+    patn_set_pid(pat_program, PMT_PID);
+    psi_set_crc(payload);
+    payload += PAT_HEADER_SIZE + PAT_PROGRAM_SIZE + PSI_CRC_SIZE;
+    *payload = 0xff;
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_ts_monitor, uref, NULL);
+}
+
+/** sends a packet carrying a PCR */
+static void send_pcr(uint64_t pcr, uint64_t cr_sys)
+{
+    uint8_t *buffer;
+    struct uref *uref = packet_alloc(PCR_PID, cr_sys, &buffer);
+    ts_set_adaptation(buffer, TS_SIZE - TS_HEADER_SIZE - 1);
+    tsaf_set_pcr(buffer, pcr / 300);
+    tsaf_set_pcrext(buffer, pcr % 300);
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_ts_monitor, uref, NULL);
+}
+
+/** sends an elementary stream packet */
+static void send_es(uint8_t cc, uint64_t cr_sys, bool error)
+{
+    uint8_t *buffer;
+    struct uref *uref = packet_alloc(ES_PID, cr_sys, &buffer);
+    ts_set_cc(buffer, cc);
+    ts_set_payload(buffer);
+    if (error)
+        ts_set_transporterror(buffer);
+    uref_block_unmap(uref, 0);
+    upipe_input(upipe_ts_monitor, uref, NULL);
+}
+
+/** sends elementary stream packets in a single block, optionally described
+ * by a packet vector */
+static void send_es_block(const uint8_t *ccs, unsigned int nb,
+                          uint64_t cr_sys, bool vector)
+{
+    uint8_t pids[2 * nb];
+    uint8_t *buffer;
+    int size = -1;
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, nb * TS_SIZE);
+    assert(uref != NULL);
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == nb * TS_SIZE);
+    for (unsigned int i = 0; i < nb; i++) {
+        ts_init(buffer + i * TS_SIZE);
+        ts_set_pid(buffer + i * TS_SIZE, ES_PID);
+        ts_set_cc(buffer + i * TS_SIZE, ccs[i]);
+        ts_set_payload(buffer + i * TS_SIZE);
+        uref_ts_vector_set_pid(pids, i, ES_PID);
+    }
+    uref_block_unmap(uref, 0);
+    if (vector)
+        ubase_assert(uref_ts_vector_set(uref, TS_SIZE, nb, pids));
+    uref_clock_set_cr_sys(uref, cr_sys);
+    upipe_input(upipe_ts_monitor, uref, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr, 0);
+    assert(uref_mgr != NULL);
+    ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                        umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *uprobe_stdio = uprobe_stdio_alloc(&uprobe, stdout,
+                                                     UPROBE_LOG_LEVEL);
+    assert(uprobe_stdio != NULL);
+
+    struct upipe_mgr *upipe_ts_monitor_mgr = upipe_ts_monitor_mgr_alloc();
+    assert(upipe_ts_monitor_mgr != NULL);
+    upipe_ts_monitor = upipe_void_alloc(upipe_ts_monitor_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts monitor"));
+    assert(upipe_ts_monitor != NULL);
+
+    struct uref *uref = uref_block_flow_alloc_def(uref_mgr, "mpegts.");
+    assert(uref != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_monitor, uref));
+    uref_free(uref);
+
+    uint64_t period;
+    ubase_assert(upipe_ts_monitor_get_period(upipe_ts_monitor, &period));
+    assert(period == UCLOCK_FREQ);
+
+    /* one packet every 1000 ticks, PCR every 10 packets */
+    send_pat(0, 0);
+    send_pcr(0, 0);
+    for (uint8_t cc = 0; cc < 9; cc++)
+        send_es(cc, 0, false);
+    send_pcr(10000, 10000);
+    /* duplicate packet, then one packet lost */
+    static const uint8_t ccs[] = { 9, 9, 11, 12, 13, 14, 15, 0, 1 };
+    for (unsigned int i = 0; i < sizeof(ccs); i++)
+        send_es(ccs[i], 10000, false);
+    /* late by 50 ticks, arriving 200 ticks late */
+    send_pcr(20050, 20200);
+    send_pat(1, UCLOCK_FREQ / 2);
+    send_es(2, UCLOCK_FREQ / 2, true);
+    /* end of the first measurement period */
+    send_es(2, UCLOCK_FREQ, false);
+
+    static const unsigned int seen[] = { 0, PMT_PID, PCR_PID, ES_PID };
+    unsigned int pid = UINT_MAX;
+    for (unsigned int i = 0; i < sizeof(seen) / sizeof(seen[0]); i++) {
+        ubase_assert(upipe_ts_monitor_iterate_pid(upipe_ts_monitor, &pid));
+        assert(pid == seen[i]);
+    }
+    ubase_assert(upipe_ts_monitor_iterate_pid(upipe_ts_monitor, &pid));
+    assert(pid == UINT_MAX);
+
+    struct upipe_ts_monitor_stats stats;
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, 0, &stats));
+    assert(stats.packets == 2);
+    assert(stats.cc_errors == 0);
+    assert(stats.nb_tables == 1);
+    assert(stats.tables[0].table_id == PAT_TABLE_ID);
+    assert(stats.tables[0].count == 2);
+    assert(stats.tables[0].interval == UCLOCK_FREQ / 2);
+    assert(stats.tables[0].interval_max == UCLOCK_FREQ / 2);
+
+    /* announced in the PAT but not received */
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, PMT_PID,
+                                            &stats));
+    assert(stats.packets == 0);
+
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, PCR_PID,
+                                            &stats));
+    assert(stats.packets == 3);
+    assert(stats.cc_errors == 0);
+    assert(stats.pcrs == 3);
+    assert(stats.pcr_interval_max == 10050);
+    assert(stats.pcr_accuracy_max == 50);
+    assert(stats.pcr_jitter_max == 150);
+
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, ES_PID,
+                                            &stats));
+    assert(stats.packets == 20);
+    assert(stats.cc_errors == 1);
+    assert(stats.transport_errors == 1);
+    assert(stats.bitrate == 19 * TS_SIZE * 8);
+    assert(stats.nb_tables == 0);
+
+    assert(!ubase_check(upipe_ts_monitor_get_stats(upipe_ts_monitor, 0x200,
+                                                   &stats)));
+
+    ubase_assert(upipe_ts_monitor_reset_stats(upipe_ts_monitor));
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, ES_PID,
+                                            &stats));
+    assert(stats.packets == 0);
+    assert(stats.cc_errors == 0);
+
+    /* packet vector, with a lost packet */
+    static const uint8_t vector_ccs[] = { 3, 4, 6 };
+    send_es_block(vector_ccs, sizeof(vector_ccs), UCLOCK_FREQ, true);
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, ES_PID,
+                                            &stats));
+    assert(stats.packets == 3);
+    assert(stats.cc_errors == 1);
+
+    /* plain block of several packets, with a lost packet */
+    static const uint8_t block_ccs[] = { 7, 8, 10 };
+    send_es_block(block_ccs, sizeof(block_ccs), UCLOCK_FREQ, false);
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, ES_PID,
+                                            &stats));
+    assert(stats.packets == 6);
+    assert(stats.cc_errors == 2);
+
+    /* arrival date going backwards */
+    send_pcr(30050, 100);
+    ubase_assert(upipe_ts_monitor_get_stats(upipe_ts_monitor, PCR_PID,
+                                            &stats));
+    assert(stats.pcrs == 1);
+    assert(stats.pcr_jitter_max == 0);
+
+    upipe_release(upipe_ts_monitor);
+    upipe_mgr_release(upipe_ts_monitor_mgr); // nop
+
+    uref_mgr_release(uref_mgr);
+    ubuf_mgr_release(ubuf_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(uprobe_stdio);
+    uprobe_clean(&uprobe);
+
+    return 0;
+}
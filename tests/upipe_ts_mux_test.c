@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for the splice order of the TS mux module
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/uprobe_uref_mgr.h"
+#include "upipe/uprobe_ubuf_mem.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/uref.h"
+#include "upipe/uref_flow.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_pic_flow.h"
+#include "upipe/uref_sound_flow.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe-ts/upipe_ts_mux.h"
+#include "upipe-ts/uref_ts_flow.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <bitstream/mpeg/ts.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UBUF_SHARED_POOL_DEPTH 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+
+#define NB_PROGRAMS 3
+/* a video stream, then two identical audio streams */
+#define NB_ROLES 3
+#define ROLE_VIDEO 0
+#define ROLE_AUDIO 1
+#define START_DATE UINT32_MAX
+#define DURATION (UCLOCK_FREQ * 2)
+#define VIDEO_OCTETRATE 150000
+#define VIDEO_FRAME_DURATION (UCLOCK_FREQ / 25)
+#define VIDEO_GOP 12
+#define AUDIO_OCTETRATE 24000
+#define AUDIO_SAMPLES 1152
+#define AUDIO_RATE 48000
+#define AUDIO_FRAME_DURATION (UCLOCK_FREQ * AUDIO_SAMPLES / AUDIO_RATE)
+#define AUDIO_FRAME_SIZE (AUDIO_OCTETRATE * AUDIO_SAMPLES / AUDIO_RATE)
+#define MAX_PACKETS 16384
+
+static struct uref_mgr *uref_mgr;
+static struct ubuf_mgr *ubuf_mgr;
+static uint16_t pids[MAX_PACKETS];
+static unsigned int nb_packets = 0;
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_NEW_FLOW_DEF:
+            break;
+        case UPROBE_TS_MUX_LAST_CC:
+            UBASE_SIGNATURE_CHECK(args, UPIPE_TS_MUX_SIGNATURE)
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** helper phony pipe */
+static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct upipe *upipe = malloc(sizeof(struct upipe));
+    assert(upipe != NULL);
+    upipe_init(upipe, mgr, uprobe);
+    return upipe;
+}
+
+/** helper phony pipe recording the PIDs of the output packets */
+static void test_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    assert(size % TS_SIZE == 0);
+    for (size_t offset = 0; offset < size; offset += TS_SIZE) {
+        uint8_t buffer[TS_SIZE];
+        ubase_assert(uref_block_extract(uref, offset, TS_SIZE, buffer));
+        assert(nb_packets < MAX_PACKETS);
+        pids[nb_packets++] = ts_get_pid(buffer);
+    }
+    uref_free(uref);
+}
+
+/** helper phony pipe */
+static int test_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        case UPIPE_REGISTER_REQUEST: {
+            struct urequest *urequest = va_arg(args, struct urequest *);
+            return upipe_throw_provide_request(upipe, urequest);
+        }
+        case UPIPE_UNREGISTER_REQUEST:
+            return UBASE_ERR_NONE;
+        default:
+            assert(0);
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe */
+static void test_free(struct upipe *upipe)
+{
+    upipe_clean(upipe);
+    free(upipe);
+}
+
+/** helper phony pipe */
+static struct upipe_mgr ts_test_mgr = {
+    .refcount = NULL,
+    .upipe_alloc = test_alloc,
+    .upipe_input = test_input,
+    .upipe_control = test_control
+};
+
+/** returns the PID of a stream */
+static uint16_t stream_pid(unsigned int program, unsigned int role)
+{
+    return 0x100 * (program + 1) + role + 1;
+}
+
+/** allocates a program */
+static struct upipe *program_alloc(struct upipe *upipe_ts_mux,
+                                   struct uprobe *uprobe,
+                                   unsigned int program_index)
+{
+    struct uref *flow_def = uref_alloc_control(uref_mgr);
+    assert(flow_def != NULL);
+    ubase_assert(uref_flow_set_def(flow_def, "void."));
+    ubase_assert(uref_flow_set_id(flow_def, program_index + 1));
+    ubase_assert(uref_ts_flow_set_pid(flow_def,
+                                      0x100 * (program_index + 1)));
+    struct upipe *program = upipe_void_alloc_sub(upipe_ts_mux,
+            uprobe_pfx_alloc_va(uprobe_use(uprobe), UPROBE_LOG_LEVEL,
+                                "program %u", program_index));
+    assert(program != NULL);
+    ubase_assert(upipe_set_flow_def(program, flow_def));
+    uref_free(flow_def);
+    return program;
+}
+
+/** allocates an elementary stream input of a program */
+static struct upipe *input_alloc(struct upipe *program, struct uprobe *uprobe,
+                                 unsigned int program_index,
+                                 unsigned int role)
+{
+    struct uref *flow_def;
+    if (role == ROLE_VIDEO) {
+        flow_def = uref_block_flow_alloc_def(uref_mgr, "mpeg2video.pic.");
+        assert(flow_def != NULL);
+        ubase_assert(uref_block_flow_set_octetrate(flow_def,
+                                                   VIDEO_OCTETRATE));
+        ubase_assert(uref_block_flow_set_buffer_size(flow_def,
+                                                     VIDEO_OCTETRATE / 2));
+        struct urational fps = { .num = 25, .den = 1 };
+        ubase_assert(uref_pic_flow_set_fps(flow_def, fps));
+    } else {
+        flow_def = uref_block_flow_alloc_def(uref_mgr, "mp2.sound.");
+        assert(flow_def != NULL);
+        ubase_assert(uref_block_flow_set_octetrate(flow_def,
+                                                   AUDIO_OCTETRATE));
+        ubase_assert(uref_sound_flow_set_rate(flow_def, AUDIO_RATE));
+        ubase_assert(uref_sound_flow_set_samples(flow_def, AUDIO_SAMPLES));
+    }
+    ubase_assert(uref_ts_flow_set_pid(flow_def,
+                                      stream_pid(program_index, role)));
+    struct upipe *input = upipe_void_alloc_sub(program,
+            uprobe_pfx_alloc_va(uprobe_use(uprobe), UPROBE_LOG_LEVEL,
+                                "input %u.%u", program_index, role));
+    assert(input != NULL);
+    ubase_assert(upipe_set_flow_def(input, flow_def));
+    uref_free(flow_def);
+    return input;
+}
+
+/** sends an access unit to an input */
+static void send_frame(struct upipe *input, size_t size, uint64_t dts,
+                       uint64_t duration, bool random)
+{
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, size);
+    assert(uref != NULL);
+    uint8_t *buffer;
+    int buffer_size = -1;
+    ubase_assert(uref_block_write(uref, 0, &buffer_size, &buffer));
+    memset(buffer, 0, buffer_size);
+    uref_block_unmap(uref, 0);
+    uref_block_set_start(uref);
+    if (random)
+        uref_flow_set_random(uref);
+    uref_clock_set_dts_sys(uref, dts);
+    uref_clock_set_dts_prog(uref, dts);
+    uref_clock_set_dts_pts_delay(uref, 0);
+    uref_clock_set_duration(uref, duration);
+    upipe_input(input, uref, NULL);
+}
+
+/** checks that identical streams of the given PIDs are spliced in the given
+ * order: inputs with the same dates are served in the order of the programs
+ * and of their inputs, so that the n-th packet of a PID never comes before
+ * the n-th packet of the previous PIDs */
+static void check_order(const uint16_t *pids_order, unsigned int nb,
+                        unsigned int nb_checked)
+{
+    unsigned int counts[nb];
+    memset(counts, 0, sizeof(counts));
+    for (unsigned int i = 0; i < nb_checked; i++) {
+        for (unsigned int j = 0; j < nb; j++) {
+            if (pids[i] != pids_order[j])
+                continue;
+            counts[j]++;
+            assert(!j || counts[j] <= counts[j - 1]);
+            break;
+        }
+    }
+    assert(counts[nb - 1]);
+}
+
+int main(int argc, char *argv[])
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr, 0);
+    assert(uref_mgr != NULL);
+    ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH, UBUF_POOL_DEPTH,
+                                        umem_mgr, 0, 0, -1, 0);
+    assert(ubuf_mgr != NULL);
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *logger = uprobe_stdio_alloc(&uprobe, stdout,
+                                               UPROBE_LOG_LEVEL);
+    assert(logger != NULL);
+    logger = uprobe_uref_mgr_alloc(logger, uref_mgr);
+    assert(logger != NULL);
+    logger = uprobe_ubuf_mem_alloc(logger, umem_mgr, UBUF_POOL_DEPTH,
+                                   UBUF_SHARED_POOL_DEPTH);
+    assert(logger != NULL);
+
+    struct upipe_mgr *upipe_ts_mux_mgr = upipe_ts_mux_mgr_alloc();
+    assert(upipe_ts_mux_mgr != NULL);
+    struct uref *flow_def = uref_alloc_control(uref_mgr);
+    assert(flow_def != NULL);
+    ubase_assert(uref_flow_set_def(flow_def, "void."));
+    struct upipe *upipe_ts_mux = upipe_void_alloc(upipe_ts_mux_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL, "ts mux"));
+    assert(upipe_ts_mux != NULL);
+    upipe_mgr_release(upipe_ts_mux_mgr);
+    ubase_assert(upipe_set_flow_def(upipe_ts_mux, flow_def));
+    uref_free(flow_def);
+    ubase_assert(upipe_ts_mux_set_conformance(upipe_ts_mux,
+                                              UPIPE_TS_CONFORMANCE_ISO));
+    ubase_assert(upipe_ts_mux_set_mode(upipe_ts_mux,
+                                       UPIPE_TS_MUX_MODE_CAPPED));
+    ubase_assert(upipe_ts_mux_set_cr_prog(upipe_ts_mux, 0));
+
+    struct upipe *upipe_sink = upipe_void_alloc(&ts_test_mgr,
+                                                uprobe_use(logger));
+    assert(upipe_sink != NULL);
+    ubase_assert(upipe_set_output(upipe_ts_mux, upipe_sink));
+
+    struct upipe *programs[NB_PROGRAMS];
+    struct upipe *inputs[NB_PROGRAMS][NB_ROLES];
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        programs[i] = program_alloc(upipe_ts_mux, logger, i);
+        for (unsigned int j = 0; j < NB_ROLES; j++)
+            inputs[i][j] = input_alloc(programs[i], logger, i, j);
+    }
+
+    /* an input without data holds the mux back until all streams are
+     * queued, so that every input has the same backlog when spliced */
+    struct upipe *hold_program = program_alloc(upipe_ts_mux, logger,
+                                               NB_PROGRAMS);
+    struct upipe *hold_input = input_alloc(hold_program, logger,
+                                           NB_PROGRAMS, ROLE_VIDEO);
+
+    /* identical streams in every program, sent in date order */
+    unsigned int video_frame = 0, audio_frame = 0;
+    for ( ; ; ) {
+        uint64_t video_dts = START_DATE + video_frame * VIDEO_FRAME_DURATION;
+        uint64_t audio_dts = START_DATE + audio_frame * AUDIO_FRAME_DURATION;
+        if (video_dts >= START_DATE + DURATION &&
+            audio_dts >= START_DATE + DURATION)
+            break;
+
+        if (video_dts <= audio_dts) {
+            bool random = !(video_frame % VIDEO_GOP);
+            size_t size = random ? 20000 : 3000 + 500 * (video_frame % 3);
+            for (unsigned int i = 0; i < NB_PROGRAMS; i++)
+                send_frame(inputs[i][ROLE_VIDEO], size, video_dts,
+                           VIDEO_FRAME_DURATION, random);
+            video_frame++;
+        } else {
+            for (unsigned int i = 0; i < NB_PROGRAMS; i++)
+                for (unsigned int j = ROLE_AUDIO; j < NB_ROLES; j++)
+                    send_frame(inputs[i][j], AUDIO_FRAME_SIZE, audio_dts,
+                               AUDIO_FRAME_DURATION, true);
+            audio_frame++;
+        }
+    }
+
+    assert(!nb_packets);
+    upipe_release(hold_input);
+    upipe_release(hold_program);
+    /* the mux stops when the first input runs out of data */
+    unsigned int nb_spliced = nb_packets;
+    assert(nb_spliced);
+
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++) {
+        for (unsigned int j = 0; j < NB_ROLES; j++)
+            upipe_release(inputs[i][j]);
+        upipe_release(programs[i]);
+    }
+    upipe_release(upipe_ts_mux);
+
+    uint16_t order[NB_PROGRAMS * NB_ROLES];
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++)
+        order[i] = stream_pid(i, ROLE_VIDEO);
+    check_order(order, NB_PROGRAMS, nb_spliced);
+
+    unsigned int nb = 0;
+    for (unsigned int i = 0; i < NB_PROGRAMS; i++)
+        for (unsigned int j = ROLE_AUDIO; j < NB_ROLES; j++)
+            order[nb++] = stream_pid(i, j);
+    check_order(order, nb, nb_spliced);
+
+    test_free(upipe_sink);
+
+    uref_mgr_release(uref_mgr);
+    ubuf_mgr_release(ubuf_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uprobe_release(logger);
+    uprobe_clean(&uprobe);
+
+    return 0;
+}
@@ -28,6 +28,7 @@
 #include "upipe/upipe.h"
 #include "upipe-ts/uref_ts_flow.h"
 #include "upipe-ts/upipe_ts_split.h"
+#include "upipe-ts/uref_ts_vector.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -73,7 +74,9 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
 
 struct test {
     uint16_t pid;
+    bool vector;
     bool got_packet;
+    unsigned int nb_packets;
     struct upipe upipe;
 };
 
@@ -88,7 +91,9 @@ static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
     assert(test != NULL);
     upipe_init(&test->upipe, mgr, uprobe);
     test->got_packet = false;
+    test->nb_packets = 0;
     test->pid = pid;
+    test->vector = ubase_check(uref_ts_flow_get_vector(flow_def));
     return &test->upipe;
 }
 
@@ -99,14 +104,28 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     struct test *test = container_of(upipe, struct test, upipe);
     assert(uref != NULL);
     test->got_packet = true;
+
+    size_t packet_size = TS_SIZE;
+    unsigned int nb = 1;
+    const uint8_t *pids;
+    if (ubase_check(uref_ts_vector_get(uref, &packet_size, &nb, &pids))) {
+        assert(test->vector);
+        assert(packet_size == TS_SIZE);
+        for (unsigned int i = 0; i < nb; i++)
+            assert(uref_ts_vector_pid(pids, i) == test->pid);
+    }
+
     const uint8_t *buffer;
     int size = -1;
     ubase_assert(uref_block_read(uref, 0, &size, &buffer));
-    assert(size == TS_SIZE); //because of the way we allocated it
-    assert(ts_validate(buffer));
-    assert(ts_get_pid(buffer) == test->pid);
+    assert(size == nb * TS_SIZE); //because of the way we allocated it
+    for (unsigned int i = 0; i < nb; i++) {
+        assert(ts_validate(buffer + i * TS_SIZE));
+        assert(ts_get_pid(buffer + i * TS_SIZE) == test->pid);
+    }
     uref_block_unmap(uref, 0);
     uref_free(uref);
+    test->nb_packets += nb;
 }
 
 /** helper phony pipe */
@@ -182,6 +201,7 @@ int main(int argc, char *argv[])
     ubase_assert(upipe_set_output(upipe_ts_split_output68, upipe_sink68));
 
     ubase_assert(uref_ts_flow_set_pid(uref, 69));
+    ubase_assert(uref_ts_flow_set_vector(uref));
     struct upipe *upipe_sink69 = upipe_flow_alloc(&test_mgr,
             uprobe_use(uprobe_stdio), uref);
     assert(upipe_sink69 != NULL);
@@ -193,6 +213,12 @@ int main(int argc, char *argv[])
     ubase_assert(upipe_set_output(upipe_ts_split_output69, upipe_sink69));
     uref_free(uref);
 
+    const uint64_t *wanted;
+    ubase_assert(upipe_ts_split_get_pids(upipe_ts_split, &wanted));
+    assert(upipe_ts_split_check_pid(wanted, 68));
+    assert(upipe_ts_split_check_pid(wanted, 69));
+    assert(!upipe_ts_split_check_pid(wanted, 70));
+
     uint8_t *buffer;
     int size;
     uref = uref_block_alloc(uref_mgr, ubuf_mgr, TS_SIZE);
@@ -215,7 +241,50 @@ int main(int argc, char *argv[])
     uref_block_unmap(uref, 0);
     upipe_input(upipe_ts_split, uref, NULL);
 
+    struct test *test68 = container_of(upipe_sink68, struct test, upipe);
+    struct test *test69 = container_of(upipe_sink69, struct test, upipe);
+    assert(test68->nb_packets == 1);
+    assert(test69->nb_packets == 1);
+
+    /* packet vector */
+    static const uint16_t vector_pids[] = { 68, 68, 69, 69, 69, 70, 68 };
+    unsigned int nb = sizeof(vector_pids) / sizeof(vector_pids[0]);
+    uint8_t pids[2 * nb];
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, nb * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == nb * TS_SIZE);
+    for (unsigned int i = 0; i < nb; i++) {
+        ts_pad(buffer + i * TS_SIZE);
+        ts_set_pid(buffer + i * TS_SIZE, vector_pids[i]);
+        uref_ts_vector_set_pid(pids, i, vector_pids[i]);
+    }
+    uref_block_unmap(uref, 0);
+    ubase_assert(uref_ts_vector_set(uref, TS_SIZE, nb, pids));
+    upipe_input(upipe_ts_split, uref, NULL);
+    assert(test68->nb_packets == 4);
+    assert(test69->nb_packets == 4);
+
+    /* vector without any wanted packet */
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 2 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    for (unsigned int i = 0; i < 2; i++) {
+        ts_pad(buffer + i * TS_SIZE);
+        ts_set_pid(buffer + i * TS_SIZE, 70);
+        uref_ts_vector_set_pid(pids, i, 70);
+    }
+    uref_block_unmap(uref, 0);
+    ubase_assert(uref_ts_vector_set(uref, TS_SIZE, 2, pids));
+    upipe_input(upipe_ts_split, uref, NULL);
+    assert(test68->nb_packets == 4);
+    assert(test69->nb_packets == 4);
+
     upipe_release(upipe_ts_split_output68);
+    assert(!upipe_ts_split_check_pid(wanted, 68));
+    assert(upipe_ts_split_check_pid(wanted, 69));
     upipe_release(upipe_ts_split_output69);
     upipe_release(upipe_ts_split);
     upipe_mgr_release(upipe_ts_split_mgr); // nop
@@ -24,9 +24,11 @@
 #include "upipe/uref.h"
 #include "upipe/uref_block_flow.h"
 #include "upipe/uref_block.h"
+#include "upipe/uref_clock.h"
 #include "upipe/uref_std.h"
 #include "upipe/upipe.h"
 #include "upipe-ts/upipe_ts_sync.h"
+#include "upipe-ts/uref_ts_vector.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -42,6 +44,16 @@
 static unsigned int nb_packets = 0;
 static int expect_loss = -1;
 
+/** expected packet vector */
+struct test_vector {
+    /** number of packets */
+    unsigned int nb;
+    /** arrival date */
+    uint64_t cr_sys;
+};
+/** next expected packet vectors */
+static const struct test_vector *vectors = NULL;
+
 /** definition of our uprobe */
 static int catch(struct uprobe *uprobe, struct upipe *upipe,
                  int event, va_list args)
@@ -79,16 +91,33 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     assert(uref != NULL);
     size_t size;
     ubase_assert(uref_block_size(uref, &size));
-    assert(size == TS_SIZE);
 
-    const uint8_t *buffer;
-    int rsize = 1;
-    ubase_assert(uref_block_read(uref, 0, &rsize, &buffer));
-    assert(rsize == 1);
-    assert(ts_validate(buffer));
-    uref_block_unmap(uref, 0);
+    size_t packet_size = TS_SIZE;
+    unsigned int nb = 1;
+    const uint8_t *pids;
+    if (ubase_check(uref_ts_vector_get(uref, &packet_size, &nb, &pids))) {
+        assert(vectors != NULL);
+        assert(packet_size == TS_SIZE);
+        assert(nb == vectors->nb);
+        uint64_t cr_sys;
+        ubase_assert(uref_clock_get_cr_sys(uref, &cr_sys));
+        assert(cr_sys == vectors->cr_sys);
+        vectors++;
+        for (unsigned int i = 0; i < nb; i++)
+            assert(uref_ts_vector_pid(pids, i) == 0x1fff);
+    }
+    assert(size == nb * TS_SIZE);
+
+    for (unsigned int i = 0; i < nb; i++) {
+        const uint8_t *buffer;
+        int rsize = 1;
+        ubase_assert(uref_block_read(uref, i * TS_SIZE, &rsize, &buffer));
+        assert(rsize == 1);
+        assert(ts_validate(buffer));
+        uref_block_unmap(uref, i * TS_SIZE);
+    }
     uref_free(uref);
-    nb_packets--;
+    nb_packets -= nb;
 }
 
 /** helper phony pipe */
@@ -216,6 +245,66 @@ int main(int argc, char *argv[])
     ubase_assert(upipe_ts_sync_get_sync(upipe_ts_sync, &sync));
     assert(sync == 4);
 
+    nb_packets++;
+    upipe_release(upipe_ts_sync);
+    assert(!nb_packets);
+
+    /* packet vectors */
+    uref = uref_block_flow_alloc_def(uref_mgr, NULL);
+    assert(uref != NULL);
+    upipe_ts_sync = upipe_void_alloc(upipe_ts_sync_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "ts sync vector"));
+    assert(upipe_ts_sync != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_ts_sync, uref));
+    ubase_assert(upipe_set_output(upipe_ts_sync, upipe_sink));
+    uref_free(uref);
+
+    int vector;
+    ubase_assert(upipe_ts_sync_get_vector(upipe_ts_sync, &vector));
+    assert(!vector);
+    ubase_assert(upipe_ts_sync_set_vector(upipe_ts_sync, true));
+    ubase_assert(upipe_ts_sync_get_vector(upipe_ts_sync, &vector));
+    assert(vector);
+
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 5 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 5 * TS_SIZE);
+    for (int i = 0; i < 5; i++)
+        ts_pad(buffer + i * TS_SIZE);
+    uref_block_unmap(uref, 0);
+    uref_clock_set_cr_sys(uref, UINT64_C(1000));
+    /* the last packet is kept until the next sync word */
+    static const struct test_vector first_vectors[] = { { 4, 1000 } };
+    vectors = first_vectors;
+    nb_packets += 4;
+    expect_loss = -1;
+    upipe_input(upipe_ts_sync, uref, NULL);
+    assert(!nb_packets);
+    assert(vectors == first_vectors + 1);
+
+    /* vectors do not span datagrams, so that packets keep their own
+     * arrival date */
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, 3 * TS_SIZE);
+    assert(uref != NULL);
+    size = -1;
+    ubase_assert(uref_block_write(uref, 0, &size, &buffer));
+    assert(size == 3 * TS_SIZE);
+    for (int i = 0; i < 3; i++)
+        ts_pad(buffer + i * TS_SIZE);
+    uref_block_unmap(uref, 0);
+    uref_clock_set_cr_sys(uref, UINT64_C(2000));
+    static const struct test_vector next_vectors[] = {
+        { 1, 1000 }, { 2, 2000 }
+    };
+    vectors = next_vectors;
+    nb_packets += 3;
+    upipe_input(upipe_ts_sync, uref, NULL);
+    assert(!nb_packets);
+    assert(vectors == next_vectors + 2);
+
     nb_packets++;
     upipe_release(upipe_ts_sync);
     assert(!nb_packets);
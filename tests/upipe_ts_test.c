@@ -263,7 +263,8 @@ static int catch_src(struct uprobe *uprobe, struct upipe *upipe,
 }
 
 static void usage(const char *argv0) {
-    fprintf(stdout, "Usage: %s <source file> <sink file>\n", argv0);
+    fprintf(stdout, "Usage: %s <source file> <sink file> [<batch size>]\n",
+            argv0);
     exit(EXIT_FAILURE);
 }
 
@@ -271,10 +272,11 @@ int main(int argc, char *argv[])
 {
     setvbuf(stdout, NULL, _IOLBF, 0);
 
-    if (argc != 3)
+    if (argc != 3 && argc != 4)
         usage(argv[0]);
     src_file = argv[1];
     sink_file = argv[2];
+    unsigned int batch_size = argc == 4 ? strtoul(argv[3], NULL, 10) : 0;
 
     struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
     assert(umem_mgr != NULL);
@@ -364,6 +366,12 @@ int main(int argc, char *argv[])
     ubase_assert(upipe_ts_mux_set_mode(upipe_ts, UPIPE_TS_MUX_MODE_CAPPED));
     ubase_assert(upipe_ts_mux_set_version(upipe_ts, 1));
     ubase_assert(upipe_ts_mux_set_cr_prog(upipe_ts, 0));
+    if (batch_size) {
+        ubase_assert(upipe_ts_mux_set_batch_size(upipe_ts, batch_size));
+        unsigned int size;
+        ubase_assert(upipe_ts_mux_get_batch_size(upipe_ts, &size));
+        assert(size && size <= batch_size);
+    }
 
     /* file sink */
     struct upipe_mgr *upipe_fsink_mgr = upipe_fsink_mgr_alloc();
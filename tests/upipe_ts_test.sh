@@ -10,3 +10,6 @@ trap cleanup EXIT
 
 "$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_ts_test "$srcdir"/upipe_ts_test.ts "$TMP"/test.ts
 cmp --quiet "$TMP"/test.ts "$srcdir"/upipe_ts_test.ts
+
+"$srcdir"/valgrind_wrapper.sh "$srcdir" ./upipe_ts_test "$srcdir"/upipe_ts_test.ts "$TMP"/test_batch.ts 1048576
+cmp --quiet "$TMP"/test_batch.ts "$srcdir"/upipe_ts_test.ts
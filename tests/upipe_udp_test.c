@@ -13,6 +13,8 @@
 
 #undef NDEBUG
 
+#include "config.h"
+
 #include "upipe/uprobe.h"
 #include "upipe/uprobe_stdio.h"
 #include "upipe/uprobe_prefix.h"
@@ -31,6 +33,7 @@
 #include "upipe/uref.h"
 #include "upipe/uref_block.h"
 #include "upipe/uref_block_flow.h"
+#include "upipe/uref_clock.h"
 #include "upipe/uref_std.h"
 #include "upipe/upump.h"
 #include "upump-ev/upump_ev.h"
@@ -43,8 +46,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <time.h>
 #include <assert.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 #include <netdb.h>
 
 #define UDICT_POOL_DEPTH 0
@@ -56,6 +62,8 @@
 #define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
 #define BUF_SIZE 256
 #define FORMAT "This is packet number %d"
+#define NB_DATAGRAMS 64
+#define DATAGRAM_SIZE 1316
 
 /* FIXME: uncomment or remove */
 /*static void usage(const char *argv0) {
@@ -77,6 +85,7 @@ struct upump *write_pump;
 struct addrinfo hints, *servinfo, *p;
 struct upipe *upipe_udpsrc;
 struct upipe *upipe_udpsink;
+struct uclock *uclock;
 static int counter = 0;
 
 /** definition of our uprobe */
@@ -182,6 +191,208 @@ static struct upipe_mgr udpsrc_test_mgr = {
     .upipe_control = test_control
 };
 
+/** size of a datagram of the batch tests, changing every four datagrams */
+static size_t batch_size(unsigned int seq)
+{
+    return DATAGRAM_SIZE - (seq / 4) % 8 * 100;
+}
+
+/** fills in a datagram of the batch tests */
+static void batch_fill(uint8_t *buf, unsigned int seq)
+{
+    for (size_t i = 0; i < batch_size(seq); i++)
+        buf[i] = seq * 7 + i;
+}
+
+/** checks that a datagram of the batch tests is intact and in order */
+static void batch_check(const uint8_t *buf, size_t size, unsigned int seq)
+{
+    assert(size == batch_size(seq));
+    for (size_t i = 0; i < size; i++)
+        assert(buf[i] == (uint8_t)(seq * 7 + i));
+}
+
+/** helper phony pipe checking the datagrams of the batch tests */
+struct batch_test {
+    unsigned int counter;
+    struct upipe *source;
+    struct upipe upipe;
+};
+
+/** helper phony pipe */
+UPIPE_HELPER_UPIPE(batch_test, upipe, 0);
+
+/** helper phony pipe */
+static struct upipe *batch_test_alloc(struct upipe_mgr *mgr,
+                                      struct uprobe *uprobe,
+                                      uint32_t signature, va_list args)
+{
+    struct batch_test *batch_test = malloc(sizeof(struct batch_test));
+    assert(batch_test != NULL);
+    batch_test->counter = 0;
+    batch_test->source = NULL;
+    upipe_init(&batch_test->upipe, mgr, uprobe);
+    upipe_throw_ready(&batch_test->upipe);
+    return &batch_test->upipe;
+}
+
+/** helper phony pipe */
+static void batch_test_input(struct upipe *upipe, struct uref *uref,
+                             struct upump **upump_p)
+{
+    struct batch_test *batch_test = batch_test_from_upipe(upipe);
+    size_t size;
+    ubase_assert(uref_block_size(uref, &size));
+    assert(size <= DATAGRAM_SIZE);
+    uint8_t buf[DATAGRAM_SIZE];
+    ubase_assert(uref_block_extract(uref, 0, size, buf));
+    batch_check(buf, size, batch_test->counter);
+    uref_free(uref);
+
+    if (++batch_test->counter == NB_DATAGRAMS)
+        upipe_set_uri(batch_test->source, NULL);
+}
+
+/** helper phony pipe */
+static void batch_test_free(struct upipe *upipe)
+{
+    upipe_throw_dead(upipe);
+    struct batch_test *batch_test = batch_test_from_upipe(upipe);
+    upipe_clean(upipe);
+    free(batch_test);
+}
+
+/** helper phony pipe */
+static struct upipe_mgr batch_test_mgr = {
+    .refcount = NULL,
+    .signature = 0,
+    .upipe_alloc = batch_test_alloc,
+    .upipe_input = batch_test_input,
+    .upipe_control = test_control
+};
+
+/** sends datagrams to a udp source reading them in batches, and checks
+ * they are all output, intact and in order */
+static void test_udpsrc_batch(struct upump_mgr *upump_mgr,
+                              struct uprobe *logger, unsigned int batch)
+{
+    struct upipe *batch_test = upipe_void_alloc(&batch_test_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "batch_test"));
+    assert(batch_test != NULL);
+
+    struct upipe_mgr *upipe_udpsrc_mgr = upipe_udpsrc_mgr_alloc();
+    assert(upipe_udpsrc_mgr != NULL);
+    struct upipe *udpsrc = upipe_void_alloc(upipe_udpsrc_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "udp source batch"));
+    assert(udpsrc != NULL);
+    ubase_assert(upipe_set_output(udpsrc, batch_test));
+    ubase_assert(upipe_set_output_size(udpsrc, READ_SIZE));
+    ubase_assert(upipe_udpsrc_set_batch(udpsrc, batch));
+    batch_test_from_upipe(batch_test)->source = udpsrc;
+
+    char udp_uri[512];
+    int i, port;
+    bool ret = false;
+    for (i = 0; i < 10; i++) {
+        port = ((rand() % 40000) + 1024);
+        snprintf(udp_uri, sizeof(udp_uri), "@127.0.0.1:%d", port);
+        if ((ret = ubase_check(upipe_set_uri(udpsrc, udp_uri))))
+            break;
+    }
+    assert(ret);
+
+    /* the datagrams are all queued before the source reads them */
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(fd != -1);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    for (unsigned int seq = 0; seq < NB_DATAGRAMS; seq++) {
+        uint8_t buf[DATAGRAM_SIZE];
+        batch_fill(buf, seq);
+        assert(sendto(fd, buf, batch_size(seq), 0, (struct sockaddr *)&addr,
+                      sizeof(addr)) == batch_size(seq));
+    }
+    close(fd);
+
+    upump_mgr_run(upump_mgr, NULL);
+    assert(batch_test_from_upipe(batch_test)->counter == NB_DATAGRAMS);
+
+    upipe_release(udpsrc);
+    upipe_mgr_release(upipe_udpsrc_mgr);
+    batch_test_free(batch_test);
+}
+
+/** writes datagrams with a udp sink in batches, and checks they are all
+ * received, intact and in order */
+static void test_udpsink_batch(struct upump_mgr *upump_mgr,
+                               struct uprobe *logger, unsigned int batch)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(fd != -1);
+    int rcvbuf = 4 * NB_DATAGRAMS * DATAGRAM_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &addrlen) == 0);
+    char udp_uri[512];
+    snprintf(udp_uri, sizeof(udp_uri), "127.0.0.1:%u", ntohs(addr.sin_port));
+
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, "bar");
+    assert(flow_def != NULL);
+    struct upipe_mgr *upipe_udpsink_mgr = upipe_udpsink_mgr_alloc();
+    assert(upipe_udpsink_mgr != NULL);
+    struct upipe *udpsink = upipe_void_alloc(upipe_udpsink_mgr,
+            uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                             "udp sink batch"));
+    assert(udpsink != NULL);
+    ubase_assert(upipe_set_flow_def(udpsink, flow_def));
+    uref_free(flow_def);
+    ubase_assert(upipe_attach_uclock(udpsink));
+    ubase_assert(upipe_udpsink_set_batch(udpsink, batch));
+    ubase_assert(upipe_set_uri(udpsink, udp_uri));
+
+    /* the datagrams are due at the same date, so that they are written
+     * together */
+    uint64_t now = uclock_now(uclock);
+    for (unsigned int seq = 0; seq < NB_DATAGRAMS; seq++) {
+        struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr,
+                                             batch_size(seq));
+        assert(uref != NULL);
+        uint8_t *buf;
+        int size = -1;
+        ubase_assert(uref_block_write(uref, 0, &size, &buf));
+        assert(size == batch_size(seq));
+        batch_fill(buf, seq);
+        uref_block_unmap(uref, 0);
+        uref_clock_set_cr_sys(uref, now + UCLOCK_FREQ / 1000);
+        upipe_input(udpsink, uref, NULL);
+    }
+
+    upump_mgr_run(upump_mgr, NULL);
+
+    for (unsigned int seq = 0; seq < NB_DATAGRAMS; seq++) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        assert(poll(&pfd, 1, 1000) == 1);
+        uint8_t buf[DATAGRAM_SIZE + 1];
+        ssize_t size = recv(fd, buf, sizeof(buf), 0);
+        assert(size > 0);
+        batch_check(buf, size, seq);
+    }
+    close(fd);
+
+    upipe_release(udpsink);
+    upipe_mgr_release(upipe_udpsink_mgr);
+}
+
 /* packet generator */
 static void genpackets(struct upump *unused)
 {
@@ -213,8 +424,12 @@ static void genpackets2(struct upump *upump)
         return;
     }
 
+    /* date the packets in the near future so that they are written in
+     * batches */
+    uint64_t now = uclock_now(uclock);
     for (i=0; i < 10; i++) {
         uref = uref_block_alloc(uref_mgr, ubuf_mgr, BUF_SIZE);
+        uref_clock_set_cr_sys(uref, now + UCLOCK_FREQ / 1000);
         uref_block_write(uref, 0, &size, &buf);
         assert(size == BUF_SIZE);
         memset(buf, 0, size);
@@ -245,7 +460,7 @@ int main(int argc, char *argv[])
     struct upump_mgr *upump_mgr = upump_ev_mgr_alloc_default(UPUMP_POOL,
             UPUMP_BLOCKER_POOL);
     assert(upump_mgr != NULL);
-    struct uclock *uclock = uclock_std_alloc(0);
+    uclock = uclock_std_alloc(0);
     assert(uclock != NULL);
     struct uprobe uprobe;
     uprobe_init(&uprobe, catch, NULL);
@@ -262,6 +477,11 @@ int main(int argc, char *argv[])
                                    UBUF_POOL_DEPTH);
     assert(logger != NULL);
 
+    test_udpsrc_batch(upump_mgr, logger, 1);
+    test_udpsrc_batch(upump_mgr, logger, 8);
+    test_udpsink_batch(upump_mgr, logger, 1);
+    test_udpsink_batch(upump_mgr, logger, 16);
+
     struct upipe *udpsrc_test = upipe_void_alloc(&udpsrc_test_mgr,
             uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
                              "udpsrc_test"));
@@ -327,6 +547,31 @@ int main(int argc, char *argv[])
     assert(upipe_udpsink != NULL);
     ubase_assert(upipe_set_flow_def(upipe_udpsink, flow_def));
     uref_free(flow_def);
+    ubase_assert(upipe_attach_uclock(upipe_udpsink));
+    unsigned int batch;
+    ubase_assert(upipe_udpsink_get_batch(upipe_udpsink, &batch));
+    assert(batch == 0);
+    ubase_assert(upipe_udpsink_set_batch(upipe_udpsink, 16));
+    ubase_assert(upipe_udpsink_get_batch(upipe_udpsink, &batch));
+    assert(batch == 16);
+    int clockid;
+    uint64_t horizon;
+    ubase_assert(upipe_udpsink_get_txtime(upipe_udpsink, &clockid, &horizon));
+    assert(horizon == 0);
+#ifdef HAVE_TXTIME
+    ubase_assert(upipe_udpsink_set_txtime(upipe_udpsink, CLOCK_MONOTONIC,
+                                          UCLOCK_FREQ / 100));
+    ubase_assert(upipe_udpsink_get_txtime(upipe_udpsink, &clockid, &horizon));
+    assert(clockid == CLOCK_MONOTONIC);
+    assert(horizon == UCLOCK_FREQ / 100);
+#endif
+
+    /* read the second run in batches */
+    ubase_assert(upipe_udpsrc_get_batch(upipe_udpsrc, &batch));
+    assert(batch == 0);
+    ubase_assert(upipe_udpsrc_set_batch(upipe_udpsrc, 8));
+    ubase_assert(upipe_udpsrc_get_batch(upipe_udpsrc, &batch));
+    assert(batch == 8);
 
     /* reset source uri */
     for (i=0; i < 10; i++) {
@@ -348,6 +593,53 @@ int main(int argc, char *argv[])
     /* fire again */
     upump_mgr_run(upump_mgr, NULL);
 
+#ifdef HAVE_TXTIME
+    /* with kernel pacing, buffers dated within the horizon are handed over
+     * to the kernel at once, without waiting in the pipe */
+    int pacing_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(pacing_fd != -1);
+    struct sockaddr_in pacing_addr;
+    socklen_t pacing_addrlen = sizeof(pacing_addr);
+    memset(&pacing_addr, 0, sizeof(pacing_addr));
+    pacing_addr.sin_family = AF_INET;
+    pacing_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(pacing_fd, (struct sockaddr *)&pacing_addr,
+                sizeof(pacing_addr)) == 0);
+    assert(getsockname(pacing_fd, (struct sockaddr *)&pacing_addr,
+                       &pacing_addrlen) == 0);
+    snprintf(udp_uri, sizeof(udp_uri), "127.0.0.1:%u",
+             ntohs(pacing_addr.sin_port));
+    ubase_assert(upipe_udpsink_set_txtime(upipe_udpsink, CLOCK_MONOTONIC,
+                                          UCLOCK_FREQ));
+    ubase_assert(upipe_set_uri(upipe_udpsink, udp_uri));
+    ubase_assert(upipe_udpsink_get_txtime(upipe_udpsink, &clockid, &horizon));
+    assert(horizon == UCLOCK_FREQ);
+
+    static const unsigned int pacing_batches[] = { 0, 16 };
+    for (i = 0; i < 2; i++) {
+        ubase_assert(upipe_udpsink_set_batch(upipe_udpsink,
+                                             pacing_batches[i]));
+        struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, BUF_SIZE);
+        assert(uref != NULL);
+        uint8_t *buf;
+        int size = -1;
+        ubase_assert(uref_block_write(uref, 0, &size, &buf));
+        memset(buf, i, size);
+        uref_block_unmap(uref, 0);
+        uref_clock_set_cr_sys(uref, uclock_now(uclock) + UCLOCK_FREQ / 2);
+        upipe_input(upipe_udpsink, uref, NULL);
+
+        /* the event loop is not run, so the buffer must have been sent */
+        struct pollfd pfd = { .fd = pacing_fd, .events = POLLIN };
+        assert(poll(&pfd, 1, 1000) == 1);
+        uint8_t rbuf[BUF_SIZE];
+        assert(recv(pacing_fd, rbuf, sizeof(rbuf), 0) == BUF_SIZE);
+        assert(rbuf[0] == i);
+    }
+    ubase_assert(upipe_set_uri(upipe_udpsink, NULL));
+    close(pacing_fd);
+#endif
+
     /* release */
     upump_free(write_pump);
     upipe_release(upipe_udpsrc);
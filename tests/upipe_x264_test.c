@@ -29,8 +29,11 @@
 #include "upipe/uref_clock.h"
 #include "upipe/uref_pic.h"
 #include "upipe/uref_pic_flow.h"
+#include "upipe/uprobe_upump_mgr.h"
+#include "upipe/upump.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_upipe.h"
+#include "upump-ev/upump_ev.h"
 
 #include "upipe-x264/upipe_x264.h"
 
@@ -48,12 +51,18 @@
 #define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
 #define WIDTH               96
 #define HEIGHT              64
+#define UPUMP_POOL          0
+#define UPUMP_BLOCKER_POOL  0
 #define LIMIT               60
+#define NB_RUNS             4
+#define ASYNC_LENGTH        4
 
 
 /** phony pipe to test upipe_x264 */
 struct x264_test {
     int counter;
+    /** timestamps of the received frames */
+    uint64_t pts[NB_RUNS * LIMIT], dts[NB_RUNS * LIMIT];
     struct upipe upipe;
 };
 
@@ -89,6 +98,9 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     }
     upipe_dbg_va(upipe, "received pic %d, pts: %"PRIu64" , dts: %"PRIu64,
                  x264_test->counter, pts, dts);
+    assert(x264_test->counter < NB_RUNS * LIMIT);
+    x264_test->pts[x264_test->counter] = pts;
+    x264_test->dts[x264_test->counter] = dts;
     x264_test->counter++;
 
     uref_free(uref);
@@ -156,6 +168,63 @@ static void fill_pic(struct uref *uref, int counter)
     }
 }
 
+/** pictures sent to a x264 pipe */
+struct feeder {
+    /** x264 pipe */
+    struct upipe *upipe;
+    /** uref manager */
+    struct uref_mgr *uref_mgr;
+    /** picture buffer manager */
+    struct ubuf_mgr *pic_mgr;
+    /** flow definition sent in the middle of the stream, or NULL */
+    struct uref *flow_def;
+    /** number of sent pictures */
+    int counter;
+};
+
+/** sends a picture, preceded by the new flow definition in the middle of
+ * the stream */
+static void feed(struct feeder *feeder, struct upump **upump_p)
+{
+    if (feeder->flow_def != NULL && feeder->counter == LIMIT / 2)
+        ubase_assert(upipe_set_flow_def(feeder->upipe, feeder->flow_def));
+
+    struct uref *pic = uref_pic_alloc(feeder->uref_mgr, feeder->pic_mgr,
+                                      WIDTH, HEIGHT);
+    assert(pic);
+    fill_pic(pic, feeder->counter);
+    uint64_t pts = feeder->counter + 42;
+    uref_clock_set_pts_orig(pic, pts);
+    uref_clock_set_pts_prog(pic, pts * UCLOCK_FREQ + UINT32_MAX);
+    feeder->counter++;
+    upipe_input(feeder->upipe, pic, upump_p);
+}
+
+/** sends pictures from the event loop, and releases the x264 pipe after the
+ * last one */
+static void feed_timer(struct upump *upump)
+{
+    struct feeder *feeder = upump_get_opaque(upump, struct feeder *);
+    feed(feeder, &upump);
+    if (feeder->counter == LIMIT) {
+        upump_stop(upump);
+        upipe_release(feeder->upipe);
+    }
+}
+
+/** checks that a run output all the pictures of the first run */
+static void check_run(struct x264_test *x264_test, int run)
+{
+    assert(x264_test->counter == (run + 1) * LIMIT);
+    for (int i = 0; i < LIMIT; i++) {
+        int found = 0;
+        for (int j = 0; j < LIMIT; j++)
+            if (x264_test->pts[run * LIMIT + j] == x264_test->pts[i])
+                found++;
+        assert(found == 1);
+    }
+}
+
 /** definition of our uprobe */
 static int catch(struct uprobe *uprobe, struct upipe *upipe,
                  int event, va_list args)
@@ -167,6 +236,7 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
         case UPROBE_READY:
         case UPROBE_DEAD:
         case UPROBE_NEW_FLOW_DEF:
+        case UPROBE_NEED_UPUMP_MGR:
             break;
     }
     return UBASE_ERR_NONE;
@@ -226,7 +296,6 @@ int main(int argc, char **argv)
                                      "x264"));
     assert(x264);
     ubase_assert(upipe_set_flow_def(x264, flow_def));
-    uref_free(flow_def);
 
     /* x264_test */
     struct upipe *x264_test = upipe_void_alloc(&x264_test_mgr,
@@ -253,8 +322,93 @@ int main(int argc, char **argv)
         upipe_input(x264, pic, NULL);
     }
 
-    /* release pipes */
     upipe_release(x264);
+    assert(x264_test_from_upipe(x264_test)->counter == LIMIT);
+
+    /* asynchronous encoding test, without upump manager */
+    x264 = upipe_void_alloc(upipe_x264_mgr,
+                    uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                     "x264 async"));
+    assert(x264);
+    ubase_assert(upipe_x264_set_async(x264, ASYNC_LENGTH));
+    ubase_assert(upipe_set_flow_def(x264, flow_def));
+    ubase_assert(upipe_set_output(x264, x264_test));
+
+    for (counter = 0; counter < LIMIT; counter ++) {
+        pic = uref_pic_alloc(uref_mgr, pic_mgr, WIDTH, HEIGHT);
+        assert(pic);
+        fill_pic(pic, counter);
+        pts = counter + 42;
+        uref_clock_set_pts_orig(pic, pts);
+        uref_clock_set_pts_prog(pic, pts * UCLOCK_FREQ + UINT32_MAX);
+        upipe_input(x264, pic, NULL);
+    }
+
+    /* the remaining frames are output when the pipe is released */
+    upipe_release(x264);
+    struct x264_test *x264_test_p = x264_test_from_upipe(x264_test);
+    assert(x264_test_p->counter == 2 * LIMIT);
+    for (counter = 0; counter < LIMIT; counter++) {
+        assert(x264_test_p->pts[LIMIT + counter] == x264_test_p->pts[counter]);
+        assert(x264_test_p->dts[LIMIT + counter] == x264_test_p->dts[counter]);
+    }
+
+    /* new aspect ratio in the middle of the stream, reconfiguring the
+     * encoder once the frames in the encoder thread are output */
+    struct uref *flow_def_sar = uref_dup(flow_def);
+    assert(flow_def_sar != NULL);
+    struct urational sar = { .num = 16, .den = 15 };
+    ubase_assert(uref_pic_flow_set_sar(flow_def_sar, sar));
+
+    x264 = upipe_void_alloc(upipe_x264_mgr,
+                    uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                     "x264 async sar"));
+    assert(x264);
+    ubase_assert(upipe_x264_set_async(x264, ASYNC_LENGTH));
+    ubase_assert(upipe_set_flow_def(x264, flow_def));
+    ubase_assert(upipe_set_output(x264, x264_test));
+
+    struct feeder feeder = {
+        .upipe = x264,
+        .uref_mgr = uref_mgr,
+        .pic_mgr = pic_mgr,
+        .flow_def = flow_def_sar,
+        .counter = 0,
+    };
+    while (feeder.counter < LIMIT)
+        feed(&feeder, NULL);
+    upipe_release(x264);
+    check_run(x264_test_p, 2);
+
+    /* asynchronous encoding test, with the watcher of an event loop */
+    struct upump_mgr *upump_mgr =
+        upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+    x264 = upipe_void_alloc(upipe_x264_mgr,
+                    uprobe_pfx_alloc(
+                        uprobe_upump_mgr_alloc(uprobe_use(logger), upump_mgr),
+                        UPROBE_LOG_LEVEL, "x264 upump"));
+    assert(x264);
+    ubase_assert(upipe_x264_set_async(x264, ASYNC_LENGTH));
+    ubase_assert(upipe_set_flow_def(x264, flow_def));
+    ubase_assert(upipe_set_output(x264, x264_test));
+
+    feeder.upipe = x264;
+    feeder.counter = 0;
+    struct upump *upump = upump_alloc_timer(upump_mgr, feed_timer, &feeder,
+                                            NULL, 0, UCLOCK_FREQ / 1000);
+    assert(upump != NULL);
+    upump_start(upump);
+    /* the watcher is freed with the pipe, once all frames are output */
+    upump_mgr_run(upump_mgr, NULL);
+    upump_free(upump);
+    check_run(x264_test_p, 3);
+
+    upump_mgr_release(upump_mgr);
+    uref_free(flow_def_sar);
+    uref_free(flow_def);
+
+    /* release pipes */
     test_free(x264_test);
 
     /* clean everything */
@@ -29,8 +29,11 @@
 #include "upipe/uref_clock.h"
 #include "upipe/uref_pic.h"
 #include "upipe/uref_pic_flow.h"
+#include "upipe/uprobe_upump_mgr.h"
+#include "upipe/upump.h"
 #include "upipe/upipe.h"
 #include "upipe/upipe_helper_upipe.h"
+#include "upump-ev/upump_ev.h"
 
 #include "upipe-x265/upipe_x265.h"
 
@@ -48,12 +51,18 @@
 #define UPROBE_LOG_LEVEL    UPROBE_LOG_DEBUG
 #define WIDTH               96
 #define HEIGHT              64
+#define UPUMP_POOL          0
+#define UPUMP_BLOCKER_POOL  0
 #define LIMIT               8
+#define NB_RUNS             4
+#define ASYNC_LENGTH        4
 
 
 /** phony pipe to test upipe_x265 */
 struct x265_test {
     int counter;
+    /** timestamps of the received frames */
+    uint64_t pts[NB_RUNS * LIMIT], dts[NB_RUNS * LIMIT];
     struct upipe upipe;
 };
 
@@ -89,6 +98,9 @@ static void test_input(struct upipe *upipe, struct uref *uref,
     }
     upipe_dbg_va(upipe, "received pic %d, pts: %"PRIu64" , dts: %"PRIu64,
                  x265_test->counter, pts, dts);
+    assert(x265_test->counter < NB_RUNS * LIMIT);
+    x265_test->pts[x265_test->counter] = pts;
+    x265_test->dts[x265_test->counter] = dts;
     x265_test->counter++;
 
     uref_free(uref);
@@ -167,18 +179,102 @@ static int catch(struct uprobe *uprobe, struct upipe *upipe,
         case UPROBE_READY:
         case UPROBE_DEAD:
         case UPROBE_NEW_FLOW_DEF:
+        case UPROBE_NEED_UPUMP_MGR:
             break;
     }
     return UBASE_ERR_NONE;
 }
 
-int main(int argc, char **argv)
+/** sets the encoding parameters of a x265 pipe */
+static void setup_x265(struct upipe *x265)
 {
-    printf("Compiled %s %s (%s)\n", __DATE__, __TIME__, __FILE__);
+    ubase_assert(upipe_x265_set_default_preset(x265, "placebo", "grain"));
+    ubase_assert(upipe_x265_set_profile(x265, "main"));
+    ubase_assert(upipe_x265_set_default_preset(x265, "faster", NULL));
+    ubase_assert(upipe_x265_set_profile(x265, "mainstillpicture"));
+    ubase_assert(upipe_x265_set_default(x265, 0));
+    ubase_assert(upipe_x265_set_default_preset(x265, "ultrafast", NULL));
 
-    struct uref *pic;
+    /* disable assembly (not valgrind safe) */
+    ubase_assert(upipe_set_option(x265, "asm", "0"));
+}
+
+/** pictures sent to a x265 pipe */
+struct feeder {
+    /** x265 pipe */
+    struct upipe *upipe;
+    /** uref manager */
+    struct uref_mgr *uref_mgr;
+    /** picture buffer manager */
+    struct ubuf_mgr *pic_mgr;
+    /** flow definition sent in the middle of the stream, or NULL */
+    struct uref *flow_def;
+    /** number of sent pictures */
     int counter;
-    uint64_t pts;
+};
+
+/** sends a picture, preceded by the new flow definition in the middle of
+ * the stream */
+static void feed(struct feeder *feeder, struct upump **upump_p)
+{
+    if (feeder->flow_def != NULL && feeder->counter == LIMIT / 2)
+        ubase_assert(upipe_set_flow_def(feeder->upipe, feeder->flow_def));
+
+    printf("Sending pic %d\n", feeder->counter);
+    struct uref *pic = uref_pic_alloc(feeder->uref_mgr, feeder->pic_mgr,
+                                      WIDTH, HEIGHT);
+    assert(pic);
+    fill_pic(pic, feeder->counter);
+    uint64_t pts = feeder->counter + 42;
+    uref_clock_set_pts_orig(pic, pts);
+    uref_clock_set_pts_prog(pic, pts * UCLOCK_FREQ + UINT32_MAX);
+    feeder->counter++;
+    upipe_input(feeder->upipe, pic, upump_p);
+}
+
+/** sends pictures from the event loop, and releases the x265 pipe after the
+ * last one */
+static void feed_timer(struct upump *upump)
+{
+    struct feeder *feeder = upump_get_opaque(upump, struct feeder *);
+    feed(feeder, &upump);
+    if (feeder->counter == LIMIT) {
+        upump_stop(upump);
+        upipe_release(feeder->upipe);
+    }
+}
+
+/** sends pictures to a x265 pipe */
+static void send_pics(struct upipe *x265, struct uref_mgr *uref_mgr,
+                      struct ubuf_mgr *pic_mgr, struct uref *flow_def)
+{
+    struct feeder feeder = {
+        .upipe = x265,
+        .uref_mgr = uref_mgr,
+        .pic_mgr = pic_mgr,
+        .flow_def = flow_def,
+        .counter = 0,
+    };
+    while (feeder.counter < LIMIT)
+        feed(&feeder, NULL);
+}
+
+/** checks that a run output all the frames of the first run */
+static void check_run(struct x265_test *x265_test, int run, int nb_frames)
+{
+    assert(x265_test->counter == (run + 1) * nb_frames);
+    for (int i = 0; i < nb_frames; i++) {
+        int found = 0;
+        for (int j = 0; j < nb_frames; j++)
+            if (x265_test->pts[run * nb_frames + j] == x265_test->pts[i])
+                found++;
+        assert(found == 1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    printf("Compiled %s %s (%s)\n", __DATE__, __TIME__, __FILE__);
 
     /* upipe env */
     struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
@@ -227,7 +323,6 @@ int main(int argc, char **argv)
                                      "x265"));
     assert(x265);
     ubase_assert(upipe_set_flow_def(x265, flow_def));
-    uref_free(flow_def);
 
     /* x265_test */
     struct upipe *x265_test = upipe_void_alloc(&x265_test_mgr,
@@ -236,30 +331,88 @@ int main(int argc, char **argv)
     ubase_assert(upipe_set_output(x265, x265_test));
 
     /* test controls */
-    ubase_assert(upipe_x265_set_default_preset(x265, "placebo", "grain"));
-    ubase_assert(upipe_x265_set_profile(x265, "main"));
-    ubase_assert(upipe_x265_set_default_preset(x265, "faster", NULL));
-    ubase_assert(upipe_x265_set_profile(x265, "mainstillpicture"));
-    ubase_assert(upipe_x265_set_default(x265, 0));
-    ubase_assert(upipe_x265_set_default_preset(x265, "ultrafast", NULL));
-
-    /* disable assembly (not valgrind safe) */
-    ubase_assert(upipe_set_option(x265, "asm", "0"));
+    setup_x265(x265);
 
     /* encoding test */
-    for (counter = 0; counter < LIMIT; counter ++) {
-        printf("Sending pic %d\n", counter);
-        pic = uref_pic_alloc(uref_mgr, pic_mgr, WIDTH, HEIGHT);
-        assert(pic);
-        fill_pic(pic, counter);
-        pts = counter + 42;
-        uref_clock_set_pts_orig(pic, pts);
-        uref_clock_set_pts_prog(pic, pts * UCLOCK_FREQ + UINT32_MAX);
-        upipe_input(x265, pic, NULL);
+    send_pics(x265, uref_mgr, pic_mgr, NULL);
+    upipe_release(x265);
+    struct x265_test *x265_test_p = x265_test_from_upipe(x265_test);
+    int nb_frames = x265_test_p->counter;
+    assert(nb_frames > 0);
+
+    /* asynchronous encoding test, without upump manager */
+    x265 = upipe_void_alloc(upipe_x265_mgr,
+                    uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                     "x265 async"));
+    assert(x265);
+    ubase_assert(upipe_x265_set_async(x265, ASYNC_LENGTH));
+    ubase_assert(upipe_set_flow_def(x265, flow_def));
+    ubase_assert(upipe_set_output(x265, x265_test));
+    setup_x265(x265);
+    send_pics(x265, uref_mgr, pic_mgr, NULL);
+
+    /* the remaining frames are output when the pipe is released */
+    upipe_release(x265);
+    assert(x265_test_p->counter == 2 * nb_frames);
+    for (int i = 0; i < nb_frames; i++) {
+        assert(x265_test_p->pts[nb_frames + i] == x265_test_p->pts[i]);
+        assert(x265_test_p->dts[nb_frames + i] == x265_test_p->dts[i]);
     }
 
-    /* release pipes */
+    /* new aspect ratio in the middle of the stream, reconfiguring the
+     * encoder once the frames in the encoder thread are output */
+    struct uref *flow_def_sar = uref_dup(flow_def);
+    assert(flow_def_sar != NULL);
+    struct urational sar = { .num = 16, .den = 15 };
+    ubase_assert(uref_pic_flow_set_sar(flow_def_sar, sar));
+
+    x265 = upipe_void_alloc(upipe_x265_mgr,
+                    uprobe_pfx_alloc(uprobe_use(logger), UPROBE_LOG_LEVEL,
+                                     "x265 async sar"));
+    assert(x265);
+    ubase_assert(upipe_x265_set_async(x265, ASYNC_LENGTH));
+    ubase_assert(upipe_set_flow_def(x265, flow_def));
+    ubase_assert(upipe_set_output(x265, x265_test));
+    setup_x265(x265);
+    send_pics(x265, uref_mgr, pic_mgr, flow_def_sar);
     upipe_release(x265);
+    check_run(x265_test_p, 2, nb_frames);
+
+    /* asynchronous encoding test, with the watcher of an event loop */
+    struct upump_mgr *upump_mgr =
+        upump_ev_mgr_alloc_default(UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+    x265 = upipe_void_alloc(upipe_x265_mgr,
+                    uprobe_pfx_alloc(
+                        uprobe_upump_mgr_alloc(uprobe_use(logger), upump_mgr),
+                        UPROBE_LOG_LEVEL, "x265 upump"));
+    assert(x265);
+    ubase_assert(upipe_x265_set_async(x265, ASYNC_LENGTH));
+    ubase_assert(upipe_set_flow_def(x265, flow_def));
+    ubase_assert(upipe_set_output(x265, x265_test));
+    setup_x265(x265);
+
+    struct feeder feeder = {
+        .upipe = x265,
+        .uref_mgr = uref_mgr,
+        .pic_mgr = pic_mgr,
+        .flow_def = flow_def_sar,
+        .counter = 0,
+    };
+    struct upump *upump = upump_alloc_timer(upump_mgr, feed_timer, &feeder,
+                                            NULL, 0, UCLOCK_FREQ / 1000);
+    assert(upump != NULL);
+    upump_start(upump);
+    /* the watcher is freed with the pipe, once all frames are output */
+    upump_mgr_run(upump_mgr, NULL);
+    upump_free(upump);
+    check_run(x265_test_p, 3, nb_frames);
+
+    upump_mgr_release(upump_mgr);
+    uref_free(flow_def_sar);
+    uref_free(flow_def);
+
+    /* release pipes */
     test_free(x265_test);
 
     /* clean everything */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for event loops scheduled on a pool of threads
+ */
+
+#undef NDEBUG
+
+#include "upipe/uclock.h"
+#include "upipe/uatomic.h"
+#include "upipe/upump.h"
+#include "upipe-pthread/upump_pthread_pool.h"
+#include "upump-ev/upump_ev.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define UPUMP_POOL 1
+#define UPUMP_BLOCKER_POOL 1
+#define NB_THREADS 2
+#define NB_GROUPS 8
+#define NB_TICKS 300
+#define MAX_TICKS (NB_TICKS * 100)
+#define TICK (UCLOCK_FREQ / 1000)
+
+struct group {
+    struct upump_mgr *upump_mgr;
+    struct upump *upump;
+    uatomic_uint32_t running;
+    unsigned int ticks;
+    bool heavy;
+    pthread_t thread;
+    bool migrated;
+};
+
+static struct group groups[NB_GROUPS];
+static uatomic_uint32_t migrated;
+static struct upump *idle_fd;
+static bool idle_fd_dispatched;
+
+static void spin(long usec)
+{
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000 +
+             (now.tv_nsec - start.tv_nsec) / 1000 < usec);
+}
+
+static void timer_cb(struct upump *upump)
+{
+    struct group *group = upump_get_opaque(upump, struct group *);
+
+    /* pumps of a manager are never dispatched concurrently */
+    assert(uatomic_fetch_add(&group->running, 1) == 0);
+    if (group->ticks && !pthread_equal(group->thread, pthread_self())) {
+        group->migrated = true;
+        uatomic_store(&migrated, 1);
+    }
+    group->thread = pthread_self();
+    if (group->heavy)
+        spin(400);
+    uatomic_fetch_sub(&group->running, 1);
+
+    /* the load of the first worker stays higher until a manager is moved
+     * away, so keep ticking until then rather than betting on timing */
+    if (++group->ticks >= NB_TICKS &&
+        (uatomic_load(&migrated) || group->ticks >= MAX_TICKS)) {
+        upump_stop(upump);
+        upump_free(upump);
+        upump_mgr_release(group->upump_mgr);
+    }
+}
+
+static void idle_fd_cb(struct upump *upump)
+{
+    idle_fd_dispatched = true;
+}
+
+static void idle_timer_cb(struct upump *upump)
+{
+    /* the pool no longer waits for the file descriptor */
+    upump_set_status(idle_fd, 0);
+}
+
+int main(int argc, char **argv)
+{
+    struct upump_pthread_pool *pool =
+        upump_pthread_pool_alloc(NB_THREADS, upump_ev_mgr_alloc_loop,
+                                 UPUMP_POOL, UPUMP_BLOCKER_POOL, NULL);
+    if (pool == NULL) {
+        fprintf(stderr, "unable to allocate event loops, skipping\n");
+        return 0;
+    }
+    uatomic_init(&migrated, 0);
+
+    for (int i = 0; i < NB_GROUPS; i++) {
+        struct group *group = &groups[i];
+        group->upump_mgr = upump_pthread_pool_mgr_alloc(pool, UPUMP_POOL,
+                                                        UPUMP_BLOCKER_POOL);
+        assert(group->upump_mgr != NULL);
+        uatomic_init(&group->running, 0);
+        group->ticks = 0;
+        /* managers are spread in turn, so the first worker gets the load */
+        group->heavy = !(i % NB_THREADS);
+        group->migrated = false;
+        group->upump = upump_alloc_timer(group->upump_mgr, timer_cb, group,
+                                         NULL, TICK, TICK);
+        assert(group->upump != NULL);
+        upump_start(group->upump);
+        ubase_assert(upump_pthread_pool_mgr_submit(group->upump_mgr));
+    }
+
+    /* a manager released from another thread is removed by its worker */
+    struct upump_mgr *upump_mgr =
+        upump_pthread_pool_mgr_alloc(pool, UPUMP_POOL, UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+    ubase_assert(upump_pthread_pool_mgr_submit(upump_mgr));
+    upump_mgr_release(upump_mgr);
+
+    /* a file descriptor which never becomes readable, made non-blocking
+     * once its real pump is started */
+    int fds[2];
+    assert(pipe(fds) != -1);
+    upump_mgr = upump_pthread_pool_mgr_alloc(pool, UPUMP_POOL,
+                                             UPUMP_BLOCKER_POOL);
+    assert(upump_mgr != NULL);
+    idle_fd = upump_alloc_fd_read(upump_mgr, idle_fd_cb, NULL, NULL, fds[0]);
+    assert(idle_fd != NULL);
+    upump_start(idle_fd);
+    struct upump *idle_timer = upump_alloc_timer(upump_mgr, idle_timer_cb,
+                                                 NULL, NULL, TICK, 0);
+    assert(idle_timer != NULL);
+    upump_start(idle_timer);
+    ubase_assert(upump_pthread_pool_mgr_submit(upump_mgr));
+
+    upump_pthread_pool_free(pool);
+
+    assert(!idle_fd_dispatched);
+    upump_free(idle_timer);
+    upump_free(idle_fd);
+    upump_mgr_release(upump_mgr);
+    close(fds[0]);
+    close(fds[1]);
+
+    bool group_migrated = false;
+    for (int i = 0; i < NB_GROUPS; i++) {
+        assert(groups[i].ticks >= NB_TICKS);
+        group_migrated = group_migrated || groups[i].migrated;
+        uatomic_clean(&groups[i].running);
+    }
+    assert(group_migrated);
+    assert(uatomic_load(&migrated));
+    uatomic_clean(&migrated);
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for upump manager with io_uring event loop
+ */
+
+#undef NDEBUG
+
+#include "upipe/uclock.h"
+#include "upump-uring/upump_uring.h"
+#include "upump_common_test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <assert.h>
+
+#define UPUMP_POOL 1
+#define UPUMP_BLOCKER_POOL 1
+
+static const char message[] = "hello io_uring";
+static char buffer[sizeof(message)];
+static unsigned int nb_reads = 0;
+static unsigned int nb_writes = 0;
+static unsigned int nb_timeouts = 0;
+static unsigned int nb_signals = 0;
+static unsigned int nb_errors = 0;
+static unsigned int nb_idles[2] = { 0, 0 };
+static struct upump *idlers[2];
+
+static void write_cb(struct upump *upump)
+{
+    ssize_t result;
+    assert(upump_uring_get_result(upump, &result) == UBASE_ERR_NONE);
+    assert(result == sizeof(message));
+    nb_writes++;
+}
+
+static void read_cb(struct upump *upump)
+{
+    ssize_t result;
+    assert(upump_uring_get_result(upump, &result) == UBASE_ERR_NONE);
+    assert(result == sizeof(message));
+    assert(!memcmp(buffer, message, sizeof(message)));
+    nb_reads++;
+}
+
+static void test_io(struct upump_mgr *mgr)
+{
+    int fds[2];
+    assert(pipe(fds) != -1);
+
+    struct upump *read_pump =
+        upump_uring_alloc_read(mgr, read_cb, NULL, NULL, fds[0],
+                               buffer, sizeof(buffer), UINT64_MAX);
+    assert(read_pump != NULL);
+    struct upump *write_pump =
+        upump_uring_alloc_write(mgr, write_cb, NULL, NULL, fds[1],
+                                message, sizeof(message), UINT64_MAX);
+    assert(write_pump != NULL);
+    assert(upump_uring_set_buffer(read_pump, buffer, sizeof(buffer),
+                                  UINT64_MAX) == UBASE_ERR_NONE);
+
+    upump_start(read_pump);
+    assert(upump_uring_set_buffer(read_pump, buffer, sizeof(buffer),
+                                  UINT64_MAX) == UBASE_ERR_BUSY);
+    upump_start(write_pump);
+    upump_mgr_run(mgr, NULL);
+    assert(nb_reads == 1);
+    assert(nb_writes == 1);
+
+    /* an operation in progress is cancelled when the pump is freed */
+    memset(buffer, 0, sizeof(buffer));
+    upump_restart(read_pump);
+    upump_free(read_pump);
+    upump_free(write_pump);
+    upump_mgr_release(mgr);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void timer_cb(struct upump *upump)
+{
+    nb_timeouts++;
+    upump_stop(upump);
+}
+
+static void signal_cb(struct upump *upump)
+{
+    nb_signals++;
+    upump_stop(upump);
+}
+
+static void test_reuse(struct upump_mgr *mgr)
+{
+    /* the cancelled request of the first timer must not stop the second
+     * timer, which gets the same id */
+    struct upump *timer = upump_alloc_timer(mgr, timer_cb, NULL, NULL,
+                                            UCLOCK_FREQ * 10, 0);
+    assert(timer != NULL);
+    upump_start(timer);
+    upump_free(timer);
+
+    timer = upump_alloc_timer(mgr, timer_cb, NULL, NULL,
+                              UCLOCK_FREQ / 100, 0);
+    assert(timer != NULL);
+    upump_start(timer);
+    upump_mgr_run(mgr, NULL);
+    assert(nb_timeouts == 1);
+    upump_free(timer);
+    upump_mgr_release(mgr);
+}
+
+static bool signal_blocked(int signum)
+{
+    sigset_t mask;
+    assert(pthread_sigmask(SIG_BLOCK, NULL, &mask) == 0);
+    return sigismember(&mask, signum);
+}
+
+static void test_signal(struct upump_mgr *mgr)
+{
+    struct upump *upump = upump_alloc_signal(mgr, signal_cb, NULL, NULL,
+                                             SIGUSR1);
+    assert(upump != NULL);
+    assert(!signal_blocked(SIGUSR1));
+    upump_start(upump);
+    assert(signal_blocked(SIGUSR1));
+    /* the default action would terminate the process */
+    assert(raise(SIGUSR1) == 0);
+    upump_mgr_run(mgr, NULL);
+    assert(nb_signals == 1);
+    assert(!signal_blocked(SIGUSR1));
+    upump_free(upump);
+    upump_mgr_release(mgr);
+}
+
+static void error_cb(struct upump *upump)
+{
+    nb_errors++;
+}
+
+static void test_error(struct upump_mgr *mgr)
+{
+    int fds[2];
+    assert(pipe(fds) != -1);
+    close(fds[0]);
+
+    /* a file descriptor that cannot be polled is reported once, and does
+     * not keep the event loop running */
+    struct upump *upump = upump_alloc_fd_read(mgr, error_cb, NULL, NULL,
+                                              fds[0]);
+    assert(upump != NULL);
+    upump_start(upump);
+    upump_mgr_run(mgr, NULL);
+    assert(nb_errors == 1);
+    upump_free(upump);
+    upump_mgr_release(mgr);
+    close(fds[1]);
+}
+
+static void idler_cb(struct upump *upump)
+{
+    nb_idles[upump == idlers[1]]++;
+    /* the first idler stops the second one before it is dispatched */
+    upump_stop(idlers[1]);
+    upump_stop(idlers[0]);
+}
+
+static void test_idlers(struct upump_mgr *mgr)
+{
+    for (int i = 0; i < 2; i++) {
+        idlers[i] = upump_alloc_idler(mgr, idler_cb, NULL, NULL);
+        assert(idlers[i] != NULL);
+        upump_start(idlers[i]);
+    }
+    upump_mgr_run(mgr, NULL);
+    assert(nb_idles[0] == 1);
+    assert(nb_idles[1] == 0);
+    for (int i = 0; i < 2; i++)
+        upump_free(idlers[i]);
+    upump_mgr_release(mgr);
+}
+
+int main(int argc, char **argv)
+{
+    struct upump_mgr *mgr = upump_uring_mgr_alloc(UPUMP_POOL,
+                                                  UPUMP_BLOCKER_POOL);
+    if (mgr == NULL) {
+        fprintf(stderr, "io_uring is not available, skipping\n");
+        return 0;
+    }
+    test_io(mgr);
+    test_reuse(upump_uring_mgr_alloc(UPUMP_POOL, UPUMP_BLOCKER_POOL));
+    test_signal(upump_uring_mgr_alloc(UPUMP_POOL, UPUMP_BLOCKER_POOL));
+    test_error(upump_uring_mgr_alloc(UPUMP_POOL, UPUMP_BLOCKER_POOL));
+    test_idlers(upump_uring_mgr_alloc(UPUMP_POOL, UPUMP_BLOCKER_POOL));
+    run(upump_uring_mgr_alloc(UPUMP_POOL, UPUMP_BLOCKER_POOL));
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for per-pipe statistics
+ */
+
+#undef NDEBUG
+
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_stdio.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/umem.h"
+#include "upipe/umem_alloc.h"
+#include "upipe/udict.h"
+#include "upipe/udict_inline.h"
+#include "upipe/ubuf.h"
+#include "upipe/ubuf_block_mem.h"
+#include "upipe/uclock.h"
+#include "upipe/uclock_std.h"
+#include "upipe/uref.h"
+#include "upipe/uref_block.h"
+#include "upipe/uref_block_flow.h"
+#include "upipe/uref_clock.h"
+#include "upipe/uref_std.h"
+#include "upipe/upipe.h"
+#include "upipe/upipe_dump.h"
+#include "upipe/upipe_helper_upipe.h"
+#include "upipe/upipe_helper_input.h"
+#include "upipe/ustats.h"
+#include "upipe-modules/upipe_setattr.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define UDICT_POOL_DEPTH 0
+#define UREF_POOL_DEPTH 0
+#define UBUF_POOL_DEPTH 0
+#define UPROBE_LOG_LEVEL UPROBE_LOG_DEBUG
+#define NB_UREFS 10
+#define UREF_SIZE 188
+#define LATENCY (10 * UCLOCK_MILLISECOND)
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        default:
+            assert(0);
+            break;
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_NEW_FLOW_DEF:
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** phony pipe holding its input */
+struct test_pipe {
+    struct uchain urefs;
+    unsigned int nb_urefs;
+    unsigned int max_urefs;
+    struct uchain blockers;
+    struct upipe upipe;
+};
+
+#define TEST_SIGNATURE UBASE_FOURCC('t','e','s','t')
+
+UPIPE_HELPER_UPIPE(test_pipe, upipe, TEST_SIGNATURE)
+
+/** helper phony pipe */
+static bool test_output(struct upipe *upipe, struct uref *uref,
+                        struct upump **upump_p)
+{
+    uref_free(uref);
+    return true;
+}
+
+UPIPE_HELPER_INPUT(test_pipe, urefs, nb_urefs, max_urefs, blockers,
+                   test_output)
+
+/** helper phony pipe */
+static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct test_pipe *test_pipe = malloc(sizeof(struct test_pipe));
+    assert(test_pipe != NULL);
+    struct upipe *upipe = test_pipe_to_upipe(test_pipe);
+    upipe_init(upipe, mgr, uprobe);
+    test_pipe_init_input(upipe);
+    return upipe;
+}
+
+/** helper phony pipe */
+static void test_input(struct upipe *upipe, struct uref *uref,
+                       struct upump **upump_p)
+{
+    test_pipe_hold_input(upipe, uref);
+}
+
+/** helper phony pipe */
+static int test_control(struct upipe *upipe, int command, va_list args)
+{
+    switch (command) {
+        case UPIPE_SET_FLOW_DEF:
+            return UBASE_ERR_NONE;
+        default:
+            return UBASE_ERR_UNHANDLED;
+    }
+}
+
+/** helper phony pipe */
+static void test_free(struct upipe *upipe)
+{
+    test_pipe_clean_input(upipe);
+    upipe_clean(upipe);
+    free(test_pipe_from_upipe(upipe));
+}
+
+/** helper phony pipe */
+static struct upipe_mgr test_mgr = {
+    .refcount = NULL,
+    .signature = TEST_SIGNATURE,
+    .upipe_alloc = test_alloc,
+    .upipe_input = test_input,
+    .upipe_control = test_control
+};
+
+int main(int argc, char *argv[])
+{
+    struct umem_mgr *umem_mgr = umem_alloc_mgr_alloc();
+    assert(umem_mgr != NULL);
+    struct udict_mgr *udict_mgr = udict_inline_mgr_alloc(UDICT_POOL_DEPTH,
+                                                         umem_mgr, -1, -1);
+    assert(udict_mgr != NULL);
+    struct uref_mgr *uref_mgr = uref_std_mgr_alloc(UREF_POOL_DEPTH, udict_mgr,
+                                                   0);
+    assert(uref_mgr != NULL);
+    struct ubuf_mgr *ubuf_mgr = ubuf_block_mem_mgr_alloc(UBUF_POOL_DEPTH,
+                                                         UBUF_POOL_DEPTH,
+                                                         umem_mgr, 0, 0,
+                                                         -1, 0);
+    assert(ubuf_mgr != NULL);
+    struct uclock *uclock = uclock_std_alloc(0);
+    assert(uclock != NULL);
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct uprobe *uprobe_stdio = uprobe_stdio_alloc(&uprobe, stdout,
+                                                     UPROBE_LOG_LEVEL);
+    assert(uprobe_stdio != NULL);
+
+    struct upipe *upipe_sink = upipe_void_alloc(&test_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "sink"));
+    assert(upipe_sink != NULL);
+
+    struct upipe_mgr *upipe_setattr_mgr = upipe_setattr_mgr_alloc();
+    assert(upipe_setattr_mgr != NULL);
+    struct upipe *upipe_setattr = upipe_void_alloc(upipe_setattr_mgr,
+            uprobe_pfx_alloc(uprobe_use(uprobe_stdio), UPROBE_LOG_LEVEL,
+                             "setattr \"1\""));
+    assert(upipe_setattr != NULL);
+    ubase_assert(upipe_set_output(upipe_setattr, upipe_sink));
+
+    struct uref *flow_def = uref_block_flow_alloc_def(uref_mgr, "");
+    assert(flow_def != NULL);
+    ubase_assert(upipe_set_flow_def(upipe_setattr, flow_def));
+    uref_free(flow_def);
+
+    /* not counted yet */
+    struct uref *uref = uref_block_alloc(uref_mgr, ubuf_mgr, UREF_SIZE);
+    assert(uref != NULL);
+    upipe_input(upipe_setattr, uref, NULL);
+    struct ustats stats;
+    ubase_nassert(ustats_get(upipe_setattr, &stats));
+
+    ustats_enable(uclock);
+    for (int i = 0; i < NB_UREFS; i++) {
+        uref = uref_block_alloc(uref_mgr, ubuf_mgr, UREF_SIZE);
+        assert(uref != NULL);
+        uref_clock_set_cr_sys(uref, uclock_now(uclock) - LATENCY);
+        upipe_input(upipe_setattr, uref, NULL);
+    }
+
+    ubase_assert(ustats_get(upipe_setattr, &stats));
+    assert(stats.urefs_in == NB_UREFS);
+    assert(stats.bytes_in == NB_UREFS * UREF_SIZE);
+    assert(stats.urefs_out == NB_UREFS);
+    assert(stats.bytes_out == NB_UREFS * UREF_SIZE);
+    assert(stats.time_self <= stats.time_total);
+    assert(stats.time_max <= stats.time_total);
+    assert(stats.latency_max >= LATENCY);
+    uint64_t nb_latency = 0;
+    for (int i = 0; i < USTATS_LATENCY_BUCKETS; i++) {
+        if ((USTATS_LATENCY_BASE << i) <= LATENCY)
+            assert(stats.latency[i] == 0);
+        nb_latency += stats.latency[i];
+    }
+    assert(nb_latency == NB_UREFS);
+    uint64_t setattr_total = stats.time_total;
+
+    ubase_assert(ustats_get(upipe_sink, &stats));
+    assert(stats.urefs_in == NB_UREFS);
+    assert(stats.urefs_out == 0);
+    assert(stats.time_total <= setattr_total);
+    /* the first uref was received before counting */
+    assert(stats.queue_depth == NB_UREFS + 1);
+    assert(stats.queue_max == NB_UREFS + 1);
+
+    test_pipe_output_input(upipe_sink);
+    ubase_assert(ustats_get(upipe_sink, &stats));
+    assert(stats.queue_depth == 0);
+    assert(stats.queue_max == NB_UREFS + 1);
+
+    char *label = ustats_upipe_label(upipe_setattr);
+    assert(label != NULL);
+    assert(strstr(label, "in 10 (1880 o)") != NULL);
+    free(label);
+    ubase_assert(ustats_dump_json(stdout));
+    upipe_dump(ustats_upipe_label, upipe_dump_flow_def_label_default, stdout,
+               NULL, upipe_setattr, NULL);
+
+    ustats_reset();
+    ubase_assert(ustats_get(upipe_setattr, &stats));
+    assert(stats.urefs_in == 0);
+
+    ustats_disable();
+    uref = uref_block_alloc(uref_mgr, ubuf_mgr, UREF_SIZE);
+    assert(uref != NULL);
+    upipe_input(upipe_setattr, uref, NULL);
+    ubase_assert(ustats_get(upipe_setattr, &stats));
+    assert(stats.urefs_in == 0);
+
+    upipe_release(upipe_setattr);
+    upipe_mgr_release(upipe_setattr_mgr);
+    test_free(upipe_sink);
+
+    uref_mgr_release(uref_mgr);
+    ubuf_mgr_release(ubuf_mgr);
+    udict_mgr_release(udict_mgr);
+    umem_mgr_release(umem_mgr);
+    uclock_release(uclock);
+    uprobe_release(uprobe_stdio);
+    uprobe_clean(&uprobe);
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2026 EasyTools
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/** @file
+ * @short unit tests for the ring mode of utrace
+ */
+
+#undef NDEBUG
+
+#include "upipe/ubase.h"
+#include "upipe/uprobe.h"
+#include "upipe/uprobe_prefix.h"
+#include "upipe/upipe.h"
+#include "upipe/utrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#define RING_EVENTS 8
+#define RING_PIPES 4096
+#define NB_CONTROLS 8
+#define PIPE_NAME "ring"
+#define TEST_COMMAND (UPIPE_CONTROL_LOCAL + 1)
+
+/* layout of a ring dump, as read by tools/utrace.lua */
+struct ring_header {
+    char magic[8];
+    uint32_t nb_events;
+    uint32_t nb_pipes;
+    uint64_t ts[2];
+    uint64_t ns[2];
+};
+
+struct ring_pipe {
+    uint64_t upipe;
+    uint32_t signature;
+    char name[52];
+};
+
+struct ring_block {
+    uint64_t tid;
+    uint64_t head;
+};
+
+struct ring_event {
+    uint64_t ts;
+    uint64_t ptr;
+    uint64_t arg;
+    uint32_t id;
+    uint32_t reserved;
+};
+
+/* event identifiers, in the order of tools/utrace.lua */
+enum ring_id {
+    RING_UPIPE_CONTROL_ENTER = 9,
+    RING_UPIPE_CONTROL_LEAVE = 10,
+    RING_ULOG_ADD_PREFIX = 25,
+};
+
+/** definition of our uprobe */
+static int catch(struct uprobe *uprobe, struct upipe *upipe,
+                 int event, va_list args)
+{
+    switch (event) {
+        case UPROBE_READY:
+        case UPROBE_DEAD:
+        case UPROBE_LOG:
+            break;
+        default:
+            assert(0);
+            break;
+    }
+    return UBASE_ERR_NONE;
+}
+
+/** helper phony pipe */
+static struct upipe *test_alloc(struct upipe_mgr *mgr, struct uprobe *uprobe,
+                                uint32_t signature, va_list args)
+{
+    struct upipe *upipe = malloc(sizeof(struct upipe));
+    assert(upipe != NULL);
+    upipe_init(upipe, mgr, uprobe);
+    upipe_throw_ready(upipe);
+    return upipe;
+}
+
+/** helper phony pipe */
+static int test_control(struct upipe *upipe, int command, va_list args)
+{
+    assert(command == TEST_COMMAND);
+    return UBASE_ERR_NONE;
+}
+
+/** helper phony pipe */
+static void test_free(struct upipe *upipe)
+{
+    upipe_throw_dead(upipe);
+    upipe_clean(upipe);
+    free(upipe);
+}
+
+/** helper phony pipe */
+static struct upipe_mgr test_mgr = {
+    .refcount = NULL,
+    .signature = UBASE_FOURCC('t','e','s','t'),
+    .upipe_alloc = test_alloc,
+    .upipe_input = NULL,
+    .upipe_control = test_control,
+};
+
+/** reads a part of the dump */
+static void read_dump(FILE *file, void *buf, size_t size)
+{
+    assert(fread(buf, size, 1, file) == 1);
+}
+
+int main(int argc, char **argv)
+{
+    /* must be set before the first traced call */
+    setenv("UTRACE_RING", "8", 1);
+    setenv("UTRACE_RING_SIGNAL", "0", 1);
+    unsetenv("UTRACE_RING_PIPES");
+    unsetenv("UTRACE_FD");
+
+    char path[] = "/tmp/utrace_ring_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+
+    int err = utrace_ring_dump(path);
+    if (err == UBASE_ERR_UNHANDLED) {
+        fprintf(stderr, "utrace is disabled, skipping\n");
+        unlink(path);
+        return 0;
+    }
+    ubase_assert(err);
+    /* the environment is left untouched */
+    assert(getenv("UTRACE_RING_PIPES") == NULL);
+
+    struct uprobe uprobe;
+    uprobe_init(&uprobe, catch, NULL);
+    struct upipe *upipe =
+        upipe_void_alloc(&test_mgr,
+                         uprobe_pfx_alloc(uprobe_use(&uprobe),
+                                          UPROBE_LOG_DEBUG, PIPE_NAME));
+    assert(upipe != NULL);
+    /* more events than the ring holds */
+    for (int i = 0; i < NB_CONTROLS; i++)
+        ubase_assert(upipe_control(upipe, TEST_COMMAND,
+                                   test_mgr.signature));
+    ubase_assert(utrace_ring_dump(path));
+
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+
+    struct ring_header header;
+    read_dump(file, &header, sizeof(header));
+    assert(!memcmp(header.magic, "UTRING01", 8));
+    assert(header.nb_events == RING_EVENTS);
+    assert(header.nb_pipes == RING_PIPES);
+    assert(header.ts[1] >= header.ts[0]);
+    assert(header.ns[1] >= header.ns[0]);
+
+    /* live pipes, terminated by an empty slot */
+    struct ring_pipe pipe;
+    read_dump(file, &pipe, sizeof(pipe));
+    assert(pipe.upipe == (uintptr_t)upipe);
+    assert(pipe.signature == test_mgr.signature);
+    assert(!strcmp(pipe.name, PIPE_NAME));
+    read_dump(file, &pipe, sizeof(pipe));
+    assert(pipe.upipe == 0);
+
+    /* ring of the only thread, terminated by a null thread identifier */
+    struct ring_block block;
+    read_dump(file, &block, sizeof(block));
+    assert(block.tid == (uint64_t)getpid());
+    assert(block.head > RING_EVENTS);
+    struct ring_event events[RING_EVENTS];
+    read_dump(file, events, sizeof(events));
+    uint64_t ts = 0;
+    for (uint64_t i = block.head - RING_EVENTS; i < block.head; i++) {
+        struct ring_event *event = &events[i % RING_EVENTS];
+        assert(event->id <= RING_ULOG_ADD_PREFIX);
+        assert(event->ts >= ts);
+        ts = event->ts;
+        /* the last controls fill the ring */
+        if ((block.head - i) % 2) {
+            assert(event->id == RING_UPIPE_CONTROL_LEAVE);
+            assert(event->arg == UBASE_ERR_NONE);
+        } else {
+            assert(event->id == RING_UPIPE_CONTROL_ENTER);
+            assert(event->ptr == (uintptr_t)upipe);
+            assert(event->arg == TEST_COMMAND);
+        }
+    }
+    read_dump(file, &block, sizeof(block));
+    assert(block.tid == 0);
+    assert(fgetc(file) == EOF);
+    fclose(file);
+    unlink(path);
+
+    test_free(upipe);
+    uprobe_clean(&uprobe);
+    return 0;
+}
@@ -268,6 +268,254 @@ local udict_type = enum {
     'unsigned', 'int', 'rational', 'float'
 }
 
+local ring_id = enum {
+    'dump_graph',
+    'uprobe_init', 'uprobe_clean', 'uprobe_throw_enter', 'uprobe_throw_leave',
+    'upipe_alloc_enter', 'upipe_alloc_leave', 'upipe_init', 'upipe_clean',
+    'upipe_control_enter', 'upipe_control_leave',
+    'upipe_throw_enter', 'upipe_throw_leave',
+    'upipe_input_enter', 'upipe_input_leave',
+    'urequest_init', 'urequest_clean', 'urequest_free',
+    'urequest_provide_enter', 'urequest_provide_leave',
+    'upump_alloc_enter', 'upump_alloc_leave',
+    'upump_control_enter', 'upump_control_leave',
+    'ulog_init', 'ulog_add_prefix',
+}
+
+ffi.cdef [[
+    typedef struct {
+        char magic[8];
+        uint32_t nb_events;
+        uint32_t nb_pipes;
+        uint64_t ts[2];
+        uint64_t ns[2];
+    } utrace_ring_header;
+
+    typedef struct {
+        uint64_t upipe;
+        uint32_t signature;
+        char name[52];
+    } utrace_ring_pipe;
+
+    typedef struct {
+        uint64_t tid;
+        uint64_t head;
+    } utrace_ring_block;
+
+    typedef struct {
+        uint64_t ts;
+        uint64_t ptr;
+        uint64_t arg;
+        uint32_t id;
+        uint32_t reserved;
+    } utrace_ring_event;
+]]
+
+local function fourcc(sig)
+    local s = ""
+    for i = 0, 3 do
+        local c = band(rsh(sig, i * 8), 0xff)
+        s = s .. ((c >= 32 and c < 127) and string.char(c) or ".")
+    end
+    return s
+end
+
+-- read a ring dump, returning the pipe names and the events of each thread,
+-- with timestamps converted to nanoseconds
+local function ring_load(filename)
+    local file = io.open(filename, "rb")
+    uassert(file, "%s: cannot open file", filename)
+    local data = file:read("*a")
+    file:close()
+
+    local base = ffi.cast("const char *", data)
+    local size, offset = #data, 0
+    local function get(ctype)
+        local len = ffi.sizeof(ctype)
+        uassert(offset + len <= size, "%s: truncated file", filename)
+        local p = ffi.cast(ctype .. " *", base + offset)
+        offset = offset + len
+        return p[0]
+    end
+
+    local hdr = get("utrace_ring_header")
+    uassert(ffi.string(hdr.magic, 8) == "UTRING01",
+        "%s: unrecognized file format", filename)
+    local ts0, ns0 = hdr.ts[0], tonumber(hdr.ns[0])
+    local scale = 1
+    if hdr.ts[1] > hdr.ts[0] then
+        scale = tonumber(hdr.ns[1] - hdr.ns[0]) /
+                tonumber(hdr.ts[1] - hdr.ts[0])
+    end
+
+    local names = {}
+    while true do
+        local pipe = get("utrace_ring_pipe")
+        if pipe.upipe == 0 then break end
+        local name = ffi.string(pipe.name)
+        names[tonumber(pipe.upipe)] = name ~= "" and name or
+            fmt("%s@%x", fourcc(pipe.signature), tonumber(pipe.upipe))
+    end
+
+    local threads = {}
+    while true do
+        local block = get("utrace_ring_block")
+        if block.tid == 0 then break end
+        local nb = hdr.nb_events
+        local head = tonumber(block.head)
+        local first = head > nb and head - nb or 0
+        local events = ffi.cast("const utrace_ring_event *", base + offset)
+        uassert(offset + nb * ffi.sizeof("utrace_ring_event") <= size,
+            "%s: truncated file", filename)
+        offset = offset + nb * ffi.sizeof("utrace_ring_event")
+
+        local list = {}
+        for i = first, head - 1 do
+            local ev = events[i % nb]
+            local ts = ev.ts >= ts0 and tonumber(ev.ts - ts0) or
+                -tonumber(ts0 - ev.ts)
+            insert(list, {
+                id = ring_id[ev.id],
+                ptr = tonumber(ev.ptr),
+                arg = tonumber(ev.arg),
+                ns = ns0 + ts * scale,
+            })
+        end
+        insert(threads, { tid = tonumber(block.tid), events = list })
+    end
+
+    return names, threads
+end
+
+-- rebuild the call trees of each thread, calling leave(node, stack) for
+-- every call whose entry and exit are both in the ring
+local function ring_walk(names, threads, all, leave)
+    local kinds = {
+        upipe_input_enter = "input", upipe_input_leave = "input",
+    }
+    if all then
+        kinds.upipe_control_enter = "control"
+        kinds.upipe_control_leave = "control"
+        kinds.upipe_throw_enter = "throw"
+        kinds.upipe_throw_leave = "throw"
+        kinds.urequest_provide_enter = "provide"
+        kinds.urequest_provide_leave = "provide"
+        kinds.upump_control_enter = "upump"
+        kinds.upump_control_leave = "upump"
+    end
+
+    local function pipe_name(ptr, sig)
+        local name = names[ptr]
+        if not name then
+            name = sig and fmt("%s@%x", fourcc(sig), ptr) or fmt("%x", ptr)
+            names[ptr] = name
+        end
+        return name
+    end
+
+    for _, thread in ipairs(threads) do
+        local stack = {}
+        for _, ev in ipairs(thread.events) do
+            local kind = kinds[ev.id]
+            if ev.id == "upipe_init" then
+                pipe_name(ev.ptr, ev.arg)
+            elseif kind and ev.id:match("_enter$") then
+                local name = pipe_name(ev.ptr,
+                    ev.id == "upipe_input_enter" and ev.arg or nil)
+                if kind == "control" then
+                    name = name .. ":" .. (upipe_command[ev.arg] or ev.arg)
+                elseif kind ~= "input" then
+                    name = name .. ":" .. kind
+                end
+                insert(stack, {
+                    kind = kind, name = name:gsub(";", ","),
+                    start = ev.ns, children = {}, nested = 0,
+                })
+            elseif kind and #stack > 0 and stack[#stack].kind == kind then
+                local node = table.remove(stack)
+                node.duration = ev.ns - node.start
+                local parent = stack[#stack]
+                if parent then
+                    parent.nested = parent.nested + node.duration
+                    insert(parent.children, node)
+                end
+                leave(thread, node, stack)
+            end
+        end
+    end
+end
+
+-- print folded stacks of self time in nanoseconds, for flamegraph.pl
+local function ring_flame(names, threads, all)
+    local folded = {}
+    ring_walk(names, threads, all, function (thread, node, stack)
+        local path = { tostring(thread.tid) }
+        for _, frame in ipairs(stack) do insert(path, frame.name) end
+        insert(path, node.name)
+        local key = concat(path, ";")
+        local self = node.duration - node.nested
+        folded[key] = (folded[key] or 0) + (self > 0 and self or 0)
+    end)
+
+    local keys = {}
+    for key in pairs(folded) do insert(keys, key) end
+    table.sort(keys)
+    for _, key in ipairs(keys) do
+        print(fmt("%s %d", key, folded[key]))
+    end
+end
+
+-- print latency statistics of the top-level calls of each pipe, with the
+-- critical path of the slowest call
+local function ring_latency(names, threads, all)
+    local roots = {}
+    ring_walk(names, threads, all, function (thread, node, stack)
+        if #stack > 0 then return end
+        local root = roots[node.name]
+        if not root then
+            root = { name = node.name, durations = {}, total = 0 }
+            roots[node.name] = root
+        end
+        insert(root.durations, node.duration)
+        root.total = root.total + node.duration
+        if not root.slowest or node.duration > root.slowest.duration then
+            root.slowest = node
+        end
+    end)
+
+    local list = {}
+    for _, root in pairs(roots) do insert(list, root) end
+    table.sort(list, function (a, b) return a.total > b.total end)
+
+    local function ms(ns) return fmt("%.3f", ns / 1e6) end
+    print(fmt("%-40s %8s %10s %10s %10s %10s",
+        "pipe", "calls", "total ms", "avg ms", "p99 ms", "max ms"))
+    for _, root in ipairs(list) do
+        local d = root.durations
+        table.sort(d)
+        local p99 = d[math.max(1, math.ceil(#d * 0.99))]
+        print(fmt("%-40s %8d %10s %10s %10s %10s", root.name, #d,
+            ms(root.total), ms(root.total / #d), ms(p99), ms(d[#d])))
+    end
+
+    for _, root in ipairs(list) do
+        print(fmt("\ncritical path of slowest %s (%s ms):",
+            root.name, ms(root.slowest.duration)))
+        local node, depth = root.slowest, 0
+        while node do
+            print(fmt("%s%s  %s ms (self %s ms)", string.rep("  ", depth),
+                node.name, ms(node.duration), ms(node.duration - node.nested)))
+            local next_node
+            for _, child in ipairs(node.children) do
+                if not next_node or child.duration > next_node.duration then
+                    next_node = child
+                end
+            end
+            node, depth = next_node, depth + 1
+        end
+    end
+end
+
 local function usage()
     io.stderr:write("Usage: ", arg[0], " COMMAND [ARGS]\n",
         "\n",
@@ -288,6 +536,12 @@ local function usage()
         "\n",
         "  utrace graph [<options>] [<name>]...\n",
         "    -i, --input <file>     input file name [utrace.data]\n",
+        "\n",
+        "  utrace ring [<options>]\n",
+        "    -i, --input <file>     ring dump file name\n",
+        "    -f, --flame            print folded stacks for flamegraph.pl\n",
+        "    -l, --latency          print per-pipe latency and critical path\n",
+        "    -a, --all              include control, throw and request calls\n",
         "\n")
     os.exit(1)
 end
@@ -428,6 +682,26 @@ elseif command == "graph" then
 
     dump_graphs = enum(arg)
 
+elseif command == "ring" then
+    local report = ring_latency
+    local all = false
+    filename = nil
+
+    while arg[1] and arg[1]:sub(1, 1) == "-" do
+        local opt = shift()
+        if opt == "--input" or opt == "-i" then filename = shift()
+        elseif opt == "--flame" or opt == "-f" then report = ring_flame
+        elseif opt == "--latency" or opt == "-l" then report = ring_latency
+        elseif opt == "--all" or opt == "-a" then all = true
+        else usage()
+        end
+    end
+
+    uassert(filename, "missing input file")
+    local names, threads = ring_load(filename)
+    report(names, threads, all)
+    return
+
 else
     usage()
 end